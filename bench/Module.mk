@@ -0,0 +1,3 @@
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), bench.c bench_loopback.c bench_micro.c bench_main.c)
@@ -0,0 +1,358 @@
+/**
+ * Benchmark tools: timing, results and JSON report
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <malloc.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "bench.h"
+#include "csm_definitions.h"
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+// The glibc allocator is wrapped to count the calls of the whole process (stack, HAL, mbed TLS)
+static volatile uint64_t bench_alloc_calls = 0U;
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    (void) __sync_fetch_and_add(&bench_alloc_calls, 1U);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nb, size_t size)
+{
+    (void) __sync_fetch_and_add(&bench_alloc_calls, 1U);
+    return __libc_calloc(nb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    (void) __sync_fetch_and_add(&bench_alloc_calls, 1U);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+uint64_t bench_allocations(void)
+{
+    return bench_alloc_calls;
+}
+
+int64_t bench_heap_usage(void)
+{
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33)))
+    struct mallinfo2 info = mallinfo2();
+    return (int64_t)info.uordblks;
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return (int64_t)info.uordblks;
+#else
+    return 0;
+#endif
+}
+
+uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r" (value));
+    return value;
+#else
+    return 0U;
+#endif
+}
+
+int bench_pin_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return (sched_setaffinity(0, sizeof(set), &set) == 0) ? TRUE : FALSE;
+#else
+    (void) cpu;
+    return FALSE;
+#endif
+}
+
+void bench_measure(bench_result *result, bench_kernel kernel, void *ctx, const bench_options *options)
+{
+    uint32_t runs = (options->runs > 0U) ? options->runs : 1U;
+    uint64_t per_run = (options->iterations > runs) ? (options->iterations / runs) : 1U;
+    uint64_t warmup = (options->warmup > 0U) ? options->warmup : ((options->iterations / 100U) + 1U);
+    double sum = 0.0;
+    double sum_sq = 0.0;
+
+    for (uint64_t i = 0U; i < warmup; i++)
+    {
+        (void) kernel(ctx);
+    }
+
+    int64_t heap = bench_heap_usage();
+    uint64_t allocations = bench_allocations();
+
+    for (uint32_t r = 0U; r < runs; r++)
+    {
+        uint64_t start = bench_now_ns();
+        uint64_t start_cycles = bench_cycles();
+
+        for (uint64_t i = 0U; i < per_run; i++)
+        {
+            int ret = kernel(ctx);
+            if (ret >= 0)
+            {
+                result->bytes += (uint64_t)ret;
+            }
+            else
+            {
+                result->errors++;
+            }
+        }
+
+        uint64_t cycles = bench_cycles() - start_cycles;
+        uint64_t ns = bench_now_ns() - start;
+        double ns_per_op = (double)ns / (double)per_run;
+
+        result->total_ns += ns;
+        result->cycles += cycles;
+        sum += ns_per_op;
+        sum_sq += ns_per_op * ns_per_op;
+    }
+
+    result->allocations = bench_allocations() - allocations;
+    result->heap_growth = bench_heap_usage() - heap;
+    result->iterations = per_run * runs;
+    result->runs = runs;
+
+    if (runs > 1U)
+    {
+        double variance = (sum_sq - ((sum * sum) / runs)) / (runs - 1U);
+        result->ns_stddev = (variance > 0.0) ? sqrt(variance) : 0.0;
+    }
+}
+
+bench_result *bench_report_add(bench_report *report, const char *name, const char *variant)
+{
+    bench_result *result = NULL;
+
+    if (report->size < BENCH_MAX_RESULTS)
+    {
+        result = &report->results[report->size];
+        report->size++;
+        memset(result, 0, sizeof(*result));
+        snprintf(result->name, BENCH_NAME_SIZE, "%s", name);
+        snprintf(result->variant, BENCH_NAME_SIZE, "%s", variant);
+    }
+    return result;
+}
+
+int bench_is_selected(const bench_options *options, const char *name, const char *variant)
+{
+    int selected = TRUE;
+
+    if ((options->scenario != NULL) && (strcmp(options->scenario, name) != 0))
+    {
+        selected = FALSE;
+    }
+    if ((options->variant != NULL) && (strcmp(options->variant, variant) != 0))
+    {
+        selected = FALSE;
+    }
+    return selected;
+}
+
+static double bench_ns_per_op(const bench_result *result)
+{
+    return (result->iterations > 0U) ? ((double)result->total_ns / (double)result->iterations) : 0.0;
+}
+
+static double bench_ops_per_sec(const bench_result *result)
+{
+    return (result->total_ns > 0U) ? (((double)result->iterations * 1e9) / (double)result->total_ns) : 0.0;
+}
+
+static double bench_cycles_per_op(const bench_result *result)
+{
+    return (result->iterations > 0U) ? ((double)result->cycles / (double)result->iterations) : 0.0;
+}
+
+static double bench_cycles_per_byte(const bench_result *result)
+{
+    return (result->bytes > 0U) ? ((double)result->cycles / (double)result->bytes) : 0.0;
+}
+
+void bench_report_print(const bench_report *report)
+{
+    printf("%-16s %-10s %12s %12s %10s %8s %10s %8s %10s %10s %8s\r\n", "scenario", "variant", "iterations", "ops/s", "ns/op",
+           "stddev", "cycles/op", "cycles/B", "allocs", "heap+", "errors");
+
+    for (uint32_t i = 0U; i < report->size; i++)
+    {
+        const bench_result *r = &report->results[i];
+        printf("%-16s %-10s %12llu %12.0f %10.1f %8.1f %10.1f %8.2f %10llu %10lld %8u\r\n", r->name, r->variant,
+               (unsigned long long)r->iterations, bench_ops_per_sec(r), bench_ns_per_op(r), r->ns_stddev,
+               bench_cycles_per_op(r), bench_cycles_per_byte(r), (unsigned long long)r->allocations,
+               (long long)r->heap_growth, r->errors);
+    }
+}
+
+int bench_report_write_json(const bench_report *report, const char *file_name)
+{
+    int ret = FALSE;
+    FILE *f = fopen(file_name, "w");
+
+    if (f != NULL)
+    {
+        fprintf(f, "{\n  \"version\": \"%s\",\n  \"results\": [\n", CSM_DEF_LIB_VERSION);
+        for (uint32_t i = 0U; i < report->size; i++)
+        {
+            const bench_result *r = &report->results[i];
+            fprintf(f, "    { \"name\": \"%s\", \"variant\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, "
+                       "\"ns_stddev\": %.2f, \"runs\": %u, \"ops_per_sec\": %.0f, \"cycles_per_op\": %.2f, "
+                       "\"cycles_per_byte\": %.3f, \"bytes\": %llu, \"allocations\": %llu, \"heap_growth\": %lld, \"errors\": %u }%s\n",
+                    r->name, r->variant, (unsigned long long)r->iterations, bench_ns_per_op(r), r->ns_stddev, r->runs,
+                    bench_ops_per_sec(r), bench_cycles_per_op(r), bench_cycles_per_byte(r),
+                    (unsigned long long)r->bytes, (unsigned long long)r->allocations, (long long)r->heap_growth, r->errors,
+                    ((i + 1U) < report->size) ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+        ret = (fclose(f) == 0) ? TRUE : FALSE;
+    }
+    return ret;
+}
+
+// ----------------------------------- BASELINE -----------------------------------
+
+// The baseline is our own JSON output: one result per line, so a key lookup in the line is enough
+static int bench_json_string(const char *line, const char *key, char *value, uint32_t size)
+{
+    int ret = FALSE;
+    char pattern[BENCH_NAME_SIZE];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *start = strstr(line, pattern);
+
+    if (start != NULL)
+    {
+        start += strlen(pattern);
+        const char *end = strchr(start, '"');
+        if ((end != NULL) && ((uint32_t)(end - start) < size))
+        {
+            memcpy(value, start, (size_t)(end - start));
+            value[end - start] = '\0';
+            ret = TRUE;
+        }
+    }
+    return ret;
+}
+
+static double bench_json_number(const char *line, const char *key)
+{
+    char pattern[BENCH_NAME_SIZE];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *start = strstr(line, pattern);
+
+    return (start != NULL) ? strtod(start + strlen(pattern), NULL) : 0.0;
+}
+
+static const bench_result *bench_report_find(const bench_report *report, const char *name, const char *variant)
+{
+    const bench_result *result = NULL;
+
+    for (uint32_t i = 0U; (i < report->size) && (result == NULL); i++)
+    {
+        if ((strcmp(report->results[i].name, name) == 0) && (strcmp(report->results[i].variant, variant) == 0))
+        {
+            result = &report->results[i];
+        }
+    }
+    return result;
+}
+
+int bench_report_compare(const bench_report *report, const char *baseline_file, double threshold_pct)
+{
+    int ret = TRUE;
+    char line[512];
+    FILE *f = fopen(baseline_file, "r");
+
+    if (f == NULL)
+    {
+        return FALSE;
+    }
+
+    printf("\r\n%-16s %-10s %10s %10s %8s %8s  %s\r\n", "scenario", "variant", "base ns/op", "ns/op", "delta", "t", "verdict");
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char name[BENCH_NAME_SIZE];
+        char variant[BENCH_NAME_SIZE];
+
+        if (!bench_json_string(line, "name", name, sizeof(name)) || !bench_json_string(line, "variant", variant, sizeof(variant)))
+        {
+            continue;
+        }
+
+        const bench_result *r = bench_report_find(report, name, variant);
+        if ((r == NULL) || (r->iterations == 0U))
+        {
+            continue;
+        }
+
+        double base = bench_json_number(line, "ns_per_op");
+        double base_sd = bench_json_number(line, "ns_stddev");
+        double base_runs = bench_json_number(line, "runs");
+        double current = bench_ns_per_op(r);
+        double delta = (base > 0.0) ? (((current - base) * 100.0) / base) : 0.0;
+
+        // Welch t statistic, the standard error cannot be zero with a single run
+        double se = sqrt(((r->ns_stddev * r->ns_stddev) / ((r->runs > 0U) ? r->runs : 1U)) +
+                         ((base_sd * base_sd) / ((base_runs >= 1.0) ? base_runs : 1.0)));
+        double t = (se > 0.0) ? ((current - base) / se) : ((current > base) ? INFINITY : -INFINITY);
+        const char *verdict = "same";
+
+        if ((fabs(delta) > threshold_pct) && (fabs(t) > 3.0))
+        {
+            if (delta > 0.0)
+            {
+                verdict = "SLOWER";
+                ret = FALSE;
+            }
+            else
+            {
+                verdict = "faster";
+            }
+        }
+
+        printf("%-16s %-10s %10.1f %10.1f %+7.1f%% %8.1f  %s\r\n", name, variant, base, current, delta, t, verdict);
+    }
+
+    fclose(f);
+    return ret;
+}
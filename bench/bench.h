@@ -0,0 +1,103 @@
+/**
+ * Benchmark tools: timing, results and JSON report
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define BENCH_MAX_RESULTS   64U
+#define BENCH_NAME_SIZE     32U
+
+typedef struct
+{
+    char name[BENCH_NAME_SIZE];         //!< Scenario name
+    char variant[BENCH_NAME_SIZE];      //!< Transport or data set
+    uint64_t iterations;
+    uint64_t total_ns;
+    uint64_t bytes;                     //!< Bytes exchanged (or processed) by all the iterations
+    uint64_t allocations;               //!< Allocator calls of the whole process during the measure (malloc, calloc, realloc)
+    int64_t heap_growth;                //!< Bytes still allocated at the end of the measure
+    uint32_t errors;
+    uint64_t cycles;                    //!< CPU cycles for all the iterations, 0 if no cycle counter
+    uint32_t runs;                      //!< Number of timed runs the iterations are split into
+    double ns_stddev;                   //!< Standard deviation of ns/op between the runs
+} bench_result;
+
+typedef struct
+{
+    bench_result results[BENCH_MAX_RESULTS];
+    uint32_t size;
+} bench_report;
+
+typedef struct
+{
+    uint64_t iterations;
+    const char *scenario;   //!< Run only this scenario, NULL for all
+    const char *variant;    //!< Run only this transport/data set, NULL for all
+    uint64_t warmup;        //!< Untimed iterations before the measure, 0 for 1% of the iterations
+    uint32_t runs;          //!< Timed runs, used for the standard deviation
+} bench_options;
+
+// Measured operation: return the number of bytes processed, negative on error
+typedef int (*bench_kernel)(void *ctx);
+
+uint64_t bench_now_ns(void);
+int64_t bench_heap_usage(void);
+
+// Allocator calls of the process since its start, 0 if they cannot be counted (non glibc systems)
+uint64_t bench_allocations(void);
+
+// Time stamp counter where available (x86, ARMv8), 0 otherwise
+uint64_t bench_cycles(void);
+
+// Pin the calling thread to one CPU, reduces the noise of the migrations
+int bench_pin_cpu(int cpu);
+
+// Warmup then options->runs timed runs of the kernel, fill the timing fields of the result
+void bench_measure(bench_result *result, bench_kernel kernel, void *ctx, const bench_options *options);
+
+// Return a new result slot, NULL if the report is full
+bench_result *bench_report_add(bench_report *report, const char *name, const char *variant);
+
+void bench_report_print(const bench_report *report);
+int bench_report_write_json(const bench_report *report, const char *file_name);
+
+/**
+ * @brief Compare the report with a baseline written by bench_report_write_json()
+ *
+ * A result is a regression when it is slower by more than threshold_pct percent and the difference
+ * is significant (Welch t-test, |t| > 3) given the run-to-run deviations.
+ *
+ * @return FALSE if the baseline cannot be read or a regression is detected
+ */
+int bench_report_compare(const bench_report *report, const char *baseline_file, double threshold_pct);
+
+// Filter helper: TRUE if the scenario/variant must be run
+int bench_is_selected(const bench_options *options, const char *name, const char *variant);
+
+// ----------------------------------- SUITES -----------------------------------
+
+// Client encoders <-> server stack through an in-memory transport
+int bench_loopback_run(const bench_options *options, bench_report *report);
+
+// Codec primitives: csm_array, BER, A-XDR, HDLC, FCS, clock
+int bench_micro_run(const bench_options *options, bench_report *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_H
@@ -0,0 +1,540 @@
+/**
+ * Loopback benchmark: client encoders <-> server stack through an in-memory transport
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "bench.h"
+#include "csm_channel.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+#include "csm_security.h"
+#include "host_hal.h"
+#include "hdlc.h"
+#include "os_util.h"
+
+#define BENCH_BUF_SIZE          2048U
+#define BENCH_HEADROOM          128U    ///< Free space before the APDU, needed by the security layer (>= CSM_DEF_MAX_HLS_SIZE)
+#define BENCH_CLIENT_SAP        0x10U
+#define BENCH_SERVER_SAP        0x01U
+#define BENCH_CLIENT_GCM        (HOST_HAL_MAX_CHANNELS - 1U)  ///< GCM context used by the client side
+#define BENCH_PROFILE_ENTRIES   32U
+#define BENCH_WRAPPER_HDR_SIZE  8U
+#define BENCH_AP_TITLE_SIZE     (CSM_DEF_APP_TITLE_SIZE + 4U)   ///< calling-AP-title field of the AARQ
+
+enum bench_transport { BENCH_RAW, BENCH_WRAPPER, BENCH_HDLC, BENCH_NB_TRANSPORTS };
+
+static const char *cTransportNames[BENCH_NB_TRANSPORTS] = { "raw", "wrapper", "hdlc" };
+
+static const uint8_t cClientTitle[CSM_DEF_APP_TITLE_SIZE] = { 'B', 'E', 'N', 'C', 'H', 0x00U, 0x00U, 0x01U };
+static const uint8_t cDateTime[12] = { 0x07U, 0xE0U, 0x0BU, 0x03U, 0x04U, 0x0CU, 0x1EU, 0x00U, 0xFFU, 0xFFU, 0xC4U, 0x00U };
+static const uint8_t cRlrq[] = { CSM_ASSO_RLRQ, 3U, 0x80U, 0x01U, 0x00U };
+
+static const csm_asso_config cAssoConf =
+{
+    { BENCH_CLIENT_SAP, BENCH_SERVER_SAP },
+    CSM_CBLOCK_GET | CSM_CBLOCK_SET | CSM_CBLOCK_ACTION | CSM_CBLOCK_SELECTIVE_ACCESS | CSM_CBLOCK_BLOCK_TRANSFER_WITH_GET_OR_READ,
+    FALSE
+};
+
+typedef struct
+{
+    enum bench_transport transport;
+    uint8_t channel;                //!< Channel index in the server stack
+    hdlc_t client_hdlc;
+    hdlc_t server_hdlc;
+    csm_asso_state client_asso;
+    csm_request client_request;
+    csm_response client_response;
+    uint32_t client_ic;             //!< Invocation counter of the ciphered requests
+    uint8_t apdu[BENCH_BUF_SIZE];   //!< Client APDU before framing
+    uint8_t wire[BENCH_BUF_SIZE];   //!< Transport frame
+    uint8_t server_buf[BENCH_BUF_SIZE];
+} bench_ctx;
+
+typedef int (*bench_op)(bench_ctx *ctx);
+
+static csm_channel channels[1];
+static csm_asso_state assos[1];
+static csm_sec_context security[1];
+static bench_ctx context;
+
+// ----------------------------------- SERVER DATABASE -----------------------------------
+
+static csm_db_code bench_db_access(csm_array *in, csm_array *out, csm_request *request)
+{
+    csm_db_code code = CSM_ERR_OBJECT_NOT_FOUND;
+    const csm_object_t *obj = &request->db_request.logical_name;
+    (void) in;
+
+    if ((obj->class_id == 8U) && (obj->id == 2))
+    {
+        // Clock::time
+        if (request->db_request.service == SVC_GET)
+        {
+            code = csm_axdr_wr_octetstring(out, cDateTime, sizeof(cDateTime)) ? CSM_OK : CSM_ERR_OBJECT_ERROR;
+        }
+        else
+        {
+            uint32_t size;
+            code = (csm_axdr_rd_octetstring(in, &size) && (size == sizeof(cDateTime))) ? CSM_OK : CSM_ERR_DATA_CONTENT_NOT_OK;
+        }
+    }
+    else if ((obj->class_id == 7U) && (obj->id == 2) && (request->db_request.service == SVC_GET))
+    {
+        // Profile generic::buffer, array of { date-time, double-long-unsigned }
+        int valid = csm_array_write_u8(out, AXDR_TAG_ARRAY);
+        valid = valid && csm_ber_write_len(out, BENCH_PROFILE_ENTRIES);
+        for (uint32_t i = 0U; i < BENCH_PROFILE_ENTRIES; i++)
+        {
+            valid = valid && csm_array_write_u8(out, AXDR_TAG_STRUCTURE);
+            valid = valid && csm_ber_write_len(out, 2U);
+            valid = valid && csm_axdr_wr_octetstring(out, cDateTime, sizeof(cDateTime));
+            valid = valid && csm_axdr_wr_u32(out, 1000U + i);
+        }
+        code = valid ? CSM_OK : CSM_ERR_OBJECT_ERROR;
+    }
+    return code;
+}
+
+// ----------------------------------- IN-MEMORY TRANSPORT -----------------------------------
+
+// Encapsulate an APDU into a transport frame, return the frame size (0 on error)
+static uint32_t bench_frame(bench_ctx *ctx, hdlc_t *hdlc, const uint8_t *apdu, uint32_t size, uint8_t *frame)
+{
+    uint32_t frame_size = 0U;
+
+    if (ctx->transport == BENCH_WRAPPER)
+    {
+        // Version, source wPort, destination wPort, length
+        PUT_BE16(&frame[0], 1U);
+        PUT_BE16(&frame[2], (hdlc->sender == HDLC_CLIENT) ? BENCH_CLIENT_SAP : BENCH_SERVER_SAP);
+        PUT_BE16(&frame[4], (hdlc->sender == HDLC_CLIENT) ? BENCH_SERVER_SAP : BENCH_CLIENT_SAP);
+        PUT_BE16(&frame[6], size);
+        memcpy(&frame[BENCH_WRAPPER_HDR_SIZE], apdu, size);
+        frame_size = size + BENCH_WRAPPER_HDR_SIZE;
+    }
+    else if (ctx->transport == BENCH_HDLC)
+    {
+        // LLC header: E6 E6 00 for a command, E6 E7 00 for a response
+        uint8_t info[BENCH_BUF_SIZE];
+        info[0] = 0xE6U;
+        info[1] = (hdlc->sender == HDLC_CLIENT) ? 0xE6U : 0xE7U;
+        info[2] = 0x00U;
+        memcpy(&info[3], apdu, size);
+        int ret = hdlc_encode_data(hdlc, frame, BENCH_BUF_SIZE, info, size + 3U);
+        frame_size = (ret > 0) ? (uint32_t)ret : 0U;
+    }
+    else
+    {
+        memcpy(frame, apdu, size);
+        frame_size = size;
+    }
+    return frame_size;
+}
+
+// Find the APDU in a transport frame, return its size (0 on error)
+static uint32_t bench_unframe(bench_ctx *ctx, hdlc_t *hdlc, uint8_t *frame, uint32_t size, uint8_t **apdu)
+{
+    uint32_t apdu_size = 0U;
+
+    if (ctx->transport == BENCH_WRAPPER)
+    {
+        if ((size >= BENCH_WRAPPER_HDR_SIZE) && (GET_BE16(&frame[6]) == (size - BENCH_WRAPPER_HDR_SIZE)))
+        {
+            *apdu = &frame[BENCH_WRAPPER_HDR_SIZE];
+            apdu_size = size - BENCH_WRAPPER_HDR_SIZE;
+        }
+    }
+    else if (ctx->transport == BENCH_HDLC)
+    {
+        // The decoder expects the sender of the frame, which is the peer
+        uint8_t sender = hdlc->sender;
+        hdlc->sender = (sender == HDLC_CLIENT) ? HDLC_SERVER : HDLC_CLIENT;
+
+        if ((hdlc_decode(hdlc, frame, size) == HDLC_OK) && (hdlc->type == HDLC_PACKET_TYPE_I) && (hdlc->data_size > 3U))
+        {
+            *apdu = &frame[hdlc->data_index + 3U];
+            apdu_size = hdlc->data_size - 3U;
+        }
+        hdlc->sender = sender;
+    }
+    else
+    {
+        *apdu = frame;
+        apdu_size = size;
+    }
+    return apdu_size;
+}
+
+// Server side: decode the frame, execute the stack and frame the reply in place, return the reply frame size
+static uint32_t bench_server(bench_ctx *ctx, uint32_t frame_size)
+{
+    uint8_t *apdu = NULL;
+    uint32_t size = bench_unframe(ctx, &ctx->server_hdlc, ctx->wire, frame_size, &apdu);
+    uint32_t reply_size = 0U;
+    csm_array packet;
+
+    if ((size > 0U) && (size <= (BENCH_BUF_SIZE - BENCH_HEADROOM)))
+    {
+        memcpy(&ctx->server_buf[BENCH_HEADROOM], apdu, size);
+        csm_array_init(&packet, ctx->server_buf, BENCH_BUF_SIZE, size, BENCH_HEADROOM);
+
+        int ret = csm_channel_execute(ctx->channel, &packet);
+        if (ret > 0)
+        {
+            reply_size = bench_frame(ctx, &ctx->server_hdlc, &ctx->server_buf[BENCH_HEADROOM], (uint32_t)ret, ctx->wire);
+        }
+    }
+    return reply_size;
+}
+
+// Client side: frame the APDU, run the server and return the reply APDU in an array (bytes exchanged, 0 on error)
+static uint32_t bench_exchange(bench_ctx *ctx, uint32_t apdu_size, csm_array *reply)
+{
+    uint32_t exchanged = 0U;
+    uint32_t frame_size = bench_frame(ctx, &ctx->client_hdlc, ctx->apdu, apdu_size, ctx->wire);
+
+    if (frame_size > 0U)
+    {
+        uint32_t reply_frame_size = bench_server(ctx, frame_size);
+        uint8_t *apdu = NULL;
+        uint32_t size = bench_unframe(ctx, &ctx->client_hdlc, ctx->wire, reply_frame_size, &apdu);
+
+        if (size > 0U)
+        {
+            csm_array_init(reply, apdu, size, size, 0U);
+            exchanged = frame_size + reply_frame_size;
+        }
+    }
+    return exchanged;
+}
+
+// ----------------------------------- SCENARIOS -----------------------------------
+
+static int bench_op_associate(bench_ctx *ctx)
+{
+    csm_array array;
+    csm_array reply;
+
+    csm_asso_init(&ctx->client_asso);
+    ctx->client_asso.ref = LN_REF;
+    csm_array_init(&array, ctx->apdu, BENCH_BUF_SIZE, 0U, 0U);
+
+    int exchanged = 0;
+    if (csm_asso_encoder(&ctx->client_asso, &array, CSM_ASSO_AARQ) && ((array.wr_index + BENCH_AP_TITLE_SIZE) <= BENCH_BUF_SIZE))
+    {
+        // The client encoder has no calling-AP-title, needed by the server for the ciphered APDUs:
+        // insert it after the application-context-name (tag, length, then 9 bytes)
+        uint8_t *title = &ctx->apdu[13];
+        memmove(&title[BENCH_AP_TITLE_SIZE], title, array.wr_index - 13U);
+        title[0] = CSM_ASSO_CALLING_AP_TITLE;
+        title[1] = CSM_DEF_APP_TITLE_SIZE + 2U;
+        title[2] = CSM_BER_TYPE_OCTET_STRING;
+        title[3] = CSM_DEF_APP_TITLE_SIZE;
+        memcpy(&title[4], cClientTitle, CSM_DEF_APP_TITLE_SIZE);
+        ctx->apdu[1] += BENCH_AP_TITLE_SIZE;
+        array.wr_index += BENCH_AP_TITLE_SIZE;
+
+        exchanged = (int)bench_exchange(ctx, array.wr_index, &reply);
+        if ((exchanged > 0) && !csm_asso_decoder(&ctx->client_asso, &reply, CSM_ASSO_AARE))
+        {
+            exchanged = -1;
+        }
+    }
+    csm_asso_release_handshake(&ctx->client_asso);
+    return (exchanged > 0) ? exchanged : -1;
+}
+
+static int bench_op_release(bench_ctx *ctx)
+{
+    csm_array reply;
+    memcpy(ctx->apdu, cRlrq, sizeof(cRlrq));
+
+    uint32_t exchanged = bench_exchange(ctx, sizeof(cRlrq), &reply);
+    uint8_t tag = 0U;
+    return ((exchanged > 0U) && csm_array_get(&reply, 0U, &tag) && (tag == CSM_ASSO_RLRE)) ? (int)exchanged : -1;
+}
+
+static int bench_op_aarq_rlrq(bench_ctx *ctx)
+{
+    int exchanged = bench_op_associate(ctx);
+    int released = bench_op_release(ctx);
+    return ((exchanged > 0) && (released > 0)) ? (exchanged + released) : -1;
+}
+
+static void bench_set_object(csm_request *request, enum csm_service service, uint16_t class_id, uint8_t c, int8_t id)
+{
+    request->db_request.service = service;
+    request->type = SVC_REQUEST_NORMAL;
+    request->sender_invoke_id = 0xC1U;
+    request->db_request.logical_name.class_id = class_id;
+    request->db_request.logical_name.obis.A = 0U;
+    request->db_request.logical_name.obis.B = 0U;
+    request->db_request.logical_name.obis.C = c;
+    request->db_request.logical_name.obis.D = 0U;
+    request->db_request.logical_name.obis.E = 0U;
+    request->db_request.logical_name.obis.F = 0xFFU;
+    request->db_request.logical_name.id = id;
+    request->db_request.sel_access.enable = FALSE;
+    request->db_request.additional_data.enable = FALSE;
+}
+
+static int bench_request(bench_ctx *ctx)
+{
+    csm_array array;
+    csm_array reply;
+    int ret = -1;
+
+    csm_array_init(&array, ctx->apdu, BENCH_BUF_SIZE, 0U, 0U);
+    if (svc_request_encoder(&ctx->client_request, &array))
+    {
+        uint32_t exchanged = bench_exchange(ctx, array.wr_index, &reply);
+        if ((exchanged > 0U) && csm_client_decode(&ctx->client_response, &reply) && (ctx->client_response.access_result == CSM_ACCESS_RESULT_SUCCESS))
+        {
+            ret = (int)exchanged;
+        }
+    }
+    return ret;
+}
+
+static int bench_op_get_clock(bench_ctx *ctx)
+{
+    bench_set_object(&ctx->client_request, SVC_GET, 8U, 1U, 2);
+    return bench_request(ctx);
+}
+
+static int bench_op_get_profile(bench_ctx *ctx)
+{
+    bench_set_object(&ctx->client_request, SVC_GET, 7U, 99U, 2);
+    return bench_request(ctx);
+}
+
+static int bench_op_set_clock(bench_ctx *ctx)
+{
+    uint8_t data[2U + sizeof(cDateTime)];
+    csm_array array;
+
+    csm_array_init(&array, data, sizeof(data), 0U, 0U);
+    csm_axdr_wr_octetstring(&array, cDateTime, sizeof(cDateTime));
+
+    bench_set_object(&ctx->client_request, SVC_SET, 8U, 1U, 2);
+    ctx->client_request.db_request.additional_data.enable = TRUE;
+    ctx->client_request.db_request.additional_data.data = array;
+    return bench_request(ctx);
+}
+
+// Client side: decipher the glo-xxx-response of the server in place, the reply array is set on the plain APDU
+static int bench_decipher_reply(csm_array *reply)
+{
+    uint8_t *apdu = csm_array_rd_data(reply);
+    uint32_t size = csm_array_unread(reply);
+    uint8_t iv[12];
+    uint8_t aad[17];
+    uint8_t tag[16];
+
+    // The responses are short: tag || length (1 byte) || SC || IC || ciphered information || T
+    int valid = (size > (2U + CSM_DEF_SEC_HDR_SIZE + 12U)) && (apdu[0] == AXDR_GLO_SET_RESPONSE) && (apdu[1] == (size - 2U));
+
+    if (valid)
+    {
+        uint32_t information = size - 2U - CSM_DEF_SEC_HDR_SIZE - 12U;
+
+        memcpy(iv, csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE);
+        memcpy(&iv[CSM_DEF_APP_TITLE_SIZE], &apdu[3], 4U);
+        aad[0] = apdu[2];
+        memcpy(&aad[1], csm_sys_get_key(BENCH_SERVER_SAP, CSM_SEC_GAK), 16U);
+
+        valid = csm_sys_gcm_init(BENCH_CLIENT_GCM, BENCH_SERVER_SAP, CSM_SEC_GUEK, CSM_SEC_DECRYPT, iv, aad, sizeof(aad));
+        valid = valid && csm_sys_gcm_update(BENCH_CLIENT_GCM, &apdu[7], information, &apdu[7]);
+        valid = valid && csm_sys_gcm_finish(BENCH_CLIENT_GCM, tag);
+        valid = valid && (memcmp(tag, &apdu[7U + information], 12U) == 0);
+        if (valid)
+        {
+            csm_array_init(reply, &apdu[7], information, information, 0U);
+        }
+    }
+    return valid;
+}
+
+static int bench_op_set_clock_ciphered(bench_ctx *ctx)
+{
+    uint8_t plain[64];
+    uint8_t data[2U + sizeof(cDateTime)];
+    csm_array array;
+    csm_array reply;
+    int ret = -1;
+
+    csm_array_init(&array, data, sizeof(data), 0U, 0U);
+    csm_axdr_wr_octetstring(&array, cDateTime, sizeof(cDateTime));
+    bench_set_object(&ctx->client_request, SVC_SET, 8U, 1U, 2);
+    ctx->client_request.db_request.additional_data.enable = TRUE;
+    ctx->client_request.db_request.additional_data.data = array;
+
+    csm_array_init(&array, plain, sizeof(plain), 0U, 0U);
+    if (svc_request_encoder(&ctx->client_request, &array))
+    {
+        // glo-set-request: tag || length || SC || IC || ciphered information || T
+        uint32_t size = array.wr_index;
+        uint8_t iv[12];
+        uint8_t aad[17];
+        uint8_t tag[16];
+        csm_sec_control_byte sc;
+
+        sc.sh_byte = 0U;
+        sc.sh_bit_field.authentication = 1U;
+        sc.sh_bit_field.encryption = 1U;
+        ctx->client_ic++;
+
+        memcpy(iv, cClientTitle, CSM_DEF_APP_TITLE_SIZE);
+        PUT_BE32(&iv[CSM_DEF_APP_TITLE_SIZE], ctx->client_ic);
+        aad[0] = sc.sh_byte;
+        memcpy(&aad[1], csm_sys_get_key(BENCH_SERVER_SAP, CSM_SEC_GAK), 16U);
+
+        ctx->apdu[0] = AXDR_GLO_SET_REQUEST;
+        ctx->apdu[1] = (uint8_t)(CSM_DEF_SEC_HDR_SIZE + size + 12U);
+        ctx->apdu[2] = sc.sh_byte;
+        PUT_BE32(&ctx->apdu[3], ctx->client_ic);
+
+        int valid = csm_sys_gcm_init(BENCH_CLIENT_GCM, BENCH_SERVER_SAP, CSM_SEC_GUEK, CSM_SEC_ENCRYPT, iv, aad, sizeof(aad));
+        valid = valid && csm_sys_gcm_update(BENCH_CLIENT_GCM, plain, size, &ctx->apdu[7]);
+        valid = valid && csm_sys_gcm_finish(BENCH_CLIENT_GCM, tag);
+
+        if (valid)
+        {
+            memcpy(&ctx->apdu[7U + size], tag, 12U);
+
+            uint32_t exchanged = bench_exchange(ctx, 7U + size + 12U, &reply);
+            if ((exchanged > 0U) && bench_decipher_reply(&reply) && csm_client_decode(&ctx->client_response, &reply) && (ctx->client_response.access_result == CSM_ACCESS_RESULT_SUCCESS))
+            {
+                ret = (int)exchanged;
+            }
+        }
+    }
+    return ret;
+}
+
+typedef struct
+{
+    const char *name;
+    bench_op op;
+    int associated;     //!< The scenario runs within an open association
+} bench_scenario;
+
+static const bench_scenario cScenarios[] =
+{
+    { "aarq-rlrq",          bench_op_aarq_rlrq,             FALSE },
+    { "get-normal",         bench_op_get_clock,             TRUE },
+    { "get-profile",        bench_op_get_profile,           TRUE },
+    { "set-normal",         bench_op_set_clock,             TRUE },
+    { "set-ciphered",       bench_op_set_clock_ciphered,    TRUE },
+};
+
+#define BENCH_NB_SCENARIOS  (sizeof(cScenarios)/sizeof(cScenarios[0]))
+
+static void bench_ctx_init(bench_ctx *ctx, enum bench_transport transport)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->transport = transport;
+
+    csm_channel_init(channels, 1U, assos, &cAssoConf, 1U);
+    memset(security, 0, sizeof(security));
+    csm_channel_set_security(security);
+    ctx->channel = csm_channel_new() - 1U;
+    channels[ctx->channel].llc.ssap = BENCH_CLIENT_SAP;
+    channels[ctx->channel].llc.dsap = BENCH_SERVER_SAP;
+
+    hdlc_init(&ctx->client_hdlc);
+    ctx->client_hdlc.sender = HDLC_CLIENT;
+    ctx->client_hdlc.client_addr = BENCH_CLIENT_SAP;
+    ctx->client_hdlc.logical_device = BENCH_SERVER_SAP;
+    ctx->client_hdlc.phy_address = 0x11U;
+
+    hdlc_init(&ctx->server_hdlc);
+    ctx->server_hdlc.sender = HDLC_SERVER;
+    ctx->server_hdlc.client_addr = BENCH_CLIENT_SAP;
+    ctx->server_hdlc.logical_device = BENCH_SERVER_SAP;
+    ctx->server_hdlc.phy_address = 0x11U;
+}
+
+static void bench_run_scenario(bench_ctx *ctx, const bench_scenario *scenario, uint64_t iterations, bench_result *result)
+{
+    uint64_t warmup = (iterations / 100U) + 1U;
+
+    if (scenario->associated && (bench_op_associate(ctx) < 0))
+    {
+        result->errors++;
+        return;
+    }
+
+    for (uint64_t i = 0U; i < warmup; i++)
+    {
+        (void) scenario->op(ctx);
+    }
+
+    int64_t heap = bench_heap_usage();
+    uint64_t allocations = bench_allocations();
+    uint64_t start = bench_now_ns();
+    uint64_t start_cycles = bench_cycles();
+
+    for (uint64_t i = 0U; i < iterations; i++)
+    {
+        int exchanged = scenario->op(ctx);
+        if (exchanged > 0)
+        {
+            result->bytes += (uint64_t)exchanged;
+        }
+        else
+        {
+            result->errors++;
+        }
+    }
+
+    result->cycles = bench_cycles() - start_cycles;
+    result->total_ns = bench_now_ns() - start;
+    result->allocations = bench_allocations() - allocations;
+    result->heap_growth = bench_heap_usage() - heap;
+    result->iterations = iterations;
+    result->runs = 1U;
+
+    if (scenario->associated)
+    {
+        (void) bench_op_release(ctx);
+    }
+}
+
+int bench_loopback_run(const bench_options *options, bench_report *report)
+{
+    int ret = TRUE;
+
+    host_hal_init();
+    csm_services_init(bench_db_access);
+
+    for (uint32_t t = 0U; t < BENCH_NB_TRANSPORTS; t++)
+    {
+        for (uint32_t s = 0U; s < BENCH_NB_SCENARIOS; s++)
+        {
+            if (bench_is_selected(options, cScenarios[s].name, cTransportNames[t]))
+            {
+                bench_result *result = bench_report_add(report, cScenarios[s].name, cTransportNames[t]);
+                if (result != NULL)
+                {
+                    bench_ctx_init(&context, (enum bench_transport)t);
+                    bench_run_scenario(&context, &cScenarios[s], options->iterations, result);
+                    if (result->errors > 0U)
+                    {
+                        ret = FALSE;
+                    }
+                }
+            }
+        }
+    }
+    return ret;
+}
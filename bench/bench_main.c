@@ -0,0 +1,121 @@
+/**
+ * Benchmark entry point
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "csm_config.h"
+
+static bench_report report;
+
+static void bench_usage(const char *name)
+{
+    printf("Usage: %s [-S loopback|micro] [-n iterations] [-s scenario] [-v variant] [-o results.json]\r\n", name);
+    printf("          [-c cpu] [-w warmup] [-r runs] [-b baseline.json] [-t threshold_pct]\r\n");
+}
+
+int main(int argc, char **argv)
+{
+    bench_options options;
+    const char *json_file = NULL;
+    const char *baseline_file = NULL;
+    const char *suite = NULL;
+    double threshold = 5.0;
+    int cpu = -1;
+    int opt;
+
+    options.iterations = 100000U;
+    options.scenario = NULL;
+    options.variant = NULL;
+    options.warmup = 0U;
+    options.runs = 10U;
+
+    while ((opt = getopt(argc, argv, "S:n:s:v:o:c:w:r:b:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'S':
+            suite = optarg;
+            break;
+        case 'n':
+            options.iterations = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            options.scenario = optarg;
+            break;
+        case 'v':
+            options.variant = optarg;
+            break;
+        case 'o':
+            json_file = optarg;
+            break;
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        case 'w':
+            options.warmup = strtoull(optarg, NULL, 10);
+            break;
+        case 'r':
+            options.runs = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            baseline_file = optarg;
+            break;
+        case 't':
+            threshold = strtod(optarg, NULL);
+            break;
+        default:
+            bench_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((cpu >= 0) && !bench_pin_cpu(cpu))
+    {
+        printf("Cannot pin to CPU %d\r\n", cpu);
+    }
+
+    int valid = TRUE;
+
+    if ((suite == NULL) || (strcmp(suite, "loopback") == 0))
+    {
+        valid = bench_loopback_run(&options, &report) && valid;
+    }
+    if ((suite == NULL) || (strcmp(suite, "micro") == 0))
+    {
+        valid = bench_micro_run(&options, &report) && valid;
+    }
+
+    bench_report_print(&report);
+
+    if (baseline_file != NULL)
+    {
+        if (!bench_report_compare(&report, baseline_file, threshold))
+        {
+            printf("Regression against %s\r\n", baseline_file);
+            valid = FALSE;
+        }
+    }
+
+    if (json_file != NULL)
+    {
+        if (!bench_report_write_json(&report, json_file))
+        {
+            printf("Cannot write %s\r\n", json_file);
+            valid = FALSE;
+        }
+    }
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,606 @@
+/**
+ * Microbenchmarks of the codec primitives
+ *
+ * Each kernel processes one reference vector and returns its size, so the report gives both the
+ * cost per operation and per byte.
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "bench.h"
+#include "csm_array.h"
+#include "csm_ber.h"
+#include "csm_axdr_codec.h"
+#include "hdlc.h"
+#include "clock.h"
+#include "os_util.h"
+#include "calendar.h"
+#include "timeseries.h"
+#include "csm_ingest.h"
+#include "csm_translate.h"
+#include "csm_columnar.h"
+
+#define MICRO_BUF_SIZE          2048U
+#define MICRO_PROFILE_ENTRIES   32U
+#define MICRO_FCS_SIZE          256U
+#define MICRO_IFRAME_SIZE       128U
+#define MICRO_STAMPS            1024U
+#define MICRO_JOBS              1024U
+#define MICRO_CAL_BUCKETS       256U
+#define MICRO_TS_ROWS           35040U  //!< One year of 15 minutes periods
+#define MICRO_TS_BLOCKS         128U
+#define MICRO_INGEST_APDUS      512U    //!< One profile buffer for three register values
+#define MICRO_INGEST_ENTRIES    96U     //!< One day of load profile per meter
+#define MICRO_INGEST_ROWS       25000U  //!< Per batch, enough for the whole set
+#define MICRO_INGEST_WORKERS    4U
+#define MICRO_TEXT_SIZE         (64U * 1024U)
+#define MICRO_TEXT_NODES        1024U
+#define MICRO_ARENA_SIZE        (16U * 1024U)
+
+// SNRM with parameter negotiation, see hdlc.c
+static const uint8_t cSnrm[] = {
+    0x7EU, 0xA0U, 0x21U, 0x00U, 0x02U, 0x00U, 0x23U, 0x21U, 0x93U, 0x19U, 0x64U, 0x81U, 0x80U, 0x12U, 0x05U, 0x01U,
+    0x80U, 0x06U, 0x01U, 0x80U, 0x07U, 0x04U, 0x00U, 0x00U, 0x00U, 0x01U, 0x08U, 0x04U, 0x00U, 0x00U, 0x00U, 0x07U,
+    0x65U, 0x5EU, 0x7EU
+};
+
+// AARQ, LN referencing, no security
+static const uint8_t cAarq[] = {
+    0x60U, 0x1DU, 0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U, 0xBEU, 0x10U, 0x04U,
+    0x0EU, 0x01U, 0x00U, 0x00U, 0x00U, 0x06U, 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x7EU, 0x1FU, 0x04U, 0xB0U
+};
+
+static const uint8_t cDateTime[12] = { 0x07U, 0xE0U, 0x0BU, 0x03U, 0x04U, 0x0CU, 0x1EU, 0x00U, 0xFFU, 0xFFU, 0xC4U, 0x00U };
+
+typedef struct
+{
+    uint8_t buffer[MICRO_BUF_SIZE];
+    uint8_t profile[MICRO_BUF_SIZE];    //!< A-XDR array of (date-time, energy) structures
+    uint32_t profile_size;
+    uint8_t payload[MICRO_FCS_SIZE];
+    uint32_t tags;                      //!< Defeats the dead code elimination of the decoders
+    hdlc_t hdlc;
+    uint8_t stamps[MICRO_STAMPS * CLK_COSEM_DATETIME_SIZE];    //!< Packed date-times, 15 minutes apart
+    uint32_t epochs[MICRO_STAMPS];
+    uint8_t match[MICRO_STAMPS];
+    char hex[HEX_DUMP_SIZE(MICRO_FCS_SIZE)];
+    cal_queue calendar;
+    cal_bucket buckets[MICRO_CAL_BUCKETS];
+    uint64_t bucket_map[CAL_MAP_WORDS(MICRO_CAL_BUCKETS)];
+    cal_node jobs[MICRO_JOBS];
+    ts_store series;                    //!< One year of energy index
+    ts_block blocks[MICRO_TS_BLOCKS];
+    ts_store day;
+    ts_block day_blocks[1];
+    uint8_t ingest_register[32];        //!< GET.response-with-list: value and scaler_unit of a register
+    uint32_t ingest_register_size;
+    uint8_t ingest_profile[MICRO_INGEST_ENTRIES * 32U];  //!< GET.response of (date-time, energy, power) entries
+    uint32_t ingest_profile_size;
+    csm_ingest_item ingest_items[MICRO_INGEST_APDUS];
+    uint32_t ingest_bytes;
+    csm_ingest_columns ingest_cols[MICRO_INGEST_WORKERS];
+    uint32_t cols_meter[MICRO_INGEST_WORKERS][MICRO_INGEST_ROWS];
+    uint32_t cols_time[MICRO_INGEST_WORKERS][MICRO_INGEST_ROWS];
+    int64_t cols_value[MICRO_INGEST_WORKERS][MICRO_INGEST_ROWS];
+    int8_t cols_scaler[MICRO_INGEST_WORKERS][MICRO_INGEST_ROWS];
+    uint8_t cols_unit[MICRO_INGEST_WORKERS][MICRO_INGEST_ROWS];
+    char text[MICRO_TEXT_SIZE];         //!< Translation of the ingest profile APDU
+    char xml[MICRO_TEXT_SIZE];
+    uint32_t xml_size;
+    csm_text_node nodes[MICRO_TEXT_NODES];
+    csm_col_schema export_schema;       //!< Clock, energy and power of the ingest profile
+    csm_col_batch export_batch;
+    uint64_t arena[MICRO_ARENA_SIZE / 8U];   //!< 8 bytes aligned as required by Arrow
+} micro_ctx;
+
+static micro_ctx context;
+
+// Created at the first use, the threads live until the end of the process
+static wp_pool ingest_pools[2];
+static int ingest_pools_ready[2];
+
+static void micro_tag_cb(uint8_t type, uint32_t size, uint8_t *data)
+{
+    (void) data;
+    context.tags += type + size;
+}
+
+// ----------------------------------- KERNELS -----------------------------------
+
+// One 64-byte record mixing all the writers
+static int micro_array_write(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    csm_array array;
+    csm_array_init(&array, c->buffer, MICRO_BUF_SIZE, 0U, 0U);
+
+    int valid = TRUE;
+    for (uint32_t i = 0U; i < 4U; i++)
+    {
+        valid = valid && csm_array_write_u8(&array, (uint8_t)i);
+        valid = valid && csm_array_write_u16(&array, (uint16_t)(i * 3U));
+        valid = valid && csm_array_write_u32(&array, i * 7U);
+        valid = valid && csm_array_write_buff(&array, cDateTime, 9U);
+    }
+    return valid ? (int)csm_array_written(&array) : -1;
+}
+
+// Walk all the BER tags of the AARQ, entering the constructed ones
+static int micro_ber_decode(void *ctx)
+{
+    (void) ctx;
+    csm_array array;
+    csm_ber ber;
+    int valid = TRUE;
+
+    csm_array_init(&array, (uint8_t *)cAarq, sizeof(cAarq), sizeof(cAarq), 0U);
+
+    while (valid && (csm_array_unread(&array) > 0U))
+    {
+        valid = csm_ber_decode(&ber, &array);
+        if (valid && ber.tag.isPrimitive)
+        {
+            valid = csm_array_reader_jump(&array, ber.length.length);
+        }
+    }
+    return valid ? (int)sizeof(cAarq) : -1;
+}
+
+static int micro_axdr_decode_tags(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    csm_array array;
+
+    csm_array_init(&array, c->profile, c->profile_size, c->profile_size, 0U);
+    (void) csm_axdr_decode_tags(&array, micro_tag_cb);
+    return (csm_array_unread(&array) == 0U) ? (int)c->profile_size : -1;
+}
+
+static int micro_hdlc_decode(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    c->hdlc.sender = HDLC_CLIENT;
+    return (hdlc_decode(&c->hdlc, cSnrm, sizeof(cSnrm)) == HDLC_OK) ? (int)sizeof(cSnrm) : -1;
+}
+
+static int micro_hdlc_encode(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    c->hdlc.sender = HDLC_SERVER;
+    return hdlc_encode_data(&c->hdlc, c->buffer, MICRO_BUF_SIZE, c->payload, MICRO_IFRAME_SIZE);
+}
+
+static int micro_fcs16(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    c->tags += pppfcs16(0xFFFFU, c->payload, MICRO_FCS_SIZE);
+    return (int)MICRO_FCS_SIZE;
+}
+
+static int micro_clk_from_cosem(void *ctx)
+{
+    (void) ctx;
+    csm_array array;
+    clk_datetime_t clk;
+
+    csm_array_init(&array, (uint8_t *)cDateTime, sizeof(cDateTime), sizeof(cDateTime), 0U);
+    return clk_datetime_from_cosem(&clk, &array) ? (int)sizeof(cDateTime) : -1;
+}
+
+// Reference for the batch: one date-time at a time through clk_datetime_from_cosem() and clk_to_epoch()
+static int micro_epoch_scalar(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    csm_array array;
+    clk_datetime_t clk;
+    struct tm tms;
+    int valid = TRUE;
+
+    csm_array_init(&array, c->stamps, sizeof(c->stamps), sizeof(c->stamps), 0U);
+    for (uint32_t i = 0U; (i < MICRO_STAMPS) && valid; i++)
+    {
+        valid = clk_datetime_from_cosem(&clk, &array);
+        memset(&tms, 0, sizeof(tms));
+        tms.tm_year = clk.date.year - 1900;
+        tms.tm_mon = clk.date.month - 1;
+        tms.tm_mday = clk.date.day;
+        tms.tm_hour = clk.time.hour;
+        tms.tm_min = clk.time.minute;
+        tms.tm_sec = clk.time.second;
+        c->epochs[i] = clk_to_epoch(&tms);
+    }
+    return valid ? (int)sizeof(c->stamps) : -1;
+}
+
+static int micro_epoch_batch(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    uint32_t nb = clk_cosem_to_epoch_batch(c->stamps, CLK_COSEM_DATETIME_SIZE, MICRO_STAMPS, c->epochs);
+    return (nb == MICRO_STAMPS) ? (int)sizeof(c->stamps) : -1;
+}
+
+// Keep one day out of the ~10 days of stamps, as a range_descriptor selective access would
+static int micro_range_filter(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    uint64_t from = clk_epoch_key(1483228800U + (4U * 86400U));
+    uint64_t to = clk_epoch_key(1483228800U + (5U * 86400U) - 1U);
+
+    uint32_t nb = clk_cosem_filter_range(c->stamps, CLK_COSEM_DATETIME_SIZE, MICRO_STAMPS, from, to, c->match);
+    return (nb == 96U) ? (int)sizeof(c->stamps) : -1;
+}
+
+static int micro_hex_encode(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    (void) hex_encode(c->payload, MICRO_FCS_SIZE, c->hex);
+    return (int)MICRO_FCS_SIZE;
+}
+
+static int micro_hex_decode(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    return (hex_decode(c->hex, 2U * MICRO_FCS_SIZE, c->buffer) == (int)MICRO_FCS_SIZE) ? (int)MICRO_FCS_SIZE : -1;
+}
+
+// Trace format of a frame: "7E:A0:..."
+static int micro_hex_dump(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    size_t len = hex_dump(c->payload, MICRO_FCS_SIZE, ':', c->hex, sizeof(c->hex));
+    return (len == ((3U * MICRO_FCS_SIZE) - 1U)) ? (int)MICRO_FCS_SIZE : -1;
+}
+
+// Schedule the jobs of 1024 devices jittered over one hour, then pop them second by second
+static int micro_cal_schedule(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    const uint32_t start = 1483228800U;
+    uint32_t nb = 0U;
+
+    (void) cal_init(&c->calendar, c->buckets, c->bucket_map, MICRO_CAL_BUCKETS, c->jobs, MICRO_JOBS, 4U, start);
+    for (uint32_t i = 0U; i < MICRO_JOBS; i++)
+    {
+        (void) cal_insert(&c->calendar, i, start + cal_jitter_offset((const uint8_t *)&i, sizeof(i), 3600U));
+    }
+    for (uint32_t t = start; t < (start + 3600U); t++)
+    {
+        while (cal_pop(&c->calendar, t) != CAL_NONE)
+        {
+            nb++;
+        }
+    }
+    return (nb == MICRO_JOBS) ? (int)MICRO_JOBS : -1;
+}
+
+static uint32_t micro_energy(uint32_t period)
+{
+    return 100000U + (period * 7U) + (period % 3U);
+}
+
+// Capture of one day of load profile in the compressed store
+static int micro_ts_append(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    int valid = ts_init(&c->day, c->day_blocks, 1U, 1U);
+
+    for (uint32_t i = 0U; valid && (i < 96U); i++)
+    {
+        uint32_t value = micro_energy(i);
+        valid = ts_append(&c->day, 1483228800U + (i * 900U), &value);
+    }
+    return valid ? (int)ts_size(&c->day) : -1;
+}
+
+// GET of one day of a year of profile: blocks out of range skipped, rows decoded to A-XDR
+static int micro_ts_axdr(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    csm_array array;
+    uint64_t from = clk_epoch_key(1483228800U + (200U * 86400U));
+    uint64_t to = clk_epoch_key(1483228800U + (201U * 86400U) - 1U);
+
+    csm_array_init(&array, c->buffer, MICRO_BUF_SIZE, 0U, 0U);
+    int valid = ts_write_axdr(&c->series, &array, from, to);
+    return valid ? (int)csm_array_written(&array) : -1;
+}
+
+// Rows expected from the whole set of APDUs
+static uint32_t micro_ingest_rows(void)
+{
+    return ((MICRO_INGEST_APDUS / 4U) * MICRO_INGEST_ENTRIES * 2U) + ((MICRO_INGEST_APDUS * 3U) / 4U);
+}
+
+static int micro_ingest_serial(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    csm_ingest_columns_reset(&c->ingest_cols[0]);
+    for (uint32_t i = 0U; i < MICRO_INGEST_APDUS; i++)
+    {
+        (void) csm_ingest_decode(&c->ingest_cols[0], &c->ingest_items[i]);
+    }
+    return (c->ingest_cols[0].rows == micro_ingest_rows()) ? (int)c->ingest_bytes : -1;
+}
+
+static int micro_ingest_pool(micro_ctx *c, uint32_t pool, uint32_t nb_workers)
+{
+    uint32_t rows = 0U;
+    int valid = TRUE;
+
+    if (!ingest_pools_ready[pool])
+    {
+        ingest_pools_ready[pool] = wp_init(&ingest_pools[pool], nb_workers);
+    }
+    for (uint32_t i = 0U; i < nb_workers; i++)
+    {
+        csm_ingest_columns_reset(&c->ingest_cols[i]);
+    }
+    valid = ingest_pools_ready[pool] && csm_ingest_run(&ingest_pools[pool], c->ingest_items, MICRO_INGEST_APDUS, c->ingest_cols);
+    for (uint32_t i = 0U; i < nb_workers; i++)
+    {
+        rows += c->ingest_cols[i].rows;
+    }
+    return (valid && (rows == micro_ingest_rows())) ? (int)c->ingest_bytes : -1;
+}
+
+static int micro_ingest_pool2(void *ctx)
+{
+    return micro_ingest_pool((micro_ctx *)ctx, 0U, 2U);
+}
+
+static int micro_ingest_pool4(void *ctx)
+{
+    return micro_ingest_pool((micro_ctx *)ctx, 1U, MICRO_INGEST_WORKERS);
+}
+
+static int micro_translate(micro_ctx *c, enum csm_text_format format)
+{
+    csm_text text;
+
+    csm_text_init(&text, c->text, MICRO_TEXT_SIZE, NULL);
+    int valid = csm_translate_to_text(&text, format, c->ingest_profile, c->ingest_profile_size);
+    return valid ? (int)c->ingest_profile_size : -1;
+}
+
+static int micro_translate_xml(void *ctx)
+{
+    return micro_translate((micro_ctx *)ctx, CSM_TEXT_XML);
+}
+
+static int micro_translate_json(void *ctx)
+{
+    return micro_translate((micro_ctx *)ctx, CSM_TEXT_JSON);
+}
+
+// XML back to the binary APDU, larger than the scratch buffer
+static int micro_translate_back(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    csm_text_tree tree;
+    csm_array array;
+    uint32_t pos = 0U;
+
+    tree.nodes = c->nodes;
+    tree.capacity = MICRO_TEXT_NODES;
+    csm_array_init(&array, (uint8_t *)c->text, MICRO_TEXT_SIZE, 0U, 0U);
+    int size = csm_translate_from_text(c->xml, c->xml_size, &pos, &tree, &array);
+    return ((uint32_t)size == c->ingest_profile_size) ? (int)c->xml_size : -1;
+}
+
+// Rows of the profile APDU: the ingest decoder against the Arrow columns
+static int micro_export_rows(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+
+    csm_ingest_columns_reset(&c->ingest_cols[0]);
+    int valid = csm_ingest_decode(&c->ingest_cols[0], &c->ingest_items[0]);
+    return valid ? (int)c->ingest_profile_size : -1;
+}
+
+static int micro_export_arrow(void *ctx)
+{
+    micro_ctx *c = (micro_ctx *)ctx;
+    struct ArrowSchema schema;
+    struct ArrowArray array;
+
+    // Data of the GET.response-normal
+    csm_col_batch_reset(&c->export_batch);
+    int valid = csm_col_decode(&c->export_batch, &c->ingest_profile[4], c->ingest_profile_size - 4U);
+    csm_col_export(&c->export_batch, &schema, &array);
+    valid = valid && (array.length == MICRO_INGEST_ENTRIES) && (array.children[0]->null_count == 0);
+    array.release(&array);
+    schema.release(&schema);
+    return valid ? (int)c->ingest_profile_size : -1;
+}
+
+typedef struct
+{
+    const char *name;
+    const char *module;     //!< Reported as the variant, allows to select a whole module
+    bench_kernel kernel;
+} micro_scenario;
+
+static const micro_scenario cMicroScenarios[] =
+{
+    { "write-mix",      "array",    micro_array_write },
+    { "ber-decode",     "ber",      micro_ber_decode },
+    { "decode-tags",    "axdr",     micro_axdr_decode_tags },
+    { "decode-snrm",    "hdlc",     micro_hdlc_decode },
+    { "encode-iframe",  "hdlc",     micro_hdlc_encode },
+    { "fcs16",          "hdlc",     micro_fcs16 },
+    { "datetime-from",  "clock",    micro_clk_from_cosem },
+    { "epoch-scalar",   "clock",    micro_epoch_scalar },
+    { "epoch-batch",    "clock",    micro_epoch_batch },
+    { "range-filter",   "clock",    micro_range_filter },
+    { "hex-encode",     "hex",      micro_hex_encode },
+    { "hex-decode",     "hex",      micro_hex_decode },
+    { "hex-dump",       "hex",      micro_hex_dump },
+    { "schedule",       "calendar", micro_cal_schedule },
+    { "ts-append",      "series",   micro_ts_append },
+    { "ts-axdr",        "series",   micro_ts_axdr },
+    { "ingest-serial",  "ingest",   micro_ingest_serial },
+    { "ingest-pool2",   "ingest",   micro_ingest_pool2 },
+    { "ingest-pool4",   "ingest",   micro_ingest_pool4 },
+    { "translate-xml",  "translate", micro_translate_xml },
+    { "translate-json", "translate", micro_translate_json },
+    { "translate-back", "translate", micro_translate_back },
+    { "export-rows",    "export",   micro_export_rows },
+    { "export-arrow",   "export",   micro_export_arrow },
+};
+
+#define MICRO_NB_SCENARIOS  (sizeof(cMicroScenarios)/sizeof(cMicroScenarios[0]))
+
+static void micro_ingest_init(micro_ctx *ctx)
+{
+    static const uint8_t cRegister[] = {
+        0xC4U, 0x03U, 0xC1U, 0x02U,
+        0x00U, 0x06U, 0x00U, 0x01U, 0xE2U, 0x40U,                       // Data: double-long-unsigned
+        0x00U, 0x02U, 0x02U, 0x0FU, 0xFDU, 0x16U, 0x1EU                 // Data: scaler_unit {-3, Wh}
+    };
+    csm_array array;
+    int valid = TRUE;
+
+    memcpy(ctx->ingest_register, cRegister, sizeof(cRegister));
+    ctx->ingest_register_size = sizeof(cRegister);
+
+    csm_array_init(&array, ctx->ingest_profile, sizeof(ctx->ingest_profile), 0U, 0U);
+    valid = valid && csm_array_write_u8(&array, 0xC4U);    // GET.response-normal, Data
+    valid = valid && csm_array_write_u8(&array, 0x01U);
+    valid = valid && csm_array_write_u8(&array, 0xC1U);
+    valid = valid && csm_array_write_u8(&array, 0x00U);
+    valid = valid && csm_array_write_u8(&array, AXDR_TAG_ARRAY);
+    valid = valid && csm_array_write_u8(&array, MICRO_INGEST_ENTRIES);
+    for (uint32_t i = 0U; i < MICRO_INGEST_ENTRIES; i++)
+    {
+        valid = valid && csm_array_write_u8(&array, AXDR_TAG_STRUCTURE);
+        valid = valid && csm_array_write_u8(&array, 3U);
+        valid = valid && csm_axdr_wr_octetstring(&array, &ctx->stamps[i * CLK_COSEM_DATETIME_SIZE], CLK_COSEM_DATETIME_SIZE);
+        valid = valid && csm_axdr_wr_u32(&array, micro_energy(i));
+        valid = valid && csm_array_write_u8(&array, AXDR_TAG_INTEGER16);
+        valid = valid && csm_array_write_u16(&array, (uint16_t)(i * 13U));
+    }
+    ctx->ingest_profile_size = valid ? csm_array_written(&array) : 0U;
+
+    for (uint32_t i = 0U; i < MICRO_INGEST_APDUS; i++)
+    {
+        int profile = ((i % 4U) == 0U);
+        ctx->ingest_items[i].meter_id = i;
+        ctx->ingest_items[i].apdu = profile ? ctx->ingest_profile : ctx->ingest_register;
+        ctx->ingest_items[i].size = profile ? ctx->ingest_profile_size : ctx->ingest_register_size;
+        ctx->ingest_bytes += ctx->ingest_items[i].size;
+    }
+    for (uint32_t i = 0U; i < MICRO_INGEST_WORKERS; i++)
+    {
+        csm_ingest_columns_init(&ctx->ingest_cols[i], MICRO_INGEST_ROWS, ctx->cols_meter[i], ctx->cols_time[i],
+                                ctx->cols_value[i], ctx->cols_scaler[i], ctx->cols_unit[i]);
+    }
+}
+
+static void micro_translate_init(micro_ctx *ctx)
+{
+    csm_text text;
+
+    csm_text_init(&text, ctx->xml, MICRO_TEXT_SIZE, NULL);
+    (void) csm_translate_to_text(&text, CSM_TEXT_XML, ctx->ingest_profile, ctx->ingest_profile_size);
+    ctx->xml_size = text.size;
+}
+
+static void micro_export_init(micro_ctx *ctx)
+{
+    static const uint8_t cCaptureObjects[] = {
+        0x01U, 0x03U,
+        0x02U, 0x04U, 0x12U, 0x00U, 0x08U, 0x09U, 0x06U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U,
+        0x02U, 0x04U, 0x12U, 0x00U, 0x03U, 0x09U, 0x06U, 0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U,
+        0x02U, 0x04U, 0x12U, 0x00U, 0x03U, 0x09U, 0x06U, 0x01U, 0x00U, 0x01U, 0x07U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U
+    };
+
+    (void) csm_col_schema_init(&ctx->export_schema, cCaptureObjects, sizeof(cCaptureObjects));
+    csm_col_batch_init(&ctx->export_batch, &ctx->export_schema, (uint8_t *)ctx->arena, MICRO_ARENA_SIZE, MICRO_INGEST_ENTRIES, 0U);
+}
+
+static void micro_ctx_init(micro_ctx *ctx)
+{
+    csm_array array;
+    int valid = TRUE;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    for (uint32_t i = 0U; i < MICRO_FCS_SIZE; i++)
+    {
+        ctx->payload[i] = (uint8_t)(i * 31U);
+    }
+
+    // Load profile buffer, as returned by a GET on attribute 2
+    csm_array_init(&array, ctx->profile, MICRO_BUF_SIZE, 0U, 0U);
+    valid = valid && csm_array_write_u8(&array, AXDR_TAG_ARRAY);
+    valid = valid && csm_array_write_u8(&array, MICRO_PROFILE_ENTRIES);
+    for (uint32_t i = 0U; i < MICRO_PROFILE_ENTRIES; i++)
+    {
+        valid = valid && csm_array_write_u8(&array, AXDR_TAG_STRUCTURE);
+        valid = valid && csm_array_write_u8(&array, 2U);
+        valid = valid && csm_axdr_wr_octetstring(&array, cDateTime, sizeof(cDateTime));
+        valid = valid && csm_axdr_wr_u32(&array, 1000U + i);
+    }
+    ctx->profile_size = valid ? csm_array_written(&array) : 0U;
+
+    for (uint32_t i = 0U; i < MICRO_STAMPS; i++)
+    {
+        ctx->epochs[i] = 1483228800U + (i * 900U); // From 2017-01-01
+    }
+    clk_epoch_to_cosem_batch(ctx->epochs, MICRO_STAMPS, ctx->stamps, CLK_COSEM_DATETIME_SIZE, -60, 0U);
+    (void) hex_encode(ctx->payload, MICRO_FCS_SIZE, ctx->hex);
+
+    (void) ts_init(&ctx->series, ctx->blocks, MICRO_TS_BLOCKS, 1U);
+    for (uint32_t i = 0U; i < MICRO_TS_ROWS; i++)
+    {
+        uint32_t value = micro_energy(i);
+        (void) ts_append(&ctx->series, 1483228800U + (i * 900U), &value);
+    }
+
+    micro_ingest_init(ctx);
+    micro_translate_init(ctx);
+    micro_export_init(ctx);
+
+    hdlc_init(&ctx->hdlc);
+    ctx->hdlc.client_addr = 0x10U;
+    ctx->hdlc.logical_device = 0x01U;
+    ctx->hdlc.phy_address = 0x11U;
+}
+
+int bench_micro_run(const bench_options *options, bench_report *report)
+{
+    int ret = TRUE;
+
+    for (uint32_t s = 0U; s < MICRO_NB_SCENARIOS; s++)
+    {
+        if (bench_is_selected(options, cMicroScenarios[s].name, cMicroScenarios[s].module))
+        {
+            bench_result *result = bench_report_add(report, cMicroScenarios[s].name, cMicroScenarios[s].module);
+            if (result != NULL)
+            {
+                micro_ctx_init(&context);
+                bench_measure(result, cMicroScenarios[s].kernel, &context, options);
+                if (result->errors > 0U)
+                {
+                    ret = FALSE;
+                }
+            }
+        }
+    }
+    return ret;
+}
@@ -5,6 +5,7 @@
 
 #include "hdlc.h"
 #include "os_util.h"
+#include "csm_metrics.h"
 
 #ifndef BIT
 #define BIT(x) (1U << (x))
@@ -104,7 +105,7 @@ uint16_t pppfcs16(uint16_t fcs, const uint8_t* cp, uint32_t len)
 
 // MASKS
 #define HDLC_FORMAT_TYPE	(0xA0)
-#define HDLC_LEN_HI         (0x03)
+#define HDLC_LEN_HI         (0x07)
 
 // BITS
 #define HDLC_SEGMENTATION_BIT	(3)
@@ -112,7 +113,7 @@ uint16_t pppfcs16(uint16_t fcs, const uint8_t* cp, uint32_t len)
 
 static uint16_t hdlc_get_len(const uint8_t *buf)
 {
-	uint16_t len = (buf[0] & HDLC_LEN_HI) << 11;
+	uint16_t len = (buf[0] & HDLC_LEN_HI) << 8;
 	return (len + buf[1]);
 }
 
@@ -754,6 +755,19 @@ int hdlc_decode(hdlc_t *hdlc, const uint8_t *buf, uint16_t size)
 	{
 		ret = HDLC_ERR_7E;
 	}
+
+	if (ret == HDLC_OK)
+	{
+		CSM_METRICS_INC(CSM_METRIC_HDLC_FRAMES);
+	}
+	else if (ret == HDLC_ERR_FCS)
+	{
+		CSM_METRICS_INC(CSM_METRIC_HDLC_FCS_ERROR);
+	}
+	else if (ret == HDLC_ERR_HCS)
+	{
+		CSM_METRICS_INC(CSM_METRIC_HDLC_HCS_ERROR);
+	}
 	return ret;
 }
 
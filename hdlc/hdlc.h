@@ -81,6 +81,9 @@ int hdlc_encode(hdlc_t *hdlc, uint8_t *buf, uint16_t size, uint8_t frame_type, c
 int hdlc_decode(hdlc_t *hdlc, const uint8_t *buf, uint16_t size);
 void hdlc_print_result(hdlc_t *hdlc, int code);
 
+// PPP 16-bit frame check sequence (RFC 1662), start with 0xFFFF
+uint16_t pppfcs16(uint16_t fcs, const uint8_t *cp, uint32_t len);
+
 //void hdlc_init(hdlc_channel *chan);
 //int hdlc_handle(hdlc_channel *chan, uint8_t *data, uint16_t size);
 
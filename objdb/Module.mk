@@ -0,0 +1,3 @@
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), objdb_main.c)
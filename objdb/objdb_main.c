@@ -0,0 +1,576 @@
+/**
+ * Object database compiler: text object model to a read-only image (see csm_objdb.h)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ * Model syntax, one statement per line, '#' starts a comment:
+ *
+ *     clients <sap> [<sap>...]                          access right bits, in this order
+ *     object <class_id> <A.B.C.D.E.F> [version=<n>]
+ *     attr <id> [read=<saps>] [write=<saps>] [handler=<n>] [value=<type>:<value>]
+ *     method <id> [exec=<saps>] [handler=<n>]
+ *
+ * <saps> is a comma separated list of client SAPs or "all". A member with a value is static, served
+ * from the image; the others go to the database handler of index <n> (0 by default). The logical name
+ * (attribute 1) is generated if not declared, readable by all the clients.
+ *
+ * Value types: u8, u16, u32, i8, i16, i32, enum, bool, string (visible-string), octets (hex),
+ * su:<scaler>,<unit> (scaler_unit structure), raw (A-XDR in hex).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csm_objdb.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+
+#define OBJDB_MAX_OBJECTS   4096U
+#define OBJDB_MAX_MEMBERS   32768U
+#define OBJDB_MAX_VALUES    (1024U * 1024U)
+#define OBJDB_LINE_SIZE     1024U
+#define OBJDB_MAX_TOKENS    16U
+
+typedef struct
+{
+    csm_objdb_member rec;
+    uint32_t object;        //!< Index in the declaration order
+    uint8_t is_method;
+} objdb_tmp_member;
+
+static csm_objdb_header header;
+static csm_objdb_object objects[OBJDB_MAX_OBJECTS];
+static objdb_tmp_member members[OBJDB_MAX_MEMBERS];
+static uint8_t values[OBJDB_MAX_VALUES];
+static uint32_t nb_objects = 0U;
+static uint32_t nb_members = 0U;
+static uint32_t nb_clients = 0U;
+static csm_array values_array;
+
+static const char *model_file = "";
+static uint32_t line_number = 0U;
+
+static int objdb_error(const char *msg, const char *arg)
+{
+    fprintf(stderr, "%s:%u: %s %s\n", model_file, line_number, msg, (arg != NULL) ? arg : "");
+    return FALSE;
+}
+
+static int objdb_parse_u32(const char *str, uint32_t *value)
+{
+    char *end = NULL;
+    unsigned long v = strtoul(str, &end, 0);
+
+    *value = (uint32_t)v;
+    return (end != str) && (*end == '\0');
+}
+
+static int objdb_parse_i32(const char *str, int32_t *value)
+{
+    char *end = NULL;
+    long v = strtol(str, &end, 0);
+
+    *value = (int32_t)v;
+    return (end != str) && (*end == '\0');
+}
+
+static int objdb_parse_obis(const char *str, uint8_t *obis)
+{
+    unsigned int f[6];
+    char extra;
+    int valid = (sscanf(str, "%u.%u.%u.%u.%u.%u%c", &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &extra) == 6);
+
+    for (uint32_t i = 0U; valid && (i < 6U); i++)
+    {
+        valid = (f[i] <= 255U);
+        obis[i] = (uint8_t)f[i];
+    }
+    return valid;
+}
+
+static int objdb_parse_hex(const char *str, csm_array *out)
+{
+    size_t len = strlen(str);
+    int valid = ((len % 2U) == 0U);
+
+    for (size_t i = 0U; valid && (i < len); i += 2U)
+    {
+        unsigned int byte;
+        valid = (sscanf(&str[i], "%2x", &byte) == 1) && csm_array_write_u8(out, (uint8_t)byte);
+    }
+    return valid;
+}
+
+// Comma separated SAP list or "all"
+static int objdb_parse_access(char *str, uint8_t *mask)
+{
+    int valid = TRUE;
+
+    *mask = 0U;
+    if (strcmp(str, "all") == 0)
+    {
+        *mask = (uint8_t)((1U << nb_clients) - 1U);
+    }
+    else
+    {
+        while (valid && (str != NULL))
+        {
+            char *next = strchr(str, ',');
+            uint32_t sap = 0U;
+            uint32_t i = 0U;
+
+            if (next != NULL)
+            {
+                *next++ = '\0';
+            }
+
+            valid = objdb_parse_u32(str, &sap);
+            while (valid && (i < nb_clients) && (header.clients[i] != sap))
+            {
+                i++;
+            }
+            valid = valid && (i < nb_clients);
+            if (valid)
+            {
+                *mask |= (uint8_t)(1U << i);
+            }
+            str = next;
+        }
+    }
+    return valid ? TRUE : objdb_error("Unknown client in access list", NULL);
+}
+
+// Encodes "type:value" at the end of the value area
+static int objdb_parse_value(char *str, csm_objdb_member *member)
+{
+    char *type = str;
+    char *text = strchr(str, ':');
+    uint32_t start = values_array.wr_index;
+    uint32_t u = 0U;
+    int32_t i = 0;
+    int valid = (text != NULL);
+
+    if (valid)
+    {
+        *text++ = '\0';
+        if (strcmp(type, "u8") == 0)
+        {
+            valid = objdb_parse_u32(text, &u) && (u <= 0xFFU);
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_UNSIGNED8) && csm_array_write_u8(&values_array, (uint8_t)u);
+        }
+        else if (strcmp(type, "u16") == 0)
+        {
+            valid = objdb_parse_u32(text, &u) && (u <= 0xFFFFU) && csm_axdr_wr_u16(&values_array, (uint16_t)u);
+        }
+        else if (strcmp(type, "u32") == 0)
+        {
+            valid = objdb_parse_u32(text, &u) && csm_axdr_wr_u32(&values_array, u);
+        }
+        else if (strcmp(type, "i8") == 0)
+        {
+            valid = objdb_parse_i32(text, &i) && (i >= -128) && (i <= 127) && csm_axdr_wr_i8(&values_array, (int8_t)i);
+        }
+        else if (strcmp(type, "i16") == 0)
+        {
+            valid = objdb_parse_i32(text, &i) && (i >= -32768) && (i <= 32767);
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_INTEGER16) && csm_array_write_u16(&values_array, (uint16_t)i);
+        }
+        else if (strcmp(type, "i32") == 0)
+        {
+            valid = objdb_parse_i32(text, &i);
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_INTEGER32) && csm_array_write_u32(&values_array, (uint32_t)i);
+        }
+        else if (strcmp(type, "enum") == 0)
+        {
+            valid = objdb_parse_u32(text, &u) && (u <= 0xFFU);
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_ENUM) && csm_array_write_u8(&values_array, (uint8_t)u);
+        }
+        else if (strcmp(type, "bool") == 0)
+        {
+            valid = objdb_parse_u32(text, &u) && (u <= 1U) && csm_axdr_wr_boolean(&values_array, (uint8_t)u);
+        }
+        else if (strcmp(type, "string") == 0)
+        {
+            uint32_t len = (uint32_t)strlen(text);
+            valid = csm_array_write_u8(&values_array, AXDR_TAG_VISIBLESTRING);
+            valid = valid && csm_ber_write_len(&values_array, len);
+            valid = valid && csm_array_write_buff(&values_array, (const uint8_t *)text, len);
+        }
+        else if (strcmp(type, "octets") == 0)
+        {
+            valid = csm_array_write_u8(&values_array, AXDR_TAG_OCTETSTRING);
+            valid = valid && csm_ber_write_len(&values_array, (uint32_t)(strlen(text) / 2U));
+            valid = valid && objdb_parse_hex(text, &values_array);
+        }
+        else if (strcmp(type, "su") == 0)
+        {
+            char *unit = strchr(text, ',');
+            valid = (unit != NULL);
+            if (valid)
+            {
+                *unit++ = '\0';
+                valid = objdb_parse_i32(text, &i) && (i >= -128) && (i <= 127) && objdb_parse_u32(unit, &u) && (u <= 0xFFU);
+            }
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_STRUCTURE) && csm_ber_write_len(&values_array, 2U);
+            valid = valid && csm_axdr_wr_i8(&values_array, (int8_t)i);
+            valid = valid && csm_array_write_u8(&values_array, AXDR_TAG_ENUM) && csm_array_write_u8(&values_array, (uint8_t)u);
+        }
+        else if (strcmp(type, "raw") == 0)
+        {
+            valid = objdb_parse_hex(text, &values_array);
+        }
+        else
+        {
+            valid = FALSE;
+        }
+    }
+
+    member->handler = CSM_OBJDB_STATIC;
+    member->value_offset = start;
+    member->value_size = values_array.wr_index - start;
+    return (valid && (member->value_size > 0U)) ? TRUE : objdb_error("Bad value", type);
+}
+
+static int objdb_parse_clients(char **tokens, uint32_t nb_tokens)
+{
+    int valid = ((nb_objects == 0U) && (nb_clients == 0U)) ? TRUE : objdb_error("Clients must be declared once, before the objects", NULL);
+
+    valid = valid && (((nb_tokens > 1U) && (nb_tokens <= (CSM_OBJDB_MAX_CLIENTS + 1U))) ? TRUE : objdb_error("Bad number of clients", NULL));
+    for (uint32_t i = 1U; valid && (i < nb_tokens); i++)
+    {
+        uint32_t sap = 0U;
+        valid = (objdb_parse_u32(tokens[i], &sap) && (sap > 0U) && (sap <= 0xFFFFU)) ? TRUE : objdb_error("Bad client SAP", tokens[i]);
+        header.clients[nb_clients++] = (uint16_t)sap;
+    }
+    return valid;
+}
+
+static int objdb_parse_object(char **tokens, uint32_t nb_tokens)
+{
+    csm_objdb_object *obj = &objects[nb_objects];
+    uint32_t class_id = 0U;
+    uint32_t version = 0U;
+    int valid = (nb_clients > 0U) ? TRUE : objdb_error("No clients declared", NULL);
+
+    valid = valid && ((nb_objects < OBJDB_MAX_OBJECTS) ? TRUE : objdb_error("Too many objects", NULL));
+    valid = valid && ((nb_tokens >= 3U) ? TRUE : objdb_error("Missing class or logical name", NULL));
+    valid = valid && ((objdb_parse_u32(tokens[1], &class_id) && (class_id <= 0xFFFFU)) ? TRUE : objdb_error("Bad class", tokens[1]));
+    valid = valid && (objdb_parse_obis(tokens[2], obj->obis) ? TRUE : objdb_error("Bad logical name", tokens[2]));
+
+    for (uint32_t i = 3U; valid && (i < nb_tokens); i++)
+    {
+        valid = ((strncmp(tokens[i], "version=", 8U) == 0) && objdb_parse_u32(&tokens[i][8], &version) && (version <= 0xFFU)) ?
+                TRUE : objdb_error("Bad option", tokens[i]);
+    }
+
+    if (valid)
+    {
+        obj->class_id = (uint16_t)class_id;
+        obj->version = (uint8_t)version;
+        nb_objects++;
+    }
+    return valid;
+}
+
+static int objdb_parse_member(char **tokens, uint32_t nb_tokens, int is_method)
+{
+    objdb_tmp_member *m = &members[nb_members];
+    int32_t id = 0;
+    int valid = (nb_objects > 0U) ? TRUE : objdb_error("Member outside an object", NULL);
+
+    valid = valid && ((nb_members < OBJDB_MAX_MEMBERS) ? TRUE : objdb_error("Too many members", NULL));
+    valid = valid && (((nb_tokens >= 2U) && objdb_parse_i32(tokens[1], &id) && (id >= -128) && (id <= 127)) ? TRUE : objdb_error("Bad member id", NULL));
+
+    if (valid)
+    {
+        memset(m, 0, sizeof(objdb_tmp_member));
+        m->object = nb_objects - 1U;
+        m->is_method = (uint8_t)is_method;
+        m->rec.id = (int8_t)id;
+    }
+
+    for (uint32_t i = 2U; valid && (i < nb_tokens); i++)
+    {
+        char *opt = tokens[i];
+        char *arg = strchr(opt, '=');
+        uint32_t handler = 0U;
+
+        valid = (arg != NULL) ? TRUE : objdb_error("Bad option", opt);
+        if (!valid)
+        {
+            break;
+        }
+
+        *arg++ = '\0';
+        if (strcmp(opt, (is_method ? "exec" : "read")) == 0)
+        {
+            valid = objdb_parse_access(arg, &m->rec.read_mask);
+        }
+        else if (!is_method && (strcmp(opt, "write") == 0))
+        {
+            valid = objdb_parse_access(arg, &m->rec.write_mask);
+        }
+        else if (strcmp(opt, "handler") == 0)
+        {
+            valid = (objdb_parse_u32(arg, &handler) && (handler < CSM_OBJDB_STATIC)) ? TRUE : objdb_error("Bad handler", arg);
+            m->rec.handler = (uint8_t)handler;
+        }
+        else if (!is_method && (strcmp(opt, "value") == 0))
+        {
+            valid = objdb_parse_value(arg, &m->rec);
+        }
+        else
+        {
+            valid = objdb_error("Unknown option", opt);
+        }
+    }
+
+    // A static value cannot be written: the image is read-only
+    if (valid && (m->rec.handler == CSM_OBJDB_STATIC) && (m->rec.write_mask != 0U))
+    {
+        valid = objdb_error("Write access on a static value", tokens[1]);
+    }
+
+    for (uint32_t i = 0U; valid && (i < nb_members); i++)
+    {
+        if ((members[i].object == m->object) && (members[i].is_method == m->is_method) && (members[i].rec.id == m->rec.id))
+        {
+            valid = objdb_error("Duplicated member", tokens[1]);
+        }
+    }
+
+    if (valid)
+    {
+        nb_members++;
+    }
+    return valid;
+}
+
+static int objdb_parse(FILE *f)
+{
+    char line[OBJDB_LINE_SIZE];
+    int valid = TRUE;
+
+    while (valid && (fgets(line, sizeof(line), f) != NULL))
+    {
+        char *tokens[OBJDB_MAX_TOKENS];
+        uint32_t nb_tokens = 0U;
+        char *comment = strchr(line, '#');
+
+        line_number++;
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        for (char *tok = strtok(line, " \t\r\n"); (tok != NULL) && (nb_tokens < OBJDB_MAX_TOKENS); tok = strtok(NULL, " \t\r\n"))
+        {
+            tokens[nb_tokens++] = tok;
+        }
+
+        if (nb_tokens == 0U)
+        {
+            continue;
+        }
+        else if (strcmp(tokens[0], "clients") == 0)
+        {
+            valid = objdb_parse_clients(tokens, nb_tokens);
+        }
+        else if (strcmp(tokens[0], "object") == 0)
+        {
+            valid = objdb_parse_object(tokens, nb_tokens);
+        }
+        else if (strcmp(tokens[0], "attr") == 0)
+        {
+            valid = objdb_parse_member(tokens, nb_tokens, FALSE);
+        }
+        else if (strcmp(tokens[0], "method") == 0)
+        {
+            valid = objdb_parse_member(tokens, nb_tokens, TRUE);
+        }
+        else
+        {
+            valid = objdb_error("Unknown statement", tokens[0]);
+        }
+    }
+    return valid;
+}
+
+// Logical name of the objects that do not declare it
+static int objdb_add_logical_names(void)
+{
+    int valid = TRUE;
+
+    for (uint32_t k = 0U; valid && (k < nb_objects); k++)
+    {
+        int found = FALSE;
+
+        for (uint32_t i = 0U; i < nb_members; i++)
+        {
+            found = found || ((members[i].object == k) && !members[i].is_method && (members[i].rec.id == 1));
+        }
+
+        if (!found)
+        {
+            objdb_tmp_member *m = &members[nb_members];
+
+            valid = (nb_members < OBJDB_MAX_MEMBERS) ? TRUE : objdb_error("Too many members", NULL);
+            if (valid)
+            {
+                memset(m, 0, sizeof(objdb_tmp_member));
+                m->object = k;
+                m->rec.id = 1;
+                m->rec.read_mask = (uint8_t)((1U << nb_clients) - 1U);
+                m->rec.handler = CSM_OBJDB_STATIC;
+                m->rec.value_offset = values_array.wr_index;
+                valid = csm_axdr_wr_octetstring(&values_array, objects[k].obis, 6U);
+                m->rec.value_size = values_array.wr_index - m->rec.value_offset;
+                nb_members++;
+            }
+        }
+    }
+    return valid;
+}
+
+static int objdb_compare_objects(const void *a, const void *b)
+{
+    const csm_objdb_object *oa = &objects[*(const uint32_t *)a];
+    const csm_objdb_object *ob = &objects[*(const uint32_t *)b];
+    int diff = (int)oa->class_id - (int)ob->class_id;
+
+    return (diff != 0) ? diff : memcmp(oa->obis, ob->obis, sizeof(oa->obis));
+}
+
+static int objdb_compare_members(const void *a, const void *b)
+{
+    const objdb_tmp_member *ma = (const objdb_tmp_member *)a;
+    const objdb_tmp_member *mb = (const objdb_tmp_member *)b;
+    int diff = (ma->object > mb->object) - (ma->object < mb->object);
+
+    diff = (diff != 0) ? diff : ((int)ma->is_method - (int)mb->is_method);
+    return (diff != 0) ? diff : ((int)ma->rec.id - (int)mb->rec.id);
+}
+
+static int objdb_write(const char *path)
+{
+    static uint32_t order[OBJDB_MAX_OBJECTS];
+    static uint32_t first[OBJDB_MAX_OBJECTS + 1U];
+    uint32_t objects_size = nb_objects * (uint32_t)sizeof(csm_objdb_object);
+    uint32_t members_size = nb_members * (uint32_t)sizeof(csm_objdb_member);
+    uint32_t size = (uint32_t)sizeof(csm_objdb_header) + objects_size + members_size + values_array.wr_index;
+    uint8_t *image = calloc(1U, size);
+    int valid = (image != NULL);
+
+    // Members grouped by declared object, attributes before methods, sorted by id
+    qsort(members, nb_members, sizeof(objdb_tmp_member), objdb_compare_members);
+    for (uint32_t i = 0U, k = 0U; k <= nb_objects; k++)
+    {
+        while ((i < nb_members) && (members[i].object < k))
+        {
+            i++;
+        }
+        first[k] = i;
+    }
+
+    for (uint32_t k = 0U; k < nb_objects; k++)
+    {
+        order[k] = k;
+    }
+    qsort(order, nb_objects, sizeof(uint32_t), objdb_compare_objects);
+
+    for (uint32_t k = 1U; valid && (k < nb_objects); k++)
+    {
+        valid = (objdb_compare_objects(&order[k - 1U], &order[k]) != 0) ? TRUE : objdb_error("Duplicated object", NULL);
+    }
+
+    if (valid)
+    {
+        csm_objdb_object *out_objects = (csm_objdb_object *)&image[sizeof(csm_objdb_header)];
+        csm_objdb_member *out_members = (csm_objdb_member *)&out_objects[nb_objects];
+        uint32_t index = 0U;
+
+        for (uint32_t k = 0U; k < nb_objects; k++)
+        {
+            uint32_t src = order[k];
+            csm_objdb_object *obj = &out_objects[k];
+
+            *obj = objects[src];
+            obj->first_member = index;
+            for (uint32_t i = first[src]; i < first[src + 1U]; i++)
+            {
+                if (members[i].is_method)
+                {
+                    obj->nb_methods++;
+                }
+                else
+                {
+                    obj->nb_attributes++;
+                }
+                out_members[index++] = members[i].rec;
+            }
+        }
+        memcpy(&out_members[nb_members], values, values_array.wr_index);
+
+        header.magic = CSM_OBJDB_MAGIC;
+        header.version = CSM_OBJDB_VERSION;
+        header.header_size = (uint16_t)sizeof(csm_objdb_header);
+        header.object_size = (uint16_t)sizeof(csm_objdb_object);
+        header.member_size = (uint16_t)sizeof(csm_objdb_member);
+        header.nb_objects = nb_objects;
+        header.nb_members = nb_members;
+        header.values_size = values_array.wr_index;
+        header.checksum = 2166136261U;
+        for (uint32_t i = (uint32_t)sizeof(csm_objdb_header); i < size; i++)
+        {
+            header.checksum = (header.checksum ^ image[i]) * 16777619U;
+        }
+        memcpy(image, &header, sizeof(header));
+
+        FILE *f = fopen(path, "wb");
+        valid = (f != NULL) && (fwrite(image, 1U, size, f) == size);
+        valid = (f != NULL) && (fclose(f) == 0) && valid;
+        if (!valid)
+        {
+            fprintf(stderr, "Cannot write %s\n", path);
+        }
+        else
+        {
+            printf("%s: %u objects, %u members, %u bytes\n", path, nb_objects, nb_members, size);
+        }
+    }
+
+    free(image);
+    return valid;
+}
+
+int main(int argc, char **argv)
+{
+    int valid = (argc == 3);
+
+    if (!valid)
+    {
+        printf("Usage: %s model.txt image.bin\r\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    model_file = argv[1];
+    csm_array_init(&values_array, values, sizeof(values), 0U, 0U);
+
+    FILE *f = fopen(model_file, "r");
+    valid = (f != NULL) ? TRUE : objdb_error("Cannot open", NULL);
+    if (valid)
+    {
+        valid = objdb_parse(f);
+        fclose(f);
+    }
+
+    valid = valid && objdb_add_logical_names();
+    valid = valid && objdb_write(argv[2]);
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,5 @@
+
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), host_hal.c)
+
@@ -0,0 +1,162 @@
+/**
+ * Host implementation of the Cosem HAL (keys, passwords, hashes, GCM), for tools running on a PC
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_hal.h"
+#include "csm_association.h"
+#include "gcm.h"
+#include "md5.h"
+#include "sha1.h"
+#include "sha256.h"
+
+#define HOST_HAL_KEY_SIZE       16U
+#define HOST_HAL_NB_KEYS        4U
+#define HOST_HAL_CHUNK_SIZE     256U ///< GCM update size, must be a multiple of 16
+
+// GreenBook 8 test vectors
+static const uint8_t cDefaultSystemTitle[CSM_DEF_APP_TITLE_SIZE] = { 0x4DU, 0x4DU, 0x4DU, 0x00U, 0x00U, 0xBCU, 0x61U, 0x4EU };
+static const uint8_t cDefaultGuek[HOST_HAL_KEY_SIZE] = { 0x00U, 0x01U, 0x02U, 0x03U, 0x04U, 0x05U, 0x06U, 0x07U,
+                                                         0x08U, 0x09U, 0x0AU, 0x0BU, 0x0CU, 0x0DU, 0x0EU, 0x0FU };
+static const uint8_t cDefaultGak[HOST_HAL_KEY_SIZE] = { 0xD0U, 0xD1U, 0xD2U, 0xD3U, 0xD4U, 0xD5U, 0xD6U, 0xD7U,
+                                                        0xD8U, 0xD9U, 0xDAU, 0xDBU, 0xDCU, 0xDDU, 0xDEU, 0xDFU };
+
+static uint8_t system_title[CSM_DEF_APP_TITLE_SIZE];
+static uint8_t lls_password[CSM_DEF_LLS_SIZE];
+static uint8_t keys[HOST_HAL_NB_KEYS][HOST_HAL_KEY_SIZE];
+static mbedtls_gcm_context gcm_ctx[HOST_HAL_MAX_CHANNELS];
+
+void host_hal_init(void)
+{
+    memcpy(system_title, cDefaultSystemTitle, sizeof(system_title));
+    memcpy(lls_password, "ABCDEFGH", CSM_DEF_LLS_SIZE);
+    memset(keys, 0, sizeof(keys));
+    memcpy(keys[CSM_SEC_GUEK], cDefaultGuek, HOST_HAL_KEY_SIZE);
+    memcpy(keys[CSM_SEC_GBEK], cDefaultGuek, HOST_HAL_KEY_SIZE);
+    memcpy(keys[CSM_SEC_GAK], cDefaultGak, HOST_HAL_KEY_SIZE);
+
+    // Called again by each tool or test: the keys set up by the previous run are released (no-op on a cleared context)
+    for (uint32_t i = 0U; i < HOST_HAL_MAX_CHANNELS; i++)
+    {
+        mbedtls_gcm_free(&gcm_ctx[i]);
+        mbedtls_gcm_init(&gcm_ctx[i]);
+    }
+}
+
+void host_hal_set_lls_password(const uint8_t *password)
+{
+    memcpy(lls_password, password, CSM_DEF_LLS_SIZE);
+}
+
+void host_hal_set_key(csm_sec_key key_id, const uint8_t *key)
+{
+    if ((uint32_t)key_id < HOST_HAL_NB_KEYS)
+    {
+        memcpy(keys[key_id], key, HOST_HAL_KEY_SIZE);
+    }
+}
+
+// ----------------------------- IMPLEMENTATION SPECIFIC INTERFACE -----------------------------
+
+void csm_sys_set_system_title(const uint8_t *buf)
+{
+    memcpy(system_title, buf, CSM_DEF_APP_TITLE_SIZE);
+}
+
+const uint8_t *csm_sys_get_system_title()
+{
+    return system_title;
+}
+
+void csm_hal_get_lls_password(uint8_t sap, uint8_t *array, uint8_t max_size)
+{
+    (void) sap;
+    memcpy(array, lls_password, (max_size < CSM_DEF_LLS_SIZE) ? max_size : CSM_DEF_LLS_SIZE);
+}
+
+uint8_t csm_hal_get_random_u8(uint8_t min, uint8_t max)
+{
+    uint32_t range = ((uint32_t)max - min) + 1U;
+    return (uint8_t)(min + ((uint32_t)rand() % range));
+}
+
+int csm_hal_decode_selective_access(csm_request *request, csm_array *array)
+{
+    // Keep a view on the selective access parameters, the database decodes them if needed
+    uint32_t size = csm_array_unread(array);
+    csm_array_init(&request->db_request.sel_access.data, csm_array_rd_data(array), size, size, 0U);
+    return csm_array_reader_jump(array, size);
+}
+
+uint8_t csm_sys_get_mechanism_id(uint8_t sap)
+{
+    (void) sap;
+    return CSM_AUTH_LOWEST_LEVEL;
+}
+
+uint8_t *csm_sys_get_key(uint8_t sap, csm_sec_key key_id)
+{
+    (void) sap;
+    return keys[((uint32_t)key_id < HOST_HAL_NB_KEYS) ? key_id : CSM_SEC_GUEK];
+}
+
+void csm_hal_md5(const uint8_t *input, uint32_t size, uint8_t *output)
+{
+    mbedtls_md5(input, size, output);
+}
+
+void csm_hal_sha1(const uint8_t *input, uint32_t size, uint8_t *output)
+{
+    mbedtls_sha1(input, size, output);
+}
+
+void csm_hal_sha256(const uint8_t *input, uint32_t size, uint8_t *output)
+{
+    mbedtls_sha256(input, size, output, 0);
+}
+
+int csm_sys_gcm_init(uint8_t channel, uint8_t sap, csm_sec_key key_id, csm_sec_mode mode, const uint8_t *iv, const uint8_t *aad, uint32_t aad_len)
+{
+    mbedtls_gcm_context *ctx = &gcm_ctx[channel % HOST_HAL_MAX_CHANNELS];
+    int ret = mbedtls_gcm_setkey(ctx, MBEDTLS_CIPHER_ID_AES, csm_sys_get_key(sap, key_id), HOST_HAL_KEY_SIZE * 8U);
+
+    if (ret == 0)
+    {
+        ret = mbedtls_gcm_starts(ctx, (mode == CSM_SEC_ENCRYPT) ? MBEDTLS_GCM_ENCRYPT : MBEDTLS_GCM_DECRYPT, iv, 12U, aad, aad_len);
+    }
+    return (ret == 0) ? TRUE : FALSE;
+}
+
+int csm_sys_gcm_update(uint8_t channel, const uint8_t *plain, uint32_t plain_len, uint8_t *crypt)
+{
+    mbedtls_gcm_context *ctx = &gcm_ctx[channel % HOST_HAL_MAX_CHANNELS];
+    uint8_t chunk[HOST_HAL_CHUNK_SIZE];
+    int ret = 0;
+
+    // The stack (de)ciphers in place, which mbed TLS does not allow: go through an intermediate buffer
+    while ((plain_len > 0U) && (ret == 0))
+    {
+        uint32_t size = (plain_len < HOST_HAL_CHUNK_SIZE) ? plain_len : HOST_HAL_CHUNK_SIZE;
+        memcpy(chunk, plain, size);
+        ret = mbedtls_gcm_update(ctx, size, chunk, crypt);
+        plain += size;
+        crypt += size;
+        plain_len -= size;
+    }
+    return (ret == 0) ? TRUE : FALSE;
+}
+
+int csm_sys_gcm_finish(uint8_t channel, uint8_t *tag)
+{
+    mbedtls_gcm_context *ctx = &gcm_ctx[channel % HOST_HAL_MAX_CHANNELS];
+    return (mbedtls_gcm_finish(ctx, tag, 16U) == 0) ? TRUE : FALSE;
+}
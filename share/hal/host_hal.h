@@ -0,0 +1,39 @@
+/**
+ * Host implementation of the Cosem HAL (keys, passwords, hashes, GCM), for tools running on a PC
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_definitions.h"
+
+// Number of GCM contexts, one per channel id: the channels executed in parallel never share one
+#ifndef HOST_HAL_MAX_CHANNELS
+#define HOST_HAL_MAX_CHANNELS   256U
+#endif
+
+/**
+ * @brief Initialize the HAL with default values (GreenBook test keys, "ABCDEFGH" LLS password)
+ */
+void host_hal_init(void);
+
+void host_hal_set_lls_password(const uint8_t *password);
+void host_hal_set_key(csm_sec_key key_id, const uint8_t *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_HAL_H
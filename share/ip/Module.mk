@@ -1,5 +1,5 @@
 
 LOCAL_DIR = $(call my-dir)/
 
-SOURCES += $(addprefix $(LOCAL_DIR), tcp_server.c tcp_client.c)
+SOURCES += $(addprefix $(LOCAL_DIR), tcp_server.c tcp_client.c tcp_push.c)
 
@@ -0,0 +1,151 @@
+/**
+ * Data-Notification transport: TCP connection to the push destination, wrapper framing
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "tcp_push.h"
+#include "os_util.h"
+
+#ifdef USE_UNIX_OS
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+#define TCP_PUSH_WRAPPER_VERSION    1U
+#define TCP_PUSH_WRAPPER_SIZE       8U
+
+#ifdef USE_UNIX_OS
+
+// "a.b.c.d:port" into a socket address
+static int tcp_push_address(const csm_push_destination *destination, struct sockaddr_in *sin)
+{
+    char host[CSM_PUSH_MAX_DEST_SIZE + 1U];
+    char *port = NULL;
+    int valid = (destination->size <= CSM_PUSH_MAX_DEST_SIZE);
+
+    if (valid)
+    {
+        memcpy(host, destination->address, destination->size);
+        host[destination->size] = '\0';
+        port = strchr(host, ':');
+        valid = (port != NULL);
+    }
+
+    if (valid)
+    {
+        unsigned long value;
+        char *end = NULL;
+
+        *port++ = '\0';
+        value = strtoul(port, &end, 10);
+        memset(sin, 0, sizeof(*sin));
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons((uint16_t)value);
+        valid = (end != port) && (*end == '\0') && (value > 0UL) && (value <= 0xFFFFUL) &&
+                (inet_pton(AF_INET, host, &sin->sin_addr) == 1);
+    }
+    return valid;
+}
+
+// Wait until the socket is writable, for the connection or the sending
+static int tcp_push_wait(int sock)
+{
+    fd_set set;
+    struct timeval timeout;
+
+    FD_ZERO(&set);
+    FD_SET(sock, &set);
+    timeout.tv_sec = TCP_PUSH_TIMEOUT_MS / 1000U;
+    timeout.tv_usec = (TCP_PUSH_TIMEOUT_MS % 1000U) * 1000U;
+    return (select(sock + 1, NULL, &set, NULL, &timeout) == 1);
+}
+
+static int tcp_push_write(int sock, const uint8_t *data, uint32_t size)
+{
+    int valid = TRUE;
+
+    while ((size > 0U) && valid)
+    {
+        ssize_t n = send(sock, data, size, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            data += n;
+            size -= (uint32_t)n;
+        }
+        else
+        {
+            valid = (n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) && tcp_push_wait(sock);
+        }
+    }
+    return valid;
+}
+
+int tcp_push_send(const csm_push_setup *setup, const uint8_t *apdu, uint32_t size)
+{
+    struct sockaddr_in sin;
+    uint8_t header[TCP_PUSH_WRAPPER_SIZE];
+    int sock = -1;
+    int valid = (setup->destination.transport == CSM_PUSH_TCP) && (size <= 0xFFFFU) &&
+                tcp_push_address(&setup->destination, &sin);
+
+    if (valid)
+    {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        valid = (sock >= 0) && (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == 0);
+    }
+
+    if (valid && (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) != 0))
+    {
+        int error = 0;
+        socklen_t len = sizeof(error);
+
+        valid = (errno == EINPROGRESS) && tcp_push_wait(sock) &&
+                (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) == 0) && (error == 0);
+    }
+
+    if (valid)
+    {
+        PUT_BE16(&header[0], TCP_PUSH_WRAPPER_VERSION);
+        PUT_BE16(&header[2], setup->llc.dsap);
+        PUT_BE16(&header[4], setup->llc.ssap);
+        PUT_BE16(&header[6], (uint16_t)size);
+        valid = tcp_push_write(sock, header, sizeof(header)) && tcp_push_write(sock, apdu, size);
+    }
+
+    if (!valid)
+    {
+        CSM_ERR("[PUSH] Cannot send to the TCP destination");
+    }
+
+    if (sock >= 0)
+    {
+        (void) close(sock);
+    }
+    return valid;
+}
+
+#else
+
+int tcp_push_send(const csm_push_setup *setup, const uint8_t *apdu, uint32_t size)
+{
+    (void) setup;
+    (void) apdu;
+    (void) size;
+    CSM_ERR("[PUSH] TCP push is only available on Unix");
+    return FALSE;
+}
+
+#endif
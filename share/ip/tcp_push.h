@@ -0,0 +1,30 @@
+/**
+ * Data-Notification transport: TCP connection to the push destination, wrapper framing
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef TCP_PUSH_H
+#define TCP_PUSH_H
+
+#include "csm_push.h"
+
+#define TCP_PUSH_TIMEOUT_MS     2000U   ///< Connection and sending time limit for one notification
+
+/**
+ * @brief Send handler of the Push Setup engine (see csm_push_init()) for the TCP destinations
+ *
+ * The destination address is "a.b.c.d:port". A connection is opened for each notification, the
+ * APDU is sent in a wrapper frame from the server SAP (llc.dsap) to the client SAP (llc.ssap), then
+ * the connection is closed. The call blocks at most TCP_PUSH_TIMEOUT_MS, call it from the loop
+ * of the transport (see tcp_server_set_timer()).
+ * @return FALSE for the other transport services, or if the destination cannot be reached
+ */
+int tcp_push_send(const csm_push_setup *setup, const uint8_t *apdu, uint32_t size);
+
+#endif // TCP_PUSH_H
@@ -1,4 +1,10 @@
 #include "tcp_server.h"
+#include "slot_alloc.h"
+#include "admission.h"
+#include "capture.h"
+#include "executor.h"
+#include "csm_runq.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -21,6 +27,7 @@
 #include <fcntl.h>
 #include <netinet/tcp.h>
 #include <errno.h>
+#include <time.h>
 
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR -1
@@ -34,14 +41,103 @@ typedef struct in_addr IN_ADDR;
 
 #define CRLF		"\r\n"
 #define MAX_CLIENTS 10
+#define ADM_ENTRIES 64U
+
+
+#define WRAPPER_HDR_SIZE 8U
 
 
 typedef struct
 {
    SOCKET sock;
    uint8_t connected; // 0 = not connected, otherwise identifier
+   uint8_t addr[4];   // Client address, part of the admission key
+   uint64_t due_ms;   // Delayed by the admission control: the APDU waits in rx until then, 0 otherwise
+   uint32_t rx_size;
+   uint8_t rx[TCP_SERVER_RX_SIZE]; // Wrapper frames being reassembled
+   uint8_t queued;    // First frame of rx admitted, waiting in the run queue
+
+   // Executed by the executor, see tcp_server_set_executor()
+   ex_mailbox mailbox;
+   ex_item item;
+   uint8_t attached;  // Mailbox open, otherwise the frames are executed by the server loop
+   uint8_t in_flight; // Frame in the executor: the peer is not read until its reply
+   uint32_t work_size; // Frame size, then reply size
+   uint8_t work[TCP_SERVER_WORK_SIZE];
 } peer;
 
+static peer peers[MAX_CLIENTS];
+static uint64_t peers_free_map[SLOT_ALLOC_WORDS(MAX_CLIENTS)];
+static slot_alloc peers_slots;
+static fd_set master_set;
+
+// Admission control, disabled until tcp_server_set_limits() is called
+static adm_entry adm_entries[ADM_ENTRIES];
+static adm_table admission;
+
+// Periodic handler, see tcp_server_set_timer()
+static timer_handler timer_func = NULL;
+static uint32_t timer_period_ms;
+
+// Deferred replies, see tcp_server_set_completion(); the pipe wakes up the select()
+static completion_handler completion_func = NULL;
+static int wake_pipe[2] = { -1, -1 };
+
+// Frames of all the connections, the channel of a record is the channel of its connection
+static cap_file capture;
+
+// Admitted frames executed by the server loop, one per peer at most: the queue cannot be full
+static csm_runq runq;
+static priority_handler priority_func = NULL;
+
+// Data handler executed by worker threads, see tcp_server_set_executor()
+static uint32_t executor_workers = 0U;
+static ex_executor executor;
+static ex_mailbox *executor_slots[MAX_CLIENTS];
+static ex_outbox executor_outbox;
+static data_handler executor_func = NULL;
+static memory_t executor_buffer; // Offset and size of the buffer given to the data handler
+
+static uint64_t now_ms(void)
+{
+#ifdef USE_UNIX_OS
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000U) + ((uint64_t)ts.tv_nsec / 1000000U);
+#else
+   return (uint64_t)GetTickCount();
+#endif
+}
+
+static uint64_t epoch_us(void)
+{
+#ifdef USE_UNIX_OS
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U);
+#else
+   return (uint64_t)time(NULL) * 1000000U;
+#endif
+}
+
+static void capture_frame(const peer *p, uint8_t direction, const uint8_t *frame, uint32_t size)
+{
+   if (capture.file != NULL)
+   {
+      (void) cap_write(&capture, epoch_us(), direction, p->connected, frame, size);
+   }
+}
+
+static enum adm_verdict admit(const uint8_t *addr, uint16_t client_sap, uint32_t size, uint32_t *delay_ms)
+{
+   enum adm_verdict verdict = ADM_ACCEPT;
+   if (admission.entries != NULL)
+   {
+      verdict = adm_check(&admission, adm_key(addr, 4U, client_sap), size, now_ms(), delay_ms);
+   }
+   return verdict;
+}
+
 static void init(void)
 {
 #ifdef WIN32
@@ -144,54 +240,379 @@ static void write_peer(SOCKET sock, const char *buffer, size_t size)
    }
 }
 
+static void open_wake_pipe(void)
+{
+#ifdef USE_UNIX_OS
+   if ((wake_pipe[0] < 0) && (pipe(wake_pipe) == 0))
+   {
+      // A full pipe already wakes up the loop: never block the caller
+      (void) fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+      (void) fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+   }
+#endif
+}
+
+static void complete(memory_t *b)
+{
+   uint8_t channel = 0U;
+   int ret;
+
+   while ((ret = completion_func(&channel, b)) >= 0)
+   {
+      int found = 0;
+      for (int i = 0; (i < MAX_CLIENTS) && !found; i++)
+      {
+         if ((channel != 0U) && (peers[i].connected == channel))
+         {
+            found = 1;
+            if (ret > 0)
+            {
+               capture_frame(&peers[i], CAP_TX, b->data + b->offset, (uint32_t)ret);
+               write_peer(peers[i].sock, (const char *)(b->data + b->offset), ret);
+            }
+         }
+      }
+      if (!found)
+      {
+         puts("[TCP server] Deferred reply dropped, client disconnected");
+      }
+   }
+}
+
+static void close_peer(peer *p, conn_handler conn_func)
+{
+   if (capture.file != NULL)
+   {
+      (void) cap_flush(&capture);
+   }
+   if (p->sock != INVALID_SOCKET)
+   {
+      FD_CLR(p->sock, &master_set);
+      end_connection(p->sock);
+      p->sock = INVALID_SOCKET;
+   }
+   if (p->in_flight)
+   {
+      // The channel is in use by a worker: released when its reply comes back, see collect()
+      return;
+   }
+   if (p->attached)
+   {
+      ex_mailbox_close(&executor, &p->mailbox);
+      p->attached = 0U;
+   }
+   conn_func(p->connected, CONN_DISCONNECTED);
+
+   // Make sure structure elements are cleared
+   p->sock = INVALID_SOCKET;
+   p->connected = 0U;
+   p->due_ms = 0U;
+   p->rx_size = 0U;
+   p->queued = 0U;
+   (void) slot_alloc_release(&peers_slots, (uint32_t)(p - &peers[0]));
+}
+
+// Execute the first frame of the receive buffer, admitted before
+static void run_peer(peer *p, data_handler data_func, memory_t *b)
+{
+   uint32_t size = WRAPPER_HDR_SIZE + (((uint32_t)p->rx[6] << 8U) | p->rx[7]);
+
+   capture_frame(p, CAP_RX, p->rx, size);
+   memcpy(b->data + b->offset, p->rx, size);
+   p->rx_size -= size;
+   memmove(p->rx, &p->rx[size], p->rx_size);
+   p->queued = 0U;
+
+   if (data_func != NULL)
+   {
+      int ret = data_func(p->connected, b, size);
+      if (ret > 0)
+      {
+         capture_frame(p, CAP_TX, b->data + b->offset, (uint32_t)ret);
+         write_peer(p->sock, (const char *)(b->data + b->offset), ret);
+      }
+   }
+}
+
+/**
+ * Admit the complete wrapper frames received, one at a time: a delayed one stays in the receive
+ * buffer and the peer is not read until the deadline. An admitted frame goes to the executor or
+ * to the run queue, the next one is admitted after its execution.
+ * Return 0 if the connection must be closed (rejected client, frame larger than the buffer).
+ */
+static int process_peer(peer *p, data_handler data_func, memory_t *b)
+{
+   int keep = 1;
+
+   while (keep && (p->due_ms == 0U) && !p->in_flight && !p->queued && (p->rx_size >= WRAPPER_HDR_SIZE))
+   {
+      uint32_t size = WRAPPER_HDR_SIZE + (((uint32_t)p->rx[6] << 8U) | p->rx[7]);
+      uint16_t client_sap = (uint16_t)(((uint16_t)p->rx[2] << 8U) | p->rx[3]);
+      uint32_t delay_ms = 0U;
+
+      if ((size > TCP_SERVER_RX_SIZE) || (size > (b->max_size - b->offset)))
+      {
+         keep = 0;
+      }
+      else if (p->rx_size < size)
+      {
+         break;
+      }
+      else
+      {
+         enum adm_verdict verdict = admit(p->addr, client_sap, size, &delay_ms);
+         if (verdict == ADM_DELAY)
+         {
+            p->due_ms = now_ms() + delay_ms;
+            FD_CLR(p->sock, &master_set);
+         }
+         else if (verdict == ADM_REJECT)
+         {
+            keep = 0;
+         }
+         else if (p->attached)
+         {
+            // Executed by a worker, the next frames wait for the reply
+            capture_frame(p, CAP_RX, p->rx, size);
+            memcpy(&p->work[executor_buffer.offset], p->rx, size);
+            p->work_size = size;
+            p->rx_size -= size;
+            memmove(p->rx, &p->rx[size], p->rx_size);
+            p->in_flight = 1U;
+            FD_CLR(p->sock, &master_set);
+            ex_submit(&executor, &p->mailbox, &p->item);
+         }
+         else
+         {
+            // Executed by run_queue(), after the high priority frames of the other peers; the peer is
+            // not read meanwhile, the next frames could fill the receive buffer
+            int high = (priority_func != NULL) && priority_func(p->connected, &p->rx[WRAPPER_HDR_SIZE], size - WRAPPER_HDR_SIZE);
+            p->queued = 1U;
+            if (csm_runq_push(&runq, high ? CSM_RUNQ_HIGH : CSM_RUNQ_NORMAL, p->connected, p))
+            {
+               FD_CLR(p->sock, &master_set);
+            }
+            else
+            {
+               run_peer(p, data_func, b);
+            }
+         }
+      }
+   }
+   return keep;
+}
+
+/**
+ * Execute the frames admitted so far, high priority first. The next frame of a peer is queued after
+ * its execution but run at the next loop, once the frames received meanwhile by the others are queued.
+ */
+static void run_queue(data_handler data_func, conn_handler conn_func, memory_t *b)
+{
+   uint8_t channel = 0U;
+   void *ctx = NULL;
+   uint32_t count = csm_runq_count(&runq);
+
+   while ((count-- > 0U) && csm_runq_pop(&runq, &channel, &ctx))
+   {
+      peer *p = (peer *)ctx;
+
+      // Skip a peer closed after the push
+      if (p->queued && (p->connected == channel))
+      {
+         run_peer(p, data_func, b);
+         FD_SET(p->sock, &master_set);
+         if (!process_peer(p, data_func, b))
+         {
+            puts("[TCP server] Connection closed, client over its rate or frame too large");
+            close_peer(p, conn_func);
+         }
+      }
+   }
+}
+
+// Worker thread: the channels of the peers are executed in parallel
+static void execute_peer(void *ctx, ex_mailbox *mailbox, ex_item *item, uint32_t worker)
+{
+   peer *p = (peer *)mailbox->owner;
+   memory_t work;
+   (void) ctx;
+   (void) item;
+   (void) worker;
+
+   work.data = p->work;
+   work.offset = executor_buffer.offset;
+   work.max_size = executor_buffer.max_size;
+   int ret = executor_func(p->connected, &work, p->work_size);
+   p->work_size = (ret > 0) ? (uint32_t)ret : 0U;
+}
+
+static void notify_outbox(void *ctx)
+{
+   (void) ctx;
+   tcp_server_wake();
+}
+
+// Send the replies of the executor, then the next frames of the peers waiting for them
+static void collect(data_handler data_func, conn_handler conn_func, memory_t *b)
+{
+   ex_item *item;
+
+   while ((item = ex_outbox_pop(&executor_outbox)) != NULL)
+   {
+      peer *p = (peer *)((uint8_t *)item - offsetof(peer, item));
+      p->in_flight = 0U;
+
+      if (p->sock == INVALID_SOCKET)
+      {
+         // Closed during the execution
+         close_peer(p, conn_func);
+         continue;
+      }
+      if (p->work_size > 0U)
+      {
+         capture_frame(p, CAP_TX, &p->work[executor_buffer.offset], p->work_size);
+         write_peer(p->sock, (const char *)&p->work[executor_buffer.offset], p->work_size);
+      }
+      if (p->due_ms == 0U)
+      {
+         FD_SET(p->sock, &master_set);
+      }
+      if (!process_peer(p, data_func, b))
+      {
+         puts("[TCP server] Connection closed, client over its rate or frame too large");
+         close_peer(p, conn_func);
+      }
+   }
+}
+
 static void app(data_handler data_func, conn_handler conn_func, memory_t *b, int tcp_port)
 {
    SOCKET sock = init_connection(tcp_port);
 
-   char *buff = (char*)(b->data + b->offset);
-   int max_size = b->max_size - b->offset;
-
    unsigned int max = sock;
-   /* an array for all clients */
-   peer peers[MAX_CLIENTS];
 
    // Init properly
    for (int i = 0; i < MAX_CLIENTS; i++)
    {
        peers[i].connected = 0U;
+       peers[i].attached = 0U;
+       peers[i].in_flight = 0U;
+       peers[i].queued = 0U;
+   }
+   slot_alloc_init(&peers_slots, peers_free_map, NULL, MAX_CLIENTS);
+   csm_runq_init(&runq);
+
+   if ((executor_workers > 0U) && (data_func != NULL))
+   {
+      executor_func = data_func;
+      executor_buffer = *b;
+      if (executor_buffer.max_size > TCP_SERVER_WORK_SIZE)
+      {
+         executor_buffer.max_size = TCP_SERVER_WORK_SIZE;
+      }
+      ex_outbox_init(&executor_outbox, notify_outbox, NULL);
+      if (!ex_init(&executor, executor_workers, executor_slots, MAX_CLIENTS, execute_peer, NULL))
+      {
+         puts("[TCP server] Cannot start the executor, frames executed by the server loop");
+         executor_workers = 0U;
+      }
    }
 
    fd_set working_set;
-   fd_set master_set;
 
    FD_ZERO(&master_set);
 
    /* add the connection socket */
    FD_SET(sock, &master_set);
+#ifdef USE_UNIX_OS
+   if (wake_pipe[0] >= 0)
+   {
+      FD_SET(wake_pipe[0], &master_set);
+   }
+#endif
+
+   uint64_t next_tick = now_ms() + timer_period_ms;
 
    puts("[TCP Server] TCP Server started");
 
     while(1)
     {
-        // update max
+        // update max and the next deadline
+        uint64_t deadline = (timer_func != NULL) ? next_tick : 0U;
         max = sock;
+#ifdef USE_UNIX_OS
+        max = (wake_pipe[0] > (int)max) ? (unsigned int)wake_pipe[0] : max;
+#endif
         for (int i = 0; i < MAX_CLIENTS; i++)
         {
-           if (peers[i].connected)
+           if (peers[i].connected && (peers[i].sock != INVALID_SOCKET))
            {
                /* what is the new maximum fd ? */
                max = peers[i].sock > max ? peers[i].sock : max;
+               if ((peers[i].due_ms != 0U) && ((deadline == 0U) || (peers[i].due_ms < deadline)))
+               {
+                   deadline = peers[i].due_ms;
+               }
            }
         }
 
         memcpy(&working_set, &master_set, sizeof(master_set));
 
-        if(select(max + 1, &working_set, NULL, NULL, NULL) == -1)
+        struct timeval timeout;
+        struct timeval *wait = NULL;
+        if (deadline != 0U)
+        {
+            uint64_t now = now_ms();
+            uint64_t left = (deadline > now) ? (deadline - now) : 0U;
+            timeout.tv_sec = (long)(left / 1000U);
+            timeout.tv_usec = (long)((left % 1000U) * 1000U);
+            wait = &timeout;
+        }
+        if (csm_runq_count(&runq) > 0U)
+        {
+            // Frames left in the run queue, only poll the sockets
+            timeout.tv_sec = 0;
+            timeout.tv_usec = 0;
+            wait = &timeout;
+        }
+
+        if(select(max + 1, &working_set, NULL, NULL, wait) == -1)
         {
             perror("select()");
             exit(errno);
         }
 
+        if ((timer_func != NULL) && (now_ms() >= next_tick))
+        {
+            timer_func(now_ms());
+            next_tick += timer_period_ms;
+            if (next_tick <= now_ms())
+            {
+                // Late: no burst of calls to catch up
+                next_tick = now_ms() + timer_period_ms;
+            }
+        }
+
+        // Without the pipe (Windows), the completions are polled on each loop
+#ifdef USE_UNIX_OS
+        if ((wake_pipe[0] >= 0) && FD_ISSET(wake_pipe[0], &working_set))
+#endif
+        {
+#ifdef USE_UNIX_OS
+            uint8_t dummy[16];
+            while (read(wake_pipe[0], dummy, sizeof(dummy)) > 0)
+            {
+            }
+#endif
+            if (completion_func != NULL)
+            {
+                complete(b);
+            }
+            if (executor_workers > 0U)
+            {
+                collect(data_func, conn_func, b);
+            }
+        }
 
         if(FD_ISSET(sock, &working_set))
         {
@@ -206,24 +627,29 @@ static void app(data_handler data_func, conn_handler conn_func, memory_t *b, int
                 continue;
             }
 
-            // Grand access to the application layer
-            uint8_t channel = conn_func(0U, CONN_NEW);
+            // Check the client rate (a connection counts as an APDU), reserve a peer, then grant access to the application layer
+            uint32_t delay_ms = 0U;
+            int32_t slot = (admit((const uint8_t *)&csin.sin_addr, 0U, 0U, &delay_ms) == ADM_ACCEPT) ? slot_alloc_get(&peers_slots) : -1;
+            uint8_t channel = (slot >= 0) ? conn_func(0U, CONN_NEW) : 0U;
             if (channel > 0)
             {
                 FD_SET(csock, &master_set);
-                peer c = { csock, (uint8_t)channel };
-                for (int i = 0; i < MAX_CLIENTS; i++)
-                {
-                    if (!peers[i].connected)
-                    {
-                        peers[i] = c;
-                        puts("[TCP server] New connection!");
-                        break;
-                    }
-                }
+                peers[slot].sock = csock;
+                peers[slot].connected = channel;
+                memcpy(peers[slot].addr, &csin.sin_addr, sizeof(peers[slot].addr));
+                peers[slot].due_ms = 0U;
+                peers[slot].rx_size = 0U;
+                peers[slot].in_flight = 0U;
+                peers[slot].queued = 0U;
+                peers[slot].attached = (executor_workers > 0U) && ex_mailbox_open(&executor, &peers[slot].mailbox, &executor_outbox, &peers[slot]);
+                puts("[TCP server] New connection!");
             }
             else
             {
+                if (slot >= 0)
+                {
+                    (void) slot_alloc_release(&peers_slots, (uint32_t)slot);
+                }
                 // Reject connection
                 end_connection(csock);
                 puts("[TCP server] New connection rejected");
@@ -232,57 +658,112 @@ static void app(data_handler data_func, conn_handler conn_func, memory_t *b, int
 
         for(int i = 0; i < MAX_CLIENTS; i++)
         {
-            if (peers[i].connected)
+            // A closed peer waits for the reply of the executor to release its channel
+            if (peers[i].connected && (peers[i].sock != INVALID_SOCKET))
             {
-                /* a client is talking */
-                if(FD_ISSET(peers[i].sock, &working_set))
+                int keep = 1;
+                if ((peers[i].due_ms != 0U) && (now_ms() >= peers[i].due_ms))
                 {
-                   int size = read_peer(peers[i].sock, buff, max_size);
+                    // Admission checked again for the APDU waiting in the receive buffer
+                    peers[i].due_ms = 0U;
+                    if (!peers[i].in_flight)
+                    {
+                        FD_SET(peers[i].sock, &master_set);
+                    }
+                    keep = process_peer(&peers[i], data_func, b);
+                }
+                /* a client is talking; never read into a full buffer, recv() would return 0 */
+                else if(FD_ISSET(peers[i].sock, &working_set) && (peers[i].rx_size < TCP_SERVER_RX_SIZE))
+                {
+                   int size = read_peer(peers[i].sock, (char *)&peers[i].rx[peers[i].rx_size], TCP_SERVER_RX_SIZE - peers[i].rx_size);
                    /* client disconnected */
                    if(size == 0)
                    {
-                       FD_CLR(peers[i].sock, &master_set);
-                      end_connection(peers[i].sock);
-
                       puts("Client disconnected !");
-                      conn_func(peers[i].connected, CONN_DISCONNECTED);
-
-                      // Make sure structure elements are cleared
-                      peers[i].sock = INVALID_SOCKET;
-                      peers[i].connected = 0U;
+                      keep = 0;
                    }
                    else
                    {
-                       puts("[TCP server] New data received!");
-                       if (data_func != NULL)
-                       {
-                           // FIXME: change channel number with instance number when multi threaded server is available
-                           int ret = data_func(0U, b, size);
-                           if (ret > 0)
-                           {
-                                write_peer(peers[i].sock, buff, ret);
-                           }
-                       }
-
-                       //broadcast(peers, client, actual, buffer, 0);
+                      peers[i].rx_size += (uint32_t)size;
+                      keep = process_peer(&peers[i], data_func, b);
+                      if (!keep)
+                      {
+                         puts("[TCP server] Connection closed, client over its rate or frame too large");
+                      }
                    }
                 }
+
+                if (!keep)
+                {
+                   close_peer(&peers[i], conn_func);
+                }
             }
         }
+
+        run_queue(data_func, conn_func, b);
     }
 
    // Clear peers
+   if (executor_workers > 0U)
+   {
+      ex_destroy(&executor);
+   }
    for(int i = 0; i < MAX_CLIENTS; i++)
    {
-       if (peers[i].connected)
+       if (peers[i].connected && (peers[i].sock != INVALID_SOCKET))
        {
             closesocket(peers[i].sock);
        }
    }
    // End server
    end_connection(sock);
+   cap_close(&capture);
+}
+
+
+void tcp_server_set_limits(const adm_limit *apdus, const adm_limit *bytes, uint32_t max_delay_ms)
+{
+   (void) adm_init(&admission, adm_entries, ADM_ENTRIES, apdus, bytes, max_delay_ms);
+}
+
+void tcp_server_set_timer(timer_handler func, uint32_t period_ms)
+{
+   timer_func = func;
+   timer_period_ms = (period_ms > 0U) ? period_ms : 1U;
+}
+
+void tcp_server_set_completion(completion_handler func)
+{
+   open_wake_pipe();
+   completion_func = func;
+}
+
+void tcp_server_set_priority(priority_handler func)
+{
+   priority_func = func;
+}
+
+void tcp_server_set_executor(uint32_t nb_workers)
+{
+   open_wake_pipe();
+   executor_workers = (nb_workers <= WP_MAX_WORKERS) ? nb_workers : WP_MAX_WORKERS;
+}
+
+int tcp_server_set_capture(const char *path)
+{
+   return cap_create(&capture, path, CAP_LINK_WRAPPER, epoch_us());
 }
 
+void tcp_server_wake(void)
+{
+#ifdef USE_UNIX_OS
+   uint8_t byte = 1U;
+   if (wake_pipe[1] >= 0)
+   {
+      (void) write(wake_pipe[1], &byte, 1U);
+   }
+#endif
+}
 
 int tcp_server_init(data_handler data_func, conn_handler conn_func, memory_t *buffer, int tcp_port)
 {
@@ -3,7 +3,91 @@
 
 #include <stdlib.h>
 #include "transports.h"
+#include "admission.h"
 
+// Receive buffer of each connection, the largest wrapper frame accepted
+#ifndef TCP_SERVER_RX_SIZE
+#define TCP_SERVER_RX_SIZE 2048U
+#endif
+
+// Buffer of each connection given to the data handler by the executor, the memory_t max_size is capped to it
+#ifndef TCP_SERVER_WORK_SIZE
+#define TCP_SERVER_WORK_SIZE 4096U
+#endif
+
+/**
+ * @brief Limit each client (address and client SAP) to APDUs/s and bytes/s (see admission.h), before tcp_server_init()
+ *
+ * The admission is decided on each wrapper frame once reassembled, and connections are counted as APDUs.
+ * An APDU over the limits waits up to max_delay_ms; beyond, the connection is closed.
+ */
+void tcp_server_set_limits(const adm_limit *apdus, const adm_limit *bytes, uint32_t max_delay_ms);
+
+/**
+ * @brief Periodic handler called from the server loop, eg: csm_push_process() with tcp_push_send()
+ * @param now_ms: monotonic time in milliseconds
+ */
+typedef void (*timer_handler)(uint64_t now_ms);
+
+// Call func every period_ms from the server loop, before tcp_server_init()
+void tcp_server_set_timer(timer_handler func, uint32_t period_ms);
+
+/**
+ * @brief Deferred reply handler called from the server loop after tcp_server_wake()
+ *
+ * Typically pops an access completed by the database and encodes its response with csm_channel_complete().
+ * @param channel: set to the channel of the reply, as given by the connection handler
+ * @return the size of the reply stored in buffer (0: nothing to send), -1 when no completion is left
+ */
+typedef int (*completion_handler)(uint8_t *channel, memory_t *buffer);
+
+// Set the deferred reply handler, before tcp_server_init()
+void tcp_server_set_completion(completion_handler func);
+
+// Make the server loop call the completion handler, can be called from any thread
+void tcp_server_wake(void);
+
+/**
+ * @brief Priority of a received APDU, non zero to execute it before the normal ones (see csm_runq.h)
+ *
+ * Typically csm_channel_is_high_priority() on the APDU, for the channel index of the connection.
+ * @param apdu: the APDU of the wrapper frame, header excluded
+ */
+typedef int (*priority_handler)(uint8_t channel, const uint8_t *apdu, uint32_t size);
+
+/**
+ * @brief Classify the frames admitted by the server loop, before tcp_server_init()
+ *
+ * The frames received from all the connections during one loop are executed high priority first,
+ * one frame per connection at a time; without a handler, they are all normal.
+ * The frames executed by the executor (see tcp_server_set_executor()) are not queued.
+ */
+void tcp_server_set_priority(priority_handler func);
+
+/**
+ * @brief Run the data handler on nb_workers threads (see executor.h) instead of the server loop, before tcp_server_init()
+ *
+ * Each connection has a mailbox: its frames are executed in order, one at a time, and the next one is
+ * read after the reply; different connections run in parallel. The handler gets a buffer of the
+ * connection with the offset of the one given to tcp_server_init(), so it must be thread safe between
+ * channels, eg: csm_channel_execute_asso() with an association state per connection.
+ * A closed connection is reported to the connection handler once its frame is executed.
+ */
+void tcp_server_set_executor(uint32_t nb_workers);
+
+/**
+ * @brief Capture the wrapper frames of all the connections (see capture.h), before tcp_server_init()
+ *
+ * The channel of a record is the channel of its connection; the file is flushed when a connection closes.
+ * @return FALSE if the file cannot be created
+ */
+int tcp_server_set_capture(const char *path);
+
+/**
+ * @brief Run the server loop
+ *
+ * The data handler receives one complete wrapper frame (header included) at a time, in buffer.
+ */
 int tcp_server_init(data_handler data_func, conn_handler conn_func, memory_t *buffer, int tcp_port);
 
 #endif // TCP_SERVER_H
@@ -1,5 +1,5 @@
 
 LOCAL_DIR = $(call my-dir)/
 
-SOURCES += $(addprefix $(LOCAL_DIR), os_util.c bitfield.c clock.c)
+SOURCES += $(addprefix $(LOCAL_DIR), os_util.c bitfield.c clock.c slot_alloc.c calendar.c admission.c mapped_file.c event_log.c timeseries.c work_pool.c executor.c capture.c)
 
@@ -0,0 +1,161 @@
+/**
+ * Per-client admission control: token buckets on APDUs/s and bytes/s in a fixed-size hash table
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "admission.h"
+
+#define ADM_MILLI   1000ULL
+
+int adm_init(adm_table *table, adm_entry *entries, uint32_t nb_entries, const adm_limit *apdus, const adm_limit *bytes, uint32_t max_delay_ms)
+{
+    int valid = (nb_entries > 0U) && ((nb_entries & (nb_entries - 1U)) == 0U);
+
+    if (valid)
+    {
+        memset(table, 0, sizeof(*table));
+        memset(entries, 0, nb_entries * sizeof(adm_entry));
+        table->entries = entries;
+        table->nb_entries = nb_entries;
+        table->apdus = *apdus;
+        table->bytes = *bytes;
+        table->max_delay_ms = max_delay_ms;
+    }
+    return valid;
+}
+
+uint64_t adm_key(const uint8_t *address, uint32_t size, uint16_t sap)
+{
+    // FNV-1a 64
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        hash = (hash ^ address[i]) * 1099511628211ULL;
+    }
+    hash = (hash ^ (sap >> 8U)) * 1099511628211ULL;
+    hash = (hash ^ (sap & 0xFFU)) * 1099511628211ULL;
+
+    return (hash != 0ULL) ? hash : 1ULL;
+}
+
+// Time to refill a whole bucket
+static uint64_t adm_refill_ms(const adm_limit *limit)
+{
+    return (limit->rate > 0U) ? ((((uint64_t)limit->burst * ADM_MILLI) + limit->rate - 1U) / limit->rate) : 0U;
+}
+
+static adm_entry *adm_lookup(adm_table *table, uint64_t key, uint64_t now_ms)
+{
+    uint64_t idle_ms = adm_refill_ms(&table->apdus);
+    uint64_t bytes_idle_ms = adm_refill_ms(&table->bytes);
+    adm_entry *found = NULL;
+    adm_entry *victim = NULL;
+
+    idle_ms = (bytes_idle_ms > idle_ms) ? bytes_idle_ms : idle_ms;
+
+    for (uint32_t i = 0U; (i < ADM_MAX_PROBES) && (i < table->nb_entries); i++)
+    {
+        adm_entry *entry = &table->entries[(uint32_t)(key + i) & (table->nb_entries - 1U)];
+
+        if (entry->key == key)
+        {
+            found = entry;
+            break;
+        }
+
+        // Slots are never emptied, so the client cannot be further than a free slot
+        if (entry->key == 0ULL)
+        {
+            victim = entry;
+            break;
+        }
+
+        if (((now_ms - entry->last_ms) >= idle_ms) && ((victim == NULL) || (entry->last_ms < victim->last_ms)))
+        {
+            victim = entry;
+        }
+    }
+
+    if ((found == NULL) && (victim != NULL))
+    {
+        found = victim;
+        found->key = key;
+        found->last_ms = now_ms;
+        found->apdu_tokens = (uint64_t)table->apdus.burst * ADM_MILLI;
+        found->byte_tokens = (uint64_t)table->bytes.burst * ADM_MILLI;
+    }
+    return found;
+}
+
+static void adm_refill(uint64_t *tokens, const adm_limit *limit, uint64_t elapsed_ms)
+{
+    uint64_t max = (uint64_t)limit->burst * ADM_MILLI;
+
+    *tokens += elapsed_ms * limit->rate;
+    *tokens = (*tokens < max) ? *tokens : max;
+}
+
+// Wait until the bucket holds 'cost' thousandths of unit, UINT64_MAX if it never will
+static uint64_t adm_wait_ms(uint64_t tokens, const adm_limit *limit, uint64_t cost)
+{
+    uint64_t wait = 0U;
+
+    if (limit->rate == 0U)
+    {
+        wait = 0U;
+    }
+    else if (cost > ((uint64_t)limit->burst * ADM_MILLI))
+    {
+        wait = UINT64_MAX;
+    }
+    else if (tokens < cost)
+    {
+        wait = ((cost - tokens) + limit->rate - 1U) / limit->rate;
+    }
+    return wait;
+}
+
+enum adm_verdict adm_check(adm_table *table, uint64_t key, uint32_t bytes, uint64_t now_ms, uint32_t *delay_ms)
+{
+    enum adm_verdict verdict = ADM_REJECT;
+    adm_entry *entry = adm_lookup(table, key, now_ms);
+
+    if (entry != NULL)
+    {
+        uint64_t elapsed_ms = (now_ms > entry->last_ms) ? (now_ms - entry->last_ms) : 0U;
+        uint64_t byte_cost = (uint64_t)bytes * ADM_MILLI;
+
+        adm_refill(&entry->apdu_tokens, &table->apdus, elapsed_ms);
+        adm_refill(&entry->byte_tokens, &table->bytes, elapsed_ms);
+        entry->last_ms = now_ms;
+
+        uint64_t wait = adm_wait_ms(entry->apdu_tokens, &table->apdus, ADM_MILLI);
+        uint64_t byte_wait = adm_wait_ms(entry->byte_tokens, &table->bytes, byte_cost);
+        wait = (byte_wait > wait) ? byte_wait : wait;
+
+        if (wait == 0U)
+        {
+            entry->apdu_tokens -= (table->apdus.rate > 0U) ? ADM_MILLI : 0U;
+            entry->byte_tokens -= (table->bytes.rate > 0U) ? byte_cost : 0U;
+            verdict = ADM_ACCEPT;
+        }
+        else if (wait <= table->max_delay_ms)
+        {
+            *delay_ms = (uint32_t)wait;
+            verdict = ADM_DELAY;
+        }
+    }
+
+    table->accepted += (verdict == ADM_ACCEPT) ? 1U : 0U;
+    table->delayed += (verdict == ADM_DELAY) ? 1U : 0U;
+    table->rejected += (verdict == ADM_REJECT) ? 1U : 0U;
+    return verdict;
+}
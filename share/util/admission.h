@@ -0,0 +1,82 @@
+/**
+ * Per-client admission control: token buckets on APDUs/s and bytes/s in a fixed-size hash table
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define ADM_MAX_PROBES      8U      //!< Hash table slots examined for a client
+
+typedef struct
+{
+    uint32_t rate;      //!< Units per second, 0 = no limit
+    uint32_t burst;     //!< Bucket depth, in units
+} adm_limit;
+
+// One per client, the tokens are in thousandths of unit
+typedef struct
+{
+    uint64_t key;       //!< 0 = free slot
+    uint64_t last_ms;
+    uint64_t apdu_tokens;
+    uint64_t byte_tokens;
+} adm_entry;
+
+typedef struct
+{
+    adm_entry *entries;
+    uint32_t nb_entries;    //!< Power of two
+    adm_limit apdus;
+    adm_limit bytes;
+    uint32_t max_delay_ms;  //!< Longer waits are rejected
+    uint32_t accepted;
+    uint32_t delayed;
+    uint32_t rejected;
+} adm_table;
+
+enum adm_verdict
+{
+    ADM_ACCEPT,     //!< Tokens consumed, process now
+    ADM_DELAY,      //!< Not enough tokens yet, check again after the delay
+    ADM_REJECT      //!< Drop the traffic (or refuse the connection)
+};
+
+/**
+ * @brief Initialize an empty table, the storage is provided by the caller (static allocation)
+ * @return 0 if nb_entries is not a power of two
+ */
+int adm_init(adm_table *table, adm_entry *entries, uint32_t nb_entries, const adm_limit *apdus, const adm_limit *bytes, uint32_t max_delay_ms);
+
+// Client identifier: network address (any size) and client SAP, never 0
+uint64_t adm_key(const uint8_t *address, uint32_t size, uint16_t sap);
+
+/**
+ * @brief Admission of one APDU of 'bytes' bytes from a client, before any decoding
+ *
+ * Known clients keep their state; a new client takes a free slot, or the slot of a client idle long
+ * enough for its buckets to be full again. When none is available the client is rejected: a flood
+ * of new addresses cannot evict the clients being limited.
+ *
+ * @param now_ms: monotonic time in milliseconds
+ * @param delay_ms: wait before the next check, set for ADM_DELAY
+ */
+enum adm_verdict adm_check(adm_table *table, uint64_t key, uint32_t bytes, uint64_t now_ms, uint32_t *delay_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADMISSION_H
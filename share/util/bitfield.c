@@ -6,6 +6,7 @@
  * See README for more details.
  */
 
+#include <string.h>
 #include "os_util.h"
 #include "bitfield.h"
 
@@ -50,23 +51,27 @@ int bitfield_is_set(struct bitfield *bf, size_t bit)
 
 static int first_zero(uint8_t val)
 {
-	int i;
-	for (i = 0; i < 8; i++)
-	{
-		if (!(val & 0x01))
-		{
-			return i;
-		}
-		val >>= 1;
-	}
-	return -1;
+	return (val == 0xFFU) ? -1 : (int)ctz64((uint8_t)~val);
 }
 
 
 int bitfield_get_first_zero(struct bitfield *bf)
 {
-	size_t i;
-    for (i = 0; i < BF_BYTE_ARRAY_SIZE(bf->max_bits); i++)
+	size_t i = 0;
+	size_t size = BF_BYTE_ARRAY_SIZE(bf->max_bits);
+
+	// Skip the full bytes 8 at a time, the byte order does not matter for this test
+	while ((i + 8) <= size)
+	{
+		uint64_t word;
+		memcpy(&word, &bf->bits[i], sizeof(word));
+		if (word != ~0ULL)
+		{
+			break;
+		}
+		i += 8;
+	}
+    for (; i < size; i++)
     {
 		if (bf->bits[i] != 0xff)
 		{
@@ -0,0 +1,226 @@
+/**
+ * Calendar queue (timer wheel) and jittered scheduling of push windows and poll jobs
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "calendar.h"
+#include "clock.h"
+#include "os_util.h"
+
+#define CAL_BIT(n)      (1ULL << ((n) & 63U))
+
+int cal_init(cal_queue *q, cal_bucket *buckets, uint64_t *map, uint32_t nb_buckets, cal_node *nodes, uint32_t nb_nodes, uint32_t shift, uint32_t now)
+{
+    int valid = (nb_buckets > 0U) && ((nb_buckets & (nb_buckets - 1U)) == 0U) && (shift < 32U);
+
+    if (valid)
+    {
+        q->buckets = buckets;
+        q->map = map;
+        q->nodes = nodes;
+        q->nb_buckets = nb_buckets;
+        q->nb_nodes = nb_nodes;
+        q->shift = shift;
+        q->cursor = now >> shift;
+        q->count = 0U;
+
+        for (uint32_t i = 0U; i < nb_buckets; i++)
+        {
+            buckets[i].head = CAL_NONE;
+            buckets[i].tail = CAL_NONE;
+        }
+        memset(map, 0, CAL_MAP_WORDS(nb_buckets) * sizeof(uint64_t));
+
+        for (uint32_t i = 0U; i < nb_nodes; i++)
+        {
+            nodes[i].queued = 0U;
+        }
+    }
+    return valid;
+}
+
+static inline uint32_t cal_bucket_of(const cal_queue *q, uint32_t due)
+{
+    uint32_t slot = due >> q->shift;
+
+    // Late jobs go to the current bucket
+    if ((int32_t)(slot - q->cursor) < 0)
+    {
+        slot = q->cursor;
+    }
+    return slot & (q->nb_buckets - 1U);
+}
+
+int cal_insert(cal_queue *q, uint32_t job, uint32_t due)
+{
+    int valid = (job < q->nb_nodes) && !q->nodes[job].queued;
+
+    if (valid)
+    {
+        uint32_t b = cal_bucket_of(q, due);
+        cal_node *node = &q->nodes[job];
+
+        node->due = due;
+        node->next = CAL_NONE;
+        node->prev = q->buckets[b].tail;
+        node->queued = b + 1U;      // Bucket is remembered, the cursor may have moved since the insertion
+
+        if (q->buckets[b].tail != CAL_NONE)
+        {
+            q->nodes[q->buckets[b].tail].next = job;
+        }
+        else
+        {
+            q->buckets[b].head = job;
+            q->map[b >> 6U] |= CAL_BIT(b);
+        }
+        q->buckets[b].tail = job;
+        q->count++;
+    }
+    return valid;
+}
+
+int cal_remove(cal_queue *q, uint32_t job)
+{
+    int valid = (job < q->nb_nodes) && q->nodes[job].queued;
+
+    if (valid)
+    {
+        cal_node *node = &q->nodes[job];
+        uint32_t b = node->queued - 1U;
+
+        if (node->prev != CAL_NONE)
+        {
+            q->nodes[node->prev].next = node->next;
+        }
+        else
+        {
+            q->buckets[b].head = node->next;
+        }
+
+        if (node->next != CAL_NONE)
+        {
+            q->nodes[node->next].prev = node->prev;
+        }
+        else
+        {
+            q->buckets[b].tail = node->prev;
+        }
+
+        if (q->buckets[b].head == CAL_NONE)
+        {
+            q->map[b >> 6U] &= ~CAL_BIT(b);
+        }
+        node->queued = 0U;
+        q->count--;
+    }
+    return valid;
+}
+
+int cal_is_queued(const cal_queue *q, uint32_t job)
+{
+    return (job < q->nb_nodes) && q->nodes[job].queued;
+}
+
+// Distance to the next non-empty bucket after b, a whole turn if b is the only one
+static uint32_t cal_next_distance(const cal_queue *q, uint32_t b)
+{
+    uint32_t d = 1U;
+
+    while (d < q->nb_buckets)
+    {
+        uint32_t i = (b + d) & (q->nb_buckets - 1U);
+        uint64_t word = q->map[i >> 6U] >> (i & 63U);
+
+        if (word != 0ULL)
+        {
+            d += ctz64(word);
+            break;
+        }
+
+        // Up to the end of the word or of the map
+        uint32_t step = 64U - (i & 63U);
+        d += (step < (q->nb_buckets - i)) ? step : (q->nb_buckets - i);
+    }
+    return (d < q->nb_buckets) ? d : q->nb_buckets;
+}
+
+uint32_t cal_pop(cal_queue *q, uint32_t now)
+{
+    uint32_t target = now >> q->shift;
+    uint32_t found = CAL_NONE;
+
+    while ((q->count > 0U) && (found == CAL_NONE))
+    {
+        uint32_t b = q->cursor & (q->nb_buckets - 1U);
+
+        // The bucket may also hold jobs of the next turns
+        for (uint32_t job = q->buckets[b].head; job != CAL_NONE; job = q->nodes[job].next)
+        {
+            if ((int32_t)(q->nodes[job].due - now) <= 0)
+            {
+                found = job;
+                (void) cal_remove(q, job);
+                break;
+            }
+        }
+
+        uint32_t remaining = target - q->cursor;
+        if ((found == CAL_NONE) && ((int32_t)remaining > 0))
+        {
+            uint32_t d = cal_next_distance(q, b);
+            q->cursor += (d < remaining) ? d : remaining;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if ((q->count == 0U) && ((int32_t)(target - q->cursor) > 0))
+    {
+        q->cursor = target;
+    }
+    return found;
+}
+
+uint32_t cal_jitter_offset(const uint8_t *id, uint32_t size, uint32_t window)
+{
+    // FNV-1a, then a final mix so that close identifiers (serial numbers) are not clustered
+    uint32_t hash = 2166136261U;
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        hash = (hash ^ id[i]) * 16777619U;
+    }
+    hash ^= hash >> 16U;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13U;
+
+    // Multiply-shift instead of a modulo: uniform over the window
+    return (uint32_t)(((uint64_t)hash * window) >> 32U);
+}
+
+uint32_t cal_next_due(uint32_t now, uint32_t period, uint32_t offset)
+{
+    uint32_t due = now + 1U;
+
+    if (period > 0U)
+    {
+        uint32_t local = clk_tz_local(now, NULL);
+        uint32_t next = ((local / period) * period) + (offset % period);
+
+        if (next <= local)
+        {
+            next += period;
+        }
+        due = now + (next - local);
+    }
+    return due;
+}
@@ -0,0 +1,104 @@
+/**
+ * Calendar queue (timer wheel) and jittered scheduling of push windows and poll jobs
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define CAL_NONE                0xFFFFFFFFU
+
+// Storage of the non-empty bucket map, in 64-bit words
+#define CAL_MAP_WORDS(buckets)  (((buckets) + 63U) / 64U)
+
+typedef struct
+{
+    uint32_t head;
+    uint32_t tail;
+} cal_bucket;
+
+// One per job, the job identifier is the index in the node array
+typedef struct
+{
+    uint32_t next;
+    uint32_t prev;
+    uint32_t due;
+    uint32_t queued;
+} cal_node;
+
+/**
+ * @brief Calendar queue of jobs keyed by due time (seconds)
+ *
+ * Bucket i holds the jobs due in the slots i, i + nb_buckets, ... of (1 << shift) seconds. Insert and
+ * remove are O(1), pop is O(1) amortized when the buckets cover the scheduling horizon
+ * (nb_buckets << shift seconds): beyond it, the jobs wait in their bucket for the next turns.
+ */
+typedef struct
+{
+    cal_bucket *buckets;
+    uint64_t *map;          //!< One bit per bucket, 1 = not empty
+    cal_node *nodes;
+    uint32_t nb_buckets;    //!< Power of two
+    uint32_t nb_nodes;
+    uint32_t shift;         //!< Bucket width is 1 << shift seconds
+    uint32_t cursor;        //!< Current slot (time >> shift)
+    uint32_t count;
+} cal_queue;
+
+/**
+ * @brief Initialize an empty queue, the storage is provided by the caller (static allocation)
+ * @return 0 if nb_buckets is not a power of two
+ */
+int cal_init(cal_queue *q, cal_bucket *buckets, uint64_t *map, uint32_t nb_buckets, cal_node *nodes, uint32_t nb_nodes, uint32_t shift, uint32_t now);
+
+// Schedule a job (not already queued); a due time in the past makes it due at the next pop
+int cal_insert(cal_queue *q, uint32_t job, uint32_t due);
+
+// Unschedule a job, return 0 if it was not queued
+int cal_remove(cal_queue *q, uint32_t job);
+
+int cal_is_queued(const cal_queue *q, uint32_t job);
+
+// Return one job due at 'now' (removed from the queue), CAL_NONE if there is none
+uint32_t cal_pop(cal_queue *q, uint32_t now);
+
+static inline uint32_t cal_count(const cal_queue *q)
+{
+    return q->count;
+}
+
+// ----------------------------------- JITTER -----------------------------------
+
+/**
+ * @brief Deterministic offset of a device in [0, window[
+ *
+ * The identifier (system title, SAP, serial number...) is hashed so that a population of devices is
+ * spread uniformly over the window, and the same device always gets the same offset.
+ */
+uint32_t cal_jitter_offset(const uint8_t *id, uint32_t size, uint32_t window);
+
+/**
+ * @brief Next occurrence, strictly after 'now', of a periodic job with an offset
+ *
+ * The periods are aligned on the local time (see clk_tz_local()): with a 86400 s period and an offset
+ * from cal_jitter_offset(), each device gets its own time after local midnight.
+ */
+uint32_t cal_next_due(uint32_t now, uint32_t period, uint32_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CALENDAR_H
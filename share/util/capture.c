@@ -0,0 +1,134 @@
+/**
+ * Binary capture of the transport frames, for offline replay
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include "capture.h"
+#include "os_util.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+int cap_create(cap_file *cap, const char *path, uint8_t link, uint64_t start_us)
+{
+    uint8_t header[CAP_HEADER_SIZE];
+    FILE *file = fopen(path, "wb");
+    int valid = (file != NULL);
+
+    PUT_BE32(&header[0], CAP_MAGIC);
+    PUT_BE16(&header[4], CAP_VERSION);
+    header[6] = link;
+    header[7] = 0U;
+    PUT_BE64(&header[8], start_us);
+    valid = valid && (fwrite(header, 1U, CAP_HEADER_SIZE, file) == CAP_HEADER_SIZE);
+
+    cap->file = file;
+    cap->link = link;
+    cap->start_us = start_us;
+    cap->last_us = start_us;
+    if (!valid)
+    {
+        cap_close(cap);
+    }
+    return valid;
+}
+
+int cap_write(cap_file *cap, uint64_t time_us, uint8_t direction, uint32_t channel, const uint8_t *frame, uint32_t size)
+{
+    uint8_t header[CAP_RECORD_SIZE];
+    uint64_t delta = (time_us > cap->last_us) ? (time_us - cap->last_us) : 0U;
+    int valid = (cap->file != NULL) && (size <= 0xFFFFU);
+
+    if (delta > 0xFFFFFFFFU)
+    {
+        delta = 0xFFFFFFFFU;
+    }
+    PUT_BE32(&header[0], (uint32_t)delta);
+    PUT_BE32(&header[4], channel);
+    PUT_BE16(&header[8], (uint16_t)size);
+    header[10] = direction;
+    header[11] = 0U;
+
+    valid = valid && (fwrite(header, 1U, CAP_RECORD_SIZE, (FILE *)cap->file) == CAP_RECORD_SIZE);
+    valid = valid && (fwrite(frame, 1U, size, (FILE *)cap->file) == size);
+    if (valid)
+    {
+        // The reader rebuilds the same time from the deltas
+        cap->last_us += delta;
+    }
+    return valid;
+}
+
+int cap_flush(cap_file *cap)
+{
+    return (cap->file != NULL) && (fflush((FILE *)cap->file) == 0);
+}
+
+int cap_open(cap_file *cap, const char *path)
+{
+    uint8_t header[CAP_HEADER_SIZE];
+    FILE *file = fopen(path, "rb");
+    int valid = (file != NULL);
+
+    cap->file = file;
+    valid = valid && (fread(header, 1U, CAP_HEADER_SIZE, file) == CAP_HEADER_SIZE);
+    valid = valid && (GET_BE32(&header[0]) == CAP_MAGIC) && (GET_BE16(&header[4]) == CAP_VERSION);
+    valid = valid && ((header[6] == CAP_LINK_WRAPPER) || (header[6] == CAP_LINK_HDLC));
+
+    if (valid)
+    {
+        cap->link = header[6];
+        cap->start_us = GET_BE64(&header[8]);
+        cap->last_us = cap->start_us;
+    }
+    else
+    {
+        cap_close(cap);
+    }
+    return valid;
+}
+
+int cap_read(cap_file *cap, cap_record *record, uint8_t *frame, uint32_t max_size)
+{
+    uint8_t header[CAP_RECORD_SIZE];
+    int ret = -1;
+    size_t size = (cap->file != NULL) ? fread(header, 1U, CAP_RECORD_SIZE, (FILE *)cap->file) : 0U;
+
+    if ((size == 0U) && (cap->file != NULL) && feof((FILE *)cap->file))
+    {
+        // Clean end, between two records
+        ret = 0;
+    }
+    else if (size == CAP_RECORD_SIZE)
+    {
+        cap->last_us += GET_BE32(&header[0]);
+        record->time_us = cap->last_us;
+        record->channel = GET_BE32(&header[4]);
+        record->size = GET_BE16(&header[8]);
+        record->direction = header[10];
+
+        if ((record->size <= max_size) && (fread(frame, 1U, record->size, (FILE *)cap->file) == record->size))
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
+
+void cap_close(cap_file *cap)
+{
+    if (cap->file != NULL)
+    {
+        fclose((FILE *)cap->file);
+        cap->file = NULL;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * Binary capture of the transport frames, for offline replay
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * File layout, integers in big endian:
+ *
+ * Header (16 bytes): magic "CAP1", version (u16), link (u8), reserved (u8), start time (u64, epoch microseconds)
+ * Records:           delta time (u32, microseconds since the previous record, saturated), channel (u32),
+ *                    size (u16), direction (u8), reserved (u8), then the frame
+ */
+#define CAP_MAGIC           0x43415031U     // "CAP1"
+#define CAP_VERSION         1U
+#define CAP_HEADER_SIZE     16U
+#define CAP_RECORD_SIZE     12U
+
+enum cap_link { CAP_LINK_WRAPPER = 1, CAP_LINK_HDLC = 2 };
+
+// Seen from the server
+enum cap_direction { CAP_RX = 0, CAP_TX = 1 };
+
+typedef struct
+{
+    void *file;         //!< FILE handle
+    uint8_t link;
+    uint64_t start_us;
+    uint64_t last_us;   //!< Time of the last record written or read
+} cap_file;
+
+typedef struct
+{
+    uint64_t time_us;   //!< Absolute time, epoch microseconds
+    uint32_t channel;   //!< Transport specific, eg: meter number
+    uint16_t size;
+    uint8_t direction;
+} cap_record;
+
+// Create or truncate a capture file
+int cap_create(cap_file *cap, const char *path, uint8_t link, uint64_t start_us);
+
+/**
+ * @brief Append one frame
+ *
+ * Not thread safe, records must be written in time order. The data is buffered, see cap_flush().
+ */
+int cap_write(cap_file *cap, uint64_t time_us, uint8_t direction, uint32_t channel, const uint8_t *frame, uint32_t size);
+int cap_flush(cap_file *cap);
+
+// Open an existing capture file for reading, the header is checked
+int cap_open(cap_file *cap, const char *path);
+
+/**
+ * @brief Read the next record and its frame
+ * @return 1 for a record, 0 at the end of the file, -1 on a truncated record, a frame larger than max_size or a read error
+ */
+int cap_read(cap_file *cap, cap_record *record, uint8_t *frame, uint32_t max_size);
+
+void cap_close(cap_file *cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAPTURE_H
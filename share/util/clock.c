@@ -1,3 +1,4 @@
+#include <string.h>
 #include "clock.h"
 #include "csm_array.h"
 
@@ -54,10 +55,6 @@ static void scalar_to_ymd (uint32_t scalar,
                uint32_t *pday) {
   uint32_t n; // compute inverse of years_to_days()
 
-  n = (uint32_t)((scalar * 400L) / 146097L);
-  while ((uint32_t)years_to_days(n) < scalar) {
-    n++;
-  }
   for ( n = (uint32_t)((scalar * 400L) / 146097L); (uint32_t)years_to_days(n) < scalar; )
     n++; // 146097 == years_to_days(400)
   *pyr = n;
@@ -65,7 +62,7 @@ static void scalar_to_ymd (uint32_t scalar,
   if ( n > 59 ) { // adjust if past February
     n += 2;
     if ( isleap(*pyr) )
-      n -= n > 61 ? 1 : 2;
+      n -= n > 62 ? 1 : 2;
   }
   *pmo = (n * 100 + 3007) / 3057; // inverse of months_to_days()
   *pday = n - months_to_days(*pmo);
@@ -346,16 +343,185 @@ int add_time(uint32_t basehrs, uint32_t basemins, uint32_t basesecs,
 }
 
 /*
-**  Encode DST rules here - defaults to standard U.S. rules.
+**  Time zone and DST rules, in the style of the COSEM Clock object (class 8, attributes 3 and 5 to 8).
+**  The transitions are precomputed per year, so that the DST checks are a table lookup.
+**  Defaults to the U.S. rules: first Sunday of April to last Sunday of October, 02:00 local time.
+**  The table is written by clk_tz_init() only, never on first use: the lookups can run in any thread.
 */
 
-uint32_t    DST_start_mo = 4;             /* Month when DST starts      */
-uint32_t    DST_start_dt = 1;             /* Date when it can start     */
-enum DOW_T  DST_start_dy = SUNDAY;        /* Day of week, or DOW_IGNORE */
+#define CLK_SECONDS_PER_DAY     86400U
+
+typedef struct
+{
+    uint32_t start;         //!< January 1st 00:00 UTC, epoch seconds
+    uint32_t begin;         //!< DST begin, UTC epoch seconds
+    uint32_t end;           //!< DST end, UTC epoch seconds
+    uint16_t begin_day;     //!< Local day of the year of the transitions (1 - 366)
+    uint16_t end_day;
+} clk_tz_year;
+
+static clk_tz_rules tz_rules;
+static clk_tz_year tz_table[CLK_TZ_NB_YEARS];
+static int tz_ready = FALSE;
+
+static const clk_tz_rules cTzDefaultRules =
+{
+    0,                                                          // time_zone
+    { { 1U, 7U, 4U, 0xFFFFU }, { 0U, 0U, 0U, 2U }, 0, 0U },     // First Sunday on or after April 1st, 02:00
+    { { 0xFEU, 7U, 10U, 0xFFFFU }, { 0U, 0U, 0U, 2U }, 0, 0U }, // Last Sunday of October, 02:00
+    60,                                                         // dst_deviation
+    TRUE                                                        // dst_enabled
+};
+
+static uint32_t clk_days_in_month(uint32_t yr, uint32_t mo)
+{
+    return days[mo - 1U] + ((2U == mo) && isleap(yr));
+}
+
+// Day of the month of a transition rule for a given year; the rule day may be 0xFE (last) or 0xFD (second last)
+static uint32_t clk_tz_rule_day(const clk_date_t *rule, uint32_t yr)
+{
+    uint32_t last = clk_days_in_month(yr, rule->month);
+    uint32_t day = rule->day;
+    int backward = FALSE;
+
+    if (day == 0xFEU)
+    {
+        day = last;
+        backward = TRUE;
+    }
+    else if (day == 0xFDU)
+    {
+        day = last - 1U;
+        backward = TRUE;
+    }
+    else if ((day == 0U) || (day > last))
+    {
+        day = last;
+    }
+
+    // Move to the required day of week (1 = Monday), forward except from the end of the month
+    if ((rule->dow >= 1U) && (rule->dow <= 7U))
+    {
+        uint32_t dow = clk_dow(yr, rule->month, day) + 1U;
+        if (backward)
+        {
+            day -= (dow + 7U - rule->dow) % 7U;
+        }
+        else
+        {
+            day += (rule->dow + 7U - dow) % 7U;
+            if (day > last)
+            {
+                day -= 7U;
+            }
+        }
+    }
+    return day;
+}
+
+// UTC instant of a transition; local_deviation is the deviation in force just before it, in minutes
+static uint32_t clk_tz_transition(const clk_datetime_t *rule, uint32_t yr, int32_t local_deviation, uint16_t *day_of_year)
+{
+    uint32_t day = clk_tz_rule_day(&rule->date, yr);
+    uint32_t scalar = ymd_to_scalar(yr, rule->date.month, day);
+    uint32_t hour = (rule->time.hour < 24U) ? rule->time.hour : 0U;
+    uint32_t minute = (rule->time.minute < 60U) ? rule->time.minute : 0U;
+    int64_t local = ((int64_t)(scalar - ymd_to_scalar(1970U, 1U, 1U)) * CLK_SECONDS_PER_DAY) + (hour * 3600U) + (minute * 60U);
+
+    *day_of_year = (uint16_t)(scalar - ymd_to_scalar(yr, 1U, 1U) + 1U);
+
+    // Time zone convention of the Clock object: local time = UTC - time_zone
+    int64_t utc = local + ((int64_t)local_deviation * 60);
+    return (utc < 0) ? 0U : (uint32_t)utc;
+}
+
+static int clk_tz_rule_valid(const clk_datetime_t *rule)
+{
+    return clk_is_valid_month(rule->date.month) &&
+           ((rule->date.day <= 31U) || (rule->date.day == 0xFDU) || (rule->date.day == 0xFEU));
+}
+
+static void clk_tz_fill(const clk_tz_rules *rules, uint32_t i, clk_tz_year *y)
+{
+    uint32_t yr = CLK_TZ_FIRST_YEAR + i;
+
+    y->start = (ymd_to_scalar(yr, 1U, 1U) - ymd_to_scalar(1970U, 1U, 1U)) * CLK_SECONDS_PER_DAY;
+
+    if (rules->dst_enabled)
+    {
+        // Begin is given in standard time, end in summer time
+        y->begin = clk_tz_transition(&rules->dst_begin, yr, rules->time_zone, &y->begin_day);
+        y->end = clk_tz_transition(&rules->dst_end, yr, rules->time_zone - rules->dst_deviation, &y->end_day);
+    }
+    else
+    {
+        y->begin = 0U;
+        y->end = 0U;
+        y->begin_day = 0U;
+        y->end_day = 0U;
+    }
+}
+
+// Rules in use: the default ones are evaluated on each call until clk_tz_init(), nothing is written
+static const clk_tz_rules *clk_tz_current(void)
+{
+    return tz_ready ? &tz_rules : &cTzDefaultRules;
+}
+
+static const clk_tz_year *clk_tz_year_get(uint32_t i, clk_tz_year *tmp)
+{
+    const clk_tz_year *y = &tz_table[i];
+
+    if (!tz_ready)
+    {
+        clk_tz_fill(&cTzDefaultRules, i, tmp);
+        y = tmp;
+    }
+    return y;
+}
+
+void clk_tz_init(const clk_tz_rules *rules)
+{
+    tz_rules = (rules != NULL) ? *rules : cTzDefaultRules;
+
+    if (!clk_tz_rule_valid(&tz_rules.dst_begin) || !clk_tz_rule_valid(&tz_rules.dst_end))
+    {
+        tz_rules.dst_enabled = FALSE;
+    }
+
+    for (uint32_t i = 0U; i < CLK_TZ_NB_YEARS; i++)
+    {
+        clk_tz_fill(&tz_rules, i, &tz_table[i]);
+    }
+    tz_ready = TRUE;
+}
+
+void clk_tz_get_rules(clk_tz_rules *rules)
+{
+    *rules = *clk_tz_current();
+}
+
+int clk_tz_transitions(uint32_t yr, uint32_t *begin, uint32_t *end)
+{
+    int ret = FALSE;
 
-uint32_t    DST_stop_mo = 10;             /* Month when DST stops       */
-uint32_t    DST_stop_dt = 31;             /* Date when it can stop      */
-enum DOW_T  DST_stop_dy = SUNDAY;         /* Day of week, or DOW_IGNORE */
+    if (clk_tz_current()->dst_enabled && (yr >= CLK_TZ_FIRST_YEAR) && (yr < (CLK_TZ_FIRST_YEAR + CLK_TZ_NB_YEARS)))
+    {
+        clk_tz_year tmp;
+        const clk_tz_year *y = clk_tz_year_get(yr - CLK_TZ_FIRST_YEAR, &tmp);
+        *begin = y->begin;
+        *end = y->end;
+        ret = TRUE;
+    }
+    return ret;
+}
+
+// Northern hemisphere: begin < end within the year; southern: DST spans the new year
+static int clk_tz_in_range(uint32_t value, uint32_t begin, uint32_t end)
+{
+    return (begin <= end) ? ((value >= begin) && (value < end)) : ((value >= begin) || (value < end));
+}
 
 /*
 **  clk_is_dst()
@@ -363,12 +529,8 @@ enum DOW_T  DST_stop_dy = SUNDAY;         /* Day of week, or DOW_IGNORE */
 **  Parameters: 1 - Year of interest.
 **              2 - Month to check.
 **              3 - Day to check.
-**              4 - Pointer to storage for scalar date representation of
-**                  the year's DST start date.
-**              5 - Pointer to storage for scalar date representation of
-**                  the year's DST stop date.
 **
-**  Returns: 1 if date is in DST range
+**  Returns: 1 if date is in DST range (day granularity, local date)
 **           0 if date is not in DST  range
 **           -1 if date is invalid,
 */
@@ -377,34 +539,71 @@ int clk_is_dst(uint32_t  yr,
             uint32_t  mo,
             uint32_t  dy)
 {
-      uint32_t date;
-      uint32_t Start;
-      uint32_t Stop;
+    int ret = 0;
 
-      if (!clk_is_valid_date(yr, mo, dy))
-            return -1;
-      else  date = ymd_to_scalar(yr, mo, dy);
+    if (!clk_is_valid_date(yr, mo, dy))
+    {
+        return -1;
+    }
 
-      Start = ymd_to_scalar(yr, DST_start_mo, DST_start_dt);
-      Stop  = ymd_to_scalar(yr, DST_stop_mo, DST_stop_dt);
+    if (clk_tz_current()->dst_enabled && (yr >= CLK_TZ_FIRST_YEAR) && (yr < (CLK_TZ_FIRST_YEAR + CLK_TZ_NB_YEARS)))
+    {
+        clk_tz_year tmp;
+        const clk_tz_year *y = clk_tz_year_get(yr - CLK_TZ_FIRST_YEAR, &tmp);
+        ret = clk_tz_in_range(clk_daynum(yr, mo, dy), y->begin_day, y->end_day);
+    }
+    return ret;
+}
 
-      if (DST_start_dy != DOW_IGNORE)
-      {
-            while (DST_start_dy != (enum DOW_T)(Start % 7U))
-            {
-                  ++Start;
-            }
-      }
+int clk_is_dst_utc(uint32_t utc)
+{
+    int ret = 0;
 
-      if (DST_stop_dy != DOW_IGNORE)
-      {
-            while (DST_stop_dy != (enum DOW_T)(Stop % 7U))
+    if (clk_tz_current()->dst_enabled)
+    {
+        clk_tz_year tmp;
+        clk_tz_year next;
+        // Estimate the year, then correct it with the year starts
+        uint32_t index = utc / 31556952U; // Average Gregorian year
+        index = (index > (CLK_TZ_FIRST_YEAR - 1970U)) ? (index - (CLK_TZ_FIRST_YEAR - 1970U)) : 0U;
+        index = (index < CLK_TZ_NB_YEARS) ? index : (CLK_TZ_NB_YEARS - 1U);
+
+        const clk_tz_year *y = clk_tz_year_get(index, &tmp);
+        if ((index > 0U) && (utc < y->start))
+        {
+            index--;
+            y = clk_tz_year_get(index, &tmp);
+        }
+        else if ((index + 1U) < CLK_TZ_NB_YEARS)
+        {
+            const clk_tz_year *n = clk_tz_year_get(index + 1U, &next);
+            if (utc >= n->start)
             {
-                  --Stop;
+                index++;
+                y = n;
             }
-      }
+        }
 
-      return ((date >= Start) && (date < Stop));
+        // Outside of the table, no DST
+        if ((utc >= clk_tz_year_get(0U, &next)->start) && (((index + 1U) < CLK_TZ_NB_YEARS) || (utc < (y->start + (366U * CLK_SECONDS_PER_DAY)))))
+        {
+            ret = clk_tz_in_range(utc, y->begin, y->end);
+        }
+    }
+    return ret;
+}
+
+uint32_t clk_tz_local(uint32_t utc, int *dst)
+{
+    const clk_tz_rules *rules = clk_tz_current();
+    int in_dst = clk_is_dst_utc(utc);
+    int32_t deviation = rules->time_zone - (in_dst ? rules->dst_deviation : 0);
+
+    if (dst != NULL)
+    {
+        *dst = in_dst;
+    }
+    return (uint32_t)((int64_t)utc - ((int64_t)deviation * 60));
 }
 
 void clk_cosem_update_status(clk_datetime_t *clk)
@@ -533,6 +732,242 @@ int clk_time_from_cosem(clk_time_t *time, csm_array *array)
     return valid;
 }
 
+/*
+** Batch conversion, based on the days_from_civil() and civil_from_days() algorithms of Howard Hinnant.
+** The loops work on blocks of columns (structure of arrays) without any branch or table, so that the
+** compiler can vectorize the arithmetic; only the gather/scatter of the 12-byte records is scalar.
+*/
+
+#define CLK_BATCH_BLOCK         64U
+#define CLK_DAYS_0000_TO_1970   719468U     // Days from 0000-03-01 to 1970-01-01
+#define CLK_BATCH_MAX_YEAR      2105U       // Last year in the uint32_t epoch range
+
+uint32_t clk_cosem_to_epoch_batch(const uint8_t *cosem, uint32_t stride, uint32_t count, uint32_t *epoch)
+{
+    uint32_t year[CLK_BATCH_BLOCK];
+    uint32_t month[CLK_BATCH_BLOCK];
+    uint32_t day[CLK_BATCH_BLOCK];
+    uint32_t seconds[CLK_BATCH_BLOCK];
+    uint32_t nb_valid = 0U;
+
+    for (uint32_t base = 0U; base < count; base += CLK_BATCH_BLOCK)
+    {
+        uint32_t size = ((count - base) < CLK_BATCH_BLOCK) ? (count - base) : CLK_BATCH_BLOCK;
+        uint32_t valid[CLK_BATCH_BLOCK];
+        uint32_t *out = &epoch[base];
+
+        // Gather the fields
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            const uint8_t *dt = &cosem[(base + i) * stride];
+            uint32_t hour = dt[5];
+            uint32_t minute = dt[6];
+            uint32_t second = dt[7];
+
+            year[i] = ((uint32_t)dt[0] << 8U) | dt[1];
+            month[i] = dt[2];
+            day[i] = dt[3];
+            seconds[i] = (hour * 3600U) + (minute * 60U) + second;
+            valid[i] = (hour < 24U) & (minute < 60U) & (second < 60U);
+        }
+
+        // Compute, no branch
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            uint32_t y = year[i];
+            uint32_t m = month[i];
+            uint32_t d = day[i];
+            // Within [1970, 2105], 2000 is the only 400 years multiple and 2100 the only other century
+            uint32_t leap = ((y & 3U) == 0U) & (y != 2100U);
+            // 31 for Jan, Mar, May, Jul, Aug, Oct, Dec; 30 for the others except February
+            uint32_t dim = (m == 2U) ? (28U + leap) : (30U + ((m + (m >> 3U)) & 1U));
+            uint32_t ok = valid[i] & (y >= 1970U) & (y <= CLK_BATCH_MAX_YEAR) & ((m - 1U) < 12U) & ((d - 1U) < dim);
+
+            // The year starts in March, February is the last month
+            uint32_t after_feb = (m > 2U);
+            uint32_t yy = (y - 1U) + after_feb;
+            uint32_t mp = (m + 9U) - (12U * after_feb);
+            // yy / 100 and yy / 400 reduce to comparisons in the valid range
+            uint32_t centuries = 19U + (yy >= 2000U) + (yy >= 2100U);
+            uint32_t quads = 4U + (yy >= 2000U);
+            uint32_t doy = ((((153U * mp) + 2U) * 52429U) >> 18U) + d - 1U; // (153 * mp + 2) / 5
+            uint32_t days = (365U * yy) + (yy >> 2U) - centuries + quads + doy - CLK_DAYS_0000_TO_1970;
+            uint32_t e = (days * CLK_SECONDS_PER_DAY) + seconds[i];
+
+            // Select without branch: mask is all ones when valid
+            uint32_t mask = 0U - ok;
+            out[i] = (e & mask) | (CLK_EPOCH_INVALID & ~mask);
+            nb_valid += ok;
+        }
+    }
+    return nb_valid;
+}
+
+void clk_epoch_to_cosem_batch(const uint32_t *epoch, uint32_t count, uint8_t *cosem, uint32_t stride, int16_t deviation, uint8_t status)
+{
+    uint32_t year[CLK_BATCH_BLOCK];
+    uint32_t month[CLK_BATCH_BLOCK];
+    uint32_t day[CLK_BATCH_BLOCK];
+    uint32_t dow[CLK_BATCH_BLOCK];
+    uint32_t seconds[CLK_BATCH_BLOCK];
+
+    for (uint32_t base = 0U; base < count; base += CLK_BATCH_BLOCK)
+    {
+        uint32_t size = ((count - base) < CLK_BATCH_BLOCK) ? (count - base) : CLK_BATCH_BLOCK;
+        const uint32_t *in = &epoch[base];
+
+        // Compute, no branch
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            uint32_t e = in[i];
+            uint32_t days = e / CLK_SECONDS_PER_DAY;
+            uint32_t z = days + CLK_DAYS_0000_TO_1970;
+            uint32_t era = z / 146097U;
+            uint32_t doe = z - (era * 146097U);
+            uint32_t yoe = (doe - (doe / 1460U) + (doe / 36524U) - (doe / 146096U)) / 365U;
+            uint32_t doy = doe - ((365U * yoe) + (yoe / 4U) - (yoe / 100U));
+            uint32_t mp = ((5U * doy) + 2U) / 153U;
+            uint32_t m = (mp < 10U) ? (mp + 3U) : (mp - 9U);
+
+            year[i] = yoe + (era * 400U) + (m <= 2U);
+            month[i] = m;
+            day[i] = doy - (((153U * mp) + 2U) / 5U) + 1U;
+            dow[i] = ((days + 3U) % 7U) + 1U; // 1970-01-01 is a Thursday, Monday is 1
+            seconds[i] = e - (days * CLK_SECONDS_PER_DAY);
+        }
+
+        // Scatter the fields
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            uint8_t *dt = &cosem[(base + i) * stride];
+
+            if (in[i] == CLK_EPOCH_INVALID)
+            {
+                // FFFFFFFFFFFFFFFFFF8000FF
+                memset(dt, 0xFF, 9U);
+                dt[9] = 0x80U;
+                dt[10] = 0x00U;
+                dt[11] = 0xFFU;
+            }
+            else
+            {
+                uint32_t s = seconds[i];
+                dt[0] = (uint8_t)(year[i] >> 8U);
+                dt[1] = (uint8_t)year[i];
+                dt[2] = (uint8_t)month[i];
+                dt[3] = (uint8_t)day[i];
+                dt[4] = (uint8_t)dow[i];
+                dt[5] = (uint8_t)(s / 3600U);
+                dt[6] = (uint8_t)((s / 60U) % 60U);
+                dt[7] = (uint8_t)(s % 60U);
+                dt[8] = 0U;
+                dt[9] = (uint8_t)((uint16_t)deviation >> 8U);
+                dt[10] = (uint8_t)deviation;
+                dt[11] = status;
+            }
+        }
+    }
+}
+
+/*
+** Sortable keys. The conversion works on the raw octets, the wildcards are resolved with selections so
+** that the filter loop has no branch depending on the data.
+*/
+
+#define CLK_KEY_SHIFT   7U      // Room for the hundredths
+
+static uint64_t clk_key_from_fields(uint32_t y, uint32_t m, uint32_t d, uint32_t h, uint32_t mi, uint32_t s,
+                                    uint32_t hs, uint32_t deviation, uint32_t upper)
+{
+    uint32_t wild_year = (y == 0xFFFFU) | (y == 0U);
+    uint32_t wild_month = ((m - 1U) >= 12U);            // 0xFF, 0xFE and 0xFD (DST begin/end)
+    m = wild_month ? (upper ? 12U : 1U) : m;
+
+    uint32_t leap = ((y % 4U) == 0U) & (((y % 100U) != 0U) | ((y % 400U) == 0U));
+    uint32_t dim = (m == 2U) ? (28U + leap) : (30U + ((m + (m >> 3U)) & 1U));
+    d = (d == 0xFEU) ? dim : ((d == 0xFDU) ? (dim - 1U) : (((d - 1U) >= 31U) ? (upper ? dim : 1U) : d));
+
+    h = (h >= 24U) ? (upper ? 23U : 0U) : h;
+    mi = (mi >= 60U) ? (upper ? 59U : 0U) : mi;
+    s = (s >= 60U) ? (upper ? 59U : 0U) : s;
+    hs = (hs >= 100U) ? (upper ? 99U : 0U) : hs;
+
+    // days_from_civil(), from 0000-03-01
+    uint32_t after_feb = (m > 2U);
+    uint32_t yy = (y - 1U) + after_feb;
+    uint32_t mp = (m + 9U) - (12U * after_feb);
+    uint32_t days = (365U * yy) + (yy / 4U) - (yy / 100U) + (yy / 400U) + ((((153U * mp) + 2U)) / 5U) + d - 1U;
+
+    // Local time = UTC - deviation
+    int64_t dev = (deviation == 0x8000U) ? 0 : (int64_t)(int16_t)deviation;
+    int64_t seconds = ((int64_t)days * 86400) + (h * 3600U) + (mi * 60U) + s + (dev * 60);
+    uint64_t key = ((uint64_t)seconds << CLK_KEY_SHIFT) | hs;
+
+    return wild_year ? (upper ? CLK_KEY_MAX : CLK_KEY_MIN) : key;
+}
+
+uint64_t clk_cosem_key(const uint8_t *cosem, int upper)
+{
+    return clk_key_from_fields(((uint32_t)cosem[0] << 8U) | cosem[1], cosem[2], cosem[3], cosem[5], cosem[6],
+                               cosem[7], cosem[8], ((uint32_t)cosem[9] << 8U) | cosem[10], upper ? 1U : 0U);
+}
+
+uint64_t clk_epoch_key(uint32_t utc)
+{
+    return ((uint64_t)utc + ((uint64_t)CLK_DAYS_0000_TO_1970 * CLK_SECONDS_PER_DAY)) << CLK_KEY_SHIFT;
+}
+
+uint32_t clk_cosem_filter_range(const uint8_t *cosem, uint32_t stride, uint32_t count, uint64_t from, uint64_t to, uint8_t *match)
+{
+    uint32_t nb_match = 0U;
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        uint64_t key = clk_cosem_key(&cosem[i * stride], FALSE);
+        uint8_t in = (uint8_t)((key >= from) & (key <= to));
+        match[i] = in;
+        nb_match += in;
+    }
+    return nb_match;
+}
+
+static int clk_rd_datetime_key(csm_array *array, int upper, uint64_t *key)
+{
+    uint32_t size = 0U;
+    int valid = csm_axdr_rd_octetstring(array, &size);
+    valid = valid && (size == CLK_COSEM_DATETIME_SIZE) && (csm_array_unread(array) >= CLK_COSEM_DATETIME_SIZE);
+
+    if (valid)
+    {
+        *key = clk_cosem_key(csm_array_rd_data(array), upper);
+        valid = csm_array_reader_jump(array, CLK_COSEM_DATETIME_SIZE);
+    }
+    return valid;
+}
+
+int clk_cosem_range_decode(csm_array *array, uint64_t *from, uint64_t *to)
+{
+    uint8_t byte = 0U;
+    uint32_t size = 0U;
+
+    // access_selector 1, range_descriptor: structure { restricting_object, from_value, to_value, selected_values }
+    int valid = csm_array_read_u8(array, &byte) && (byte == 1U);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == 4U);
+
+    // restricting_object: structure { long-unsigned, octet-string(6), integer, long-unsigned }
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == 4U);
+    valid = valid && csm_array_reader_jump(array, 3U);
+    valid = valid && csm_axdr_rd_octetstring(array, &size) && (size == 6U);
+    valid = valid && csm_array_reader_jump(array, 6U + 2U + 3U);
+
+    valid = valid && clk_rd_datetime_key(array, FALSE, from);
+    valid = valid && clk_rd_datetime_key(array, TRUE, to);
+
+    return valid;
+}
+
 void clk_print_datetime(const clk_datetime_t *clk)
 {
     (void) clk;
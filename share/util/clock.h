@@ -86,7 +86,46 @@ uint32_t clk_weeknum(uint32_t year, uint32_t month, uint32_t day);
 
 uint32_t clk_to_epoch(struct tm *timeptr);
 void clk_to_datetime(const uint32_t timer, struct tm *tms);
+
+// -------------------------------------- TIME ZONE AND DST --------------------------------------
+
+#define CLK_TZ_FIRST_YEAR   2000U
+#define CLK_TZ_NB_YEARS     100U    ///< Transitions are precomputed for the years 2000 - 2099
+
+/**
+ * Time zone rules, same meaning as the Clock object (class 8) attributes.
+ * The DST begin/end date-times accept the COSEM wildcards: day 0xFE (last) or 0xFD (second last) of the
+ * month, dow 1..7 (Monday..Sunday) to select the first such day on or after the day (on or before for
+ * 0xFE/0xFD), 0xFF otherwise. Begin is given in standard local time, end in summer local time.
+ */
+typedef struct
+{
+    int16_t time_zone;          //!< Attribute 3: deviation in minutes, local time = UTC - time_zone
+    clk_datetime_t dst_begin;   //!< Attribute 5
+    clk_datetime_t dst_end;     //!< Attribute 6
+    int8_t dst_deviation;       //!< Attribute 7: minutes added to the local time during DST
+    uint8_t dst_enabled;        //!< Attribute 8
+} clk_tz_rules;
+
+/**
+ * @brief Precompute the DST transitions, NULL installs the default rules (U.S.)
+ *
+ * Call it at startup, before the threads using the lookups below are created: the table is then
+ * only read. Until then, the default rules are evaluated on each call without any shared state.
+ * Changing the rules later must be serialized with the readers by the application.
+ */
+void clk_tz_init(const clk_tz_rules *rules);
+void clk_tz_get_rules(clk_tz_rules *rules);
+
+// UTC epoch seconds of the DST transitions of a year, FALSE if DST is disabled or the year is out of the table
+int clk_tz_transitions(uint32_t yr, uint32_t *begin, uint32_t *end);
+
+// Table lookups: local date (day granularity, -1 if the date is invalid) or UTC instant
 int clk_is_dst(uint32_t yr, uint32_t mo, uint32_t dy);
+int clk_is_dst_utc(uint32_t utc);
+
+// Local time of a UTC instant, dst (optional) receives the DST state
+uint32_t clk_tz_local(uint32_t utc, int *dst);
 
 
 // -------------------------------------- COSEM DATE TIME --------------------------------------
@@ -103,6 +142,57 @@ int clk_datetime_from_cosem(clk_datetime_t *clk, csm_array *array);
 int clk_date_from_cosem(clk_date_t *date, csm_array *array);
 int clk_time_from_cosem(clk_time_t *time, csm_array *array);
 
+// -------------------------------------- BATCH CONVERSION --------------------------------------
+
+#define CLK_COSEM_DATETIME_SIZE     12U
+#define CLK_EPOCH_INVALID           0xFFFFFFFFU
+#define CLK_DEVIATION_UNSPECIFIED   ((int16_t)-32768)   // 0x8000
+
+/**
+ * @brief Convert COSEM date-time octet-strings to epoch seconds
+ *
+ * The date-times are read at 'stride' bytes of interval (12 for a packed array, the row size to read a
+ * column of a profile buffer in place). Like clk_to_epoch(), the fields are taken as they are: deviation
+ * and status are ignored. Wildcards and invalid dates or times give CLK_EPOCH_INVALID.
+ *
+ * @return the number of valid date-times
+ */
+uint32_t clk_cosem_to_epoch_batch(const uint8_t *cosem, uint32_t stride, uint32_t count, uint32_t *epoch);
+
+// Inverse conversion, the day of week is computed, hundredths are zero; CLK_EPOCH_INVALID gives an undefined date-time
+void clk_epoch_to_cosem_batch(const uint32_t *epoch, uint32_t count, uint8_t *cosem, uint32_t stride, int16_t deviation, uint8_t status);
+
+// -------------------------------------- SORTABLE KEYS --------------------------------------
+
+/**
+ * 64-bit key of a COSEM date-time: UTC seconds from 0000-03-01 (deviation applied) shifted by 7 bits,
+ * plus the hundredths. Keys compare like the instants they represent.
+ *
+ * Wildcards are replaced by the lowest value of the field, or the highest one when 'upper' is TRUE, so
+ * that a range bound with wildcards covers the whole unspecified period; day 0xFE/0xFD is the last/second
+ * last day of the month, deviation 0x8000 is taken as zero. A wildcard year gives CLK_KEY_MIN/CLK_KEY_MAX.
+ */
+#define CLK_KEY_MIN     0ULL
+#define CLK_KEY_MAX     0xFFFFFFFFFFFFFFFFULL
+
+uint64_t clk_cosem_key(const uint8_t *cosem, int upper);
+uint64_t clk_epoch_key(uint32_t utc);
+
+/**
+ * @brief Mark the date-times within [from, to] (inclusive, keys from clk_cosem_key)
+ *
+ * The date-times are read at 'stride' bytes of interval, see clk_cosem_to_epoch_batch().
+ * @return the number of matching date-times
+ */
+uint32_t clk_cosem_filter_range(const uint8_t *cosem, uint32_t stride, uint32_t count, uint64_t from, uint64_t to, uint8_t *match);
+
+/**
+ * @brief Decode a range_descriptor selective access (access selector 1) into a key range
+ *
+ * The array starts at the access selector; the restricting object and selected values are skipped.
+ */
+int clk_cosem_range_decode(csm_array *array, uint64_t *from, uint64_t *to);
+
 // Printers
 void clk_print_datetime(const clk_datetime_t *clk);
 void clk_print_date(const clk_date_t *date);
@@ -0,0 +1,378 @@
+/**
+ * Append-only log of fixed-size records with group commit, storage of event and alarm profiles
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "event_log.h"
+#include "csm_axdr_codec.h"
+
+#ifdef USE_UNIX_OS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Superblock: header then the two commit slots
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+} evl_header;
+
+#define EVL_SLOT_OFFSET(i)  (32U + ((i) * (uint32_t)sizeof(evl_commit_slot)))
+
+// ----------------------------------- FILE ACCESS -----------------------------------
+
+#ifdef USE_UNIX_OS
+
+static int evl_file_open(evl_log *log, const char *path)
+{
+    log->fd = open(path, O_RDWR | O_CREAT, 0644);
+    return (log->fd >= 0);
+}
+
+static void evl_file_close(evl_log *log)
+{
+    close(log->fd);
+    log->fd = -1;
+}
+
+static int evl_file_write(const evl_log *log, uint64_t offset, const uint8_t *data, uint32_t size)
+{
+    return (pwrite(log->fd, data, size, (off_t)offset) == (ssize_t)size);
+}
+
+static int evl_file_read(const evl_log *log, uint64_t offset, uint8_t *data, uint32_t size)
+{
+    return (pread(log->fd, data, size, (off_t)offset) == (ssize_t)size);
+}
+
+static int evl_file_sync(const evl_log *log)
+{
+    return (fdatasync(log->fd) == 0);
+}
+
+#else
+
+// Without positioned I/O, reads and writes share the file position: the caller serializes them
+static int evl_file_open(evl_log *log, const char *path)
+{
+    log->file = fopen(path, "r+b");
+    if (log->file == NULL)
+    {
+        log->file = fopen(path, "w+b");
+    }
+    return (log->file != NULL);
+}
+
+static void evl_file_close(evl_log *log)
+{
+    fclose((FILE *)log->file);
+    log->file = NULL;
+}
+
+static int evl_file_write(const evl_log *log, uint64_t offset, const uint8_t *data, uint32_t size)
+{
+    FILE *f = (FILE *)log->file;
+    return (fseek(f, (long)offset, SEEK_SET) == 0) && (fwrite(data, 1U, size, f) == size);
+}
+
+static int evl_file_read(const evl_log *log, uint64_t offset, uint8_t *data, uint32_t size)
+{
+    FILE *f = (FILE *)log->file;
+    return (fseek(f, (long)offset, SEEK_SET) == 0) && (fread(data, 1U, size, f) == size);
+}
+
+static int evl_file_sync(const evl_log *log)
+{
+    return (fflush((FILE *)log->file) == 0);
+}
+
+#endif
+
+// ----------------------------------- COMMIT SLOTS -----------------------------------
+
+static uint32_t evl_slot_checksum(const evl_commit_slot *slot)
+{
+    const uint8_t *data = (const uint8_t *)slot;
+    uint32_t hash = 2166136261U;
+
+    for (uint32_t i = 0U; i < offsetof(evl_commit_slot, checksum); i++)
+    {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+// The tail is the valid slot with the highest sequence
+static void evl_load_tail(evl_log *log)
+{
+    uint64_t committed = 0U;
+    log->sequence = 0U;
+
+    for (uint32_t i = 0U; i < 2U; i++)
+    {
+        evl_commit_slot slot;
+        if (evl_file_read(log, EVL_SLOT_OFFSET(i), (uint8_t *)&slot, sizeof(slot)) &&
+            (slot.checksum == evl_slot_checksum(&slot)) && (slot.sequence >= log->sequence) && (slot.sequence != 0U))
+        {
+            committed = slot.committed;
+            log->sequence = slot.sequence;
+        }
+    }
+    EVL_STORE(log->oldest, (committed > log->capacity) ? (committed - log->capacity) : 0U);
+    EVL_STORE(log->committed, committed);
+}
+
+// ----------------------------------- LOG -----------------------------------
+
+int evl_open(evl_log *log, const char *path, uint32_t record_size, uint32_t capacity, uint8_t *staging, uint32_t staging_max,
+             uint32_t interval_ms)
+{
+    evl_header header;
+    int valid = (record_size > 0U) && (capacity > 0U) && (staging_max > 0U) && (staging_max <= capacity);
+
+    memset(log, 0, sizeof(evl_log));
+    log->fd = -1;
+    log->record_size = record_size;
+    log->capacity = capacity;
+    log->staging = staging;
+    log->staging_max = staging_max;
+    log->interval_ms = interval_ms;
+
+    valid = valid && evl_file_open(log, path);
+
+    if (valid)
+    {
+        if (evl_file_read(log, 0U, (uint8_t *)&header, sizeof(header)))
+        {
+            valid = (header.magic == EVL_MAGIC) && (header.version == EVL_VERSION) &&
+                    (header.record_size == record_size) && (header.capacity == capacity);
+            if (valid)
+            {
+                evl_load_tail(log);
+            }
+        }
+        else
+        {
+            // New log: superblock with empty commit slots
+            uint8_t block[EVL_HEADER_SIZE];
+
+            memset(block, 0, sizeof(block));
+            header.magic = EVL_MAGIC;
+            header.version = EVL_VERSION;
+            header.record_size = record_size;
+            header.capacity = capacity;
+            memcpy(block, &header, sizeof(header));
+            valid = evl_file_write(log, 0U, block, sizeof(block)) && evl_file_sync(log);
+        }
+
+        if (!valid)
+        {
+            evl_file_close(log);
+        }
+    }
+    return valid;
+}
+
+void evl_close(evl_log *log)
+{
+    (void) evl_commit(log);
+    evl_file_close(log);
+}
+
+int evl_append(evl_log *log, const uint8_t *record)
+{
+    int valid = (log->nb_staged < log->staging_max) || evl_seal(log);
+
+    if (valid)
+    {
+        memcpy(&log->staging[((log->active * log->staging_max) + log->nb_staged) * log->record_size], record, log->record_size);
+        log->nb_staged++;
+        log->appends++;
+    }
+    else
+    {
+        log->dropped++;
+    }
+    return valid;
+}
+
+int evl_seal(evl_log *log)
+{
+    int valid = (log->nb_staged > 0U) && (EVL_LOAD(log->nb_sealed) == 0U);
+
+    if (valid)
+    {
+        // The half is written by evl_write() once nb_sealed is published
+        log->sealed = log->active;
+        EVL_STORE(log->nb_sealed, log->nb_staged);
+        log->active ^= 1U;
+        log->nb_staged = 0U;
+    }
+    return valid;
+}
+
+int evl_write(evl_log *log)
+{
+    int valid = TRUE;
+    uint32_t nb_sealed = EVL_LOAD(log->nb_sealed);
+
+    if (nb_sealed > 0U)
+    {
+        const uint8_t *records = &log->staging[log->sealed * log->staging_max * log->record_size];
+        uint64_t committed = log->committed;
+        uint64_t total = committed + nb_sealed;
+        uint32_t slot = (uint32_t)(committed % log->capacity);
+        uint32_t first_part = log->capacity - slot;
+
+        if (first_part > nb_sealed)
+        {
+            first_part = nb_sealed;
+        }
+
+        // The readers stop using the entries about to be overwritten
+        if ((total > log->capacity) && ((total - log->capacity) > log->oldest))
+        {
+            EVL_STORE(log->oldest, total - log->capacity);
+        }
+
+        // Records first, at most two writes at the end of the ring
+        valid = evl_file_write(log, EVL_HEADER_SIZE + ((uint64_t)slot * log->record_size), records, first_part * log->record_size);
+        if (valid && (first_part < nb_sealed))
+        {
+            valid = evl_file_write(log, EVL_HEADER_SIZE, &records[first_part * log->record_size],
+                                   (nb_sealed - first_part) * log->record_size);
+        }
+        valid = valid && evl_file_sync(log);
+
+        // Then the tail, in the slot not holding the current one
+        if (valid)
+        {
+            evl_commit_slot tail;
+
+            memset(&tail, 0, sizeof(tail));
+            tail.committed = total;
+            tail.sequence = log->sequence + 1U;
+            tail.checksum = evl_slot_checksum(&tail);
+
+            valid = evl_file_write(log, EVL_SLOT_OFFSET(tail.sequence & 1U), (const uint8_t *)&tail, sizeof(tail));
+            valid = valid && evl_file_sync(log);
+            if (valid)
+            {
+                log->sequence = tail.sequence;
+                log->commits++;
+                EVL_STORE(log->committed, total);
+                EVL_STORE(log->nb_sealed, 0U);
+            }
+        }
+    }
+    return valid;
+}
+
+int evl_commit(evl_log *log)
+{
+    // Records left sealed by a failed write go first
+    int valid = evl_write(log);
+
+    if (valid && evl_seal(log))
+    {
+        valid = evl_write(log);
+    }
+    return valid;
+}
+
+int evl_poll(evl_log *log, uint64_t now_ms)
+{
+    int valid = TRUE;
+
+    if ((log->nb_staged > 0U) && ((now_ms - log->last_commit_ms) >= log->interval_ms))
+    {
+        valid = evl_commit(log);
+        log->last_commit_ms = now_ms;
+    }
+    return valid;
+}
+
+uint32_t evl_select(const evl_log *log, uint32_t from_entry, uint32_t to_entry, uint64_t *first)
+{
+    uint64_t oldest = EVL_LOAD(log->oldest);
+    uint64_t committed = EVL_LOAD(log->committed);
+    uint32_t in_use = (uint32_t)(committed - oldest);
+    uint32_t count = 0U;
+
+    if (from_entry == 0U)
+    {
+        from_entry = 1U;
+    }
+    if ((to_entry == 0U) || (to_entry > in_use))
+    {
+        to_entry = in_use;
+    }
+
+    if (from_entry <= to_entry)
+    {
+        *first = oldest + (from_entry - 1U);
+        count = to_entry - from_entry + 1U;
+    }
+    return count;
+}
+
+int evl_read(const evl_log *log, uint64_t sequence, uint32_t count, uint8_t *out)
+{
+    int valid = (sequence >= EVL_LOAD(log->oldest)) && ((sequence + count) <= EVL_LOAD(log->committed));
+
+    if (valid && (count > 0U))
+    {
+        uint32_t slot = (uint32_t)(sequence % log->capacity);
+        uint32_t first_part = log->capacity - slot;
+
+        if (first_part > count)
+        {
+            first_part = count;
+        }
+
+        valid = evl_file_read(log, EVL_HEADER_SIZE + ((uint64_t)slot * log->record_size), out, first_part * log->record_size);
+        if (valid && (first_part < count))
+        {
+            valid = evl_file_read(log, EVL_HEADER_SIZE, &out[first_part * log->record_size], (count - first_part) * log->record_size);
+        }
+
+        // A commit during the read may have overwritten the first entries
+#if defined(__GNUC__)
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+        valid = valid && (sequence >= EVL_LOAD(log->oldest));
+    }
+    return valid;
+}
+
+int evl_entry_decode(csm_array *array, uint32_t *from_entry, uint32_t *to_entry, uint16_t *from_column, uint16_t *to_column)
+{
+    uint8_t byte = 0U;
+
+    // access_selector 2, entry_descriptor: structure { from_entry, to_entry, from_selected_value, to_selected_value }
+    int valid = csm_array_read_u8(array, &byte) && (byte == 2U);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == 4U);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_UNSIGNED32);
+    valid = valid && csm_array_read_u32(array, from_entry);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_UNSIGNED32);
+    valid = valid && csm_array_read_u32(array, to_entry);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_UNSIGNED16);
+    valid = valid && csm_array_read_u16(array, from_column);
+    valid = valid && csm_array_read_u8(array, &byte) && (byte == AXDR_TAG_UNSIGNED16);
+    valid = valid && csm_array_read_u16(array, to_column);
+
+    return valid;
+}
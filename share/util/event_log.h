@@ -0,0 +1,159 @@
+/**
+ * Append-only log of fixed-size records with group commit, storage of event and alarm profiles
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_array.h"
+
+#define EVL_MAGIC           0x4C564543U     // "CEVL" on little endian hosts
+#define EVL_VERSION         1U
+#define EVL_HEADER_SIZE     64U             //!< Superblock, the records follow
+
+/**
+ * File layout: superblock | capacity x record_size
+ *
+ * The records form a ring: entry n (absolute sequence since the creation) is stored in slot
+ * n % capacity, the oldest entries are overwritten like a FIFO profile buffer. The superblock holds
+ * two commit slots written alternately, each with the number of committed entries, a sequence and a
+ * checksum: a commit is durable once its slot is synced, a torn slot is ignored and the previous
+ * commit is used at the next opening.
+ */
+typedef struct
+{
+    uint64_t committed;     //!< Entries appended since the creation
+    uint32_t sequence;      //!< Commit number, the highest valid slot is the tail
+    uint32_t checksum;
+} evl_commit_slot;
+
+/**
+ * Appends are staged in memory and written by one commit per interval (group commit): one write of
+ * the staged records (two at the ring end), one sync, then the commit slot and a second sync.
+ *
+ * The staging area has two halves: evl_seal() hands the appended records to the commit and the
+ * appends go on in the other half, so that the writes and syncs of evl_write() can run on another
+ * thread (committer) without blocking the appends. Appends and seals come from one thread or are
+ * serialized by the caller, writes come from one thread. Reads only use the committed entries and
+ * the file handle, they can run concurrently with all of them (Unix).
+ */
+typedef struct
+{
+    int fd;                         //!< Unix only
+    void *file;                     //!< Other systems: FILE handle
+    uint32_t record_size;
+    uint32_t capacity;              //!< Entries kept in the ring
+    uint64_t committed;             //!< Durable entries, published after the commit sync (atomic)
+    uint64_t oldest;                //!< First intact entry, raised before its slot is overwritten (atomic)
+    uint32_t sequence;
+    uint8_t *staging;               //!< 2 x staging_max records
+    uint32_t staging_max;
+    uint32_t active;                //!< Half receiving the appends
+    uint32_t nb_staged;             //!< Records in the active half
+    uint32_t sealed;                //!< Half handed to evl_write()
+    uint32_t nb_sealed;             //!< Records of the other half waiting for evl_write(), 0 once written (atomic)
+    uint32_t interval_ms;
+    uint64_t last_commit_ms;
+
+    // Statistics
+    uint32_t commits;
+    uint32_t appends;
+    uint32_t dropped;               //!< Appends refused, both halves full
+} evl_log;
+
+// Ordered accesses to the fields shared with the committer and the readers
+#if defined(__GNUC__)
+#define EVL_LOAD(field)             __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define EVL_STORE(field, value)     __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+#else
+#define EVL_LOAD(field)             (field)
+#define EVL_STORE(field, value)     ((field) = (value))
+#endif
+
+/**
+ * @brief Open or create a log
+ *
+ * An existing log of another geometry (record size, capacity) is refused.
+ * @param staging: memory of 2 x staging_max records, staging_max <= capacity
+ * @param interval_ms: group commit interval, see evl_poll()
+ * @return TRUE on success
+ */
+int evl_open(evl_log *log, const char *path, uint32_t record_size, uint32_t capacity, uint8_t *staging, uint32_t staging_max,
+             uint32_t interval_ms);
+
+// Commit the staged records and close the file
+void evl_close(evl_log *log);
+
+/**
+ * @brief Stage a record, committed by the next evl_commit() or evl_poll(), or evl_seal() then evl_write()
+ *
+ * A full half is sealed and the appends go on in the other one; never writes to the file.
+ * @return FALSE if both halves are full (the commit is late), the record is dropped
+ */
+int evl_append(evl_log *log, const uint8_t *record);
+
+/**
+ * @brief Hand the staged records to evl_write(), with the appends serialized
+ * @return FALSE if there is nothing to seal or if the previous records are not written yet
+ */
+int evl_seal(evl_log *log);
+
+/**
+ * @brief Write and sync the sealed records, then the tail (committer side)
+ *
+ * Without sealed records, returns TRUE. On failure, the records stay sealed for the next call.
+ */
+int evl_write(evl_log *log);
+
+// Seal and write all the staged records, appends and commits from one thread
+int evl_commit(evl_log *log);
+
+// Commit if records are staged and the interval has elapsed since the last commit, see evl_commit()
+int evl_poll(evl_log *log, uint64_t now_ms);
+
+// Committed entries still in the ring (entries_in_use of the profile)
+static inline uint32_t evl_entries(const evl_log *log)
+{
+    uint64_t oldest = EVL_LOAD(log->oldest);
+    return (uint32_t)(EVL_LOAD(log->committed) - oldest);
+}
+
+/**
+ * @brief Select entries by index, as the entry_descriptor: 1 is the oldest entry, to_entry 0 is the newest
+ *
+ * @param first: absolute sequence of the first selected entry, for evl_read()
+ * @return the number of selected entries, 0 if none
+ */
+uint32_t evl_select(const evl_log *log, uint32_t from_entry, uint32_t to_entry, uint64_t *first);
+
+/**
+ * @brief Read committed entries, from their absolute sequence (O(1) addressing)
+ *
+ * @return FALSE if the entries are not committed or have been overwritten during the read
+ */
+int evl_read(const evl_log *log, uint64_t sequence, uint32_t count, uint8_t *out);
+
+/**
+ * @brief Decode an entry_descriptor selective access (access selector 2)
+ *
+ * The array starts at the access selector. Columns are 1-based, to_column 0 is the last one.
+ */
+int evl_entry_decode(csm_array *array, uint32_t *from_entry, uint32_t *to_entry, uint16_t *from_column, uint16_t *to_column);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOG_H
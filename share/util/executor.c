@@ -0,0 +1,408 @@
+/**
+ * Request executor: work-stealing workers running per-channel mailboxes
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "executor.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// ----------------------------------- QUEUES -----------------------------------
+
+void ex_queue_init(ex_queue *queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+    queue->count = 0U;
+}
+
+// Producers exchange the head, then link the previous one: in between, the consumer sees the queue empty
+void ex_queue_push(ex_queue *queue, ex_item *item)
+{
+    __atomic_store_n(&item->next, NULL, __ATOMIC_RELAXED);
+    ex_item *prev = __atomic_exchange_n(&queue->head, item, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, item, __ATOMIC_RELEASE);
+}
+
+ex_item *ex_queue_pop(ex_queue *queue)
+{
+    ex_item *item = NULL;
+    ex_item *tail = queue->tail;
+    ex_item *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &queue->stub)
+    {
+        // Skip the stub
+        if (next != NULL)
+        {
+            queue->tail = next;
+            tail = next;
+            next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        }
+        else
+        {
+            tail = NULL;
+        }
+    }
+
+    if (tail == NULL)
+    {
+        // Empty
+    }
+    else if (next != NULL)
+    {
+        queue->tail = next;
+        item = tail;
+    }
+    else if (tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+    {
+        // Last item: the stub goes behind it so that the queue is never without a node
+        ex_queue_push(queue, &queue->stub);
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        if (next != NULL)
+        {
+            queue->tail = next;
+            item = tail;
+        }
+    }
+    return item;
+}
+
+// The counter says that an item is there: wait for its producer to link it
+static ex_item *ex_queue_take(ex_queue *queue)
+{
+    ex_item *item = ex_queue_pop(queue);
+
+    while (item == NULL)
+    {
+        item = ex_queue_pop(queue);
+    }
+    return item;
+}
+
+void ex_outbox_init(ex_outbox *outbox, void (*notify)(void *ctx), void *ctx)
+{
+    ex_queue_init(&outbox->queue);
+    outbox->notify = notify;
+    outbox->ctx = ctx;
+}
+
+static void ex_outbox_push(ex_outbox *outbox, ex_item *item)
+{
+    ex_queue_push(&outbox->queue, item);
+    if ((__atomic_fetch_add(&outbox->queue.count, 1U, __ATOMIC_ACQ_REL) == 0U) && (outbox->notify != NULL))
+    {
+        outbox->notify(outbox->ctx);
+    }
+}
+
+ex_item *ex_outbox_pop(ex_outbox *outbox)
+{
+    ex_item *item = NULL;
+
+    if (__atomic_load_n(&outbox->queue.count, __ATOMIC_ACQUIRE) > 0U)
+    {
+        item = ex_queue_take(&outbox->queue);
+        __atomic_sub_fetch(&outbox->queue.count, 1U, __ATOMIC_ACQ_REL);
+    }
+    return item;
+}
+
+// ----------------------------------- MAILBOXES -----------------------------------
+
+#ifdef USE_UNIX_OS
+#define EX_LOCK(m)      pthread_mutex_lock(m)
+#define EX_UNLOCK(m)    pthread_mutex_unlock(m)
+#else
+#define EX_LOCK(m)
+#define EX_UNLOCK(m)
+#endif
+
+int ex_mailbox_open(ex_executor *ex, ex_mailbox *mailbox, ex_outbox *outbox, void *owner)
+{
+    int valid = FALSE;
+
+    ex_queue_init(&mailbox->queue);
+    mailbox->outbox = outbox;
+    mailbox->owner = owner;
+
+    EX_LOCK(&ex->lock);
+    for (uint32_t i = 0U; i < ex->nb_slots; i++)
+    {
+        uint32_t slot = (ex->next_slot + i) % ex->nb_slots;
+        if (ex->slots[slot] == NULL)
+        {
+            ex->slots[slot] = mailbox;
+            ex->next_slot = slot + 1U;
+            mailbox->index = slot;
+            valid = TRUE;
+            break;
+        }
+    }
+    EX_UNLOCK(&ex->lock);
+    return valid;
+}
+
+void ex_mailbox_close(ex_executor *ex, ex_mailbox *mailbox)
+{
+#ifdef USE_UNIX_OS
+    // The last completion is received just before its worker leaves the mailbox
+    while (__atomic_load_n(&mailbox->queue.count, __ATOMIC_ACQUIRE) != 0U)
+    {
+    }
+#endif
+    EX_LOCK(&ex->lock);
+    ex->slots[mailbox->index] = NULL;
+    EX_UNLOCK(&ex->lock);
+}
+
+#ifdef USE_UNIX_OS
+
+// ----------------------------------- SCHEDULING -----------------------------------
+
+static void ex_wake(ex_executor *ex)
+{
+    if (__atomic_load_n(&ex->sleepers, __ATOMIC_SEQ_CST) > 0U)
+    {
+        pthread_mutex_lock(&ex->lock);
+        pthread_cond_signal(&ex->wake);
+        pthread_mutex_unlock(&ex->lock);
+    }
+}
+
+static int ex_inject(ex_worker *worker, uint32_t index)
+{
+    int valid;
+
+    pthread_mutex_lock(&worker->lock);
+    valid = (worker->inject_count < EX_INJECT_SIZE);
+    if (valid)
+    {
+        worker->inject[(worker->inject_head + worker->inject_count) % EX_INJECT_SIZE] = index;
+        worker->inject_count++;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return valid;
+}
+
+static uint32_t ex_uninject(ex_worker *worker)
+{
+    uint32_t index = WP_EMPTY;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->inject_count > 0U)
+    {
+        index = worker->inject[worker->inject_head];
+        worker->inject_head = (worker->inject_head + 1U) % EX_INJECT_SIZE;
+        worker->inject_count--;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return index;
+}
+
+// 'self' is the index of the calling worker, nb_workers for another thread
+static void ex_schedule(ex_executor *ex, ex_mailbox *mailbox, uint32_t self)
+{
+    uint32_t index = mailbox->index;
+    int done = FALSE;
+
+    // Counted first: a worker that takes it before the increment would see a negative count
+    __atomic_add_fetch(&ex->ready, 1, __ATOMIC_SEQ_CST);
+
+    if (self < ex->nb_workers)
+    {
+        done = wp_deque_push(&ex->workers[self].deque, index);
+    }
+    for (uint32_t i = 0U; !done && (i < ex->nb_workers); i++)
+    {
+        done = ex_inject(&ex->workers[(index + i) % ex->nb_workers], index);
+    }
+    ex_wake(ex);
+}
+
+static uint32_t ex_next_mailbox(ex_executor *ex, uint32_t self)
+{
+    ex_worker *worker = &ex->workers[self];
+    uint32_t index = wp_deque_pop(&worker->deque);
+
+    if (index == WP_EMPTY)
+    {
+        index = ex_uninject(worker);
+    }
+    for (uint32_t i = 1U; (index == WP_EMPTY) && (i < ex->nb_workers); i++)
+    {
+        index = wp_deque_steal(&ex->workers[(self + i) % ex->nb_workers].deque);
+    }
+    for (uint32_t i = 1U; (index == WP_EMPTY) && (i < ex->nb_workers); i++)
+    {
+        index = ex_uninject(&ex->workers[(self + i) % ex->nb_workers]);
+        worker->stolen += (index != WP_EMPTY) ? 1U : 0U;
+    }
+    return index;
+}
+
+// Execute the items of a mailbox in order, up to the budget
+static void ex_run_mailbox(ex_executor *ex, ex_mailbox *mailbox, uint32_t self)
+{
+    uint32_t remaining = 1U;
+
+    for (uint32_t n = 0U; remaining > 0U; n++)
+    {
+        ex_item *item = ex_queue_take(&mailbox->queue);
+        ex_outbox *outbox = mailbox->outbox;
+
+        ex->handler(ex->ctx, mailbox, item, self);
+        ex->workers[self].executed++;
+
+        // Handed back while the mailbox is still counted: the next item, run by any worker once the
+        // mailbox is scheduled again, cannot overtake this completion. ex_mailbox_close() waits for the count.
+        if (outbox != NULL)
+        {
+            ex_outbox_push(outbox, item);
+        }
+        remaining = __atomic_sub_fetch(&mailbox->queue.count, 1U, __ATOMIC_ACQ_REL);
+        if ((remaining > 0U) && ((n + 1U) >= EX_BUDGET))
+        {
+            ex_schedule(ex, mailbox, self);
+            remaining = 0U;
+        }
+    }
+}
+
+static void *ex_worker_loop(void *arg)
+{
+    ex_executor *ex = (ex_executor *)arg;
+
+    pthread_mutex_lock(&ex->lock);
+    uint32_t self = ex->started++;
+    pthread_mutex_unlock(&ex->lock);
+
+    while (!__atomic_load_n(&ex->stop, __ATOMIC_ACQUIRE))
+    {
+        uint32_t index = ex_next_mailbox(ex, self);
+
+        if (index != WP_EMPTY)
+        {
+            __atomic_sub_fetch(&ex->ready, 1, __ATOMIC_SEQ_CST);
+            ex_run_mailbox(ex, ex->slots[index], self);
+        }
+        else if (__atomic_load_n(&ex->ready, __ATOMIC_SEQ_CST) <= 0)
+        {
+            // The submitter increments 'ready' then reads 'sleepers': one of the two sees the other
+            pthread_mutex_lock(&ex->lock);
+            __atomic_add_fetch(&ex->sleepers, 1U, __ATOMIC_SEQ_CST);
+            while (!ex->stop && (__atomic_load_n(&ex->ready, __ATOMIC_SEQ_CST) <= 0))
+            {
+                pthread_cond_wait(&ex->wake, &ex->lock);
+            }
+            __atomic_sub_fetch(&ex->sleepers, 1U, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&ex->lock);
+        }
+    }
+    return NULL;
+}
+
+int ex_init(ex_executor *ex, uint32_t nb_workers, ex_mailbox **slots, uint32_t nb_slots, ex_handler handler, void *ctx)
+{
+    int valid = (nb_workers > 0U) && (nb_workers <= WP_MAX_WORKERS);
+
+    memset(ex, 0, sizeof(ex_executor));
+    memset(slots, 0, nb_slots * sizeof(ex_mailbox *));
+    ex->slots = slots;
+    // A scheduled mailbox always finds room in the injection queues
+    ex->nb_slots = (nb_slots < (nb_workers * EX_INJECT_SIZE)) ? nb_slots : (nb_workers * EX_INJECT_SIZE);
+    ex->handler = handler;
+    ex->ctx = ctx;
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->wake, NULL);
+
+    // The deques are ready before any thread can push to them
+    for (uint32_t i = 0U; valid && (i < nb_workers); i++)
+    {
+        wp_deque_init(&ex->workers[i].deque);
+        pthread_mutex_init(&ex->workers[i].lock, NULL);
+    }
+    ex->nb_workers = valid ? nb_workers : 0U;
+
+    for (uint32_t i = 0U; valid && (i < nb_workers); i++)
+    {
+        valid = (pthread_create(&ex->workers[i].thread, NULL, ex_worker_loop, ex) == 0);
+        if (!valid)
+        {
+            ex->nb_workers = i;
+        }
+    }
+
+    if (!valid)
+    {
+        ex_destroy(ex);
+    }
+    return valid;
+}
+
+void ex_destroy(ex_executor *ex)
+{
+    pthread_mutex_lock(&ex->lock);
+    __atomic_store_n(&ex->stop, TRUE, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&ex->wake);
+    pthread_mutex_unlock(&ex->lock);
+
+    for (uint32_t i = 0U; i < ex->nb_workers; i++)
+    {
+        pthread_join(ex->workers[i].thread, NULL);
+    }
+    ex->nb_workers = 0U;
+}
+
+void ex_submit(ex_executor *ex, ex_mailbox *mailbox, ex_item *item)
+{
+    ex_queue_push(&mailbox->queue, item);
+
+    // The first pending item schedules the mailbox, the worker running it takes the next ones
+    if (__atomic_fetch_add(&mailbox->queue.count, 1U, __ATOMIC_ACQ_REL) == 0U)
+    {
+        ex_schedule(ex, mailbox, ex->nb_workers);
+    }
+}
+
+#else
+
+int ex_init(ex_executor *ex, uint32_t nb_workers, ex_mailbox **slots, uint32_t nb_slots, ex_handler handler, void *ctx)
+{
+    memset(ex, 0, sizeof(ex_executor));
+    memset(slots, 0, nb_slots * sizeof(ex_mailbox *));
+    ex->slots = slots;
+    ex->nb_slots = nb_slots;
+    ex->handler = handler;
+    ex->ctx = ctx;
+    ex->nb_workers = (nb_workers > 0U) ? 1U : 0U;
+    return (ex->nb_workers > 0U);
+}
+
+void ex_destroy(ex_executor *ex)
+{
+    ex->nb_workers = 0U;
+}
+
+void ex_submit(ex_executor *ex, ex_mailbox *mailbox, ex_item *item)
+{
+    ex->handler(ex->ctx, mailbox, item, 0U);
+    ex->workers[0].executed++;
+    if (mailbox->outbox != NULL)
+    {
+        ex_outbox_push(mailbox->outbox, item);
+    }
+}
+
+#endif // USE_UNIX_OS
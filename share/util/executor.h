@@ -0,0 +1,146 @@
+/**
+ * Request executor: work-stealing workers running per-channel mailboxes
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "work_pool.h"
+
+#define EX_INJECT_SIZE      1024U   //!< Mailboxes scheduled from outside the workers, per worker
+#define EX_BUDGET           8U      //!< Items of a mailbox executed before it goes back to the queue
+
+/*
+ * A transport submits work items to the mailbox of a channel from its I/O thread. The items of a
+ * mailbox are executed in order, by one worker at a time; the mailbox is the task scheduled on the
+ * workers, so different channels run in parallel. An executed item is handed back to the outbox of
+ * the mailbox, drained by the I/O thread that owns the channel.
+ *
+ * Scheduling: a mailbox that becomes non-empty is injected into the queue of its home worker (index
+ * modulo the number of workers); a mailbox that exhausts its budget is pushed on the deque of the
+ * worker running it. An idle worker steals from the deques, then from the injection queues of the others.
+ */
+
+// Embedded in the caller work item
+typedef struct ex_item
+{
+    struct ex_item *volatile next;
+} ex_item;
+
+// Intrusive multi-producer single-consumer queue
+typedef struct
+{
+    ex_item *volatile head;     //!< Last pushed, producers side
+    ex_item *tail;              //!< Consumer side
+    ex_item stub;
+    volatile uint32_t count;
+} ex_queue;
+
+// Completed items of an I/O thread
+typedef struct
+{
+    ex_queue queue;
+    void (*notify)(void *ctx);  //!< Called by the worker when the outbox becomes non-empty, eg: write to an eventfd
+    void *ctx;
+} ex_outbox;
+
+typedef struct
+{
+    ex_queue queue;
+    ex_outbox *outbox;
+    void *owner;                //!< Given to the handler, eg: the connection
+    uint32_t index;             //!< Slot in the executor
+} ex_mailbox;
+
+// Executes one item, on a worker thread
+typedef void (*ex_handler)(void *ctx, ex_mailbox *mailbox, ex_item *item, uint32_t worker);
+
+typedef struct
+{
+    wp_deque deque;             //!< Mailbox indexes, pushed by this worker only
+#ifdef USE_UNIX_OS
+    pthread_t thread;
+    pthread_mutex_t lock;       //!< Injection queue
+#endif
+    uint32_t inject[EX_INJECT_SIZE];
+    uint32_t inject_head;
+    uint32_t inject_count;
+
+    volatile uint32_t executed; //!< Items
+    volatile uint32_t stolen;   //!< Mailboxes taken from another worker
+} ex_worker;
+
+typedef struct
+{
+    ex_worker workers[WP_MAX_WORKERS];
+    uint32_t nb_workers;
+    ex_handler handler;
+    void *ctx;
+
+    ex_mailbox **slots;         //!< Open mailboxes, NULL for a free slot
+    uint32_t nb_slots;
+    uint32_t next_slot;
+
+#ifdef USE_UNIX_OS
+    pthread_mutex_t lock;       //!< Slots and sleeping workers
+    pthread_cond_t wake;
+#endif
+    volatile int32_t ready;     //!< Mailboxes scheduled and not taken yet
+    volatile uint32_t sleepers;
+    uint32_t started;
+    int stop;
+} ex_executor;
+
+void ex_queue_init(ex_queue *queue);
+
+// Any thread
+void ex_queue_push(ex_queue *queue, ex_item *item);
+
+// Consumer only; NULL if empty or if a producer is between its two steps (see ex_queue_push())
+ex_item *ex_queue_pop(ex_queue *queue);
+
+void ex_outbox_init(ex_outbox *outbox, void (*notify)(void *ctx), void *ctx);
+
+/**
+ * @brief Take one completed item (owner thread)
+ *
+ * Drain until NULL: the notification is sent again only when the outbox goes from empty to non-empty.
+ */
+ex_item *ex_outbox_pop(ex_outbox *outbox);
+
+/**
+ * @brief Start the workers
+ *
+ * The slots array (caller storage) limits the number of open mailboxes, to nb_workers * EX_INJECT_SIZE
+ * at most so that the injection queues cannot overflow.
+ * Without USE_UNIX_OS, there is no thread: the items are executed by ex_submit().
+ */
+int ex_init(ex_executor *ex, uint32_t nb_workers, ex_mailbox **slots, uint32_t nb_slots, ex_handler handler, void *ctx);
+void ex_destroy(ex_executor *ex);
+
+// Attach a mailbox to the executor, FALSE if there is no free slot
+int ex_mailbox_open(ex_executor *ex, ex_mailbox *mailbox, ex_outbox *outbox, void *owner);
+
+// Detach a mailbox, once the completions of all its items have been received from the outbox
+void ex_mailbox_close(ex_executor *ex, ex_mailbox *mailbox);
+
+// Queue an item to a mailbox (any thread)
+void ex_submit(ex_executor *ex, ex_mailbox *mailbox, ex_item *item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXECUTOR_H
@@ -0,0 +1,208 @@
+/**
+ * File mapped in memory, used to persist state images across restarts
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "mapped_file.h"
+
+#ifdef USE_UNIX_OS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#ifdef USE_UNIX_OS
+
+int mapped_file_open(mapped_file *mf, const char *path, uint32_t size)
+{
+    struct stat st;
+    int valid = (size > 0U);
+
+    memset(mf, 0, sizeof(mapped_file));
+    mf->fd = open(path, O_RDWR | O_CREAT, 0644);
+    valid = valid && (mf->fd >= 0);
+    valid = valid && (fstat(mf->fd, &st) == 0);
+
+    if (valid && (st.st_size != (off_t)size))
+    {
+        // Truncate to zero first so that an image of another size is not partially kept
+        valid = (ftruncate(mf->fd, 0) == 0) && (ftruncate(mf->fd, (off_t)size) == 0);
+    }
+
+    if (valid)
+    {
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mf->fd, 0);
+        valid = (addr != MAP_FAILED);
+        if (valid)
+        {
+            mf->data = (uint8_t *)addr;
+            mf->size = size;
+        }
+    }
+
+    if (!valid && (mf->fd >= 0))
+    {
+        close(mf->fd);
+        mf->fd = -1;
+    }
+    return valid;
+}
+
+int mapped_file_open_ro(mapped_file *mf, const char *path)
+{
+    struct stat st;
+
+    memset(mf, 0, sizeof(mapped_file));
+    mf->fd = open(path, O_RDONLY);
+    int valid = (mf->fd >= 0);
+    valid = valid && (fstat(mf->fd, &st) == 0) && (st.st_size > 0) && (st.st_size <= (off_t)UINT32_MAX);
+
+    if (valid)
+    {
+        void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, mf->fd, 0);
+        valid = (addr != MAP_FAILED);
+        if (valid)
+        {
+            mf->data = (uint8_t *)addr;
+            mf->size = (uint32_t)st.st_size;
+        }
+    }
+
+    if (!valid && (mf->fd >= 0))
+    {
+        close(mf->fd);
+        mf->fd = -1;
+    }
+    return valid;
+}
+
+int mapped_file_sync(mapped_file *mf)
+{
+    return (mf->data != NULL) && (msync(mf->data, mf->size, MS_SYNC) == 0);
+}
+
+void mapped_file_close(mapped_file *mf)
+{
+    if (mf->data != NULL)
+    {
+        (void) munmap(mf->data, mf->size);
+        mf->data = NULL;
+    }
+    if (mf->fd >= 0)
+    {
+        close(mf->fd);
+        mf->fd = -1;
+    }
+}
+
+#else
+
+int mapped_file_open(mapped_file *mf, const char *path, uint32_t size)
+{
+    FILE *f;
+    int valid = (size > 0U);
+
+    memset(mf, 0, sizeof(mapped_file));
+    mf->fd = -1;
+    f = fopen(path, "r+b");
+    if (f == NULL)
+    {
+        f = fopen(path, "w+b");
+    }
+    valid = valid && (f != NULL);
+
+    if (valid)
+    {
+        mf->data = (uint8_t *)calloc(1U, size);
+        valid = (mf->data != NULL);
+    }
+
+    if (valid)
+    {
+        mf->file = f;
+        mf->size = size;
+        // A file of another size is not an image of this size
+        if (fread(mf->data, 1U, size, f) != size)
+        {
+            memset(mf->data, 0, size);
+        }
+        else if (fgetc(f) != EOF)
+        {
+            memset(mf->data, 0, size);
+        }
+    }
+    else if (f != NULL)
+    {
+        fclose(f);
+    }
+    return valid;
+}
+
+int mapped_file_open_ro(mapped_file *mf, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    long size = -1;
+
+    memset(mf, 0, sizeof(mapped_file));
+    mf->fd = -1;
+    int valid = (f != NULL);
+    valid = valid && (fseek(f, 0, SEEK_END) == 0) && ((size = ftell(f)) > 0) && (fseek(f, 0, SEEK_SET) == 0);
+
+    if (valid)
+    {
+        mf->data = (uint8_t *)malloc((size_t)size);
+        valid = (mf->data != NULL) && (fread(mf->data, 1U, (size_t)size, f) == (size_t)size);
+        mf->size = (uint32_t)size;
+    }
+
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+    if (!valid)
+    {
+        free(mf->data);
+        mf->data = NULL;
+    }
+    return valid;
+}
+
+int mapped_file_sync(mapped_file *mf)
+{
+    FILE *f = (FILE *)mf->file;
+    int valid = (f != NULL) && (mf->data != NULL);
+
+    valid = valid && (fseek(f, 0, SEEK_SET) == 0);
+    valid = valid && (fwrite(mf->data, 1U, mf->size, f) == mf->size);
+    valid = valid && (fflush(f) == 0);
+    return valid;
+}
+
+void mapped_file_close(mapped_file *mf)
+{
+    if (mf->file != NULL)
+    {
+        (void) mapped_file_sync(mf);
+        fclose((FILE *)mf->file);
+        mf->file = NULL;
+    }
+    free(mf->data);
+    mf->data = NULL;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * File mapped in memory, used to persist state images across restarts
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t size;
+    int fd;             //!< Unix only
+    void *file;         //!< Other systems: FILE handle, the data is a heap copy written back by mapped_file_sync()
+} mapped_file;
+
+/**
+ * @brief Open or create a file of the given size and map it
+ *
+ * A new file, or a file of another size, is resized and filled with zeros: the content is then
+ * not a valid image, the caller detects it with its own header.
+ * @return TRUE on success
+ */
+int mapped_file_open(mapped_file *mf, const char *path, uint32_t size);
+
+/**
+ * @brief Map an existing file read-only, with its own size
+ *
+ * The pages are shared by all the processes mapping the same file.
+ */
+int mapped_file_open_ro(mapped_file *mf, const char *path);
+
+// Write the modified pages back to the file
+int mapped_file_sync(mapped_file *mf);
+
+void mapped_file_close(mapped_file *mf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MAPPED_FILE_H
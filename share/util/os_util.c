@@ -19,6 +19,13 @@
 #include "os_util.h"
 #include <stdio.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(HEX_NO_SIMD)
+#define HEX_X86
+#include <immintrin.h>
+#define HEX_SSSE3   __attribute__((target("ssse3")))
+#define HEX_AVX2    __attribute__((target("avx2")))
+#endif
+
 int memcmp_const(const void *a, const void *b, size_t len)
 {
 	const uint8_t *aa = a;
@@ -34,43 +41,308 @@ int memcmp_const(const void *a, const void *b, size_t len)
 	return res;
 }
 
-void byte_to_hex(const char byte, char *out)
+/*
+** Hexadecimal conversions. On x86 with GCC or Clang the SSSE3 and AVX2 versions are always compiled
+** (target attribute) and selected at run time from the CPU features; build with -DHEX_NO_SIMD to keep
+** the scalar versions only. The scalar versions process the tails and the other targets.
+*/
+
+static const char cHexDigits[] = "0123456789ABCDEF";
+
+// Nibble value of an hexadecimal digit (any case), 0xFF otherwise
+static inline uint8_t hex_nibble(char c)
 {
-    int i = 0U;
-    static const char binHex[] = "0123456789ABCDEF";
+    uint8_t digit = (uint8_t)((uint8_t)c - (uint8_t)'0');
+    uint8_t alpha = (uint8_t)(((uint8_t)c | 0x20U) - (uint8_t)'a');
 
-    out[2*i] = binHex[(byte >> 4) & 0x0F];
-    out[2*i + 1] = binHex[byte & 0x0F];
+    return (digit < 10U) ? digit : ((alpha < 6U) ? (uint8_t)(alpha + 10U) : 0xFFU);
 }
 
+#if defined(HEX_X86)
 
-void print_hex(const char *buf, int size)
+// Compiled in without -mavx2: ask the CPU (the features are read by libgcc before main)
+static inline int hex_has_avx2(void)
+{
+#if defined(__AVX2__)
+    return 1;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static inline int hex_has_ssse3(void)
+{
+#if defined(__SSSE3__)
+    return 1;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static const int8_t cDumpShuffle[3][3][16] =
+{
+    {   // Digit of the high nibble, of the low nibble, separator mask
+        { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+        { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+        { 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0 }
+    },
+    {
+        { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+        { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+        { 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0 }
+    },
+    {
+        { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+        { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+        { -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1 }
+    }
+};
+
+// Digits of the high and low nibbles of 16 bytes
+static inline HEX_SSSE3 void hex_digits_16(const uint8_t *in, __m128i *high, __m128i *low)
+{
+    const __m128i lut = _mm_loadu_si128((const __m128i *)cHexDigits);
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i v = _mm_loadu_si128((const __m128i *)in);
+
+    *high = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    *low = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+}
+
+// Nibble values of 16 digits, returns 0 if one of them is not an hexadecimal digit
+static inline HEX_SSSE3 int hex_nibbles_16(const char *in, __m128i *nibbles)
+{
+    __m128i c = _mm_loadu_si128((const __m128i *)in);
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+    *nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit),
+                            _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+    return _mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) == 0xFFFF;
+}
+
+// Blocks of 32 bytes, returns the number of bytes encoded
+static HEX_AVX2 size_t hex_encode_avx2(const uint8_t *in, size_t size, char *out)
 {
-    int i = 0U;
-    char out[2];
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)cHexDigits));
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0U;
 
-    for (i = 0U; i < size; i++)
+    for (; (i + 32U) <= size; i += 32U)
     {
-        byte_to_hex(buf[i], &out[0]);
+        __m256i v = _mm256_loadu_si256((const __m256i *)&in[i]);
+        __m256i high = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i low = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        // Unpack works inside the 128-bit lanes, the permutation restores the order
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
 
-        printf("%c", out[0]);
-        printf("%c", out[1]);
+        _mm256_storeu_si256((__m256i *)&out[2U * i], _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)&out[(2U * i) + 32U], _mm256_permute2x128_si256(first, second, 0x31));
     }
+    return i;
+}
 
-    fflush(stdout);
+// Blocks of 16 bytes from byte i, returns the number of bytes encoded
+static HEX_SSSE3 size_t hex_encode_ssse3(const uint8_t *in, size_t size, char *out, size_t i)
+{
+    for (; (i + 16U) <= size; i += 16U)
+    {
+        __m128i high;
+        __m128i low;
+        hex_digits_16(&in[i], &high, &low);
+
+        _mm_storeu_si128((__m128i *)&out[2U * i], _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)&out[(2U * i) + 16U], _mm_unpackhi_epi8(high, low));
+    }
+    return i;
 }
 
+// Blocks of 64 digits, returns the number of digits decoded; valid is cleared on an invalid digit
+static HEX_AVX2 size_t hex_decode_avx2(const char *in, size_t size, uint8_t *out, int *valid)
+{
+    const __m256i weights = _mm256_set1_epi16(0x0110);     // high nibble * 16 + low nibble
+    size_t i = 0U;
 
-void hex2bin(const char *in, char* out, int size)
+    for (; *valid && ((i + 64U) <= size); i += 64U)
+    {
+        __m256i n[2];
+        for (uint32_t k = 0U; k < 2U; k++)
+        {
+            __m256i c = _mm256_loadu_si256((const __m256i *)&in[i + (32U * k)]);
+            __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+            __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+            __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+            __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+
+            *valid = *valid && (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha)) == -1);
+            n[k] = _mm256_maddubs_epi16(_mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                                        _mm256_and_si256(is_alpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10)))), weights);
+        }
+        // Pack works inside the 128-bit lanes, the permutation restores the order
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(n[0], n[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *)&out[i / 2U], bytes);
+    }
+    return i;
+}
+
+// Blocks of 32 digits from digit i, returns the number of digits decoded
+static HEX_SSSE3 size_t hex_decode_ssse3(const char *in, size_t size, uint8_t *out, size_t i, int *valid)
 {
-    int i = 0;
-    int j = 0;
+    const __m128i weights = _mm_set1_epi16(0x0110);
+
+    for (; *valid && ((i + 32U) <= size); i += 32U)
+    {
+        __m128i first;
+        __m128i second = _mm_setzero_si128();
+        *valid = hex_nibbles_16(&in[i], &first) && hex_nibbles_16(&in[i + 16U], &second);
+
+        __m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+        _mm_storeu_si128((__m128i *)&out[i / 2U], bytes);
+    }
+    return i;
+}
+
+// Blocks of 16 bytes with a separator after each one (48 characters), returns the number of bytes dumped
+static HEX_SSSE3 size_t hex_dump_ssse3(const uint8_t *in, size_t size, char separator, char *out)
+{
+    const __m128i sep = _mm_set1_epi8(separator);
+    size_t i = 0U;
+
+    for (; (i + 16U) <= size; i += 16U)
+    {
+        __m128i high;
+        __m128i low;
+        hex_digits_16(&in[i], &high, &low);
+
+        for (uint32_t k = 0U; k < 3U; k++)
+        {
+            __m128i h = _mm_shuffle_epi8(high, _mm_loadu_si128((const __m128i *)cDumpShuffle[k][0]));
+            __m128i l = _mm_shuffle_epi8(low, _mm_loadu_si128((const __m128i *)cDumpShuffle[k][1]));
+            __m128i s = _mm_and_si128(sep, _mm_loadu_si128((const __m128i *)cDumpShuffle[k][2]));
+            _mm_storeu_si128((__m128i *)&out[(3U * i) + (16U * k)], _mm_or_si128(_mm_or_si128(h, l), s));
+        }
+    }
+    return i;
+}
 
-    int final_len = size / 2U;
+#endif // HEX_X86
+
+size_t hex_encode(const uint8_t *in, size_t size, char *out)
+{
+    size_t i = 0U;
 
-    for (i = 0, j = 0; j<final_len; i+=2, j++)
+#if defined(HEX_X86)
+    if (hex_has_avx2())
     {
-        out[j] = (in[i] % 32 + 9) % 25 * 16 + (in[i+1] % 32 + 9) % 25;
+        i = hex_encode_avx2(in, size, out);
     }
+    if (hex_has_ssse3())
+    {
+        i = hex_encode_ssse3(in, size, out, i);
+    }
+#endif
+    for (; i < size; i++)
+    {
+        out[2U * i] = cHexDigits[in[i] >> 4U];
+        out[(2U * i) + 1U] = cHexDigits[in[i] & 0x0FU];
+    }
+    return 2U * size;
 }
 
+int hex_decode(const char *in, size_t size, uint8_t *out)
+{
+    size_t i = 0U;
+    int valid = ((size % 2U) == 0U);
+
+#if defined(HEX_X86)
+    if (valid && hex_has_avx2())
+    {
+        i = hex_decode_avx2(in, size, out, &valid);
+    }
+    if (valid && hex_has_ssse3())
+    {
+        i = hex_decode_ssse3(in, size, out, i, &valid);
+    }
+#endif
+    for (; valid && (i < size); i += 2U)
+    {
+        uint8_t high = hex_nibble(in[i]);
+        uint8_t low = hex_nibble(in[i + 1U]);
+
+        valid = (high != 0xFFU) && (low != 0xFFU);
+        out[i / 2U] = (uint8_t)((high << 4U) | low);
+    }
+    return valid ? (int)(size / 2U) : -1;
+}
+
+size_t hex_dump(const uint8_t *in, size_t size, char separator, char *out, size_t out_size)
+{
+    size_t i = 0U;
+    size_t pos = 0U;
+
+    // Keep the bytes that fit with the terminating null character
+    size_t max = (separator != 0) ? (out_size / 3U) : ((out_size > 0U) ? ((out_size - 1U) / 2U) : 0U);
+    size = (size < max) ? size : max;
+
+    if (separator == 0)
+    {
+        pos = hex_encode(in, size, out);
+    }
+    else
+    {
+#if defined(HEX_X86)
+        if (hex_has_ssse3())
+        {
+            i = hex_dump_ssse3(in, size, separator, out);
+            pos = 3U * i;
+        }
+#endif
+        for (; i < size; i++)
+        {
+            out[pos++] = cHexDigits[in[i] >> 4U];
+            out[pos++] = cHexDigits[in[i] & 0x0FU];
+            out[pos++] = separator;
+        }
+        // No separator after the last byte
+        pos = (pos > 0U) ? (pos - 1U) : 0U;
+    }
+
+    if (out_size > 0U)
+    {
+        out[pos] = '\0';
+    }
+    return pos;
+}
+
+void byte_to_hex(const char byte, char *out)
+{
+    out[0] = cHexDigits[((uint8_t)byte >> 4U) & 0x0FU];
+    out[1] = cHexDigits[(uint8_t)byte & 0x0FU];
+}
+
+void print_hex(const char *buf, int size)
+{
+    char out[512];
+    int i = 0;
+
+    // One write per chunk instead of one printf per digit
+    while (i < size)
+    {
+        int chunk = ((size - i) < 256) ? (size - i) : 256;
+        size_t len = hex_encode((const uint8_t *)&buf[i], (size_t)chunk, out);
+        (void) fwrite(out, 1U, len, stdout);
+        i += chunk;
+    }
+
+    fflush(stdout);
+}
+
+
+void hex2bin(const char *in, char* out, int size)
+{
+    // Invalid digits are not reported, as before; use hex_decode() to check the input
+    (void) hex_decode(in, (size_t)size & ~(size_t)1U, (uint8_t *)out);
+}
@@ -82,6 +82,35 @@ static inline uint32_t div_round_up(uint32_t x, uint32_t y)
     return  (x + y - 1U) / y;
 }
 
+// Index of the least significant bit set, value must not be zero
+static inline uint32_t ctz64(uint64_t value)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctzll(value);
+#else
+    // De Bruijn multiplication on the isolated lowest bit
+    static const uint8_t table[64] = {
+         0,  1,  2, 53,  3,  7, 54, 27,  4, 38, 41,  8, 34, 55, 48, 28,
+        62,  5, 39, 46, 44, 42, 22,  9, 24, 35, 59, 56, 49, 18, 29, 11,
+        63, 52,  6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+        51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12
+    };
+    return table[((value & (~value + 1U)) * 0x022FDD63CC95386DULL) >> 58U];
+#endif
+}
+
+static inline uint32_t popcount64(uint64_t value)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcountll(value);
+#else
+    value = value - ((value >> 1U) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2U) & 0x3333333333333333ULL);
+    value = (value + (value >> 4U)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (uint32_t)((value * 0x0101010101010101ULL) >> 56U);
+#endif
+}
+
 // -----------------------------------  Prototypes --------------------------------------------------
 
 /**
@@ -107,6 +136,23 @@ void hex2bin(const char *in, char* out, int size);
 void byte_to_hex(const char byte, char *out);
 void print_hex(const char *buf, int size);
 
+/**
+ * Hexadecimal conversions, vectorized with SSSE3 or AVX2 when the x86 CPU has them
+ */
+
+// Upper case digits, 2 * size characters (not null terminated), returns the number of characters
+size_t hex_encode(const uint8_t *in, size_t size, char *out);
+
+// Any case digits, size must be even; returns the number of bytes, -1 on an invalid digit
+int hex_decode(const char *in, size_t size, uint8_t *out);
+
+/**
+ * Format a whole buffer as one null terminated string, "0A:1B:2C" (or "0A1B2C" with separator 0)
+ * The dump is truncated to the bytes that fit in out_size; returns the string length.
+ */
+#define HEX_DUMP_SIZE(size)     ((3U * (size)) + 1U)
+size_t hex_dump(const uint8_t *in, size_t size, char separator, char *out, size_t out_size);
+
 
 #define debug_print(fmt, ...) \
         do { if (DEBUG) fprintf(stderr, "%s:%d:%s(): " fmt, __FILE__, \
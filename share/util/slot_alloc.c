@@ -0,0 +1,151 @@
+/**
+ * Constant time slot allocator based on 64-bit free maps
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include "slot_alloc.h"
+#include "os_util.h"
+
+#define SLOT_BIT(n)     (1ULL << ((n) & 63U))
+
+void slot_alloc_init(slot_alloc *sa, uint64_t *words, uint64_t *summary, uint32_t nb_slots)
+{
+    sa->words = words;
+    sa->summary = summary;
+    sa->nb_slots = nb_slots;
+    sa->nb_words = SLOT_ALLOC_WORDS(nb_slots);
+    sa->nb_free = nb_slots;
+    sa->hint = 0U;
+
+    for (uint32_t i = 0U; i < sa->nb_words; i++)
+    {
+        sa->words[i] = ~0ULL;
+    }
+
+    // The bits beyond the last slot are never free
+    if ((nb_slots & 63U) != 0U)
+    {
+        sa->words[sa->nb_words - 1U] = SLOT_BIT(nb_slots) - 1U;
+    }
+
+    if (summary != NULL)
+    {
+        uint32_t nb_summary = SLOT_ALLOC_SUMMARY(nb_slots);
+        for (uint32_t i = 0U; i < nb_summary; i++)
+        {
+            summary[i] = ~0ULL;
+        }
+        if ((sa->nb_words & 63U) != 0U)
+        {
+            summary[nb_summary - 1U] = SLOT_BIT(sa->nb_words) - 1U;
+        }
+    }
+}
+
+// Find a word with a free slot, starting from the hint
+static int32_t slot_alloc_find_word(slot_alloc *sa)
+{
+    int32_t word = -1;
+
+    if (sa->summary != NULL)
+    {
+        uint32_t nb_summary = SLOT_ALLOC_SUMMARY(sa->nb_slots);
+        for (uint32_t i = sa->hint; i < nb_summary; i++)
+        {
+            if (sa->summary[i] != 0U)
+            {
+                sa->hint = i;
+                word = (int32_t)((i * 64U) + ctz64(sa->summary[i]));
+                break;
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t i = sa->hint; i < sa->nb_words; i++)
+        {
+            if (sa->words[i] != 0U)
+            {
+                sa->hint = i;
+                word = (int32_t)i;
+                break;
+            }
+        }
+    }
+    return word;
+}
+
+int32_t slot_alloc_get(slot_alloc *sa)
+{
+    int32_t slot = -1;
+
+    if (sa->nb_free > 0U)
+    {
+        int32_t word = slot_alloc_find_word(sa);
+        if (word >= 0)
+        {
+            uint32_t bit = ctz64(sa->words[word]);
+            sa->words[word] &= ~SLOT_BIT(bit);
+            if ((sa->summary != NULL) && (sa->words[word] == 0U))
+            {
+                sa->summary[(uint32_t)word / 64U] &= ~SLOT_BIT((uint32_t)word);
+            }
+            sa->nb_free--;
+            slot = (int32_t)(((uint32_t)word * 64U) + bit);
+        }
+    }
+    return slot;
+}
+
+int slot_alloc_take(slot_alloc *sa, uint32_t slot)
+{
+    int ret = 0;
+
+    if ((slot < sa->nb_slots) && !slot_alloc_is_used(sa, slot))
+    {
+        uint32_t word = slot / 64U;
+        sa->words[word] &= ~SLOT_BIT(slot);
+        if ((sa->summary != NULL) && (sa->words[word] == 0U))
+        {
+            sa->summary[word / 64U] &= ~SLOT_BIT(word);
+        }
+        sa->nb_free--;
+        ret = 1;
+    }
+    return ret;
+}
+
+int slot_alloc_release(slot_alloc *sa, uint32_t slot)
+{
+    int ret = 0;
+
+    if (slot_alloc_is_used(sa, slot))
+    {
+        uint32_t word = slot / 64U;
+        sa->words[word] |= SLOT_BIT(slot);
+        sa->nb_free++;
+
+        if (sa->summary != NULL)
+        {
+            sa->summary[word / 64U] |= SLOT_BIT(word);
+            word /= 64U;
+        }
+        if (word < sa->hint)
+        {
+            sa->hint = word;
+        }
+        ret = 1;
+    }
+    return ret;
+}
+
+int slot_alloc_is_used(const slot_alloc *sa, uint32_t slot)
+{
+    return (slot < sa->nb_slots) && ((sa->words[slot / 64U] & SLOT_BIT(slot)) == 0U);
+}
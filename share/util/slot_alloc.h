@@ -0,0 +1,63 @@
+/**
+ * Constant time slot allocator based on 64-bit free maps
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef SLOT_ALLOC_H
+#define SLOT_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Storage needed for a number of slots, in 64-bit words
+#define SLOT_ALLOC_WORDS(slots)     (((slots) + 63U) / 64U)
+#define SLOT_ALLOC_SUMMARY(slots)   ((SLOT_ALLOC_WORDS(slots) + 63U) / 64U)
+
+typedef struct
+{
+    uint64_t *words;        //!< One bit per slot, 1 = free
+    uint64_t *summary;      //!< Optional second level, one bit per word, 1 = the word has a free slot
+    uint32_t nb_slots;
+    uint32_t nb_words;
+    uint32_t nb_free;
+    uint32_t hint;          //!< No free slot below this word (summary word if two-level)
+} slot_alloc;
+
+/**
+ * @brief Initialize an allocator with all the slots free
+ *
+ * The storage is provided by the caller (static allocation), see SLOT_ALLOC_WORDS().
+ * The summary is optional (NULL): it is worth it above a few hundreds of slots.
+ */
+void slot_alloc_init(slot_alloc *sa, uint64_t *words, uint64_t *summary, uint32_t nb_slots);
+
+// Return the lowest free slot and mark it as used, -1 if all the slots are used
+int32_t slot_alloc_get(slot_alloc *sa);
+
+// Mark a given slot as used (eg: state restored after a restart), return 0 if it was not free
+int slot_alloc_take(slot_alloc *sa, uint32_t slot);
+
+// Mark a slot as free, return 0 if it was not in use
+int slot_alloc_release(slot_alloc *sa, uint32_t slot);
+
+int slot_alloc_is_used(const slot_alloc *sa, uint32_t slot);
+
+static inline uint32_t slot_alloc_free_count(const slot_alloc *sa)
+{
+    return sa->nb_free;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SLOT_ALLOC_H
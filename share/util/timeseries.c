@@ -0,0 +1,413 @@
+/**
+ * Compressed time series of profile-generic buffers: delta-of-delta timestamps, delta values
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include "timeseries.h"
+#include "clock.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+
+// Widest difference: prefix 1111 and 33 bits (a timestamp interval change can exceed 32 bits)
+#define TS_MAX_CODE_BITS    37U
+#define TS_CAPACITY_BITS    (TS_BLOCK_BYTES * 8U)
+
+// ----------------------------------- BIT PACKING -----------------------------------
+
+static void ts_put_bits(uint8_t *data, uint32_t *pos, uint64_t value, uint32_t nb_bits)
+{
+    for (uint32_t i = nb_bits; i > 0U; i--)
+    {
+        uint32_t bit = (uint32_t)((value >> (i - 1U)) & 1U);
+        data[*pos >> 3] |= (uint8_t)(bit << (7U - (*pos & 7U)));
+        (*pos)++;
+    }
+}
+
+static uint64_t ts_get_bits(const uint8_t *data, uint32_t *pos, uint32_t nb_bits)
+{
+    uint64_t value = 0U;
+
+    for (uint32_t i = 0U; i < nb_bits; i++)
+    {
+        value = (value << 1) | ((data[*pos >> 3] >> (7U - (*pos & 7U))) & 1U);
+        (*pos)++;
+    }
+    return value;
+}
+
+static uint64_t ts_zigzag(int64_t value)
+{
+    // Unsigned shifts: a left shift of a negative value is undefined
+    return ((uint64_t)value << 1) ^ (0U - ((uint64_t)value >> 63));
+}
+
+static int64_t ts_unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1U);
+}
+
+static const uint8_t cBucketBits[] = { 0U, 7U, 12U, 20U, 33U };
+
+static void ts_put_diff(uint8_t *data, uint32_t *pos, int64_t diff)
+{
+    uint64_t value = ts_zigzag(diff);
+    uint32_t bucket = 0U;
+
+    while ((bucket < 4U) && (value >= (1ULL << cBucketBits[bucket])))
+    {
+        bucket++;
+    }
+
+    // Prefix: 0, 10, 110, 1110, 1111
+    if (bucket < 4U)
+    {
+        ts_put_bits(data, pos, ((1U << bucket) - 1U) << 1, bucket + 1U);
+    }
+    else
+    {
+        ts_put_bits(data, pos, 0xFU, 4U);
+    }
+    ts_put_bits(data, pos, value, cBucketBits[bucket]);
+}
+
+static int64_t ts_get_diff(const uint8_t *data, uint32_t *pos)
+{
+    uint32_t bucket = 0U;
+
+    while ((bucket < 4U) && (ts_get_bits(data, pos, 1U) == 1U))
+    {
+        bucket++;
+    }
+    return ts_unzigzag(ts_get_bits(data, pos, cBucketBits[bucket]));
+}
+
+// ----------------------------------- STORE -----------------------------------
+
+int ts_init(ts_store *store, ts_block *blocks, uint32_t nb_blocks, uint32_t nb_columns)
+{
+    int valid = (nb_blocks > 0U) && (nb_columns <= TS_MAX_COLUMNS);
+
+    memset(store, 0, sizeof(ts_store));
+    store->blocks = blocks;
+    store->nb_blocks = nb_blocks;
+    store->nb_columns = nb_columns;
+    return valid;
+}
+
+static ts_block *ts_new_block(ts_store *store, uint32_t time, const uint32_t *values)
+{
+    if (store->used == store->nb_blocks)
+    {
+        store->head = (store->head + 1U) % store->nb_blocks;
+        store->used--;
+    }
+
+    ts_block *block = &store->blocks[(store->head + store->used) % store->nb_blocks];
+    store->used++;
+
+    memset(block, 0, sizeof(ts_block));
+    block->first_time = time;
+    block->last_time = time;
+    block->rows = 1U;
+    for (uint32_t c = 0U; c < store->nb_columns; c++)
+    {
+        block->first[c] = values[c];
+        block->min[c] = values[c];
+        block->max[c] = values[c];
+    }
+    return block;
+}
+
+int ts_append(ts_store *store, uint32_t time, const uint32_t *values)
+{
+    int valid = (store->used == 0U) || (time > store->last_time);
+
+    if (valid)
+    {
+        ts_block *block = (store->used > 0U) ? &store->blocks[(store->head + store->used - 1U) % store->nb_blocks] : NULL;
+        uint32_t interval = (block != NULL) ? (time - store->last_time) : 0U;
+
+        if ((block == NULL) || (block->rows == 0xFFFFU) ||
+            ((block->bits + ((store->nb_columns + 1U) * TS_MAX_CODE_BITS)) > TS_CAPACITY_BITS))
+        {
+            // The first row of a block is in its header, the interval restarts from zero
+            (void) ts_new_block(store, time, values);
+            interval = 0U;
+        }
+        else
+        {
+            uint32_t pos = block->bits;
+
+            ts_put_diff(block->data, &pos, (int64_t)interval - (int64_t)store->last_interval);
+            for (uint32_t c = 0U; c < store->nb_columns; c++)
+            {
+                ts_put_diff(block->data, &pos, (int64_t)(int32_t)(values[c] - store->last[c]));
+                block->min[c] = (values[c] < block->min[c]) ? values[c] : block->min[c];
+                block->max[c] = (values[c] > block->max[c]) ? values[c] : block->max[c];
+            }
+            block->bits = (uint16_t)pos;
+            block->rows++;
+            block->last_time = time;
+        }
+
+        store->last_time = time;
+        store->last_interval = interval;
+        memcpy(store->last, values, store->nb_columns * sizeof(uint32_t));
+    }
+    return valid;
+}
+
+uint32_t ts_rows(const ts_store *store)
+{
+    uint32_t rows = 0U;
+
+    for (uint32_t i = 0U; i < store->used; i++)
+    {
+        rows += store->blocks[(store->head + i) % store->nb_blocks].rows;
+    }
+    return rows;
+}
+
+uint32_t ts_size(const ts_store *store)
+{
+    uint32_t size = 0U;
+
+    for (uint32_t i = 0U; i < store->used; i++)
+    {
+        const ts_block *block = &store->blocks[(store->head + i) % store->nb_blocks];
+        size += (uint32_t)offsetof(ts_block, data) + ((block->bits + 7U) / 8U);
+    }
+    return size;
+}
+
+// Rows within [from, to] (UTC seconds) and, for a column below nb_columns, with its value within [low, high]
+typedef struct
+{
+    uint32_t from;
+    uint32_t to;
+    uint32_t column;
+    uint32_t low;
+    uint32_t high;
+} ts_filter;
+
+// Blocks out of the filter, from their header only
+static int ts_block_out(const ts_block *block, const ts_filter *filter, uint32_t nb_columns)
+{
+    int out = (block->last_time < filter->from) || (block->first_time > filter->to);
+
+    if (!out && (filter->column < nb_columns))
+    {
+        out = (block->max[filter->column] < filter->low) || (block->min[filter->column] > filter->high);
+    }
+    return out;
+}
+
+// Blocks entirely within the filter, from their header only
+static int ts_block_in(const ts_block *block, const ts_filter *filter, uint32_t nb_columns)
+{
+    int in = (block->first_time >= filter->from) && (block->last_time <= filter->to);
+
+    if (in && (filter->column < nb_columns))
+    {
+        in = (block->min[filter->column] >= filter->low) && (block->max[filter->column] <= filter->high);
+    }
+    return in;
+}
+
+static uint32_t ts_scan_block(const ts_store *store, const ts_block *block, const ts_filter *filter, ts_row_cb callback, void *ctx, int *go_on)
+{
+    uint32_t values[TS_MAX_COLUMNS];
+    uint32_t time = block->first_time;
+    uint32_t interval = 0U;
+    uint32_t pos = 0U;
+    uint32_t nb = 0U;
+
+    memcpy(values, block->first, sizeof(values));
+    for (uint32_t r = 0U; *go_on && (r < block->rows); r++)
+    {
+        if (r > 0U)
+        {
+            interval = (uint32_t)((int64_t)interval + ts_get_diff(block->data, &pos));
+            time += interval;
+            for (uint32_t c = 0U; c < store->nb_columns; c++)
+            {
+                values[c] += (uint32_t)ts_get_diff(block->data, &pos);
+            }
+        }
+
+        if (time > filter->to)
+        {
+            *go_on = FALSE;
+        }
+        else if ((time >= filter->from) &&
+                 ((filter->column >= store->nb_columns) ||
+                  ((values[filter->column] >= filter->low) && (values[filter->column] <= filter->high))))
+        {
+            *go_on = callback(ctx, time, values);
+            nb++;
+        }
+    }
+    return nb;
+}
+
+static uint32_t ts_scan_filter(const ts_store *store, const ts_filter *filter, ts_row_cb callback, void *ctx)
+{
+    uint32_t nb = 0U;
+    int go_on = TRUE;
+
+    for (uint32_t i = 0U; go_on && (i < store->used); i++)
+    {
+        const ts_block *block = &store->blocks[(store->head + i) % store->nb_blocks];
+
+        if (!ts_block_out(block, filter, store->nb_columns))
+        {
+            nb += ts_scan_block(store, block, filter, callback, ctx, &go_on);
+        }
+    }
+    return nb;
+}
+
+uint32_t ts_scan(const ts_store *store, uint32_t from, uint32_t to, ts_row_cb callback, void *ctx)
+{
+    ts_filter filter = { from, to, TS_MAX_COLUMNS, 0U, 0U };
+
+    return ts_scan_filter(store, &filter, callback, ctx);
+}
+
+typedef struct
+{
+    const ts_store *store;
+    csm_array *out;
+    int valid;
+} ts_axdr_ctx;
+
+static int ts_count_cb(void *ctx, uint32_t time, const uint32_t *values)
+{
+    (void) ctx;
+    (void) time;
+    (void) values;
+    return TRUE;
+}
+
+// Blocks entirely within the filter are counted from their header, the others are decoded
+static uint32_t ts_count(const ts_store *store, const ts_filter *filter)
+{
+    uint32_t nb = 0U;
+
+    for (uint32_t i = 0U; i < store->used; i++)
+    {
+        const ts_block *block = &store->blocks[(store->head + i) % store->nb_blocks];
+
+        if (ts_block_in(block, filter, store->nb_columns))
+        {
+            nb += block->rows;
+        }
+        else if (!ts_block_out(block, filter, store->nb_columns))
+        {
+            int go_on = TRUE;
+            nb += ts_scan_block(store, block, filter, ts_count_cb, NULL, &go_on);
+        }
+    }
+    return nb;
+}
+
+static int ts_axdr_cb(void *ctx, uint32_t time, const uint32_t *values)
+{
+    ts_axdr_ctx *c = (ts_axdr_ctx *)ctx;
+    uint8_t datetime[CLK_COSEM_DATETIME_SIZE];
+
+    clk_epoch_to_cosem_batch(&time, 1U, datetime, CLK_COSEM_DATETIME_SIZE, 0, 0U);
+
+    int valid = csm_array_write_u8(c->out, AXDR_TAG_STRUCTURE);
+    valid = valid && csm_ber_write_len(c->out, c->store->nb_columns + 1U);
+    valid = valid && csm_axdr_wr_octetstring(c->out, datetime, sizeof(datetime));
+    for (uint32_t i = 0U; valid && (i < c->store->nb_columns); i++)
+    {
+        valid = csm_axdr_wr_u32(c->out, values[i]);
+    }
+    c->valid = valid;
+    return valid;
+}
+
+// Key range to the UTC seconds covering it
+static void ts_key_range(uint64_t from_key, uint64_t to_key, uint32_t *from, uint32_t *to)
+{
+    uint32_t low = 0U;
+    uint32_t high = 0xFFFFFFFFU;
+
+    // clk_epoch_key() is monotonic: binary search of the first second at or after from_key, and of the last one up to to_key
+    while (low < high)
+    {
+        uint32_t mid = low + ((high - low) / 2U);
+        if (clk_epoch_key(mid) < from_key)
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    *from = low;
+
+    low = 0U;
+    high = 0xFFFFFFFFU;
+    while (low < high)
+    {
+        uint32_t mid = (uint32_t)(low + (((uint64_t)high - low + 1U) / 2U));
+        if (clk_epoch_key(mid) > to_key)
+        {
+            high = mid - 1U;
+        }
+        else
+        {
+            low = mid;
+        }
+    }
+    *to = low;
+}
+
+static int ts_write_filter(const ts_store *store, csm_array *out, const ts_filter *filter, int empty)
+{
+    ts_axdr_ctx ctx;
+
+    // The array length comes first: count, then encode
+    uint32_t count = empty ? 0U : ts_count(store, filter);
+
+    ctx.store = store;
+    ctx.out = out;
+    ctx.valid = csm_array_write_u8(out, AXDR_TAG_ARRAY);
+    ctx.valid = ctx.valid && csm_ber_write_len(out, count);
+
+    if (ctx.valid && (count > 0U))
+    {
+        (void) ts_scan_filter(store, filter, ts_axdr_cb, &ctx);
+    }
+    return ctx.valid;
+}
+
+int ts_write_axdr(const ts_store *store, csm_array *out, uint64_t from_key, uint64_t to_key)
+{
+    ts_filter filter = { 0U, 0U, TS_MAX_COLUMNS, 0U, 0U };
+
+    ts_key_range(from_key, to_key, &filter.from, &filter.to);
+    return ts_write_filter(store, out, &filter, from_key > to_key);
+}
+
+int ts_write_axdr_values(const ts_store *store, csm_array *out, uint64_t from_key, uint64_t to_key, uint32_t column,
+                         uint32_t low, uint32_t high)
+{
+    ts_filter filter = { 0U, 0U, column, low, high };
+
+    ts_key_range(from_key, to_key, &filter.from, &filter.to);
+    return ts_write_filter(store, out, &filter, (from_key > to_key) || (low > high) || (column >= store->nb_columns));
+}
@@ -0,0 +1,105 @@
+/**
+ * Compressed time series of profile-generic buffers: delta-of-delta timestamps, delta values
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_array.h"
+
+#define TS_MAX_COLUMNS      4U      //!< Register values per row, besides the timestamp
+#define TS_BLOCK_BYTES      512U    //!< Encoded rows per block
+
+/**
+ * Rows are encoded in fixed-size blocks, each one decodable alone: the first row is kept in the
+ * header, the next ones are bit-packed. The timestamp is encoded as the difference of its interval
+ * with the previous one (0 for a constant capture period, one bit), each value as the zigzag
+ * difference with the previous one. A difference takes 1, 9, 15, 24 or 37 bits.
+ *
+ * The header also holds the time span and the value bounds of the block: a selection skips the
+ * blocks out of range without decoding them.
+ */
+typedef struct
+{
+    uint32_t first_time;
+    uint32_t last_time;
+    uint32_t first[TS_MAX_COLUMNS];
+    uint32_t min[TS_MAX_COLUMNS];
+    uint32_t max[TS_MAX_COLUMNS];
+    uint16_t rows;
+    uint16_t bits;                  //!< Used bits of data
+    uint8_t data[TS_BLOCK_BYTES];
+} ts_block;
+
+// The blocks form a ring, the oldest block is dropped when a new one is needed
+typedef struct
+{
+    ts_block *blocks;
+    uint32_t nb_blocks;
+    uint32_t head;                  //!< Oldest block
+    uint32_t used;                  //!< Blocks in use, the last one is being filled
+    uint32_t nb_columns;
+
+    // Last row appended, origin of the next differences
+    uint32_t last_time;
+    uint32_t last_interval;
+    uint32_t last[TS_MAX_COLUMNS];
+} ts_store;
+
+int ts_init(ts_store *store, ts_block *blocks, uint32_t nb_blocks, uint32_t nb_columns);
+
+/**
+ * @brief Append a row, timestamps strictly increasing (UTC seconds)
+ * @return FALSE if the timestamp is not after the last one
+ */
+int ts_append(ts_store *store, uint32_t time, const uint32_t *values);
+
+// Rows stored, and the encoded size (headers included)
+uint32_t ts_rows(const ts_store *store);
+uint32_t ts_size(const ts_store *store);
+
+// Return FALSE to stop the scan
+typedef int (*ts_row_cb)(void *ctx, uint32_t time, const uint32_t *values);
+
+/**
+ * @brief Decode the rows within [from, to] (UTC seconds, inclusive), oldest first
+ * @return the number of rows given to the callback
+ */
+uint32_t ts_scan(const ts_store *store, uint32_t from, uint32_t to, ts_row_cb callback, void *ctx);
+
+/**
+ * @brief Encode the rows within [from_key, to_key] as a profile buffer
+ *
+ * array { structure { date-time, double-long-unsigned... } }, the range is given by sortable keys
+ * (see clk_cosem_range_decode()), the date-times are in UTC.
+ * @return FALSE if the output is full
+ */
+int ts_write_axdr(const ts_store *store, csm_array *out, uint64_t from_key, uint64_t to_key);
+
+/**
+ * @brief Encode the rows within [from_key, to_key] whose value in the column is within [low, high]
+ *
+ * Range restricted by a captured register: the blocks whose bounds miss [low, high] are skipped, the
+ * blocks entirely within it are counted from their header.
+ * @return FALSE if the output is full
+ */
+int ts_write_axdr_values(const ts_store *store, csm_array *out, uint64_t from_key, uint64_t to_key, uint32_t column,
+                         uint32_t low, uint32_t high);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMESERIES_H
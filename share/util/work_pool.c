@@ -0,0 +1,247 @@
+/**
+ * Pool of worker threads with work-stealing deques
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "work_pool.h"
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define WP_MASK     ((int64_t)WP_DEQUE_SIZE - 1)
+
+// ----------------------------------- DEQUE -----------------------------------
+
+void wp_deque_init(wp_deque *dq)
+{
+    dq->top = 0;
+    dq->bottom = 0;
+}
+
+int wp_deque_push(wp_deque *dq, uint32_t task)
+{
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    int valid = ((b - t) < (int64_t)WP_DEQUE_SIZE);
+
+    if (valid)
+    {
+        dq->tasks[b & WP_MASK] = task;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return valid;
+}
+
+uint32_t wp_deque_pop(wp_deque *dq)
+{
+    uint32_t task = WP_EMPTY;
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+
+    __atomic_store_n(&dq->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (t <= b)
+    {
+        task = dq->tasks[b & WP_MASK];
+        if (t == b)
+        {
+            // Last task: race with the thieves
+            if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            {
+                task = WP_EMPTY;
+            }
+            __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        __atomic_store_n(&dq->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+uint32_t wp_deque_steal(wp_deque *dq)
+{
+    uint32_t task = WP_EMPTY;
+    int64_t t = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+
+    if (t < b)
+    {
+        task = dq->tasks[t & WP_MASK];
+        if (!__atomic_compare_exchange_n(&dq->top, &t, t + 1, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            task = WP_EMPTY;    // Lost the race, try elsewhere
+        }
+    }
+    return task;
+}
+
+// ----------------------------------- POOL -----------------------------------
+
+#ifdef USE_UNIX_OS
+
+// Own deque first, then the others in turn from the next worker
+static uint32_t wp_next_task(wp_pool *pool, uint32_t index)
+{
+    uint32_t task = wp_deque_pop(&pool->deques[index]);
+
+    for (uint32_t i = 1U; (task == WP_EMPTY) && (i < pool->nb_workers); i++)
+    {
+        task = wp_deque_steal(&pool->deques[(index + i) % pool->nb_workers]);
+    }
+    return task;
+}
+
+static void *wp_worker(void *arg)
+{
+    wp_pool *pool = (wp_pool *)arg;
+    uint32_t generation = 0U;
+
+    pthread_mutex_lock(&pool->lock);
+    uint32_t index = pool->started++;   // Deque owned by this thread
+    for (;;)
+    {
+        while (!pool->stop && (pool->generation == generation))
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop)
+        {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        while (__atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE) > 0U)
+        {
+            uint32_t task = wp_next_task(pool, index);
+            if (task != WP_EMPTY)
+            {
+                pool->fn(pool->ctx, task, index);
+                __atomic_sub_fetch(&pool->remaining, 1U, __ATOMIC_RELEASE);
+            }
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running--;
+        if (pool->running == 0U)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int wp_init(wp_pool *pool, uint32_t nb_workers)
+{
+    int valid = (nb_workers > 0U) && (nb_workers <= WP_MAX_WORKERS);
+
+    memset(pool, 0, sizeof(wp_pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (uint32_t i = 0U; valid && (i < nb_workers); i++)
+    {
+        wp_deque_init(&pool->deques[i]);
+        valid = (pthread_create(&pool->threads[i], NULL, wp_worker, pool) == 0);
+        if (valid)
+        {
+            pool->nb_workers++;
+        }
+    }
+
+    if (!valid)
+    {
+        wp_destroy(pool);
+    }
+    return valid;
+}
+
+void wp_destroy(wp_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0U; i < pool->nb_workers; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->nb_workers = 0U;
+}
+
+int wp_run(wp_pool *pool, wp_task_fn fn, void *ctx, uint32_t nb_tasks)
+{
+    int valid = (pool->nb_workers > 0U) && (nb_tasks <= (pool->nb_workers * WP_DEQUE_SIZE));
+
+    if (valid && (nb_tasks > 0U))
+    {
+        // The workers are idle: the deques can be filled from this thread
+        for (uint32_t i = 0U; i < pool->nb_workers; i++)
+        {
+            wp_deque_init(&pool->deques[i]);
+        }
+        for (uint32_t task = 0U; task < nb_tasks; task++)
+        {
+            (void) wp_deque_push(&pool->deques[task % pool->nb_workers], task);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->fn = fn;
+        pool->ctx = ctx;
+        pool->remaining = nb_tasks;
+        pool->running = pool->nb_workers;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        while (pool->running > 0U)
+        {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return valid;
+}
+
+#else
+
+int wp_init(wp_pool *pool, uint32_t nb_workers)
+{
+    memset(pool, 0, sizeof(wp_pool));
+    pool->nb_workers = (nb_workers > 0U) ? 1U : 0U;
+    return (pool->nb_workers > 0U);
+}
+
+void wp_destroy(wp_pool *pool)
+{
+    pool->nb_workers = 0U;
+}
+
+int wp_run(wp_pool *pool, wp_task_fn fn, void *ctx, uint32_t nb_tasks)
+{
+    int valid = (pool->nb_workers > 0U);
+
+    for (uint32_t task = 0U; valid && (task < nb_tasks); task++)
+    {
+        fn(ctx, task, 0U);
+    }
+    return valid;
+}
+
+#endif // USE_UNIX_OS
@@ -0,0 +1,87 @@
+/**
+ * Pool of worker threads with work-stealing deques
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifdef USE_UNIX_OS
+#include <pthread.h>
+#endif
+
+#define WP_MAX_WORKERS      64U
+#define WP_DEQUE_SIZE       1024U           //!< Tasks per worker deque, power of two
+#define WP_EMPTY            0xFFFFFFFFU
+
+/**
+ * Chase-Lev deque: the owner pushes and pops at the bottom, the other workers steal at the top.
+ * Only the owner may push, except before the workers are started (see wp_run()).
+ */
+typedef struct
+{
+    volatile int64_t top;
+    volatile int64_t bottom;
+    uint32_t tasks[WP_DEQUE_SIZE];
+} wp_deque;
+
+void wp_deque_init(wp_deque *dq);
+int wp_deque_push(wp_deque *dq, uint32_t task);
+uint32_t wp_deque_pop(wp_deque *dq);
+uint32_t wp_deque_steal(wp_deque *dq);
+
+// Task function: 'task' is the index given to wp_run(), 'worker' the index of the thread running it
+typedef void (*wp_task_fn)(void *ctx, uint32_t task, uint32_t worker);
+
+typedef struct
+{
+    wp_deque deques[WP_MAX_WORKERS];
+    uint32_t nb_workers;
+
+#ifdef USE_UNIX_OS
+    pthread_t threads[WP_MAX_WORKERS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+#endif
+    uint32_t started;               //!< Workers that have taken their deque index
+    uint32_t generation;            //!< Incremented by each wp_run()
+    uint32_t running;               //!< Workers still in the current run
+    int stop;
+
+    // Current run
+    wp_task_fn fn;
+    void *ctx;
+    volatile uint32_t remaining;    //!< Tasks not executed yet
+} wp_pool;
+
+// Without USE_UNIX_OS, there is no thread: wp_run() executes the tasks in the calling thread as worker 0
+int wp_init(wp_pool *pool, uint32_t nb_workers);
+void wp_destroy(wp_pool *pool);
+
+/**
+ * @brief Execute the tasks 0 .. nb_tasks - 1 on the workers and wait for their completion
+ *
+ * The tasks are dealt round-robin to the deques, an idle worker steals from the others so that the
+ * slow tasks do not hold the run. Not reentrant: one run at a time per pool.
+ * @return FALSE if there are more tasks than the deques can hold
+ */
+int wp_run(wp_pool *pool, wp_task_fn fn, void *ctx, uint32_t nb_tasks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WORK_POOL_H
@@ -0,0 +1,3 @@
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), sim_main.c sim_meter.c sim_server.c)
@@ -0,0 +1,243 @@
+/**
+ * Meter simulator entry point
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+
+#include "simulator.h"
+#include "mapped_file.h"
+
+#define SIM_MAX_PROFILE_ENTRIES     185U    ///< Keep the profile buffer within one APDU
+
+static sim_config config;
+static mapped_file snapshot;
+
+static void sim_usage(const char *name)
+{
+    printf("Usage: %s [-n meters] [-w workers] [-E executors] [-p base_port] [-a address] [-t tcp|udp|hdlc] [-e profile_entries]\r\n", name);
+    printf("          [-l latency_ms] [-j jitter_ms] [-D drop] [-C corrupt] [-K disconnect] [-X exception]\r\n");
+    printf("          [-r apdus_per_s[:burst]] [-R bytes_per_s[:burst]] [-Q max_delay_ms]\r\n");
+    printf("          [-s snapshot] [-m objdb] [-L event_log] [-c capture] [-P capture [-T]]\r\n");
+    printf("-E executes the APDUs on separate threads, the workers only handle the network.\r\n");
+    printf("Fault injection rates are given per thousand.\r\n");
+    printf("Admission control is per client address, client SAP and meter; the burst defaults to one second.\r\n");
+    printf("The snapshot file keeps the UDP associations across a restart.\r\n");
+    printf("-c records the frames, -P replays a capture offline and exits (-T: at the original pace).\r\n");
+}
+
+// "rate[:burst]"
+static void sim_parse_limit(const char *arg, adm_limit *limit)
+{
+    char *end = NULL;
+
+    limit->rate = strtoul(arg, &end, 10);
+    limit->burst = ((end != NULL) && (*end == ':')) ? strtoul(end + 1, NULL, 10) : limit->rate;
+}
+
+// Each meter needs one socket plus its connections
+static void sim_raise_fd_limit(uint32_t nb_meters)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        rlim_t needed = (rlim_t)nb_meters * 4U + 64U;
+        if (limit.rlim_cur < needed)
+        {
+            limit.rlim_cur = (needed < limit.rlim_max) ? needed : limit.rlim_max;
+            (void) setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    config.nb_meters = 100U;
+    config.nb_workers = 4U;
+    config.base_port = 4059U;
+    config.bind_addr = htonl(INADDR_LOOPBACK);
+    config.transport = SIM_TCP;
+    config.profile_entries = 96U;
+
+    while ((opt = getopt(argc, argv, "n:w:E:p:a:t:e:l:j:D:C:K:X:r:R:Q:s:m:L:c:P:Th")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.nb_meters = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            config.nb_workers = strtoul(optarg, NULL, 10);
+            break;
+        case 'E':
+            config.nb_executors = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            config.base_port = (uint16_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            if (inet_pton(AF_INET, optarg, &config.bind_addr) != 1)
+            {
+                printf("Bad address: %s\r\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            if (strcmp(optarg, "udp") == 0)
+            {
+                config.transport = SIM_UDP;
+            }
+            else if (strcmp(optarg, "hdlc") == 0)
+            {
+                config.transport = SIM_HDLC;
+            }
+            else
+            {
+                config.transport = SIM_TCP;
+            }
+            break;
+        case 'e':
+            config.profile_entries = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            config.latency_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            config.jitter_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'D':
+            config.drop_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'C':
+            config.corrupt_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'K':
+            config.disconnect_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'X':
+            config.exception_permille = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            sim_parse_limit(optarg, &config.apdus);
+            break;
+        case 'R':
+            sim_parse_limit(optarg, &config.bytes);
+            break;
+        case 'Q':
+            config.max_delay_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.snapshot_file = optarg;
+            break;
+        case 'm':
+            config.objdb_file = optarg;
+            break;
+        case 'L':
+            config.log_file = optarg;
+            break;
+        case 'c':
+            config.capture_file = optarg;
+            break;
+        case 'P':
+            config.replay_file = optarg;
+            break;
+        case 'T':
+            config.replay_timing = TRUE;
+            break;
+        default:
+            sim_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((config.nb_workers == 0U) || (config.nb_workers > SIM_MAX_WORKERS) || (config.nb_executors > SIM_MAX_WORKERS) || (config.nb_meters == 0U) ||
+        ((config.base_port + config.nb_meters) > 65536U))
+    {
+        sim_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (config.profile_entries > SIM_MAX_PROFILE_ENTRIES)
+    {
+        config.profile_entries = SIM_MAX_PROFILE_ENTRIES;
+    }
+
+    sim_raise_fd_limit(config.nb_meters);
+
+    if (!sim_meters_init(&config))
+    {
+        printf("[SIM] Initialization failure\r\n");
+        return EXIT_FAILURE;
+    }
+
+    if (config.replay_file != NULL)
+    {
+        return sim_server_replay(&config) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Sessions are resumed before the first frame is received
+    if ((config.snapshot_file != NULL) && (config.transport == SIM_UDP))
+    {
+        if (mapped_file_open(&snapshot, config.snapshot_file, sim_meters_snapshot_size()))
+        {
+            printf("[SIM] %d associations resumed from %s\r\n", sim_meters_restore(snapshot.data, snapshot.size),
+                   config.snapshot_file);
+            // The restored counters are limited to their window: reserve the next one before serving
+            if (sim_meters_save(snapshot.data, snapshot.size) && mapped_file_sync(&snapshot))
+            {
+                (void) sim_meters_reserve(snapshot.data, snapshot.size);
+            }
+        }
+        else
+        {
+            printf("[SIM] Cannot map %s, no snapshot\r\n", config.snapshot_file);
+        }
+    }
+
+    if (!sim_server_start(&config))
+    {
+        printf("[SIM] Initialization failure\r\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("[SIM] %u meters on ports %u-%u, %u workers, %u executors\r\n", config.nb_meters, config.base_port,
+           config.base_port + config.nb_meters - 1U, config.nb_workers, config.nb_executors);
+
+    for (;;)
+    {
+        sim_stats stats;
+
+        sleep(1);
+        sim_server_flush_capture();
+        if (snapshot.data != NULL)
+        {
+            // The counters saved ahead are used once the image is on disk
+            if (sim_meters_save(snapshot.data, snapshot.size) && mapped_file_sync(&snapshot))
+            {
+                (void) sim_meters_reserve(snapshot.data, snapshot.size);
+            }
+        }
+
+        sim_server_get_stats(&stats);
+        printf("[SIM] conn=%u req=%u rep=%u drop=%u corrupt=%u disc=%u exc=%u bad=%u delayed=%u rejected=%u\r\n",
+               stats.connections, stats.requests, stats.replies, stats.dropped, stats.corrupted,
+               stats.disconnected, stats.exceptions, stats.bad_frames, stats.delayed, stats.rejected);
+        fflush(stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,793 @@
+/**
+ * Meter simulator: synthetic object model and access to the server stack
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simulator.h"
+#include "csm_channel.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+#include "csm_snapshot.h"
+#include "csm_objdb.h"
+#include "clock.h"
+#include "host_hal.h"
+#include "mapped_file.h"
+#include "event_log.h"
+#include "os_util.h"
+
+#define SIM_EPOCH_ORIGIN    1483228800U     ///< 2017-01-01 00:00:00 UTC, origin of the synthetic energy index
+#define SIM_UNIT_WH         30U
+
+static const csm_asso_config cAssoConf[SIM_NB_CLIENTS] =
+{
+    { { 0x10U, SIM_SERVER_SAP }, CSM_CBLOCK_GET | CSM_CBLOCK_SELECTIVE_ACCESS | CSM_CBLOCK_BLOCK_TRANSFER_WITH_GET_OR_READ, FALSE },
+    { { 0x01U, SIM_SERVER_SAP }, CSM_CBLOCK_GET | CSM_CBLOCK_SET | CSM_CBLOCK_ACTION | CSM_CBLOCK_SELECTIVE_ACCESS | CSM_CBLOCK_BLOCK_TRANSFER_WITH_GET_OR_READ, FALSE },
+};
+
+static const csm_obis_code cLdnObis        = { 0U, 0U, 42U, 0U, 0U, 0xFFU };
+static const csm_obis_code cSerialObis     = { 0U, 0U, 96U, 1U, 0U, 0xFFU };
+static const csm_obis_code cClockObis      = { 0U, 0U, 1U, 0U, 0U, 0xFFU };
+static const csm_obis_code cEnergyObis     = { 1U, 0U, 1U, 8U, 0U, 0xFFU };
+static const csm_obis_code cProfileObis    = { 1U, 0U, 99U, 1U, 0U, 0xFFU };
+static const csm_obis_code cEventLogObis   = { 0U, 0U, 99U, 98U, 0U, 0xFFU };
+static const csm_obis_code cEventCodeObis  = { 0U, 0U, 96U, 11U, 0U, 0xFFU };
+
+// Event log record, the columns are the capture objects
+typedef struct
+{
+    uint32_t timestamp;
+    uint32_t meter;
+    uint8_t code;
+    uint8_t reserved[3];
+} sim_event_record;
+
+#define SIM_EVENT_COLUMNS   3U
+
+// Context of an execution thread: its own stack channel, the database handler finds it from the channel id
+typedef struct
+{
+    sim_meter *meter;
+    uint32_t *rand_state;
+    sim_stats *stats;
+} sim_lane;
+
+static csm_channel channels[SIM_MAX_LANES];
+static sim_lane lanes[SIM_MAX_LANES];
+
+// The associations of a meter are executed by one thread at a time, the meters in parallel
+static sim_meter *meters = NULL;
+static pthread_mutex_t *meter_locks = NULL;
+static ts_block *profile_blocks = NULL;
+
+// Serializes the appends and the seals of the event log, the committer thread writes outside of it
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t log_committer;
+static mapped_file objdb_image;
+static evl_log event_log;
+static uint8_t event_staging[2U * SIM_LOG_STAGING * sizeof(sim_event_record)];
+static int event_log_open = FALSE;
+static const sim_config *sim_cfg = NULL;
+
+uint32_t sim_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    *state = x;
+    return x;
+}
+
+// ----------------------------------- OBJECT MODEL -----------------------------------
+
+static int sim_obis_equal(const csm_obis_code *a, const csm_obis_code *b)
+{
+    return (memcmp(&a->A, &b->A, 6U) == 0) ? TRUE : FALSE;
+}
+
+static uint32_t sim_meter_time(const sim_meter *meter)
+{
+    return (uint32_t)((int64_t)time(NULL) + meter->clock_offset);
+}
+
+// Ages of the handshakes: the clients silent after their AARQ give their slot back
+static uint32_t sim_monotonic_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec;
+}
+
+// Energy index in Wh, monotonic, different slope for each meter
+static uint32_t sim_meter_energy(const sim_meter *meter, uint32_t timestamp)
+{
+    uint32_t periods = (timestamp > SIM_EPOCH_ORIGIN) ? ((timestamp - SIM_EPOCH_ORIGIN) / SIM_PROFILE_PERIOD) : 0U;
+    return (meter->seed % 100000U) + (periods * (5U + (meter->seed % 13U)));
+}
+
+static int sim_wr_datetime(csm_array *out, uint32_t timestamp)
+{
+    struct tm tms;
+    clk_to_datetime(timestamp, &tms);
+
+    int valid = csm_array_write_u8(out, AXDR_TAG_OCTETSTRING);
+    valid = valid && csm_array_write_u8(out, 12U);
+    valid = valid && csm_array_write_u16(out, (uint16_t)(tms.tm_year + 1900));
+    valid = valid && csm_array_write_u8(out, (uint8_t)(tms.tm_mon + 1));
+    valid = valid && csm_array_write_u8(out, (uint8_t)tms.tm_mday);
+    valid = valid && csm_array_write_u8(out, (uint8_t)((tms.tm_wday == 0) ? 7 : tms.tm_wday)); // Monday is 1
+    valid = valid && csm_array_write_u8(out, (uint8_t)tms.tm_hour);
+    valid = valid && csm_array_write_u8(out, (uint8_t)tms.tm_min);
+    valid = valid && csm_array_write_u8(out, (uint8_t)tms.tm_sec);
+    valid = valid && csm_array_write_u8(out, 0U);       // hundredths
+    valid = valid && csm_array_write_u16(out, 0U);      // deviation: UTC
+    valid = valid && csm_array_write_u8(out, 0U);       // status
+    return valid;
+}
+
+static int sim_wr_string(csm_array *out, const char *str)
+{
+    return csm_axdr_wr_octetstring(out, (const uint8_t *)str, (uint32_t)strlen(str));
+}
+
+static csm_db_code sim_set_clock(sim_meter *meter, csm_array *in)
+{
+    csm_db_code code = CSM_ERR_DATA_CONTENT_NOT_OK;
+    uint32_t size = 0U;
+
+    if (csm_axdr_rd_octetstring(in, &size) && (size == 12U) && (csm_array_unread(in) >= 12U))
+    {
+        const uint8_t *dt = csm_array_rd_data(in);
+        struct tm tms;
+
+        memset(&tms, 0, sizeof(tms));
+        tms.tm_year = (int)GET_BE16(&dt[0]) - 1900;
+        tms.tm_mon = (int)dt[2] - 1;
+        tms.tm_mday = dt[3];
+        tms.tm_hour = dt[5];
+        tms.tm_min = dt[6];
+        tms.tm_sec = dt[7];
+
+        if (clk_is_valid_date(GET_BE16(&dt[0]), dt[2], dt[3]) && (dt[5] < 24U) && (dt[6] < 60U) && (dt[7] < 60U))
+        {
+            meter->clock_offset = (int32_t)((int64_t)clk_to_epoch(&tms) - (int64_t)time(NULL));
+            code = CSM_OK;
+        }
+    }
+    return code;
+}
+
+// Capture the periods elapsed up to the meter time, at most the buffer depth
+static void sim_profile_capture(sim_meter *meter)
+{
+    uint32_t entries = sim_cfg->profile_entries;
+    uint32_t last = (sim_meter_time(meter) / SIM_PROFILE_PERIOD) * SIM_PROFILE_PERIOD;
+    uint32_t first = last - ((entries - 1U) * SIM_PROFILE_PERIOD);
+
+    // A clock set backwards stops the capture until the meter time passes the newest entry
+    if ((meter->profile.used > 0U) && (meter->profile.last_time >= first))
+    {
+        first = meter->profile.last_time + SIM_PROFILE_PERIOD;
+    }
+    for (uint32_t timestamp = first; timestamp <= last; timestamp += SIM_PROFILE_PERIOD)
+    {
+        uint32_t energy = sim_meter_energy(meter, timestamp);
+        (void) ts_append(&meter->profile, timestamp, &energy);
+    }
+}
+
+/**
+ * Decode a range_descriptor restricted by the clock (key range) or by the energy register ([low, high] in Wh)
+ */
+static int sim_profile_range_decode(const csm_array *sel, uint64_t *from, uint64_t *to, int *by_energy, uint32_t *low, uint32_t *high)
+{
+    csm_array array = *sel;
+    uint8_t byte = 0U;
+    uint16_t class_id = 0U;
+    uint32_t size = 0U;
+
+    // access_selector 1, structure { restricting_object { class_id, logical_name, attribute_index, data_index }, ... }
+    int valid = csm_array_read_u8(&array, &byte) && (byte == 1U);
+    valid = valid && csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_read_u8(&array, &byte) && (byte == 4U);
+    valid = valid && csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_read_u8(&array, &byte) && (byte == 4U);
+    valid = valid && csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_UNSIGNED16);
+    valid = valid && csm_array_read_u16(&array, &class_id);
+    valid = valid && csm_axdr_rd_octetstring(&array, &size) && (size == 6U) && (csm_array_unread(&array) >= 6U);
+
+    *by_energy = valid && (class_id == 3U) && (memcmp(csm_array_rd_data(&array), &cEnergyObis.A, 6U) == 0);
+    if (*by_energy)
+    {
+        // from_value and to_value: double-long-unsigned, the clock range is not restricted
+        valid = csm_array_reader_jump(&array, 6U + 2U + 3U);
+        valid = valid && csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_UNSIGNED32);
+        valid = valid && csm_array_read_u32(&array, low);
+        valid = valid && csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_UNSIGNED32);
+        valid = valid && csm_array_read_u32(&array, high);
+        *from = CLK_KEY_MIN;
+        *to = CLK_KEY_MAX;
+    }
+    else
+    {
+        array = *sel;
+        valid = clk_cosem_range_decode(&array, from, to);
+    }
+    return valid;
+}
+
+// The newest profile_entries entries of the stored profile, entries outside of the range are skipped
+static int sim_wr_profile_buffer(sim_meter *meter, csm_array *out, uint64_t from, uint64_t to, int by_energy, uint32_t low, uint32_t high)
+{
+    sim_profile_capture(meter);
+
+    uint32_t depth = (sim_cfg->profile_entries - 1U) * SIM_PROFILE_PERIOD;
+    uint32_t oldest = (meter->profile.last_time > depth) ? (meter->profile.last_time - depth) : 0U;
+    uint64_t oldest_key = clk_epoch_key(oldest);
+
+    from = (from < oldest_key) ? oldest_key : from;
+    return by_energy ? ts_write_axdr_values(&meter->profile, out, from, to, 0U, low, high)
+                     : ts_write_axdr(&meter->profile, out, from, to);
+}
+
+static int sim_wr_capture_objects(csm_array *out)
+{
+    csm_object_t obj;
+
+    int valid = csm_array_write_u8(out, AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_write_len(out, 2U);
+
+    obj.class_id = 8U;
+    obj.obis = cClockObis;
+    obj.id = 2;
+    obj.data_index = 0U;
+    valid = valid && csm_axdr_wr_capture_object(out, &obj);
+
+    obj.class_id = 3U;
+    obj.obis = cEnergyObis;
+    valid = valid && csm_axdr_wr_capture_object(out, &obj);
+    return valid;
+}
+
+// ----------------------------------- EVENT LOG -----------------------------------
+
+static void sim_log_event(const sim_meter *meter, enum sim_event code)
+{
+    if (event_log_open)
+    {
+        sim_event_record rec;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.timestamp = sim_meter_time(meter);
+        rec.meter = meter->id;
+        rec.code = (uint8_t)code;
+        pthread_mutex_lock(&log_lock);
+        (void) evl_append(&event_log, (const uint8_t *)&rec);
+        pthread_mutex_unlock(&log_lock);
+    }
+}
+
+// Group commit of the event log: the meters wait for the seal only, not for the writes and syncs
+static void *sim_log_committer(void *arg)
+{
+    (void) arg;
+
+    for (;;)
+    {
+        struct timespec ts = { 0, (long)SIM_LOG_COMMIT_MS * 1000000L };
+
+        (void) nanosleep(&ts, NULL);
+        pthread_mutex_lock(&log_lock);
+        (void) evl_seal(&event_log);
+        pthread_mutex_unlock(&log_lock);
+
+        // Records left by a failed write are retried first, the next seal waits for them
+        if (!evl_write(&event_log))
+        {
+            printf("[SIM] Event log commit failure\r\n");
+        }
+    }
+    return NULL;
+}
+
+static int sim_wr_event_capture_objects(csm_array *out)
+{
+    csm_object_t obj;
+
+    int valid = csm_array_write_u8(out, AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_write_len(out, SIM_EVENT_COLUMNS);
+
+    memset(&obj, 0, sizeof(obj));
+    obj.class_id = 8U;
+    obj.obis = cClockObis;
+    obj.id = 2;
+    valid = valid && csm_axdr_wr_capture_object(out, &obj);
+
+    obj.class_id = 1U;
+    obj.obis = cEventCodeObis;
+    valid = valid && csm_axdr_wr_capture_object(out, &obj);
+
+    obj.obis = cSerialObis;
+    valid = valid && csm_axdr_wr_capture_object(out, &obj);
+    return valid;
+}
+
+// Columns [from_column, to_column] of the entries [from_entry, to_entry], read from the committed log
+static int sim_wr_event_buffer(csm_array *out, uint32_t from_entry, uint32_t to_entry, uint16_t from_column, uint16_t to_column)
+{
+    sim_event_record records[SIM_LOG_MAX_READ];
+    uint64_t first = 0U;
+    uint32_t count = 0U;
+    char str[20];
+
+    count = evl_select(&event_log, from_entry, to_entry, &first);
+
+    if (to_column == 0U)
+    {
+        to_column = SIM_EVENT_COLUMNS;
+    }
+    if (from_column == 0U)
+    {
+        from_column = 1U;
+    }
+
+    int valid = (from_column <= to_column) && (to_column <= SIM_EVENT_COLUMNS);
+
+    // One APDU: the newest entries of the selection
+    if (count > SIM_LOG_MAX_READ)
+    {
+        first += count - SIM_LOG_MAX_READ;
+        count = SIM_LOG_MAX_READ;
+    }
+
+    valid = valid && evl_read(&event_log, first, count, (uint8_t *)records);
+
+    valid = valid && csm_array_write_u8(out, AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_write_len(out, count);
+
+    for (uint32_t i = 0U; (i < count) && valid; i++)
+    {
+        valid = csm_array_write_u8(out, AXDR_TAG_STRUCTURE);
+        valid = valid && csm_ber_write_len(out, (uint32_t)(to_column - from_column) + 1U);
+        for (uint16_t col = from_column; (col <= to_column) && valid; col++)
+        {
+            if (col == 1U)
+            {
+                valid = sim_wr_datetime(out, records[i].timestamp);
+            }
+            else if (col == 2U)
+            {
+                valid = csm_array_write_u8(out, AXDR_TAG_UNSIGNED8) && csm_array_write_u8(out, records[i].code);
+            }
+            else
+            {
+                snprintf(str, sizeof(str), "%08u", records[i].meter);
+                valid = sim_wr_string(out, str);
+            }
+        }
+    }
+    return valid;
+}
+
+static csm_db_code sim_get(sim_meter *meter, const csm_db_request *db_request, csm_array *out)
+{
+    const csm_object_t *obj = &db_request->logical_name;
+    csm_db_code code = CSM_ERR_OBJECT_NOT_FOUND;
+    int valid = FALSE;
+    char str[20];
+
+    if ((obj->class_id == 1U) && sim_obis_equal(&obj->obis, &cLdnObis) && (obj->id == 2))
+    {
+        snprintf(str, sizeof(str), "SIM%013u", meter->id);
+        valid = sim_wr_string(out, str);
+    }
+    else if ((obj->class_id == 1U) && sim_obis_equal(&obj->obis, &cSerialObis) && (obj->id == 2))
+    {
+        snprintf(str, sizeof(str), "%08u", meter->id);
+        valid = sim_wr_string(out, str);
+    }
+    else if ((obj->class_id == 8U) && sim_obis_equal(&obj->obis, &cClockObis) && (obj->id == 2))
+    {
+        valid = sim_wr_datetime(out, sim_meter_time(meter));
+    }
+    else if ((obj->class_id == 3U) && sim_obis_equal(&obj->obis, &cEnergyObis))
+    {
+        if (obj->id == 2)
+        {
+            valid = csm_axdr_wr_u32(out, sim_meter_energy(meter, sim_meter_time(meter)));
+        }
+        else if (obj->id == 3)
+        {
+            // scaler_unit: structure { integer, enum }
+            valid = csm_array_write_u8(out, AXDR_TAG_STRUCTURE);
+            valid = valid && csm_ber_write_len(out, 2U);
+            valid = valid && csm_axdr_wr_i8(out, 0);
+            valid = valid && csm_array_write_u8(out, AXDR_TAG_ENUM);
+            valid = valid && csm_array_write_u8(out, SIM_UNIT_WH);
+        }
+    }
+    else if ((obj->class_id == 7U) && sim_obis_equal(&obj->obis, &cEventLogObis) && event_log_open)
+    {
+        switch (obj->id)
+        {
+        case 2:
+        {
+            uint32_t from_entry = 1U;
+            uint32_t to_entry = 0U;
+            uint16_t from_column = 1U;
+            uint16_t to_column = 0U;
+            valid = TRUE;
+            if (db_request->sel_access.enable)
+            {
+                // Only the entry descriptor is supported
+                csm_array sel = db_request->sel_access.data;
+                valid = evl_entry_decode(&sel, &from_entry, &to_entry, &from_column, &to_column);
+                code = valid ? code : CSM_ERR_DATA_CONTENT_NOT_OK;
+            }
+            valid = valid && sim_wr_event_buffer(out, from_entry, to_entry, from_column, to_column);
+            break;
+        }
+        case 3:
+            valid = sim_wr_event_capture_objects(out);
+            break;
+        case 4:
+            valid = csm_axdr_wr_u32(out, 0U);   // asynchronous capture
+            break;
+        case 7:
+            valid = csm_axdr_wr_u32(out, evl_entries(&event_log));
+            break;
+        case 8:
+            valid = csm_axdr_wr_u32(out, SIM_LOG_ENTRIES);
+            break;
+        default:
+            break;
+        }
+    }
+    else if ((obj->class_id == 7U) && sim_obis_equal(&obj->obis, &cProfileObis))
+    {
+        switch (obj->id)
+        {
+        case 2:
+        {
+            uint64_t from = CLK_KEY_MIN;
+            uint64_t to = CLK_KEY_MAX;
+            int by_energy = FALSE;
+            uint32_t low = 0U;
+            uint32_t high = 0U;
+            valid = TRUE;
+            if (db_request->sel_access.enable)
+            {
+                // Only the range descriptor is supported
+                valid = sim_profile_range_decode(&db_request->sel_access.data, &from, &to, &by_energy, &low, &high);
+                code = valid ? code : CSM_ERR_DATA_CONTENT_NOT_OK;
+            }
+            valid = valid && sim_wr_profile_buffer(meter, out, from, to, by_energy, low, high);
+            break;
+        }
+        case 3:
+            valid = sim_wr_capture_objects(out);
+            break;
+        case 4:
+            valid = csm_axdr_wr_u32(out, SIM_PROFILE_PERIOD);
+            break;
+        case 7:
+        case 8:
+            valid = csm_axdr_wr_u32(out, sim_cfg->profile_entries);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (valid)
+    {
+        code = CSM_OK;
+    }
+    return code;
+}
+
+static csm_db_code sim_db_access(csm_array *in, csm_array *out, csm_request *request)
+{
+    csm_db_code code = CSM_ERR_UNAUTHORIZED_ACCESS;
+    const csm_object_t *obj = &request->db_request.logical_name;
+    const sim_lane *lane = &lanes[request->channel_id - 1U];
+    sim_meter *meter = lane->meter;
+
+    if ((sim_rand(lane->rand_state) % 1000U) < sim_cfg->exception_permille)
+    {
+        lane->stats->exceptions++;
+        code = CSM_ERR_TEMPORARY_FAILURE;
+    }
+    else if (request->db_request.service == SVC_GET)
+    {
+        code = sim_get(meter, &request->db_request, out);
+    }
+    else if (request->db_request.service == SVC_SET)
+    {
+        if ((obj->class_id == 8U) && sim_obis_equal(&obj->obis, &cClockObis) && (obj->id == 2))
+        {
+            code = sim_set_clock(meter, in);
+            if (code == CSM_OK)
+            {
+                sim_log_event(meter, SIM_EVENT_CLOCK_SET);
+            }
+        }
+    }
+    return code;
+}
+
+// ----------------------------------- STACK ACCESS -----------------------------------
+
+int sim_meters_init(const sim_config *config)
+{
+    int ret = FALSE;
+
+    sim_cfg = config;
+    meters = calloc(config->nb_meters, sizeof(sim_meter));
+    meter_locks = calloc(config->nb_meters, sizeof(pthread_mutex_t));
+    profile_blocks = calloc(config->nb_meters * SIM_PROFILE_BLOCKS, sizeof(ts_block));
+
+    if ((meters != NULL) && (meter_locks != NULL) && (profile_blocks != NULL))
+    {
+        for (uint32_t i = 0U; i < config->nb_meters; i++)
+        {
+            pthread_mutex_init(&meter_locks[i], NULL);
+            (void) ts_init(&meters[i].profile, &profile_blocks[i * SIM_PROFILE_BLOCKS], SIM_PROFILE_BLOCKS, 1U);
+            meters[i].id = i;
+            meters[i].seed = (i + 1U) * 2654435761U; // Knuth multiplicative hash
+            for (uint32_t k = 0U; k < SIM_NB_CLIENTS; k++)
+            {
+                csm_asso_init(&meters[i].asso[k]);
+                meters[i].asso[k].config = &cAssoConf[k];
+            }
+        }
+
+        host_hal_init();
+        csm_asso_set_clock(sim_monotonic_s);
+        ret = TRUE;
+        if (config->objdb_file == NULL)
+        {
+            csm_services_init(sim_db_access);
+        }
+        else
+        {
+            // The image routes the dynamic attributes to the simulator, the constant ones are served in place
+            static const csm_db_access_handler handlers[] = { sim_db_access };
+
+            ret = mapped_file_open_ro(&objdb_image, config->objdb_file) &&
+                  csm_objdb_load(objdb_image.data, objdb_image.size, handlers, 1U);
+            if (ret)
+            {
+                csm_services_init(csm_objdb_access);
+            }
+            else
+            {
+                printf("[SIM] Cannot load the object model %s\r\n", config->objdb_file);
+            }
+        }
+        if (ret && (config->log_file != NULL))
+        {
+            event_log_open = evl_open(&event_log, config->log_file, sizeof(sim_event_record), SIM_LOG_ENTRIES,
+                                      event_staging, SIM_LOG_STAGING, SIM_LOG_COMMIT_MS);
+            ret = event_log_open && (pthread_create(&log_committer, NULL, sim_log_committer, NULL) == 0);
+            if (!ret)
+            {
+                printf("[SIM] Cannot open the event log %s\r\n", config->log_file);
+            }
+        }
+        // The associations are kept in the meters, one channel per execution thread
+        csm_channel_init(channels, SIM_MAX_LANES, NULL, NULL, 0U);
+        for (uint32_t i = 0U; i < SIM_MAX_LANES; i++)
+        {
+            ret = ret && (csm_channel_new() == (uint8_t)(i + 1U));
+            channels[i].llc.dsap = SIM_SERVER_SAP;
+        }
+    }
+    return ret;
+}
+
+sim_meter *sim_meter_get(uint32_t id)
+{
+    return ((meters != NULL) && (id < sim_cfg->nb_meters)) ? &meters[id] : NULL;
+}
+
+static int sim_client_index(uint16_t client_sap)
+{
+    int index = -1;
+    for (uint32_t k = 0U; k < SIM_NB_CLIENTS; k++)
+    {
+        if (cAssoConf[k].llc.ssap == client_sap)
+        {
+            index = (int)k;
+            break;
+        }
+    }
+    return index;
+}
+
+uint32_t sim_meter_execute(sim_meter *meter, uint16_t client_sap, uint8_t *buffer, uint32_t size, uint32_t lane, uint32_t *rand_state, sim_stats *stats)
+{
+    uint32_t reply_size = 0U;
+    int k = sim_client_index(client_sap);
+
+    if ((k >= 0) && (lane < SIM_MAX_LANES))
+    {
+        csm_array packet;
+        csm_asso_state *asso = &meter->asso[k];
+        pthread_mutex_t *lock = &meter_locks[meter->id];
+
+        csm_array_init(&packet, buffer, SIM_BUF_SIZE, size, SIM_HEADROOM);
+        lanes[lane].meter = meter;
+        lanes[lane].rand_state = rand_state;
+        lanes[lane].stats = stats;
+        channels[lane].llc.ssap = client_sap;
+
+        pthread_mutex_lock(lock);
+        enum state_cf before = asso->state_cf;
+        int ret = csm_channel_execute_asso((uint8_t)lane, asso, &meter->sec[k], &packet);
+
+        if ((before != CF_ASSOCIATED) && (asso->state_cf == CF_ASSOCIATED))
+        {
+            sim_log_event(meter, SIM_EVENT_ASSOCIATED);
+        }
+        else if ((before == CF_ASSOCIATED) && (asso->state_cf != CF_ASSOCIATED))
+        {
+            sim_log_event(meter, SIM_EVENT_RELEASED);
+        }
+        pthread_mutex_unlock(lock);
+
+        reply_size = (ret > 0) ? (uint32_t)ret : 0U;
+    }
+    return reply_size;
+}
+
+void sim_meter_release(sim_meter *meter, uint16_t client_sap)
+{
+    int k = sim_client_index(client_sap);
+
+    if (k >= 0)
+    {
+        pthread_mutex_lock(&meter_locks[meter->id]);
+        if (meter->asso[k].state_cf == CF_ASSOCIATED)
+        {
+            sim_log_event(meter, SIM_EVENT_RELEASED);
+        }
+        csm_asso_release_handshake(&meter->asso[k]);
+        csm_asso_init(&meter->asso[k]);
+        pthread_mutex_unlock(&meter_locks[meter->id]);
+    }
+}
+
+// ----------------------------------- SNAPSHOT -----------------------------------
+
+uint32_t sim_meters_snapshot_size(void)
+{
+    return csm_snapshot_size(sim_cfg->nb_meters * SIM_NB_CLIENTS, SIM_MAX_LANES);
+}
+
+// Copy of the invocation counters of all the meters, in the order of the image
+static csm_sec_context *sim_meters_sec(uint32_t nb_assos)
+{
+    csm_sec_context *flat = malloc(nb_assos * sizeof(csm_sec_context));
+
+    for (uint32_t i = 0U; (flat != NULL) && (i < sim_cfg->nb_meters); i++)
+    {
+        pthread_mutex_lock(&meter_locks[i]);
+        memcpy(&flat[i * SIM_NB_CLIENTS], meters[i].sec, sizeof(meters[i].sec));
+        pthread_mutex_unlock(&meter_locks[i]);
+    }
+    return flat;
+}
+
+// The meter states are not contiguous, the image is built from a flat copy of the associations
+int sim_meters_save(uint8_t *image, uint32_t size)
+{
+    static csm_channel lane_channels[SIM_MAX_LANES];
+    uint32_t nb_assos = sim_cfg->nb_meters * SIM_NB_CLIENTS;
+    csm_asso_state *flat = malloc(nb_assos * sizeof(csm_asso_state));
+    csm_sec_context *sec = sim_meters_sec(nb_assos);
+    uint32_t written = 0U;
+
+    if ((flat != NULL) && (sec != NULL))
+    {
+        for (uint32_t i = 0U; i < sim_cfg->nb_meters; i++)
+        {
+            pthread_mutex_lock(&meter_locks[i]);
+            memcpy(&flat[i * SIM_NB_CLIENTS], meters[i].asso, sizeof(meters[i].asso));
+            pthread_mutex_unlock(&meter_locks[i]);
+        }
+        // The client SAP of a lane changes with each APDU, only its binding is kept
+        memset(lane_channels, 0, sizeof(lane_channels));
+        for (uint32_t i = 0U; i < SIM_MAX_LANES; i++)
+        {
+            lane_channels[i].channel_id = channels[i].channel_id;
+            lane_channels[i].llc.dsap = SIM_SERVER_SAP;
+        }
+
+        written = csm_snapshot_save(image, size, flat, sec, nb_assos, lane_channels, SIM_MAX_LANES);
+    }
+    free(flat);
+    free(sec);
+    return (written > 0U) ? TRUE : FALSE;
+}
+
+int sim_meters_reserve(const uint8_t *image, uint32_t size)
+{
+    uint32_t nb_assos = sim_cfg->nb_meters * SIM_NB_CLIENTS;
+    csm_sec_context *sec = sim_meters_sec(nb_assos);
+    int valid = (sec != NULL) && csm_snapshot_reserve(image, size, sec, nb_assos);
+
+    // Only the limits: the counters moved since the copy
+    for (uint32_t i = 0U; valid && (i < sim_cfg->nb_meters); i++)
+    {
+        pthread_mutex_lock(&meter_locks[i]);
+        for (uint32_t k = 0U; k < SIM_NB_CLIENTS; k++)
+        {
+            meters[i].sec[k].server_ic_limit = sec[(i * SIM_NB_CLIENTS) + k].server_ic_limit;
+        }
+        pthread_mutex_unlock(&meter_locks[i]);
+    }
+    free(sec);
+    return valid;
+}
+
+int sim_meters_restore(const uint8_t *image, uint32_t size)
+{
+    uint32_t nb_assos = sim_cfg->nb_meters * SIM_NB_CLIENTS;
+    csm_asso_state *flat = calloc(nb_assos, sizeof(csm_asso_state));
+    csm_sec_context *sec = calloc(nb_assos, sizeof(csm_sec_context));
+    int resumed = -1;
+
+    if ((flat != NULL) && (sec != NULL))
+    {
+        for (uint32_t i = 0U; i < nb_assos; i++)
+        {
+            csm_asso_init(&flat[i]);
+        }
+        // The lanes are bound again by the image, before any APDU is executed
+        for (uint32_t i = 0U; i < SIM_MAX_LANES; i++)
+        {
+            channels[i].asso = NULL;
+            csm_channel_disconnect((uint8_t)i);
+        }
+
+        // The counters are restored even without an established association: a nonce is never used twice
+        resumed = csm_snapshot_restore(image, size, flat, sec, nb_assos, cAssoConf, SIM_NB_CLIENTS);
+        for (uint32_t i = 0U; (i < sim_cfg->nb_meters) && (resumed >= 0); i++)
+        {
+            pthread_mutex_lock(&meter_locks[i]);
+            memcpy(meters[i].asso, &flat[i * SIM_NB_CLIENTS], sizeof(meters[i].asso));
+            memcpy(meters[i].sec, &sec[i * SIM_NB_CLIENTS], sizeof(meters[i].sec));
+            for (uint32_t k = 0U; k < SIM_NB_CLIENTS; k++)
+            {
+                meters[i].asso[k].config = &cAssoConf[k];
+            }
+            pthread_mutex_unlock(&meter_locks[i]);
+        }
+    }
+    // A lane missing from the image (or an invalid image) is bound again to its own channel
+    for (uint32_t i = 0U; i < SIM_MAX_LANES; i++)
+    {
+        csm_llc llc = { 0U, SIM_SERVER_SAP };
+        if ((channels[i].channel_id == INVALID_CHANNEL_ID) && !csm_channel_resume((uint8_t)(i + 1U), &llc))
+        {
+            resumed = -1;
+        }
+        channels[i].llc = llc;
+    }
+    free(flat);
+    free(sec);
+    return resumed;
+}
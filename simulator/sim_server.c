@@ -0,0 +1,1071 @@
+/**
+ * Meter simulator: multi-threaded network event loop (Linux epoll)
+ *
+ * Each worker thread owns a subset of the meters, with their listening sockets and connections.
+ * Transports: wrapper over TCP, wrapper over UDP, HDLC over TCP.
+ * The APDUs are executed by the worker, or submitted to the executor threads (see executor.h): the
+ * mailbox of a connection keeps its requests in order, the reply comes back through the outbox of its
+ * worker, which does the framing and the sending.
+ * The frames can be captured to a file and replayed offline through the same framing code.
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "simulator.h"
+#include "hdlc.h"
+#include "os_util.h"
+#include "capture.h"
+#include "executor.h"
+#include "csm_metrics.h"
+
+#define SIM_WRAPPER_HDR_SIZE    8U
+#define SIM_MAX_EVENTS          256U
+#define SIM_HDLC_UA             0x73U
+#define SIM_HDLC_LLC_SIZE       3U
+
+typedef struct sim_worker sim_worker;
+
+typedef struct sim_conn
+{
+    int fd;
+    int listening;                  //!< TRUE for a TCP listening socket
+    sim_meter *meter;
+    sim_worker *worker;
+    uint16_t client_sap;            //!< Last client seen on this connection
+    hdlc_t hdlc;
+    uint8_t vr;                     //!< HDLC receive sequence number
+    uint8_t vs;                     //!< HDLC send sequence number
+    struct sockaddr_in peer;        //!< TCP: remote end, UDP: sender of the last datagram
+    uint64_t due_ns;                //!< Reply deadline, 0 if no reply is pending
+    uint32_t pending_index;
+    ex_item item;                   //!< The APDU in work, submitted to the executor
+    ex_mailbox mailbox;
+    int attached;                   //!< Mailbox open in the executor
+    int in_flight;                  //!< APDU being executed, the next frames wait for its reply
+    uint32_t apdu_size;             //!< Request size, then reply size
+    uint32_t rx_size;
+    uint32_t tx_size;
+    uint32_t tx_sent;
+    uint8_t rx[SIM_BUF_SIZE];
+    uint8_t work[SIM_BUF_SIZE];     //!< APDU with headroom for the stack
+    uint8_t tx[SIM_BUF_SIZE];
+} sim_conn;
+
+struct sim_worker
+{
+    pthread_t thread;
+    int epfd;
+    int efd;                        //!< Eventfd signaled when the outbox is not empty
+    ex_outbox outbox;               //!< Executed APDUs of the connections of this worker
+    uint32_t rand_state;
+    sim_conn **pending;             //!< Connections waiting for their reply deadline
+    uint32_t nb_pending;
+    uint32_t max_pending;
+    adm_table admission;            //!< Unused (no entries) if no limit is configured
+    sim_stats stats;
+};
+
+// Executor threads state, the database handler of the meters uses them while it executes an APDU
+typedef struct
+{
+    uint32_t rand_state;
+    sim_stats stats;
+} sim_exec;
+
+static sim_worker workers[SIM_MAX_WORKERS];
+static const sim_config *sim_cfg = NULL;
+
+static ex_executor executor;
+static ex_mailbox **exec_slots = NULL;
+static sim_exec exec_states[WP_MAX_WORKERS];
+
+// Shared by the workers, the records are written in time order under the lock
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static cap_file capture;
+
+static uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t sim_epoch_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000U) + ((uint64_t)ts.tv_nsec / 1000U);
+}
+
+static int sim_roll(sim_worker *worker, uint32_t permille)
+{
+    return ((sim_rand(&worker->rand_state) % 1000U) < permille) ? TRUE : FALSE;
+}
+
+// ----------------------------------- CONNECTIONS -----------------------------------
+
+static void sim_pending_remove(sim_conn *conn)
+{
+    sim_worker *worker = conn->worker;
+
+    if (conn->due_ns != 0U)
+    {
+        // Swap with the last one
+        worker->nb_pending--;
+        worker->pending[conn->pending_index] = worker->pending[worker->nb_pending];
+        worker->pending[conn->pending_index]->pending_index = conn->pending_index;
+        conn->due_ns = 0U;
+    }
+}
+
+static int sim_pending_add(sim_conn *conn, uint64_t due_ns)
+{
+    sim_worker *worker = conn->worker;
+
+    if (worker->nb_pending >= worker->max_pending)
+    {
+        uint32_t size = (worker->max_pending == 0U) ? 64U : (worker->max_pending * 2U);
+        sim_conn **pending = realloc(worker->pending, size * sizeof(sim_conn *));
+        if (pending == NULL)
+        {
+            return FALSE;
+        }
+        worker->pending = pending;
+        worker->max_pending = size;
+    }
+    conn->pending_index = worker->nb_pending;
+    conn->due_ns = due_ns;
+    worker->pending[worker->nb_pending] = conn;
+    worker->nb_pending++;
+    return TRUE;
+}
+
+static void sim_conn_free(sim_conn *conn)
+{
+    if (conn->client_sap != 0U)
+    {
+        sim_meter_release(conn->meter, conn->client_sap);
+    }
+    if (conn->attached)
+    {
+        ex_mailbox_close(&executor, &conn->mailbox);
+    }
+    free(conn);
+}
+
+static void sim_conn_close(sim_conn *conn)
+{
+    sim_pending_remove(conn);
+    epoll_ctl(conn->worker->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+
+    // Still used by an executor thread: freed with its reply, see sim_handle_completions()
+    if (!conn->in_flight)
+    {
+        sim_conn_free(conn);
+    }
+}
+
+static sim_conn *sim_conn_new(sim_worker *worker, sim_meter *meter, int fd)
+{
+    sim_conn *conn = calloc(1U, sizeof(sim_conn));
+
+    if (conn != NULL)
+    {
+        conn->fd = fd;
+        conn->meter = meter;
+        conn->worker = worker;
+        hdlc_init(&conn->hdlc);
+        conn->hdlc.sender = HDLC_SERVER;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            free(conn);
+            conn = NULL;
+        }
+    }
+    return conn;
+}
+
+static void sim_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Send the reply, return FALSE if the connection must be closed
+static int sim_conn_flush(sim_conn *conn)
+{
+    int ret = TRUE;
+
+    if (sim_cfg->transport == SIM_UDP)
+    {
+        (void) sendto(conn->fd, conn->tx, conn->tx_size, 0, (struct sockaddr *)&conn->peer, sizeof(conn->peer));
+        conn->tx_sent = conn->tx_size;
+    }
+    else
+    {
+        while (conn->tx_sent < conn->tx_size)
+        {
+            ssize_t n = send(conn->fd, &conn->tx[conn->tx_sent], conn->tx_size - conn->tx_sent, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                conn->tx_sent += (uint32_t)n;
+            }
+            else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+            {
+                // Wait for the socket to be writable
+                struct epoll_event ev;
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.ptr = conn;
+                epoll_ctl(conn->worker->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+                break;
+            }
+            else
+            {
+                ret = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (conn->tx_sent >= conn->tx_size)
+    {
+        conn->tx_size = 0U;
+        conn->tx_sent = 0U;
+    }
+    return ret;
+}
+
+// ----------------------------------- CAPTURE -----------------------------------
+
+static void sim_capture(const sim_conn *conn, uint8_t direction, const uint8_t *frame, uint32_t size)
+{
+    if (capture.file != NULL)
+    {
+        pthread_mutex_lock(&capture_lock);
+        (void) cap_write(&capture, sim_epoch_us(), direction, conn->meter->id, frame, size);
+        pthread_mutex_unlock(&capture_lock);
+    }
+}
+
+void sim_server_flush_capture(void)
+{
+    pthread_mutex_lock(&capture_lock);
+    if (capture.file != NULL)
+    {
+        (void) cap_flush(&capture);
+    }
+    pthread_mutex_unlock(&capture_lock);
+}
+
+// ----------------------------------- ADMISSION -----------------------------------
+
+// The client is limited per meter: the key includes the meter
+static uint64_t sim_client_key(const sim_conn *conn, uint16_t client_sap)
+{
+    uint8_t id[8];
+
+    memcpy(&id[0], &conn->peer.sin_addr.s_addr, 4U);
+    PUT_BE32(&id[4], conn->meter->id);
+    return adm_key(id, sizeof(id), client_sap);
+}
+
+static enum adm_verdict sim_admit(sim_conn *conn, uint16_t client_sap, uint32_t size, uint32_t *delay_ms)
+{
+    enum adm_verdict verdict = ADM_ACCEPT;
+    sim_worker *worker = conn->worker;
+
+    if (worker->admission.entries != NULL)
+    {
+        verdict = adm_check(&worker->admission, sim_client_key(conn, client_sap), size, sim_now_ns() / 1000000U, delay_ms);
+
+        // A datagram cannot wait: the receive buffer is reused
+        if ((verdict == ADM_DELAY) && (sim_cfg->transport == SIM_UDP))
+        {
+            verdict = ADM_REJECT;
+        }
+
+        worker->stats.delayed += (verdict == ADM_DELAY) ? 1U : 0U;
+        worker->stats.rejected += (verdict == ADM_REJECT) ? 1U : 0U;
+    }
+    return verdict;
+}
+
+// ----------------------------------- FRAMING -----------------------------------
+
+// Return the size of the first complete frame in the receive buffer, 0 if incomplete
+static uint32_t sim_frame_size(sim_conn *conn)
+{
+    uint32_t size = 0U;
+
+    if (sim_cfg->transport == SIM_UDP)
+    {
+        size = conn->rx_size;
+    }
+    else if (sim_cfg->transport == SIM_TCP)
+    {
+        if (conn->rx_size >= SIM_WRAPPER_HDR_SIZE)
+        {
+            uint32_t frame_size = SIM_WRAPPER_HDR_SIZE + GET_BE16(&conn->rx[6]);
+            size = (conn->rx_size >= frame_size) ? frame_size : 0U;
+        }
+    }
+    else
+    {
+        // Resynchronize on the opening flag
+        uint32_t start = 0U;
+        while ((start < conn->rx_size) && (conn->rx[start] != 0x7EU))
+        {
+            start++;
+        }
+        if (start > 0U)
+        {
+            memmove(conn->rx, &conn->rx[start], conn->rx_size - start);
+            conn->rx_size -= start;
+        }
+
+        if (conn->rx_size >= 3U)
+        {
+            uint32_t frame_size = (((uint32_t)conn->rx[1] & 0x07U) << 8U) + conn->rx[2] + 2U;
+            size = (conn->rx_size >= frame_size) ? frame_size : 0U;
+        }
+    }
+    return size;
+}
+
+// Execute the APDU of the work buffer, the reply size is 0 if it is submitted to the executor
+static uint32_t sim_execute(sim_conn *conn, uint32_t apdu_size)
+{
+    uint32_t reply_size = 0U;
+
+    // Opened at the first request; without a free slot, the worker executes the APDUs itself
+    if ((executor.nb_workers > 0U) && !conn->attached)
+    {
+        conn->attached = ex_mailbox_open(&executor, &conn->mailbox, &conn->worker->outbox, conn);
+    }
+
+    if (conn->attached)
+    {
+        conn->apdu_size = apdu_size;
+        conn->in_flight = TRUE;
+        ex_submit(&executor, &conn->mailbox, &conn->item);
+    }
+    else
+    {
+        uint32_t lane = (uint32_t)(conn->worker - &workers[0]);
+        reply_size = sim_meter_execute(conn->meter, conn->client_sap, conn->work, apdu_size, lane, &conn->worker->rand_state, &conn->worker->stats);
+    }
+    return reply_size;
+}
+
+// Executor thread
+static void sim_exec_handler(void *ctx, ex_mailbox *mailbox, ex_item *item, uint32_t worker)
+{
+    sim_conn *conn = (sim_conn *)mailbox->owner;
+    sim_exec *state = &exec_states[worker];
+    (void) ctx;
+    (void) item;
+
+    // The executors use the lanes after the ones of the workers
+    conn->apdu_size = sim_meter_execute(conn->meter, conn->client_sap, conn->work, conn->apdu_size, sim_cfg->nb_workers + worker,
+                                        &state->rand_state, &state->stats);
+}
+
+static uint32_t sim_wrapper_reply(sim_conn *conn, uint32_t apdu_size)
+{
+    uint32_t reply_size = 0U;
+
+    if ((apdu_size > 0U) && (apdu_size <= (SIM_BUF_SIZE - SIM_WRAPPER_HDR_SIZE)))
+    {
+        PUT_BE16(&conn->tx[0], 1U);
+        PUT_BE16(&conn->tx[2], SIM_SERVER_SAP);
+        PUT_BE16(&conn->tx[4], conn->client_sap);
+        PUT_BE16(&conn->tx[6], (uint16_t)apdu_size);
+        memcpy(&conn->tx[SIM_WRAPPER_HDR_SIZE], &conn->work[SIM_HEADROOM], apdu_size);
+        reply_size = SIM_WRAPPER_HDR_SIZE + apdu_size;
+    }
+    return reply_size;
+}
+
+static uint32_t sim_handle_wrapper(sim_conn *conn, const uint8_t *frame, uint32_t size)
+{
+    uint32_t reply_size = 0U;
+    uint32_t apdu_size = size - SIM_WRAPPER_HDR_SIZE;
+
+    if ((size > SIM_WRAPPER_HDR_SIZE) && (GET_BE16(&frame[0]) == 1U) && (apdu_size <= (SIM_BUF_SIZE - SIM_HEADROOM)))
+    {
+        conn->client_sap = GET_BE16(&frame[2]);
+        memcpy(&conn->work[SIM_HEADROOM], &frame[SIM_WRAPPER_HDR_SIZE], apdu_size);
+        conn->worker->stats.requests++;
+
+        reply_size = sim_wrapper_reply(conn, sim_execute(conn, apdu_size));
+    }
+    else
+    {
+        conn->worker->stats.bad_frames++;
+    }
+    return reply_size;
+}
+
+// I frame carrying the reply APDU of the work buffer
+static int sim_hdlc_reply(sim_conn *conn, uint32_t apdu_size)
+{
+    hdlc_t *hdlc = &conn->hdlc;
+    int ret = -1;
+
+    if (apdu_size > 0U)
+    {
+        // LLC response header, written in the headroom just before the APDU
+        uint8_t *info = &conn->work[SIM_HEADROOM - SIM_HDLC_LLC_SIZE];
+        info[0] = 0xE6U;
+        info[1] = 0xE7U;
+        info[2] = 0x00U;
+
+        hdlc->rrr = conn->vr;
+        hdlc->sss = conn->vs;
+        ret = hdlc_encode_data(hdlc, conn->tx, SIM_BUF_SIZE, info, (uint16_t)(apdu_size + SIM_HDLC_LLC_SIZE));
+        conn->vs = (conn->vs + 1U) & 0x07U;
+    }
+    return ret;
+}
+
+static uint32_t sim_handle_hdlc(sim_conn *conn, const uint8_t *frame, uint32_t size)
+{
+    uint32_t reply_size = 0U;
+    hdlc_t *hdlc = &conn->hdlc;
+    int ret;
+
+    // The decoder expects the sender of the frame
+    hdlc->sender = HDLC_CLIENT;
+    ret = hdlc_decode(hdlc, frame, (uint16_t)size);
+    hdlc->sender = HDLC_SERVER;
+
+    if (ret != HDLC_OK)
+    {
+        conn->worker->stats.bad_frames++;
+        return 0U;
+    }
+
+    conn->client_sap = hdlc->client_addr;
+
+    switch (hdlc->type)
+    {
+    case HDLC_PACKET_TYPE_SNRM:
+        conn->vr = 0U;
+        conn->vs = 0U;
+        ret = hdlc_encode(hdlc, conn->tx, SIM_BUF_SIZE, SIM_HDLC_UA, NULL, 0U);
+        break;
+    case HDLC_PACKET_TYPE_DISC:
+        sim_meter_release(conn->meter, conn->client_sap);
+        ret = hdlc_encode(hdlc, conn->tx, SIM_BUF_SIZE, SIM_HDLC_UA, NULL, 0U);
+        break;
+    case HDLC_PACKET_TYPE_RR:
+        hdlc->rrr = conn->vr;
+        ret = hdlc_encode_rr(hdlc, conn->tx, SIM_BUF_SIZE);
+        break;
+    case HDLC_PACKET_TYPE_I:
+    {
+        uint32_t apdu_size = (hdlc->data_size > SIM_HDLC_LLC_SIZE) ? (hdlc->data_size - SIM_HDLC_LLC_SIZE) : 0U;
+        ret = -1;
+
+        if ((apdu_size > 0U) && (apdu_size <= (SIM_BUF_SIZE - SIM_HEADROOM - SIM_HDLC_LLC_SIZE)))
+        {
+            conn->vr = (hdlc->sss + 1U) & 0x07U;
+            memcpy(&conn->work[SIM_HEADROOM], &frame[hdlc->data_index + SIM_HDLC_LLC_SIZE], apdu_size);
+            conn->worker->stats.requests++;
+
+            ret = sim_hdlc_reply(conn, sim_execute(conn, apdu_size));
+        }
+        break;
+    }
+    default:
+        ret = -1;
+        break;
+    }
+
+    if (ret > 0)
+    {
+        reply_size = (uint32_t)ret;
+    }
+    return reply_size;
+}
+
+// Fault injection, then send the reply now or at its deadline; return FALSE if the connection must be closed
+static int sim_conn_reply(sim_conn *conn, uint32_t reply_size)
+{
+    sim_worker *worker = conn->worker;
+    int ret = TRUE;
+
+    if (sim_roll(worker, sim_cfg->disconnect_permille) && (sim_cfg->transport != SIM_UDP))
+    {
+        worker->stats.disconnected++;
+        ret = FALSE;
+    }
+    else if (sim_roll(worker, sim_cfg->drop_permille))
+    {
+        worker->stats.dropped++;
+    }
+    else
+    {
+        if (sim_roll(worker, sim_cfg->corrupt_permille))
+        {
+            conn->tx[sim_rand(&worker->rand_state) % reply_size] ^= 0x5AU;
+            worker->stats.corrupted++;
+        }
+
+        conn->tx_size = reply_size;
+        conn->tx_sent = 0U;
+        sim_capture(conn, CAP_TX, conn->tx, reply_size);
+
+        uint64_t delay_ms = sim_cfg->latency_ms;
+        if (sim_cfg->jitter_ms > 0U)
+        {
+            delay_ms += sim_rand(&worker->rand_state) % sim_cfg->jitter_ms;
+        }
+
+        if (delay_ms > 0U)
+        {
+            ret = sim_pending_add(conn, sim_now_ns() + (delay_ms * 1000000U));
+        }
+        else
+        {
+            worker->stats.replies++;
+            ret = sim_conn_flush(conn);
+        }
+    }
+    return ret;
+}
+
+// Process the complete frames of the receive buffer, one reply at a time
+static int sim_conn_process(sim_conn *conn)
+{
+    int ret = TRUE;
+
+    while ((conn->due_ns == 0U) && (conn->tx_size == 0U) && !conn->in_flight && ret)
+    {
+        uint32_t size = sim_frame_size(conn);
+        if (size == 0U)
+        {
+            break;
+        }
+
+        // Before any decoding; an HDLC client is only known by its previous frames
+        uint32_t delay_ms = 0U;
+        uint16_t client_sap = (sim_cfg->transport == SIM_HDLC) ? conn->client_sap : GET_BE16(&conn->rx[2]);
+        enum adm_verdict verdict = sim_admit(conn, client_sap, size, &delay_ms);
+
+        if (verdict == ADM_DELAY)
+        {
+            // The frame stays in the receive buffer, checked again at the deadline
+            ret = sim_pending_add(conn, sim_now_ns() + ((uint64_t)delay_ms * 1000000U));
+            break;
+        }
+        sim_capture(conn, CAP_RX, conn->rx, size);
+
+        uint32_t reply_size = 0U;
+        if (verdict == ADM_ACCEPT)
+        {
+            reply_size = (sim_cfg->transport == SIM_HDLC) ? sim_handle_hdlc(conn, conn->rx, size) : sim_handle_wrapper(conn, conn->rx, size);
+        }
+
+        conn->rx_size -= size;
+        memmove(conn->rx, &conn->rx[size], conn->rx_size);
+
+        if (reply_size > 0U)
+        {
+            ret = sim_conn_reply(conn, reply_size);
+        }
+    }
+    return ret;
+}
+
+// ----------------------------------- EXECUTOR -----------------------------------
+
+// Executor thread: wake up the worker owning the connection
+static void sim_notify(void *ctx)
+{
+    uint64_t one = 1U;
+    (void) write(((sim_worker *)ctx)->efd, &one, sizeof(one));
+}
+
+// Replies of the executor, framed and sent in the order of each connection
+static void sim_handle_completions(sim_worker *worker)
+{
+    uint64_t value;
+    ex_item *item;
+
+    (void) read(worker->efd, &value, sizeof(value));
+
+    while ((item = ex_outbox_pop(&worker->outbox)) != NULL)
+    {
+        sim_conn *conn = (sim_conn *)((uint8_t *)item - offsetof(sim_conn, item));
+        conn->in_flight = FALSE;
+
+        if (conn->fd < 0)
+        {
+            sim_conn_free(conn);
+            continue;
+        }
+
+        int ret = TRUE;
+        uint32_t reply_size = 0U;
+        if (sim_cfg->transport == SIM_HDLC)
+        {
+            int size = sim_hdlc_reply(conn, conn->apdu_size);
+            reply_size = (size > 0) ? (uint32_t)size : 0U;
+        }
+        else
+        {
+            reply_size = sim_wrapper_reply(conn, conn->apdu_size);
+        }
+
+        if (reply_size > 0U)
+        {
+            ret = sim_conn_reply(conn, reply_size);
+        }
+        if (!ret || !sim_conn_process(conn))
+        {
+            sim_conn_close(conn);
+        }
+    }
+}
+
+// ----------------------------------- EVENT LOOP -----------------------------------
+
+static void sim_handle_event(sim_worker *worker, sim_conn *conn, uint32_t events)
+{
+    int ret = TRUE;
+
+    if (conn->listening)
+    {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept(conn->fd, (struct sockaddr *)&peer, &len);
+        if (fd >= 0)
+        {
+            int one = 1;
+            uint32_t delay_ms = 0U;
+            sim_conn *client = NULL;
+
+            // Connection attempts are counted as APDUs of the client SAP 0
+            conn->peer = peer;
+            if (sim_admit(conn, 0U, 0U, &delay_ms) == ADM_ACCEPT)
+            {
+                sim_set_nonblocking(fd);
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                client = sim_conn_new(worker, conn->meter, fd);
+            }
+
+            if (client != NULL)
+            {
+                client->peer = peer;
+                worker->stats.connections++;
+            }
+            else
+            {
+                close(fd);
+            }
+        }
+        return;
+    }
+
+    if (events & EPOLLOUT)
+    {
+        ret = sim_conn_flush(conn);
+        if (ret && (conn->tx_size == 0U))
+        {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = conn;
+            epoll_ctl(worker->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+        }
+    }
+
+    if (ret && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+    {
+        if (sim_cfg->transport == SIM_UDP)
+        {
+            struct sockaddr_in peer;
+            socklen_t len = sizeof(peer);
+            ssize_t n = recvfrom(conn->fd, conn->rx, SIM_BUF_SIZE, 0, (struct sockaddr *)&peer, &len);
+            // A datagram arriving while a reply is pending is dropped, like on a real half-duplex meter
+            if ((n > 0) && (conn->due_ns == 0U) && !conn->in_flight)
+            {
+                conn->peer = peer;
+                conn->rx_size = (uint32_t)n;
+                (void) sim_conn_process(conn);
+            }
+            conn->rx_size = 0U;
+            return;
+        }
+
+        ssize_t n = recv(conn->fd, &conn->rx[conn->rx_size], SIM_BUF_SIZE - conn->rx_size, 0);
+        if (n > 0)
+        {
+            conn->rx_size += (uint32_t)n;
+            ret = sim_conn_process(conn);
+        }
+        else if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)) || (conn->rx_size >= SIM_BUF_SIZE))
+        {
+            ret = FALSE;
+        }
+    }
+
+    if (!ret)
+    {
+        sim_conn_close(conn);
+    }
+}
+
+static void sim_handle_deadlines(sim_worker *worker, uint64_t now)
+{
+    uint32_t i = 0U;
+
+    while (i < worker->nb_pending)
+    {
+        sim_conn *conn = worker->pending[i];
+
+        if (conn->due_ns <= now)
+        {
+            // The slot i is now used by another connection, do not increment
+            sim_pending_remove(conn);
+            // Nothing to send if the deadline was set by the admission control
+            worker->stats.replies += (conn->tx_size > 0U) ? 1U : 0U;
+
+            if (!sim_conn_flush(conn) || !sim_conn_process(conn))
+            {
+                sim_conn_close(conn);
+            }
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static int sim_next_timeout_ms(const sim_worker *worker, uint64_t now)
+{
+    int timeout = 100;
+
+    for (uint32_t i = 0U; i < worker->nb_pending; i++)
+    {
+        uint64_t due = worker->pending[i]->due_ns;
+        int ms = (due > now) ? (int)(((due - now) + 999999U) / 1000000U) : 0;
+        if (ms < timeout)
+        {
+            timeout = ms;
+        }
+    }
+    return timeout;
+}
+
+static void *sim_worker_loop(void *arg)
+{
+    sim_worker *worker = (sim_worker *)arg;
+    struct epoll_event events[SIM_MAX_EVENTS];
+
+    for (;;)
+    {
+        int nb = epoll_wait(worker->epfd, events, SIM_MAX_EVENTS, sim_next_timeout_ms(worker, sim_now_ns()));
+
+        for (int i = 0; i < nb; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                sim_handle_completions(worker);
+            }
+            else
+            {
+                sim_handle_event(worker, (sim_conn *)events[i].data.ptr, events[i].events);
+            }
+        }
+
+        sim_handle_deadlines(worker, sim_now_ns());
+    }
+    return NULL;
+}
+
+static int sim_open_meter_socket(sim_worker *worker, sim_meter *meter, uint16_t port)
+{
+    int ret = FALSE;
+    int type = (sim_cfg->transport == SIM_UDP) ? SOCK_DGRAM : SOCK_STREAM;
+    int fd = socket(AF_INET, type, 0);
+
+    if (fd >= 0)
+    {
+        struct sockaddr_in addr;
+        int one = 1;
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = sim_cfg->bind_addr;
+        addr.sin_port = htons(port);
+
+        if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) &&
+            ((type == SOCK_DGRAM) || (listen(fd, 16) == 0)))
+        {
+            sim_set_nonblocking(fd);
+            sim_conn *conn = sim_conn_new(worker, meter, fd);
+            if (conn != NULL)
+            {
+                conn->listening = (type == SOCK_STREAM) ? TRUE : FALSE;
+                ret = TRUE;
+            }
+        }
+
+        if (!ret)
+        {
+            printf("[SIM] Cannot open port %d\r\n", port);
+            close(fd);
+        }
+    }
+    return ret;
+}
+
+int sim_server_start(const sim_config *config)
+{
+    int ret = TRUE;
+    sim_cfg = config;
+
+    if (config->capture_file != NULL)
+    {
+        uint8_t link = (config->transport == SIM_HDLC) ? CAP_LINK_HDLC : CAP_LINK_WRAPPER;
+        ret = cap_create(&capture, config->capture_file, link, sim_epoch_us());
+        if (!ret)
+        {
+            printf("[SIM] Cannot create the capture file %s\r\n", config->capture_file);
+        }
+    }
+
+    for (uint32_t w = 0U; (w < config->nb_workers) && ret; w++)
+    {
+        memset(&workers[w], 0, sizeof(sim_worker));
+        workers[w].epfd = epoll_create1(0);
+        workers[w].rand_state = 0x9E3779B9U ^ (w + 1U);
+        ret = (workers[w].epfd >= 0) ? TRUE : FALSE;
+
+        if (ret && ((config->apdus.rate > 0U) || (config->bytes.rate > 0U)))
+        {
+            adm_entry *entries = malloc(SIM_ADM_ENTRIES * sizeof(adm_entry));
+            ret = (entries != NULL) && adm_init(&workers[w].admission, entries, SIM_ADM_ENTRIES, &config->apdus, &config->bytes, config->max_delay_ms);
+        }
+
+        if (ret && (config->nb_executors > 0U))
+        {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = NULL;
+            ex_outbox_init(&workers[w].outbox, sim_notify, &workers[w]);
+            workers[w].efd = eventfd(0U, EFD_NONBLOCK);
+            ret = (workers[w].efd >= 0) && (epoll_ctl(workers[w].epfd, EPOLL_CTL_ADD, workers[w].efd, &ev) == 0);
+        }
+    }
+
+    // One mailbox per connection, as many as the file descriptors allowed by sim_main.c
+    if (ret && (config->nb_executors > 0U))
+    {
+        uint32_t nb_slots = (config->nb_meters * 4U) + 64U;
+        exec_slots = malloc(nb_slots * sizeof(ex_mailbox *));
+        for (uint32_t i = 0U; i < config->nb_executors; i++)
+        {
+            exec_states[i].rand_state = 0x85EBCA6BU ^ (i + 1U);
+        }
+        ret = (exec_slots != NULL) && ex_init(&executor, config->nb_executors, exec_slots, nb_slots, sim_exec_handler, NULL);
+    }
+
+    // Meter i is handled by worker i % nb_workers
+    for (uint32_t i = 0U; (i < config->nb_meters) && ret; i++)
+    {
+        ret = sim_open_meter_socket(&workers[i % config->nb_workers], sim_meter_get(i), (uint16_t)(config->base_port + i));
+    }
+
+    for (uint32_t w = 0U; (w < config->nb_workers) && ret; w++)
+    {
+        ret = (pthread_create(&workers[w].thread, NULL, sim_worker_loop, &workers[w]) == 0) ? TRUE : FALSE;
+    }
+    return ret;
+}
+
+void sim_server_get_stats(sim_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    for (uint32_t w = 0U; w < (sim_cfg->nb_workers + sim_cfg->nb_executors); w++)
+    {
+        const sim_stats *s = (w < sim_cfg->nb_workers) ? &workers[w].stats : &exec_states[w - sim_cfg->nb_workers].stats;
+        stats->connections += s->connections;
+        stats->requests += s->requests;
+        stats->replies += s->replies;
+        stats->dropped += s->dropped;
+        stats->corrupted += s->corrupted;
+        stats->disconnected += s->disconnected;
+        stats->exceptions += s->exceptions;
+        stats->bad_frames += s->bad_frames;
+        stats->delayed += s->delayed;
+        stats->rejected += s->rejected;
+    }
+}
+
+// ----------------------------------- REPLAY -----------------------------------
+
+static sim_conn *sim_replay_conn(sim_worker *worker, sim_conn **conns, uint32_t channel)
+{
+    sim_conn *conn = conns[channel];
+
+    if (conn == NULL)
+    {
+        conn = calloc(1U, sizeof(sim_conn));
+        if (conn != NULL)
+        {
+            conn->fd = -1;
+            conn->meter = sim_meter_get(channel);
+            conn->worker = worker;
+            hdlc_init(&conn->hdlc);
+            conn->hdlc.sender = HDLC_SERVER;
+            conns[channel] = conn;
+        }
+    }
+    return conn;
+}
+
+// Sleep until the capture time of the record, relative to the first one
+static void sim_replay_wait(uint64_t start_ns, uint64_t offset_us)
+{
+    uint64_t due = start_ns + (offset_us * 1000U);
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(due / 1000000000ULL);
+    ts.tv_nsec = (long)(due % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+int sim_server_replay(sim_config *config)
+{
+    static uint8_t frame[SIM_BUF_SIZE];
+    static uint32_t histogram[CSM_METRICS_HIST_BUCKETS];
+    sim_worker *worker = &workers[0];
+    sim_conn **conns = NULL;
+    cap_file replay;
+    cap_record record;
+    uint64_t first_us = 0U;
+    uint64_t bytes = 0U;
+    uint32_t frames = 0U;
+    uint32_t replies = 0U;
+    uint32_t skipped = 0U;
+    int read = 0;
+    int ret = cap_open(&replay, config->replay_file);
+
+    sim_cfg = config;
+    memset(worker, 0, sizeof(sim_worker));
+    worker->rand_state = 0x9E3779B9U;
+
+    if (ret)
+    {
+        config->transport = (replay.link == CAP_LINK_HDLC) ? SIM_HDLC : SIM_TCP;
+        conns = calloc(config->nb_meters, sizeof(sim_conn *));
+        ret = (conns != NULL);
+    }
+    else
+    {
+        printf("[SIM] Cannot open the capture file %s\r\n", config->replay_file);
+    }
+
+    uint64_t start = sim_now_ns();
+    while (ret && ((read = cap_read(&replay, &record, frame, SIM_BUF_SIZE)) > 0))
+    {
+        // The replies are produced again by the stack
+        if (record.direction != CAP_RX)
+        {
+            continue;
+        }
+        if (record.channel >= config->nb_meters)
+        {
+            skipped++;
+            continue;
+        }
+
+        sim_conn *conn = sim_replay_conn(worker, conns, record.channel);
+        ret = (conn != NULL);
+        if (ret)
+        {
+            if (frames == 0U)
+            {
+                first_us = record.time_us;
+            }
+            if (config->replay_timing)
+            {
+                sim_replay_wait(start, record.time_us - first_us);
+            }
+
+            uint64_t t0 = sim_now_ns();
+            uint32_t reply_size = (config->transport == SIM_HDLC) ? sim_handle_hdlc(conn, frame, record.size) : sim_handle_wrapper(conn, frame, record.size);
+            uint64_t latency = sim_now_ns() - t0;
+
+            histogram[csm_metrics_bucket_index((latency > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)latency)]++;
+            frames++;
+            bytes += record.size;
+            replies += (reply_size > 0U) ? 1U : 0U;
+        }
+    }
+
+    if (read < 0)
+    {
+        printf("[SIM] Truncated or oversized record in %s\r\n", config->replay_file);
+        ret = FALSE;
+    }
+
+    double elapsed = (double)(sim_now_ns() - start) / 1e9;
+    if (elapsed <= 0.0)
+    {
+        elapsed = 1e-9;
+    }
+
+    printf("[SIM] Replay of %s (%s): %u frames, %u replies, %u bad frames, %u skipped (channel >= %u meters)\r\n",
+           config->replay_file, (config->transport == SIM_HDLC) ? "hdlc" : "wrapper", frames, replies,
+           worker->stats.bad_frames, skipped, config->nb_meters);
+    printf("[SIM] %.3f s, %.0f frames/s, %.2f MB/s\r\n", elapsed, (double)frames / elapsed, ((double)bytes / elapsed) / 1e6);
+    printf("[SIM] latency ns: p50=%u p90=%u p99=%u p99.9=%u max=%u\r\n", csm_metrics_percentile(histogram, 500U),
+           csm_metrics_percentile(histogram, 900U), csm_metrics_percentile(histogram, 990U),
+           csm_metrics_percentile(histogram, 999U), csm_metrics_percentile(histogram, 1000U));
+
+    if (conns != NULL)
+    {
+        for (uint32_t i = 0U; i < config->nb_meters; i++)
+        {
+            free(conns[i]);
+        }
+        free(conns);
+    }
+    cap_close(&replay);
+    return ret;
+}
@@ -0,0 +1,157 @@
+/**
+ * Meter simulator farm: N virtual meters served by the Cosem server stack
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_association.h"
+#include "csm_security.h"
+#include "admission.h"
+#include "timeseries.h"
+
+#define SIM_BUF_SIZE            4096U
+#define SIM_HEADROOM            128U    ///< Free space before the APDU, needed by the security layer
+#define SIM_MAX_WORKERS         64U
+#define SIM_MAX_LANES           (2U * SIM_MAX_WORKERS)  ///< Stack channels: one per worker and per executor thread
+#define SIM_NB_CLIENTS          2U      ///< Public client (0x10) and management client (0x01)
+#define SIM_SERVER_SAP          0x01U   ///< Management logical device
+#define SIM_PROFILE_PERIOD      900U    ///< Load profile capture period, in seconds
+#define SIM_PROFILE_BLOCKS      2U      ///< Load profile storage blocks per meter, one holds hundreds of regular entries
+#define SIM_ADM_ENTRIES         4096U   ///< Admission control clients per worker
+#define SIM_LOG_ENTRIES         100000U ///< Event log capacity, shared by all the meters
+#define SIM_LOG_STAGING         256U    ///< Events appended between two commits, at most
+#define SIM_LOG_COMMIT_MS       100U    ///< Event log group commit interval
+#define SIM_LOG_MAX_READ        150U    ///< Newest events returned without selective access (one APDU)
+
+enum sim_event { SIM_EVENT_ASSOCIATED = 1, SIM_EVENT_RELEASED = 2, SIM_EVENT_CLOCK_SET = 3 };
+
+enum sim_transport { SIM_TCP, SIM_UDP, SIM_HDLC };
+
+typedef struct
+{
+    uint32_t nb_meters;
+    uint32_t nb_workers;
+    uint32_t nb_executors;          //!< Threads executing the APDUs (see executor.h), 0: executed by the workers
+    uint16_t base_port;             //!< Meter i listens on base_port + i
+    uint32_t bind_addr;             //!< IPv4 address, network order
+    enum sim_transport transport;
+    uint32_t profile_entries;       //!< Number of entries in the load profile buffer
+
+    // Fault injection
+    uint32_t latency_ms;            //!< Delay before each reply
+    uint32_t jitter_ms;             //!< Random extra delay, [0, jitter_ms[
+    uint32_t drop_permille;         //!< Reply not sent
+    uint32_t corrupt_permille;      //!< One byte of the reply is altered
+    uint32_t disconnect_permille;   //!< Connection closed instead of replying
+    uint32_t exception_permille;    //!< Data access answered with a temporary failure
+
+    // Admission control per client (address, SAP) and meter, a rate of 0 disables the limit
+    adm_limit apdus;                //!< APDUs per second
+    adm_limit bytes;                //!< Bytes per second
+    uint32_t max_delay_ms;          //!< Excess frames are delayed up to this, then dropped
+
+    const char *log_file;           //!< Event log storage, NULL if not used
+    const char *objdb_file;         //!< Compiled object model (see sim_model.txt), NULL for the built-in one
+    const char *snapshot_file;      //!< Associations saved every second and resumed at start (UDP), NULL if not used
+    const char *capture_file;       //!< Frames received and sent, see capture.h; NULL if not used
+    const char *replay_file;        //!< Capture replayed offline instead of serving the network
+    int replay_timing;              //!< TRUE to replay at the original pace, as fast as possible otherwise
+} sim_config;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t seed;                          //!< Per meter variation of the synthetic values
+    int32_t clock_offset;                   //!< Set by the client, in seconds
+    csm_asso_state asso[SIM_NB_CLIENTS];    //!< Saved association state, one per client SAP
+    csm_sec_context sec[SIM_NB_CLIENTS];    //!< Invocation counters of the glo-ciphered APDUs, saved with the associations
+    ts_store profile;                       //!< Load profile, captured up to the meter time when read
+} sim_meter;
+
+typedef struct
+{
+    volatile uint32_t connections;
+    volatile uint32_t requests;
+    volatile uint32_t replies;
+    volatile uint32_t dropped;
+    volatile uint32_t corrupted;
+    volatile uint32_t disconnected;
+    volatile uint32_t exceptions;
+    volatile uint32_t bad_frames;
+    volatile uint32_t delayed;      //!< Frames held by the admission control
+    volatile uint32_t rejected;     //!< Frames and connections refused by the admission control
+} sim_stats;
+
+// ----------------------------------- METERS -----------------------------------
+
+// xorshift32, each thread owns its state
+uint32_t sim_rand(uint32_t *state);
+
+int sim_meters_init(const sim_config *config);
+sim_meter *sim_meter_get(uint32_t id);
+
+/**
+ * @brief Execute one APDU on the stack on behalf of a meter (thread safe)
+ *
+ * Each calling thread owns a lane, a channel of the stack executed with the association state kept
+ * in the meter (see csm_channel_execute_asso()). The meters run in parallel, the calls for the same
+ * meter are serialized by a lock of the meter.
+ *
+ * @param buffer: SIM_BUF_SIZE bytes, the APDU starts at SIM_HEADROOM; the reply is written at the same place
+ * @param lane: index of the calling thread, lower than SIM_MAX_LANES
+ * @return the reply size, 0 if no reply
+ */
+uint32_t sim_meter_execute(sim_meter *meter, uint16_t client_sap, uint8_t *buffer, uint32_t size, uint32_t lane, uint32_t *rand_state, sim_stats *stats);
+
+// Release the association of a client (transport disconnection)
+void sim_meter_release(sim_meter *meter, uint16_t client_sap);
+
+/**
+ * @brief Image of the established associations of all the meters, see csm_snapshot_save()
+ *
+ * The image holds the associations, their invocation counters and the channels of the lanes.
+ * Only meaningful with the UDP transport: a TCP association ends with its connection.
+ */
+uint32_t sim_meters_snapshot_size(void);
+int sim_meters_save(uint8_t *image, uint32_t size);
+
+// Allow the server counters reserved by the image once it is durable, see csm_snapshot_reserve()
+int sim_meters_reserve(const uint8_t *image, uint32_t size);
+
+// @return the number of associations resumed, -1 if the image is not valid
+int sim_meters_restore(const uint8_t *image, uint32_t size);
+
+// ----------------------------------- NETWORK -----------------------------------
+
+int sim_server_start(const sim_config *config);
+void sim_server_get_stats(sim_stats *stats);
+
+// Write the buffered frames of the capture file, called periodically
+void sim_server_flush_capture(void);
+
+/**
+ * @brief Replay the requests of a capture file through the framing layer and the stack, then print a report
+ *
+ * The channel of a record is the meter number. Fault injection and admission control are not applied;
+ * the latency of each request is measured from the frame decoding to the encoded reply.
+ */
+int sim_server_replay(sim_config *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIMULATOR_H
@@ -1,5 +1,5 @@
 
 LOCAL_DIR = $(call my-dir)/
 
-SOURCES += $(addprefix $(LOCAL_DIR), csm_array.c csm_association.c csm_axdr_codec.c csm_ber.c csm_channel.c csm_security.c csm_services.c)
+SOURCES += $(addprefix $(LOCAL_DIR), csm_array.c csm_association.c csm_axdr_codec.c csm_ber.c csm_channel.c csm_security.c csm_services.c csm_trace.c csm_metrics.c csm_push.c csm_runq.c csm_snapshot.c csm_objdb.c csm_ingest.c csm_translate.c csm_columnar.c)
 
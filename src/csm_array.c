@@ -19,6 +19,9 @@
 #define TEST_INDEX(array, i)    (INDEX(array, i) < array->size)
 #define TEST_WR_INDEX(array)    (TEST_INDEX(array, array->wr_index))
 
+#define ARRAY_DUMP_LINE_BYTES   128U    ///< Bytes per trace line of csm_array_dump(), formatted on the stack
+#define ARRAY_DUMP_RING_BYTES   24U     ///< Bytes per record in the binary trace ring
+
 void csm_array_init(csm_array *array, uint8_t *buffer, uint32_t max_size, uint32_t used_size, uint32_t offset)
 {
     CSM_ASSERT(used_size <= max_size);
@@ -109,15 +112,40 @@ int csm_array_write_u32(csm_array *array, uint32_t value)
 
 void csm_array_dump(csm_array *array)
 {
-    for (uint32_t i = 0U; i < array->size; i++)
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_TRACE)
+    const uint8_t *data = &array->buff[array->offset];
+    uint32_t size = array->wr_index;
+#ifdef CSM_TRACE_USE_RING
+    // The ring only stores numbers: the bytes are packed in three 64-bit arguments per record,
+    // the last record is padded with zeros
+    CSM_TRACE("Dump of %u bytes\r\n", size);
+    for (uint32_t pos = 0U; pos < size; pos += ARRAY_DUMP_RING_BYTES)
+    {
+        uint8_t chunk[ARRAY_DUMP_RING_BYTES];
+        uint32_t len = ((size - pos) < ARRAY_DUMP_RING_BYTES) ? (size - pos) : ARRAY_DUMP_RING_BYTES;
+
+        memset(chunk, 0, sizeof(chunk));
+        memcpy(chunk, &data[pos], len);
+        CSM_TRACE("%04x: %016llx %016llx %016llx\r\n", pos, (unsigned long long)GET_BE64(&chunk[0]),
+                  (unsigned long long)GET_BE64(&chunk[8]), (unsigned long long)GET_BE64(&chunk[16]));
+    }
+#else
+    // Formatted by lines on the stack, each line emitted in one write
+    char line[HEX_DUMP_SIZE(ARRAY_DUMP_LINE_BYTES)];
+
+    do
     {
-        if (i > 0U)
-        {
-            CSM_TRACE(":");
-        }
-        CSM_TRACE("%02X", array->buff[i]);
+        uint32_t chunk = (size < ARRAY_DUMP_LINE_BYTES) ? size : ARRAY_DUMP_LINE_BYTES;
+        (void) hex_dump(data, chunk, ':', line, sizeof(line));
+        CSM_TRACE("%s\r\n", line);
+        data += chunk;
+        size -= chunk;
     }
-    CSM_TRACE("\r\n");
+    while (size > 0U);
+#endif
+#else
+    (void) array;
+#endif
 }
 
 int csm_array_writer_jump(csm_array *array, uint32_t nb_bytes)
@@ -125,7 +153,7 @@ int csm_array_writer_jump(csm_array *array, uint32_t nb_bytes)
     int ret = TRUE;
 
     array->wr_index += nb_bytes;
-    if (WR_INDEX(array) >= array->size)
+    if (WR_INDEX(array) > array->size)
     {
         // saturate
         array->wr_index = (array->size-array->offset); // Write index out of bound, it forbid any further write
@@ -141,7 +169,7 @@ int csm_array_reader_jump(csm_array *array, uint32_t nb_bytes)
 
     CSM_ASSERT(array != NULL);
     array->rd_index += nb_bytes;
-    if (RD_INDEX(array) >= array->size)
+    if (RD_INDEX(array) > array->size)
     {
         // saturate
         array->rd_index = (array->size-array->offset);
@@ -13,6 +13,8 @@
 #include "csm_association.h"
 #include "string.h"
 #include "csm_axdr_codec.h"
+#include "csm_metrics.h"
+#include "slot_alloc.h"
 
 
 // Since this is part of a Cosem stack, simplify the decoding to lower code & RAM ;
@@ -257,18 +259,18 @@ static csm_acse_code acse_auth_value_decoder(csm_asso_state *state, csm_ber *ber
                 if (tag == CSM_ASSO_CALLING_AUTH_VALUE)
                 {
                     // It is a GraphicString, the size is dynamic
-                    if (csm_array_read_buff(array, &state->handshake.ctos.value[0], ber->length.length))
+                    if (csm_array_read_buff(array, &state->handshake->ctos.value[0], ber->length.length))
                     {
-                        state->handshake.ctos.size = ber->length.length;
+                        state->handshake->ctos.size = ber->length.length;
                         ret = CSM_ACSE_OK;
                     }
                 }
                 else
                 {
                     // It is a GraphicString, the size is dynamic
-                    if (csm_array_read_buff(array, &state->handshake.stoc.value[0], ber->length.length))
+                    if (csm_array_read_buff(array, &state->handshake->stoc.value[0], ber->length.length))
                     {
-                        state->handshake.stoc.size = ber->length.length;
+                        state->handshake->stoc.size = ber->length.length;
                         ret = CSM_ACSE_OK;
                     }
                 }
@@ -311,21 +313,22 @@ int acse_decode_conformance_block(csm_asso_state *state, csm_ber *ber, csm_array
             valid = valid && csm_array_read_u8(array, &byte);
             valid = valid && (byte == 0U ? TRUE : FALSE); // unused bits in the bitstring
 
-            state->handshake.proposed_conformance = ((uint32_t)byte) << 16U;
             valid = valid && csm_array_read_u8(array, &byte);
-            state->handshake.proposed_conformance += ((uint32_t)byte) << 8U;
+            state->handshake->proposed_conformance = ((uint32_t)byte) << 16U;
             valid = valid && csm_array_read_u8(array, &byte);
-            state->handshake.proposed_conformance += ((uint32_t)byte);
+            state->handshake->proposed_conformance += ((uint32_t)byte) << 8U;
+            valid = valid && csm_array_read_u8(array, &byte);
+            state->handshake->proposed_conformance += ((uint32_t)byte);
 
             uint16_t pdu_size;
             valid = valid && csm_array_read_u16(array, &pdu_size);
             if (tag == AXDR_INITIATE_REQUEST)
             {
-                state->handshake.client_max_receive_pdu_size = pdu_size;
+                state->handshake->client_max_receive_pdu_size = pdu_size;
             }
             else
             {
-                state->handshake.server_max_receive_pdu_size = pdu_size;
+                state->handshake->server_max_receive_pdu_size = pdu_size;
             }
         }
     }
@@ -494,11 +497,11 @@ static csm_acse_code acse_result_decoder(csm_asso_state *state, csm_ber *ber, cs
         if (result == 0U)
         {
             // accepted, connection OK
-            state->handshake.accepted = TRUE;
+            state->handshake->accepted = TRUE;
         }
         else
         {
-            state->handshake.accepted = FALSE;
+            state->handshake->accepted = FALSE;
         }
     }
 
@@ -517,7 +520,7 @@ static csm_acse_code acse_result_src_diag_decoder(csm_asso_state *state, csm_ber
         uint8_t result;
         if (csm_ber_read_u8(array, &result))
         {
-            state->handshake.result = (enum csm_asso_result)result;
+            state->handshake->result = (enum csm_asso_result)result;
             ret = CSM_ACSE_OK;
         }
     }
@@ -701,7 +704,7 @@ static csm_acse_code acse_result_src_diag_encoder(csm_asso_state *state, csm_ber
         {
             if (csm_ber_write_len(array, 3U)) // 3 bytes = integer tag, integer length and result boolean
             {
-                if (csm_ber_write_u8(array, state->handshake.result))
+                if (csm_ber_write_u8(array, state->handshake->result))
                 {
                     ret = CSM_ACSE_OK;
                 }
@@ -798,8 +801,8 @@ static csm_acse_code acse_responder_auth_value_encoder(csm_asso_state *state, cs
 
     // Generate the same challenge size than the client
     // FIXME: randomize the size for the StoC challenge?
-    uint8_t size = state->handshake.ctos.size;
-    state->handshake.stoc.size = size;
+    uint8_t size = state->handshake->ctos.size;
+    state->handshake->stoc.size = size;
 
     // Serialize the server authentication value to the output buffer and in our scratch buffer
     for (uint8_t i = 0U; i < size; i++)
@@ -809,10 +812,10 @@ static csm_acse_code acse_responder_auth_value_encoder(csm_asso_state *state, cs
 #else
         uint8_t byte = csm_hal_get_random_u8(0, 255);
 #endif
-        state->handshake.stoc.value[i] = byte;
+        state->handshake->stoc.value[i] = byte;
     }
 
-    if (acse_auth_value_encoder(array, &state->handshake.stoc.value[0], size))
+    if (acse_auth_value_encoder(array, &state->handshake->stoc.value[0], size))
     {
         ret = CSM_ACSE_OK;
     }
@@ -829,22 +832,22 @@ static csm_acse_code acse_aarq_auth_value_encoder(csm_asso_state *state, csm_ber
 
     if (state->auth_level == CSM_AUTH_LOW_LEVEL)
     {
-        state->handshake.ctos.size = 8U;
-        csm_hal_get_lls_password(0U, &state->handshake.ctos.value[0], state->handshake.ctos.size);
+        state->handshake->ctos.size = 8U;
+        csm_hal_get_lls_password(0U, &state->handshake->ctos.value[0], state->handshake->ctos.size);
     }
     else
     {
         // High level security, generate a challenge
-        state->handshake.ctos.size = csm_hal_get_random_u8(8U, 64U);
+        state->handshake->ctos.size = csm_hal_get_random_u8(8U, 64U);
 
-        for (uint8_t i = 0U; i < state->handshake.ctos.size; i++)
+        for (uint8_t i = 0U; i < state->handshake->ctos.size; i++)
         {
             uint8_t byte = csm_hal_get_random_u8(0, 255);
-            state->handshake.ctos.value[i] = byte;
+            state->handshake->ctos.value[i] = byte;
         }
     }
 
-    if (acse_auth_value_encoder(array, &state->handshake.ctos.value[0], state->handshake.ctos.size))
+    if (acse_auth_value_encoder(array, &state->handshake->ctos.value[0], state->handshake->ctos.size))
     {
         ret = CSM_ACSE_OK;
     }
@@ -993,12 +996,130 @@ static const csm_asso_enc aarq_encoder_chain[] =
 
 // --------------------------  ASSOCIATION MAIN FUNCTIONS -------------------------------------------
 
+// Handshakes in progress, shared by all the associations
+static csm_asso_handshake handshake_pool[CSM_DEF_MAX_HANDSHAKES];
+static uint64_t handshake_free_map[SLOT_ALLOC_WORDS(CSM_DEF_MAX_HANDSHAKES)];
+static slot_alloc handshake_slots;
+static uint8_t handshake_pool_ready = FALSE;
+static CSM_LOCK_TYPE handshake_lock = CSM_LOCK_INIT;  // The associations can be executed by several threads
+
+// Owner of each slot and time of its last use: a silent client loses its slot when the pool is full
+static csm_asso_state *handshake_owner[CSM_DEF_MAX_HANDSHAKES];
+static uint32_t handshake_used[CSM_DEF_MAX_HANDSHAKES];
+static csm_asso_clock handshake_clock = NULL;
+
+void csm_asso_set_clock(csm_asso_clock clock)
+{
+    handshake_clock = clock;
+}
+
+// The slot unused for the longest time, if over CSM_DEF_HANDSHAKE_TIMEOUT; -1 otherwise. Called locked, pool full.
+static int32_t asso_handshake_reclaim(uint32_t now)
+{
+    int32_t slot = -1;
+    uint32_t oldest = 0U;
+
+    for (uint32_t i = 0U; (handshake_clock != NULL) && (i < CSM_DEF_MAX_HANDSHAKES); i++)
+    {
+        uint32_t age = now - handshake_used[i];
+        if ((age >= CSM_DEF_HANDSHAKE_TIMEOUT) && ((slot < 0) || (age > oldest)))
+        {
+            slot = (int32_t)i;
+            oldest = age;
+        }
+    }
+    return slot;
+}
+
+// Take a slot, or check that the slot of the state was not reclaimed; its time of use is updated
+static int asso_handshake_get(csm_asso_state *state)
+{
+    uint32_t now = (handshake_clock != NULL) ? handshake_clock() : 0U;
+    int32_t slot = -1;
+    int reclaimed = FALSE;
+
+    CSM_LOCK(handshake_lock);
+    if (!handshake_pool_ready)
+    {
+        slot_alloc_init(&handshake_slots, handshake_free_map, NULL, CSM_DEF_MAX_HANDSHAKES);
+        handshake_pool_ready = TRUE;
+    }
+    if (state->handshake != NULL)
+    {
+        slot = (int32_t)(state->handshake - &handshake_pool[0]);
+        slot = (handshake_owner[slot] == state) ? slot : -1;
+    }
+    else
+    {
+        slot = slot_alloc_get(&handshake_slots);
+        if (slot < 0)
+        {
+            slot = asso_handshake_reclaim(now);
+            reclaimed = (slot >= 0);
+        }
+        if (slot >= 0)
+        {
+            handshake_owner[slot] = state;
+            state->handshake = &handshake_pool[slot];
+            memset(state->handshake, 0, sizeof(csm_asso_handshake));
+        }
+    }
+    if (slot >= 0)
+    {
+        handshake_used[slot] = now;
+    }
+    CSM_UNLOCK(handshake_lock);
+
+    if (reclaimed)
+    {
+        CSM_LOG("[ACSE] Handshake %d reclaimed, unused for too long", slot);
+    }
+    if ((slot < 0) && (state->handshake != NULL))
+    {
+        // Taken by another association: this one is established again from the AARQ
+        CSM_ERR("[ACSE] Handshake reclaimed, association aborted");
+        state->handshake = NULL;
+        state->state_cf = CF_IDLE;
+    }
+    else if (slot < 0)
+    {
+        CSM_ERR("[ACSE] Too many associations in progress");
+    }
+    return (slot >= 0);
+}
+
+int csm_asso_hold_handshake(csm_asso_state *state)
+{
+    return (state->handshake != NULL) && asso_handshake_get(state);
+}
+
+void csm_asso_release_handshake(csm_asso_state *state)
+{
+    if (state->handshake != NULL)
+    {
+        uint32_t slot = (uint32_t)(state->handshake - &handshake_pool[0]);
+
+        CSM_LOCK(handshake_lock);
+        // Left as is when reclaimed by another association
+        if (handshake_owner[slot] == state)
+        {
+            // Erase the challenges
+            memset(state->handshake, 0, sizeof(csm_asso_handshake));
+            handshake_owner[slot] = NULL;
+            (void) slot_alloc_release(&handshake_slots, slot);
+        }
+        CSM_UNLOCK(handshake_lock);
+        state->handshake = NULL;
+    }
+}
+
 void csm_asso_init(csm_asso_state *state)
 {
     state->state_cf = CF_IDLE;
     state->auth_level = CSM_AUTH_LOWEST_LEVEL;
     state->ref = NO_REF;
-    state->handshake.result = CSM_ASSO_ERR_NULL;
+    state->conformance = 0U;
+    state->handshake = NULL;
 }
 
 // Check is association is granted
@@ -1007,40 +1128,42 @@ int csm_asso_is_granted(csm_asso_state *state)
     int ret = FALSE;
     if (state->state_cf == CF_IDLE)
     {
+        state->conformance = state->config->conformance & state->handshake->proposed_conformance;
+
         // Test the password if required
         if (state->auth_level == CSM_AUTH_LOWEST_LEVEL)
         {
             CSM_LOG("Granted (No security)");
             state->state_cf = CF_ASSOCIATED;
-            state->handshake.result = CSM_ASSO_ERR_NULL;
+            state->handshake->result = CSM_ASSO_ERR_NULL;
             ret = TRUE;
         }
         else if (state->auth_level == CSM_AUTH_LOW_LEVEL)
         {
             // Use unused StoC buffer to store our temporary password
-            csm_hal_get_lls_password(state->config->llc.dsap, &state->handshake.stoc.value[0], 8U);
-            if (memcmp(&state->handshake.stoc.value[0], &state->handshake.ctos.value[0], state->handshake.ctos.size) == 0)
+            csm_hal_get_lls_password(state->config->llc.dsap, &state->handshake->stoc.value[0], 8U);
+            if (memcmp(&state->handshake->stoc.value[0], &state->handshake->ctos.value[0], state->handshake->ctos.size) == 0)
             {
                 state->state_cf = CF_ASSOCIATED;
-                state->handshake.result = CSM_ASSO_ERR_NULL;
+                state->handshake->result = CSM_ASSO_ERR_NULL;
                 ret = TRUE;
             }
             else
             {
-                state->handshake.result = CSM_ASSO_ERR_AUTH_FAILURE;
+                state->handshake->result = CSM_ASSO_ERR_AUTH_FAILURE;
             }
         }
         else if (state->auth_level == CSM_AUTH_HIGH_LEVEL_GMAC)
         {
             state->state_cf = CF_ASSOCIATION_PENDING;
-            state->handshake.result = CSM_ASSO_AUTH_REQUIRED;
+            state->handshake->result = CSM_ASSO_AUTH_REQUIRED;
             ret = TRUE;
         }
         else
         {
             // Failure, other cases are not managed
             CSM_ERR("[ACSE] Access refused, bad authentication level");
-            state->handshake.result = CSM_ASSO_AUTH_NOT_RECOGNIZED;
+            state->handshake->result = CSM_ASSO_AUTH_NOT_RECOGNIZED;
         }
     }
 
@@ -1063,6 +1186,10 @@ int csm_asso_decoder(csm_asso_state *state, csm_array *array, uint8_t tag)
         CSM_ERR("[ACSE] Bad ACSE tag");
         ret = CSM_ACSE_ERR;
     }
+    else if (!asso_handshake_get(state))
+    {
+        ret = CSM_ACSE_ERR;
+    }
     else
     {
         const csm_asso_dec *codec = &aare_decoder_chain[0];
@@ -1093,7 +1220,12 @@ int csm_asso_decoder(csm_asso_state *state, csm_array *array, uint8_t tag)
                         }
                     }
 
-                    if ((ret) && (decoder_index < size))
+                    if ((ret) && (csm_array_unread(array) == 0U))
+                    {
+                        // Last field decoded, the user information is generally the final one
+                        break;
+                    }
+                    else if ((ret) && (decoder_index < size))
                     {
                         // Continue decoding BER
                         ret = csm_ber_decode(&ber, array);
@@ -1135,7 +1267,7 @@ int csm_asso_encoder(csm_asso_state *state, csm_array *array, uint8_t tag)
     int ret = FALSE;
     csm_ber ber;
 
-    if (csm_array_write_u8(array, tag))
+    if (asso_handshake_get(state) && csm_array_write_u8(array, tag))
     {
         // Write dummy size, it will be updated later
         // Since the AARE is never bigger than 127, the length encoding can one-byte size
@@ -1194,18 +1326,34 @@ int csm_asso_server_execute(csm_asso_state *asso, csm_array *packet)
 {
     int bytes_to_reply = 0;
 
-    if (asso->state_cf  == CF_IDLE)
+    if ((asso->state_cf == CF_IDLE) && !asso_handshake_get(asso))
+    {
+        // No handshake left: minimal AARE, rejected-transient, acse-service-user no-reason-given
+        static const uint8_t cAareBusy[] = { CSM_ASSO_AARE, 0x17U,
+                                             0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U,
+                                             0xA2U, 0x03U, 0x02U, 0x01U, 0x02U,
+                                             0xA3U, 0x05U, 0xA1U, 0x03U, 0x02U, 0x01U, 0x01U };
+        CSM_METRICS_INC(CSM_METRIC_ASSO_REJECTED);
+        packet->wr_index = 0U;
+        if (csm_array_write_buff(packet, cAareBusy, sizeof(cAareBusy)))
+        {
+            bytes_to_reply = (int)sizeof(cAareBusy);
+        }
+    }
+    else if (asso->state_cf  == CF_IDLE)
     {
         if (csm_asso_decoder(asso, packet, CSM_ASSO_AARQ))
         {
             if (csm_asso_is_granted(asso))
             {
                 CSM_LOG("[ACSE] Access granted!");
+                CSM_METRICS_INC(CSM_METRIC_ASSO_ACCEPTED);
             }
             else
             {
                 // FIXME: print textual reason
-                CSM_ERR("[ACSE] Connection rejected, reason: %d", asso->handshake.result);
+                CSM_ERR("[ACSE] Connection rejected, reason: %d", asso->handshake->result);
+                CSM_METRICS_INC(CSM_METRIC_ASSO_REJECTED);
             }
 
             // Send AARE, success or failure
@@ -1220,6 +1368,12 @@ int csm_asso_server_execute(csm_asso_state *asso, csm_array *packet)
         {
             CSM_ERR("[ACSE] BER decoding error");
         }
+
+        // The challenges are still needed by the HLS pass 3 and 4
+        if (asso->state_cf != CF_ASSOCIATION_PENDING)
+        {
+            csm_asso_release_handshake(asso);
+        }
     }
     else if (asso->state_cf  == CF_ASSOCIATED)
     {
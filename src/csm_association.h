@@ -153,6 +153,9 @@ typedef struct
 
 /**
  * @brief Temporary structure valid during the ACSE
+ *
+ * Taken from a pool of CSM_DEF_MAX_HANDSHAKES slots when the AARQ is received (or encoded by a
+ * client) and released once the association is established, rejected, or the HLS is complete.
  */
 typedef struct
 {
@@ -173,21 +176,41 @@ typedef struct
  */
 typedef struct
 {
+    // Pointer to the configuration structure in ROM
+    const csm_asso_config *config;
+
+    // Valid for the ACSE session establishment only, NULL otherwise (erased when released)
+    csm_asso_handshake *handshake;
+
     // Current state and parameters of the association
+    uint32_t conformance;   ///< Negotiated: proposed by the client and authorized by the configuration
     enum state_cf state_cf;
     enum csm_referencing ref;
     enum csm_auth_level auth_level;
     uint8_t client_app_title[CSM_DEF_APP_TITLE_SIZE];
     uint8_t server_app_title[CSM_DEF_APP_TITLE_SIZE];
-
-    // Valid for the ACSE session establishment, for security reasons it should be erased after all
-    csm_asso_handshake handshake;
-
-    // Pointer to the configuration structure in ROM
-    const csm_asso_config *config;
 } csm_asso_state;
 
+// Idle state without handshake; a state in use must release its handshake first
 void csm_asso_init(csm_asso_state *state);
+
+// Give the handshake slot back to the pool (end of the association establishment, disconnection)
+void csm_asso_release_handshake(csm_asso_state *state);
+
+// Check that the handshake of the state was not reclaimed, and restart its age (HLS pass 3 and 4)
+int csm_asso_hold_handshake(csm_asso_state *state);
+
+/**
+ * @brief Monotonic clock of the handshake ages, in seconds (wrapping is allowed)
+ */
+typedef uint32_t (*csm_asso_clock)(void);
+
+/**
+ * @brief When the pool is full, a new association takes the handshake unused for CSM_DEF_HANDSHAKE_TIMEOUT
+ * seconds or more (eg: a client silent after the AARQ of an HLS); its association goes back to idle.
+ * Without clock, the slots are only given back by the associations.
+ */
+void csm_asso_set_clock(csm_asso_clock clock);
 int csm_asso_server_execute(csm_asso_state *state, csm_array *packet);
 int csm_asso_encoder(csm_asso_state *state, csm_array *array, uint8_t tag);
 int csm_asso_decoder(csm_asso_state *state, csm_array *array, uint8_t tag);
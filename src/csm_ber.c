@@ -16,6 +16,7 @@
 // We only manage two-bytes length
 
 
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_TRACE)
 // 31 tags
 static const char *cUniversalTypes[] = {
 "Reserved",
@@ -47,6 +48,7 @@ static const char *cUniversalTypes[] = {
 "UniversalString",
 "CHARACTER STRING",
 "BMPString" };
+#endif
 
 static int csm_ber_read_tag(csm_array *i_array, ber_tag *o_tag)
 {
@@ -187,6 +189,7 @@ int csm_ber_decode_object_identifier(ber_object_identifier *oid, csm_array *arra
 
 void csm_ber_dump(csm_ber *i_ber)
 {
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_TRACE)
     CSM_TRACE("-------------- BER FIELD --------------\r\n");
     CSM_TRACE("Tag: ");
 
@@ -231,6 +234,9 @@ void csm_ber_dump(csm_ber *i_ber)
     }
 
     CSM_TRACE("\r\nValue length: %d\r\n", i_ber->length.length);
+#else
+    (void) i_ber;
+#endif
 }
 
 int csm_ber_decode(csm_ber *ber, csm_array *array)
@@ -9,21 +9,43 @@
  *
  */
 
+#include <string.h>
 #include "csm_channel.h"
 #include "csm_config.h"
 #include "csm_services.h"
 #include "csm_security.h"
 #include "csm_axdr_codec.h"
+#include "csm_metrics.h"
+#include "slot_alloc.h"
+#include "os_util.h"
 
 // List of channels
 static csm_channel *channel_list = NULL;
 static uint8_t channel_list_size;
 
+// Free channels, the channel count is limited to 255 by its uint8_t size
+static uint64_t channel_free_map[SLOT_ALLOC_WORDS(256U)];
+static slot_alloc channel_slots;
+
+// Requests left pending by the database, the other ones only live during csm_channel_execute()
+static csm_request request_pool[CSM_DEF_MAX_REQUESTS];
+static uint64_t request_free_map[SLOT_ALLOC_WORDS(CSM_DEF_MAX_REQUESTS)];
+static slot_alloc request_slots;
+
+// The channels can be executed by several threads, the pools are shared
+static CSM_LOCK_TYPE pool_lock = CSM_LOCK_INIT;
+
 // List of association state and ocnfiguration
 static csm_asso_state *asso_list = NULL;
 static const csm_asso_config *asso_conf_list = NULL;
 static uint8_t asso_list_size;
 
+// Invocation counters of the associations, needed by the glo-ciphered APDUs
+static csm_sec_context *sec_list = NULL;
+
+// Room kept after a deciphered request for the tag and a longer length of the ciphered response
+#define CHAN_CIPHER_RESERVE     (12U + 2U)
+
 void csm_channel_init(csm_channel *channels, uint8_t chan_size, csm_asso_state *assos, const csm_asso_config *assos_config, uint8_t asso_size)
 {
     // Save system channels and
@@ -41,8 +63,276 @@ void csm_channel_init(csm_channel *channels, uint8_t chan_size, csm_asso_state *
     for (uint32_t i = 0U; i < chan_size; i++)
     {
         channels[i].asso = NULL;
-        channels[i].request.channel_id = INVALID_CHANNEL_ID;
+        channels[i].sec = NULL;
+        channels[i].request = NULL;
+        channels[i].channel_id = INVALID_CHANNEL_ID;
+        channels[i].sequence = 0U;
+    }
+
+    slot_alloc_init(&channel_slots, channel_free_map, NULL, chan_size);
+    slot_alloc_init(&request_slots, request_free_map, NULL, CSM_DEF_MAX_REQUESTS);
+}
+
+void csm_channel_set_security(csm_sec_context *contexts)
+{
+    sec_list = contexts;
+}
+
+static void channel_release_request(csm_channel *chan)
+{
+    if (chan->request != NULL)
+    {
+        CSM_LOCK(pool_lock);
+        (void) slot_alloc_release(&request_slots, (uint32_t)(chan->request - &request_pool[0]));
+        CSM_UNLOCK(pool_lock);
+        chan->request = NULL;
+    }
+}
+
+// Keep the request until csm_channel_complete(), return FALSE if the pool is exhausted
+static int channel_keep_request(csm_channel *chan, const csm_request *request)
+{
+    CSM_LOCK(pool_lock);
+    int32_t slot = slot_alloc_get(&request_slots);
+    CSM_UNLOCK(pool_lock);
+
+    if (slot >= 0)
+    {
+        request_pool[slot] = *request;
+        chan->request = &request_pool[slot];
+    }
+    return (slot >= 0);
+}
+
+// glo-xxx-request: tag || length || SC || IC || ciphered xDLMS APDU || T
+// The APDU is deciphered in place and the packet is set on it; return FALSE if the request must be dropped
+static int channel_decipher(csm_channel *chan, csm_request *request, csm_array *packet)
+{
+    csm_ber ber;
+    csm_sec_control_byte sc;
+    uint32_t ic = 0U;
+    uint8_t tag = 0U;
+    uint8_t *buffer = packet->buff;
+    uint32_t size = packet->size;
+
+    int valid = (chan->sec != NULL) && (chan->asso->state_cf == CF_ASSOCIATED);
+    valid = valid && csm_array_get(packet, 0U, &tag);
+    valid = valid && csm_ber_decode(&ber, packet);
+    valid = valid && (ber.length.length == csm_array_unread(packet));
+    valid = valid && (ber.length.length > (CSM_DEF_SEC_HDR_SIZE + 12U));
+    // The AAD is built before the information
+    valid = valid && ((packet->offset + packet->rd_index + CSM_DEF_SEC_HDR_SIZE) >= 17U);
+
+    if (valid)
+    {
+        const uint8_t *header = csm_array_rd_data(packet);
+        sc.sh_byte = header[0];
+        ic = GET_BE32(&header[1]);
+
+        // Only the authenticated APDUs, ciphered with the unicast key, are accepted
+        valid = (sc.sh_bit_field.authentication == 1U) && (sc.sh_bit_field.key_set == 0U) && (sc.sh_bit_field.compression == 0U);
+        if (ic < chan->sec->client_ic)
+        {
+            CSM_ERR("[CHAN] Replayed invocation counter");
+            valid = FALSE;
+        }
+    }
+
+    if (valid)
+    {
+        uint32_t information = ber.length.length - CSM_DEF_SEC_HDR_SIZE - 12U;
+        uint32_t offset = packet->offset + packet->rd_index + CSM_DEF_SEC_HDR_SIZE;
+
+        packet->offset += packet->rd_index;
+        packet->wr_index -= packet->rd_index;
+        packet->rd_index = 0U;
+        valid = (csm_sec_auth_decrypt(packet, request, &chan->asso->client_app_title[0]) == CSM_SEC_OK);
+
+        // The ciphered APDU carries the plain service of the same kind: glo-get-request, get-request
+        valid = valid && ((offset + information + CHAN_CIPHER_RESERVE) <= size);
+        valid = valid && (information > 0U) && (buffer[offset] == (uint8_t)(tag - 8U));
+        if (valid)
+        {
+            // Counted only once authenticated, a forged APDU cannot move the counter
+            chan->sec->client_ic = ic + 1U;
+            request->sc = sc.sh_byte;
+            csm_array_init(packet, buffer, size - CHAN_CIPHER_RESERVE, information, offset);
+        }
+        else
+        {
+            CSM_ERR("[CHAN] Deciphering failure");
+        }
+    }
+    return valid;
+}
+
+// Take the counter of the response before the execution: a request that cannot be answered is not run
+static int channel_reserve_ic(csm_channel *chan, csm_request *request)
+{
+    // A counter not saved in the snapshot could be used again after a restart
+    int valid = (chan->sec->server_ic_limit == 0U) || (chan->sec->server_ic < chan->sec->server_ic_limit);
+
+    if (valid)
+    {
+        request->ic = chan->sec->server_ic++;
+    }
+    else
+    {
+        CSM_ERR("[CHAN] Invocation counter not reserved");
+    }
+    return valid;
+}
+
+// Cipher in place the response written at the packet offset, move it to 'base'; return the APDU size, 0 on error
+static int channel_cipher(csm_channel *chan, const csm_request *request, csm_array *packet, uint32_t base, uint32_t plain)
+{
+    csm_sec_control_byte sc;
+    uint8_t *buffer = packet->buff;
+    uint32_t size = packet->size;
+    uint32_t content = CSM_DEF_SEC_HDR_SIZE + plain + 12U;
+    uint32_t header = (content > 255U) ? 4U : ((content > 127U) ? 3U : 2U);
+    uint32_t data = base + header + CSM_DEF_SEC_HDR_SIZE;
+    uint8_t tag = 0U;
+    int ret = 0;
+
+    sc.sh_byte = request->sc;
+    (void) csm_array_get(packet, 0U, &tag);
+
+    if ((tag != AXDR_GET_RESPONSE) && (tag != AXDR_SET_RESPONSE) && (tag != AXDR_ACTION_RESPONSE))
+    {
+        // Exception response, never ciphered
+        ret = (int)plain;
+    }
+    else if (((data + plain + 12U) > size) || (data < 17U) || (content > 0xFFFFU))
+    {
+        CSM_ERR("[CHAN] No room to cipher the response");
+    }
+    else
+    {
+        uint32_t ic = request->ic;
+
+        memmove(&buffer[data], &buffer[packet->offset], plain);
+        csm_array_init(packet, buffer, size, plain, data);
+
+        if (csm_sec_auth_encrypt(packet, (csm_request *)request, csm_sys_get_system_title(), sc, ic) == CSM_SEC_OK)
+        {
+            csm_array_init(packet, buffer, size, 0U, base);
+            int valid = csm_array_write_u8(packet, (uint8_t)(tag + 8U));
+            if (header == 4U)
+            {
+                valid = valid && csm_array_write_u8(packet, 0x82U);
+                valid = valid && csm_array_write_u16(packet, (uint16_t)content);
+            }
+            else
+            {
+                valid = valid && ((header == 2U) || csm_array_write_u8(packet, 0x81U));
+                valid = valid && csm_array_write_u8(packet, (uint8_t)content);
+            }
+            valid = valid && csm_array_write_u8(packet, sc.sh_byte);
+            valid = valid && csm_array_write_u32(packet, ic);
+            valid = valid && csm_array_writer_jump(packet, plain + 12U);
+            ret = valid ? (int)packet->wr_index : 0;
+        }
+        else
+        {
+            CSM_ERR("[CHAN] Ciphering failure");
+        }
+    }
+    return ret;
+}
+
+// Execute the APDU with the association and the invocation counters set in the channel
+static int channel_run(csm_channel *chan, csm_array *packet)
+{
+    int ret = FALSE;
+    csm_asso_state *asso = chan->asso;
+    uint8_t tag;
+
+    if (csm_array_get(packet, 0U, &tag))
+    {
+        switch (tag)
+        {
+        case CSM_ASSO_AARE:
+        case CSM_ASSO_AARQ:
+        case CSM_ASSO_RLRE:
+        case CSM_ASSO_RLRQ:
+            ret = csm_asso_server_execute(asso, packet);
+            break;
+        default:
+        {
+            csm_request request;
+            uint32_t base = packet->offset;
+            uint32_t size = packet->size;
+            int ciphered = (tag == AXDR_GLO_GET_REQUEST) || (tag == AXDR_GLO_SET_REQUEST) || (tag == AXDR_GLO_ACTION_REQUEST);
+
+            memset(&request, 0, sizeof(request));
+            if (chan->request != NULL)
+            {
+                // The pending request keeps its token, this one is not decoded
+                CSM_ERR("[CHAN] Previous request still pending");
+            }
+            else
+            {
+                // The token identifies this request if the database completes it later
+                chan->sequence++;
+                request.llc = chan->llc;
+                request.channel_id = chan->channel_id;
+                request.token = (chan->sequence << 8U) | chan->channel_id;
+
+                if (ciphered)
+                {
+                    int deciphered = channel_decipher(chan, &request, packet);
+                    if (deciphered && channel_reserve_ic(chan, &request))
+                    {
+                        ret = csm_server_services_execute(asso, &request, packet);
+                        packet->size = size;
+                        if (ret > 0)
+                        {
+                            ret = channel_cipher(chan, &request, packet, base, (uint32_t)ret);
+                        }
+                    }
+                    else if (deciphered)
+                    {
+                        // Refused in clear, the client retries once new counters are reserved (see csm_snapshot_reserve())
+                        csm_array_init(packet, packet->buff, size, 0U, base);
+                        ret = svc_exception_response_encoder(packet) ? (int)packet->wr_index : 0;
+                    }
+                }
+                else if (asso->state_cf == CF_ASSOCIATED)
+                {
+                    ret = csm_server_services_execute(asso, &request, packet);
+                }
+                else if (asso->state_cf == CF_ASSOCIATION_PENDING)
+                {
+                    // In case of HLS, we have to access to one attribute
+                    ret = csm_services_hls_execute(asso, &request, packet);
+                }
+                else
+                {
+                    CSM_ERR("[CHAN] Association is not open");
+                }
+            }
+
+            if (ret == CSM_SVC_PENDING)
+            {
+                // No reply now, see csm_channel_complete()
+                ret = 0;
+                if (!channel_keep_request(chan, &request))
+                {
+                    // The result of the access will be lost, the client can try again
+                    CSM_ERR("[CHAN] Too many pending requests");
+                    ret = csm_services_complete(&request, CSM_ERR_TEMPORARY_FAILURE, NULL, 0U, packet);
+                    if ((ret > 0) && (request.sc != 0U))
+                    {
+                        ret = channel_cipher(chan, &request, packet, base, (uint32_t)ret);
+                    }
+                }
+            }
+            break;
+        }
+        }
     }
+    return ret;
 }
 
 int csm_channel_execute(uint8_t channel, csm_array *packet)
@@ -57,14 +347,16 @@ int csm_channel_execute(uint8_t channel, csm_array *packet)
         return ret;
     }
 
+    CSM_METRICS_START(start);
+    csm_channel *chan = &channel_list[channel];
     uint32_t i = 0U;
 
     // We have to find the association used by this request
     // Find the valid association.
     for (i = 0U; i < asso_list_size; i++)
     {
-        if ((channel_list[channel].request.llc.ssap == asso_conf_list[i].llc.ssap) &&
-            (channel_list[channel].request.llc.dsap == asso_conf_list[i].llc.dsap))
+        if ((chan->llc.ssap == asso_conf_list[i].llc.ssap) &&
+            (chan->llc.dsap == asso_conf_list[i].llc.dsap))
         {
             break;
         }
@@ -75,40 +367,79 @@ int csm_channel_execute(uint8_t channel, csm_array *packet)
         // Association found, use this one
         // Link the state with the configuration structure
         asso_list[i].config = &asso_conf_list[i];
-        channel_list[channel].asso = &asso_list[i];
+        chan->asso = &asso_list[i];
+        chan->sec = (sec_list != NULL) ? &sec_list[i] : NULL;
+        ret = channel_run(chan, packet);
+    }
+
+    CSM_METRICS_STOP(CSM_LATENCY_CHANNEL, start);
+    return ret;
+}
+
+int csm_channel_execute_asso(uint8_t channel, csm_asso_state *asso, csm_sec_context *sec, csm_array *packet)
+{
+    int ret = FALSE;
+
+    if ((channel_list == NULL) || (channel >= channel_list_size) || (asso == NULL) || (asso->config == NULL))
+    {
+        CSM_ERR("[CHAN] Bad channel or association");
+        return ret;
+    }
+
+    CSM_METRICS_START(start);
+    csm_channel *chan = &channel_list[channel];
+
+    chan->asso = asso;
+    chan->sec = sec;
+    ret = channel_run(chan, packet);
+
+    CSM_METRICS_STOP(CSM_LATENCY_CHANNEL, start);
+    return ret;
+}
+
+int csm_channel_complete(uint32_t token, csm_db_code code, const uint8_t *data, uint32_t size, csm_array *packet)
+{
+    int ret = 0;
+    uint32_t channel = (token & 0xFFU) - 1U;
+
+    if ((channel < channel_list_size) && (channel_list[channel].request != NULL) && (channel_list[channel].request->token == token))
+    {
+        csm_request *request = channel_list[channel].request;
+        uint32_t base = packet->offset;
 
-        uint8_t tag;
-        if (csm_array_get(packet, 0U, &tag))
+        ret = csm_services_complete(request, code, data, size, packet);
+        if ((ret > 0) && (request->sc != 0U))
         {
-            switch (tag)
-            {
-            case CSM_ASSO_AARE:
-            case CSM_ASSO_AARQ:
-            case CSM_ASSO_RLRE:
-            case CSM_ASSO_RLRQ:
-                ret = csm_asso_server_execute(&asso_list[i], packet);
-                break;
-            default:
-                if (asso_list[i].state_cf == CF_ASSOCIATED)
-                {
-                    ret = csm_server_services_execute(&asso_list[i], &channel_list[channel].request, packet);
-                }
-                else if (asso_list[i].state_cf == CF_ASSOCIATION_PENDING)
-                {
-                    // In case of HLS, we have to access to one attribute
-                    ret = csm_services_hls_execute(&asso_list[i], &channel_list[channel].request, packet);
-                }
-                else
-                {
-                    CSM_ERR("[CHAN] Association is not open");
-                }
-                break;
-            }
+            ret = channel_cipher(&channel_list[channel], request, packet, base, (uint32_t)ret);
         }
+        channel_release_request(&channel_list[channel]);
+    }
+    else
+    {
+        CSM_ERR("[CHAN] No pending request for this token");
     }
     return ret;
 }
 
+int csm_channel_is_high_priority(uint8_t channel, const csm_array *packet)
+{
+    int high = FALSE;
+    uint8_t tag;
+    uint8_t invoke_id;
+
+    if ((channel < channel_list_size) && (channel_list[channel].asso != NULL) &&
+        (channel_list[channel].asso->state_cf == CF_ASSOCIATED) &&
+        csm_array_get(packet, 0U, &tag) && csm_array_get(packet, 2U, &invoke_id))
+    {
+        // Negotiated: both the client and the server have the conformance bit
+        const csm_asso_state *asso = channel_list[channel].asso;
+        high = ((tag == AXDR_GET_REQUEST) || (tag == AXDR_SET_REQUEST) || (tag == AXDR_ACTION_REQUEST)) &&
+               ((asso->conformance & CSM_CBLOCK_PRIORITY_MGT_SUPPORTED) != 0U) &&
+               ((invoke_id & 0x80U) != 0U);
+    }
+    return high;
+}
+
 int csm_channel_hls_pass3(csm_array *array, csm_request *request)
 {
     csm_sec_control_byte sc;
@@ -128,12 +459,16 @@ int csm_channel_hls_pass3(csm_array *array, csm_request *request)
     {
         uint32_t offset = array->offset; // Save the original offset
 
-        if (offset >= CSM_DEF_MAX_HLS_SIZE)
-        {
-            csm_asso_state *asso = channel_list[request->channel_id - 1U].asso;
+        csm_asso_state *asso = channel_list[request->channel_id - 1U].asso;
 
+        if (!csm_asso_hold_handshake(asso))
+        {
+            CSM_ERR("[CHAN] No HLS in progress");
+        }
+        else if (offset >= CSM_DEF_MAX_HLS_SIZE)
+        {
             // Reserve memory & prepare packet
-            array->offset = (offset + array->rd_index) - (CSM_DEF_SEC_HDR_SIZE + asso->handshake.stoc.size);
+            array->offset = (offset + array->rd_index) - (CSM_DEF_SEC_HDR_SIZE + asso->handshake->stoc.size);
             array->rd_index = 0U;
             array->wr_index = 0U;
 
@@ -141,7 +476,7 @@ int csm_channel_hls_pass3(csm_array *array, csm_request *request)
             // Tag is left untouched, other data are appended just before
             csm_array_write_u8(array, sc.sh_byte);
             csm_array_write_u32(array, ic);
-            csm_array_write_buff(array, &asso->handshake.stoc.value[0], asso->handshake.stoc.size);
+            csm_array_write_buff(array, &asso->handshake->stoc.value[0], asso->handshake->stoc.size);
             csm_array_writer_jump(array, 12U); // Add the tag (already in the buffer)
 
             csm_sec_result res = csm_sec_auth_decrypt(array, request, &asso->client_app_title[0]);
@@ -197,13 +532,17 @@ int csm_channel_hls_pass4(csm_array *array, csm_request *request)
     uint32_t ic = 0x01234567U; // FIXME: get the IC from the vital data manager
     uint32_t offset = array->offset; // save offset
 
-    if (offset >= CSM_DEF_MAX_HLS_SIZE)
-    {
-        csm_asso_state *asso = channel_list[request->channel_id - 1U].asso;       
+    csm_asso_state *asso = channel_list[request->channel_id - 1U].asso;
 
-        array->offset = offset - (asso->handshake.ctos.size - CSM_DEF_SEC_HDR_SIZE - 2U); // 2U is the OctetString encoding
+    if (!csm_asso_hold_handshake(asso))
+    {
+        CSM_ERR("[CHAN] No HLS in progress");
+    }
+    else if (offset >= CSM_DEF_MAX_HLS_SIZE)
+    {
+        array->offset = offset - (asso->handshake->ctos.size - CSM_DEF_SEC_HDR_SIZE - 2U); // 2U is the OctetString encoding
         // Write information data to authenticate
-        csm_array_write_buff(array, &asso->handshake.ctos.value[0], asso->handshake.ctos.size);
+        csm_array_write_buff(array, &asso->handshake->ctos.value[0], asso->handshake->ctos.size);
 
         csm_sec_result res = csm_sec_auth_encrypt(array, request, csm_sys_get_system_title(), sc, ic);
 
@@ -219,12 +558,16 @@ int csm_channel_hls_pass4(csm_array *array, csm_request *request)
         if ((res == CSM_SEC_OK) && valid)
         {
             CSM_LOG("[CHAN] HLS Pass 4 success!");
+            asso->state_cf = CF_ASSOCIATED;
             ret = TRUE;
         }
         else
         {
             CSM_ERR("[CHAN] HLS Pass 4 failure");
         }
+
+        // End of the HLS, the challenges are not needed anymore
+        csm_asso_release_handshake(asso);
     }
     else
     {
@@ -239,28 +582,53 @@ void csm_channel_disconnect(uint8_t channel)
 {
     if (channel < channel_list_size)
     {
-        channel_list[channel].request.channel_id = INVALID_CHANNEL_ID;
+        CSM_LOCK(pool_lock);
+        (void) slot_alloc_release(&channel_slots, channel);
+        CSM_UNLOCK(pool_lock);
+        channel_list[channel].channel_id = INVALID_CHANNEL_ID;
+        channel_release_request(&channel_list[channel]);
         if (channel_list[channel].asso != NULL)
         {
             channel_list[channel].asso->state_cf = CF_IDLE;
+            csm_asso_release_handshake(channel_list[channel].asso);
         }
     }
 }
 
+int csm_channel_resume(uint8_t channel_id, const csm_llc *llc)
+{
+    uint32_t slot = (uint32_t)channel_id - 1U;
+    int valid = (channel_list != NULL) && (channel_id != INVALID_CHANNEL_ID) && (slot < channel_list_size);
+
+    if (valid)
+    {
+        CSM_LOCK(pool_lock);
+        valid = slot_alloc_take(&channel_slots, slot);
+        CSM_UNLOCK(pool_lock);
+    }
+    if (valid)
+    {
+        channel_list[slot].channel_id = channel_id;
+        channel_list[slot].llc = *llc;
+        channel_list[slot].request = NULL;
+        CSM_LOG("[CHAN] Channel %d resumed", channel_id);
+    }
+    return valid;
+}
+
 uint8_t csm_channel_new(void)
 {
     uint8_t chan_id = INVALID_CHANNEL_ID;
-    // search for a valid free channel
     // In case of CONN_NEW event, channel parameter is 0 (means invalid)
-    for (uint32_t i = 0U; i < channel_list_size; i++)
+    CSM_LOCK(pool_lock);
+    int32_t slot = slot_alloc_get(&channel_slots);
+    CSM_UNLOCK(pool_lock);
+
+    if (slot >= 0)
     {
-        if (channel_list[i].request.channel_id == INVALID_CHANNEL_ID)
-        {
-            chan_id = i + 1U; // generate a channel id
-            channel_list[i].request.channel_id = chan_id;
-            CSM_LOG("[CHAN] Grant connection to channel %d", chan_id);
-            break;
-        }
+        chan_id = (uint8_t)(slot + 1); // generate a channel id
+        channel_list[slot].channel_id = chan_id;
+        CSM_LOG("[CHAN] Grant connection to channel %d", chan_id);
     }
 
     return chan_id;
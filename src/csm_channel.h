@@ -14,15 +14,25 @@
 
 #include "csm_association.h"
 #include "csm_services.h"
+#include "csm_security.h"
 
 #define INVALID_CHANNEL_ID 0U
 
 
+/**
+ * @brief Per connection state, kept small for the servers handling many sessions
+ *
+ * The request is decoded in a temporary structure during csm_channel_execute(); it is copied to a
+ * pool of CSM_DEF_MAX_REQUESTS slots only when the database leaves it pending.
+ */
 typedef struct
 {
-    csm_request request;
     csm_asso_state *asso;   //!< Association used for that channel
-
+    csm_sec_context *sec;   //!< Invocation counters of that association, NULL if the ciphered APDUs are dropped
+    csm_request *request;   //!< Request pending in the database, see csm_channel_complete(), NULL otherwise
+    csm_llc llc;            //!< Client and server SAP of the connection, set by the transport layer
+    uint8_t channel_id;     //!< INVALID_CHANNEL_ID if the channel is free
+    uint32_t sequence;      //!< Makes the completion tokens of a reused channel different
 } csm_channel;
 
 
@@ -30,7 +40,64 @@ void csm_channel_init(csm_channel *channels, uint8_t chan_size, csm_asso_state *
 void csm_channel_disconnect(uint8_t channel);
 int csm_channel_hls_pass3(csm_array *array, csm_request *request);
 int csm_channel_hls_pass4(csm_array *array, csm_request *request);
+
+/**
+ * @brief Execute one APDU received on the channel, the reply is written in the same packet
+ *
+ * The glo-get/set/action requests are deciphered in place and their response is ciphered with the
+ * same security control byte; the packet offset must leave room for the AAD (17 bytes). The
+ * reply always starts at the packet offset given, whatever its size.
+ * @return the reply size, 0 for no reply
+ */
 int csm_channel_execute(uint8_t channel, csm_array *packet);
+
+/**
+ * @brief Same as csm_channel_execute() with an association state owned by the caller
+ *
+ * For the servers keeping the associations outside of the stack (eg: a farm of virtual meters):
+ * the association list of csm_channel_init() is not used and asso->config must be set. Calls on
+ * different channels with different association states can run in parallel.
+ * @param sec: invocation counters of the association, NULL to drop the ciphered APDUs
+ */
+int csm_channel_execute_asso(uint8_t channel, csm_asso_state *asso, csm_sec_context *sec, csm_array *packet);
+
+/**
+ * @brief Invocation counters used by the glo-ciphered APDUs, one per association
+ *
+ * client_ic is the lowest counter accepted for the next request of the client, server_ic the
+ * next counter of a response; from server_ic_limit, if not 0, the ciphered requests are not executed
+ * and get an exception-response. The same array is given to csm_snapshot_save(). Ciphered APDUs
+ * are dropped until this is called.
+ */
+void csm_channel_set_security(csm_sec_context *contexts);
+
+/**
+ * @brief Encode the response of a request left pending by the database (CSM_PENDING)
+ *
+ * Can be called from the transport loop once the access is done; the packet is prepared like for
+ * csm_channel_execute(). Further requests on the channel are ignored until the completion.
+ * When CSM_DEF_MAX_REQUESTS requests are already pending, the request is answered at once with
+ * a temporary-failure result.
+ * @param token: request->token given to the database handler
+ * @return the number of bytes to send on the channel, 0 if the token is unknown (eg: channel closed)
+ */
+int csm_channel_complete(uint32_t token, csm_db_code code, const uint8_t *data, uint32_t size, csm_array *packet);
 uint8_t csm_channel_new(void);
 
+/**
+ * @brief Allocate a given channel with its LLC, after a restart (see csm_snapshot.h)
+ *
+ * The association is found again from the LLC at the next request.
+ * @return FALSE if the channel is already used or out of range
+ */
+int csm_channel_resume(uint8_t channel_id, const csm_llc *llc);
+
+/**
+ * @brief Priority bit of the invoke-id-and-priority of a plain GET, SET or ACTION request
+ *
+ * The bit is honoured only if priority-mgmt-supported is in the negotiated conformance of the
+ * association of the channel. Ciphered APDUs are normal priority: the byte is not readable yet.
+ */
+int csm_channel_is_high_priority(uint8_t channel, const csm_array *packet);
+
 #endif // CSM_CHANNEL_H
@@ -0,0 +1,728 @@
+/**
+ * Columnar export of profile buffers, in the Apache Arrow memory layout
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "csm_columnar.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+#include "clock.h"
+
+#define COL_DATETIME_TAG    25U
+#define COL_DATE_TAG        26U
+#define COL_TIME_TAG        27U
+#define COL_FLOAT32_TAG     23U
+#define COL_FLOAT64_TAG     24U
+#define COL_CLOCK_CLASS     8U
+#define COL_MAX_DEPTH       8U      //!< Nesting of the values skipped
+#define COL_EPOCH_CHUNK     64U     //!< Date-times converted at once
+
+// A-XDR is big endian: the gathered values are already in the host order on big endian hosts
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define COL_HOST_BIG_ENDIAN 1
+#else
+#define COL_HOST_BIG_ENDIAN 0
+#endif
+
+typedef struct
+{
+    const char *format;     //!< Arrow format string
+    uint8_t width;          //!< Bytes per value, 0 for the bits and the variable length types
+} col_type_info;
+
+// Indexed by enum csm_col_type; the fixed size binary format depends on the tag (see col_format())
+static const col_type_info cTypes[] =
+{
+    { "n", 0U },        // CSM_COL_PENDING, exported as null
+    { "n", 0U },        // CSM_COL_NULL
+    { "b", 0U },        // CSM_COL_BOOL
+    { "c", 1U },        // CSM_COL_INT8
+    { "C", 1U },        // CSM_COL_UINT8
+    { "s", 2U },        // CSM_COL_INT16
+    { "S", 2U },        // CSM_COL_UINT16
+    { "i", 4U },        // CSM_COL_INT32
+    { "I", 4U },        // CSM_COL_UINT32
+    { "l", 8U },        // CSM_COL_INT64
+    { "L", 8U },        // CSM_COL_UINT64
+    { "f", 4U },        // CSM_COL_FLOAT32
+    { "g", 8U },        // CSM_COL_FLOAT64
+    { "tss:", 8U },     // CSM_COL_TIMESTAMP
+    { "w:5", 5U },      // CSM_COL_FIXED
+    { "z", 0U },        // CSM_COL_BINARY
+    { "u", 0U }         // CSM_COL_UTF8
+};
+
+static uint8_t col_type_from_tag(uint8_t tag)
+{
+    uint8_t type;
+
+    switch (tag)
+    {
+    case AXDR_TAG_BOOLEAN:      type = CSM_COL_BOOL; break;
+    case AXDR_TAG_BCD:
+    case AXDR_TAG_INTEGER8:     type = CSM_COL_INT8; break;
+    case AXDR_TAG_ENUM:
+    case AXDR_TAG_UNSIGNED8:    type = CSM_COL_UINT8; break;
+    case AXDR_TAG_INTEGER16:    type = CSM_COL_INT16; break;
+    case AXDR_TAG_UNSIGNED16:   type = CSM_COL_UINT16; break;
+    case AXDR_TAG_INTEGER32:    type = CSM_COL_INT32; break;
+    case AXDR_TAG_UNSIGNED32:   type = CSM_COL_UINT32; break;
+    case AXDR_TAG_INTEGER64:    type = CSM_COL_INT64; break;
+    case AXDR_TAG_UNSIGNED64:   type = CSM_COL_UINT64; break;
+    case COL_FLOAT32_TAG:       type = CSM_COL_FLOAT32; break;
+    case COL_FLOAT64_TAG:       type = CSM_COL_FLOAT64; break;
+    case COL_DATETIME_TAG:      type = CSM_COL_TIMESTAMP; break;
+    case COL_DATE_TAG:
+    case COL_TIME_TAG:          type = CSM_COL_FIXED; break;
+    case AXDR_TAG_OCTETSTRING:
+    case AXDR_TAG_BITSTRING:    type = CSM_COL_BINARY; break;
+    case AXDR_TAG_VISIBLESTRING:
+    case AXDR_TAG_UTF8_STRING:  type = CSM_COL_UTF8; break;
+    default:                    type = CSM_COL_NULL; break;
+    }
+    return type;
+}
+
+static uint32_t col_width(const csm_col_def *def)
+{
+    return ((def->type == CSM_COL_FIXED) && (def->tag == COL_TIME_TAG)) ? 4U : cTypes[def->type].width;
+}
+
+static const char *col_format(const csm_col_def *def)
+{
+    return ((def->type == CSM_COL_FIXED) && (def->tag == COL_TIME_TAG)) ? "w:4" : cTypes[def->type].format;
+}
+
+static int col_is_variable(const csm_col_def *def)
+{
+    return (def->type == CSM_COL_BINARY) || (def->type == CSM_COL_UTF8);
+}
+
+// The clock column also accepts the date-time as an octet-string
+static int col_accepts(const csm_col_def *def, uint8_t tag)
+{
+    return (def->type == CSM_COL_TIMESTAMP) ? ((tag == COL_DATETIME_TAG) || (tag == AXDR_TAG_OCTETSTRING)) : (tag == def->tag);
+}
+
+// ----------------------------------- SCHEMA -----------------------------------
+
+static void col_make_name(csm_col_def *def)
+{
+    const uint8_t *ln = def->logical_name;
+
+    if (def->data_index != 0U)
+    {
+        (void) snprintf(def->name, CSM_COL_NAME_SIZE, "%u-%u.%u.%u.%u.%u.%u:%d:%u", def->class_id, ln[0], ln[1], ln[2],
+                        ln[3], ln[4], ln[5], def->attribute_id, def->data_index);
+    }
+    else
+    {
+        (void) snprintf(def->name, CSM_COL_NAME_SIZE, "%u-%u.%u.%u.%u.%u.%u:%d", def->class_id, ln[0], ln[1], ln[2],
+                        ln[3], ln[4], ln[5], def->attribute_id);
+    }
+}
+
+// Tag then a check of the value, the array is advanced by the tag only
+static int col_read_tag(csm_array *array, uint8_t expected)
+{
+    uint8_t tag = 0U;
+    return csm_array_read_u8(array, &tag) && (tag == expected);
+}
+
+static int col_read_length(csm_array *array, uint32_t *length)
+{
+    ber_length len;
+    int valid = csm_ber_read_len(array, &len);
+    *length = len.length;
+    return valid;
+}
+
+int csm_col_schema_init(csm_col_schema *schema, const uint8_t *capture_objects, uint32_t size)
+{
+    csm_array array;
+    uint32_t count = 0U;
+    uint32_t length = 0U;
+
+    memset(schema, 0, sizeof(csm_col_schema));
+    csm_array_init(&array, (uint8_t *)capture_objects, size, size, 0U);
+
+    int valid = col_read_tag(&array, AXDR_TAG_ARRAY) && col_read_length(&array, &count);
+    valid = valid && (count <= CSM_COL_MAX_COLUMNS);
+
+    for (uint32_t i = 0U; valid && (i < count); i++)
+    {
+        csm_col_def *def = &schema->columns[i];
+        uint8_t attribute = 0U;
+
+        // capture_object_definition: class_id, logical_name, attribute_index, data_index
+        valid = col_read_tag(&array, AXDR_TAG_STRUCTURE) && col_read_length(&array, &length) && (length == 4U);
+        valid = valid && col_read_tag(&array, AXDR_TAG_UNSIGNED16) && csm_array_read_u16(&array, &def->class_id);
+        valid = valid && col_read_tag(&array, AXDR_TAG_OCTETSTRING) && col_read_length(&array, &length) && (length == 6U);
+        valid = valid && (csm_array_unread(&array) >= 6U);
+        if (valid)
+        {
+            memcpy(def->logical_name, csm_array_rd_data(&array), 6U);
+            valid = csm_array_reader_jump(&array, 6U);
+        }
+        valid = valid && col_read_tag(&array, AXDR_TAG_INTEGER8) && csm_array_read_u8(&array, &attribute);
+        valid = valid && col_read_tag(&array, AXDR_TAG_UNSIGNED16) && csm_array_read_u16(&array, &def->data_index);
+
+        if (valid)
+        {
+            def->attribute_id = (int8_t)attribute;
+            def->type = ((def->class_id == COL_CLOCK_CLASS) && (def->attribute_id == 2) && (def->data_index == 0U)) ?
+                        CSM_COL_TIMESTAMP : CSM_COL_PENDING;
+            col_make_name(def);
+        }
+    }
+
+    valid = valid && (csm_array_unread(&array) == 0U);
+    schema->nb_columns = valid ? count : 0U;
+    return valid;
+}
+
+// ----------------------------------- BATCH -----------------------------------
+
+void csm_col_batch_init(csm_col_batch *batch, csm_col_schema *schema, uint8_t *arena, uint32_t arena_size,
+                        uint32_t capacity, uint32_t var_size)
+{
+    batch->schema = schema;
+    batch->arena = arena;
+    batch->arena_size = arena_size;
+    batch->capacity = capacity;
+    batch->var_size = var_size;
+    csm_col_batch_reset(batch);
+}
+
+void csm_col_batch_reset(csm_col_batch *batch)
+{
+    batch->arena_used = 0U;
+    batch->rows = 0U;
+    batch->buffers = 0U;
+    batch->errors = 0U;
+    batch->mismatches = 0U;
+    batch->overflows = 0U;
+    memset(batch->columns, 0, sizeof(batch->columns));
+}
+
+// Zeroed buffer of the arena, aligned on CSM_COL_ALIGN from the arena start
+static uint8_t *col_carve(csm_col_batch *batch, uint32_t size)
+{
+    uint8_t *buffer = NULL;
+    uint32_t aligned = (size + CSM_COL_ALIGN - 1U) & ~(CSM_COL_ALIGN - 1U);
+
+    if (aligned <= (batch->arena_size - batch->arena_used))
+    {
+        buffer = &batch->arena[batch->arena_used];
+        memset(buffer, 0, aligned);
+        batch->arena_used += aligned;
+    }
+    return buffer;
+}
+
+// Buffers of a column whose type is known, the rows decoded before are null
+static int col_alloc(csm_col_batch *batch, uint32_t index)
+{
+    const csm_col_def *def = &batch->schema->columns[index];
+    csm_col_column *col = &batch->columns[index];
+    uint32_t bitmap = (batch->capacity + 7U) / 8U;
+    int valid = TRUE;
+
+    if ((col->validity == NULL) && (def->type > CSM_COL_NULL))
+    {
+        col->validity = col_carve(batch, bitmap);
+        valid = (col->validity != NULL);
+
+        if (valid && (def->type == CSM_COL_BOOL))
+        {
+            col->values = col_carve(batch, bitmap);
+            valid = (col->values != NULL);
+        }
+        else if (valid && col_is_variable(def))
+        {
+            col->offsets = (int32_t *)col_carve(batch, (batch->capacity + 1U) * 4U);
+            col->data = col_carve(batch, batch->var_size);
+            col->data_capacity = batch->var_size;
+            valid = (col->offsets != NULL) && ((col->data != NULL) || (batch->var_size == 0U));
+        }
+        else if (valid)
+        {
+            col->values = col_carve(batch, batch->capacity * col_width(def));
+            valid = (col->values != NULL);
+            if (valid && (def->type == CSM_COL_TIMESTAMP))
+            {
+                col->raw = col_carve(batch, batch->capacity * CLK_COSEM_DATETIME_SIZE);
+                valid = (col->raw != NULL);
+            }
+        }
+
+        if (!valid)
+        {
+            col->validity = NULL;
+        }
+    }
+    return valid;
+}
+
+// ----------------------------------- DECODING -----------------------------------
+
+static uint32_t col_fixed_size(uint8_t tag)
+{
+    uint32_t size;
+
+    switch (tag)
+    {
+    case AXDR_TAG_NULL:         size = 0U; break;
+    case AXDR_TAG_BOOLEAN:
+    case AXDR_TAG_BCD:
+    case AXDR_TAG_INTEGER8:
+    case AXDR_TAG_UNSIGNED8:
+    case AXDR_TAG_ENUM:         size = 1U; break;
+    case AXDR_TAG_INTEGER16:
+    case AXDR_TAG_UNSIGNED16:   size = 2U; break;
+    case AXDR_TAG_INTEGER32:
+    case AXDR_TAG_UNSIGNED32:
+    case COL_FLOAT32_TAG:
+    case COL_TIME_TAG:          size = 4U; break;
+    case COL_DATE_TAG:          size = 5U; break;
+    case AXDR_TAG_INTEGER64:
+    case AXDR_TAG_UNSIGNED64:
+    case COL_FLOAT64_TAG:       size = 8U; break;
+    case COL_DATETIME_TAG:      size = CLK_COSEM_DATETIME_SIZE; break;
+    default:                    size = 0xFFFFFFFFU; break;
+    }
+    return size;
+}
+
+// Skip a value whose tag is read
+static int col_skip(csm_array *array, uint8_t tag, uint32_t depth)
+{
+    uint32_t size = col_fixed_size(tag);
+    int valid = TRUE;
+
+    if (size == 0xFFFFFFFFU)
+    {
+        valid = col_read_length(array, &size);
+        if (valid && ((tag == AXDR_TAG_ARRAY) || (tag == AXDR_TAG_STRUCTURE)))
+        {
+            valid = (depth < COL_MAX_DEPTH);
+            for (uint32_t i = 0U; valid && (i < size); i++)
+            {
+                uint8_t sub = 0U;
+                valid = csm_array_read_u8(array, &sub) && col_skip(array, sub, depth + 1U);
+            }
+            size = 0U;
+        }
+        else if (valid && (tag == AXDR_TAG_BITSTRING))
+        {
+            size = (size + 7U) / 8U;
+        }
+        else if (valid && (tag != AXDR_TAG_OCTETSTRING) && (tag != AXDR_TAG_VISIBLESTRING) && (tag != AXDR_TAG_UTF8_STRING))
+        {
+            valid = FALSE;
+        }
+    }
+    return valid && ((size == 0U) || csm_array_reader_jump(array, size));
+}
+
+static void col_set_bit(uint8_t *bitmap, uint32_t row)
+{
+    bitmap[row >> 3U] |= (uint8_t)(1U << (row & 7U));
+}
+
+// The buffers of a null value: the variable length columns need their offset
+static void col_set_null(const csm_col_def *def, csm_col_column *col, uint32_t row)
+{
+    if (col->validity != NULL)
+    {
+        if (col->offsets != NULL)
+        {
+            col->offsets[row + 1U] = (int32_t)col->data_size;
+        }
+        else if ((col->values != NULL) && (def->type != CSM_COL_BOOL))
+        {
+            uint32_t width = col_width(def);
+            memset(&col->values[row * width], 0, width);
+        }
+    }
+}
+
+static int col_variable(csm_col_batch *batch, const csm_col_def *def, csm_col_column *col, csm_array *array, uint32_t row)
+{
+    uint32_t length = 0U;
+    int valid = col_read_length(array, &length);
+    uint32_t size = (def->tag == AXDR_TAG_BITSTRING) ? ((length + 7U) / 8U) : length;
+
+    valid = valid && (csm_array_unread(array) >= size);
+    if (valid && ((col->data_size + size) <= col->data_capacity))
+    {
+        memcpy(&col->data[col->data_size], csm_array_rd_data(array), size);
+        col->data_size += size;
+        col->offsets[row + 1U] = (int32_t)col->data_size;
+        col_set_bit(col->validity, row);
+    }
+    else if (valid)
+    {
+        batch->overflows++;
+        col_set_null(def, col, row);
+    }
+    return valid && ((size == 0U) || csm_array_reader_jump(array, size));
+}
+
+// One element of a row; the values are copied as encoded, see col_convert()
+static int col_value(csm_col_batch *batch, uint32_t index, csm_array *array, uint32_t row)
+{
+    csm_col_def *def = &batch->schema->columns[index];
+    csm_col_column *col = &batch->columns[index];
+    uint8_t tag = 0U;
+    int valid = csm_array_read_u8(array, &tag);
+
+    if (valid && (tag != AXDR_TAG_NULL) && (def->type == CSM_COL_PENDING))
+    {
+        def->type = col_type_from_tag(tag);
+        def->tag = tag;
+        valid = col_alloc(batch, index);
+    }
+
+    if (!valid)
+    {
+        // Bad encoding, or no room for the column
+    }
+    else if ((tag == AXDR_TAG_NULL) || (def->type == CSM_COL_NULL) || !col_accepts(def, tag))
+    {
+        if ((tag != AXDR_TAG_NULL) && (def->type != CSM_COL_NULL))
+        {
+            batch->mismatches++;
+        }
+        col_set_null(def, col, row);
+        valid = col_skip(array, tag, 0U);
+    }
+    else if (def->type == CSM_COL_BOOL)
+    {
+        uint8_t value = 0U;
+        valid = csm_array_read_u8(array, &value);
+        if (valid && (value != 0U))
+        {
+            col_set_bit(col->values, row);
+        }
+        col_set_bit(col->validity, row);
+    }
+    else if (col_is_variable(def))
+    {
+        valid = col_variable(batch, def, col, array, row);
+    }
+    else if (def->type == CSM_COL_TIMESTAMP)
+    {
+        uint32_t length = CLK_COSEM_DATETIME_SIZE;
+        if (tag == AXDR_TAG_OCTETSTRING)
+        {
+            valid = col_read_length(array, &length);
+        }
+        if (valid && (length == CLK_COSEM_DATETIME_SIZE) && (csm_array_unread(array) >= length))
+        {
+            memcpy(&col->raw[row * CLK_COSEM_DATETIME_SIZE], csm_array_rd_data(array), CLK_COSEM_DATETIME_SIZE);
+            col_set_bit(col->validity, row);
+        }
+        else if (valid)
+        {
+            batch->mismatches++;
+            col_set_null(def, col, row);
+        }
+        valid = valid && csm_array_reader_jump(array, length);
+    }
+    else
+    {
+        uint32_t width = col_width(def);
+        valid = (csm_array_unread(array) >= width);
+        if (valid)
+        {
+            memcpy(&col->values[row * width], csm_array_rd_data(array), width);
+            col_set_bit(col->validity, row);
+            valid = csm_array_reader_jump(array, width);
+        }
+    }
+    return valid;
+}
+
+// Byte swaps written as plain loops over contiguous values: vectorized by the compiler
+static void col_swap16(uint16_t *values, uint32_t count)
+{
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        values[i] = (uint16_t)((values[i] >> 8U) | (values[i] << 8U));
+    }
+}
+
+static void col_swap32(uint32_t *values, uint32_t count)
+{
+    for (uint32_t i = 0U; i < count; i++)
+    {
+#if defined(__GNUC__)
+        values[i] = __builtin_bswap32(values[i]);
+#else
+        uint32_t v = values[i];
+        values[i] = (v >> 24U) | ((v >> 8U) & 0xFF00U) | ((v << 8U) & 0xFF0000U) | (v << 24U);
+#endif
+    }
+}
+
+static void col_swap64(uint64_t *values, uint32_t count)
+{
+    for (uint32_t i = 0U; i < count; i++)
+    {
+#if defined(__GNUC__)
+        values[i] = __builtin_bswap64(values[i]);
+#else
+        uint64_t v = values[i];
+        v = ((v & 0x00FF00FF00FF00FFULL) << 8U) | ((v >> 8U) & 0x00FF00FF00FF00FFULL);
+        v = ((v & 0x0000FFFF0000FFFFULL) << 16U) | ((v >> 16U) & 0x0000FFFF0000FFFFULL);
+        values[i] = (v << 32U) | (v >> 32U);
+#endif
+    }
+}
+
+// Date-times of the rows to seconds, by chunks; the invalid ones become null
+static void col_timestamps(csm_col_column *col, uint32_t first, uint32_t count)
+{
+    uint32_t epoch[COL_EPOCH_CHUNK];
+    int64_t *values = (int64_t *)col->values;
+
+    for (uint32_t done = 0U; done < count; done += COL_EPOCH_CHUNK)
+    {
+        uint32_t row = first + done;
+        uint32_t n = ((count - done) < COL_EPOCH_CHUNK) ? (count - done) : COL_EPOCH_CHUNK;
+
+        (void) clk_cosem_to_epoch_batch(&col->raw[row * CLK_COSEM_DATETIME_SIZE], CLK_COSEM_DATETIME_SIZE, n, epoch);
+        for (uint32_t i = 0U; i < n; i++)
+        {
+            int valid = (col->validity[(row + i) >> 3U] >> ((row + i) & 7U)) & 1U;
+            if (valid && (epoch[i] == CLK_EPOCH_INVALID))
+            {
+                col->validity[(row + i) >> 3U] &= (uint8_t)~(1U << ((row + i) & 7U));
+            }
+            values[row + i] = (valid && (epoch[i] != CLK_EPOCH_INVALID)) ? (int64_t)epoch[i] : 0;
+        }
+    }
+}
+
+// Second pass over the new rows of a column, from the encoded values to the Arrow values
+static void col_convert(const csm_col_def *def, csm_col_column *col, uint32_t first, uint32_t count)
+{
+    if ((col->validity == NULL) || (count == 0U))
+    {
+        // Nothing decoded
+    }
+    else if (def->type == CSM_COL_TIMESTAMP)
+    {
+        col_timestamps(col, first, count);
+    }
+    else if (!COL_HOST_BIG_ENDIAN && (def->type != CSM_COL_FIXED) && (col->values != NULL))
+    {
+        switch (cTypes[def->type].width)
+        {
+        case 2U: col_swap16(&((uint16_t *)col->values)[first], count); break;
+        case 4U: col_swap32(&((uint32_t *)col->values)[first], count); break;
+        case 8U: col_swap64(&((uint64_t *)col->values)[first], count); break;
+        default: break;
+        }
+    }
+}
+
+// Remove the rows from 'first' (the row being decoded included) of a rejected buffer
+static void col_rollback(csm_col_batch *batch, uint32_t first)
+{
+    uint32_t end = (batch->rows < batch->capacity) ? (batch->rows + 1U) : batch->capacity;
+
+    for (uint32_t c = 0U; c < batch->schema->nb_columns; c++)
+    {
+        const csm_col_def *def = &batch->schema->columns[c];
+        csm_col_column *col = &batch->columns[c];
+
+        for (uint32_t row = first; (col->validity != NULL) && (row < end); row++)
+        {
+            col->validity[row >> 3U] &= (uint8_t)~(1U << (row & 7U));
+            if (def->type == CSM_COL_BOOL)
+            {
+                col->values[row >> 3U] &= (uint8_t)~(1U << (row & 7U));
+            }
+        }
+        if (col->offsets != NULL)
+        {
+            col->data_size = (uint32_t)col->offsets[first];
+        }
+    }
+    batch->rows = first;
+}
+
+int csm_col_decode(csm_col_batch *batch, const uint8_t *buffer, uint32_t size)
+{
+    csm_col_schema *schema = batch->schema;
+    csm_array array;
+    uint32_t count = 0U;
+    uint32_t length = 0U;
+    uint32_t r = 0U;
+    uint32_t first = batch->rows;
+    uint32_t mismatches = batch->mismatches;
+    uint32_t overflows = batch->overflows;
+
+    csm_array_init(&array, (uint8_t *)buffer, size, size, 0U);
+    int valid = col_read_tag(&array, AXDR_TAG_ARRAY) && col_read_length(&array, &count);
+
+    // Columns typed by a previous batch of the profile
+    for (uint32_t c = 0U; valid && (c < schema->nb_columns); c++)
+    {
+        valid = col_alloc(batch, c);
+    }
+
+    for (r = 0U; valid && (r < count); r++)
+    {
+        if (batch->rows >= batch->capacity)
+        {
+            batch->overflows += count - r;
+            break;
+        }
+
+        valid = col_read_tag(&array, AXDR_TAG_STRUCTURE) && col_read_length(&array, &length) && (length == schema->nb_columns);
+        for (uint32_t c = 0U; valid && (c < schema->nb_columns); c++)
+        {
+            valid = col_value(batch, c, &array, batch->rows);
+        }
+        if (valid)
+        {
+            batch->rows++;
+        }
+    }
+
+    // The buffer ends with its last row, unless the batch is full before
+    valid = valid && ((r < count) || (csm_array_unread(&array) == 0U));
+
+    if (valid)
+    {
+        for (uint32_t c = 0U; c < schema->nb_columns; c++)
+        {
+            col_convert(&schema->columns[c], &batch->columns[c], first, batch->rows - first);
+        }
+        batch->buffers++;
+    }
+    else
+    {
+        col_rollback(batch, first);
+        batch->mismatches = mismatches;
+        batch->overflows = overflows;
+        batch->errors++;
+    }
+    return valid;
+}
+
+// ----------------------------------- EXPORT -----------------------------------
+
+static void col_release_schema(struct ArrowSchema *schema)
+{
+    for (int64_t i = 0; i < schema->n_children; i++)
+    {
+        if (schema->children[i]->release != NULL)
+        {
+            schema->children[i]->release(schema->children[i]);
+        }
+    }
+    schema->release = NULL;
+}
+
+static void col_release_array(struct ArrowArray *array)
+{
+    for (int64_t i = 0; i < array->n_children; i++)
+    {
+        if (array->children[i]->release != NULL)
+        {
+            array->children[i]->release(array->children[i]);
+        }
+    }
+    array->release = NULL;
+}
+
+static int64_t col_null_count(const uint8_t *validity, uint32_t rows)
+{
+    static const uint8_t cBits[16] = { 0U, 1U, 1U, 2U, 1U, 2U, 2U, 3U, 1U, 2U, 2U, 3U, 2U, 3U, 3U, 4U };
+    uint32_t valid = 0U;
+
+    for (uint32_t i = 0U; i < (rows / 8U); i++)
+    {
+        valid += cBits[validity[i] & 0x0FU] + cBits[validity[i] >> 4U];
+    }
+    for (uint32_t row = rows & ~7U; row < rows; row++)
+    {
+        valid += (validity[row >> 3U] >> (row & 7U)) & 1U;
+    }
+    return (int64_t)(rows - valid);
+}
+
+void csm_col_export(csm_col_batch *batch, struct ArrowSchema *schema, struct ArrowArray *array)
+{
+    uint32_t nb_columns = batch->schema->nb_columns;
+
+    for (uint32_t c = 0U; c < nb_columns; c++)
+    {
+        const csm_col_def *def = &batch->schema->columns[c];
+        csm_col_column *col = &batch->columns[c];
+        struct ArrowSchema *child_schema = &batch->child_schemas[c];
+        struct ArrowArray *child = &batch->child_arrays[c];
+        const void **buffers = batch->child_buffers[c];
+
+        // A typed column without any row yet still needs its buffers
+        int has_buffers = col_alloc(batch, c) && (col->validity != NULL);
+
+        memset(child_schema, 0, sizeof(struct ArrowSchema));
+        child_schema->format = has_buffers ? col_format(def) : "n";
+        child_schema->name = def->name;
+        child_schema->flags = ARROW_FLAG_NULLABLE;
+        child_schema->release = col_release_schema;
+        batch->child_schema_ptrs[c] = child_schema;
+
+        memset(child, 0, sizeof(struct ArrowArray));
+        child->length = batch->rows;
+        child->buffers = buffers;
+        child->release = col_release_array;
+        batch->child_array_ptrs[c] = child;
+
+        if (has_buffers)
+        {
+            col->null_count = col_null_count(col->validity, batch->rows);
+            child->null_count = col->null_count;
+            buffers[0] = col->validity;
+            buffers[1] = (col->offsets != NULL) ? (const void *)col->offsets : (const void *)col->values;
+            buffers[2] = col->data;
+            child->n_buffers = (col->offsets != NULL) ? 3 : 2;
+        }
+        else
+        {
+            // Null type: no buffer
+            child->null_count = batch->rows;
+            child->n_buffers = 0;
+        }
+    }
+
+    memset(schema, 0, sizeof(struct ArrowSchema));
+    schema->format = "+s";
+    schema->name = "";
+    schema->n_children = nb_columns;
+    schema->children = batch->child_schema_ptrs;
+    schema->release = col_release_schema;
+
+    memset(array, 0, sizeof(struct ArrowArray));
+    batch->struct_buffers[0] = NULL;
+    array->length = batch->rows;
+    array->n_buffers = 1;
+    array->buffers = batch->struct_buffers;
+    array->n_children = nb_columns;
+    array->children = batch->child_array_ptrs;
+    array->release = col_release_array;
+}
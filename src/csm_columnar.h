@@ -0,0 +1,181 @@
+/**
+ * Columnar export of profile buffers, in the Apache Arrow memory layout
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_COLUMNAR_H
+#define CSM_COLUMNAR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define CSM_COL_MAX_COLUMNS     32U
+#define CSM_COL_NAME_SIZE       48U
+#define CSM_COL_ALIGN           64U     //!< Arrow buffer alignment
+
+// Arrow C data interface (ABI stable, see the Arrow specification), shared with other producers
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED   1
+#define ARROW_FLAG_NULLABLE             2
+#define ARROW_FLAG_MAP_KEYS_SORTED      4
+
+struct ArrowSchema
+{
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray
+{
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+enum csm_col_type
+{
+    CSM_COL_PENDING,    //!< Not known yet, fixed by the first value that is not null
+    CSM_COL_NULL,       //!< No value, or a type without Arrow equivalent (array, structure)
+    CSM_COL_BOOL,
+    CSM_COL_INT8,
+    CSM_COL_UINT8,
+    CSM_COL_INT16,
+    CSM_COL_UINT16,
+    CSM_COL_INT32,
+    CSM_COL_UINT32,
+    CSM_COL_INT64,
+    CSM_COL_UINT64,
+    CSM_COL_FLOAT32,
+    CSM_COL_FLOAT64,
+    CSM_COL_TIMESTAMP,  //!< COSEM date-time to seconds, local time as in the date-time (no time zone)
+    CSM_COL_FIXED,      //!< Date or time, bytes as encoded
+    CSM_COL_BINARY,     //!< Octet-string, bit-string
+    CSM_COL_UTF8        //!< Visible-string, utf8-string
+};
+
+typedef struct
+{
+    uint16_t class_id;
+    uint8_t logical_name[6];
+    int8_t attribute_id;
+    uint16_t data_index;
+    uint8_t type;                   //!< enum csm_col_type
+    uint8_t tag;                    //!< A-XDR tag of the values
+    char name[CSM_COL_NAME_SIZE];   //!< "class-A.B.C.D.E.F:attribute[:index]"
+} csm_col_def;
+
+// Columns of a profile, shared by all the batches decoded from it
+typedef struct
+{
+    csm_col_def columns[CSM_COL_MAX_COLUMNS];
+    uint32_t nb_columns;
+} csm_col_schema;
+
+/**
+ * @brief Build the schema from the capture_objects attribute (array of capture_object_definition)
+ *
+ * The clock time (class 8, attribute 2) gives a timestamp column. The other types are fixed by the
+ * first value decoded that is not null, then kept for the whole profile.
+ */
+int csm_col_schema_init(csm_col_schema *schema, const uint8_t *capture_objects, uint32_t size);
+
+// One column in the Arrow layout, the buffers are in the arena of the batch
+typedef struct
+{
+    uint8_t *validity;      //!< Bit i set if the row i is valid (LSB first)
+    uint8_t *values;        //!< Fixed width values, little endian on little endian hosts; bits for bool
+    int32_t *offsets;       //!< Variable length: rows + 1 offsets in data
+    uint8_t *data;
+    uint32_t data_size;
+    uint32_t data_capacity;
+    uint8_t *raw;           //!< Timestamp: date-times as received, converted after each buffer
+    int64_t null_count;
+} csm_col_column;
+
+typedef struct
+{
+    csm_col_schema *schema;
+    uint8_t *arena;
+    uint32_t arena_size;
+    uint32_t arena_used;
+    uint32_t var_size;      //!< Data bytes of each variable length column
+    uint32_t capacity;      //!< Rows
+    uint32_t rows;
+
+    uint32_t buffers;       //!< Buffers (profile buffer attribute values) decoded
+    uint32_t errors;        //!< Buffers rejected: bad encoding, row that is not a structure of the schema
+    uint32_t mismatches;    //!< Values of another type than their column, exported as null
+    uint32_t overflows;     //!< Rows lost (batch full) or variable length values lost (data full, exported as null)
+
+    csm_col_column columns[CSM_COL_MAX_COLUMNS];
+
+    // Export, see csm_col_export()
+    struct ArrowSchema child_schemas[CSM_COL_MAX_COLUMNS];
+    struct ArrowSchema *child_schema_ptrs[CSM_COL_MAX_COLUMNS];
+    struct ArrowArray child_arrays[CSM_COL_MAX_COLUMNS];
+    struct ArrowArray *child_array_ptrs[CSM_COL_MAX_COLUMNS];
+    const void *child_buffers[CSM_COL_MAX_COLUMNS][3];
+    const void *struct_buffers[1];
+} csm_col_batch;
+
+/**
+ * @brief Prepare a batch of 'capacity' rows
+ *
+ * All the buffers are carved from the arena, at least 8 bytes aligned (64 recommended by Arrow); a
+ * variable length column gets var_size bytes of data. Columns are allocated when their type is known.
+ */
+void csm_col_batch_init(csm_col_batch *batch, csm_col_schema *schema, uint8_t *arena, uint32_t arena_size,
+                        uint32_t capacity, uint32_t var_size);
+
+// Empty the batch, the counters included; the exported arrays must have been released
+void csm_col_batch_reset(csm_col_batch *batch);
+
+/**
+ * @brief Append the rows of a profile buffer (array of structure, as in the GET response data)
+ *
+ * Values are gathered row by row, then each new column range is converted at once: byte swap of the
+ * fixed width values (none on big endian hosts), date-times to seconds.
+ * @return FALSE if the buffer is rejected, its rows are then removed
+ */
+int csm_col_decode(csm_col_batch *batch, const uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief Export the batch as an Arrow struct array, one child per column, without copy
+ *
+ * The arrays point to the batch buffers: the batch must not be modified before the consumer
+ * calls the release callbacks.
+ */
+void csm_col_export(csm_col_batch *batch, struct ArrowSchema *schema, struct ArrowArray *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_COLUMNAR_H
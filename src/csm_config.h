@@ -6,6 +6,21 @@
 
 #define CSM_DEF_PDU_SIZE        1024
 
+// Associations being established at the same time (ACSE and HLS challenges)
+#ifndef CSM_DEF_MAX_HANDSHAKES
+#define CSM_DEF_MAX_HANDSHAKES  8U
+#endif
+
+// Seconds after which an unused handshake can be reclaimed by a new association, see csm_asso_set_clock()
+#ifndef CSM_DEF_HANDSHAKE_TIMEOUT
+#define CSM_DEF_HANDSHAKE_TIMEOUT   30U
+#endif
+
+// Requests executed or left pending by the database at the same time, see csm_channel_complete()
+#ifndef CSM_DEF_MAX_REQUESTS
+#define CSM_DEF_MAX_REQUESTS    8U
+#endif
+
 
 #define TRUE 1
 #define FALSE 0
@@ -14,17 +29,86 @@
 #define CSM_ASSERT(condition) assert(condition)
 #endif
 
+// Compiler helpers for the lock-free modules (trace ring, metrics)
+// CSM_LOCK / CSM_UNLOCK: spinlock for the few instructions taking a slot of a shared pool, declared with
+// static CSM_LOCK_TYPE name = CSM_LOCK_INIT;
+#if defined(__GNUC__)
+#define CSM_THREAD_LOCAL        __thread
+#define CSM_BARRIER()           __sync_synchronize()
+#define CSM_ALIGNED(n)          __attribute__((aligned(n)))
+#define CSM_LOCK_TYPE           volatile int
+#define CSM_LOCK_INIT           0
+#define CSM_LOCK(lock)          do { } while (__sync_lock_test_and_set(&(lock), 1))
+#define CSM_UNLOCK(lock)        __sync_lock_release(&(lock))
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#include <stdatomic.h>
+#define CSM_THREAD_LOCAL        _Thread_local
+#define CSM_BARRIER()           atomic_thread_fence(memory_order_seq_cst)
+#define CSM_ALIGNED(n)          _Alignas(n)
+#define CSM_LOCK_TYPE           atomic_flag
+#define CSM_LOCK_INIT           ATOMIC_FLAG_INIT
+#define CSM_LOCK(lock)          do { } while (atomic_flag_test_and_set_explicit(&(lock), memory_order_acquire))
+#define CSM_UNLOCK(lock)        atomic_flag_clear_explicit(&(lock), memory_order_release)
+#else
+// Single threaded targets
+#define CSM_THREAD_LOCAL
+#define CSM_BARRIER()
+#define CSM_ALIGNED(n)
+#define CSM_LOCK_TYPE           int
+#define CSM_LOCK_INIT           0
+#define CSM_LOCK(lock)          (void) (lock)
+#define CSM_UNLOCK(lock)        (void) (lock)
+#endif
+
+#define CSM_CACHE_LINE_SIZE     64U
+
+// Trace levels, filtered at compile time. Statements above CSM_TRACE_LEVEL are removed completely.
+#define CSM_TRACE_LEVEL_NONE    0
+#define CSM_TRACE_LEVEL_ERR     1
+#define CSM_TRACE_LEVEL_LOG     2
+#define CSM_TRACE_LEVEL_TRACE   3
+
+#ifndef CSM_TRACE_LEVEL
+#define CSM_TRACE_LEVEL CSM_TRACE_LEVEL_TRACE
+#endif
+
+// Define CSM_TRACE_USE_RING to record binary events into the trace ring (see csm_trace.h) instead of printf
+#ifdef CSM_TRACE_USE_RING
+#include "csm_trace.h"
+#define CSM_TRACE_PRINT(...)            csm_trace_write(CSM_TRACE_LEVEL_TRACE, __VA_ARGS__)
+#define CSM_TRACE_LINE(level, tag, ...) csm_trace_write(level, __VA_ARGS__)
+#else
+#define CSM_TRACE_PRINT(...)            printf(__VA_ARGS__)
+#define CSM_TRACE_LINE(level, tag, ...) do { printf(tag); printf(__VA_ARGS__); printf("\r\n"); } while (0)
+#endif
+
 #ifndef CSM_TRACE
-#define CSM_TRACE(...) printf(__VA_ARGS__)
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_TRACE)
+#define CSM_TRACE(...) CSM_TRACE_PRINT(__VA_ARGS__)
+#else
+#define CSM_TRACE(...) do { } while (0)
+#endif
 #endif
 
 #ifndef CSM_LOG
-#define CSM_LOG(...) printf("[LOG]");printf(__VA_ARGS__);printf("\r\n")
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_LOG)
+#define CSM_LOG(...) CSM_TRACE_LINE(CSM_TRACE_LEVEL_LOG, "[LOG]", __VA_ARGS__)
+#else
+#define CSM_LOG(...) do { } while (0)
+#endif
 #endif
 
 #ifndef CSM_ERR
-#define CSM_ERR(...) printf("[ERR]");printf(__VA_ARGS__);printf("\r\n")
+#if (CSM_TRACE_LEVEL >= CSM_TRACE_LEVEL_ERR)
+#define CSM_ERR(...) CSM_TRACE_LINE(CSM_TRACE_LEVEL_ERR, "[ERR]", __VA_ARGS__)
+#else
+#define CSM_ERR(...) do { } while (0)
+#endif
 #endif
 
-#endif // CSM_CONFIG_H
+// Set CSM_METRICS_ENABLED to 0 to remove the counters and latency histograms (see csm_metrics.h)
+#ifndef CSM_METRICS_ENABLED
+#define CSM_METRICS_ENABLED 1
+#endif
 
+#endif // CSM_CONFIG_H
@@ -37,13 +37,21 @@ enum xdlms_tag
     AXDR_BAD_TAG            = 0U,
     AXDR_INITIATE_REQUEST   = 1U,
     AXDR_INITIATE_RESPONSE  = 8U,
+    AXDR_DATA_NOTIFICATION  = 15U,
     AXDR_GET_REQUEST        = 192U,
     AXDR_SET_REQUEST        = 193U,
     AXDR_ACTION_REQUEST     = 195U,
     AXDR_GET_RESPONSE       = 196U,
     AXDR_SET_RESPONSE       = 197U,
     AXDR_ACTION_RESPONSE    = 199U,
-    AXDR_EXCEPTION_RESPONSE = 216U
+    AXDR_GLO_GET_REQUEST    = 200U,
+    AXDR_GLO_SET_REQUEST    = 201U,
+    AXDR_GLO_ACTION_REQUEST = 203U,
+    AXDR_GLO_GET_RESPONSE   = 204U,
+    AXDR_GLO_SET_RESPONSE   = 205U,
+    AXDR_GLO_ACTION_RESPONSE = 207U,
+    AXDR_EXCEPTION_RESPONSE = 216U,
+    AXDR_GENERAL_GLO_CIPHERING = 219U
 };
 
 enum csm_conformance_mask
@@ -133,6 +141,9 @@ typedef struct
     enum svc_request type; // Type of the request (normal, next ...)
     csm_llc llc;
     uint8_t channel_id; // Channel in use
+    uint32_t token;     // Completion token of a pending database access
+    uint8_t sc;         // Security control byte of a glo-ciphered request, 0 if the request is plain
+    uint32_t ic;        // Invocation counter of the ciphered response, reserved before the execution
 
 } csm_request;
 
@@ -0,0 +1,397 @@
+/**
+ * Bulk decoding of response APDUs into columns, for head-end ingestion
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include "csm_ingest.h"
+#include "csm_services.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+#include "clock.h"
+
+#define INGEST_GET_RESPONSE         0xC4U
+#define INGEST_GET_WITH_LIST        3U
+#define INGEST_DATETIME_TAG         25U     // date-time type, same encoding as an octet-string of 12 bytes
+
+// Decoding context of one APDU
+typedef struct
+{
+    csm_ingest_columns *cols;
+    uint32_t meter_id;
+    uint32_t first_row;
+    int has_scaler;
+    int8_t scaler;
+    uint8_t unit;
+} ingest_apdu;
+
+void csm_ingest_columns_init(csm_ingest_columns *cols, uint32_t capacity, uint32_t *meter_id, uint32_t *timestamp,
+                             int64_t *value, int8_t *scaler, uint8_t *unit)
+{
+    cols->meter_id = meter_id;
+    cols->timestamp = timestamp;
+    cols->value = value;
+    cols->scaler = scaler;
+    cols->unit = unit;
+    cols->capacity = capacity;
+    csm_ingest_columns_reset(cols);
+}
+
+void csm_ingest_columns_reset(csm_ingest_columns *cols)
+{
+    cols->rows = 0U;
+    cols->apdus = 0U;
+    cols->errors = 0U;
+    cols->overflows = 0U;
+}
+
+static int ingest_read_length(csm_array *array, uint32_t *length)
+{
+    ber_length len;
+    int valid = csm_ber_read_len(array, &len);
+    valid = valid && (len.length <= csm_array_unread(array));
+    *length = len.length;
+    return valid;
+}
+
+// Big endian integer of 'size' bytes
+static int ingest_read_integer(csm_array *array, uint32_t size, int is_signed, int64_t *value)
+{
+    uint64_t raw = 0U;
+    const uint8_t *data = csm_array_rd_data(array);
+    int valid = csm_array_reader_jump(array, size);
+
+    for (uint32_t i = 0U; valid && (i < size); i++)
+    {
+        raw = (raw << 8U) | data[i];
+    }
+    if (valid && is_signed && (size < 8U) && ((raw >> ((size * 8U) - 1U)) & 1U))
+    {
+        raw |= ~0ULL << (size * 8U);    // Sign extension
+    }
+    *value = (int64_t)raw;
+    return valid;
+}
+
+static void ingest_add_row(ingest_apdu *ctx, int64_t value)
+{
+    csm_ingest_columns *cols = ctx->cols;
+
+    if (cols->rows < cols->capacity)
+    {
+        cols->meter_id[cols->rows] = ctx->meter_id;
+        cols->timestamp[cols->rows] = 0U;
+        cols->value[cols->rows] = value;
+        cols->scaler[cols->rows] = 0;
+        cols->unit[cols->rows] = 0U;
+        cols->rows++;
+    }
+    else
+    {
+        cols->overflows++;
+    }
+}
+
+// Size of the types that are skipped, AXDR_SIZE_CODED types are handled by the caller
+static uint32_t ingest_fixed_size(uint8_t tag)
+{
+    uint32_t size;
+
+    switch (tag)
+    {
+    case AXDR_TAG_NULL:
+        size = 0U;
+        break;
+    case AXDR_TAG_BOOLEAN:
+    case AXDR_TAG_BCD:
+    case AXDR_TAG_ENUM:
+        size = 1U;
+        break;
+    case 23U:   // float32
+    case 27U:   // time
+        size = 4U;
+        break;
+    case 24U:   // float64
+        size = 8U;
+        break;
+    case 26U:   // date
+        size = 5U;
+        break;
+    case INGEST_DATETIME_TAG:
+        size = CLK_COSEM_DATETIME_SIZE;
+        break;
+    default:
+        size = 0xFFFFFFFFU;
+        break;
+    }
+    return size;
+}
+
+// A date-time in a structure: octet-string of 12 bytes or date-time type
+static int ingest_is_datetime(csm_array *array)
+{
+    const uint8_t *data = csm_array_rd_data(array);
+    uint32_t unread = csm_array_unread(array);
+
+    return ((unread >= (CLK_COSEM_DATETIME_SIZE + 2U)) && (data[0] == AXDR_TAG_OCTETSTRING) && (data[1] == CLK_COSEM_DATETIME_SIZE)) ||
+           ((unread >= (CLK_COSEM_DATETIME_SIZE + 1U)) && (data[0] == INGEST_DATETIME_TAG));
+}
+
+// structure { scaler integer, unit enum }
+static int ingest_is_scaler_unit(csm_array *array, uint32_t count)
+{
+    const uint8_t *data = csm_array_rd_data(array);
+
+    return (count == 2U) && (csm_array_unread(array) >= 4U) && (data[0] == AXDR_TAG_INTEGER8) && (data[2] == AXDR_TAG_ENUM);
+}
+
+static int ingest_walk(ingest_apdu *ctx, csm_array *array, uint32_t depth);
+
+static int ingest_structure(ingest_apdu *ctx, csm_array *array, uint32_t count, uint32_t depth)
+{
+    int valid = TRUE;
+
+    if (ingest_is_scaler_unit(array, count))
+    {
+        const uint8_t *data = csm_array_rd_data(array);
+        ctx->has_scaler = TRUE;
+        ctx->scaler = (int8_t)data[1];
+        ctx->unit = data[3];
+        valid = csm_array_reader_jump(array, 4U);
+    }
+    else
+    {
+        uint32_t first_row = ctx->cols->rows;
+        uint32_t timestamp = 0U;
+
+        for (uint32_t i = 0U; valid && (i < count); i++)
+        {
+            if (ingest_is_datetime(array))
+            {
+                const uint8_t *data = csm_array_rd_data(array);
+                uint32_t header = (data[0] == AXDR_TAG_OCTETSTRING) ? 2U : 1U;
+                uint32_t epoch;
+
+                if (clk_cosem_to_epoch_batch(&data[header], CLK_COSEM_DATETIME_SIZE, 1U, &epoch) == 1U)
+                {
+                    timestamp = epoch;
+                }
+                valid = csm_array_reader_jump(array, header + CLK_COSEM_DATETIME_SIZE);
+            }
+            else
+            {
+                valid = ingest_walk(ctx, array, depth + 1U);
+            }
+        }
+
+        // The values of the nested structures keep their own date-time
+        for (uint32_t row = first_row; row < ctx->cols->rows; row++)
+        {
+            if (ctx->cols->timestamp[row] == 0U)
+            {
+                ctx->cols->timestamp[row] = timestamp;
+            }
+        }
+    }
+    return valid;
+}
+
+static int ingest_walk(ingest_apdu *ctx, csm_array *array, uint32_t depth)
+{
+    uint8_t tag = 0U;
+    uint32_t size = 0U;
+    int64_t value = 0;
+    int valid = (depth < CSM_INGEST_MAX_DEPTH) && csm_array_read_u8(array, &tag);
+
+    if (valid)
+    {
+        switch (tag)
+        {
+        case AXDR_TAG_ARRAY:
+            valid = ingest_read_length(array, &size);
+            for (uint32_t i = 0U; valid && (i < size); i++)
+            {
+                valid = ingest_walk(ctx, array, depth + 1U);
+            }
+            break;
+        case AXDR_TAG_STRUCTURE:
+            valid = ingest_read_length(array, &size);
+            valid = valid && ingest_structure(ctx, array, size, depth);
+            break;
+        case AXDR_TAG_INTEGER8:
+        case AXDR_TAG_UNSIGNED8:
+            size = 1U;
+            break;
+        case AXDR_TAG_INTEGER16:
+        case AXDR_TAG_UNSIGNED16:
+            size = 2U;
+            break;
+        case AXDR_TAG_INTEGER32:
+        case AXDR_TAG_UNSIGNED32:
+            size = 4U;
+            break;
+        case AXDR_TAG_INTEGER64:
+        case AXDR_TAG_UNSIGNED64:
+            size = 8U;
+            break;
+        case AXDR_TAG_OCTETSTRING:
+        case AXDR_TAG_VISIBLESTRING:
+        case AXDR_TAG_UTF8_STRING:
+            valid = ingest_read_length(array, &size);
+            valid = valid && csm_array_reader_jump(array, size);
+            break;
+        case AXDR_TAG_BITSTRING:
+            valid = ingest_read_length(array, &size);
+            valid = valid && ((size == 0U) || csm_array_reader_jump(array, BITFIELD_BYTES(size)));
+            break;
+        default:
+            size = ingest_fixed_size(tag);
+            valid = (size != 0xFFFFFFFFU) && csm_array_reader_jump(array, size);
+            break;
+        }
+    }
+
+    if (valid)
+    {
+        switch (tag)
+        {
+        case AXDR_TAG_INTEGER8:
+        case AXDR_TAG_INTEGER16:
+        case AXDR_TAG_INTEGER32:
+        case AXDR_TAG_INTEGER64:
+            valid = ingest_read_integer(array, size, TRUE, &value);
+            if (valid)
+            {
+                ingest_add_row(ctx, value);
+            }
+            break;
+        case AXDR_TAG_UNSIGNED8:
+        case AXDR_TAG_UNSIGNED16:
+        case AXDR_TAG_UNSIGNED32:
+        case AXDR_TAG_UNSIGNED64:
+            valid = ingest_read_integer(array, size, FALSE, &value);
+            if (valid)
+            {
+                ingest_add_row(ctx, value);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return valid;
+}
+
+// GET.response-with-list: the decoder of the stack only supports the normal and block responses
+static int ingest_get_with_list(ingest_apdu *ctx, csm_array *array)
+{
+    uint32_t count = 0U;
+    int valid = csm_array_reader_jump(array, 3U);   // Tag, type, invoke-id-and-priority
+    valid = valid && ingest_read_length(array, &count);
+
+    for (uint32_t i = 0U; valid && (i < count); i++)
+    {
+        uint8_t choice = 0xFFU;
+        valid = csm_array_read_u8(array, &choice) && (choice == 0U);    // Data, not Data-Access-Result
+        valid = valid && ingest_walk(ctx, array, 0U);
+    }
+    return valid;
+}
+
+int csm_ingest_decode(csm_ingest_columns *cols, const csm_ingest_item *item)
+{
+    csm_array array;
+    csm_response response;
+    ingest_apdu ctx;
+    int valid = (item->size >= 2U);
+
+    ctx.cols = cols;
+    ctx.meter_id = item->meter_id;
+    ctx.first_row = cols->rows;
+    ctx.has_scaler = FALSE;
+    ctx.scaler = 0;
+    ctx.unit = 0U;
+
+    // Read only, the array API has no const version
+    csm_array_init(&array, (uint8_t *)item->apdu, item->size, item->size, 0U);
+
+    if (valid && (item->apdu[0] == INGEST_GET_RESPONSE) && (item->apdu[1] == INGEST_GET_WITH_LIST))
+    {
+        valid = ingest_get_with_list(&ctx, &array);
+    }
+    else if (valid)
+    {
+        csm_client_init(NULL, &response);
+        valid = csm_client_decode(&response, &array);
+        valid = valid && ((response.service == SVC_GET) || (response.service == SVC_ACTION));
+        valid = valid && (response.type == SVC_RESPONSE_NORMAL);
+        if (valid && (response.service == SVC_GET))
+        {
+            valid = (response.access_result == CSM_ACCESS_RESULT_SUCCESS);
+            valid = valid && ingest_walk(&ctx, &array, 0U);
+        }
+        else if (valid && response.has_data)
+        {
+            valid = ingest_walk(&ctx, &array, 0U);
+        }
+    }
+
+    if (valid)
+    {
+        if (ctx.has_scaler)
+        {
+            for (uint32_t row = ctx.first_row; row < cols->rows; row++)
+            {
+                cols->scaler[row] = ctx.scaler;
+                cols->unit[row] = ctx.unit;
+            }
+        }
+        cols->apdus++;
+    }
+    else
+    {
+        cols->rows = ctx.first_row;
+        cols->errors++;
+    }
+    return valid;
+}
+
+// ----------------------------------- POOL -----------------------------------
+
+typedef struct
+{
+    const csm_ingest_item *items;
+    uint32_t nb_items;
+    csm_ingest_columns *cols;
+} ingest_job;
+
+static void ingest_task(void *ctx, uint32_t task, uint32_t worker)
+{
+    const ingest_job *job = (const ingest_job *)ctx;
+    uint32_t first = task * CSM_INGEST_CHUNK;
+    uint32_t last = first + CSM_INGEST_CHUNK;
+
+    if (last > job->nb_items)
+    {
+        last = job->nb_items;
+    }
+    for (uint32_t i = first; i < last; i++)
+    {
+        (void) csm_ingest_decode(&job->cols[worker], &job->items[i]);
+    }
+}
+
+int csm_ingest_run(wp_pool *pool, const csm_ingest_item *items, uint32_t nb_items, csm_ingest_columns *cols)
+{
+    ingest_job job;
+
+    job.items = items;
+    job.nb_items = nb_items;
+    job.cols = cols;
+    return wp_run(pool, ingest_task, &job, (nb_items + CSM_INGEST_CHUNK - 1U) / CSM_INGEST_CHUNK);
+}
@@ -0,0 +1,83 @@
+/**
+ * Bulk decoding of response APDUs into columns, for head-end ingestion
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_INGEST_H
+#define CSM_INGEST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "work_pool.h"
+
+#define CSM_INGEST_MAX_DEPTH    8U      //!< Nesting of arrays and structures
+#define CSM_INGEST_CHUNK        64U     //!< APDUs per pool task
+
+// One raw response APDU (GET or ACTION), as received from a meter
+typedef struct
+{
+    uint32_t meter_id;
+    const uint8_t *apdu;
+    uint32_t size;
+} csm_ingest_item;
+
+/**
+ * Output batch, one row per numeric value (integer and unsigned types, 8 to 64 bits)
+ *
+ * The timestamp is the date-time found in the same structure as the value (profile buffer entry),
+ * in epoch seconds, 0 if none. Scaler and unit come from a scaler_unit structure found in the same
+ * APDU (GET with list of the value and scaler_unit attributes), 0 if none.
+ * The arrays are allocated by the caller, each one holds 'capacity' elements.
+ */
+typedef struct
+{
+    uint32_t *meter_id;
+    uint32_t *timestamp;
+    int64_t *value;
+    int8_t *scaler;
+    uint8_t *unit;
+    uint32_t capacity;
+
+    uint32_t rows;
+    uint32_t apdus;         //!< APDUs decoded
+    uint32_t errors;        //!< APDUs rejected: bad encoding, data access error, block transfer, exception
+    uint32_t overflows;     //!< Values lost, batch full
+} csm_ingest_columns;
+
+void csm_ingest_columns_init(csm_ingest_columns *cols, uint32_t capacity, uint32_t *meter_id, uint32_t *timestamp,
+                             int64_t *value, int8_t *scaler, uint8_t *unit);
+
+// Empty the batch, the counters included
+void csm_ingest_columns_reset(csm_ingest_columns *cols);
+
+/**
+ * @brief Decode one APDU into the batch (reentrant)
+ *
+ * The rows of a rejected APDU are removed.
+ * @return TRUE if the APDU is decoded
+ */
+int csm_ingest_decode(csm_ingest_columns *cols, const csm_ingest_item *item);
+
+/**
+ * @brief Decode a batch of APDUs on a pool of threads
+ *
+ * Each worker fills its own batch: 'cols' has one entry per worker of the pool, the rows of an APDU
+ * are in the batch of the worker that decoded it. Batches are not reset.
+ * @return FALSE if the pool cannot take the batch (see wp_run())
+ */
+int csm_ingest_run(wp_pool *pool, const csm_ingest_item *items, uint32_t nb_items, csm_ingest_columns *cols);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_INGEST_H
@@ -0,0 +1,241 @@
+/**
+ * Stack metrics: per-service counters and latency histograms
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "csm_metrics.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+
+typedef struct
+{
+    volatile uint32_t counters[CSM_METRIC_NB];
+    volatile uint32_t latency[CSM_LATENCY_NB][CSM_METRICS_HIST_BUCKETS];
+} csm_metrics_shard;
+
+// Each shard is padded to a multiple of the cache line size to avoid false sharing between threads
+typedef union
+{
+    csm_metrics_shard shard;
+    uint8_t padding[((sizeof(csm_metrics_shard) + CSM_CACHE_LINE_SIZE - 1U) / CSM_CACHE_LINE_SIZE) * CSM_CACHE_LINE_SIZE];
+} csm_metrics_slot;
+
+// One shard per thread, the last one is shared by the threads beyond CSM_METRICS_SHARDS
+static CSM_ALIGNED(CSM_CACHE_LINE_SIZE) csm_metrics_slot metrics_slots[CSM_METRICS_SHARDS + 1U];
+static csm_metrics_clock metrics_clock = NULL;
+static volatile uint32_t metrics_next_shard = 0U;
+static CSM_THREAD_LOCAL csm_metrics_shard *current_shard = NULL;
+static CSM_THREAD_LOCAL int current_shared = FALSE;
+
+void csm_metrics_init(csm_metrics_clock clock)
+{
+    memset(metrics_slots, 0, sizeof(metrics_slots));
+    metrics_clock = clock;
+}
+
+static csm_metrics_shard *metrics_get_shard(void)
+{
+    csm_metrics_shard *shard = current_shard;
+
+    if (shard == NULL)
+    {
+        // First use by this thread, take the next free shard
+#if defined(__GNUC__)
+        uint32_t index = __sync_fetch_and_add(&metrics_next_shard, 1U);
+#else
+        uint32_t index = metrics_next_shard++;
+#endif
+        if (index < CSM_METRICS_SHARDS)
+        {
+            shard = &metrics_slots[index].shard;
+        }
+        else
+        {
+            shard = &metrics_slots[CSM_METRICS_SHARDS].shard;
+            current_shared = TRUE;
+        }
+        current_shard = shard;
+    }
+    return shard;
+}
+
+// A private shard has a single writer; the shared one needs atomic increments
+static void metrics_add(volatile uint32_t *counter)
+{
+    if (current_shared)
+    {
+#if defined(__GNUC__)
+        (void) __sync_fetch_and_add(counter, 1U);
+#else
+        (*counter)++;
+#endif
+    }
+    else
+    {
+        (*counter)++;
+    }
+}
+
+void csm_metrics_inc(csm_metric_id id)
+{
+    if (id < CSM_METRIC_NB)
+    {
+        csm_metrics_shard *shard = metrics_get_shard();
+        metrics_add(&shard->counters[id]);
+    }
+}
+
+uint32_t csm_metrics_now(void)
+{
+    return (metrics_clock != NULL) ? metrics_clock() : 0U;
+}
+
+static uint32_t metrics_msb(uint32_t value)
+{
+#if defined(__GNUC__)
+    return 31U - (uint32_t)__builtin_clz(value);
+#else
+    uint32_t msb = 0U;
+    while (value >>= 1U)
+    {
+        msb++;
+    }
+    return msb;
+#endif
+}
+
+uint32_t csm_metrics_bucket_index(uint32_t value)
+{
+    uint32_t index = value;
+
+    if (value >= 16U)
+    {
+        uint32_t msb = metrics_msb(value);
+        uint32_t sub = (value >> (msb - CSM_METRICS_SUB_BITS)) & ((1U << CSM_METRICS_SUB_BITS) - 1U);
+        index = 16U + ((msb - 4U) << CSM_METRICS_SUB_BITS) + sub;
+    }
+    return index;
+}
+
+// Return the highest value stored in the bucket
+uint32_t csm_metrics_bucket_value(uint32_t index)
+{
+    uint32_t value = index;
+
+    if (index >= 16U)
+    {
+        uint32_t msb = ((index - 16U) >> CSM_METRICS_SUB_BITS) + 4U;
+        uint32_t sub = (index - 16U) & ((1U << CSM_METRICS_SUB_BITS) - 1U);
+        uint32_t shift = msb - CSM_METRICS_SUB_BITS;
+        uint64_t upper = ((uint64_t)((1U << CSM_METRICS_SUB_BITS) + sub + 1U) << shift) - 1U;
+        value = (upper > 0xFFFFFFFFU) ? 0xFFFFFFFFU : (uint32_t)upper;
+    }
+    return value;
+}
+
+void csm_metrics_record_latency(csm_latency_id id, uint32_t ns)
+{
+    if ((metrics_clock != NULL) && (id < CSM_LATENCY_NB))
+    {
+        csm_metrics_shard *shard = metrics_get_shard();
+        metrics_add(&shard->latency[id][csm_metrics_bucket_index(ns)]);
+    }
+}
+
+void csm_metrics_get_snapshot(csm_metrics_snapshot *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+
+    for (uint32_t s = 0U; s <= CSM_METRICS_SHARDS; s++)
+    {
+        const csm_metrics_shard *shard = &metrics_slots[s].shard;
+
+        for (uint32_t i = 0U; i < CSM_METRIC_NB; i++)
+        {
+            snap->counters[i] += shard->counters[i];
+        }
+
+        for (uint32_t i = 0U; i < CSM_LATENCY_NB; i++)
+        {
+            for (uint32_t b = 0U; b < CSM_METRICS_HIST_BUCKETS; b++)
+            {
+                snap->latency[i][b] += shard->latency[i][b];
+            }
+        }
+    }
+}
+
+static uint32_t metrics_count(const uint32_t *histogram)
+{
+    uint32_t count = 0U;
+    for (uint32_t b = 0U; b < CSM_METRICS_HIST_BUCKETS; b++)
+    {
+        count += histogram[b];
+    }
+    return count;
+}
+
+uint32_t csm_metrics_percentile(const uint32_t *histogram, uint32_t per_mille)
+{
+    uint32_t value = 0U;
+    uint32_t count = metrics_count(histogram);
+
+    if (count > 0U)
+    {
+        // Rank of the sample, rounded up
+        uint64_t rank = (((uint64_t)count * per_mille) + 999U) / 1000U;
+        uint64_t cumul = 0U;
+
+        if (rank == 0U)
+        {
+            rank = 1U;
+        }
+
+        for (uint32_t b = 0U; b < CSM_METRICS_HIST_BUCKETS; b++)
+        {
+            cumul += histogram[b];
+            if (cumul >= rank)
+            {
+                value = csm_metrics_bucket_value(b);
+                break;
+            }
+        }
+    }
+    return value;
+}
+
+int csm_metrics_encode(csm_array *array, const csm_metrics_snapshot *snap)
+{
+    int valid = csm_array_write_u8(array, AXDR_TAG_STRUCTURE);
+    valid = valid && csm_ber_write_len(array, 2U);
+
+    // 1. counters
+    valid = valid && csm_array_write_u8(array, AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_write_len(array, CSM_METRIC_NB);
+    for (uint32_t i = 0U; i < CSM_METRIC_NB; i++)
+    {
+        valid = valid && csm_axdr_wr_u32(array, snap->counters[i]);
+    }
+
+    // 2. latencies
+    valid = valid && csm_array_write_u8(array, AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_write_len(array, CSM_LATENCY_NB);
+    for (uint32_t i = 0U; i < CSM_LATENCY_NB; i++)
+    {
+        valid = valid && csm_array_write_u8(array, AXDR_TAG_STRUCTURE);
+        valid = valid && csm_ber_write_len(array, 4U);
+        valid = valid && csm_axdr_wr_u32(array, metrics_count(snap->latency[i]));
+        valid = valid && csm_axdr_wr_u32(array, csm_metrics_percentile(snap->latency[i], 500U));
+        valid = valid && csm_axdr_wr_u32(array, csm_metrics_percentile(snap->latency[i], 990U));
+        valid = valid && csm_axdr_wr_u32(array, csm_metrics_percentile(snap->latency[i], 1000U));
+    }
+
+    return valid;
+}
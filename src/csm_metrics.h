@@ -0,0 +1,108 @@
+/**
+ * Stack metrics: per-service counters and latency histograms
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_METRICS_H
+#define CSM_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_config.h"
+#include "csm_array.h"
+
+// Number of private shards: each of the first threads updates its own shard without atomic operation,
+// the next threads share one more shard with atomic increments
+#ifndef CSM_METRICS_SHARDS
+#define CSM_METRICS_SHARDS      4U
+#endif
+
+// Log-linear histogram: 16 exact buckets, then 8 sub-buckets per power of two (12.5% precision)
+#define CSM_METRICS_SUB_BITS        3U
+#define CSM_METRICS_HIST_BUCKETS    (16U + ((32U - 4U) * 8U))
+
+typedef enum
+{
+    CSM_METRIC_GET,
+    CSM_METRIC_SET,
+    CSM_METRIC_ACTION,
+    CSM_METRIC_EXCEPTION,
+    CSM_METRIC_ASSO_ACCEPTED,
+    CSM_METRIC_ASSO_REJECTED,
+    CSM_METRIC_SEC_FAILURE,
+    CSM_METRIC_HDLC_FRAMES,
+    CSM_METRIC_HDLC_FCS_ERROR,
+    CSM_METRIC_HDLC_HCS_ERROR,
+    CSM_METRIC_NB
+} csm_metric_id;
+
+typedef enum
+{
+    CSM_LATENCY_CHANNEL,    //!< csm_channel_execute(), whole APDU processing
+    CSM_LATENCY_SERVICES,   //!< csm_server_services_execute(), including the database access
+    CSM_LATENCY_SECURITY,   //!< csm_sec_auth_decrypt()
+    CSM_LATENCY_NB
+} csm_latency_id;
+
+typedef struct
+{
+    uint32_t counters[CSM_METRIC_NB];
+    uint32_t latency[CSM_LATENCY_NB][CSM_METRICS_HIST_BUCKETS];
+} csm_metrics_snapshot;
+
+/**
+ * @brief Monotonic clock, in nanoseconds (wrapping is allowed)
+ */
+typedef uint32_t (*csm_metrics_clock)(void);
+
+// Clear all the counters; without clock, the latency histograms are not updated
+void csm_metrics_init(csm_metrics_clock clock);
+
+void csm_metrics_inc(csm_metric_id id);
+uint32_t csm_metrics_now(void);
+void csm_metrics_record_latency(csm_latency_id id, uint32_t ns);
+
+// Sum all the shards, can be called from any thread without stopping the producers
+void csm_metrics_get_snapshot(csm_metrics_snapshot *snap);
+
+uint32_t csm_metrics_bucket_index(uint32_t value);
+uint32_t csm_metrics_bucket_value(uint32_t index);
+
+// Return the value below which per_mille of the samples fall (eg: 990 for the 99th percentile)
+uint32_t csm_metrics_percentile(const uint32_t *histogram, uint32_t per_mille);
+
+/**
+ * @brief Encode a snapshot as a Cosem Data value, to be returned by the database handler
+ *
+ * structure
+ * {
+ *     counters: array of double-long-unsigned (in csm_metric_id order),
+ *     latencies: array of structure { count, p50, p99, max } (double-long-unsigned, in nanoseconds)
+ * }
+ */
+int csm_metrics_encode(csm_array *array, const csm_metrics_snapshot *snap);
+
+#if CSM_METRICS_ENABLED
+#define CSM_METRICS_INC(id)             csm_metrics_inc(id)
+#define CSM_METRICS_START(var)          uint32_t var = csm_metrics_now()
+#define CSM_METRICS_STOP(id, var)       csm_metrics_record_latency(id, csm_metrics_now() - (var))
+#else
+#define CSM_METRICS_INC(id)             do { } while (0)
+#define CSM_METRICS_START(var)
+#define CSM_METRICS_STOP(id, var)       do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_METRICS_H
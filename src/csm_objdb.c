@@ -0,0 +1,210 @@
+/**
+ * Read-only object database image: object list, access rights and pre-encoded values
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "csm_objdb.h"
+
+typedef struct
+{
+    const csm_objdb_header *header;
+    const csm_objdb_object *objects;
+    const csm_objdb_member *members;
+    const uint8_t *values;
+    const csm_db_access_handler *handlers;
+    uint8_t nb_handlers;
+} csm_objdb;
+
+static csm_objdb objdb;
+
+int csm_objdb_load(const uint8_t *image, uint32_t size, const csm_db_access_handler *handlers, uint8_t nb_handlers)
+{
+    const csm_objdb_header *header = (const csm_objdb_header *)image;
+    int valid = (image != NULL) && (size >= sizeof(csm_objdb_header)) && ((((uintptr_t)image) & 3U) == 0U);
+
+    memset(&objdb, 0, sizeof(objdb));
+
+    valid = valid && (header->magic == CSM_OBJDB_MAGIC) && (header->version == CSM_OBJDB_VERSION);
+    valid = valid && (header->header_size == sizeof(csm_objdb_header));
+    valid = valid && (header->object_size == sizeof(csm_objdb_object)) && (header->member_size == sizeof(csm_objdb_member));
+
+    // 64-bit arithmetic: the counters come from the image
+    valid = valid && (((uint64_t)sizeof(csm_objdb_header) + ((uint64_t)header->nb_objects * sizeof(csm_objdb_object)) +
+                       ((uint64_t)header->nb_members * sizeof(csm_objdb_member)) + header->values_size) <= size);
+
+    if (valid)
+    {
+        objdb.header = header;
+        objdb.objects = (const csm_objdb_object *)&image[sizeof(csm_objdb_header)];
+        objdb.members = (const csm_objdb_member *)&objdb.objects[header->nb_objects];
+        objdb.values = (const uint8_t *)&objdb.members[header->nb_members];
+        objdb.handlers = handlers;
+        objdb.nb_handlers = nb_handlers;
+        CSM_LOG("[OBJDB] %u objects, %u members", header->nb_objects, header->nb_members);
+    }
+    else
+    {
+        CSM_ERR("[OBJDB] Invalid image");
+    }
+    return valid;
+}
+
+int csm_objdb_verify(void)
+{
+    int valid = (objdb.header != NULL);
+
+    if (valid)
+    {
+        const uint8_t *data = (const uint8_t *)objdb.objects;
+        uint32_t size = (objdb.header->nb_objects * (uint32_t)sizeof(csm_objdb_object)) +
+                        (objdb.header->nb_members * (uint32_t)sizeof(csm_objdb_member)) + objdb.header->values_size;
+        uint32_t hash = 2166136261U;
+
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            hash = (hash ^ data[i]) * 16777619U;
+        }
+        valid = (hash == objdb.header->checksum);
+    }
+    return valid;
+}
+
+static int objdb_compare(const csm_objdb_object *object, uint16_t class_id, const csm_obis_code *obis)
+{
+    int diff = (int)object->class_id - (int)class_id;
+
+    if (diff == 0)
+    {
+        const uint8_t key[6] = { obis->A, obis->B, obis->C, obis->D, obis->E, obis->F };
+        diff = memcmp(object->obis, key, sizeof(key));
+    }
+    return diff;
+}
+
+const csm_objdb_object *csm_objdb_find(uint16_t class_id, const csm_obis_code *obis)
+{
+    const csm_objdb_object *found = NULL;
+
+    if (objdb.header != NULL)
+    {
+        uint32_t low = 0U;
+        uint32_t high = objdb.header->nb_objects;
+
+        while (low < high)
+        {
+            uint32_t mid = low + ((high - low) / 2U);
+            int diff = objdb_compare(&objdb.objects[mid], class_id, obis);
+
+            if (diff == 0)
+            {
+                found = &objdb.objects[mid];
+                break;
+            }
+            else if (diff < 0)
+            {
+                low = mid + 1U;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+    }
+    return found;
+}
+
+static const csm_objdb_member *objdb_member(const csm_objdb_object *object, enum csm_service service, int8_t id)
+{
+    const csm_objdb_member *found = NULL;
+    uint64_t first = object->first_member;    // 64-bit: the offsets come from the image
+    uint32_t count = object->nb_attributes;
+
+    if (service == SVC_ACTION)
+    {
+        first += object->nb_attributes;
+        count = object->nb_methods;
+    }
+
+    if ((first + count) <= objdb.header->nb_members)
+    {
+        for (uint32_t i = 0U; i < count; i++)
+        {
+            if (objdb.members[first + i].id == id)
+            {
+                found = &objdb.members[first + i];
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+static uint8_t objdb_client_mask(uint16_t ssap)
+{
+    uint8_t mask = 0U;
+
+    for (uint32_t i = 0U; i < CSM_OBJDB_MAX_CLIENTS; i++)
+    {
+        if ((objdb.header->clients[i] != 0U) && (objdb.header->clients[i] == ssap))
+        {
+            mask = (uint8_t)(1U << i);
+            break;
+        }
+    }
+    return mask;
+}
+
+csm_db_code csm_objdb_access(csm_array *in, csm_array *out, csm_request *request)
+{
+    csm_db_code code = CSM_ERR_OBJECT_NOT_FOUND;
+    const csm_object_t *obj = &request->db_request.logical_name;
+    const csm_objdb_object *object = csm_objdb_find(obj->class_id, &obj->obis);
+    const csm_objdb_member *member = NULL;
+
+    if (object != NULL)
+    {
+        member = objdb_member(object, request->db_request.service, obj->id);
+    }
+
+    if (member != NULL)
+    {
+        uint8_t client = objdb_client_mask(request->llc.ssap);
+        uint8_t rights = (request->db_request.service == SVC_SET) ? member->write_mask : member->read_mask;
+
+        if ((rights & client) == 0U)
+        {
+            code = CSM_ERR_UNAUTHORIZED_ACCESS;
+        }
+        else if (member->handler == CSM_OBJDB_STATIC)
+        {
+            // Only readable: the compiler refuses write rights on a static member
+            if ((request->db_request.service == SVC_GET) &&
+                (((uint64_t)member->value_offset + member->value_size) <= objdb.header->values_size) &&
+                csm_array_write_buff(out, &objdb.values[member->value_offset], member->value_size))
+            {
+                code = CSM_OK;
+            }
+            else
+            {
+                code = CSM_ERR_OBJECT_ERROR;
+            }
+        }
+        else if ((member->handler < objdb.nb_handlers) && (objdb.handlers[member->handler] != NULL))
+        {
+            code = objdb.handlers[member->handler](in, out, request);
+        }
+        else
+        {
+            CSM_ERR("[OBJDB] No handler %u", member->handler);
+            code = CSM_ERR_OBJECT_ERROR;
+        }
+    }
+    return code;
+}
@@ -0,0 +1,99 @@
+/**
+ * Read-only object database image: object list, access rights and pre-encoded values
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_OBJDB_H
+#define CSM_OBJDB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "csm_services.h"
+
+#define CSM_OBJDB_MAGIC         0x444D5343U     // "CSMD" on little endian hosts
+#define CSM_OBJDB_VERSION       1U
+#define CSM_OBJDB_MAX_CLIENTS   8U              //!< One access right bit per client SAP
+#define CSM_OBJDB_STATIC        0xFFU           //!< Member served from the image, no handler
+
+/**
+ * The image is produced at build time by the objdb compiler and used in place (mapped file, flash):
+ * there is no pointer inside, only offsets, and the loading only checks the header.
+ *
+ *     header | nb_objects x csm_objdb_object | nb_members x csm_objdb_member | values
+ *
+ * Objects are sorted by class and logical name, the members of an object are consecutive (attributes
+ * then methods, sorted by id). The host byte order is used: a host of the other endianness does not
+ * recognize the magic.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t object_size;
+    uint16_t member_size;
+    uint32_t nb_objects;
+    uint32_t nb_members;
+    uint32_t values_size;
+    uint32_t checksum;                          //!< FNV-1a of everything after the header
+    uint16_t clients[CSM_OBJDB_MAX_CLIENTS];    //!< Client SAP of each access right bit, 0 if unused
+} csm_objdb_header;
+
+typedef struct
+{
+    uint16_t class_id;
+    uint8_t version;
+    uint8_t nb_attributes;
+    uint8_t obis[6];
+    uint8_t nb_methods;
+    uint8_t reserved;
+    uint32_t first_member;
+} csm_objdb_object;
+
+typedef struct
+{
+    int8_t id;
+    uint8_t read_mask;      //!< Methods: execute rights
+    uint8_t write_mask;
+    uint8_t handler;        //!< Index in the handler table, CSM_OBJDB_STATIC for a pre-encoded value
+    uint32_t value_offset;  //!< In the values area, A-XDR encoded
+    uint32_t value_size;
+} csm_objdb_member;
+
+/**
+ * @brief Use an image as the object database
+ *
+ * Only the header and the area sizes are checked (constant time); the bounds of each member are
+ * checked on access. csm_objdb_verify() checks the content.
+ * @param handlers: database access of the dynamic members, the image stores their index
+ * @return TRUE if the image is accepted
+ */
+int csm_objdb_load(const uint8_t *image, uint32_t size, const csm_db_access_handler *handlers, uint8_t nb_handlers);
+
+// Checksum of the loaded image
+int csm_objdb_verify(void);
+
+// Binary search in the object list, NULL if not found
+const csm_objdb_object *csm_objdb_find(uint16_t class_id, const csm_obis_code *obis);
+
+/**
+ * @brief Database access handler over the loaded image, to give to csm_services_init()
+ *
+ * Checks the existence and the access rights of the client, serves the static members and dispatches
+ * the others to their handler.
+ */
+csm_db_code csm_objdb_access(csm_array *in, csm_array *out, csm_request *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_OBJDB_H
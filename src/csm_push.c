@@ -0,0 +1,337 @@
+/**
+ * Data-Notification encoder and Push Setup engine
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "csm_push.h"
+#include "csm_axdr_codec.h"
+#include "os_util.h"
+#include "calendar.h"
+
+#define PUSH_HIGH_PRIORITY      0x80000000U
+#define PUSH_INVOKE_ID_MASK     0x00FFFFFFU
+#define PUSH_TAG_SIZE           12U
+
+typedef struct
+{
+    uint8_t used;
+    uint8_t setup;
+    uint8_t retries;        //!< Remaining attempts after the next one
+    uint32_t due;
+} csm_push_entry;
+
+static const csm_push_setup *push_setups = NULL;
+static uint8_t push_nb_setups;
+static csm_db_access_handler push_database = NULL;
+static csm_push_send_handler push_send = NULL;
+
+static csm_push_entry push_queue[CSM_PUSH_QUEUE_SIZE];
+static uint32_t push_ic[CSM_PUSH_MAX_SETUPS];
+static uint32_t push_invoke_id;
+
+void csm_push_init(const csm_push_setup *setups, uint8_t nb_setups, csm_db_access_handler db_access, csm_push_send_handler send)
+{
+    push_setups = setups;
+    push_nb_setups = (nb_setups < CSM_PUSH_MAX_SETUPS) ? nb_setups : CSM_PUSH_MAX_SETUPS;
+    push_database = db_access;
+    push_send = send;
+    push_invoke_id = 0U;
+
+    memset(push_queue, 0, sizeof(push_queue));
+    memset(push_ic, 0, sizeof(push_ic));
+}
+
+// The setups of the same logical device (server SAP) cipher with the same key, so they share the
+// invocation counter of the first of them: a counter value is never used twice with a key
+static uint8_t push_ic_owner(uint8_t setup)
+{
+    uint8_t owner = 0U;
+
+    while ((owner < setup) && (push_setups[owner].llc.dsap != push_setups[setup].llc.dsap))
+    {
+        owner++;
+    }
+    return owner;
+}
+
+void csm_push_set_invocation_counter(uint8_t setup, uint32_t ic)
+{
+    if (setup < push_nb_setups)
+    {
+        push_ic[push_ic_owner(setup)] = ic;
+    }
+}
+
+int csm_push_trigger(uint8_t setup, uint32_t now)
+{
+    int ret = FALSE;
+    uint32_t free_slot = CSM_PUSH_QUEUE_SIZE;
+
+    if ((push_setups != NULL) && (setup < push_nb_setups))
+    {
+        for (uint32_t i = 0U; i < CSM_PUSH_QUEUE_SIZE; i++)
+        {
+            if (!push_queue[i].used)
+            {
+                free_slot = (free_slot == CSM_PUSH_QUEUE_SIZE) ? i : free_slot;
+            }
+            else if (push_queue[i].setup == setup)
+            {
+                // Already pending: the values are read when the notification is built
+                free_slot = i;
+                ret = TRUE;
+                break;
+            }
+        }
+
+        if (!ret && (free_slot < CSM_PUSH_QUEUE_SIZE))
+        {
+            push_queue[free_slot].used = TRUE;
+            push_queue[free_slot].setup = setup;
+            push_queue[free_slot].retries = push_setups[setup].nb_retries;
+            push_queue[free_slot].due = now + cal_jitter_offset(csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE,
+                                                                push_setups[setup].randomisation_start_interval);
+            ret = TRUE;
+        }
+        else if (!ret)
+        {
+            CSM_ERR("[PUSH] Queue full");
+        }
+    }
+    return ret;
+}
+
+uint32_t csm_push_pending(void)
+{
+    uint32_t nb = 0U;
+    for (uint32_t i = 0U; i < CSM_PUSH_QUEUE_SIZE; i++)
+    {
+        nb += push_queue[i].used;
+    }
+    return nb;
+}
+
+int csm_push_encode_notification(csm_array *array, uint32_t invoke_id, int high_priority, const uint8_t *date_time)
+{
+    uint32_t long_invoke_id = (invoke_id & PUSH_INVOKE_ID_MASK) | (high_priority ? PUSH_HIGH_PRIORITY : 0U);
+
+    int valid = csm_array_write_u8(array, AXDR_DATA_NOTIFICATION);
+    valid = valid && csm_array_write_u32(array, long_invoke_id);
+
+    if (date_time != NULL)
+    {
+        valid = valid && csm_array_write_u8(array, 12U);
+        valid = valid && csm_array_write_buff(array, date_time, 12U);
+    }
+    else
+    {
+        valid = valid && csm_array_write_u8(array, 0U);
+    }
+    return valid;
+}
+
+// Same destination and same security context: the notification is ciphered once, with the key,
+// GCM context and invocation counter of the first setup of the group
+static int push_same_group(const csm_push_setup *a, const csm_push_setup *b)
+{
+    return (a->destination.transport == b->destination.transport) &&
+           (a->destination.size == b->destination.size) &&
+           (memcmp(a->destination.address, b->destination.address, a->destination.size) == 0) &&
+           (a->sc.sh_byte == b->sc.sh_byte) && (a->gcm_channel == b->gcm_channel) &&
+           (a->llc.ssap == b->llc.ssap) && (a->llc.dsap == b->llc.dsap);
+}
+
+// structure { value of each object of the push_object_list }, null-data for an object that cannot be read
+static int push_encode_body(const csm_push_setup *setup, csm_array *array)
+{
+    csm_request request;
+
+    memset(&request, 0, sizeof(request));
+    request.llc = setup->llc;
+    request.db_request.service = SVC_GET;
+
+    int valid = csm_array_write_u8(array, AXDR_TAG_STRUCTURE);
+    valid = valid && csm_array_write_u8(array, setup->nb_objects);
+
+    for (uint32_t i = 0U; (i < setup->nb_objects) && valid; i++)
+    {
+        uint32_t wr_index = array->wr_index;
+        request.db_request.logical_name = setup->objects[i];
+
+        if (push_database(array, array, &request) != CSM_OK)
+        {
+            CSM_ERR("[PUSH] Cannot read object %d", (int)i);
+            array->wr_index = wr_index;
+            valid = csm_array_write_u8(array, AXDR_TAG_NULL);
+        }
+    }
+    return valid;
+}
+
+// Protect the Data-Notification in place and prepend the general-glo-ciphering header, returns the APDU start
+static uint8_t *push_cipher(uint8_t setup, csm_array *array, uint32_t *size)
+{
+    uint8_t *apdu = NULL;
+    csm_request request;
+    uint32_t ic = push_ic[push_ic_owner(setup)]++;
+
+    memset(&request, 0, sizeof(request));
+    request.llc = push_setups[setup].llc;
+    request.channel_id = push_setups[setup].gcm_channel;
+
+    if ((csm_array_written(array) + PUSH_TAG_SIZE) > array->size)
+    {
+        CSM_ERR("[PUSH] No room for the authentication tag");
+    }
+    else if (csm_sec_auth_encrypt(array, &request, csm_sys_get_system_title(), push_setups[setup].sc, ic) == CSM_SEC_OK)
+    {
+        // ciphered-content: SC || IC || information || T
+        uint32_t content = CSM_DEF_SEC_HDR_SIZE + array->wr_index;
+        uint8_t *p = &array->buff[array->offset - CSM_DEF_SEC_HDR_SIZE];
+
+        p[0] = push_setups[setup].sc.sh_byte;
+        PUT_BE32(&p[1], ic);
+
+        if (content > 255U)
+        {
+            p -= 3U;
+            p[0] = 0x82U;
+            PUT_BE16(&p[1], (uint16_t)content);
+        }
+        else if (content > 127U)
+        {
+            p -= 2U;
+            p[0] = 0x81U;
+            p[1] = (uint8_t)content;
+        }
+        else
+        {
+            p -= 1U;
+            p[0] = (uint8_t)content;
+        }
+
+        p -= CSM_DEF_APP_TITLE_SIZE + 2U;
+        p[0] = AXDR_GENERAL_GLO_CIPHERING;
+        p[1] = CSM_DEF_APP_TITLE_SIZE;
+        memcpy(&p[2], csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE);
+
+        apdu = p;
+        *size = (uint32_t)(&array->buff[array->offset] - p) + array->wr_index;
+    }
+    else
+    {
+        CSM_ERR("[PUSH] Ciphering failure");
+    }
+    return apdu;
+}
+
+// Build and send the Data-Notification of the pushes marked in the group, returns TRUE if sent
+static int push_send_group(const uint8_t *group, uint32_t nb_group, uint8_t *buffer, uint32_t size)
+{
+    csm_array array;
+    uint8_t first = CSM_PUSH_QUEUE_SIZE;
+    int sent = FALSE;
+
+    csm_array_init(&array, buffer, size, 0U, CSM_PUSH_HEADROOM);
+
+    int valid = csm_push_encode_notification(&array, push_invoke_id++, FALSE, NULL);
+    if (nb_group > 1U)
+    {
+        valid = valid && csm_array_write_u8(&array, AXDR_TAG_STRUCTURE);
+        valid = valid && csm_array_write_u8(&array, (uint8_t)nb_group);
+    }
+
+    for (uint32_t i = 0U; (i < CSM_PUSH_QUEUE_SIZE) && valid; i++)
+    {
+        if (group[i])
+        {
+            first = (first == CSM_PUSH_QUEUE_SIZE) ? (uint8_t)i : first;
+            valid = push_encode_body(&push_setups[push_queue[i].setup], &array);
+        }
+    }
+
+    if (valid)
+    {
+        uint8_t setup = push_queue[first].setup;
+        uint8_t *apdu = csm_array_rd_data(&array);
+        uint32_t apdu_size = array.wr_index;
+
+        if (push_setups[setup].sc.sh_bit_field.authentication || push_setups[setup].sc.sh_bit_field.encryption)
+        {
+            apdu = push_cipher(setup, &array, &apdu_size);
+        }
+
+        sent = (apdu != NULL) && push_send(&push_setups[setup], apdu, apdu_size);
+    }
+    else
+    {
+        CSM_ERR("[PUSH] Notification too large for the buffer");
+    }
+    return sent;
+}
+
+uint32_t csm_push_process(uint32_t now, uint8_t *buffer, uint32_t size)
+{
+    uint32_t nb_sent = 0U;
+    uint8_t group[CSM_PUSH_QUEUE_SIZE];
+    int found = (push_setups != NULL) && (push_database != NULL) && (push_send != NULL) && (size > CSM_PUSH_HEADROOM);
+
+    while (found)
+    {
+        uint32_t first = CSM_PUSH_QUEUE_SIZE;
+        uint32_t nb_group = 0U;
+
+        // Comparisons are done on the difference to allow the wrapping of the application time
+        for (uint32_t i = 0U; i < CSM_PUSH_QUEUE_SIZE; i++)
+        {
+            group[i] = FALSE;
+            if (push_queue[i].used && ((int32_t)(now - push_queue[i].due) >= 0))
+            {
+                first = (first == CSM_PUSH_QUEUE_SIZE) ? i : first;
+                if (push_same_group(&push_setups[push_queue[first].setup], &push_setups[push_queue[i].setup]))
+                {
+                    group[i] = TRUE;
+                    nb_group++;
+                }
+            }
+        }
+
+        found = (first < CSM_PUSH_QUEUE_SIZE);
+        if (found)
+        {
+            int sent = push_send_group(group, nb_group, buffer, size);
+            nb_sent += sent ? 1U : 0U;
+
+            for (uint32_t i = 0U; i < CSM_PUSH_QUEUE_SIZE; i++)
+            {
+                if (!group[i])
+                {
+                    continue;
+                }
+
+                if (sent || (push_queue[i].retries == 0U))
+                {
+                    if (!sent)
+                    {
+                        CSM_ERR("[PUSH] Push %d dropped after retries", push_queue[i].setup);
+                    }
+                    push_queue[i].used = FALSE;
+                }
+                else
+                {
+                    const csm_push_setup *setup = &push_setups[push_queue[i].setup];
+                    push_queue[i].retries--;
+                    push_queue[i].due = now + ((setup->repetition_delay > 0U) ? setup->repetition_delay : 1U);
+                }
+            }
+        }
+    }
+    return nb_sent;
+}
@@ -0,0 +1,122 @@
+/**
+ * Data-Notification encoder and Push Setup engine
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_PUSH_H
+#define CSM_PUSH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "csm_services.h"
+#include "csm_security.h"
+
+#define CSM_PUSH_MAX_SETUPS     4U
+#define CSM_PUSH_MAX_OBJECTS    8U      //!< Size of the push_object_list
+#define CSM_PUSH_QUEUE_SIZE     8U      //!< Pending pushes
+#define CSM_PUSH_MAX_DEST_SIZE  32U
+
+// Free space before the Data-Notification, used by the general-glo-ciphering header and the AAD
+#define CSM_PUSH_HEADROOM       32U
+
+// transport_service of the send_destination_and_method attribute (Blue Book, Push setup)
+enum csm_push_transport
+{
+    CSM_PUSH_TCP    = 0U,
+    CSM_PUSH_UDP    = 1U,
+    CSM_PUSH_SMS    = 4U,
+    CSM_PUSH_HDLC   = 5U
+};
+
+typedef struct
+{
+    uint8_t transport;  //!< enum csm_push_transport
+    uint8_t size;
+    uint8_t address[CSM_PUSH_MAX_DEST_SIZE];   //!< eg: "192.168.1.10:4059", interpreted by the send handler
+} csm_push_destination;
+
+/**
+ * @brief Push Setup object (class 40), configuration part
+ *
+ * The values of the push_object_list are read through the database, as a GET would do, with the
+ * association defined by llc. When sc has the authentication and/or encryption bits set, the
+ * notification is protected with csm_sec_auth_encrypt() and sent as general-glo-ciphering.
+ */
+typedef struct
+{
+    csm_object_t objects[CSM_PUSH_MAX_OBJECTS];
+    uint8_t nb_objects;
+    csm_push_destination destination;
+    uint8_t nb_retries;
+    uint16_t repetition_delay;      //!< In seconds, between two attempts
+    uint16_t randomisation_start_interval;  //!< In seconds, the first attempt is delayed by a per-device offset
+    csm_llc llc;
+    csm_sec_control_byte sc;
+    uint8_t gcm_channel;            //!< Context passed to csm_sys_gcm_init()
+} csm_push_setup;
+
+/**
+ * @brief Send one APDU to the destination of the setup, the transport framing is up to the application
+ *
+ * The setup gives the destination and the addresses of the logical device (llc) for the framing.
+ * See tcp_push_send() in share/ip for the TCP wrapper.
+ * @return TRUE if the APDU is sent
+ */
+typedef int (*csm_push_send_handler)(const csm_push_setup *setup, const uint8_t *apdu, uint32_t size);
+
+void csm_push_init(const csm_push_setup *setups, uint8_t nb_setups, csm_db_access_handler db_access, csm_push_send_handler send);
+
+/**
+ * @brief Invocation counter of the ciphered notifications of a Push Setup, incremented on each use
+ *
+ * The setups with the same server SAP (llc.dsap) use the same key and thus share one counter:
+ * setting it for one of them sets it for all.
+ */
+void csm_push_set_invocation_counter(uint8_t setup, uint32_t ic);
+
+/**
+ * @brief Queue a push (eg: push_script execution, alarm, daily reading)
+ *
+ * A push already pending for the same Push Setup is not queued twice. The first attempt is delayed
+ * by an offset in [0, randomisation_start_interval[ derived from the system title, so that a population
+ * of meters triggered at the same time reaches the head-end at a flat rate.
+ * @param now: application time in seconds, only used for the comparisons with the retry dates
+ * @return FALSE if the queue is full or the setup does not exist
+ */
+int csm_push_trigger(uint8_t setup, uint32_t now);
+
+/**
+ * @brief Send the pending pushes that are due
+ *
+ * All the due pushes to the same destination, with the same security context (SC, llc and GCM
+ * context, hence the same key and invocation counter) are coalesced into one
+ * Data-Notification whose body is a structure of the individual bodies. Failed pushes are retried
+ * nb_retries times, repetition_delay apart.
+ *
+ * @param buffer: work buffer for the APDU, CSM_PUSH_HEADROOM bytes are reserved at the beginning
+ * @return the number of APDUs sent
+ */
+uint32_t csm_push_process(uint32_t now, uint8_t *buffer, uint32_t size);
+
+uint32_t csm_push_pending(void);
+
+/**
+ * @brief Data-Notification header: tag, long-invoke-id-and-priority, date-time (optional, 12 bytes)
+ *
+ * The notification-body (one Data) must be written after.
+ */
+int csm_push_encode_notification(csm_array *array, uint32_t invoke_id, int high_priority, const uint8_t *date_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_PUSH_H
@@ -0,0 +1,69 @@
+/**
+ * Two-level run queue of the received APDUs, honouring the invoke-id priority bit
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "csm_runq.h"
+#include "csm_channel.h"
+#include "csm_config.h"
+
+void csm_runq_init(csm_runq *q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+int csm_runq_push(csm_runq *q, enum csm_runq_level level, uint8_t channel, void *ctx)
+{
+    int valid = (level < CSM_RUNQ_NB_LEVELS) && (q->count[level] < CSM_RUNQ_SIZE);
+
+    if (valid)
+    {
+        csm_runq_item *item = &q->items[level][(q->head[level] + q->count[level]) % CSM_RUNQ_SIZE];
+        item->channel = channel;
+        item->ctx = ctx;
+        q->count[level]++;
+    }
+    else
+    {
+        CSM_ERR("[RUNQ] Queue full");
+    }
+    return valid;
+}
+
+int csm_runq_submit(csm_runq *q, uint8_t channel, const csm_array *packet, void *ctx)
+{
+    enum csm_runq_level level = csm_channel_is_high_priority(channel, packet) ? CSM_RUNQ_HIGH : CSM_RUNQ_NORMAL;
+    return csm_runq_push(q, level, channel, ctx);
+}
+
+int csm_runq_pop(csm_runq *q, uint8_t *channel, void **ctx)
+{
+    enum csm_runq_level level = CSM_RUNQ_NORMAL;
+    int valid = (csm_runq_count(q) > 0U);
+
+    if (valid)
+    {
+        if ((q->count[CSM_RUNQ_HIGH] > 0U) &&
+            ((q->count[CSM_RUNQ_NORMAL] == 0U) || (q->burst < CSM_RUNQ_MAX_BURST)))
+        {
+            level = CSM_RUNQ_HIGH;
+        }
+
+        // The burst only counts the high priority APDUs served while normal ones are waiting
+        q->burst = ((level == CSM_RUNQ_HIGH) && (q->count[CSM_RUNQ_NORMAL] > 0U)) ? (uint8_t)(q->burst + 1U) : 0U;
+
+        const csm_runq_item *item = &q->items[level][q->head[level]];
+        *channel = item->channel;
+        *ctx = item->ctx;
+        q->head[level] = (uint8_t)((q->head[level] + 1U) % CSM_RUNQ_SIZE);
+        q->count[level]--;
+    }
+    return valid;
+}
@@ -0,0 +1,73 @@
+/**
+ * Two-level run queue of the received APDUs, honouring the invoke-id priority bit
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_RUNQ_H
+#define CSM_RUNQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "csm_array.h"
+
+#define CSM_RUNQ_SIZE       16U     //!< APDUs per level
+
+// After this number of consecutive high priority APDUs, one normal APDU is served (no starvation)
+#define CSM_RUNQ_MAX_BURST  8U
+
+enum csm_runq_level { CSM_RUNQ_HIGH, CSM_RUNQ_NORMAL, CSM_RUNQ_NB_LEVELS };
+
+typedef struct
+{
+    uint8_t channel;
+    void *ctx;          //!< Application handle of the APDU (buffer, connection...)
+} csm_runq_item;
+
+typedef struct
+{
+    csm_runq_item items[CSM_RUNQ_NB_LEVELS][CSM_RUNQ_SIZE];
+    uint8_t head[CSM_RUNQ_NB_LEVELS];
+    uint8_t count[CSM_RUNQ_NB_LEVELS];
+    uint8_t burst;      //!< Consecutive high priority APDUs served while normal ones wait
+} csm_runq;
+
+void csm_runq_init(csm_runq *q);
+
+int csm_runq_push(csm_runq *q, enum csm_runq_level level, uint8_t channel, void *ctx);
+
+/**
+ * @brief Queue a received APDU at the level given by its invoke-id-and-priority byte
+ *
+ * The high priority level is used only if the association of the channel has negotiated
+ * priority-mgmt-supported, see csm_channel_is_high_priority().
+ * @return FALSE if the level is full
+ */
+int csm_runq_submit(csm_runq *q, uint8_t channel, const csm_array *packet, void *ctx);
+
+/**
+ * @brief Next APDU to execute, high priority first
+ *
+ * The queue holds whole requests: an urgent request overtakes the ones queued before it, not a
+ * response being encoded. The server has no GET-with-block, a long readout is one APDU.
+ * @return FALSE if the queue is empty
+ */
+int csm_runq_pop(csm_runq *q, uint8_t *channel, void **ctx);
+
+static inline uint32_t csm_runq_count(const csm_runq *q)
+{
+    return (uint32_t)q->count[CSM_RUNQ_HIGH] + q->count[CSM_RUNQ_NORMAL];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_RUNQ_H
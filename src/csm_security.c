@@ -11,6 +11,7 @@
 
 #include "csm_security.h"
 #include "os_util.h"
+#include "csm_metrics.h"
 #include <string.h>
 
 csm_sec_result csm_sec_auth_decrypt(csm_array *array, csm_request *request, const uint8_t *system_title)
@@ -22,6 +23,7 @@ csm_sec_result csm_sec_auth_decrypt(csm_array *array, csm_request *request, cons
     uint32_t data_size = 0U;
     uint32_t aad_size = 0U;
     uint8_t IV[12];
+    CSM_METRICS_START(start);
 
     csm_array_read_u8(array, &sc.sh_byte);
     csm_array_read_u32(array, &ic);
@@ -57,6 +59,7 @@ csm_sec_result csm_sec_auth_decrypt(csm_array *array, csm_request *request, cons
             {
                 data_size -= 12U;
                 aad_size += 17U;
+                tag_read = data + data_size;
             }
             else
             {
@@ -107,6 +110,11 @@ csm_sec_result csm_sec_auth_decrypt(csm_array *array, csm_request *request, cons
         }
     }
 
+    if (retcode != CSM_SEC_OK)
+    {
+        CSM_METRICS_INC(CSM_METRIC_SEC_FAILURE);
+    }
+    CSM_METRICS_STOP(CSM_LATENCY_SECURITY, start);
     return retcode;
 }
 
@@ -142,18 +150,9 @@ csm_sec_result csm_sec_auth_encrypt(csm_array *array, csm_request *request, cons
         if (sc.sh_bit_field.authentication)
         {
             CSM_LOG("[SEC] Authentication enabled");
-            // E + A: size must be higher than the tag
-            if (unread > 12U)
-            {
-                data_size -= 12U;
-                aad_size += 17U;
-                tag_ptr = data + data_size;
-            }
-            else
-            {
-                CSM_ERR("[SEC] Bad packet size for deciphering");
-                retcode = CSM_SEC_ERROR;
-            }
+            // E + A: the tag is appended after the ciphered information
+            aad_size = 17U;
+            tag_ptr = data + data_size;
         }
     }
     else if (sc.sh_bit_field.authentication)
@@ -188,7 +187,7 @@ csm_sec_result csm_sec_auth_encrypt(csm_array *array, csm_request *request, cons
     uint8_t tag[16U];
     csm_sys_gcm_finish(request->channel_id, tag);
 
-    csm_array_writer_jump(array, data_size); // Jump over crypted data
+    // The information is ciphered in place, it is already counted in the array
 
     if ((tag_ptr != NULL) && (retcode == CSM_SEC_OK))
     {
@@ -48,6 +48,7 @@ typedef struct
 {
     uint32_t client_ic; //!< Invocation counter of the client
     uint32_t server_ic; //!< Invocation counter of the server
+    uint32_t server_ic_limit; //!< Ciphered requests are executed below this counter only, 0: no limit (see csm_snapshot_reserve())
 } csm_sec_context;
 
 typedef enum
@@ -11,12 +11,14 @@
 
 #include "csm_services.h"
 #include "csm_axdr_codec.h"
+#include "csm_metrics.h"
 
 static csm_db_access_handler database = NULL;
 
 // FIXME: add parameters to specialize the exception response
 int svc_exception_response_encoder(csm_array *array)
 {
+    CSM_METRICS_INC(CSM_METRIC_EXCEPTION);
     int valid = csm_array_write_u8(array, AXDR_EXCEPTION_RESPONSE);
     valid = valid && csm_array_write_u8(array, 1U);
     valid = valid && csm_array_write_u8(array, 1U);
@@ -38,13 +40,23 @@ int svc_data_access_result_encoder(csm_array *array, csm_db_code code)
 {
     uint8_t result;
     // Transform the code into a DLMS/Cosem valid response
-    if (code == CSM_OK)
+    switch (code)
     {
-        result = SRV_RESULT_SUCCESS;
-    }
-    else
-    {
-        result = SRV_RESULT_OTHER_REASON;
+        case CSM_OK:
+            result = SRV_RESULT_SUCCESS;
+            break;
+        case CSM_ERR_OBJECT_NOT_FOUND:
+            result = SRV_RESULT_OBJECT_UNDEFINED;
+            break;
+        case CSM_ERR_UNAUTHORIZED_ACCESS:
+            result = SRV_RESULT_READ_WRITE_DENIED;
+            break;
+        case CSM_ERR_TEMPORARY_FAILURE:
+            result = SRV_RESULT_TEMPORARY_FAILURE;
+            break;
+        default:
+            result = SRV_RESULT_OTHER_REASON;
+            break;
     }
 
     return csm_array_write_u8(array, result);
@@ -104,12 +116,17 @@ int svc_decode_request(csm_request *request, csm_array *array)
                 }
             }
 
-            if (request->db_request.service != SVC_GET)
+            if (request->db_request.service == SVC_ACTION)
             {
-                // SET and ACTION services can have data in the request
+                // ACTION services can have data in the request
                 valid = valid && csm_array_read_u8(array, &request->db_request.additional_data.enable);
                 // Data is following in the array
             }
+            else if (request->db_request.service == SVC_SET)
+            {
+                // The value is mandatory for SET services, no presence flag
+                request->db_request.additional_data.enable = TRUE;
+            }
         }
         else if (svc_is_next_request(type, request->db_request.service))
         {
@@ -120,12 +137,23 @@ int svc_decode_request(csm_request *request, csm_array *array)
     return valid;
 }
 
+// The result choice is 0 for data, 1 for a data-access-result
+static int svc_get_response_header(csm_request *request, uint8_t result, csm_array *array)
+{
+    int valid = csm_array_write_u8(array, AXDR_GET_RESPONSE);
+    valid = valid && csm_array_write_u8(array, 1U); // FIXME: we support only get response normal for now
+    valid = valid && csm_array_write_u8(array, request->sender_invoke_id);
+    valid = valid && csm_array_write_u8(array, result);
+    return valid;
+}
+
 static csm_db_code svc_get_request_decoder(csm_asso_state *state, csm_request *request, csm_array *array)
 {
     csm_db_code code = CSM_ERR_BAD_ENCODING;
     (void) state;
 
     CSM_LOG("[SVC] Decoding GET.request");
+    CSM_METRICS_INC(CSM_METRIC_GET);
 
     request->db_request.service = SVC_GET;
 
@@ -137,17 +165,18 @@ static csm_db_code svc_get_request_decoder(csm_asso_state *state, csm_request *r
             array->wr_index = 0U;
             CSM_LOG("[SVC] Encoding GET.response");
 
-            int valid = csm_array_write_u8(array, AXDR_GET_RESPONSE);
-            valid = valid && csm_array_write_u8(array, 1U); // FIXME: we support only get response normal for now
-            valid = valid && csm_array_write_u8(array, request->sender_invoke_id);
-            valid = valid && csm_array_write_u8(array, 0U); // data result
-
             // Actually append the data
-            if (valid)
+            if (svc_get_response_header(request, 0U, array))
             {
                 code = database(array, array, request);
                 // FIXME: update the code according to the DB result
             }
+
+            if (code == CSM_PENDING)
+            {
+                CSM_LOG("[SVC] GET pending");
+                array->wr_index = 0U;
+            }
         }
         else
         {
@@ -156,7 +185,7 @@ static csm_db_code svc_get_request_decoder(csm_asso_state *state, csm_request *r
         }
     }
 
-    if (code != CSM_OK)
+    if ((code != CSM_OK) && (code != CSM_PENDING))
     {
         array->wr_index = 0U;
         if (svc_exception_response_encoder(array))
@@ -175,6 +204,38 @@ static csm_db_code svc_get_request_decoder(csm_asso_state *state, csm_request *r
 
 static const uint32_t gResponseNormalHeaderSize = 6U; // Offset where data can be returned for an Action
 
+// The ACTION return parameters (reply_size bytes) are already encoded after the response header
+static int svc_set_action_response(csm_request *request, csm_db_code code, uint32_t reply_size, csm_array *array)
+{
+    csm_array output = *array;
+    output.wr_index = 0U;
+
+    uint8_t service_resp = (request->db_request.service == SVC_SET) ? AXDR_SET_RESPONSE : AXDR_ACTION_RESPONSE;
+    int valid = csm_array_write_u8(&output, service_resp);
+    valid = valid && csm_array_write_u8(&output, 1U); // FIXME: use proper service tag according to service type
+    valid = valid && csm_array_write_u8(&output, request->sender_invoke_id);
+    valid = valid && svc_data_access_result_encoder(&output, code);
+
+    if (request->db_request.service == SVC_ACTION)
+    {
+        // Encode additional data if any
+        if (reply_size > 0U)
+        {
+            valid = valid && csm_array_write_u8(&output, 1U); // presence flag for optional return-parameters
+            valid = valid && csm_array_write_u8(&output, 0U); // Data
+            valid = valid && csm_array_writer_jump(&output, reply_size); // Virtually add the data (already encoded in the buffer)
+        }
+        else
+        {
+            valid = valid && csm_array_write_u8(&output, 0U); // presence flag for optional return-parameters
+        }
+    }
+
+    // Update size to send to output channel
+    array->wr_index = output.wr_index;
+    return valid;
+}
+
 static csm_db_code svc_set_or_action_decoder(csm_asso_state *state, csm_request *request, csm_array *array)
 {
     csm_db_code code = CSM_ERR_BAD_ENCODING;
@@ -189,50 +250,24 @@ static csm_db_code svc_set_or_action_decoder(csm_asso_state *state, csm_request
             // The output data will point to a different area into our working buffer
             // This will help us to encode the data
             csm_array output = *array;
-            uint32_t reply_size = 0U;
             output.offset += gResponseNormalHeaderSize; // begin to encode the reply just after the response header
             output.rd_index = 0U;
             output.wr_index = 0U;
 
             code = database(array, &output, request);
 
-            reply_size = output.wr_index;
-
-            // Encode the response
-            output.offset -= gResponseNormalHeaderSize;
-            output.wr_index = 0U;
-
-            uint8_t service_resp = (request->db_request.service == SVC_SET) ? AXDR_SET_RESPONSE : AXDR_ACTION_RESPONSE;
-            int valid = csm_array_write_u8(&output, service_resp);
-            valid = valid && csm_array_write_u8(&output, 1U); // FIXME: use proper service tag according to service type
-            valid = valid && csm_array_write_u8(&output, request->sender_invoke_id);
-            valid = svc_data_access_result_encoder(&output, code);
-
-            if (request->db_request.service == SVC_ACTION)
+            if (code == CSM_PENDING)
             {
-                // Encode additional data if any
-                if (reply_size > 0U)
-                {
-                    valid = valid && csm_array_write_u8(&output, 1U); // presence flag for optional return-parameters
-                    valid = valid && csm_array_write_u8(&output, 0U); // Data
-                    valid = valid && csm_array_writer_jump(&output, reply_size); // Virtually add the data (already encoded in the buffer)
-                }
-                else
-                {
-                    valid = valid && csm_array_write_u8(&output, 0U); // presence flag for optional return-parameters
-                }
+                CSM_LOG("[SVC] SET/ACTION pending");
+                array->wr_index = 0U;
             }
-
-            // Update size to send to output channel
-            array->wr_index = output.wr_index;
-
-            if (!valid)
+            else if (svc_set_action_response(request, code, output.wr_index, array))
             {
-                code = CSM_ERR_BAD_ENCODING;
+                code = CSM_OK;
             }
             else
             {
-                code = CSM_OK;
+                code = CSM_ERR_BAD_ENCODING;
             }
         }
         else
@@ -242,7 +277,7 @@ static csm_db_code svc_set_or_action_decoder(csm_asso_state *state, csm_request
         }
     }
 
-    if (code != CSM_OK)
+    if ((code != CSM_OK) && (code != CSM_PENDING))
     {
         array->wr_index = 0U;
         if (svc_exception_response_encoder(array))
@@ -254,10 +289,6 @@ static csm_db_code svc_set_or_action_decoder(csm_asso_state *state, csm_request
             CSM_ERR("[SVC][SET] Internal problem, cannot encore exception response");
         }
     }
-    else
-    {
-        CSM_ERR("[SVC][SET] Encoding error");
-    }
 
     return code;
 }
@@ -266,6 +297,7 @@ static csm_db_code svc_set_request_decoder(csm_asso_state *state, csm_request *r
 {
     request->db_request.service = SVC_SET;
     CSM_LOG("[SVC] Decoding SET.request");
+    CSM_METRICS_INC(CSM_METRIC_SET);
     return svc_set_or_action_decoder(state, request, array);
 }
 
@@ -274,6 +306,7 @@ static csm_db_code svc_action_request_decoder(csm_asso_state *state, csm_request
 {
     request->db_request.service = SVC_ACTION;
     CSM_LOG("[SVC] Decoding ACTION.request");
+    CSM_METRICS_INC(CSM_METRIC_ACTION);
     return svc_set_or_action_decoder(state, request, array);
 }
 
@@ -423,6 +456,7 @@ int csm_services_hls_execute(csm_asso_state *state, csm_request *request, csm_ar
 int csm_server_services_execute(csm_asso_state *state, csm_request *request, csm_array *array)
 {
     int number_of_bytes = 0;
+    CSM_METRICS_START(start);
     // FIXME: test the array size: minimum/maximum data size allowed
     if (database != NULL)
     {
@@ -435,10 +469,15 @@ int csm_server_services_execute(csm_asso_state *state, csm_request *request, csm
                 if ((srv->tag == tag) && (srv->decoder != NULL))
                 {
                     CSM_LOG("[SVC] Found service");
-                    if (srv->decoder(state, request, array) == CSM_OK)
+                    csm_db_code code = srv->decoder(state, request, array);
+                    if (code == CSM_OK)
                     {
                         number_of_bytes = array->wr_index;
                     }
+                    else if (code == CSM_PENDING)
+                    {
+                        number_of_bytes = CSM_SVC_PENDING;
+                    }
                     else
                     {
                         CSM_ERR("[SVC] Encoding error!");
@@ -448,9 +487,51 @@ int csm_server_services_execute(csm_asso_state *state, csm_request *request, csm
             }
         }
     }
+
+    CSM_METRICS_STOP(CSM_LATENCY_SERVICES, start);
     return number_of_bytes;
 }
 
+int csm_services_complete(csm_request *request, csm_db_code code, const uint8_t *data, uint32_t size, csm_array *array)
+{
+    int valid = FALSE;
+
+    array->rd_index = 0U;
+    array->wr_index = 0U;
+
+    if (request->db_request.service == SVC_GET)
+    {
+        CSM_LOG("[SVC] Encoding deferred GET.response");
+        if (code == CSM_OK)
+        {
+            valid = svc_get_response_header(request, 0U, array);
+            valid = valid && ((size == 0U) || csm_array_write_buff(array, data, size));
+        }
+        else
+        {
+            // The request was valid, only the access failed: Get-Data-Result is a data-access-result
+            valid = svc_get_response_header(request, 1U, array);
+            valid = valid && svc_data_access_result_encoder(array, code);
+        }
+    }
+    else if ((request->db_request.service == SVC_SET) || (request->db_request.service == SVC_ACTION))
+    {
+        CSM_LOG("[SVC] Encoding deferred SET/ACTION.response");
+        // Same layout as the synchronous path: the return parameters follow the response header
+        csm_array output = *array;
+        output.offset += gResponseNormalHeaderSize;
+
+        valid = (size == 0U) || csm_array_write_buff(&output, data, size);
+        valid = valid && svc_set_action_response(request, code, output.wr_index, array);
+    }
+
+    if (!valid)
+    {
+        array->wr_index = 0U;
+        valid = svc_exception_response_encoder(array);
+    }
+    return valid ? (int)array->wr_index : 0;
+}
 
 int svc_is_valid_data_access_result(uint8_t result)
 {
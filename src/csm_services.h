@@ -37,12 +37,23 @@ typedef enum
     CSM_ERR_UNAUTHORIZED_ACCESS, //!< Attribute access problem
     CSM_ERR_TEMPORARY_FAILURE,   ///< Temporary failure
     CSM_ERR_DATA_CONTENT_NOT_OK, ///< Data content is not accepted.
+    CSM_PENDING,                 ///< Access in progress, completed later with request->token (see csm_channel_complete())
 } csm_db_code;
 
 
-
+/**
+ * @brief Database access
+ *
+ * A handler that cannot answer immediately (flash, sub-meter, external database) returns CSM_PENDING
+ * and keeps request->token: the transport loop goes on and the response is encoded when the access
+ * completes. The input array (SET value, ACTION parameters, selective access) is only valid during
+ * the call, a pending handler must copy what it needs.
+ */
 typedef csm_db_code (*csm_db_access_handler)(csm_array *in, csm_array *out, csm_request *request);
 
+// Returned by csm_server_services_execute() when the database access is pending
+#define CSM_SVC_PENDING     (-1)
+
 
 
 
@@ -58,9 +69,19 @@ int csm_client_encode_selective_access_by_range(csm_array *array, csm_object_t *
 
 void csm_services_init(const csm_db_access_handler db_access);
 
-// Return he number of bytes to transfer back, 0 if no response
+// Generic exception-response (service-not-allowed, operation-not-possible), TRUE if written
+int svc_exception_response_encoder(csm_array *array);
+
+// Return he number of bytes to transfer back, 0 if no response, CSM_SVC_PENDING if the database completes later
 int csm_server_services_execute(csm_asso_state *state, csm_request *request, csm_array *array);
 
+/**
+ * @brief Encode the response of a pending request
+ * @param data: A-XDR encoded data (GET value, ACTION return parameters), may be empty
+ * @return the number of bytes to transfer back
+ */
+int csm_services_complete(csm_request *request, csm_db_code code, const uint8_t *data, uint32_t size, csm_array *array);
+
 // Specific method in case of HLS authentication
 int csm_services_hls_execute(csm_asso_state *state, csm_request *request, csm_array *array);
 
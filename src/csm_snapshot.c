@@ -0,0 +1,207 @@
+/**
+ * Snapshot and restore of the association and channel states, for a fast restart
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include "csm_snapshot.h"
+
+static uint32_t snapshot_checksum(const uint8_t *data, uint32_t size)
+{
+    uint32_t hash = 2166136261U;
+
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+uint32_t csm_snapshot_size(uint32_t nb_assos, uint32_t nb_channels)
+{
+    return (uint32_t)sizeof(csm_snapshot_header) + (nb_assos * (uint32_t)sizeof(csm_snapshot_asso)) +
+           (nb_channels * (uint32_t)sizeof(csm_snapshot_channel));
+}
+
+uint32_t csm_snapshot_save(uint8_t *image, uint32_t size, const csm_asso_state *assos, const csm_sec_context *sec, uint32_t nb_assos,
+                           const csm_channel *channels, uint32_t nb_channels)
+{
+    uint32_t image_size = csm_snapshot_size(nb_assos, nb_channels);
+
+    if (size < image_size)
+    {
+        CSM_ERR("[SNAP] Buffer too small");
+        return 0U;
+    }
+
+    csm_snapshot_header header;
+    csm_snapshot_asso *asso_rec = (csm_snapshot_asso *)&image[sizeof(csm_snapshot_header)];
+    csm_snapshot_channel *chan_rec = (csm_snapshot_channel *)&asso_rec[nb_assos];
+
+    // Invalidate the previous image during the update
+    memset(image, 0, sizeof(csm_snapshot_header));
+
+    for (uint32_t i = 0U; i < nb_assos; i++)
+    {
+        csm_snapshot_asso rec;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.conformance = assos[i].conformance;
+        rec.client_ic = (sec != NULL) ? sec[i].client_ic : 0U;
+        if (sec != NULL)
+        {
+            // Saturated: the key must be changed, nothing more is ciphered
+            uint32_t reserved = sec[i].server_ic + CSM_SNAPSHOT_IC_WINDOW;
+            rec.server_ic = (reserved < sec[i].server_ic) ? 0xFFFFFFFFU : reserved;
+        }
+        rec.state_cf = (uint8_t)((assos[i].config != NULL) ? assos[i].state_cf : CF_IDLE);
+        rec.ref = (uint8_t)assos[i].ref;
+        rec.auth_level = (uint8_t)assos[i].auth_level;
+        memcpy(rec.client_app_title, assos[i].client_app_title, CSM_DEF_APP_TITLE_SIZE);
+        memcpy(rec.server_app_title, assos[i].server_app_title, CSM_DEF_APP_TITLE_SIZE);
+        if (assos[i].config != NULL)
+        {
+            rec.llc = assos[i].config->llc;
+        }
+        memcpy(&asso_rec[i], &rec, sizeof(rec));
+    }
+
+    for (uint32_t i = 0U; i < nb_channels; i++)
+    {
+        csm_snapshot_channel rec;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.llc = channels[i].llc;
+        rec.channel_id = channels[i].channel_id;
+        memcpy(&chan_rec[i], &rec, sizeof(rec));
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = CSM_SNAPSHOT_MAGIC;
+    header.version = CSM_SNAPSHOT_VERSION;
+    header.header_size = (uint16_t)sizeof(csm_snapshot_header);
+    header.asso_size = (uint16_t)sizeof(csm_snapshot_asso);
+    header.channel_size = (uint16_t)sizeof(csm_snapshot_channel);
+    header.nb_assos = nb_assos;
+    header.nb_channels = nb_channels;
+    header.checksum = snapshot_checksum(&image[sizeof(csm_snapshot_header)], image_size - (uint32_t)sizeof(csm_snapshot_header));
+    memcpy(header.system_title, csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE);
+
+    memcpy(image, &header, sizeof(header));
+    return image_size;
+}
+
+static int snapshot_validate(const uint8_t *image, uint32_t size, csm_snapshot_header *header)
+{
+    int valid = (size >= sizeof(csm_snapshot_header));
+
+    if (valid)
+    {
+        memcpy(header, image, sizeof(csm_snapshot_header));
+        valid = (header->magic == CSM_SNAPSHOT_MAGIC) &&
+                (header->version == CSM_SNAPSHOT_VERSION) &&
+                (header->header_size == sizeof(csm_snapshot_header)) &&
+                (header->asso_size == sizeof(csm_snapshot_asso)) &&
+                (header->channel_size == sizeof(csm_snapshot_channel)) &&
+                (header->nb_assos <= 0x10000U) && (header->nb_channels <= 0x100U);
+    }
+
+    valid = valid && (size >= csm_snapshot_size(header->nb_assos, header->nb_channels));
+    valid = valid && (memcmp(header->system_title, csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE) == 0);
+    valid = valid && (header->checksum == snapshot_checksum(&image[sizeof(csm_snapshot_header)],
+                                                             csm_snapshot_size(header->nb_assos, header->nb_channels) - (uint32_t)sizeof(csm_snapshot_header)));
+    return valid;
+}
+
+int csm_snapshot_reserve(const uint8_t *image, uint32_t size, csm_sec_context *sec, uint32_t nb_assos)
+{
+    csm_snapshot_header header;
+    int valid = snapshot_validate(image, size, &header);
+
+    for (uint32_t i = 0U; valid && (i < header.nb_assos) && (i < nb_assos); i++)
+    {
+        csm_snapshot_asso rec;
+        memcpy(&rec, &image[sizeof(csm_snapshot_header) + (i * sizeof(csm_snapshot_asso))], sizeof(rec));
+
+        // Only moves forward: an older image does not reserve the counters again
+        if (rec.server_ic > sec[i].server_ic_limit)
+        {
+            sec[i].server_ic_limit = rec.server_ic;
+        }
+    }
+    return valid;
+}
+
+int csm_snapshot_restore(const uint8_t *image, uint32_t size, csm_asso_state *assos, csm_sec_context *sec, uint32_t nb_assos,
+                         const csm_asso_config *configs, uint32_t nb_configs)
+{
+    csm_snapshot_header header;
+    int resumed = -1;
+
+    if (!snapshot_validate(image, size, &header))
+    {
+        CSM_ERR("[SNAP] Invalid image, full reconnection");
+        return resumed;
+    }
+
+    const uint8_t *records = &image[sizeof(csm_snapshot_header)];
+    resumed = 0;
+
+    for (uint32_t i = 0U; (i < header.nb_assos) && (i < nb_assos); i++)
+    {
+        csm_snapshot_asso rec;
+        memcpy(&rec, &records[i * sizeof(csm_snapshot_asso)], sizeof(rec));
+
+        const csm_asso_config *config = NULL;
+        for (uint32_t j = 0U; j < nb_configs; j++)
+        {
+            if ((configs[j].llc.ssap == rec.llc.ssap) && (configs[j].llc.dsap == rec.llc.dsap))
+            {
+                config = &configs[j];
+                break;
+            }
+        }
+
+        if (sec != NULL)
+        {
+            sec[i].client_ic = rec.client_ic;
+            sec[i].server_ic = rec.server_ic;
+            sec[i].server_ic_limit = rec.server_ic;
+        }
+
+        // The association configuration may have changed since the snapshot
+        if ((rec.state_cf == CF_ASSOCIATED) && (config != NULL))
+        {
+            csm_asso_init(&assos[i]);
+            assos[i].config = config;
+            assos[i].conformance = rec.conformance & config->conformance;
+            assos[i].state_cf = CF_ASSOCIATED;
+            assos[i].ref = (enum csm_referencing)rec.ref;
+            assos[i].auth_level = (enum csm_auth_level)rec.auth_level;
+            memcpy(assos[i].client_app_title, rec.client_app_title, CSM_DEF_APP_TITLE_SIZE);
+            memcpy(assos[i].server_app_title, rec.server_app_title, CSM_DEF_APP_TITLE_SIZE);
+            resumed++;
+        }
+    }
+
+    records += header.nb_assos * sizeof(csm_snapshot_asso);
+    for (uint32_t i = 0U; i < header.nb_channels; i++)
+    {
+        csm_snapshot_channel rec;
+        memcpy(&rec, &records[i * sizeof(csm_snapshot_channel)], sizeof(rec));
+
+        if (rec.channel_id != INVALID_CHANNEL_ID)
+        {
+            (void) csm_channel_resume(rec.channel_id, &rec.llc);
+        }
+    }
+
+    CSM_LOG("[SNAP] %d associations resumed", resumed);
+    return resumed;
+}
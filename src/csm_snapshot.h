@@ -0,0 +1,120 @@
+/**
+ * Snapshot and restore of the association and channel states, for a fast restart
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_SNAPSHOT_H
+#define CSM_SNAPSHOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "csm_channel.h"
+#include "csm_security.h"
+
+#define CSM_SNAPSHOT_MAGIC      0x534D5343U     // "CSMS" on little endian hosts
+#define CSM_SNAPSHOT_VERSION    2U
+
+// Server invocation counters reserved by an image, see csm_snapshot_reserve()
+#ifndef CSM_SNAPSHOT_IC_WINDOW
+#define CSM_SNAPSHOT_IC_WINDOW  4096U
+#endif
+
+/**
+ * Image layout, in the host byte order (a host of another endianness does not recognize the magic):
+ *
+ *     header | nb_assos x csm_snapshot_asso | nb_channels x csm_snapshot_channel
+ *
+ * Records have a fixed layout without pointers: the configuration is found again from the LLC and the
+ * keys are referenced by the server SAP, they are never part of the image.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t asso_size;         //!< Record sizes: a layout change is detected even without a version bump
+    uint16_t channel_size;
+    uint32_t nb_assos;
+    uint32_t nb_channels;
+    uint32_t checksum;          //!< FNV-1a of the records
+    uint8_t system_title[CSM_DEF_APP_TITLE_SIZE];   //!< The image of another device is not restored
+} csm_snapshot_header;
+
+typedef struct
+{
+    uint32_t conformance;
+    uint32_t client_ic;
+    uint32_t server_ic;         //!< First counter after the reserved window, never used before a restart
+    csm_llc llc;
+    uint8_t state_cf;
+    uint8_t ref;
+    uint8_t auth_level;
+    uint8_t reserved;
+    uint8_t client_app_title[CSM_DEF_APP_TITLE_SIZE];
+    uint8_t server_app_title[CSM_DEF_APP_TITLE_SIZE];
+} csm_snapshot_asso;
+
+typedef struct
+{
+    csm_llc llc;
+    uint8_t channel_id;         //!< INVALID_CHANNEL_ID if the channel was free
+    uint8_t reserved[3];
+} csm_snapshot_channel;
+
+uint32_t csm_snapshot_size(uint32_t nb_assos, uint32_t nb_channels);
+
+/**
+ * @brief Write the image of the associations and channels
+ *
+ * The header is written last: an image interrupted by a crash is rejected by the restore.
+ * The server counter of each association is saved CSM_SNAPSHOT_IC_WINDOW ahead: the counters below
+ * are reserved, and can be used once the image is stored, see csm_snapshot_reserve().
+ * @param sec: invocation counters of the associations, can be NULL
+ * @return the image size, 0 if the buffer is too small
+ */
+uint32_t csm_snapshot_save(uint8_t *image, uint32_t size, const csm_asso_state *assos, const csm_sec_context *sec, uint32_t nb_assos,
+                           const csm_channel *channels, uint32_t nb_channels);
+
+/**
+ * @brief Allow the server counters reserved by an image, once it is durable (eg: after msync())
+ *
+ * Sets the server_ic_limit of each context: a GCM nonce is never used again after a restart, even
+ * if the counters moved since the save. When a limit is reached, the ciphered requests are refused
+ * (exception-response, not executed) until the next image.
+ * @return FALSE if the image is not valid
+ */
+int csm_snapshot_reserve(const uint8_t *image, uint32_t size, csm_sec_context *sec, uint32_t nb_assos);
+
+/**
+ * @brief Resume the sessions of a valid image
+ *
+ * The image is validated as a whole (header, sizes, checksum, system title) before anything is copied.
+ * Only the established associations are resumed, with their configuration found from the LLC; an
+ * association in the middle of the HLS has lost its challenges and is left idle. The channels are
+ * resumed with csm_channel_resume(), csm_channel_init() must be called before. Pending database
+ * accesses are not part of the image.
+ *
+ * The server counters restart after their reserved window and are limited to it: the responses
+ * are ciphered again after the next csm_snapshot_save() and csm_snapshot_reserve(). The client
+ * counters are the ones of the save, a request sent between the save and the restart can be
+ * replayed once: save often.
+ *
+ * @param sec: receives the invocation counters, can be NULL
+ * @return the number of associations resumed, -1 if the image is not valid
+ */
+int csm_snapshot_restore(const uint8_t *image, uint32_t size, csm_asso_state *assos, csm_sec_context *sec, uint32_t nb_assos,
+                         const csm_asso_config *configs, uint32_t nb_configs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_SNAPSHOT_H
@@ -0,0 +1,808 @@
+/**
+ * Binary trace ring, used instead of printf when CSM_TRACE_USE_RING is defined
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "csm_trace.h"
+#include "csm_config.h"
+#include "os_util.h"
+
+static csm_trace_ring *ring_list[CSM_TRACE_MAX_RINGS];
+static volatile uint32_t ring_list_size = 0U;     // Published once the slot is filled
+static CSM_LOCK_TYPE ring_list_lock = CSM_LOCK_INIT;
+static volatile uint32_t unattached_drops = 0U;
+
+static CSM_THREAD_LOCAL csm_trace_ring *current_ring = NULL;
+static csm_trace_clock trace_clock = NULL;
+
+// Argument classes, given by the conversion and its length modifier
+enum
+{
+    TRACE_ARG_NONE,     //!< %% or end of string
+    TRACE_ARG_INT,      //!< int or promoted to int (hh, h, c)
+    TRACE_ARG_LONG,
+    TRACE_ARG_LLONG,
+    TRACE_ARG_INTMAX,
+    TRACE_ARG_SIZE,
+    TRACE_ARG_PTRDIFF,
+    TRACE_ARG_DOUBLE,
+    TRACE_ARG_LDOUBLE,
+    TRACE_ARG_STRING,
+    TRACE_ARG_POINTER,
+    TRACE_ARG_COUNT     //!< %n, consumed but never written
+};
+
+typedef struct
+{
+    const char *start;      //!< The '%'
+    const char *end;        //!< After the conversion character
+    const char *modifier;   //!< First character of the length modifier
+    uint32_t modifier_len;
+    char conversion;
+    uint8_t type;
+    uint8_t signed_int;
+    uint8_t stars;          //!< Width and precision given as int arguments, before the value
+} trace_spec;
+
+void csm_trace_set_clock(csm_trace_clock clock)
+{
+    trace_clock = clock;
+}
+
+int csm_trace_attach(csm_trace_ring *ring, csm_trace_record *records, uint32_t size)
+{
+    int ret = FALSE;
+
+    // The size must be a power of two to replace the modulo by a mask
+    if ((size > 0U) && ((size & (size - 1U)) == 0U))
+    {
+        CSM_LOCK(ring_list_lock);
+        uint32_t index = ring_list_size;
+        if (index < CSM_TRACE_MAX_RINGS)
+        {
+            ring->records = records;
+            ring->size = size;
+            ring->head = 0U;
+            ring->tail = 0U;
+            ring->dropped = 0U;
+            ring_list[index] = ring;
+            CSM_BARRIER();
+            ring_list_size = index + 1U;
+            current_ring = ring;
+            ret = TRUE;
+        }
+        CSM_UNLOCK(ring_list_lock);
+    }
+    return ret;
+}
+
+uint32_t csm_trace_unattached_drops(void)
+{
+    return unattached_drops;
+}
+
+uint32_t csm_trace_number_of_rings(void)
+{
+    uint32_t nb = ring_list_size;
+    // The entries below the count are filled
+    CSM_BARRIER();
+    return nb;
+}
+
+csm_trace_ring *csm_trace_get_ring(uint32_t index)
+{
+    csm_trace_ring *ring = NULL;
+    if (index < csm_trace_number_of_rings())
+    {
+        ring = ring_list[index];
+    }
+    return ring;
+}
+
+// Parse the specification starting at fmt (the '%'), return the next character to parse
+static const char *trace_parse_spec(const char *fmt, trace_spec *spec)
+{
+    const char *p = fmt + 1;
+
+    spec->start = fmt;
+    spec->stars = 0U;
+    spec->signed_int = FALSE;
+    spec->type = TRACE_ARG_NONE;
+
+    // Flags, width and precision
+    while ((*p != '\0') && (strchr("-+ #0123456789.*", *p) != NULL))
+    {
+        if (*p == '*')
+        {
+            spec->stars++;
+        }
+        p++;
+    }
+
+    spec->modifier = p;
+    while ((*p != '\0') && (strchr("hlLqjzt", *p) != NULL))
+    {
+        p++;
+    }
+    spec->modifier_len = (uint32_t)(p - spec->modifier);
+    spec->conversion = *p;
+
+    if (*p != '\0')
+    {
+        char m0 = (spec->modifier_len > 0U) ? spec->modifier[0] : '\0';
+        char m1 = (spec->modifier_len > 1U) ? spec->modifier[1] : '\0';
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+            spec->signed_int = TRUE;
+            // fall through
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (((m0 == 'l') && (m1 == 'l')) || (m0 == 'q') || (m0 == 'L'))
+            {
+                spec->type = TRACE_ARG_LLONG;
+            }
+            else if (m0 == 'l')
+            {
+                spec->type = TRACE_ARG_LONG;
+            }
+            else if (m0 == 'j')
+            {
+                spec->type = TRACE_ARG_INTMAX;
+            }
+            else if (m0 == 'z')
+            {
+                spec->type = TRACE_ARG_SIZE;
+            }
+            else if (m0 == 't')
+            {
+                spec->type = TRACE_ARG_PTRDIFF;
+            }
+            else
+            {
+                spec->type = TRACE_ARG_INT;
+            }
+            break;
+        case 'c':
+            spec->type = TRACE_ARG_INT;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = (m0 == 'L') ? TRACE_ARG_LDOUBLE : TRACE_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = TRACE_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = TRACE_ARG_POINTER;
+            break;
+        case 'n':
+            spec->type = TRACE_ARG_COUNT;
+            break;
+        default:
+            // %% or unknown conversion: no argument
+            spec->stars = 0U;
+            break;
+        }
+        p++;
+    }
+    spec->end = p;
+    return p;
+}
+
+static uint64_t trace_double_bits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double trace_bits_double(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t trace_get_arg(const trace_spec *spec, va_list *ap)
+{
+    uint64_t value = 0U;
+
+    // Signed integers are sign extended, the formatter casts them back
+    switch (spec->type)
+    {
+    case TRACE_ARG_INT:
+        value = spec->signed_int ? (uint64_t)(int64_t)va_arg(*ap, int) : (uint64_t)va_arg(*ap, unsigned int);
+        break;
+    case TRACE_ARG_LONG:
+        value = spec->signed_int ? (uint64_t)(int64_t)va_arg(*ap, long) : (uint64_t)va_arg(*ap, unsigned long);
+        break;
+    case TRACE_ARG_LLONG:
+        value = spec->signed_int ? (uint64_t)va_arg(*ap, long long) : (uint64_t)va_arg(*ap, unsigned long long);
+        break;
+    case TRACE_ARG_INTMAX:
+        value = (uint64_t)va_arg(*ap, intmax_t);
+        break;
+    case TRACE_ARG_SIZE:
+        value = (uint64_t)va_arg(*ap, size_t);
+        break;
+    case TRACE_ARG_PTRDIFF:
+        value = (uint64_t)(int64_t)va_arg(*ap, ptrdiff_t);
+        break;
+    case TRACE_ARG_DOUBLE:
+        value = trace_double_bits(va_arg(*ap, double));
+        break;
+    case TRACE_ARG_LDOUBLE:
+        value = trace_double_bits((double)va_arg(*ap, long double));
+        break;
+    case TRACE_ARG_STRING:
+    case TRACE_ARG_POINTER:
+    case TRACE_ARG_COUNT:
+        value = (uint64_t)(uintptr_t)va_arg(*ap, void *);
+        break;
+    default:
+        break;
+    }
+    return value;
+}
+
+void csm_trace_write(uint8_t level, const char *fmt, ...)
+{
+    csm_trace_ring *ring = current_ring;
+
+    if (ring != NULL)
+    {
+        uint32_t head = ring->head;
+        if ((head - ring->tail) < ring->size)
+        {
+            csm_trace_record *rec = &ring->records[head & (ring->size - 1U)];
+            va_list ap;
+            const char *p = fmt;
+
+            rec->timestamp = (trace_clock != NULL) ? trace_clock() : 0U;
+            rec->fmt = fmt;
+            rec->level = level;
+            rec->nargs = 0U;
+
+            // Capture the arguments without formatting them, in the order of the format string
+            va_start(ap, fmt);
+            while ((p = strchr(p, '%')) != NULL)
+            {
+                trace_spec spec;
+                p = trace_parse_spec(p, &spec);
+
+                for (uint32_t i = 0U; i < spec.stars; i++)
+                {
+                    int star = va_arg(ap, int);
+                    if (rec->nargs < CSM_TRACE_MAX_ARGS)
+                    {
+                        rec->args[rec->nargs++] = (uint64_t)(int64_t)star;
+                    }
+                }
+
+                if (spec.type != TRACE_ARG_NONE)
+                {
+                    uint64_t value = trace_get_arg(&spec, &ap);
+                    if (rec->nargs < CSM_TRACE_MAX_ARGS)
+                    {
+                        rec->args[rec->nargs++] = value;
+                    }
+                }
+            }
+            va_end(ap);
+
+            // Publish the record only once its contents are written
+            CSM_BARRIER();
+            ring->head = head + 1U;
+        }
+        else
+        {
+            ring->dropped++;
+        }
+    }
+    else
+    {
+#if defined(__GNUC__)
+        (void) __sync_fetch_and_add(&unattached_drops, 1U);
+#else
+        unattached_drops++;
+#endif
+    }
+}
+
+int csm_trace_read(csm_trace_ring *ring, csm_trace_record *record)
+{
+    int ret = FALSE;
+    uint32_t tail = ring->tail;
+
+    if (tail != ring->head)
+    {
+        CSM_BARRIER();
+        *record = ring->records[tail & (ring->size - 1U)];
+        CSM_BARRIER();
+        ring->tail = tail + 1U;
+        ret = TRUE;
+    }
+    return ret;
+}
+
+static uint32_t trace_append(uint32_t size, uint32_t len, int written)
+{
+    if (written > 0)
+    {
+        len += (uint32_t)written;
+    }
+    return (len < size) ? len : (size - 1U);
+}
+
+// Format one specification with the stored argument, the '*' are replaced by their values
+static uint32_t trace_format_spec(const trace_spec *spec, const csm_trace_record *record, uint32_t *arg, char *out, uint32_t size, uint32_t len)
+{
+    char fmt[32];
+    uint32_t fmt_len = 0U;
+    uint64_t value;
+
+    for (const char *c = spec->start; (c < spec->modifier) && (fmt_len < (sizeof(fmt) - 24U)); c++)
+    {
+        if (*c == '*')
+        {
+            int64_t star = (*arg < record->nargs) ? (int64_t)record->args[*arg] : 0;
+            (*arg)++;
+            fmt_len += (uint32_t)snprintf(&fmt[fmt_len], sizeof(fmt) - fmt_len, "%d", (int)star);
+        }
+        else
+        {
+            fmt[fmt_len++] = *c;
+        }
+    }
+
+    value = (*arg < record->nargs) ? record->args[*arg] : 0U;
+    (*arg)++;
+
+    switch (spec->type)
+    {
+    case TRACE_ARG_INT:
+        // Keep hh and h: the value is converted back to char or short by printf
+        if ((spec->modifier_len > 0U) && (spec->modifier[0] == 'h'))
+        {
+            memcpy(&fmt[fmt_len], spec->modifier, spec->modifier_len);
+            fmt_len += spec->modifier_len;
+        }
+        fmt[fmt_len++] = spec->conversion;
+        fmt[fmt_len] = '\0';
+        len = trace_append(size, len, snprintf(&out[len], size - len, fmt, (int)(uint32_t)value));
+        break;
+    case TRACE_ARG_LONG:
+    case TRACE_ARG_LLONG:
+    case TRACE_ARG_INTMAX:
+    case TRACE_ARG_SIZE:
+    case TRACE_ARG_PTRDIFF:
+    {
+        // Stored on 64 bits: truncate to the original width, then print as long long
+        uint64_t mask = UINT64_MAX;
+        if ((spec->type == TRACE_ARG_LONG) && (sizeof(long) < sizeof(uint64_t)))
+        {
+            mask = (uint64_t)ULONG_MAX;
+        }
+        else if ((spec->type == TRACE_ARG_SIZE) && (sizeof(size_t) < sizeof(uint64_t)))
+        {
+            mask = (uint64_t)(size_t)-1;
+        }
+        value &= mask;
+        if (spec->signed_int && (mask != UINT64_MAX) && ((value & ((mask >> 1) + 1U)) != 0U))
+        {
+            value |= ~mask;
+        }
+        fmt[fmt_len++] = 'l';
+        fmt[fmt_len++] = 'l';
+        fmt[fmt_len++] = spec->conversion;
+        fmt[fmt_len] = '\0';
+        if (spec->signed_int)
+        {
+            len = trace_append(size, len, snprintf(&out[len], size - len, fmt, (long long)(int64_t)value));
+        }
+        else
+        {
+            len = trace_append(size, len, snprintf(&out[len], size - len, fmt, (unsigned long long)value));
+        }
+        break;
+    }
+    case TRACE_ARG_DOUBLE:
+    case TRACE_ARG_LDOUBLE:
+        fmt[fmt_len++] = spec->conversion;
+        fmt[fmt_len] = '\0';
+        len = trace_append(size, len, snprintf(&out[len], size - len, fmt, trace_bits_double(value)));
+        break;
+    case TRACE_ARG_STRING:
+        fmt[fmt_len++] = 's';
+        fmt[fmt_len] = '\0';
+        len = trace_append(size, len, snprintf(&out[len], size - len, fmt, (value != 0U) ? (const char *)(uintptr_t)value : "?"));
+        break;
+    case TRACE_ARG_POINTER:
+        // The address may come from another process, printed in hexadecimal whatever the platform
+        len = trace_append(size, len, snprintf(&out[len], size - len, "0x%llx", (unsigned long long)value));
+        break;
+    default:
+        break;
+    }
+    return len;
+}
+
+uint32_t csm_trace_format(const csm_trace_record *record, char *out, uint32_t size)
+{
+    uint32_t len = 0U;
+    uint32_t arg = 0U;
+    const char *p = record->fmt;
+
+    if ((size == 0U) || (p == NULL))
+    {
+        return 0U;
+    }
+    out[0] = '\0';
+
+    if (record->level == CSM_TRACE_LEVEL_LOG)
+    {
+        len = trace_append(size, len, snprintf(out, size, "[LOG]"));
+    }
+    else if (record->level == CSM_TRACE_LEVEL_ERR)
+    {
+        len = trace_append(size, len, snprintf(out, size, "[ERR]"));
+    }
+
+    while (*p != '\0')
+    {
+        if (*p != '%')
+        {
+            if (len < (size - 1U))
+            {
+                out[len++] = *p;
+                out[len] = '\0';
+            }
+            p++;
+        }
+        else
+        {
+            trace_spec spec;
+            p = trace_parse_spec(p, &spec);
+
+            if (spec.type == TRACE_ARG_COUNT)
+            {
+                arg++;
+            }
+            else if (spec.type != TRACE_ARG_NONE)
+            {
+                len = trace_format_spec(&spec, record, &arg, out, size, len);
+            }
+            else if (spec.conversion == '%')
+            {
+                len = trace_append(size, len, snprintf(&out[len], size - len, "%%"));
+            }
+        }
+    }
+
+    if (record->level != CSM_TRACE_LEVEL_TRACE)
+    {
+        len = trace_append(size, len, snprintf(&out[len], size - len, "\r\n"));
+    }
+
+    return len;
+}
+
+// Indexes in args[] of the %s arguments of a format string
+static uint32_t trace_string_args(const char *fmt, uint8_t nargs, uint8_t *indexes)
+{
+    uint32_t nb = 0U;
+    uint32_t arg = 0U;
+    const char *p = fmt;
+
+    while ((p = strchr(p, '%')) != NULL)
+    {
+        trace_spec spec;
+        p = trace_parse_spec(p, &spec);
+        arg += spec.stars;
+        if (spec.type != TRACE_ARG_NONE)
+        {
+            if ((spec.type == TRACE_ARG_STRING) && (arg < nargs))
+            {
+                indexes[nb++] = (uint8_t)arg;
+            }
+            arg++;
+        }
+    }
+    return nb;
+}
+
+void csm_trace_encoder_init(csm_trace_encoder *enc)
+{
+    memset(enc, 0, sizeof(*enc));
+}
+
+static uint32_t trace_sent_index(uint64_t address)
+{
+    // Multiplicative hash, the low bits of an address are often aligned
+    return (uint32_t)((address * 0x9E3779B97F4A7C15ULL) >> 56) & (CSM_TRACE_SENT_CACHE - 1U);
+}
+
+uint32_t csm_trace_encode(csm_trace_encoder *enc, const csm_trace_record *record, uint8_t *out, uint32_t size)
+{
+    uint64_t strings[1U + CSM_TRACE_MAX_ARGS];
+    uint32_t lengths[1U + CSM_TRACE_MAX_ARGS];
+    uint8_t indexes[CSM_TRACE_MAX_ARGS];
+    uint32_t nb_strings = 0U;
+    uint32_t nargs = (record->nargs < CSM_TRACE_MAX_ARGS) ? record->nargs : CSM_TRACE_MAX_ARGS;
+    uint32_t needed = (enc->started ? 0U : 5U) + 15U + (8U * nargs);
+    uint32_t nb_indexes;
+    uint32_t pos = 0U;
+
+    if (record->fmt == NULL)
+    {
+        return 0U;
+    }
+
+    // Strings to define first: the format, then the %s arguments, once each
+    nb_indexes = trace_string_args(record->fmt, (uint8_t)nargs, indexes);
+    for (uint32_t i = 0U; i <= nb_indexes; i++)
+    {
+        uint64_t address = (i == 0U) ? (uint64_t)(uintptr_t)record->fmt : record->args[indexes[i - 1U]];
+        int known = (address == 0U) || (enc->sent[trace_sent_index(address)] == address);
+
+        for (uint32_t j = 0U; (j < nb_strings) && !known; j++)
+        {
+            known = (strings[j] == address);
+        }
+        if (!known)
+        {
+            size_t length = strlen((const char *)(uintptr_t)address);
+            lengths[nb_strings] = (length < CSM_TRACE_MAX_STRING) ? (uint32_t)length : CSM_TRACE_MAX_STRING;
+            strings[nb_strings] = address;
+            needed += 11U + lengths[nb_strings];
+            nb_strings++;
+        }
+    }
+
+    if (needed > size)
+    {
+        return 0U;
+    }
+
+    if (!enc->started)
+    {
+        PUT_BE32(&out[pos], CSM_TRACE_MAGIC);
+        out[pos + 4U] = CSM_TRACE_VERSION;
+        pos += 5U;
+        enc->started = TRUE;
+    }
+
+    for (uint32_t i = 0U; i < nb_strings; i++)
+    {
+        out[pos] = 'S';
+        PUT_BE64(&out[pos + 1U], strings[i]);
+        PUT_BE16(&out[pos + 9U], (uint16_t)lengths[i]);
+        memcpy(&out[pos + 11U], (const void *)(uintptr_t)strings[i], lengths[i]);
+        pos += 11U + lengths[i];
+        enc->sent[trace_sent_index(strings[i])] = strings[i];
+    }
+
+    out[pos] = 'R';
+    PUT_BE32(&out[pos + 1U], record->timestamp);
+    PUT_BE64(&out[pos + 5U], (uint64_t)(uintptr_t)record->fmt);
+    out[pos + 13U] = record->level;
+    out[pos + 14U] = (uint8_t)nargs;
+    pos += 15U;
+    for (uint32_t i = 0U; i < nargs; i++)
+    {
+        PUT_BE64(&out[pos], record->args[i]);
+        pos += 8U;
+    }
+
+    return pos;
+}
+
+uint32_t csm_trace_drain(csm_trace_encoder *enc, uint8_t *out, uint32_t size)
+{
+    uint32_t pos = 0U;
+    uint32_t nb_rings = csm_trace_number_of_rings();
+    int full = FALSE;
+
+    for (uint32_t i = 0U; (i < nb_rings) && !full; i++)
+    {
+        csm_trace_ring *ring = ring_list[i];
+        uint32_t tail = ring->tail;
+
+        // Encoded in place: a record leaves the ring only once it fits in the output
+        while ((tail != ring->head) && !full)
+        {
+            uint32_t written;
+            CSM_BARRIER();
+            written = csm_trace_encode(enc, &ring->records[tail & (ring->size - 1U)], &out[pos], size - pos);
+            if (written > 0U)
+            {
+                pos += written;
+                tail++;
+                CSM_BARRIER();
+                ring->tail = tail;
+            }
+            else
+            {
+                full = TRUE;
+            }
+        }
+    }
+    return pos;
+}
+
+void csm_trace_decoder_init(csm_trace_decoder *dec, csm_trace_string *strings, uint32_t max_strings, char *text, uint32_t text_size)
+{
+    dec->strings = strings;
+    dec->max_strings = max_strings;
+    dec->nb_strings = 0U;
+    dec->text = text;
+    dec->text_size = text_size;
+    dec->text_used = 0U;
+    dec->started = FALSE;
+
+    for (uint32_t i = 0U; i < max_strings; i++)
+    {
+        strings[i].address = 0U;
+    }
+}
+
+// Open addressing table, the address 0 is the empty slot
+static csm_trace_string *trace_find_string(csm_trace_decoder *dec, uint64_t address)
+{
+    uint32_t mask = dec->max_strings - 1U;
+    uint32_t index = (uint32_t)((address * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    csm_trace_string *found = NULL;
+
+    for (uint32_t i = 0U; (i < dec->max_strings) && (found == NULL); i++)
+    {
+        csm_trace_string *entry = &dec->strings[(index + i) & mask];
+        if ((entry->address == address) || (entry->address == 0U))
+        {
+            found = entry;
+        }
+    }
+    return found;
+}
+
+static const char *trace_resolve(csm_trace_decoder *dec, uint64_t address)
+{
+    const char *str = "?";
+    csm_trace_string *entry = (address != 0U) ? trace_find_string(dec, address) : NULL;
+
+    if ((entry != NULL) && (entry->address == address))
+    {
+        str = &dec->text[entry->offset];
+    }
+    return str;
+}
+
+int csm_trace_decode(csm_trace_decoder *dec, const uint8_t *data, uint32_t size, uint32_t *pos, csm_trace_record *record)
+{
+    int ret = 0;
+    uint32_t p = *pos;
+
+    if (!dec->started && (p < size))
+    {
+        if (((size - p) < 5U) || (GET_BE32(&data[p]) != CSM_TRACE_MAGIC) || (data[p + 4U] != CSM_TRACE_VERSION))
+        {
+            return -1;
+        }
+        p += 5U;
+        dec->started = TRUE;
+    }
+
+    while ((p < size) && (ret == 0))
+    {
+        if (data[p] == 'S')
+        {
+            uint64_t address;
+            uint32_t length;
+            csm_trace_string *entry;
+
+            if ((size - p) < 11U)
+            {
+                ret = -1;
+                break;
+            }
+            address = GET_BE64(&data[p + 1U]);
+            length = GET_BE16(&data[p + 9U]);
+            if (((size - p - 11U) < length) || (address == 0U))
+            {
+                ret = -1;
+                break;
+            }
+
+            entry = trace_find_string(dec, address);
+            if (entry == NULL)
+            {
+                ret = -1;
+                break;
+            }
+            if (entry->address == 0U)
+            {
+                // Sent again after an eviction from the encoder cache: the first definition is kept
+                if (((dec->nb_strings + 1U) >= dec->max_strings) || ((dec->text_size - dec->text_used) <= length))
+                {
+                    ret = -1;
+                    break;
+                }
+                entry->address = address;
+                entry->offset = dec->text_used;
+                memcpy(&dec->text[dec->text_used], &data[p + 11U], length);
+                dec->text[dec->text_used + length] = '\0';
+                dec->text_used += length + 1U;
+                dec->nb_strings++;
+            }
+            p += 11U + length;
+        }
+        else if (data[p] == 'R')
+        {
+            uint8_t indexes[CSM_TRACE_MAX_ARGS];
+            uint32_t nargs;
+            uint32_t nb_indexes;
+
+            if ((size - p) < 15U)
+            {
+                ret = -1;
+                break;
+            }
+            nargs = data[p + 14U];
+            if ((nargs > CSM_TRACE_MAX_ARGS) || ((size - p - 15U) < (8U * nargs)))
+            {
+                ret = -1;
+                break;
+            }
+
+            record->timestamp = GET_BE32(&data[p + 1U]);
+            record->fmt = trace_resolve(dec, GET_BE64(&data[p + 5U]));
+            record->level = data[p + 13U];
+            record->nargs = (uint8_t)nargs;
+            for (uint32_t i = 0U; i < nargs; i++)
+            {
+                record->args[i] = GET_BE64(&data[p + 15U + (8U * i)]);
+            }
+
+            // The %s arguments become addresses in the decoder storage
+            nb_indexes = trace_string_args(record->fmt, (uint8_t)nargs, indexes);
+            for (uint32_t i = 0U; i < nb_indexes; i++)
+            {
+                uint64_t address = record->args[indexes[i]];
+                record->args[indexes[i]] = (address != 0U) ? (uint64_t)(uintptr_t)trace_resolve(dec, address) : 0U;
+            }
+
+            p += 15U + (8U * nargs);
+            ret = 1;
+        }
+        else
+        {
+            ret = -1;
+        }
+    }
+
+    // On error, pos is the offset of the invalid element
+    *pos = p;
+    return ret;
+}
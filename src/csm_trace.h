@@ -0,0 +1,138 @@
+/**
+ * Binary trace ring, used instead of printf when CSM_TRACE_USE_RING is defined
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_TRACE_H
+#define CSM_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifndef CSM_TRACE_MAX_ARGS
+#define CSM_TRACE_MAX_ARGS      4U
+#endif
+
+#ifndef CSM_TRACE_MAX_RINGS
+#define CSM_TRACE_MAX_RINGS     8U
+#endif
+
+#define CSM_TRACE_MAGIC         0x43534D54U     //!< "CSMT", start of a serialized trace
+#define CSM_TRACE_VERSION       1U
+#define CSM_TRACE_SENT_CACHE    256U            //!< Strings remembered by an encoder, power of two
+#define CSM_TRACE_MAX_STRING    1024U           //!< Longer strings are truncated in a serialized trace
+
+/**
+ * @brief One trace event, fixed size
+ *
+ * The format string is not copied nor formatted: only its address is stored, so the format string and
+ * any %s argument must live in ROM (string literals). The arguments are stored on 64 bits following
+ * their conversion: integers with their length modifier (l, ll, j, z, t), double bits for %f %e %g %a,
+ * addresses for %s and %p. Arguments beyond CSM_TRACE_MAX_ARGS are lost.
+ */
+typedef struct
+{
+    uint32_t timestamp;
+    uint8_t level;
+    uint8_t nargs;
+    const char *fmt;
+    uint64_t args[CSM_TRACE_MAX_ARGS];
+} csm_trace_record;
+
+/**
+ * @brief Single producer / single consumer ring of records
+ *
+ * Each producer thread owns its ring (see csm_trace_attach()), so the producer never takes a lock
+ * and never blocks: when the ring is full, the new record is dropped and counted.
+ */
+typedef struct
+{
+    csm_trace_record *records;
+    uint32_t size;          //!< Number of records, must be a power of two
+    volatile uint32_t head; //!< Next record to write, updated by the producer only
+    volatile uint32_t tail; //!< Next record to read, updated by the consumer only
+    volatile uint32_t dropped;
+} csm_trace_ring;
+
+typedef uint32_t (*csm_trace_clock)(void);
+
+void csm_trace_set_clock(csm_trace_clock clock);
+
+// Producer side: attach a ring to the calling thread, return FALSE if the registry is full
+int csm_trace_attach(csm_trace_ring *ring, csm_trace_record *records, uint32_t size);
+void csm_trace_write(uint8_t level, const char *fmt, ...);
+
+// Events written by the threads without a ring, lost
+uint32_t csm_trace_unattached_drops(void);
+
+// Consumer side, can run in any other thread
+uint32_t csm_trace_number_of_rings(void);
+csm_trace_ring *csm_trace_get_ring(uint32_t index);
+int csm_trace_read(csm_trace_ring *ring, csm_trace_record *record);
+
+// Format one record into a null terminated string, return the string length
+uint32_t csm_trace_format(const csm_trace_record *record, char *out, uint32_t size);
+
+/**
+ * Serialized trace, decoded offline by another process (see tracedump/):
+ *   magic (4) | version (1), then elements:
+ *   'S' | address (8) | length (2) | characters      definition of a format or %s string
+ *   'R' | timestamp (4) | format address (8) | level (1) | nargs (1) | args (8 each)
+ * Integers are big endian. A string is defined before the first record using it.
+ */
+typedef struct
+{
+    uint64_t sent[CSM_TRACE_SENT_CACHE];   //!< Addresses of the strings already written, direct mapped
+    int started;
+} csm_trace_encoder;
+
+void csm_trace_encoder_init(csm_trace_encoder *enc);
+
+// Serialize one record, preceded by the strings not sent yet; return the size written, 0 if out is too small
+uint32_t csm_trace_encode(csm_trace_encoder *enc, const csm_trace_record *record, uint8_t *out, uint32_t size);
+
+// Consumer side: serialize the pending records of all the rings, until out is full; return the size written
+uint32_t csm_trace_drain(csm_trace_encoder *enc, uint8_t *out, uint32_t size);
+
+typedef struct
+{
+    uint64_t address;
+    uint32_t offset;        //!< In the text storage of the decoder
+} csm_trace_string;
+
+typedef struct
+{
+    csm_trace_string *strings;
+    uint32_t max_strings;   //!< Power of two
+    uint32_t nb_strings;
+    char *text;
+    uint32_t text_size;
+    uint32_t text_used;
+    int started;
+} csm_trace_decoder;
+
+void csm_trace_decoder_init(csm_trace_decoder *dec, csm_trace_string *strings, uint32_t max_strings, char *text, uint32_t text_size);
+
+/**
+ * @brief Read the next record of a serialized trace
+ *
+ * The format and %s arguments point to the decoder storage, ready for csm_trace_format().
+ * An unknown string is replaced by "?".
+ * @return 1 for a record, 0 at the end of the data, -1 if the data is not valid or the storage is full
+ */
+int csm_trace_decode(csm_trace_decoder *dec, const uint8_t *data, uint32_t size, uint32_t *pos, csm_trace_record *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_TRACE_H
@@ -0,0 +1,1755 @@
+/**
+ * Translation of the APDUs to XML or JSON text, and back to binary
+ *
+ * Both directions walk the same description of the APDUs, so that a translated APDU is encoded
+ * back to the same bytes.
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "csm_translate.h"
+#include "csm_definitions.h"
+#include "csm_association.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+
+#define XLT_MAX_DEPTH       32U
+#define XLT_NO_CHOICE       0xFFU
+#define XLT_USER_INFO_TAG   0xBEU
+#define XLT_OCTET_STRING    0x04U   // BER universal tag of the user information content
+
+// ----------------------------------- GRAMMAR -----------------------------------
+
+enum xlt_type
+{
+    XLT_HEX,            //!< 'size' bytes
+    XLT_OPT_HEX,        //!< Optional: flag, then 'size' bytes
+    XLT_OPT_OCTETS,     //!< Optional: flag, then length and bytes
+    XLT_CONFORMANCE,    //!< [APPLICATION 31] bit string of 24 bits
+    XLT_DATA,           //!< Data
+    XLT_OPT_DATA,       //!< Optional: flag, then Data
+    XLT_SEQUENCE,       //!< 'size' sub-fields
+    XLT_OPT_SEQUENCE,   //!< Optional: flag, then the sub-fields
+    XLT_GET_RESULT,     //!< Get-Data-Result: Data or Data-Access-Result
+    XLT_OPT_GET_RESULT, //!< Optional: flag, then Get-Data-Result
+    XLT_RAW_RESULT,     //!< Raw data (octet-string) or Data-Access-Result
+    XLT_LIST            //!< Length, then items described by the single sub-field
+};
+
+typedef struct xlt_field
+{
+    const char *name;
+    uint8_t type;
+    uint8_t size;
+    const struct xlt_field *sub;
+} xlt_field;
+
+typedef struct
+{
+    uint8_t tag;
+    uint8_t choice;         //!< XLT_NO_CHOICE if the APDU has no variants
+    const char *service;
+    const char *variant;
+    const xlt_field *fields;
+    uint8_t nb_fields;
+} xlt_pdu;
+
+#define XLT_NB(array)   ((uint8_t)(sizeof(array) / sizeof(array[0])))
+
+static const xlt_field cInvokeId = { "InvokeIdAndPriority", XLT_HEX, 1U, NULL };
+
+static const xlt_field cAttributeDescriptor[] =
+{
+    { "ClassId", XLT_HEX, 2U, NULL },
+    { "InstanceId", XLT_HEX, 6U, NULL },
+    { "AttributeId", XLT_HEX, 1U, NULL }
+};
+
+static const xlt_field cMethodDescriptor[] =
+{
+    { "ClassId", XLT_HEX, 2U, NULL },
+    { "InstanceId", XLT_HEX, 6U, NULL },
+    { "MethodId", XLT_HEX, 1U, NULL }
+};
+
+static const xlt_field cAccessSelection[] =
+{
+    { "AccessSelector", XLT_HEX, 1U, NULL },
+    { "AccessParameters", XLT_DATA, 0U, NULL }
+};
+
+static const xlt_field cDescriptorWithSelection[] =
+{
+    { "AttributeDescriptor", XLT_SEQUENCE, XLT_NB(cAttributeDescriptor), cAttributeDescriptor },
+    { "AccessSelection", XLT_OPT_SEQUENCE, XLT_NB(cAccessSelection), cAccessSelection }
+};
+
+static const xlt_field cDescriptorItem[] =
+{
+    { "_AttributeDescriptorWithSelection", XLT_SEQUENCE, XLT_NB(cDescriptorWithSelection), cDescriptorWithSelection }
+};
+
+static const xlt_field cResultItem[] =
+{
+    { "_Result", XLT_GET_RESULT, 0U, NULL }
+};
+
+static const xlt_field cDataBlock[] =
+{
+    { "LastBlock", XLT_HEX, 1U, NULL },
+    { "BlockNumber", XLT_HEX, 4U, NULL },
+    { "Result", XLT_RAW_RESULT, 0U, NULL }
+};
+
+static const xlt_field cGetRequestNormal[] =
+{
+    cInvokeId,
+    { "AttributeDescriptor", XLT_SEQUENCE, XLT_NB(cAttributeDescriptor), cAttributeDescriptor },
+    { "AccessSelection", XLT_OPT_SEQUENCE, XLT_NB(cAccessSelection), cAccessSelection }
+};
+
+static const xlt_field cGetRequestNext[] =
+{
+    cInvokeId,
+    { "BlockNumber", XLT_HEX, 4U, NULL }
+};
+
+static const xlt_field cGetRequestWithList[] =
+{
+    cInvokeId,
+    { "AttributeDescriptorList", XLT_LIST, 1U, cDescriptorItem }
+};
+
+static const xlt_field cGetResponseNormal[] =
+{
+    cInvokeId,
+    { "Result", XLT_GET_RESULT, 0U, NULL }
+};
+
+static const xlt_field cGetResponseWithDatablock[] =
+{
+    cInvokeId,
+    { "Result", XLT_SEQUENCE, XLT_NB(cDataBlock), cDataBlock }
+};
+
+static const xlt_field cGetResponseWithList[] =
+{
+    cInvokeId,
+    { "Result", XLT_LIST, 1U, cResultItem }
+};
+
+static const xlt_field cSetRequestNormal[] =
+{
+    cInvokeId,
+    { "AttributeDescriptor", XLT_SEQUENCE, XLT_NB(cAttributeDescriptor), cAttributeDescriptor },
+    { "AccessSelection", XLT_OPT_SEQUENCE, XLT_NB(cAccessSelection), cAccessSelection },
+    { "Value", XLT_DATA, 0U, NULL }
+};
+
+static const xlt_field cSetResponseNormal[] =
+{
+    cInvokeId,
+    { "Result", XLT_HEX, 1U, NULL }
+};
+
+static const xlt_field cActionRequestNormal[] =
+{
+    cInvokeId,
+    { "MethodDescriptor", XLT_SEQUENCE, XLT_NB(cMethodDescriptor), cMethodDescriptor },
+    { "MethodInvocationParameters", XLT_OPT_DATA, 0U, NULL }
+};
+
+static const xlt_field cActionResponseNormal[] =
+{
+    cInvokeId,
+    { "Result", XLT_HEX, 1U, NULL },
+    { "ReturnParameters", XLT_OPT_GET_RESULT, 0U, NULL }
+};
+
+static const xlt_field cExceptionResponse[] =
+{
+    { "StateError", XLT_HEX, 1U, NULL },
+    { "ServiceError", XLT_HEX, 1U, NULL }
+};
+
+static const xlt_pdu cPdus[] =
+{
+    { AXDR_GET_REQUEST, 1U, "GetRequest", "GetRequestNormal", cGetRequestNormal, XLT_NB(cGetRequestNormal) },
+    { AXDR_GET_REQUEST, 2U, "GetRequest", "GetRequestNext", cGetRequestNext, XLT_NB(cGetRequestNext) },
+    { AXDR_GET_REQUEST, 3U, "GetRequest", "GetRequestWithList", cGetRequestWithList, XLT_NB(cGetRequestWithList) },
+    { AXDR_GET_RESPONSE, 1U, "GetResponse", "GetResponseNormal", cGetResponseNormal, XLT_NB(cGetResponseNormal) },
+    { AXDR_GET_RESPONSE, 2U, "GetResponse", "GetResponseWithDatablock", cGetResponseWithDatablock, XLT_NB(cGetResponseWithDatablock) },
+    { AXDR_GET_RESPONSE, 3U, "GetResponse", "GetResponseWithList", cGetResponseWithList, XLT_NB(cGetResponseWithList) },
+    { AXDR_SET_REQUEST, 1U, "SetRequest", "SetRequestNormal", cSetRequestNormal, XLT_NB(cSetRequestNormal) },
+    { AXDR_SET_RESPONSE, 1U, "SetResponse", "SetResponseNormal", cSetResponseNormal, XLT_NB(cSetResponseNormal) },
+    { AXDR_ACTION_REQUEST, 1U, "ActionRequest", "ActionRequestNormal", cActionRequestNormal, XLT_NB(cActionRequestNormal) },
+    { AXDR_ACTION_RESPONSE, 1U, "ActionResponse", "ActionResponseNormal", cActionResponseNormal, XLT_NB(cActionResponseNormal) },
+    { AXDR_EXCEPTION_RESPONSE, XLT_NO_CHOICE, "ExceptionResponse", NULL, cExceptionResponse, XLT_NB(cExceptionResponse) }
+};
+
+// xDLMS initiate, only found in the user information of the ACSE APDUs
+static const xlt_field cInitiateRequest[] =
+{
+    { "DedicatedKey", XLT_OPT_OCTETS, 0U, NULL },
+    { "ResponseAllowed", XLT_OPT_HEX, 1U, NULL },
+    { "ProposedQualityOfService", XLT_OPT_HEX, 1U, NULL },
+    { "ProposedDlmsVersionNumber", XLT_HEX, 1U, NULL },
+    { "ProposedConformance", XLT_CONFORMANCE, 0U, NULL },
+    { "ProposedMaxPduSize", XLT_HEX, 2U, NULL }
+};
+
+static const xlt_field cInitiateResponse[] =
+{
+    { "NegotiatedQualityOfService", XLT_OPT_HEX, 1U, NULL },
+    { "NegotiatedDlmsVersionNumber", XLT_HEX, 1U, NULL },
+    { "NegotiatedConformance", XLT_CONFORMANCE, 0U, NULL },
+    { "NegotiatedMaxPduSize", XLT_HEX, 2U, NULL },
+    { "VaaName", XLT_HEX, 2U, NULL }
+};
+
+static const xlt_pdu cInitiates[] =
+{
+    { AXDR_INITIATE_REQUEST, XLT_NO_CHOICE, "InitiateRequest", NULL, cInitiateRequest, XLT_NB(cInitiateRequest) },
+    { AXDR_INITIATE_RESPONSE, XLT_NO_CHOICE, "InitiateResponse", NULL, cInitiateResponse, XLT_NB(cInitiateResponse) }
+};
+
+// ACSE APDUs: BER elements, the value is the content of the element
+typedef struct
+{
+    uint8_t tag;
+    const char *name;
+} xlt_element;
+
+typedef struct
+{
+    uint8_t tag;
+    const char *name;
+    const xlt_element *elements;
+    uint8_t nb_elements;
+} xlt_acse;
+
+static const xlt_element cAarqElements[] =
+{
+    { 0x80U, "ProtocolVersion" },
+    { 0xA1U, "ApplicationContextName" },
+    { 0xA2U, "CalledAPTitle" },
+    { 0xA3U, "CalledAEQualifier" },
+    { 0xA4U, "CalledAPInvocationId" },
+    { 0xA5U, "CalledAEInvocationId" },
+    { 0xA6U, "CallingAPTitle" },
+    { 0xA7U, "CallingAEQualifier" },
+    { 0xA8U, "CallingAPInvocationId" },
+    { 0xA9U, "CallingAEInvocationId" },
+    { 0x8AU, "SenderACSERequirements" },
+    { 0x8BU, "MechanismName" },
+    { 0xACU, "CallingAuthentication" },
+    { 0xBDU, "ImplementationInformation" },
+    { XLT_USER_INFO_TAG, "UserInformation" }
+};
+
+static const xlt_element cAareElements[] =
+{
+    { 0x80U, "ProtocolVersion" },
+    { 0xA1U, "ApplicationContextName" },
+    { 0xA2U, "AssociationResult" },
+    { 0xA3U, "ResultSourceDiagnostic" },
+    { 0xA4U, "RespondingAPTitle" },
+    { 0xA5U, "RespondingAEQualifier" },
+    { 0xA6U, "RespondingAPInvocationId" },
+    { 0xA7U, "RespondingAEInvocationId" },
+    { 0x88U, "ResponderACSERequirements" },
+    { 0x89U, "MechanismName" },
+    { 0xAAU, "RespondingAuthentication" },
+    { 0xBDU, "ImplementationInformation" },
+    { XLT_USER_INFO_TAG, "UserInformation" }
+};
+
+static const xlt_element cReleaseElements[] =
+{
+    { 0x80U, "Reason" },
+    { XLT_USER_INFO_TAG, "UserInformation" }
+};
+
+static const xlt_acse cAcses[] =
+{
+    { CSM_ASSO_AARQ, "AssociationRequest", cAarqElements, XLT_NB(cAarqElements) },
+    { CSM_ASSO_AARE, "AssociationResponse", cAareElements, XLT_NB(cAareElements) },
+    { CSM_ASSO_RLRQ, "ReleaseRequest", cReleaseElements, XLT_NB(cReleaseElements) },
+    { CSM_ASSO_RLRE, "ReleaseResponse", cReleaseElements, XLT_NB(cReleaseElements) }
+};
+
+// A-XDR data types
+enum xlt_value { XLT_VAL_NONE, XLT_VAL_HEX, XLT_VAL_SIZED_HEX, XLT_VAL_TEXT, XLT_VAL_BITS, XLT_VAL_CONTAINER };
+
+typedef struct
+{
+    uint8_t tag;
+    uint8_t value;
+    uint8_t size;       //!< XLT_VAL_HEX
+    const char *name;
+} xlt_data_type;
+
+static const xlt_data_type cDataTypes[] =
+{
+    { AXDR_TAG_NULL, XLT_VAL_NONE, 0U, "Null" },
+    { AXDR_TAG_ARRAY, XLT_VAL_CONTAINER, 0U, "Array" },
+    { AXDR_TAG_STRUCTURE, XLT_VAL_CONTAINER, 0U, "Structure" },
+    { AXDR_TAG_BOOLEAN, XLT_VAL_HEX, 1U, "Boolean" },
+    { AXDR_TAG_BITSTRING, XLT_VAL_BITS, 0U, "BitString" },
+    { AXDR_TAG_INTEGER32, XLT_VAL_HEX, 4U, "Int32" },
+    { AXDR_TAG_UNSIGNED32, XLT_VAL_HEX, 4U, "UInt32" },
+    { AXDR_TAG_OCTETSTRING, XLT_VAL_SIZED_HEX, 0U, "OctetString" },
+    { AXDR_TAG_VISIBLESTRING, XLT_VAL_TEXT, 0U, "String" },
+    { AXDR_TAG_UTF8_STRING, XLT_VAL_SIZED_HEX, 0U, "Utf8String" },
+    { AXDR_TAG_BCD, XLT_VAL_HEX, 1U, "Bcd" },
+    { AXDR_TAG_INTEGER8, XLT_VAL_HEX, 1U, "Int8" },
+    { AXDR_TAG_INTEGER16, XLT_VAL_HEX, 2U, "Int16" },
+    { AXDR_TAG_UNSIGNED8, XLT_VAL_HEX, 1U, "UInt8" },
+    { AXDR_TAG_UNSIGNED16, XLT_VAL_HEX, 2U, "UInt16" },
+    { AXDR_TAG_INTEGER64, XLT_VAL_HEX, 8U, "Int64" },
+    { AXDR_TAG_UNSIGNED64, XLT_VAL_HEX, 8U, "UInt64" },
+    { AXDR_TAG_ENUM, XLT_VAL_HEX, 1U, "Enum" },
+    { 23U, XLT_VAL_HEX, 4U, "Float32" },
+    { 24U, XLT_VAL_HEX, 8U, "Float64" },
+    { 25U, XLT_VAL_HEX, 12U, "DateTime" },
+    { 26U, XLT_VAL_HEX, 5U, "Date" },
+    { 27U, XLT_VAL_HEX, 4U, "Time" }
+};
+
+// Indexed by tag, 0 if the type is not supported (index + 1 in cDataTypes otherwise)
+static uint8_t data_type_index[256];
+static int data_type_ready = FALSE;
+
+static const xlt_data_type *xlt_data_type_get(uint8_t tag)
+{
+    if (!data_type_ready)
+    {
+        // Idempotent, concurrent first calls write the same values
+        for (uint32_t i = 0U; i < XLT_NB(cDataTypes); i++)
+        {
+            data_type_index[cDataTypes[i].tag] = (uint8_t)(i + 1U);
+        }
+        data_type_ready = TRUE;
+    }
+    return (data_type_index[tag] != 0U) ? &cDataTypes[data_type_index[tag] - 1U] : NULL;
+}
+
+// ----------------------------------- TEXT OUTPUT -----------------------------------
+
+static const char cHexDigits[] = "0123456789ABCDEF";
+
+typedef struct
+{
+    csm_text *text;
+    enum csm_text_format format;
+    uint32_t depth;
+    uint8_t first[XLT_MAX_DEPTH + 1U];      //!< JSON: no separator before the next node of this level
+} xlt_out;
+
+void csm_text_init(csm_text *text, char *buffer, uint32_t capacity, csm_text_grow grow)
+{
+    text->data = buffer;
+    text->size = 0U;
+    text->capacity = capacity;
+    text->grow = grow;
+    text->error = FALSE;
+}
+
+static int text_reserve(csm_text *text, uint32_t size)
+{
+    if (!text->error && ((text->size + size) > text->capacity))
+    {
+        if ((text->grow == NULL) || !text->grow(text, text->size + size))
+        {
+            text->error = TRUE;
+        }
+    }
+    return !text->error;
+}
+
+static void text_put(csm_text *text, const char *str, uint32_t size)
+{
+    if (text_reserve(text, size))
+    {
+        memcpy(&text->data[text->size], str, size);
+        text->size += size;
+    }
+}
+
+int csm_text_append(csm_text *text, const char *str, uint32_t size)
+{
+    text_put(text, str, size);
+    return !text->error;
+}
+
+static void text_puts(csm_text *text, const char *str)
+{
+    text_put(text, str, (uint32_t)strlen(str));
+}
+
+static void text_hex(csm_text *text, const uint8_t *data, uint32_t size)
+{
+    if (text_reserve(text, size * 2U))
+    {
+        char *out = &text->data[text->size];
+        for (uint32_t i = 0U; i < size; i++)
+        {
+            out[2U * i] = cHexDigits[data[i] >> 4U];
+            out[(2U * i) + 1U] = cHexDigits[data[i] & 0x0FU];
+        }
+        text->size += size * 2U;
+    }
+}
+
+static void text_escaped(csm_text *text, enum csm_text_format format, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        char c = (char)data[i];
+        if (format == CSM_TEXT_XML)
+        {
+            switch (c)
+            {
+            case '<': text_put(text, "&lt;", 4U); break;
+            case '>': text_put(text, "&gt;", 4U); break;
+            case '&': text_put(text, "&amp;", 5U); break;
+            case '"': text_put(text, "&quot;", 6U); break;
+            default:
+                if ((data[i] < 0x20U) || (data[i] >= 0x7FU))
+                {
+                    char ref[6] = { '&', '#', 'x', cHexDigits[data[i] >> 4U], cHexDigits[data[i] & 0x0FU], ';' };
+                    text_put(text, ref, 6U);
+                }
+                else
+                {
+                    text_put(text, &c, 1U);
+                }
+                break;
+            }
+        }
+        else if ((c == '"') || (c == '\\'))
+        {
+            char escape[2] = { '\\', c };
+            text_put(text, escape, 2U);
+        }
+        else if ((data[i] < 0x20U) || (data[i] >= 0x7FU))
+        {
+            char escape[6] = { '\\', 'u', '0', '0', cHexDigits[data[i] >> 4U], cHexDigits[data[i] & 0x0FU] };
+            text_put(text, escape, 6U);
+        }
+        else
+        {
+            text_put(text, &c, 1U);
+        }
+    }
+}
+
+static void xlt_indent(xlt_out *out)
+{
+    static const char cSpaces[] = "                                                                ";
+    uint32_t n = out->depth * 2U;
+
+    text_put(out->text, cSpaces, (n < (sizeof(cSpaces) - 1U)) ? n : (uint32_t)(sizeof(cSpaces) - 1U));
+}
+
+// JSON: comma between the nodes of a level
+static void xlt_separator(xlt_out *out)
+{
+    if (!out->first[out->depth])
+    {
+        text_put(out->text, ",", 1U);
+    }
+    out->first[out->depth] = FALSE;
+}
+
+static int xlt_open(xlt_out *out, const char *name, uint32_t quantity, int has_quantity)
+{
+    int valid = (out->depth < XLT_MAX_DEPTH);
+
+    if (valid && (out->format == CSM_TEXT_XML))
+    {
+        xlt_indent(out);
+        text_put(out->text, "<", 1U);
+        text_puts(out->text, name);
+        if (has_quantity)
+        {
+            uint8_t qty[2] = { (uint8_t)(quantity >> 8U), (uint8_t)quantity };
+            text_put(out->text, " Qty=\"", 6U);
+            text_hex(out->text, (quantity > 0xFFU) ? qty : &qty[1], (quantity > 0xFFU) ? 2U : 1U);
+            text_put(out->text, "\">\n", 3U);
+        }
+        else
+        {
+            text_put(out->text, ">\n", 2U);
+        }
+    }
+    else if (valid)
+    {
+        xlt_separator(out);
+        text_put(out->text, "{\"", 2U);
+        text_puts(out->text, name);
+        text_put(out->text, "\":[", 3U);
+    }
+
+    if (valid)
+    {
+        out->depth++;
+        out->first[out->depth] = TRUE;
+    }
+    return valid;
+}
+
+static void xlt_close(xlt_out *out, const char *name)
+{
+    out->depth--;
+    if (out->format == CSM_TEXT_XML)
+    {
+        xlt_indent(out);
+        text_put(out->text, "</", 2U);
+        text_puts(out->text, name);
+        text_put(out->text, ">\n", 2U);
+    }
+    else
+    {
+        text_put(out->text, "]}", 2U);
+    }
+}
+
+static void xlt_leaf_begin(xlt_out *out, const char *name)
+{
+    if (out->format == CSM_TEXT_XML)
+    {
+        xlt_indent(out);
+        text_put(out->text, "<", 1U);
+        text_puts(out->text, name);
+        text_put(out->text, " Value=\"", 8U);
+    }
+    else
+    {
+        xlt_separator(out);
+        text_put(out->text, "{\"", 2U);
+        text_puts(out->text, name);
+        text_put(out->text, "\":\"", 3U);
+    }
+}
+
+static void xlt_leaf_end(xlt_out *out)
+{
+    if (out->format == CSM_TEXT_XML)
+    {
+        text_put(out->text, "\" />\n", 5U);
+    }
+    else
+    {
+        text_put(out->text, "\"}", 2U);
+    }
+}
+
+static void xlt_leaf_hex(xlt_out *out, const char *name, const uint8_t *data, uint32_t size)
+{
+    xlt_leaf_begin(out, name);
+    text_hex(out->text, data, size);
+    xlt_leaf_end(out);
+}
+
+static void xlt_empty(xlt_out *out, const char *name)
+{
+    if (out->format == CSM_TEXT_XML)
+    {
+        xlt_indent(out);
+        text_put(out->text, "<", 1U);
+        text_puts(out->text, name);
+        text_put(out->text, " />\n", 4U);
+    }
+    else
+    {
+        xlt_separator(out);
+        text_put(out->text, "{\"", 2U);
+        text_puts(out->text, name);
+        text_put(out->text, "\":null}", 7U);
+    }
+}
+
+// ----------------------------------- BINARY TO TEXT -----------------------------------
+
+static int xlt_read_length(csm_array *in, uint32_t *length)
+{
+    ber_length len;
+    int valid = csm_ber_read_len(in, &len);
+    valid = valid && (len.length <= csm_array_unread(in));
+    *length = len.length;
+    return valid;
+}
+
+// Leaf of 'size' bytes read from the input
+static int xlt_hex_field(xlt_out *out, csm_array *in, const char *name, uint32_t size)
+{
+    const uint8_t *data = csm_array_rd_data(in);
+    int valid = (csm_array_unread(in) >= size);
+
+    if (valid)
+    {
+        xlt_leaf_hex(out, name, data, size);
+        valid = csm_array_reader_jump(in, size);
+    }
+    return valid;
+}
+
+static int xlt_data_to_text(xlt_out *out, csm_array *in)
+{
+    uint8_t tag = 0U;
+    uint32_t size = 0U;
+    int valid = csm_array_read_u8(in, &tag);
+    const xlt_data_type *type = valid ? xlt_data_type_get(tag) : NULL;
+
+    valid = (type != NULL);
+    if (valid)
+    {
+        switch (type->value)
+        {
+        case XLT_VAL_NONE:
+            xlt_empty(out, type->name);
+            break;
+        case XLT_VAL_CONTAINER:
+            valid = xlt_read_length(in, &size) && xlt_open(out, type->name, size, TRUE);
+            for (uint32_t i = 0U; valid && (i < size); i++)
+            {
+                valid = xlt_data_to_text(out, in);
+            }
+            if (valid)
+            {
+                xlt_close(out, type->name);
+            }
+            break;
+        case XLT_VAL_HEX:
+            valid = xlt_hex_field(out, in, type->name, type->size);
+            break;
+        case XLT_VAL_SIZED_HEX:
+            valid = xlt_read_length(in, &size) && xlt_hex_field(out, in, type->name, size);
+            break;
+        case XLT_VAL_TEXT:
+            valid = xlt_read_length(in, &size);
+            if (valid)
+            {
+                xlt_leaf_begin(out, type->name);
+                text_escaped(out->text, out->format, csm_array_rd_data(in), size);
+                xlt_leaf_end(out);
+                valid = csm_array_reader_jump(in, size);
+            }
+            break;
+        case XLT_VAL_BITS:
+        default:
+        {
+            // The length is in bits
+            ber_length len;
+            valid = csm_ber_read_len(in, &len);
+            size = len.length;
+            valid = valid && ((size == 0U) || (BITFIELD_BYTES(size) <= csm_array_unread(in)));
+            if (valid)
+            {
+                const uint8_t *bits = csm_array_rd_data(in);
+                xlt_leaf_begin(out, type->name);
+                for (uint32_t i = 0U; i < size; i++)
+                {
+                    text_put(out->text, ((bits[i / 8U] >> (7U - (i % 8U))) & 1U) ? "1" : "0", 1U);
+                }
+                xlt_leaf_end(out);
+                valid = (size == 0U) || csm_array_reader_jump(in, BITFIELD_BYTES(size));
+            }
+            break;
+        }
+        }
+    }
+    return valid;
+}
+
+// Optional elements start with a flag: 0 absent, 1 present
+static int xlt_read_flag(csm_array *in, uint8_t *flag)
+{
+    return csm_array_read_u8(in, flag) && (*flag <= 1U);
+}
+
+static int xlt_fields_to_text(xlt_out *out, csm_array *in, const xlt_field *fields, uint32_t nb_fields);
+
+static int xlt_get_result_to_text(xlt_out *out, csm_array *in, const char *name)
+{
+    uint8_t choice = 0xFFU;
+    int valid = xlt_read_flag(in, &choice) && xlt_open(out, name, 0U, FALSE);
+
+    if (valid && (choice == 0U))
+    {
+        valid = xlt_open(out, "Data", 0U, FALSE) && xlt_data_to_text(out, in);
+        if (valid)
+        {
+            xlt_close(out, "Data");
+        }
+    }
+    else if (valid)
+    {
+        valid = xlt_hex_field(out, in, "DataAccessError", 1U);
+    }
+
+    if (valid)
+    {
+        xlt_close(out, name);
+    }
+    return valid;
+}
+
+static int xlt_field_to_text(xlt_out *out, csm_array *in, const xlt_field *field)
+{
+    uint8_t flag = 1U;
+    uint32_t size = 0U;
+    int valid = TRUE;
+
+    switch (field->type)
+    {
+    case XLT_HEX:
+        valid = xlt_hex_field(out, in, field->name, field->size);
+        break;
+    case XLT_OPT_HEX:
+        valid = xlt_read_flag(in, &flag);
+        valid = valid && ((flag == 0U) || xlt_hex_field(out, in, field->name, field->size));
+        break;
+    case XLT_OPT_OCTETS:
+        valid = xlt_read_flag(in, &flag);
+        valid = valid && ((flag == 0U) || (xlt_read_length(in, &size) && xlt_hex_field(out, in, field->name, size)));
+        break;
+    case XLT_CONFORMANCE:
+    {
+        // 5F 1F (tag), 04 (length), 00 (unused bits), then 24 bits
+        const uint8_t *data = csm_array_rd_data(in);
+        valid = (csm_array_unread(in) >= 7U) && (data[0] == 0x5FU) && (data[1] == 0x1FU) && (data[2] == 0x04U) && (data[3] == 0x00U);
+        valid = valid && csm_array_reader_jump(in, 4U) && xlt_hex_field(out, in, field->name, 3U);
+        break;
+    }
+    case XLT_OPT_DATA:
+    case XLT_DATA:
+        if (field->type == XLT_OPT_DATA)
+        {
+            valid = xlt_read_flag(in, &flag);
+        }
+        if (valid && (flag == 1U))
+        {
+            valid = xlt_open(out, field->name, 0U, FALSE) && xlt_data_to_text(out, in);
+            if (valid)
+            {
+                xlt_close(out, field->name);
+            }
+        }
+        break;
+    case XLT_OPT_SEQUENCE:
+    case XLT_SEQUENCE:
+        if (field->type == XLT_OPT_SEQUENCE)
+        {
+            valid = xlt_read_flag(in, &flag);
+        }
+        if (valid && (flag == 1U))
+        {
+            valid = xlt_open(out, field->name, 0U, FALSE) && xlt_fields_to_text(out, in, field->sub, field->size);
+            if (valid)
+            {
+                xlt_close(out, field->name);
+            }
+        }
+        break;
+    case XLT_OPT_GET_RESULT:
+    case XLT_GET_RESULT:
+        if (field->type == XLT_OPT_GET_RESULT)
+        {
+            valid = xlt_read_flag(in, &flag);
+        }
+        valid = valid && ((flag == 0U) || xlt_get_result_to_text(out, in, field->name));
+        break;
+    case XLT_RAW_RESULT:
+        valid = xlt_read_flag(in, &flag) && xlt_open(out, field->name, 0U, FALSE);
+        if (valid)
+        {
+            if (flag == 0U)
+            {
+                valid = xlt_read_length(in, &size) && xlt_hex_field(out, in, "RawData", size);
+            }
+            else
+            {
+                valid = xlt_hex_field(out, in, "DataAccessError", 1U);
+            }
+        }
+        if (valid)
+        {
+            xlt_close(out, field->name);
+        }
+        break;
+    case XLT_LIST:
+    default:
+        valid = xlt_read_length(in, &size) && xlt_open(out, field->name, size, TRUE);
+        for (uint32_t i = 0U; valid && (i < size); i++)
+        {
+            valid = xlt_fields_to_text(out, in, field->sub, 1U);
+        }
+        if (valid)
+        {
+            xlt_close(out, field->name);
+        }
+        break;
+    }
+    return valid;
+}
+
+static int xlt_fields_to_text(xlt_out *out, csm_array *in, const xlt_field *fields, uint32_t nb_fields)
+{
+    int valid = TRUE;
+
+    for (uint32_t i = 0U; valid && (i < nb_fields); i++)
+    {
+        valid = xlt_field_to_text(out, in, &fields[i]);
+    }
+    return valid;
+}
+
+static const xlt_pdu *xlt_find_pdu(const xlt_pdu *pdus, uint32_t nb_pdus, uint8_t tag, uint8_t choice)
+{
+    const xlt_pdu *pdu = NULL;
+
+    for (uint32_t i = 0U; i < nb_pdus; i++)
+    {
+        if ((pdus[i].tag == tag) && ((pdus[i].choice == XLT_NO_CHOICE) || (pdus[i].choice == choice)))
+        {
+            pdu = &pdus[i];
+            break;
+        }
+    }
+    return pdu;
+}
+
+static int xlt_pdu_to_text(xlt_out *out, csm_array *in, const xlt_pdu *pdus, uint32_t nb_pdus)
+{
+    const uint8_t *data = csm_array_rd_data(in);
+    uint32_t unread = csm_array_unread(in);
+    const xlt_pdu *pdu = (unread >= 2U) ? xlt_find_pdu(pdus, nb_pdus, data[0], data[1]) : NULL;
+    int valid = (pdu != NULL);
+
+    if (valid)
+    {
+        valid = csm_array_reader_jump(in, (pdu->choice == XLT_NO_CHOICE) ? 1U : 2U);
+        valid = valid && xlt_open(out, pdu->service, 0U, FALSE);
+        if (valid && (pdu->variant != NULL))
+        {
+            valid = xlt_open(out, pdu->variant, 0U, FALSE);
+        }
+        valid = valid && xlt_fields_to_text(out, in, pdu->fields, pdu->nb_fields);
+        if (valid && (pdu->variant != NULL))
+        {
+            xlt_close(out, pdu->variant);
+        }
+        if (valid)
+        {
+            xlt_close(out, pdu->service);
+        }
+    }
+    return valid;
+}
+
+// 04 len InitiateRequest/InitiateResponse, written as a leaf if it is ciphered or unknown
+static int xlt_user_info_to_text(xlt_out *out, const uint8_t *content, uint32_t size, const char *name)
+{
+    xlt_out saved = *out;
+    uint32_t mark = out->text->size;
+    csm_array in;
+    uint32_t length = 0U;
+    uint8_t tag = 0U;
+
+    csm_array_init(&in, (uint8_t *)content, size, size, 0U);
+    int valid = csm_array_read_u8(&in, &tag) && (tag == XLT_OCTET_STRING);
+    valid = valid && xlt_read_length(&in, &length) && (length == csm_array_unread(&in));
+    valid = valid && xlt_open(out, name, 0U, FALSE) && xlt_pdu_to_text(out, &in, cInitiates, XLT_NB(cInitiates));
+    valid = valid && (csm_array_unread(&in) == 0U);
+
+    if (valid)
+    {
+        xlt_close(out, name);
+    }
+    else if (!out->text->error)
+    {
+        *out = saved;
+        out->text->size = mark;
+        xlt_leaf_hex(out, name, content, size);
+        valid = TRUE;
+    }
+    return valid;
+}
+
+static int xlt_acse_to_text(xlt_out *out, csm_array *in, const xlt_acse *acse)
+{
+    uint32_t length = 0U;
+    int valid = csm_array_reader_jump(in, 1U) && xlt_read_length(in, &length) && (length == csm_array_unread(in));
+
+    valid = valid && xlt_open(out, acse->name, 0U, FALSE);
+    while (valid && (csm_array_unread(in) > 0U))
+    {
+        uint8_t tag = 0U;
+        const char *name = NULL;
+
+        valid = csm_array_read_u8(in, &tag) && xlt_read_length(in, &length);
+        for (uint32_t i = 0U; valid && (i < acse->nb_elements); i++)
+        {
+            if (acse->elements[i].tag == tag)
+            {
+                name = acse->elements[i].name;
+                break;
+            }
+        }
+        valid = valid && (name != NULL);
+
+        if (valid && (tag == XLT_USER_INFO_TAG))
+        {
+            valid = xlt_user_info_to_text(out, csm_array_rd_data(in), length, name) && csm_array_reader_jump(in, length);
+        }
+        else if (valid)
+        {
+            valid = xlt_hex_field(out, in, name, length);
+        }
+    }
+
+    if (valid)
+    {
+        xlt_close(out, acse->name);
+    }
+    return valid;
+}
+
+int csm_translate_to_text(csm_text *text, enum csm_text_format format, const uint8_t *apdu, uint32_t size)
+{
+    xlt_out out;
+    csm_array in;
+    uint32_t mark = text->size;
+    int valid = (size > 0U);
+
+    out.text = text;
+    out.format = format;
+    out.depth = 0U;
+    out.first[0] = TRUE;
+
+    // Read only, the array API has no const version
+    csm_array_init(&in, (uint8_t *)apdu, size, size, 0U);
+
+    if (valid)
+    {
+        const xlt_acse *acse = NULL;
+        for (uint32_t i = 0U; i < XLT_NB(cAcses); i++)
+        {
+            if (cAcses[i].tag == apdu[0])
+            {
+                acse = &cAcses[i];
+                break;
+            }
+        }
+        valid = (acse != NULL) ? xlt_acse_to_text(&out, &in, acse) : xlt_pdu_to_text(&out, &in, cPdus, XLT_NB(cPdus));
+        valid = valid && (csm_array_unread(&in) == 0U);
+    }
+
+    if (!valid && !text->error)
+    {
+        out.depth = 0U;
+        out.first[0] = TRUE;
+        text->size = mark;
+        xlt_leaf_hex(&out, "Raw", apdu, size);
+    }
+    if (format == CSM_TEXT_JSON)
+    {
+        text_put(text, "\n", 1U);
+    }
+    return !text->error;
+}
+
+// ----------------------------------- TEXT PARSER -----------------------------------
+
+typedef struct
+{
+    const char *text;
+    uint32_t size;
+    uint32_t pos;
+    csm_text_tree *tree;
+} xlt_parser;
+
+static int xlt_is_space(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static int xlt_is_name(char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) || (c == '_');
+}
+
+static int xlt_starts_with(const xlt_parser *p, const char *str)
+{
+    uint32_t len = (uint32_t)strlen(str);
+    return ((p->pos + len) <= p->size) && (memcmp(&p->text[p->pos], str, len) == 0);
+}
+
+// Skip to the character after 'str', FALSE if not found
+static int xlt_skip_past(xlt_parser *p, const char *str)
+{
+    while ((p->pos < p->size) && !xlt_starts_with(p, str))
+    {
+        p->pos++;
+    }
+    int found = (p->pos < p->size);
+    if (found)
+    {
+        p->pos += (uint32_t)strlen(str);
+    }
+    return found;
+}
+
+// White spaces, and for XML the declarations and comments
+static void xlt_skip(xlt_parser *p)
+{
+    int again = TRUE;
+
+    while (again)
+    {
+        while ((p->pos < p->size) && xlt_is_space(p->text[p->pos]))
+        {
+            p->pos++;
+        }
+        if (xlt_starts_with(p, "<!--"))
+        {
+            again = xlt_skip_past(p, "-->");
+        }
+        else if (xlt_starts_with(p, "<?"))
+        {
+            again = xlt_skip_past(p, "?>");
+        }
+        else
+        {
+            again = FALSE;
+        }
+    }
+}
+
+static int xlt_expect(xlt_parser *p, char c)
+{
+    xlt_skip(p);
+    int valid = (p->pos < p->size) && (p->text[p->pos] == c);
+    if (valid)
+    {
+        p->pos++;
+    }
+    return valid;
+}
+
+static csm_text_node *xlt_new_node(xlt_parser *p, uint32_t *index)
+{
+    csm_text_node *node = NULL;
+
+    if (p->tree->count < p->tree->capacity)
+    {
+        node = &p->tree->nodes[p->tree->count];
+        memset(node, 0, sizeof(csm_text_node));
+        p->tree->count++;
+        *index = p->tree->count;
+    }
+    return node;
+}
+
+static uint32_t xlt_read_name(xlt_parser *p)
+{
+    uint32_t start = p->pos;
+    while ((p->pos < p->size) && xlt_is_name(p->text[p->pos]))
+    {
+        p->pos++;
+    }
+    return p->pos - start;
+}
+
+// Quoted string, the position is on the opening quote; JSON escapes are kept
+static int xlt_read_quoted(xlt_parser *p, const char **value, uint32_t *len)
+{
+    int valid = (p->pos < p->size) && (p->text[p->pos] == '"');
+    uint32_t start = ++p->pos;
+
+    while (valid && (p->pos < p->size) && (p->text[p->pos] != '"'))
+    {
+        p->pos += ((p->text[p->pos] == '\\') && (p->tree->format == CSM_TEXT_JSON)) ? 2U : 1U;
+    }
+    valid = valid && (p->pos < p->size);
+    if (valid)
+    {
+        *value = &p->text[start];
+        *len = p->pos - start;
+        p->pos++;
+    }
+    return valid;
+}
+
+static int xlt_parse_xml(xlt_parser *p, uint32_t *index, uint32_t depth)
+{
+    uint32_t last = 0U;
+    csm_text_node *node = NULL;
+    int valid = (depth < XLT_MAX_DEPTH) && xlt_expect(p, '<');
+
+    valid = valid && ((node = xlt_new_node(p, index)) != NULL);
+    if (valid)
+    {
+        node->name = &p->text[p->pos];
+        node->name_len = xlt_read_name(p);
+        valid = (node->name_len > 0U);
+    }
+
+    // Attributes, only Value is used
+    int open = FALSE;
+    while (valid)
+    {
+        xlt_skip(p);
+        if (xlt_starts_with(p, "/>"))
+        {
+            p->pos += 2U;
+            break;
+        }
+        if (xlt_starts_with(p, ">"))
+        {
+            p->pos++;
+            open = TRUE;
+            break;
+        }
+
+        const char *attr = &p->text[p->pos];
+        const char *value = NULL;
+        uint32_t attr_len = xlt_read_name(p);
+        uint32_t value_len = 0U;
+        valid = (attr_len > 0U) && xlt_expect(p, '=');
+        xlt_skip(p);
+        valid = valid && xlt_read_quoted(p, &value, &value_len);
+        if (valid && (attr_len == 5U) && (memcmp(attr, "Value", 5U) == 0))
+        {
+            node->value = value;
+            node->value_len = value_len;
+        }
+    }
+
+    // Children, then the closing tag
+    while (valid && open)
+    {
+        xlt_skip(p);
+        if (xlt_starts_with(p, "</"))
+        {
+            p->pos += 2U;
+            uint32_t len = xlt_read_name(p);
+            valid = (len == node->name_len) && (memcmp(&p->text[p->pos - len], node->name, len) == 0) && xlt_expect(p, '>');
+            break;
+        }
+
+        uint32_t child = 0U;
+        valid = xlt_parse_xml(p, &child, depth + 1U);
+        if (valid)
+        {
+            if (last == 0U)
+            {
+                node->child = child;
+            }
+            else
+            {
+                p->tree->nodes[last - 1U].next = child;
+            }
+            last = child;
+        }
+    }
+    return valid;
+}
+
+static int xlt_parse_json(xlt_parser *p, uint32_t *index, uint32_t depth)
+{
+    csm_text_node *node = NULL;
+    int valid = (depth < XLT_MAX_DEPTH) && xlt_expect(p, '{');
+    const char *name = NULL;
+    uint32_t name_len = 0U;
+
+    valid = valid && ((node = xlt_new_node(p, index)) != NULL);
+    valid = valid && xlt_expect(p, '"');
+    if (valid)
+    {
+        p->pos--;
+        valid = xlt_read_quoted(p, &name, &name_len) && (name_len > 0U) && xlt_expect(p, ':');
+        node->name = name;
+        node->name_len = name_len;
+    }
+    xlt_skip(p);
+
+    if (valid && xlt_starts_with(p, "null"))
+    {
+        p->pos += 4U;
+    }
+    else if (valid && xlt_starts_with(p, "\""))
+    {
+        valid = xlt_read_quoted(p, &node->value, &node->value_len);
+    }
+    else if (valid && xlt_expect(p, '['))
+    {
+        uint32_t last = 0U;
+        xlt_skip(p);
+        if (xlt_starts_with(p, "]"))
+        {
+            p->pos++;
+        }
+        else
+        {
+            int more = TRUE;
+            while (valid && more)
+            {
+                uint32_t child = 0U;
+                valid = xlt_parse_json(p, &child, depth + 1U);
+                if (valid)
+                {
+                    if (last == 0U)
+                    {
+                        node->child = child;
+                    }
+                    else
+                    {
+                        p->tree->nodes[last - 1U].next = child;
+                    }
+                    last = child;
+
+                    xlt_skip(p);
+                    more = xlt_starts_with(p, ",");
+                    valid = more || xlt_starts_with(p, "]");
+                    p->pos++;
+                }
+            }
+        }
+    }
+    else
+    {
+        valid = FALSE;
+    }
+    return valid && xlt_expect(p, '}');
+}
+
+// ----------------------------------- TEXT TO BINARY -----------------------------------
+
+typedef struct
+{
+    const csm_text_tree *tree;
+    csm_array *out;
+} xlt_in;
+
+static const csm_text_node *xlt_node(const xlt_in *in, uint32_t index)
+{
+    return (index != 0U) ? &in->tree->nodes[index - 1U] : NULL;
+}
+
+static int xlt_is(const csm_text_node *node, const char *name)
+{
+    uint32_t len = (uint32_t)strlen(name);
+    return (node != NULL) && (node->name_len == len) && (memcmp(node->name, name, len) == 0);
+}
+
+static uint32_t xlt_nb_children(const xlt_in *in, const csm_text_node *node)
+{
+    uint32_t count = 0U;
+    for (uint32_t i = node->child; i != 0U; i = xlt_node(in, i)->next)
+    {
+        count++;
+    }
+    return count;
+}
+
+static int xlt_hex_digit(char c, uint8_t *digit)
+{
+    int valid = TRUE;
+    if ((c >= '0') && (c <= '9'))
+    {
+        *digit = (uint8_t)(c - '0');
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+        *digit = (uint8_t)(c - 'A' + 10);
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+        *digit = (uint8_t)(c - 'a' + 10);
+    }
+    else
+    {
+        valid = FALSE;
+    }
+    return valid;
+}
+
+static int xlt_write_length(csm_array *out, uint32_t length)
+{
+    int valid = TRUE;
+
+    if (length > 0xFFU)
+    {
+        valid = (length <= 0xFFFFU) && csm_array_write_u8(out, 0x82U) && csm_array_write_u16(out, (uint16_t)length);
+    }
+    else if (length > 0x7FU)
+    {
+        valid = csm_array_write_u8(out, 0x81U) && csm_array_write_u8(out, (uint8_t)length);
+    }
+    else
+    {
+        valid = csm_array_write_u8(out, (uint8_t)length);
+    }
+    return valid;
+}
+
+// Insert the length of the bytes written since 'start' (write index) before them
+static int xlt_insert_length(csm_array *out, uint32_t start)
+{
+    uint32_t length = out->wr_index - start;
+    uint8_t header[3];
+    uint32_t header_size = 1U;
+    int valid = (length <= 0xFFFFU);
+
+    if (length > 0xFFU)
+    {
+        header[0] = 0x82U;
+        header[1] = (uint8_t)(length >> 8U);
+        header[2] = (uint8_t)length;
+        header_size = 3U;
+    }
+    else if (length > 0x7FU)
+    {
+        header[0] = 0x81U;
+        header[1] = (uint8_t)length;
+        header_size = 2U;
+    }
+    else
+    {
+        header[0] = (uint8_t)length;
+    }
+
+    valid = valid && (csm_array_free_size(out) >= header_size);
+    if (valid)
+    {
+        uint8_t *data = &out->buff[out->offset + start];
+        memmove(&data[header_size], data, length);
+        memcpy(data, header, header_size);
+        out->wr_index += header_size;
+    }
+    return valid;
+}
+
+// Hexadecimal value of the node, 'size' bytes (any size if 0); the number of bytes is returned in 'written'
+static int xlt_write_hex(csm_array *out, const csm_text_node *node, uint32_t size, uint32_t *written)
+{
+    uint32_t nb = (node != NULL) ? (node->value_len / 2U) : 0U;
+    int valid = (node != NULL) && (node->value != NULL) && ((node->value_len % 2U) == 0U) && ((size == 0U) || (nb == size));
+
+    valid = valid && (csm_array_free_size(out) >= nb);
+    for (uint32_t i = 0U; valid && (i < nb); i++)
+    {
+        uint8_t high = 0U;
+        uint8_t low = 0U;
+        valid = xlt_hex_digit(node->value[2U * i], &high) && xlt_hex_digit(node->value[(2U * i) + 1U], &low);
+        valid = valid && csm_array_write_u8(out, (uint8_t)((high << 4U) | low));
+    }
+    if (written != NULL)
+    {
+        *written = nb;
+    }
+    return valid;
+}
+
+static int xlt_write_sized_hex(csm_array *out, const csm_text_node *node)
+{
+    int valid = (node != NULL) && (node->value != NULL);
+    valid = valid && xlt_write_length(out, node->value_len / 2U);
+    return valid && xlt_write_hex(out, node, 0U, NULL);
+}
+
+// Unescape a visible string, XML entities or JSON escapes
+static int xlt_write_text(const xlt_in *in, const csm_text_node *node)
+{
+    csm_array *out = in->out;
+    const char *s = node->value;
+    uint32_t len = (s != NULL) ? node->value_len : 0U;
+    int valid = TRUE;
+
+    for (uint32_t i = 0U; valid && (i < len); i++)
+    {
+        uint8_t c = (uint8_t)s[i];
+
+        if ((in->tree->format == CSM_TEXT_XML) && (c == '&'))
+        {
+            static const char *cEntities[] = { "&lt;", "&gt;", "&amp;", "&quot;", "&apos;" };
+            static const char cChars[] = { '<', '>', '&', '"', '\'' };
+            uint8_t d[2] = { 0U, 0U };
+            valid = FALSE;
+            if (((i + 5U) < len) && (s[i + 1U] == '#') && (s[i + 2U] == 'x') && (s[i + 5U] == ';') &&
+                xlt_hex_digit(s[i + 3U], &d[0]) && xlt_hex_digit(s[i + 4U], &d[1]))
+            {
+                c = (uint8_t)((d[0] << 4U) | d[1]);
+                i += 5U;
+                valid = TRUE;
+            }
+            for (uint32_t e = 0U; !valid && (e < 5U); e++)
+            {
+                uint32_t elen = (uint32_t)strlen(cEntities[e]);
+                if (((i + elen) <= len) && (memcmp(&s[i], cEntities[e], elen) == 0))
+                {
+                    c = (uint8_t)cChars[e];
+                    i += elen - 1U;
+                    valid = TRUE;
+                    break;
+                }
+            }
+        }
+        else if ((in->tree->format == CSM_TEXT_JSON) && (c == '\\') && ((i + 1U) < len))
+        {
+            i++;
+            c = (uint8_t)s[i];
+            if (c == 'u')
+            {
+                uint8_t d[4] = { 0U, 0U, 0U, 0U };
+                valid = ((i + 4U) < len) && xlt_hex_digit(s[i + 1U], &d[0]) && xlt_hex_digit(s[i + 2U], &d[1]) &&
+                        xlt_hex_digit(s[i + 3U], &d[2]) && xlt_hex_digit(s[i + 4U], &d[3]) && (d[0] == 0U) && (d[1] == 0U);
+                c = (uint8_t)((d[2] << 4U) | d[3]);
+                i += 4U;
+            }
+            else if (c == 'n')
+            {
+                c = '\n';
+            }
+            else if (c == 't')
+            {
+                c = '\t';
+            }
+            else if (c == 'r')
+            {
+                c = '\r';
+            }
+        }
+        valid = valid && csm_array_write_u8(out, c);
+    }
+    return valid;
+}
+
+static int xlt_data_from_text(const xlt_in *in, const csm_text_node *node, uint32_t depth)
+{
+    csm_array *out = in->out;
+    const xlt_data_type *type = NULL;
+    int valid = (node != NULL) && (depth < XLT_MAX_DEPTH);
+
+    for (uint32_t i = 0U; valid && (i < XLT_NB(cDataTypes)); i++)
+    {
+        if (xlt_is(node, cDataTypes[i].name))
+        {
+            type = &cDataTypes[i];
+            break;
+        }
+    }
+    valid = (type != NULL) && csm_array_write_u8(out, type->tag);
+
+    if (valid)
+    {
+        switch (type->value)
+        {
+        case XLT_VAL_NONE:
+            break;
+        case XLT_VAL_CONTAINER:
+            valid = xlt_write_length(out, xlt_nb_children(in, node));
+            for (uint32_t i = node->child; valid && (i != 0U); i = xlt_node(in, i)->next)
+            {
+                valid = xlt_data_from_text(in, xlt_node(in, i), depth + 1U);
+            }
+            break;
+        case XLT_VAL_HEX:
+            valid = xlt_write_hex(out, node, type->size, NULL);
+            break;
+        case XLT_VAL_SIZED_HEX:
+            valid = xlt_write_sized_hex(out, node);
+            break;
+        case XLT_VAL_TEXT:
+        {
+            uint32_t start = out->wr_index;
+            valid = xlt_write_text(in, node) && xlt_insert_length(out, start);
+            break;
+        }
+        case XLT_VAL_BITS:
+        default:
+        {
+            uint32_t bits = (node->value != NULL) ? node->value_len : 0U;
+            uint8_t byte = 0U;
+            valid = xlt_write_length(out, bits);
+            for (uint32_t i = 0U; valid && (i < bits); i++)
+            {
+                valid = (node->value[i] == '0') || (node->value[i] == '1');
+                byte |= (uint8_t)((node->value[i] == '1') ? (0x80U >> (i % 8U)) : 0U);
+                if (valid && (((i % 8U) == 7U) || ((i + 1U) == bits)))
+                {
+                    valid = csm_array_write_u8(out, byte);
+                    byte = 0U;
+                }
+            }
+            break;
+        }
+        }
+    }
+    return valid;
+}
+
+static int xlt_fields_from_text(const xlt_in *in, const xlt_field *fields, uint32_t nb_fields, uint32_t *cursor, uint32_t depth);
+
+static int xlt_get_result_from_text(const xlt_in *in, const csm_text_node *node, uint32_t depth)
+{
+    const csm_text_node *choice = xlt_node(in, node->child);
+    int valid = (choice != NULL) && (choice->next == 0U);
+
+    if (valid && xlt_is(choice, "Data"))
+    {
+        valid = csm_array_write_u8(in->out, 0U) && xlt_data_from_text(in, xlt_node(in, choice->child), depth + 1U);
+    }
+    else if (valid && xlt_is(choice, "DataAccessError"))
+    {
+        valid = csm_array_write_u8(in->out, 1U) && xlt_write_hex(in->out, choice, 1U, NULL);
+    }
+    else
+    {
+        valid = FALSE;
+    }
+    return valid;
+}
+
+static int xlt_field_from_text(const xlt_in *in, const xlt_field *field, uint32_t *cursor, uint32_t depth)
+{
+    csm_array *out = in->out;
+    const csm_text_node *node = xlt_node(in, *cursor);
+    int present = xlt_is(node, field->name);
+    int valid = TRUE;
+
+    switch (field->type)
+    {
+    case XLT_OPT_HEX:
+    case XLT_OPT_OCTETS:
+    case XLT_OPT_DATA:
+    case XLT_OPT_SEQUENCE:
+    case XLT_OPT_GET_RESULT:
+        valid = csm_array_write_u8(out, present ? 1U : 0U);
+        break;
+    default:
+        valid = present;
+        break;
+    }
+
+    if (valid && present)
+    {
+        switch (field->type)
+        {
+        case XLT_HEX:
+        case XLT_OPT_HEX:
+            valid = xlt_write_hex(out, node, field->size, NULL);
+            break;
+        case XLT_OPT_OCTETS:
+            valid = xlt_write_sized_hex(out, node);
+            break;
+        case XLT_CONFORMANCE:
+            valid = csm_array_write_u8(out, 0x5FU) && csm_array_write_u8(out, 0x1FU) && csm_array_write_u8(out, 0x04U) &&
+                    csm_array_write_u8(out, 0x00U) && xlt_write_hex(out, node, 3U, NULL);
+            break;
+        case XLT_DATA:
+        case XLT_OPT_DATA:
+        {
+            const csm_text_node *data = xlt_node(in, node->child);
+            valid = (data != NULL) && (data->next == 0U) && xlt_data_from_text(in, data, depth + 1U);
+            break;
+        }
+        case XLT_SEQUENCE:
+        case XLT_OPT_SEQUENCE:
+        {
+            uint32_t child = node->child;
+            valid = xlt_fields_from_text(in, field->sub, field->size, &child, depth + 1U) && (child == 0U);
+            break;
+        }
+        case XLT_GET_RESULT:
+        case XLT_OPT_GET_RESULT:
+            valid = xlt_get_result_from_text(in, node, depth);
+            break;
+        case XLT_RAW_RESULT:
+        {
+            const csm_text_node *choice = xlt_node(in, node->child);
+            valid = (choice != NULL) && (choice->next == 0U);
+            if (valid && xlt_is(choice, "RawData"))
+            {
+                valid = csm_array_write_u8(out, 0U) && xlt_write_sized_hex(out, choice);
+            }
+            else
+            {
+                valid = valid && xlt_is(choice, "DataAccessError") && csm_array_write_u8(out, 1U) && xlt_write_hex(out, choice, 1U, NULL);
+            }
+            break;
+        }
+        case XLT_LIST:
+        default:
+            valid = xlt_write_length(out, xlt_nb_children(in, node));
+            for (uint32_t i = node->child; valid && (i != 0U); i = xlt_node(in, i)->next)
+            {
+                uint32_t item = i;
+                valid = xlt_fields_from_text(in, field->sub, 1U, &item, depth + 1U);
+            }
+            break;
+        }
+    }
+
+    if (valid && present)
+    {
+        *cursor = node->next;
+    }
+    return valid;
+}
+
+static int xlt_fields_from_text(const xlt_in *in, const xlt_field *fields, uint32_t nb_fields, uint32_t *cursor, uint32_t depth)
+{
+    int valid = (depth < XLT_MAX_DEPTH);
+
+    for (uint32_t i = 0U; valid && (i < nb_fields); i++)
+    {
+        valid = xlt_field_from_text(in, &fields[i], cursor, depth);
+    }
+    return valid;
+}
+
+static int xlt_pdu_from_text(const xlt_in *in, const csm_text_node *root, const xlt_pdu *pdus, uint32_t nb_pdus)
+{
+    int valid = FALSE;
+
+    for (uint32_t i = 0U; i < nb_pdus; i++)
+    {
+        const xlt_pdu *pdu = &pdus[i];
+        const csm_text_node *node = root;
+
+        if (!xlt_is(root, pdu->service))
+        {
+            continue;
+        }
+        if (pdu->variant != NULL)
+        {
+            node = xlt_node(in, root->child);
+            if (!xlt_is(node, pdu->variant) || (node->next != 0U))
+            {
+                continue;
+            }
+        }
+
+        uint32_t cursor = node->child;
+        valid = csm_array_write_u8(in->out, pdu->tag);
+        if (pdu->choice != XLT_NO_CHOICE)
+        {
+            valid = valid && csm_array_write_u8(in->out, pdu->choice);
+        }
+        valid = valid && xlt_fields_from_text(in, pdu->fields, pdu->nb_fields, &cursor, 0U) && (cursor == 0U);
+        break;
+    }
+    return valid;
+}
+
+static int xlt_acse_from_text(const xlt_in *in, const csm_text_node *root, const xlt_acse *acse)
+{
+    csm_array *out = in->out;
+    int valid = csm_array_write_u8(out, acse->tag);
+    uint32_t start = out->wr_index;
+
+    for (uint32_t i = root->child; valid && (i != 0U); i = xlt_node(in, i)->next)
+    {
+        const csm_text_node *node = xlt_node(in, i);
+        uint8_t tag = 0U;
+
+        valid = FALSE;
+        for (uint32_t e = 0U; e < acse->nb_elements; e++)
+        {
+            if (xlt_is(node, acse->elements[e].name))
+            {
+                tag = acse->elements[e].tag;
+                valid = TRUE;
+                break;
+            }
+        }
+        valid = valid && csm_array_write_u8(out, tag);
+
+        if (valid && (tag == XLT_USER_INFO_TAG) && (node->child != 0U))
+        {
+            const csm_text_node *initiate = xlt_node(in, node->child);
+            uint32_t element = out->wr_index;
+            valid = csm_array_write_u8(out, XLT_OCTET_STRING);
+            uint32_t content = out->wr_index;
+            valid = valid && (initiate->next == 0U) && xlt_pdu_from_text(in, initiate, cInitiates, XLT_NB(cInitiates));
+            valid = valid && xlt_insert_length(out, content) && xlt_insert_length(out, element);
+        }
+        else if (valid)
+        {
+            valid = xlt_write_sized_hex(out, node);
+        }
+    }
+    return valid && xlt_insert_length(out, start);
+}
+
+int csm_translate_from_text(const char *text, uint32_t size, uint32_t *pos, csm_text_tree *tree, csm_array *apdu)
+{
+    xlt_parser parser;
+    xlt_in in;
+    uint32_t root_index = 0U;
+    uint32_t start = apdu->wr_index;
+    int ret = 0;
+
+    parser.text = text;
+    parser.size = size;
+    parser.pos = *pos;
+    parser.tree = tree;
+    tree->count = 0U;
+
+    xlt_skip(&parser);
+    if (parser.pos < size)
+    {
+        int valid;
+        tree->format = (text[parser.pos] == '{') ? CSM_TEXT_JSON : CSM_TEXT_XML;
+        valid = (tree->format == CSM_TEXT_JSON) ? xlt_parse_json(&parser, &root_index, 0U) : xlt_parse_xml(&parser, &root_index, 0U);
+
+        in.tree = tree;
+        in.out = apdu;
+        if (valid)
+        {
+            const csm_text_node *root = xlt_node(&in, root_index);
+            const xlt_acse *acse = NULL;
+
+            for (uint32_t i = 0U; i < XLT_NB(cAcses); i++)
+            {
+                if (xlt_is(root, cAcses[i].name))
+                {
+                    acse = &cAcses[i];
+                    break;
+                }
+            }
+
+            if (xlt_is(root, "Raw"))
+            {
+                valid = xlt_write_hex(apdu, root, 0U, NULL);
+            }
+            else if (acse != NULL)
+            {
+                valid = xlt_acse_from_text(&in, root, acse);
+            }
+            else
+            {
+                valid = xlt_pdu_from_text(&in, root, cPdus, XLT_NB(cPdus));
+            }
+        }
+
+        ret = valid ? (int)(apdu->wr_index - start) : -1;
+        *pos = parser.pos;
+    }
+    else
+    {
+        *pos = size;
+    }
+    return ret;
+}
@@ -0,0 +1,105 @@
+/**
+ * Translation of the APDUs to XML or JSON text, and back to binary
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef CSM_TRANSLATE_H
+#define CSM_TRANSLATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "csm_array.h"
+
+/*
+ * The XML form follows the Gurux style (see the comments in csm_services.c), all the values are
+ * hexadecimal except the bit strings ('0' and '1') and the visible strings (escaped text):
+ *
+ *  <GetResponse>
+ *    <GetResponseNormal>
+ *      <InvokeIdAndPriority Value="C1" />
+ *      <Result>
+ *        <Data>
+ *          <UInt32 Value="00000064" />
+ *        </Data>
+ *      </Result>
+ *    </GetResponseNormal>
+ *  </GetResponse>
+ *
+ * The JSON form has the same tree, one APDU per line: a node is {"Name":"value"} or {"Name":[nodes]}.
+ *
+ * Supported: AARQ, AARE, RLRQ, RLRE (the user information is decoded if it is a plain xDLMS initiate),
+ * GET, SET and ACTION requests and responses (normal, block, with list as supported by the stack),
+ * exception response. Any other APDU, ciphered ones included, is written as <Raw Value="..." />.
+ */
+
+enum csm_text_format { CSM_TEXT_XML, CSM_TEXT_JSON };
+
+typedef struct csm_text csm_text;
+
+// Enlarge the buffer to at least 'needed' bytes (data and capacity updated), FALSE if not possible
+typedef int (*csm_text_grow)(csm_text *text, uint32_t needed);
+
+// Output buffer, not null terminated
+struct csm_text
+{
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    csm_text_grow grow;     //!< NULL for a fixed buffer
+    int error;              //!< Set when the buffer cannot grow, the text is then incomplete
+};
+
+void csm_text_init(csm_text *text, char *buffer, uint32_t capacity, csm_text_grow grow);
+
+// Append raw text, eg: comments between the APDUs; FALSE if the buffer is full
+int csm_text_append(csm_text *text, const char *str, uint32_t size);
+
+/**
+ * @brief Append the translation of one APDU to the text
+ * @return FALSE if the buffer is full
+ */
+int csm_translate_to_text(csm_text *text, enum csm_text_format format, const uint8_t *apdu, uint32_t size);
+
+// Node of a parsed text, the name and the value point into the text
+typedef struct
+{
+    const char *name;
+    const char *value;      //!< Escaped as in the text, NULL if none
+    uint32_t name_len;
+    uint32_t value_len;
+    uint32_t child;         //!< Index + 1 of the first child, 0 if none
+    uint32_t next;          //!< Index + 1 of the next sibling, 0 if none
+} csm_text_node;
+
+typedef struct
+{
+    csm_text_node *nodes;
+    uint32_t capacity;
+    uint32_t count;
+    enum csm_text_format format;
+} csm_text_tree;
+
+/**
+ * @brief Translate the next APDU of a text back to binary
+ *
+ * The format (XML or JSON) is detected; XML declarations and comments are skipped. The tree is
+ * working memory, it needs one node per element of the APDU.
+ * @param pos: position in the text, updated
+ * @return the size of the APDU written to the array, 0 at the end of the text, -1 on error
+ */
+int csm_translate_from_text(const char *text, uint32_t size, uint32_t *pos, csm_text_tree *tree, csm_array *apdu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSM_TRANSLATE_H
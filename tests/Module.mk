@@ -0,0 +1,7 @@
+
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), tests_main.c test_stack.c test_trace.c test_metrics.c test_hdlc.c test_association.c test_services.c test_array.c test_clock.c test_push.c test_capture.c test_executor.c test_snapshot.c test_event_log.c test_timeseries.c test_columnar.c test_slot_alloc.c test_calendar.c test_admission.c test_work_pool.c test_translate.c test_simulator.c test_hex.c test_objdb.c)
+
+# Meter model of the simulator, executed through the stack by test_simulator.c
+SOURCES += $(LOCAL_DIR)../simulator/sim_meter.c
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Optional check of the columnar export (csm_columnar.h) against pyarrow
+
+Profile buffers with random values and nulls are decoded by the C library, the exported batch is
+imported through the Arrow C data interface, validated by pyarrow and compared with the values
+encoded. The library is built apart, from the repository root:
+
+    gcc -shared -fPIC -std=gnu99 -O2 -DCSM_TRACE_LEVEL=0 -Isrc -Ishare/util src/csm_columnar.c \\
+        src/csm_array.c src/csm_axdr_codec.c src/csm_ber.c share/util/clock.c -o libcsm_columnar.so
+    python3 tests/arrow_check.py ./libcsm_columnar.so
+
+Copyright (c) 2016, Anthony Rabine
+All rights reserved.
+
+This software may be modified and distributed under the terms of the BSD license.
+See LICENSE.txt for more details.
+"""
+
+import ctypes
+import random
+import struct
+import sys
+import time
+
+import pyarrow as pa
+
+MAX_COLUMNS = 32
+NAME_SIZE = 48
+PERIOD = 900
+START = 1483228800  # 2017-01-01 00:00:00
+
+
+class ArrowSchema(ctypes.Structure):
+    pass
+
+
+ArrowSchema._fields_ = [
+    ("format", ctypes.c_char_p), ("name", ctypes.c_char_p), ("metadata", ctypes.c_char_p),
+    ("flags", ctypes.c_int64), ("n_children", ctypes.c_int64),
+    ("children", ctypes.POINTER(ctypes.POINTER(ArrowSchema))), ("dictionary", ctypes.POINTER(ArrowSchema)),
+    ("release", ctypes.c_void_p), ("private_data", ctypes.c_void_p)]
+
+
+class ArrowArray(ctypes.Structure):
+    pass
+
+
+ArrowArray._fields_ = [
+    ("length", ctypes.c_int64), ("null_count", ctypes.c_int64), ("offset", ctypes.c_int64),
+    ("n_buffers", ctypes.c_int64), ("n_children", ctypes.c_int64), ("buffers", ctypes.c_void_p),
+    ("children", ctypes.POINTER(ctypes.POINTER(ArrowArray))), ("dictionary", ctypes.POINTER(ArrowArray)),
+    ("release", ctypes.c_void_p), ("private_data", ctypes.c_void_p)]
+
+
+class ColDef(ctypes.Structure):
+    _fields_ = [
+        ("class_id", ctypes.c_uint16), ("logical_name", ctypes.c_uint8 * 6), ("attribute_id", ctypes.c_int8),
+        ("data_index", ctypes.c_uint16), ("type", ctypes.c_uint8), ("tag", ctypes.c_uint8),
+        ("name", ctypes.c_char * NAME_SIZE)]
+
+
+class ColSchema(ctypes.Structure):
+    _fields_ = [("columns", ColDef * MAX_COLUMNS), ("nb_columns", ctypes.c_uint32)]
+
+
+class ColColumn(ctypes.Structure):
+    _fields_ = [
+        ("validity", ctypes.c_void_p), ("values", ctypes.c_void_p), ("offsets", ctypes.c_void_p),
+        ("data", ctypes.c_void_p), ("data_size", ctypes.c_uint32), ("data_capacity", ctypes.c_uint32),
+        ("raw", ctypes.c_void_p), ("null_count", ctypes.c_int64)]
+
+
+class ColBatch(ctypes.Structure):
+    _fields_ = [
+        ("schema", ctypes.POINTER(ColSchema)), ("arena", ctypes.c_void_p), ("arena_size", ctypes.c_uint32),
+        ("arena_used", ctypes.c_uint32), ("var_size", ctypes.c_uint32), ("capacity", ctypes.c_uint32),
+        ("rows", ctypes.c_uint32), ("buffers", ctypes.c_uint32), ("errors", ctypes.c_uint32),
+        ("mismatches", ctypes.c_uint32), ("overflows", ctypes.c_uint32),
+        ("columns", ColColumn * MAX_COLUMNS),
+        ("child_schemas", ArrowSchema * MAX_COLUMNS), ("child_schema_ptrs", ctypes.c_void_p * MAX_COLUMNS),
+        ("child_arrays", ArrowArray * MAX_COLUMNS), ("child_array_ptrs", ctypes.c_void_p * MAX_COLUMNS),
+        ("child_buffers", (ctypes.c_void_p * 3) * MAX_COLUMNS), ("struct_buffers", ctypes.c_void_p * 1)]
+
+
+def capture_object(class_id, obis):
+    return bytes([0x02, 0x04, 0x12]) + struct.pack(">H", class_id) + bytes([0x09, 0x06]) + bytes(obis) + \
+        bytes([0x0F, 0x02, 0x12, 0x00, 0x00])
+
+
+# UTC date-time, deviation 0
+def datetime(utc):
+    y, mo, d, h, mi, s, wd = time.gmtime(utc)[:7]
+    return bytes([0x09, 0x0C]) + struct.pack(">HBBBBBBBhB", y, mo, d, wd + 1, h, mi, s, 0, 0, 0)
+
+
+# Clock, energy (double-long-unsigned), power (long), status (visible-string)
+CAPTURE_OBJECTS = bytes([0x01, 0x04]) + capture_object(8, [0, 0, 1, 0, 0, 255]) + \
+    capture_object(3, [1, 0, 1, 8, 0, 255]) + capture_object(3, [1, 0, 1, 7, 0, 255]) + \
+    capture_object(1, [0, 0, 96, 10, 1, 255])
+
+
+def make_buffer(first, count, rand):
+    rows = []
+    data = bytes([0x01, 0x81, count]) if count >= 0x80 else bytes([0x01, count])
+    for i in range(first, first + count):
+        utc = START + (i * PERIOD)
+        energy = rand.randrange(1 << 32) if rand.random() > 0.1 else None
+        power = rand.randrange(-32768, 32768) if rand.random() > 0.1 else None
+        status = "".join(rand.choice("ABCDEF") for _ in range(rand.randrange(8))) if rand.random() > 0.3 else None
+        rows.append((utc, energy, power, status))
+        data += bytes([0x02, 0x04]) + datetime(utc)
+        data += (bytes([0x06]) + struct.pack(">I", energy)) if energy is not None else bytes([0x00])
+        data += (bytes([0x10]) + struct.pack(">h", power)) if power is not None else bytes([0x00])
+        data += (bytes([0x0A, len(status)]) + status.encode()) if status is not None else bytes([0x00])
+    return data, rows
+
+
+def main():
+    lib = ctypes.CDLL(sys.argv[1] if len(sys.argv) > 1 else "./libcsm_columnar.so")
+    rand = random.Random(1)
+
+    schema = ColSchema()
+    batch = ColBatch()
+    arena = (ctypes.c_uint64 * 65536)()
+    if not lib.csm_col_schema_init(ctypes.byref(schema), CAPTURE_OBJECTS, len(CAPTURE_OBJECTS)):
+        sys.exit("capture_objects rejected")
+    lib.csm_col_batch_init(ctypes.byref(batch), ctypes.byref(schema), arena, ctypes.sizeof(arena), 1000, 8192)
+
+    expected = []
+    for first in range(0, 600, 100):
+        buffer, rows = make_buffer(first, 100, rand)
+        if not lib.csm_col_decode(ctypes.byref(batch), buffer, len(buffer)):
+            sys.exit("buffer %u rejected" % first)
+        expected += rows
+
+        # The same buffer with a trailing byte is rejected, without rows left in the batch
+        if lib.csm_col_decode(ctypes.byref(batch), buffer + b"\x00", len(buffer) + 1):
+            sys.exit("trailing byte accepted")
+
+    out_schema = ArrowSchema()
+    out_array = ArrowArray()
+    lib.csm_col_export(ctypes.byref(batch), ctypes.byref(out_schema), ctypes.byref(out_array))
+    array = pa.Array._import_from_c(ctypes.addressof(out_array), ctypes.addressof(out_schema))
+    array.validate(full=True)
+
+    columns = [array.field(i) for i in range(array.type.num_fields)]
+    times = columns[0].cast(pa.int64()).to_pylist()
+    got = list(zip(times, columns[1].to_pylist(), columns[2].to_pylist(), columns[3].to_pylist()))
+    if (batch.rows != len(expected)) or (batch.errors != 6) or (got != expected):
+        sys.exit("mismatch: %u rows, %u errors" % (batch.rows, batch.errors))
+    print("ok %u rows, %s" % (len(got), array.type))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+/**
+ * Unit tests of the admission control
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "admission.h"
+
+#define TEST_ADM_ENTRIES    8U
+
+static adm_entry entries[TEST_ADM_ENTRIES];
+
+void test_admission(void)
+{
+    static const uint8_t cAddress[] = { 192U, 168U, 1U, 10U };
+    adm_table table;
+    adm_limit apdus = { 10U, 5U };      // 10 APDU/s, bursts of 5
+    adm_limit bytes = { 0U, 0U };
+    uint32_t delay = 0U;
+    uint64_t key = adm_key(cAddress, sizeof(cAddress), 0x10U);
+
+    TEST_CHECK(!adm_init(&table, entries, 6U, &apdus, &bytes, 200U));
+    TEST_CHECK(adm_init(&table, entries, TEST_ADM_ENTRIES, &apdus, &bytes, 200U));
+    TEST_CHECK((key != 0ULL) && (key != adm_key(cAddress, sizeof(cAddress), 0x01U)));
+
+    // Burst, then one APDU per 100 ms
+    int valid = TRUE;
+    for (uint32_t i = 0U; i < 5U; i++)
+    {
+        valid = valid && (adm_check(&table, key, 20U, 1000U, &delay) == ADM_ACCEPT);
+    }
+    TEST_CHECK(valid);
+    TEST_CHECK((adm_check(&table, key, 20U, 1000U, &delay) == ADM_DELAY) && (delay == 100U));
+    TEST_CHECK(adm_check(&table, key, 20U, 1050U, &delay) == ADM_DELAY);
+    TEST_CHECK(adm_check(&table, key, 20U, 1100U, &delay) == ADM_ACCEPT);
+
+    // Sustained rate over 10 s, one APDU tried per millisecond: the burst, then the rate
+    uint32_t accepted = 0U;
+    for (uint64_t now = 100000U; now < 110000U; now++)
+    {
+        accepted += (adm_check(&table, key, 20U, now, &delay) == ADM_ACCEPT) ? 1U : 0U;
+    }
+    TEST_CHECK((accepted >= 104U) && (accepted <= 106U));
+
+    // A wait longer than the maximum delay is a rejection
+    apdus.rate = 1U;
+    apdus.burst = 1U;
+    TEST_CHECK(adm_init(&table, entries, TEST_ADM_ENTRIES, &apdus, &bytes, 200U));
+    TEST_CHECK(adm_check(&table, key, 20U, 1000U, &delay) == ADM_ACCEPT);
+    TEST_CHECK((adm_check(&table, key, 20U, 1000U, &delay) == ADM_REJECT) && (table.rejected == 1U));
+    TEST_CHECK(adm_check(&table, key, 20U, 2000U, &delay) == ADM_ACCEPT);
+
+    // Bytes: an APDU larger than the burst never passes
+    apdus.rate = 0U;
+    bytes.rate = 1000U;
+    bytes.burst = 500U;
+    TEST_CHECK(adm_init(&table, entries, TEST_ADM_ENTRIES, &apdus, &bytes, 500U));
+    TEST_CHECK(adm_check(&table, key, 600U, 1000U, &delay) == ADM_REJECT);
+    TEST_CHECK(adm_check(&table, key, 400U, 1000U, &delay) == ADM_ACCEPT);
+    TEST_CHECK((adm_check(&table, key, 400U, 1000U, &delay) == ADM_DELAY) && (delay == 300U));
+    TEST_CHECK(adm_check(&table, key, 400U, 1300U, &delay) == ADM_ACCEPT);
+
+    // No limit
+    bytes.rate = 0U;
+    TEST_CHECK(adm_init(&table, entries, TEST_ADM_ENTRIES, &apdus, &bytes, 0U));
+    valid = TRUE;
+    for (uint32_t i = 0U; i < 1000U; i++)
+    {
+        valid = valid && (adm_check(&table, key, 4000U, 1000U, &delay) == ADM_ACCEPT);
+    }
+    TEST_CHECK(valid && (table.accepted == 1000U));
+
+    // Full table: the active clients keep their slots, an idle one is replaced
+    apdus.rate = 10U;
+    apdus.burst = 5U;
+    TEST_CHECK(adm_init(&table, entries, TEST_ADM_ENTRIES, &apdus, &bytes, 200U));
+    valid = TRUE;
+    for (uint16_t sap = 1U; sap <= TEST_ADM_ENTRIES; sap++)
+    {
+        valid = valid && (adm_check(&table, adm_key(cAddress, sizeof(cAddress), sap), 20U, 1000U + sap, &delay) == ADM_ACCEPT);
+    }
+    TEST_CHECK(valid);
+    TEST_CHECK(adm_check(&table, adm_key(cAddress, sizeof(cAddress), 100U), 20U, 1100U, &delay) == ADM_REJECT);
+    TEST_CHECK(adm_check(&table, adm_key(cAddress, sizeof(cAddress), 1U), 20U, 1100U, &delay) == ADM_ACCEPT);
+
+    // 500 ms refill the buckets: the clients idle since then can be evicted, the oldest first
+    TEST_CHECK(adm_check(&table, adm_key(cAddress, sizeof(cAddress), 100U), 20U, 1600U, &delay) == ADM_ACCEPT);
+    valid = TRUE;
+    for (uint32_t i = 0U; i < TEST_ADM_ENTRIES; i++)
+    {
+        valid = valid && (entries[i].key != adm_key(cAddress, sizeof(cAddress), 2U));
+    }
+    TEST_CHECK(valid);
+}
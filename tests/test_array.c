@@ -0,0 +1,49 @@
+/**
+ * Unit tests of the array (bounded buffer with read and write indexes)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_array.h"
+
+// A jump may end exactly at the end of the buffer, not beyond
+static void test_array_jumps(void)
+{
+    uint8_t buffer[8];
+    uint8_t data[4];
+    csm_array array;
+
+    csm_array_init(&array, buffer, sizeof(buffer), 0U, 2U);
+    TEST_CHECK(csm_array_write_u16(&array, 0x0102U));
+    TEST_CHECK(csm_array_write_u32(&array, 0x03040506U));
+    TEST_CHECK(csm_array_free_size(&array) == 0U);
+    TEST_CHECK(array.wr_index == 6U);
+    TEST_CHECK(!csm_array_write_u8(&array, 0x07U));
+
+    TEST_CHECK(csm_array_reader_jump(&array, 2U));
+    TEST_CHECK(csm_array_read_buff(&array, data, 4U));
+    TEST_CHECK((data[0] == 0x03U) && (data[3] == 0x06U));
+    TEST_CHECK(csm_array_unread(&array) == 0U);
+
+    // Beyond the end: saturated and refused
+    csm_array_init(&array, buffer, sizeof(buffer), 0U, 2U);
+    TEST_CHECK(csm_array_writer_jump(&array, 6U));
+    csm_array_init(&array, buffer, sizeof(buffer), 0U, 2U);
+    TEST_CHECK(!csm_array_writer_jump(&array, 7U));
+    TEST_CHECK(array.wr_index == 6U);
+    TEST_CHECK(!csm_array_reader_jump(&array, 7U));
+    TEST_CHECK(array.rd_index == 6U);
+}
+
+void test_array(void)
+{
+    test_array_jumps();
+}
@@ -0,0 +1,253 @@
+/**
+ * Unit tests of the association control (AARQ, AARE, RLRQ)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "tests.h"
+
+static csm_db_code test_asso_db(csm_array *in, csm_array *out, csm_request *request)
+{
+    (void) in;
+    (void) out;
+    (void) request;
+    return CSM_ERR_OBJECT_NOT_FOUND;
+}
+
+// The decoding stops after the last field, whatever it is: the AARQ is always answered
+static void test_asso_aarq_end(void)
+{
+    static const uint8_t cMinimalAarq[] = { CSM_ASSO_AARQ, 0x0BU, 0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U };
+    csm_array reply;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    TEST_CHECK(test_stack_exchange(channel, cMinimalAarq, sizeof(cMinimalAarq), &reply) > 0);
+    TEST_CHECK(reply.buff[0] == CSM_ASSO_AARE);
+    csm_channel_disconnect(channel);
+}
+
+// Conformance: bit string with its unused bits byte, then the 24 bits proposed by the client
+static void test_asso_conformance(void)
+{
+    static const uint8_t cConformance[] = { 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x10U, 0x1DU };
+    csm_array reply;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    TEST_CHECK(test_stack_exchange(channel, cTestAarq, cTestAarqSize, &reply) > 0);
+    // Proposed 0x007E1F, negotiated with the configuration
+    TEST_CHECK(test_stack_channel(channel)->asso->state_cf == CF_ASSOCIATED);
+    TEST_CHECK(test_stack_channel(channel)->asso->conformance == (0x007E1FU & TEST_CONFORMANCE));
+    TEST_CHECK(test_find(&reply, cConformance, sizeof(cConformance)) >= 0);
+    csm_channel_disconnect(channel);
+}
+
+// Without a free handshake, the AARQ is answered with a rejected AARE
+static void test_asso_no_handshake(void)
+{
+    static const uint8_t cRejectedTransient[] = { 0xA2U, 0x03U, 0x02U, 0x01U, 0x02U };
+    static csm_asso_state clients[CSM_DEF_MAX_HANDSHAKES];
+    uint8_t aarq[128];
+    csm_array array;
+    csm_array reply;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    // The client side keeps its handshake after the AARQ encoding
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_asso_init(&clients[i]);
+        clients[i].config = &cTestAssoConf[0];
+        csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+        TEST_CHECK(csm_asso_encoder(&clients[i], &array, CSM_ASSO_AARQ));
+    }
+
+    TEST_CHECK(test_stack_exchange(channel, cTestAarq, cTestAarqSize, &reply) > 0);
+    TEST_CHECK((reply.buff[0] == CSM_ASSO_AARE) && (reply.buff[1] == (reply.wr_index - 2U)));
+    TEST_CHECK(test_find(&reply, cRejectedTransient, sizeof(cRejectedTransient)) >= 0);
+    TEST_CHECK(test_stack_channel(channel)->asso->state_cf == CF_IDLE);
+
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_asso_release_handshake(&clients[i]);
+    }
+    TEST_CHECK(test_stack_associate(channel));
+    csm_channel_disconnect(channel);
+}
+
+static uint32_t test_asso_time = 0U;
+
+static uint32_t test_asso_clock(void)
+{
+    return test_asso_time;
+}
+
+// With a clock, a handshake unused for CSM_DEF_HANDSHAKE_TIMEOUT is taken by a new association when the pool is full
+static void test_asso_reclaim(void)
+{
+    static const uint8_t cRejectedTransient[] = { 0xA2U, 0x03U, 0x02U, 0x01U, 0x02U };
+    static csm_asso_state clients[CSM_DEF_MAX_HANDSHAKES];
+    static csm_asso_state late;
+    uint8_t aarq[128];
+    csm_array array;
+    csm_array reply;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+    int valid = TRUE;
+
+    csm_asso_set_clock(test_asso_clock);
+    test_asso_time = 0xFFFFFFF0U;   // Wraps during the test
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_asso_init(&clients[i]);
+        clients[i].config = &cTestAssoConf[0];
+        csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+        valid = valid && csm_asso_encoder(&clients[i], &array, CSM_ASSO_AARQ);
+    }
+    TEST_CHECK(valid);
+
+    // Not old enough
+    test_asso_time += CSM_DEF_HANDSHAKE_TIMEOUT - 1U;
+    TEST_CHECK(test_stack_exchange(channel, cTestAarq, cTestAarqSize, &reply) > 0);
+    TEST_CHECK(test_find(&reply, cRejectedTransient, sizeof(cRejectedTransient)) >= 0);
+    TEST_CHECK(csm_asso_hold_handshake(&clients[0]));
+
+    // The oldest one is taken, its association is aborted when it uses it again
+    test_asso_time += 1U;
+    csm_asso_init(&late);
+    late.config = &cTestAssoConf[0];
+    csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+    TEST_CHECK(csm_asso_encoder(&late, &array, CSM_ASSO_AARQ));
+    TEST_CHECK((late.handshake != NULL) && (late.handshake == clients[1].handshake));
+    clients[1].state_cf = CF_ASSOCIATION_PENDING;
+    TEST_CHECK(!csm_asso_hold_handshake(&clients[1]));
+    TEST_CHECK((clients[1].handshake == NULL) && (clients[1].state_cf == CF_IDLE));
+    csm_asso_release_handshake(&clients[1]);
+    TEST_CHECK(csm_asso_hold_handshake(&late));
+
+    // The server takes the next one
+    TEST_CHECK(test_stack_associate(channel));
+    TEST_CHECK(clients[2].handshake != NULL);
+    TEST_CHECK(!csm_asso_hold_handshake(&clients[2]));
+    csm_channel_disconnect(channel);
+
+    // No slot lost: the ones left and the ones given back fill the pool again
+    csm_asso_set_clock(NULL);
+    csm_asso_release_handshake(&late);
+    valid = TRUE;
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+        valid = valid && csm_asso_encoder(&clients[i], &array, CSM_ASSO_AARQ);
+    }
+    TEST_CHECK(valid);
+    csm_asso_init(&late);
+    late.config = &cTestAssoConf[0];
+    csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+    TEST_CHECK(!csm_asso_encoder(&late, &array, CSM_ASSO_AARQ));
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_asso_release_handshake(&clients[i]);
+    }
+}
+
+// The association state given by the caller is used instead of the stack one
+static void test_asso_caller_state(void)
+{
+    static const uint8_t cGetLdn[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x01U, 0x00U, 0x00U, 0x2AU, 0x00U, 0x00U, 0xFFU, 0x02U, 0x00U };
+    static csm_asso_state state;
+    csm_array packet;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+    uint8_t other = test_stack_open(TEST_CLIENT_SAP);
+
+    csm_asso_init(&state);
+    state.config = &cTestAssoConf[0];
+    test_stack_packet(&packet, cTestAarq, cTestAarqSize);
+    TEST_CHECK(csm_channel_execute_asso(channel, &state, NULL, &packet) > 0);
+    TEST_CHECK(state.state_cf == CF_ASSOCIATED);
+
+    // The association of the stack for that client is still closed
+    TEST_CHECK(test_stack_exchange(other, cGetLdn, sizeof(cGetLdn), &packet) == 0);
+    test_stack_packet(&packet, cGetLdn, sizeof(cGetLdn));
+    TEST_CHECK(csm_channel_execute_asso(channel, &state, NULL, &packet) > 0);
+    // Answered by the services: the database of this suite knows no object
+    TEST_CHECK(packet.buff[packet.offset] == AXDR_EXCEPTION_RESPONSE);
+
+    csm_channel_disconnect(other);
+    csm_channel_disconnect(channel);
+    TEST_CHECK(state.state_cf == CF_IDLE);
+}
+
+#define TEST_ASSO_THREADS   4U
+#define TEST_ASSO_ROUNDS    200000U
+
+// Take and give back handshakes, as the transports threads executing AARQs at the same time
+static void *test_asso_churn(void *arg)
+{
+    csm_asso_state *state = (csm_asso_state *)arg;
+    uint8_t aarq[128];
+    csm_array array;
+    uint32_t failures = 0U;
+
+    for (uint32_t i = 0U; i < TEST_ASSO_ROUNDS; i++)
+    {
+        csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+        failures += csm_asso_encoder(state, &array, CSM_ASSO_AARQ) ? 0U : 1U;
+        csm_asso_release_handshake(state);
+    }
+    return (failures == 0U) ? arg : NULL;
+}
+
+static void test_asso_threads(void)
+{
+    static csm_asso_state states[CSM_DEF_MAX_HANDSHAKES];
+    pthread_t threads[TEST_ASSO_THREADS];
+    uint8_t aarq[128];
+    csm_array array;
+    void *result;
+
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_asso_init(&states[i]);
+        states[i].config = &cTestAssoConf[0];
+    }
+    for (uint32_t i = 0U; i < TEST_ASSO_THREADS; i++)
+    {
+        TEST_CHECK(pthread_create(&threads[i], NULL, test_asso_churn, &states[i]) == 0);
+    }
+    for (uint32_t i = 0U; i < TEST_ASSO_THREADS; i++)
+    {
+        TEST_CHECK((pthread_join(threads[i], &result) == 0) && (result == &states[i]));
+    }
+
+    // No slot lost nor given twice
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        csm_array_init(&array, aarq, sizeof(aarq), 0U, 0U);
+        TEST_CHECK(csm_asso_encoder(&states[i], &array, CSM_ASSO_AARQ));
+    }
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_HANDSHAKES; i++)
+    {
+        for (uint32_t j = i + 1U; j < CSM_DEF_MAX_HANDSHAKES; j++)
+        {
+            TEST_CHECK(states[i].handshake != states[j].handshake);
+        }
+        csm_asso_release_handshake(&states[i]);
+    }
+}
+
+void test_association(void)
+{
+    test_stack_init(test_asso_db);
+    test_asso_aarq_end();
+    test_asso_conformance();
+    test_asso_no_handshake();
+    test_asso_reclaim();
+    test_asso_caller_state();
+    test_asso_threads();
+}
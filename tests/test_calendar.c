@@ -0,0 +1,131 @@
+/**
+ * Unit tests of the calendar queue and of the jittered scheduling
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "calendar.h"
+#include "clock.h"
+
+#define TEST_CAL_BUCKETS    128U
+#define TEST_CAL_JOBS       1000U
+#define TEST_CAL_SHIFT      4U      // 16 s buckets, horizon 2048 s
+#define TEST_CAL_START      1700000000U
+
+static cal_bucket buckets[TEST_CAL_BUCKETS];
+static uint64_t map[CAL_MAP_WORDS(TEST_CAL_BUCKETS)];
+static cal_node nodes[TEST_CAL_JOBS];
+static uint32_t due[TEST_CAL_JOBS];
+static uint8_t popped[TEST_CAL_JOBS];
+
+static uint32_t test_cal_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    *state = x;
+    return x;
+}
+
+// Jobs over three horizons, some removed; time advances by irregular steps, every due job is popped once
+static int test_cal_random(cal_queue *q)
+{
+    uint32_t state = 0xC0FFEEU;
+    uint32_t now = TEST_CAL_START;
+    uint32_t end = TEST_CAL_START + (3U * (TEST_CAL_BUCKETS << TEST_CAL_SHIFT));
+    uint32_t removed = 0U;
+    int valid = TRUE;
+
+    memset(popped, 0, sizeof(popped));
+    for (uint32_t job = 0U; valid && (job < TEST_CAL_JOBS); job++)
+    {
+        due[job] = TEST_CAL_START + (test_cal_rand(&state) % (end - TEST_CAL_START));
+        valid = cal_insert(q, job, due[job]);
+    }
+    for (uint32_t job = 0U; valid && (job < TEST_CAL_JOBS); job += 7U)
+    {
+        valid = cal_remove(q, job) && !cal_is_queued(q, job);
+        popped[job] = 1U;
+        removed++;
+    }
+    valid = valid && (cal_count(q) == (TEST_CAL_JOBS - removed));
+
+    while (valid && (now <= end))
+    {
+        uint32_t job;
+
+        while (valid && ((job = cal_pop(q, now)) != CAL_NONE))
+        {
+            valid = (job < TEST_CAL_JOBS) && !popped[job] && (due[job] <= now);
+            popped[job] = 1U;
+        }
+        // Nothing due left behind
+        for (uint32_t i = 0U; valid && (i < TEST_CAL_JOBS); i++)
+        {
+            valid = popped[i] || (due[i] > now);
+        }
+        now += 1U + (test_cal_rand(&state) % 40U);
+    }
+    return valid && (cal_count(q) == 0U);
+}
+
+void test_calendar(void)
+{
+    cal_queue q;
+    static const uint8_t cId1[] = { 'A', 'B', 'C', 0x00U, 0x00U, 0x01U };
+    uint32_t slots[10];
+
+    TEST_CHECK(!cal_init(&q, buckets, map, 100U, nodes, TEST_CAL_JOBS, TEST_CAL_SHIFT, TEST_CAL_START));
+    TEST_CHECK(cal_init(&q, buckets, map, TEST_CAL_BUCKETS, nodes, TEST_CAL_JOBS, TEST_CAL_SHIFT, TEST_CAL_START));
+
+    // Queued once, a past due time is due now
+    TEST_CHECK(cal_insert(&q, 1U, TEST_CAL_START + 100U) && !cal_insert(&q, 1U, TEST_CAL_START + 200U));
+    TEST_CHECK(!cal_insert(&q, TEST_CAL_JOBS, TEST_CAL_START));
+    TEST_CHECK(cal_insert(&q, 2U, TEST_CAL_START - 50U));
+    TEST_CHECK(cal_pop(&q, TEST_CAL_START) == 2U);
+    TEST_CHECK(cal_pop(&q, TEST_CAL_START + 99U) == CAL_NONE);
+    TEST_CHECK((cal_pop(&q, TEST_CAL_START + 100U) == 1U) && (cal_count(&q) == 0U));
+    TEST_CHECK(!cal_remove(&q, 1U));
+
+    // Beyond the horizon: the job waits in its bucket for the next turn
+    TEST_CHECK(cal_insert(&q, 3U, TEST_CAL_START + 100U + (TEST_CAL_BUCKETS << TEST_CAL_SHIFT)));
+    TEST_CHECK(cal_pop(&q, TEST_CAL_START + 120U) == CAL_NONE);
+    TEST_CHECK(cal_pop(&q, TEST_CAL_START + 100U + (TEST_CAL_BUCKETS << TEST_CAL_SHIFT)) == 3U);
+
+    TEST_CHECK(cal_init(&q, buckets, map, TEST_CAL_BUCKETS, nodes, TEST_CAL_JOBS, TEST_CAL_SHIFT, TEST_CAL_START));
+    TEST_CHECK(test_cal_random(&q));
+
+    // Jitter: deterministic, in the window, spread over it
+    TEST_CHECK(cal_jitter_offset(cId1, sizeof(cId1), 3600U) == cal_jitter_offset(cId1, sizeof(cId1), 3600U));
+    memset(slots, 0, sizeof(slots));
+    int valid = TRUE;
+    for (uint32_t serial = 0U; serial < 10000U; serial++)
+    {
+        uint8_t id[4] = { (uint8_t)(serial >> 24), (uint8_t)(serial >> 16), (uint8_t)(serial >> 8), (uint8_t)serial };
+        uint32_t offset = cal_jitter_offset(id, sizeof(id), 3600U);
+
+        valid = valid && (offset < 3600U);
+        slots[offset / 360U]++;
+    }
+    TEST_CHECK(valid);
+    for (uint32_t i = 0U; i < 10U; i++)
+    {
+        TEST_CHECK((slots[i] > 850U) && (slots[i] < 1150U));
+    }
+
+    // Next occurrence: strictly after now, at the offset of the local period
+    uint32_t now = TEST_CAL_START + 12345U;
+    uint32_t next = cal_next_due(now, 900U, 100U);
+    TEST_CHECK((next > now) && (next <= (now + 900U)) && ((clk_tz_local(next, NULL) % 900U) == 100U));
+    TEST_CHECK(cal_next_due(next, 900U, 100U) == (next + 900U));
+    TEST_CHECK(cal_next_due(now, 0U, 100U) == (now + 1U));
+}
@@ -0,0 +1,84 @@
+/**
+ * Unit tests of the capture file
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "capture.h"
+
+#define TEST_CAP_PATH       "test_capture.cap"
+#define TEST_CAP_START      1700000000000000ULL
+
+static const uint8_t cFrame1[] = { 0x00U, 0x01U, 0x00U, 0x10U, 0x00U, 0x01U, 0x00U, 0x02U, 0xC0U, 0x01U };
+static const uint8_t cFrame2[] = { 0x00U, 0x01U, 0x00U, 0x01U, 0x00U, 0x10U, 0x00U, 0x01U, 0xC4U };
+
+// Copy the first size bytes of the capture file
+static int test_cap_truncate(long size)
+{
+    uint8_t data[256];
+    FILE *file = fopen(TEST_CAP_PATH, "rb");
+    size_t length = (file != NULL) ? fread(data, 1U, sizeof(data), file) : 0U;
+
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    file = fopen(TEST_CAP_PATH, "wb");
+    int valid = (file != NULL) && ((long)length >= size) && (fwrite(data, 1U, (size_t)size, file) == (size_t)size);
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    return valid;
+}
+
+void test_capture(void)
+{
+    cap_file cap;
+    cap_record record;
+    uint8_t frame[16];
+
+    TEST_CHECK(cap_create(&cap, TEST_CAP_PATH, CAP_LINK_WRAPPER, TEST_CAP_START));
+    TEST_CHECK(cap_write(&cap, TEST_CAP_START + 1500U, CAP_RX, 3U, cFrame1, sizeof(cFrame1)));
+    TEST_CHECK(cap_write(&cap, TEST_CAP_START + 2000U, CAP_TX, 3U, cFrame2, sizeof(cFrame2)));
+    cap_close(&cap);
+
+    TEST_CHECK(cap_open(&cap, TEST_CAP_PATH));
+    TEST_CHECK(cap.link == CAP_LINK_WRAPPER);
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == 1);
+    TEST_CHECK((record.time_us == (TEST_CAP_START + 1500U)) && (record.channel == 3U) && (record.direction == CAP_RX));
+    TEST_CHECK((record.size == sizeof(cFrame1)) && (memcmp(frame, cFrame1, sizeof(cFrame1)) == 0));
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == 1);
+    TEST_CHECK((record.time_us == (TEST_CAP_START + 2000U)) && (record.direction == CAP_TX));
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == 0);
+    cap_close(&cap);
+
+    // A frame larger than the buffer is an error, not the end of the capture
+    TEST_CHECK(cap_open(&cap, TEST_CAP_PATH));
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(cFrame1) - 1U) == -1);
+    cap_close(&cap);
+
+    // Truncated frame, then truncated record header
+    TEST_CHECK(test_cap_truncate((long)(CAP_HEADER_SIZE + CAP_RECORD_SIZE + sizeof(cFrame1) + CAP_RECORD_SIZE + 2U)));
+    TEST_CHECK(cap_open(&cap, TEST_CAP_PATH));
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == 1);
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == -1);
+    cap_close(&cap);
+
+    TEST_CHECK(test_cap_truncate((long)(CAP_HEADER_SIZE + CAP_RECORD_SIZE + sizeof(cFrame1) + 5U)));
+    TEST_CHECK(cap_open(&cap, TEST_CAP_PATH));
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == 1);
+    TEST_CHECK(cap_read(&cap, &record, frame, sizeof(frame)) == -1);
+    cap_close(&cap);
+
+    (void) remove(TEST_CAP_PATH);
+}
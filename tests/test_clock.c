@@ -0,0 +1,346 @@
+/**
+ * Unit tests of the time zone and DST tables, of the batch conversions and of the sortable keys
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "tests.h"
+#include "clock.h"
+#include "csm_axdr_codec.h"
+
+#define TEST_CLK_2024       1704067200U     // 2024-01-01 00:00 UTC
+#define TEST_CLK_DAY        86400U
+#define TEST_CLK_THREADS    4U
+#define TEST_CLK_BATCH      200U            // Several blocks of the batch conversion
+#define TEST_CLK_STRIDE     16U             // A date-time column in rows of 16 bytes
+#define TEST_CLK_2106       4291747200U     // 2106-01-01 00:00 UTC, end of the batch conversion range
+
+static int dst_days[TEST_CLK_THREADS];
+static uint32_t epochs[TEST_CLK_BATCH];
+static uint32_t converted[TEST_CLK_BATCH];
+static uint8_t rows[TEST_CLK_BATCH * TEST_CLK_STRIDE];
+
+static uint32_t test_clock_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    *state = x;
+    return x;
+}
+
+static void test_clock_cosem(uint8_t *dt, uint32_t year, uint32_t month, uint32_t day, uint32_t hour, uint32_t minute,
+                             uint32_t second, uint32_t hundredths, uint16_t deviation)
+{
+    dt[0] = (uint8_t)(year >> 8U);
+    dt[1] = (uint8_t)year;
+    dt[2] = (uint8_t)month;
+    dt[3] = (uint8_t)day;
+    dt[4] = 0xFFU;
+    dt[5] = (uint8_t)hour;
+    dt[6] = (uint8_t)minute;
+    dt[7] = (uint8_t)second;
+    dt[8] = (uint8_t)hundredths;
+    dt[9] = (uint8_t)(deviation >> 8U);
+    dt[10] = (uint8_t)deviation;
+    dt[11] = 0x00U;
+}
+
+// Scalar reference, years 1970 to 2020
+static uint32_t test_clock_scalar(const uint8_t *dt)
+{
+    struct tm tms;
+
+    memset(&tms, 0, sizeof(tms));
+    tms.tm_year = (int)((((uint32_t)dt[0] << 8U) | dt[1]) - 1900U);
+    tms.tm_mon = dt[2] - 1;
+    tms.tm_mday = dt[3];
+    tms.tm_hour = dt[5];
+    tms.tm_min = dt[6];
+    tms.tm_sec = dt[7];
+    return clk_to_epoch(&tms);
+}
+
+// Before clk_tz_init(): the default rules are evaluated without writing any shared state
+static void *test_clock_reader(void *arg)
+{
+    int *days = (int *)arg;
+
+    for (uint32_t d = 0U; d < 366U; d++)
+    {
+        *days += clk_is_dst_utc(TEST_CLK_2024 + (d * TEST_CLK_DAY) + 43200U);
+    }
+    return NULL;
+}
+
+static void test_clock_default(void)
+{
+    pthread_t threads[TEST_CLK_THREADS];
+    uint32_t begin = 0U;
+    uint32_t end = 0U;
+
+    for (uint32_t i = 0U; i < TEST_CLK_THREADS; i++)
+    {
+        dst_days[i] = 0;
+        TEST_CHECK(pthread_create(&threads[i], NULL, test_clock_reader, &dst_days[i]) == 0);
+    }
+    for (uint32_t i = 0U; i < TEST_CLK_THREADS; i++)
+    {
+        (void) pthread_join(threads[i], NULL);
+        // April 7th to October 27th 2024
+        TEST_CHECK(dst_days[i] == 203);
+    }
+
+    // U.S. rules: first Sunday of April 02:00 standard time, last Sunday of October 02:00 summer time
+    TEST_CHECK(clk_tz_transitions(2024U, &begin, &end));
+    TEST_CHECK(begin == (TEST_CLK_2024 + (97U * TEST_CLK_DAY) + 7200U));
+    TEST_CHECK(end == (TEST_CLK_2024 + (300U * TEST_CLK_DAY) + 3600U));
+    TEST_CHECK(clk_is_dst(2024U, 7U, 14U) == 1);
+    TEST_CHECK(clk_is_dst(2024U, 12U, 1U) == 0);
+    TEST_CHECK(clk_is_dst(2024U, 2U, 30U) == -1);
+}
+
+// The table gives the same answers as the evaluation of the default rules
+static void test_clock_table(void)
+{
+    int same = TRUE;
+    int before[96];
+
+    for (uint32_t i = 0U; i < 96U; i++)
+    {
+        before[i] = clk_is_dst_utc(TEST_CLK_2024 + (i * 4U * TEST_CLK_DAY) + (i * 3607U));
+    }
+    clk_tz_init(NULL);
+    for (uint32_t i = 0U; i < 96U; i++)
+    {
+        same = same && (before[i] == clk_is_dst_utc(TEST_CLK_2024 + (i * 4U * TEST_CLK_DAY) + (i * 3607U)));
+    }
+    TEST_CHECK(same);
+}
+
+// Southern hemisphere: DST spans the new year
+static void test_clock_southern(void)
+{
+    clk_tz_rules rules;
+    uint32_t begin = 0U;
+    uint32_t end = 0U;
+    int dst = FALSE;
+
+    memset(&rules, 0, sizeof(rules));
+    rules.time_zone = -600;     // UTC+10
+    rules.dst_begin.date.day = 1U;
+    rules.dst_begin.date.dow = 7U;
+    rules.dst_begin.date.month = 10U;
+    rules.dst_begin.date.year = 0xFFFFU;
+    rules.dst_begin.time.hour = 2U;
+    rules.dst_end.date.day = 1U;
+    rules.dst_end.date.dow = 7U;
+    rules.dst_end.date.month = 4U;
+    rules.dst_end.date.year = 0xFFFFU;
+    rules.dst_end.time.hour = 3U;
+    rules.dst_deviation = 60;
+    rules.dst_enabled = TRUE;
+    clk_tz_init(&rules);
+
+    TEST_CHECK(clk_tz_transitions(2024U, &begin, &end));
+    TEST_CHECK(end < begin);
+    TEST_CHECK(clk_is_dst(2024U, 1U, 15U) == 1);
+    TEST_CHECK(clk_is_dst(2024U, 7U, 15U) == 0);
+    // January 15th 2024, 00:00 UTC is 11:00 summer time
+    TEST_CHECK(clk_tz_local(TEST_CLK_2024 + (14U * TEST_CLK_DAY), &dst) == (TEST_CLK_2024 + (14U * TEST_CLK_DAY) + 39600U));
+    TEST_CHECK(dst);
+
+    // Invalid rule: DST disabled
+    rules.dst_end.date.month = 13U;
+    clk_tz_init(&rules);
+    TEST_CHECK(!clk_tz_transitions(2024U, &begin, &end));
+    TEST_CHECK(clk_is_dst(2024U, 1U, 15U) == 0);
+    clk_tz_init(NULL);
+}
+
+static uint32_t test_clock_one(uint32_t year, uint32_t month, uint32_t day, uint32_t hour)
+{
+    uint8_t dt[CLK_COSEM_DATETIME_SIZE];
+    uint32_t epoch = 0U;
+
+    test_clock_cosem(dt, year, month, day, hour, 0U, 0U, 0U, 0U);
+    (void) clk_cosem_to_epoch_batch(dt, CLK_COSEM_DATETIME_SIZE, 1U, &epoch);
+    return epoch;
+}
+
+// Epoch to date-time and back, over the whole range, in place in rows larger than a date-time
+static void test_clock_batch(void)
+{
+    static const uint8_t cUndefined[CLK_COSEM_DATETIME_SIZE] = { 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x80U, 0x00U, 0xFFU };
+    uint32_t state = 0x2468ACE1U;
+    int valid = TRUE;
+
+    memset(rows, 0xA5, sizeof(rows));
+    for (uint32_t i = 0U; i < TEST_CLK_BATCH; i++)
+    {
+        // One out of two before 2021, for the scalar reference
+        epochs[i] = ((i % 2U) == 0U) ? (test_clock_rand(&state) % 1609459200U) : (test_clock_rand(&state) % TEST_CLK_2106);
+    }
+    epochs[0] = 0U;
+    epochs[1] = 4107456000U + 86399U;   // 2100-02-28 23:59:59
+    epochs[2] = 951782400U;             // 2000-02-29
+    epochs[3] = TEST_CLK_2106 - 1U;
+    epochs[4] = CLK_EPOCH_INVALID;
+
+    clk_epoch_to_cosem_batch(epochs, TEST_CLK_BATCH, rows, TEST_CLK_STRIDE, -60, 0x80U);
+    TEST_CHECK(clk_cosem_to_epoch_batch(rows, TEST_CLK_STRIDE, TEST_CLK_BATCH, converted) == (TEST_CLK_BATCH - 1U));
+    for (uint32_t i = 0U; i < TEST_CLK_BATCH; i++)
+    {
+        const uint8_t *dt = &rows[i * TEST_CLK_STRIDE];
+
+        valid = valid && (converted[i] == epochs[i]) && (dt[12] == 0xA5U) && (dt[15] == 0xA5U);
+        if (epochs[i] != CLK_EPOCH_INVALID)
+        {
+            valid = valid && (dt[8] == 0U) && (dt[9] == 0xFFU) && (dt[10] == 0xC4U) && (dt[11] == 0x80U);
+        }
+        if (epochs[i] < 1609459200U)
+        {
+            valid = valid && (test_clock_scalar(dt) == epochs[i]);
+        }
+    }
+    TEST_CHECK(valid);
+    TEST_CHECK(memcmp(&rows[4U * TEST_CLK_STRIDE], cUndefined, CLK_COSEM_DATETIME_SIZE) == 0);
+    // 2100-02-28 is a Sunday, 2000-02-29 a Tuesday, 2105-12-31 a Thursday
+    TEST_CHECK((rows[TEST_CLK_STRIDE + 4U] == 7U) && (rows[(2U * TEST_CLK_STRIDE) + 4U] == 2U));
+    TEST_CHECK((rows[(3U * TEST_CLK_STRIDE) + 0U] == 0x08U) && (rows[(3U * TEST_CLK_STRIDE) + 1U] == 0x39U) &&
+               (rows[(3U * TEST_CLK_STRIDE) + 3U] == 31U) && (rows[(3U * TEST_CLK_STRIDE) + 4U] == 4U) &&
+               (rows[(3U * TEST_CLK_STRIDE) + 7U] == 59U));
+
+    // Leap years, 2100 is not one
+    TEST_CHECK(test_clock_one(2024U, 2U, 29U, 0U) == 1709164800U);
+    TEST_CHECK(test_clock_one(2096U, 2U, 29U, 0U) == 3981312000U);
+    TEST_CHECK(test_clock_one(2100U, 3U, 1U, 0U) == 4107542400U);
+    TEST_CHECK(test_clock_one(2023U, 2U, 29U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2100U, 2U, 29U, 0U) == CLK_EPOCH_INVALID);
+
+    // Wildcards and invalid fields, years out of the epoch range
+    TEST_CHECK(test_clock_one(0xFFFFU, 1U, 1U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 0xFFU, 1U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 0xFEU, 1U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 1U, 0xFEU, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 1U, 0U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 4U, 31U, 0U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 1U, 1U, 0xFFU) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2024U, 1U, 1U, 24U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(1969U, 12U, 31U, 23U) == CLK_EPOCH_INVALID);
+    TEST_CHECK(test_clock_one(2106U, 1U, 1U, 0U) == CLK_EPOCH_INVALID);
+}
+
+static uint64_t test_clock_key(uint32_t year, uint32_t month, uint32_t day, uint32_t hour, uint32_t minute, uint32_t second,
+                               uint32_t hundredths, uint16_t deviation, int upper)
+{
+    uint8_t dt[CLK_COSEM_DATETIME_SIZE];
+
+    test_clock_cosem(dt, year, month, day, hour, minute, second, hundredths, deviation);
+    return clk_cosem_key(dt, upper);
+}
+
+// Keys of date-times compare like the instants, wildcards widen a bound to the whole unspecified period
+static void test_clock_keys(void)
+{
+    static const uint8_t cRange[] = { 0x01U, 0x02U, 0x04U, 0x02U, 0x04U, 0x12U, 0x00U, 0x08U, 0x09U, 0x06U, 0x00U, 0x00U, 0x01U, 0x00U,
+                                      0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U };
+    const uint32_t march15 = 1710460800U;   // 2024-03-15 00:00 UTC
+    uint32_t state = 0x13579BDFU;
+    uint8_t match[TEST_CLK_BATCH];
+    uint8_t descriptor[64];
+    csm_array array;
+    uint64_t from = 0U;
+    uint64_t to = 0U;
+    int valid = TRUE;
+
+    // Same order as the epoch keys
+    for (uint32_t i = 0U; i < TEST_CLK_BATCH; i++)
+    {
+        epochs[i] = test_clock_rand(&state) % TEST_CLK_2106;
+    }
+    clk_epoch_to_cosem_batch(epochs, TEST_CLK_BATCH, rows, TEST_CLK_STRIDE, 0, 0U);
+    for (uint32_t i = 0U; i < TEST_CLK_BATCH; i++)
+    {
+        uint64_t key = clk_cosem_key(&rows[i * TEST_CLK_STRIDE], FALSE);
+        uint64_t next = clk_cosem_key(&rows[((i + 1U) % TEST_CLK_BATCH) * TEST_CLK_STRIDE], FALSE);
+
+        valid = valid && (key == clk_epoch_key(epochs[i])) && (clk_cosem_key(&rows[i * TEST_CLK_STRIDE], TRUE) == key);
+        valid = valid && ((key < next) == (epochs[i] < epochs[(i + 1U) % TEST_CLK_BATCH]));
+    }
+    TEST_CHECK(valid);
+    TEST_CHECK(clk_epoch_key(0U) < clk_epoch_key(1U));
+
+    // Hundredths between two seconds; deviation in minutes, UTC = local time + deviation, 0x8000 is zero
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0U, 0U, 0U, 0U, 0U, FALSE) == clk_epoch_key(march15));
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0U, 0U, 0U, 50U, 0U, FALSE) > clk_epoch_key(march15));
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0U, 0U, 0U, 99U, 0U, FALSE) < clk_epoch_key(march15 + 1U));
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 1U, 0U, 0U, 0U, 0xFFC4U, FALSE) == clk_epoch_key(march15));
+    TEST_CHECK(test_clock_key(2024U, 3U, 14U, 19U, 0U, 0U, 0U, 300U, FALSE) == clk_epoch_key(march15));
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0U, 0U, 0U, 0U, 0x8000U, FALSE) == clk_epoch_key(march15));
+
+    // 0xFF: lowest value for a lower bound, highest one for an upper bound
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0U, FALSE) == clk_epoch_key(march15));
+    TEST_CHECK(test_clock_key(2024U, 3U, 15U, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0U, TRUE) == (clk_epoch_key(march15 + 86399U) | 99U));
+    TEST_CHECK(test_clock_key(2024U, 3U, 0xFFU, 0U, 0U, 0U, 0U, 0U, FALSE) == clk_epoch_key(march15 - (14U * TEST_CLK_DAY)));
+    TEST_CHECK(test_clock_key(2024U, 3U, 0xFFU, 0U, 0U, 0U, 0U, 0U, TRUE) == clk_epoch_key(march15 + (16U * TEST_CLK_DAY)));
+    TEST_CHECK(test_clock_key(2024U, 0xFFU, 1U, 0U, 0U, 0U, 0U, 0U, FALSE) == clk_epoch_key(TEST_CLK_2024));
+    TEST_CHECK(test_clock_key(2024U, 0xFFU, 0xFFU, 0U, 0U, 0U, 0U, 0U, TRUE) == clk_epoch_key(TEST_CLK_2024 + (365U * TEST_CLK_DAY)));
+    TEST_CHECK(test_clock_key(0xFFFFU, 3U, 15U, 0U, 0U, 0U, 0U, 0U, FALSE) == CLK_KEY_MIN);
+    TEST_CHECK(test_clock_key(0xFFFFU, 3U, 15U, 0U, 0U, 0U, 0U, 0U, TRUE) == CLK_KEY_MAX);
+
+    // 0xFE: last day of the month, 0xFD: second last day
+    TEST_CHECK(test_clock_key(2024U, 2U, 0xFEU, 0U, 0U, 0U, 0U, 0U, FALSE) == test_clock_key(2024U, 2U, 29U, 0U, 0U, 0U, 0U, 0U, FALSE));
+    TEST_CHECK(test_clock_key(2024U, 2U, 0xFDU, 0U, 0U, 0U, 0U, 0U, TRUE) == test_clock_key(2024U, 2U, 28U, 0U, 0U, 0U, 0U, 0U, TRUE));
+    TEST_CHECK(test_clock_key(2023U, 2U, 0xFEU, 0U, 0U, 0U, 0U, 0U, FALSE) == test_clock_key(2023U, 2U, 28U, 0U, 0U, 0U, 0U, 0U, FALSE));
+    TEST_CHECK(test_clock_key(2024U, 4U, 0xFEU, 0U, 0U, 0U, 0U, 0U, FALSE) == test_clock_key(2024U, 4U, 30U, 0U, 0U, 0U, 0U, 0U, FALSE));
+
+    // Filter of a column, half an hour from March 14th 18:00: the day of March 15th, then one hour with its bounds
+    for (uint32_t i = 0U; i < 48U; i++)
+    {
+        epochs[i] = (march15 - (6U * 3600U)) + (i * 1800U);
+    }
+    clk_epoch_to_cosem_batch(epochs, 48U, rows, TEST_CLK_STRIDE, 0, 0U);
+    TEST_CHECK(clk_cosem_filter_range(rows, TEST_CLK_STRIDE, 48U, test_clock_key(2024U, 3U, 15U, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0U, FALSE),
+                                      test_clock_key(2024U, 3U, 15U, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0U, TRUE), match) == 36U);
+    TEST_CHECK(!match[11] && match[12] && match[47]);
+    TEST_CHECK(clk_cosem_filter_range(rows, TEST_CLK_STRIDE, 48U, clk_epoch_key(march15), clk_epoch_key(march15 + 3600U), match) == 3U);
+    TEST_CHECK(!match[11] && match[12] && match[14] && !match[15]);
+
+    // range_descriptor: from the start of the 15th to the end of the month
+    csm_array_init(&array, descriptor, sizeof(descriptor), 0U, 0U);
+    (void) csm_array_write_buff(&array, cRange, sizeof(cRange));
+    (void) csm_array_write_u8(&array, AXDR_TAG_OCTETSTRING);
+    (void) csm_array_write_u8(&array, CLK_COSEM_DATETIME_SIZE);
+    test_clock_cosem(&descriptor[array.wr_index], 2024U, 3U, 15U, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x8000U);
+    array.wr_index += CLK_COSEM_DATETIME_SIZE;
+    (void) csm_array_write_u8(&array, AXDR_TAG_OCTETSTRING);
+    (void) csm_array_write_u8(&array, CLK_COSEM_DATETIME_SIZE);
+    test_clock_cosem(&descriptor[array.wr_index], 2024U, 3U, 0xFEU, 0xFFU, 0xFFU, 0xFFU, 0xFFU, 0x8000U);
+    array.wr_index += CLK_COSEM_DATETIME_SIZE;
+    (void) csm_array_write_u8(&array, AXDR_TAG_ARRAY);
+    (void) csm_array_write_u8(&array, 0U);
+    TEST_CHECK(clk_cosem_range_decode(&array, &from, &to));
+    TEST_CHECK((from == clk_epoch_key(march15)) && (to == (clk_epoch_key(march15 + (17U * TEST_CLK_DAY) - 1U) | 99U)));
+    array.rd_index = 0U;
+    array.wr_index -= 4U;
+    TEST_CHECK(!clk_cosem_range_decode(&array, &from, &to));
+}
+
+void test_clock(void)
+{
+    test_clock_default();
+    test_clock_table();
+    test_clock_southern();
+    test_clock_batch();
+    test_clock_keys();
+}
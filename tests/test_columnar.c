@@ -0,0 +1,91 @@
+/**
+ * Unit tests of the columnar export
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_columnar.h"
+
+// Clock, energy register, status (visible-string)
+static const uint8_t cCaptureObjects[] = {
+    0x01U, 0x03U,
+    0x02U, 0x04U, 0x12U, 0x00U, 0x08U, 0x09U, 0x06U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U,
+    0x02U, 0x04U, 0x12U, 0x00U, 0x03U, 0x09U, 0x06U, 0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U,
+    0x02U, 0x04U, 0x12U, 0x00U, 0x01U, 0x09U, 0x06U, 0x00U, 0x00U, 0x60U, 0x0AU, 0x01U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U
+};
+
+// 2017-01-01 00:00:00 and 00:15:00, the second row without status
+static const uint8_t cBuffer[] = {
+    0x01U, 0x02U,
+    0x02U, 0x03U,
+    0x09U, 0x0CU, 0x07U, 0xE1U, 0x01U, 0x01U, 0x07U, 0x00U, 0x00U, 0x00U, 0x00U, 0x80U, 0x00U, 0x00U,
+    0x06U, 0x00U, 0x00U, 0x30U, 0x39U,
+    0x0AU, 0x02U, 'O', 'K',
+    0x02U, 0x03U,
+    0x09U, 0x0CU, 0x07U, 0xE1U, 0x01U, 0x01U, 0x07U, 0x00U, 0x0FU, 0x00U, 0x00U, 0x80U, 0x00U, 0x00U,
+    0x06U, 0x00U, 0x00U, 0x30U, 0x3AU,
+    0x00U
+};
+
+static uint64_t arena[1024];
+
+void test_columnar(void)
+{
+    csm_col_schema schema;
+    csm_col_batch batch;
+    struct ArrowSchema out_schema;
+    struct ArrowArray out_array;
+    uint8_t buffer[sizeof(cCaptureObjects) + sizeof(cBuffer)];
+
+    TEST_CHECK(csm_col_schema_init(&schema, cCaptureObjects, sizeof(cCaptureObjects)));
+    TEST_CHECK((schema.nb_columns == 3U) && (schema.columns[0].type == CSM_COL_TIMESTAMP));
+    TEST_CHECK(strcmp(schema.columns[1].name, "3-1.0.1.8.0.255:2") == 0);
+
+    // One capture object too many, or trailing bytes
+    TEST_CHECK(!csm_col_schema_init(&schema, cCaptureObjects, sizeof(cCaptureObjects) - 20U));
+    memcpy(buffer, cCaptureObjects, sizeof(cCaptureObjects));
+    buffer[sizeof(cCaptureObjects)] = 0x00U;
+    TEST_CHECK(!csm_col_schema_init(&schema, buffer, sizeof(cCaptureObjects) + 1U) && (schema.nb_columns == 0U));
+
+    TEST_CHECK(csm_col_schema_init(&schema, cCaptureObjects, sizeof(cCaptureObjects)));
+    csm_col_batch_init(&batch, &schema, (uint8_t *)arena, sizeof(arena), 16U, 64U);
+    TEST_CHECK(csm_col_decode(&batch, cBuffer, sizeof(cBuffer)));
+    TEST_CHECK((batch.rows == 2U) && (batch.errors == 0U));
+    TEST_CHECK((schema.columns[1].type == CSM_COL_UINT32) && (schema.columns[2].type == CSM_COL_UTF8));
+
+    // Bytes after the last row: the buffer is rejected and its rows removed
+    memcpy(buffer, cBuffer, sizeof(cBuffer));
+    buffer[sizeof(cBuffer)] = 0x00U;
+    TEST_CHECK(!csm_col_decode(&batch, buffer, sizeof(cBuffer) + 1U));
+    TEST_CHECK((batch.rows == 2U) && (batch.errors == 1U));
+
+    // Truncated
+    TEST_CHECK(!csm_col_decode(&batch, cBuffer, sizeof(cBuffer) - 1U));
+    TEST_CHECK((batch.rows == 2U) && (batch.errors == 2U));
+
+    // A full batch keeps the first rows, the others are counted as lost
+    csm_col_batch_init(&batch, &schema, (uint8_t *)arena, sizeof(arena), 1U, 64U);
+    TEST_CHECK(csm_col_decode(&batch, cBuffer, sizeof(cBuffer)));
+    TEST_CHECK((batch.rows == 1U) && (batch.overflows == 1U));
+
+    csm_col_batch_init(&batch, &schema, (uint8_t *)arena, sizeof(arena), 16U, 64U);
+    TEST_CHECK(csm_col_decode(&batch, cBuffer, sizeof(cBuffer)));
+    csm_col_export(&batch, &out_schema, &out_array);
+    TEST_CHECK((strcmp(out_schema.format, "+s") == 0) && (out_schema.n_children == 3));
+    TEST_CHECK((out_array.length == 2) && (out_array.n_children == 3));
+    TEST_CHECK(strcmp(out_schema.children[0]->format, "tss:") == 0);
+    TEST_CHECK(((const int64_t *)out_array.children[0]->buffers[1])[1] == (1483228800 + 900));
+    TEST_CHECK(((const uint32_t *)out_array.children[1]->buffers[1])[0] == 12345U);
+    TEST_CHECK(out_array.children[2]->null_count == 1);
+    out_array.release(&out_array);
+    out_schema.release(&out_schema);
+    TEST_CHECK((out_array.release == NULL) && (out_schema.release == NULL));
+}
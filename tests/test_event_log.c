@@ -0,0 +1,128 @@
+/**
+ * Unit tests of the event log
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "event_log.h"
+#include "csm_axdr_codec.h"
+
+#define TEST_EVL_PATH       "test_event_log.evl"
+#define TEST_EVL_CAPACITY   8U
+#define TEST_EVL_STAGING    3U
+
+static uint8_t staging[2U * TEST_EVL_STAGING * sizeof(uint32_t)];
+
+static int test_evl_append(evl_log *log, uint32_t value)
+{
+    return evl_append(log, (const uint8_t *)&value);
+}
+
+// The selected entries hold consecutive values from the first one
+static int test_evl_check(const evl_log *log, uint32_t from_entry, uint32_t to_entry, uint32_t count, uint32_t first_value)
+{
+    uint32_t values[TEST_EVL_CAPACITY];
+    uint64_t first = 0U;
+
+    int valid = (evl_select(log, from_entry, to_entry, &first) == count);
+    valid = valid && evl_read(log, first, count, (uint8_t *)values);
+    for (uint32_t i = 0U; (i < count) && valid; i++)
+    {
+        valid = (values[i] == (first_value + i));
+    }
+    return valid;
+}
+
+void test_event_log(void)
+{
+    evl_log log;
+    uint32_t from_entry = 0U;
+    uint32_t to_entry = 0U;
+    uint16_t from_column = 0U;
+    uint16_t to_column = 0U;
+    uint64_t first = 0U;
+    uint8_t values[8];
+
+    (void) remove(TEST_EVL_PATH);
+    TEST_CHECK(evl_open(&log, TEST_EVL_PATH, sizeof(uint32_t), TEST_EVL_CAPACITY, staging, TEST_EVL_STAGING, 100U));
+
+    // A full half is sealed, the appends go on in the other one until the commit is late
+    for (uint32_t i = 0U; i < (2U * TEST_EVL_STAGING); i++)
+    {
+        TEST_CHECK(test_evl_append(&log, i));
+    }
+    TEST_CHECK(!test_evl_append(&log, 100U));
+    TEST_CHECK((log.dropped == 1U) && (evl_entries(&log) == 0U));
+    TEST_CHECK(!evl_seal(&log));
+
+    // The write only takes the sealed half
+    TEST_CHECK(evl_write(&log));
+    TEST_CHECK(evl_entries(&log) == TEST_EVL_STAGING);
+    TEST_CHECK(test_evl_check(&log, 1U, 0U, TEST_EVL_STAGING, 0U));
+    TEST_CHECK(evl_write(&log) && (log.commits == 1U));
+    TEST_CHECK(evl_commit(&log) && (evl_entries(&log) == (2U * TEST_EVL_STAGING)));
+
+    // Not committed: not readable
+    TEST_CHECK(test_evl_append(&log, 6U));
+    TEST_CHECK(!evl_read(&log, 6U, 1U, values));
+    TEST_CHECK(evl_poll(&log, 0U) && (evl_entries(&log) == 6U));
+    TEST_CHECK(evl_poll(&log, 100U) && (evl_entries(&log) == 7U));
+
+    // Ring wrap: the oldest entries are overwritten, the reads cross the end of the file
+    for (uint32_t i = 7U; i < 11U; i++)
+    {
+        TEST_CHECK(test_evl_append(&log, i));
+    }
+    TEST_CHECK(evl_commit(&log));
+    TEST_CHECK(evl_entries(&log) == TEST_EVL_CAPACITY);
+    TEST_CHECK(!evl_read(&log, 2U, 1U, values));
+    TEST_CHECK(test_evl_check(&log, 1U, 0U, TEST_EVL_CAPACITY, 3U));
+    TEST_CHECK(test_evl_check(&log, 6U, 7U, 2U, 8U));
+    TEST_CHECK(test_evl_check(&log, 7U, 20U, 2U, 9U));
+    TEST_CHECK(evl_select(&log, 9U, 0U, &first) == 0U);
+    evl_close(&log);
+
+    // Reopen from the tail
+    TEST_CHECK(evl_open(&log, TEST_EVL_PATH, sizeof(uint32_t), TEST_EVL_CAPACITY, staging, TEST_EVL_STAGING, 100U));
+    TEST_CHECK(evl_entries(&log) == TEST_EVL_CAPACITY);
+    TEST_CHECK(test_evl_check(&log, 1U, 0U, TEST_EVL_CAPACITY, 3U));
+    evl_close(&log);
+
+    // Another geometry is refused, as a staging larger than the ring
+    TEST_CHECK(!evl_open(&log, TEST_EVL_PATH, sizeof(uint16_t), TEST_EVL_CAPACITY, staging, TEST_EVL_STAGING, 100U));
+    TEST_CHECK(!evl_open(&log, TEST_EVL_PATH, sizeof(uint32_t), 2U, staging, TEST_EVL_STAGING, 100U));
+    (void) remove(TEST_EVL_PATH);
+
+    // entry_descriptor: { from_entry 2, to_entry 0, from_column 1, to_column 0 }
+    {
+        uint8_t buffer[] = { 0x02U, AXDR_TAG_STRUCTURE, 0x04U,
+                             AXDR_TAG_UNSIGNED32, 0x00U, 0x00U, 0x00U, 0x02U,
+                             AXDR_TAG_UNSIGNED32, 0x00U, 0x00U, 0x00U, 0x00U,
+                             AXDR_TAG_UNSIGNED16, 0x00U, 0x01U,
+                             AXDR_TAG_UNSIGNED16, 0x00U, 0x00U };
+        csm_array array;
+
+        csm_array_init(&array, buffer, sizeof(buffer), sizeof(buffer), 0U);
+        TEST_CHECK(evl_entry_decode(&array, &from_entry, &to_entry, &from_column, &to_column));
+        TEST_CHECK((from_entry == 2U) && (to_entry == 0U) && (from_column == 1U) && (to_column == 0U));
+
+        // range_descriptor selector
+        buffer[0] = 0x01U;
+        csm_array_init(&array, buffer, sizeof(buffer), sizeof(buffer), 0U);
+        TEST_CHECK(!evl_entry_decode(&array, &from_entry, &to_entry, &from_column, &to_column));
+
+        // Truncated
+        buffer[0] = 0x02U;
+        csm_array_init(&array, buffer, sizeof(buffer), sizeof(buffer) - 1U, 0U);
+        TEST_CHECK(!evl_entry_decode(&array, &from_entry, &to_entry, &from_column, &to_column));
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * Unit tests of the request executor
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "executor.h"
+
+#define TEST_EX_WORKERS     4U
+#define TEST_EX_MAILBOXES   16U
+#define TEST_EX_ITEMS       256U    //!< Per mailbox, many times EX_BUDGET
+
+typedef struct
+{
+    ex_item item;
+    uint32_t mailbox;
+    uint32_t seq;
+} test_ex_item;
+
+static ex_executor executor;
+static ex_mailbox *slots[TEST_EX_MAILBOXES];
+static ex_mailbox mailboxes[TEST_EX_MAILBOXES];
+static ex_outbox outbox;
+static test_ex_item items[TEST_EX_MAILBOXES][TEST_EX_ITEMS];
+static volatile uint32_t running[TEST_EX_MAILBOXES];
+static volatile uint32_t overlaps;
+
+static void test_ex_handler(void *ctx, ex_mailbox *mailbox, ex_item *item, uint32_t worker)
+{
+    uint32_t index = mailbox->index;
+    // The first item of a run is short: it races with the end of the previous run on another worker
+    uint32_t work = ((((test_ex_item *)item)->seq % EX_BUDGET) == 0U) ? 0U : 200U;
+    (void) ctx;
+    (void) worker;
+
+    // One worker at a time per mailbox
+    if (__atomic_fetch_add(&running[index], 1U, __ATOMIC_SEQ_CST) != 0U)
+    {
+        __atomic_fetch_add(&overlaps, 1U, __ATOMIC_SEQ_CST);
+    }
+    for (volatile uint32_t spin = 0U; spin < work; spin++)
+    {
+    }
+    __atomic_fetch_sub(&running[index], 1U, __ATOMIC_SEQ_CST);
+}
+
+// The completions of a mailbox come back in submission order, even when it moves between workers
+static void test_executor_order(void)
+{
+    uint32_t next[TEST_EX_MAILBOXES];
+    uint32_t received = 0U;
+    uint32_t disorder = 0U;
+    uint32_t executed = 0U;
+
+    memset(next, 0, sizeof(next));
+    ex_outbox_init(&outbox, NULL, NULL);
+    TEST_CHECK(ex_init(&executor, TEST_EX_WORKERS, slots, TEST_EX_MAILBOXES, test_ex_handler, NULL));
+
+    for (uint32_t m = 0U; m < TEST_EX_MAILBOXES; m++)
+    {
+        TEST_CHECK(ex_mailbox_open(&executor, &mailboxes[m], &outbox, NULL));
+    }
+    // No free slot left
+    TEST_CHECK(!ex_mailbox_open(&executor, &mailboxes[0], &outbox, NULL));
+
+    for (uint32_t i = 0U; i < TEST_EX_ITEMS; i++)
+    {
+        for (uint32_t m = 0U; m < TEST_EX_MAILBOXES; m++)
+        {
+            items[m][i].mailbox = m;
+            items[m][i].seq = i;
+            ex_submit(&executor, &mailboxes[m], &items[m][i].item);
+        }
+    }
+
+    while (received < (TEST_EX_MAILBOXES * TEST_EX_ITEMS))
+    {
+        ex_item *item = ex_outbox_pop(&outbox);
+        if (item != NULL)
+        {
+            test_ex_item *done = (test_ex_item *)item;
+            disorder += (done->seq != next[done->mailbox]) ? 1U : 0U;
+            next[done->mailbox] = done->seq + 1U;
+            received++;
+        }
+    }
+    TEST_CHECK(disorder == 0U);
+    TEST_CHECK(overlaps == 0U);
+    TEST_CHECK(ex_outbox_pop(&outbox) == NULL);
+
+    for (uint32_t m = 0U; m < TEST_EX_MAILBOXES; m++)
+    {
+        ex_mailbox_close(&executor, &mailboxes[m]);
+    }
+    for (uint32_t w = 0U; w < TEST_EX_WORKERS; w++)
+    {
+        executed += executor.workers[w].executed;
+    }
+    TEST_CHECK(executed == (TEST_EX_MAILBOXES * TEST_EX_ITEMS));
+    ex_destroy(&executor);
+}
+
+void test_executor(void)
+{
+    test_executor_order();
+}
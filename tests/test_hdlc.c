@@ -0,0 +1,60 @@
+/**
+ * Unit tests of the HDLC framing
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "hdlc.h"
+
+// Encode then decode an I frame carrying size bytes of information
+static int test_hdlc_round_trip(uint16_t size)
+{
+    static uint8_t info[2048];
+    static uint8_t frame[2100];
+    hdlc_t tx;
+    hdlc_t rx;
+    int frame_size;
+    int ok;
+
+    for (uint32_t i = 0U; i < size; i++)
+    {
+        info[i] = (uint8_t)(i * 7U);
+    }
+
+    hdlc_init(&tx);
+    tx.sender = HDLC_CLIENT;
+    tx.client_addr = 0x10U;
+    tx.logical_device = 1U;
+    tx.phy_address = 0x11U;
+    frame_size = hdlc_encode_data(&tx, frame, sizeof(frame), info, size);
+
+    hdlc_init(&rx);
+    rx.sender = HDLC_CLIENT;
+    ok = (frame_size > 0) && (hdlc_decode(&rx, frame, (uint16_t)frame_size) == HDLC_OK);
+    ok = ok && (rx.frame_size == (uint16_t)frame_size);
+    ok = ok && (rx.type == HDLC_PACKET_TYPE_I) && (rx.data_size == size);
+    ok = ok && (memcmp(&frame[rx.data_index], info, size) == 0);
+    return ok;
+}
+
+static void test_hdlc_length(void)
+{
+    // The frame length is 11 bits: 3 bits in the format byte, then 8 bits
+    TEST_CHECK(test_hdlc_round_trip(100U));
+    TEST_CHECK(test_hdlc_round_trip(300U));     // 0x1xx
+    TEST_CHECK(test_hdlc_round_trip(1100U));    // 0x4xx, needs the third bit
+    TEST_CHECK(test_hdlc_round_trip(2000U));    // 0x7xx
+}
+
+void test_hdlc(void)
+{
+    test_hdlc_length();
+}
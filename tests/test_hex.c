@@ -0,0 +1,166 @@
+/**
+ * Unit tests of the hexadecimal conversions, compared with a scalar reference
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "os_util.h"
+
+#define TEST_HEX_MAX        200U    // Bytes: several AVX2 and SSSE3 blocks with every tail length
+#define TEST_HEX_GUARD      8U
+
+static uint8_t data[TEST_HEX_MAX + TEST_HEX_GUARD];
+static uint8_t decoded[TEST_HEX_MAX + TEST_HEX_GUARD];
+static char text[HEX_DUMP_SIZE(TEST_HEX_MAX) + TEST_HEX_GUARD];
+static char expected[HEX_DUMP_SIZE(TEST_HEX_MAX) + TEST_HEX_GUARD];
+
+static uint32_t test_hex_rand(void)
+{
+    static uint32_t state = 0x48455821U;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Reference dump, one byte at a time
+static size_t test_hex_reference(const uint8_t *in, size_t size, char separator, int lower, char *out)
+{
+    static const char cUpper[] = "0123456789ABCDEF";
+    static const char cLower[] = "0123456789abcdef";
+    const char *digits = lower ? cLower : cUpper;
+    size_t pos = 0U;
+
+    for (size_t i = 0U; i < size; i++)
+    {
+        if ((separator != 0) && (i > 0U))
+        {
+            out[pos++] = separator;
+        }
+        out[pos++] = digits[in[i] >> 4U];
+        out[pos++] = digits[in[i] & 0x0FU];
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+static void test_hex_encode(void)
+{
+    int valid = TRUE;
+
+    for (size_t size = 0U; size <= TEST_HEX_MAX; size++)
+    {
+        for (size_t i = 0U; i < size; i++)
+        {
+            data[i] = (uint8_t)test_hex_rand();
+        }
+        memset(text, 'x', sizeof(text));
+        (void) test_hex_reference(data, size, 0, FALSE, expected);
+
+        valid = valid && (hex_encode(data, size, text) == (2U * size));
+        valid = valid && (memcmp(text, expected, 2U * size) == 0) && (text[2U * size] == 'x');
+    }
+    TEST_CHECK(valid);
+}
+
+static void test_hex_decode(void)
+{
+    int valid = TRUE;
+
+    for (size_t size = 0U; size <= TEST_HEX_MAX; size++)
+    {
+        for (size_t i = 0U; i < size; i++)
+        {
+            data[i] = (uint8_t)test_hex_rand();
+        }
+        // Both cases of digits
+        (void) test_hex_reference(data, size, 0, (size % 3U) == 1U, text);
+        memset(decoded, 0xA5, sizeof(decoded));
+
+        valid = valid && (hex_decode(text, 2U * size, decoded) == (int)size);
+        valid = valid && (memcmp(decoded, data, size) == 0) && (decoded[size] == 0xA5U);
+    }
+    TEST_CHECK(valid);
+
+    // Odd number of digits
+    (void) test_hex_reference(data, TEST_HEX_MAX, 0, FALSE, text);
+    valid = TRUE;
+    for (size_t size = 1U; size < (2U * TEST_HEX_MAX); size += 2U)
+    {
+        valid = valid && (hex_decode(text, size, decoded) == -1);
+    }
+    TEST_CHECK(valid);
+
+    // One invalid digit at each position, in every block and tail; the characters around the digit ranges
+    static const char cInvalid[] = { '/', ':', '@', 'G', '`', 'g', ' ', 'x', (char)0x80, (char)0xC1, '\0' };
+    valid = TRUE;
+    for (size_t pos = 0U; pos < (2U * TEST_HEX_MAX); pos++)
+    {
+        char saved = text[pos];
+
+        text[pos] = cInvalid[pos % sizeof(cInvalid)];
+        valid = valid && (hex_decode(text, 2U * TEST_HEX_MAX, decoded) == -1);
+        // Still detected when the digit is in the last block or the tail
+        valid = valid && (hex_decode(&text[pos & ~(size_t)1U], (2U * TEST_HEX_MAX) - (pos & ~(size_t)1U), decoded) == -1);
+        text[pos] = saved;
+    }
+    TEST_CHECK(valid);
+    TEST_CHECK(hex_decode(text, 2U * TEST_HEX_MAX, decoded) == (int)TEST_HEX_MAX);
+}
+
+static void test_hex_dump(void)
+{
+    int valid = TRUE;
+
+    for (size_t size = 0U; size <= TEST_HEX_MAX; size++)
+    {
+        for (size_t i = 0U; i < size; i++)
+        {
+            data[i] = (uint8_t)test_hex_rand();
+        }
+        for (uint32_t k = 0U; k < 2U; k++)
+        {
+            char separator = (k == 0U) ? ':' : 0;
+            size_t len = test_hex_reference(data, size, separator, FALSE, expected);
+
+            memset(text, 'x', sizeof(text));
+            valid = valid && (hex_dump(data, size, separator, text, sizeof(text)) == len);
+            valid = valid && (memcmp(text, expected, len + 1U) == 0);
+        }
+    }
+    TEST_CHECK(valid);
+
+    // Output too small: truncated to the whole bytes that fit with the null character, nothing written after
+    valid = TRUE;
+    for (size_t out_size = 0U; out_size <= HEX_DUMP_SIZE(TEST_HEX_MAX); out_size++)
+    {
+        for (uint32_t k = 0U; k < 2U; k++)
+        {
+            char separator = (k == 0U) ? ' ' : 0;
+            size_t fit = (separator != 0) ? (out_size / 3U) : ((out_size > 0U) ? ((out_size - 1U) / 2U) : 0U);
+            size_t len = test_hex_reference(data, (fit < TEST_HEX_MAX) ? fit : TEST_HEX_MAX, separator, FALSE, expected);
+
+            memset(text, 'x', sizeof(text));
+            valid = valid && (hex_dump(data, TEST_HEX_MAX, separator, text, out_size) == len);
+            valid = valid && ((out_size == 0U) || (memcmp(text, expected, len + 1U) == 0));
+            valid = valid && (text[(out_size > 0U) ? out_size : 0U] == 'x') && (len < ((out_size > 0U) ? out_size : 1U));
+        }
+    }
+    TEST_CHECK(valid);
+}
+
+void test_hex(void)
+{
+    test_hex_encode();
+    test_hex_decode();
+    test_hex_dump();
+}
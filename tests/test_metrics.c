@@ -0,0 +1,91 @@
+/**
+ * Unit tests of the stack metrics
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <pthread.h>
+
+#include "tests.h"
+#include "csm_metrics.h"
+
+#define TEST_METRICS_THREADS    (CSM_METRICS_SHARDS + 4U)
+#define TEST_METRICS_LOOPS      100000U
+
+static uint32_t test_metrics_clock(void)
+{
+    return 0U;
+}
+
+static void *test_metrics_thread(void *arg)
+{
+    (void) arg;
+    for (uint32_t i = 0U; i < TEST_METRICS_LOOPS; i++)
+    {
+        csm_metrics_inc(CSM_METRIC_GET);
+        csm_metrics_record_latency(CSM_LATENCY_CHANNEL, 100U);
+    }
+    return NULL;
+}
+
+static void test_metrics_buckets(void)
+{
+    uint32_t histogram[CSM_METRICS_HIST_BUCKETS] = { 0U };
+
+    TEST_CHECK(csm_metrics_bucket_index(15U) == 15U);
+    TEST_CHECK(csm_metrics_bucket_index(16U) == 16U);
+    TEST_CHECK(csm_metrics_bucket_index(0xFFFFFFFFU) == (CSM_METRICS_HIST_BUCKETS - 1U));
+    TEST_CHECK(csm_metrics_bucket_value(CSM_METRICS_HIST_BUCKETS - 1U) == 0xFFFFFFFFU);
+
+    // Each value is at most the upper bound of its bucket, within 12.5%
+    for (uint32_t value = 1U; value < 1000000U; value = (value * 3U) + 1U)
+    {
+        uint32_t upper = csm_metrics_bucket_value(csm_metrics_bucket_index(value));
+        TEST_CHECK((upper >= value) && ((upper - value) <= (value / 8U)));
+    }
+
+    for (uint32_t value = 1U; value <= 100U; value++)
+    {
+        histogram[csm_metrics_bucket_index(value)]++;
+    }
+    TEST_CHECK(csm_metrics_percentile(histogram, 1000U) >= 100U);
+    TEST_CHECK(csm_metrics_percentile(histogram, 500U) >= 50U);
+    TEST_CHECK(csm_metrics_percentile(histogram, 500U) < 60U);
+}
+
+// More threads than private shards: no increment may be lost
+static void test_metrics_threads(void)
+{
+    pthread_t threads[TEST_METRICS_THREADS];
+    csm_metrics_snapshot snap;
+    uint32_t latencies = 0U;
+
+    csm_metrics_init(test_metrics_clock);
+    for (uint32_t i = 0U; i < TEST_METRICS_THREADS; i++)
+    {
+        TEST_CHECK(pthread_create(&threads[i], NULL, test_metrics_thread, NULL) == 0);
+    }
+    for (uint32_t i = 0U; i < TEST_METRICS_THREADS; i++)
+    {
+        (void) pthread_join(threads[i], NULL);
+    }
+
+    csm_metrics_get_snapshot(&snap);
+    for (uint32_t b = 0U; b < CSM_METRICS_HIST_BUCKETS; b++)
+    {
+        latencies += snap.latency[CSM_LATENCY_CHANNEL][b];
+    }
+    TEST_CHECK(snap.counters[CSM_METRIC_GET] == (TEST_METRICS_THREADS * TEST_METRICS_LOOPS));
+    TEST_CHECK(latencies == (TEST_METRICS_THREADS * TEST_METRICS_LOOPS));
+}
+
+void test_metrics(void)
+{
+    test_metrics_buckets();
+    test_metrics_threads();
+}
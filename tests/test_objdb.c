@@ -0,0 +1,322 @@
+/**
+ * Unit tests of the object database, over an image built by the objdb compiler
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_objdb.h"
+#include "csm_axdr_codec.h"
+
+// cosem_objdb tests/test_objdb_model.txt objdb.bin, little endian host
+static const uint8_t cImage[] = {
+    0x43U, 0x53U, 0x4DU, 0x44U, 0x01U, 0x00U, 0x2CU, 0x00U, 0x10U, 0x00U, 0x0CU, 0x00U, 0x04U, 0x00U, 0x00U, 0x00U,
+    0x0CU, 0x00U, 0x00U, 0x00U, 0x32U, 0x00U, 0x00U, 0x00U, 0x8DU, 0x0DU, 0xB7U, 0xF1U, 0x10U, 0x00U, 0x01U, 0x00U,
+    0x20U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0x02U,
+    0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x03U, 0x00U, 0x00U, 0x03U,
+    0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU, 0x00U, 0x00U, 0x02U, 0x00U, 0x00U, 0x00U, 0x08U, 0x00U, 0x00U, 0x03U,
+    0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x01U, 0x00U, 0x05U, 0x00U, 0x00U, 0x00U, 0x46U, 0x00U, 0x00U, 0x02U,
+    0x00U, 0x00U, 0x60U, 0x03U, 0x0AU, 0xFFU, 0x01U, 0x00U, 0x09U, 0x00U, 0x00U, 0x00U, 0x01U, 0x07U, 0x00U, 0xFFU,
+    0x1AU, 0x00U, 0x00U, 0x00U, 0x08U, 0x00U, 0x00U, 0x00U, 0x02U, 0x02U, 0x00U, 0xFFU, 0x03U, 0x00U, 0x00U, 0x00U,
+    0x09U, 0x00U, 0x00U, 0x00U, 0x01U, 0x07U, 0x00U, 0xFFU, 0x22U, 0x00U, 0x00U, 0x00U, 0x08U, 0x00U, 0x00U, 0x00U,
+    0x02U, 0x03U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x03U, 0x07U, 0x00U, 0xFFU,
+    0x0CU, 0x00U, 0x00U, 0x00U, 0x06U, 0x00U, 0x00U, 0x00U, 0x01U, 0x07U, 0x00U, 0xFFU, 0x12U, 0x00U, 0x00U, 0x00U,
+    0x08U, 0x00U, 0x00U, 0x00U, 0x02U, 0x07U, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+    0x03U, 0x07U, 0x00U, 0xFFU, 0x00U, 0x00U, 0x00U, 0x00U, 0x03U, 0x00U, 0x00U, 0x00U, 0x01U, 0x02U, 0x00U, 0x01U,
+    0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U, 0x07U, 0x00U, 0xFFU, 0x2AU, 0x00U, 0x00U, 0x00U,
+    0x08U, 0x00U, 0x00U, 0x00U, 0x02U, 0x07U, 0x00U, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+    0x01U, 0x02U, 0x00U, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x10U, 0x00U, 0x3CU, 0x0AU,
+    0x07U, 0x53U, 0x49U, 0x4DU, 0x30U, 0x30U, 0x30U, 0x31U, 0x02U, 0x02U, 0x0FU, 0x00U, 0x16U, 0x1EU, 0x09U, 0x06U,
+    0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x09U, 0x06U, 0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x09U, 0x06U,
+    0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU, 0x09U, 0x06U, 0x00U, 0x00U, 0x60U, 0x03U, 0x0AU, 0xFFU
+};
+
+static const csm_obis_code cSerial = { 0U, 0U, 96U, 1U, 0U, 255U };
+static const csm_obis_code cEnergy = { 1U, 0U, 1U, 8U, 0U, 255U };
+static const csm_obis_code cClock = { 0U, 0U, 1U, 0U, 0U, 255U };
+static const csm_obis_code cDisconnect = { 0U, 0U, 96U, 3U, 10U, 255U };
+
+// The image is used in place: aligned copy, corrupted by the tests
+static uint32_t image_words[(sizeof(cImage) / 4U) + 2U];
+static uint8_t *image = (uint8_t *)image_words;
+static uint8_t reply[32];
+static uint32_t handler_calls[2];
+
+static csm_db_code test_objdb_register(csm_array *in, csm_array *out, csm_request *request)
+{
+    (void) in;
+    (void) request;
+    handler_calls[0]++;
+    return csm_axdr_wr_u32(out, 1234U) ? CSM_OK : CSM_ERR_OBJECT_ERROR;
+}
+
+static csm_db_code test_objdb_clock(csm_array *in, csm_array *out, csm_request *request)
+{
+    (void) in;
+    (void) out;
+    (void) request;
+    handler_calls[1]++;
+    return CSM_OK;
+}
+
+static const csm_db_access_handler cHandlers[] = { test_objdb_register, test_objdb_clock };
+
+static const csm_db_access_handler cNoClock[] = { test_objdb_register, NULL };
+
+static int test_objdb_load(void)
+{
+    memcpy(image, cImage, sizeof(cImage));
+    return csm_objdb_load(image, sizeof(cImage), cHandlers, 2U);
+}
+
+static csm_objdb_member *test_objdb_member(const csm_objdb_object *object, uint32_t index)
+{
+    const csm_objdb_header *header = (const csm_objdb_header *)image;
+    csm_objdb_member *members = (csm_objdb_member *)&image[sizeof(csm_objdb_header) + (header->nb_objects * sizeof(csm_objdb_object))];
+
+    return &members[object->first_member + index];
+}
+
+static csm_db_code test_objdb_access(enum csm_service service, uint16_t class_id, const csm_obis_code *obis, int8_t id, uint16_t ssap, uint32_t out_size)
+{
+    csm_request request;
+    csm_array in;
+    csm_array out;
+
+    memset(&request, 0, sizeof(request));
+    request.db_request.service = service;
+    request.db_request.logical_name.class_id = class_id;
+    request.db_request.logical_name.obis = *obis;
+    request.db_request.logical_name.id = id;
+    request.llc.ssap = ssap;
+    csm_array_init(&in, reply, 0U, 0U, 0U);
+    csm_array_init(&out, reply, out_size, 0U, 0U);
+    memset(reply, 0, sizeof(reply));
+    return csm_objdb_access(&in, &out, &request);
+}
+
+static void test_objdb_load_image(void)
+{
+    csm_objdb_header *header = (csm_objdb_header *)image;
+
+    TEST_CHECK(test_objdb_load() && csm_objdb_verify());
+    TEST_CHECK(!csm_objdb_load(NULL, sizeof(cImage), cHandlers, 2U) && !csm_objdb_verify());
+
+    // Truncated, nothing is left loaded
+    int valid = TRUE;
+    for (uint32_t size = 0U; size < sizeof(cImage); size++)
+    {
+        valid = valid && !csm_objdb_load(image, size, cHandlers, 2U) && (csm_objdb_find(8U, &cClock) == NULL);
+    }
+    TEST_CHECK(valid);
+
+    // Misaligned
+    valid = TRUE;
+    for (uint32_t shift = 1U; shift < 4U; shift++)
+    {
+        memcpy(&image[shift], cImage, sizeof(cImage));
+        valid = valid && !csm_objdb_load(&image[shift], sizeof(cImage), cHandlers, 2U);
+    }
+    TEST_CHECK(valid);
+
+    // Counts larger than the image, also when their size overflows 32 bits
+    TEST_CHECK(test_objdb_load());
+    header->nb_objects++;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    header->nb_objects = 0x10000000U;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    TEST_CHECK(test_objdb_load());
+    header->nb_members = 0x15555556U;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    TEST_CHECK(test_objdb_load());
+    header->values_size = 0xFFFFFFFFU;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    header->values_size = ((const csm_objdb_header *)cImage)->values_size + 1U;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    header->values_size -= 2U;
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+
+    // Header of another format
+    TEST_CHECK(test_objdb_load());
+    header->magic ^= 1U;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    TEST_CHECK(test_objdb_load());
+    header->version++;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+    TEST_CHECK(test_objdb_load());
+    header->member_size++;
+    TEST_CHECK(!csm_objdb_load(image, sizeof(cImage), cHandlers, 2U));
+
+    // The content is only checked by the checksum
+    TEST_CHECK(test_objdb_load());
+    image[sizeof(cImage) - 1U] ^= 0x01U;
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), cHandlers, 2U) && !csm_objdb_verify());
+}
+
+static void test_objdb_find(void)
+{
+    TEST_CHECK(test_objdb_load());
+
+    // Declared out of order, sorted by class then logical name
+    const csm_objdb_object *serial = csm_objdb_find(1U, &cSerial);
+    const csm_objdb_object *energy = csm_objdb_find(3U, &cEnergy);
+    const csm_objdb_object *clock = csm_objdb_find(8U, &cClock);
+    const csm_objdb_object *disconnect = csm_objdb_find(70U, &cDisconnect);
+
+    TEST_CHECK((serial != NULL) && (energy == (serial + 1)) && (clock == (serial + 2)) && (disconnect == (serial + 3)));
+    TEST_CHECK((clock != NULL) && (clock->class_id == 8U) && (memcmp(clock->obis, &cClock, sizeof(clock->obis)) == 0));
+    TEST_CHECK((clock != NULL) && (clock->nb_attributes == 3U) && (clock->nb_methods == 1U));
+
+    // Another class, another logical name, before the first and after the last object
+    const csm_obis_code other = { 0U, 0U, 1U, 0U, 0U, 0U };
+    TEST_CHECK(csm_objdb_find(1U, &cClock) == NULL);
+    TEST_CHECK(csm_objdb_find(8U, &other) == NULL);
+    TEST_CHECK((csm_objdb_find(0U, &cSerial) == NULL) && (csm_objdb_find(0xFFFFU, &cDisconnect) == NULL));
+
+    // Empty image
+    csm_objdb_header *header = (csm_objdb_header *)image;
+    header->nb_objects = 0U;
+    header->nb_members = 0U;
+    header->values_size = 0U;
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), cHandlers, 2U) && (csm_objdb_find(1U, &cSerial) == NULL));
+}
+
+static void test_objdb_rights(void)
+{
+    static const uint8_t cSerialValue[] = { 0x0AU, 0x07U, 'S', 'I', 'M', '0', '0', '0', '1' };
+    static const uint8_t cEnergyName[] = { 0x09U, 0x06U, 0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU };
+
+    TEST_CHECK(test_objdb_load());
+    memset(handler_calls, 0, sizeof(handler_calls));
+
+    // Read mask: the management client only, the unknown clients have no right
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_OK);
+    TEST_CHECK(memcmp(reply, cSerialValue, sizeof(cSerialValue)) == 0);
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x10U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x20U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x30U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x00U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+
+    // Generated logical name, readable by all
+    TEST_CHECK(test_objdb_access(SVC_GET, 3U, &cEnergy, 1, 0x20U, sizeof(reply)) == CSM_OK);
+    TEST_CHECK(memcmp(reply, cEnergyName, sizeof(cEnergyName)) == 0);
+
+    // Refused before the handler
+    TEST_CHECK(test_objdb_access(SVC_GET, 3U, &cEnergy, 2, 0x20U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(handler_calls[0] == 0U);
+    TEST_CHECK(test_objdb_access(SVC_GET, 3U, &cEnergy, 2, 0x10U, sizeof(reply)) == CSM_OK);
+    TEST_CHECK((handler_calls[0] == 1U) && (reply[0] == AXDR_TAG_UNSIGNED32));
+
+    // Write mask for SET, execute mask for ACTION
+    TEST_CHECK(test_objdb_access(SVC_SET, 8U, &cClock, 2, 0x10U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_SET, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_OK);
+    TEST_CHECK(test_objdb_access(SVC_SET, 8U, &cClock, 3, 0x01U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 1, 0x10U, sizeof(reply)) == CSM_ERR_UNAUTHORIZED_ACCESS);
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 1, 0x01U, sizeof(reply)) == CSM_OK);
+    TEST_CHECK((handler_calls[0] == 2U) && (handler_calls[1] == 1U));
+
+    // Attributes and methods are looked up separately
+    TEST_CHECK(test_objdb_access(SVC_GET, 3U, &cEnergy, 4, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 3U, &cEnergy, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cEnergy, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+}
+
+static void test_objdb_bounds(void)
+{
+    TEST_CHECK(test_objdb_load());
+
+    const csm_objdb_header *header = (const csm_objdb_header *)image;
+    const csm_objdb_object *serial = csm_objdb_find(1U, &cSerial);
+    const csm_objdb_object *clock = csm_objdb_find(8U, &cClock);
+    TEST_CHECK((serial != NULL) && (clock != NULL));
+    if ((serial == NULL) || (clock == NULL))
+    {
+        return;
+    }
+    // Attribute 1 generated, then attribute 2
+    csm_objdb_member *member = test_objdb_member(serial, 1U);
+    uint32_t offset = member->value_offset;
+    uint32_t size = member->value_size;
+    TEST_CHECK((member->id == 2) && (member->handler == CSM_OBJDB_STATIC) && ((offset + size) <= header->values_size));
+
+    // Static member: the whole value in the values area and in the reply
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, size) == CSM_OK);
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, size - 1U) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 3, 0x01U, 2U) == CSM_ERR_OBJECT_ERROR);
+    member->value_offset = header->values_size - size + 1U;
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    member->value_offset = 0xFFFFFFFFU;
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    member->value_offset = offset;
+    member->value_size = 0xFFFFFFFFU;
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    member->value_size = size;
+    TEST_CHECK(test_objdb_access(SVC_GET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_OK);
+
+    // Write rights on a static member are not honored
+    member->write_mask = 0xFFU;
+    TEST_CHECK(test_objdb_access(SVC_SET, 1U, &cSerial, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+
+    // Members out of the members area
+    csm_objdb_object *object = (csm_objdb_object *)clock;
+    uint32_t first = object->first_member;
+    object->first_member = header->nb_members - 1U;
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 2, 0x10U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+    object->first_member = 0xFFFFFFFFU;
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 1, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+    object->first_member = first;
+}
+
+static void test_objdb_handlers(void)
+{
+    TEST_CHECK(test_objdb_load());
+    memset(handler_calls, 0, sizeof(handler_calls));
+
+    // Handler index beyond the table given at load
+    TEST_CHECK(test_objdb_access(SVC_GET, 70U, &cDisconnect, 2, 0x10U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 70U, &cDisconnect, 1, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), cHandlers, 1U));
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 1, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_OK);
+
+    // Empty entry
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), cNoClock, 2U));
+    TEST_CHECK(test_objdb_access(SVC_ACTION, 8U, &cClock, 1, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(csm_objdb_load(image, sizeof(cImage), NULL, 0U));
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 3, 0x01U, sizeof(reply)) == CSM_OK);
+
+    // An index corrupted in the image
+    TEST_CHECK(test_objdb_load());
+    const csm_objdb_object *clock = csm_objdb_find(8U, &cClock);
+    TEST_CHECK(clock != NULL);
+    if (clock != NULL)
+    {
+        test_objdb_member(clock, 1U)->handler = 2U;
+        TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_ERROR);
+        test_objdb_member(clock, 1U)->handler = 1U;
+        TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 2, 0x01U, sizeof(reply)) == CSM_OK);
+    }
+    TEST_CHECK((handler_calls[0] == 1U) && (handler_calls[1] == 1U));
+
+    // Nothing loaded
+    TEST_CHECK(!csm_objdb_load(NULL, 0U, NULL, 0U));
+    TEST_CHECK(test_objdb_access(SVC_GET, 8U, &cClock, 3, 0x01U, sizeof(reply)) == CSM_ERR_OBJECT_NOT_FOUND);
+}
+
+void test_objdb(void)
+{
+    test_objdb_load_image();
+    test_objdb_find();
+    test_objdb_rights();
+    test_objdb_bounds();
+    test_objdb_handlers();
+}
@@ -0,0 +1,147 @@
+/**
+ * Unit tests of the Push Setup engine
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_push.h"
+#include "csm_axdr_codec.h"
+#include "host_hal.h"
+#include "os_util.h"
+
+#define TEST_PUSH_SENT      8U
+
+typedef struct
+{
+    uint8_t apdu[128];
+    uint32_t size;
+} test_push_apdu;
+
+static test_push_apdu sent[TEST_PUSH_SENT];
+static uint32_t nb_sent;
+static int link_up;
+
+// Every object is a unsigned16 with its class id
+static csm_db_code test_push_db(csm_array *in, csm_array *out, csm_request *request)
+{
+    (void) in;
+    return csm_axdr_wr_u16(out, request->db_request.logical_name.class_id) ? CSM_OK : CSM_ERR_OBJECT_ERROR;
+}
+
+static int test_push_send(const csm_push_setup *setup, const uint8_t *apdu, uint32_t size)
+{
+    (void) setup;
+    if (link_up && (nb_sent < TEST_PUSH_SENT) && (size <= sizeof(sent[0].apdu)))
+    {
+        memcpy(sent[nb_sent].apdu, apdu, size);
+        sent[nb_sent].size = size;
+        nb_sent++;
+    }
+    return link_up;
+}
+
+static void test_push_setup(csm_push_setup *setup, uint16_t class_id, uint8_t sc, uint8_t gcm_channel)
+{
+    static const char cDestination[] = "127.0.0.1:4059";
+
+    memset(setup, 0, sizeof(*setup));
+    setup->objects[0].class_id = class_id;
+    setup->objects[0].id = 2;
+    setup->nb_objects = 1U;
+    setup->destination.transport = CSM_PUSH_TCP;
+    setup->destination.size = sizeof(cDestination) - 1U;
+    memcpy(setup->destination.address, cDestination, setup->destination.size);
+    setup->nb_retries = 1U;
+    setup->repetition_delay = 10U;
+    setup->llc.ssap = TEST_CLIENT_SAP;
+    setup->llc.dsap = TEST_SERVER_SAP;
+    setup->sc.sh_byte = sc;
+    setup->gcm_channel = gcm_channel;
+}
+
+// Plain pushes to the same destination: one notification, body is a structure of the bodies
+static void test_push_coalesce(void)
+{
+    static csm_push_setup setups[2];
+    static uint8_t buffer[256];
+    static const uint8_t cBody[] = { AXDR_TAG_STRUCTURE, 2U, AXDR_TAG_STRUCTURE, 1U, AXDR_TAG_UNSIGNED16, 0x00U, 0x03U,
+                                     AXDR_TAG_STRUCTURE, 1U, AXDR_TAG_UNSIGNED16, 0x00U, 0x07U };
+
+    test_push_setup(&setups[0], 3U, 0U, 0U);
+    test_push_setup(&setups[1], 7U, 0U, 0U);
+    csm_push_init(setups, 2U, test_push_db, test_push_send);
+    nb_sent = 0U;
+    link_up = TRUE;
+
+    TEST_CHECK(csm_push_trigger(0U, 100U));
+    TEST_CHECK(csm_push_trigger(1U, 100U));
+    TEST_CHECK(csm_push_trigger(1U, 100U));
+    TEST_CHECK(csm_push_pending() == 2U);
+    TEST_CHECK(csm_push_process(100U, buffer, sizeof(buffer)) == 1U);
+    TEST_CHECK(nb_sent == 1U);
+    // Data-Notification, long-invoke-id, no date-time, then the body
+    TEST_CHECK(sent[0].apdu[0] == AXDR_DATA_NOTIFICATION);
+    TEST_CHECK(sent[0].size == (6U + sizeof(cBody)));
+    TEST_CHECK(memcmp(&sent[0].apdu[6], cBody, sizeof(cBody)) == 0);
+    TEST_CHECK(csm_push_pending() == 0U);
+
+    // Link down: retried once, repetition_delay later, then dropped
+    link_up = FALSE;
+    TEST_CHECK(csm_push_trigger(0U, 200U));
+    TEST_CHECK(csm_push_process(200U, buffer, sizeof(buffer)) == 0U);
+    TEST_CHECK(csm_push_pending() == 1U);
+    TEST_CHECK(csm_push_process(205U, buffer, sizeof(buffer)) == 0U);
+    TEST_CHECK(csm_push_pending() == 1U);
+    TEST_CHECK(csm_push_process(210U, buffer, sizeof(buffer)) == 0U);
+    TEST_CHECK(csm_push_pending() == 0U);
+}
+
+// Ciphered pushes are coalesced only within the same security context, the key counter is shared
+static void test_push_security(void)
+{
+    static csm_push_setup setups[4];
+    static uint8_t buffer[256];
+    uint32_t ic[TEST_PUSH_SENT];
+
+    host_hal_init();
+    test_push_setup(&setups[0], 3U, 0x30U, 1U);
+    test_push_setup(&setups[1], 4U, 0x30U, 1U);
+    test_push_setup(&setups[2], 5U, 0x30U, 2U);   // Other GCM context
+    test_push_setup(&setups[3], 6U, 0x10U, 1U);   // Authentication only
+    csm_push_init(setups, 4U, test_push_db, test_push_send);
+    csm_push_set_invocation_counter(2U, 1000U);
+    nb_sent = 0U;
+    link_up = TRUE;
+
+    for (uint8_t i = 0U; i < 4U; i++)
+    {
+        TEST_CHECK(csm_push_trigger(i, 0U));
+    }
+    TEST_CHECK(csm_push_process(0U, buffer, sizeof(buffer)) == 3U);
+    TEST_CHECK(nb_sent == 3U);
+
+    for (uint32_t i = 0U; i < nb_sent; i++)
+    {
+        // general-glo-ciphering: tag, system title, length, SC, IC
+        TEST_CHECK(sent[i].apdu[0] == AXDR_GENERAL_GLO_CIPHERING);
+        ic[i] = GET_BE32(&sent[i].apdu[2U + CSM_DEF_APP_TITLE_SIZE + 2U]);
+    }
+    // One counter for the server SAP, set through any of its setups
+    TEST_CHECK((ic[0] == 1000U) && (ic[1] == 1001U) && (ic[2] == 1002U));
+    TEST_CHECK(sent[0].apdu[2U + CSM_DEF_APP_TITLE_SIZE + 1U] == 0x30U);
+    TEST_CHECK(sent[2].apdu[2U + CSM_DEF_APP_TITLE_SIZE + 1U] == 0x10U);
+}
+
+void test_push(void)
+{
+    test_push_coalesce();
+    test_push_security();
+}
@@ -0,0 +1,289 @@
+/**
+ * Unit tests of the xDLMS services (GET, SET, ACTION)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_axdr_codec.h"
+#include "csm_security.h"
+#include "host_hal.h"
+#include "os_util.h"
+
+#define TEST_CLIENT_GCM     (HOST_HAL_MAX_CHANNELS - 1U)
+
+static const uint8_t cDateTime[12] = { 0x07U, 0xE0U, 0x0BU, 0x03U, 0x04U, 0x0CU, 0x1EU, 0x00U, 0xFFU, 0xFFU, 0xC4U, 0x00U };
+
+static const uint8_t cClientTitle[CSM_DEF_APP_TITLE_SIZE] = { 'T', 'E', 'S', 'T', 0x00U, 0x00U, 0x00U, 0x01U };
+static const uint8_t cSetOk[] = { 0xC5U, 0x01U, 0xC1U, 0x00U };
+
+static uint8_t clock_time[12];
+static csm_sec_context security[TEST_NB_ASSOS];
+static uint32_t pending_tokens[CSM_DEF_MAX_REQUESTS + 1U];
+static uint32_t pending_token;
+static uint32_t pending_calls;
+
+// Clock::time only
+static csm_db_code test_svc_db(csm_array *in, csm_array *out, csm_request *request)
+{
+    csm_db_code code = CSM_ERR_OBJECT_NOT_FOUND;
+    const csm_object_t *obj = &request->db_request.logical_name;
+
+    if (obj->class_id == 1U)
+    {
+        // Data objects are read later, see test_svc_get_deferred()
+        pending_token = request->token;
+        pending_tokens[pending_calls % (CSM_DEF_MAX_REQUESTS + 1U)] = request->token;
+        pending_calls++;
+        code = CSM_PENDING;
+    }
+    else if ((obj->class_id == 8U) && (obj->id == 2))
+    {
+        if (request->db_request.service == SVC_GET)
+        {
+            code = csm_axdr_wr_octetstring(out, clock_time, sizeof(clock_time)) ? CSM_OK : CSM_ERR_OBJECT_ERROR;
+        }
+        else if (request->db_request.service == SVC_SET)
+        {
+            uint32_t size;
+            code = CSM_ERR_DATA_CONTENT_NOT_OK;
+            if (request->db_request.additional_data.enable && csm_axdr_rd_octetstring(in, &size) && (size == sizeof(clock_time)))
+            {
+                memcpy(clock_time, csm_array_rd_data(in), sizeof(clock_time));
+                code = CSM_OK;
+            }
+        }
+    }
+    return code;
+}
+
+// SET.request normal: the value follows the access selection, without presence flag
+static void test_svc_set_normal(void)
+{
+    static uint8_t cSet[15U + 12U] = { 0xC1U, 0x01U, 0xC1U, 0x00U, 0x08U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x02U, 0x00U, 0x09U, 0x0CU };
+    csm_array reply;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    memcpy(&cSet[15], cDateTime, sizeof(cDateTime));
+    memset(clock_time, 0, sizeof(clock_time));
+
+    TEST_CHECK(test_stack_associate(channel));
+    TEST_CHECK(test_stack_exchange(channel, cSet, sizeof(cSet), &reply) == (int)sizeof(cSetOk));
+    TEST_CHECK(memcmp(reply.buff, cSetOk, sizeof(cSetOk)) == 0);
+    TEST_CHECK(memcmp(clock_time, cDateTime, sizeof(cDateTime)) == 0);
+    csm_channel_disconnect(channel);
+}
+
+// Client side of a glo-ciphered APDU: tag || length || SC || IC || information || T, return its size
+static uint32_t test_svc_cipher(uint8_t tag, uint32_t ic, const uint8_t *title, const uint8_t *plain, uint32_t size, uint8_t *apdu)
+{
+    uint8_t iv[12];
+    uint8_t aad[17];
+    uint8_t mac[16];
+
+    memcpy(iv, title, CSM_DEF_APP_TITLE_SIZE);
+    PUT_BE32(&iv[CSM_DEF_APP_TITLE_SIZE], ic);
+    aad[0] = 0x30U; // Authenticated and encrypted
+    memcpy(&aad[1], csm_sys_get_key(TEST_SERVER_SAP, CSM_SEC_GAK), 16U);
+
+    apdu[0] = tag;
+    apdu[1] = (uint8_t)(CSM_DEF_SEC_HDR_SIZE + size + 12U);
+    apdu[2] = aad[0];
+    PUT_BE32(&apdu[3], ic);
+
+    int valid = csm_sys_gcm_init(TEST_CLIENT_GCM, TEST_SERVER_SAP, CSM_SEC_GUEK, CSM_SEC_ENCRYPT, iv, aad, sizeof(aad));
+    valid = valid && csm_sys_gcm_update(TEST_CLIENT_GCM, plain, size, &apdu[7]);
+    valid = valid && csm_sys_gcm_finish(TEST_CLIENT_GCM, mac);
+    memcpy(&apdu[7U + size], mac, 12U);
+    return valid ? (7U + size + 12U) : 0U;
+}
+
+// AARQ of the test stack with a calling-AP-title, needed to decipher the requests of the client
+static int test_svc_associate_titled(uint8_t channel)
+{
+    uint8_t aarq[128];
+    csm_array reply;
+
+    memcpy(aarq, cTestAarq, 13U);
+    aarq[1] += 12U;
+    aarq[13] = CSM_ASSO_CALLING_AP_TITLE;
+    aarq[14] = CSM_DEF_APP_TITLE_SIZE + 2U;
+    aarq[15] = CSM_BER_TYPE_OCTET_STRING;
+    aarq[16] = CSM_DEF_APP_TITLE_SIZE;
+    memcpy(&aarq[17], cClientTitle, CSM_DEF_APP_TITLE_SIZE);
+    memcpy(&aarq[25], &cTestAarq[13], cTestAarqSize - 13U);
+
+    int ret = test_stack_exchange(channel, aarq, cTestAarqSize + 12U, &reply);
+    return (ret > 0) && (reply.buff[0] == CSM_ASSO_AARE);
+}
+
+// glo-set-request deciphered by the stack, glo-set-response ciphered with the server counter
+static void test_svc_set_ciphered(void)
+{
+    static uint8_t cSet[15U + 12U] = { 0xC1U, 0x01U, 0xC1U, 0x00U, 0x08U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x02U, 0x00U, 0x09U, 0x0CU };
+    uint8_t apdu[128];
+    uint8_t plain[32];
+    uint8_t mac[16];
+    uint8_t iv[12];
+    uint8_t aad[17];
+    csm_array reply;
+    uint32_t size;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    memcpy(&cSet[15], cDateTime, sizeof(cDateTime));
+    memset(clock_time, 0, sizeof(clock_time));
+    memset(security, 0, sizeof(security));
+    security[0].client_ic = 10U;
+    security[0].server_ic = 100U;
+
+    // No calling-AP-title: the APDU cannot be deciphered
+    TEST_CHECK(test_stack_associate(channel));
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 10U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 0);
+    csm_channel_disconnect(channel);
+
+    channel = test_stack_open(TEST_CLIENT_SAP);
+    TEST_CHECK(test_svc_associate_titled(channel));
+
+    // Counter below the last one accepted
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 9U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 0);
+
+    // Bad authentication tag: dropped, the counter does not move
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 12U, cClientTitle, cSet, sizeof(cSet), apdu);
+    apdu[size - 1U] ^= 0x01U;
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 0);
+    TEST_CHECK(security[0].client_ic == 10U);
+    TEST_CHECK(clock_time[0] == 0U);
+
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 12U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == (int)(2U + CSM_DEF_SEC_HDR_SIZE + sizeof(cSetOk) + 12U));
+    TEST_CHECK(memcmp(clock_time, cDateTime, sizeof(cDateTime)) == 0);
+    TEST_CHECK(security[0].client_ic == 13U);
+    TEST_CHECK(security[0].server_ic == 101U);
+    TEST_CHECK((reply.buff[0] == AXDR_GLO_SET_RESPONSE) && (reply.buff[1] == (reply.wr_index - 2U)) && (reply.buff[2] == 0x30U));
+    TEST_CHECK(GET_BE32(&reply.buff[3]) == 100U);
+
+    memcpy(iv, csm_sys_get_system_title(), CSM_DEF_APP_TITLE_SIZE);
+    memcpy(&iv[CSM_DEF_APP_TITLE_SIZE], &reply.buff[3], 4U);
+    aad[0] = 0x30U;
+    memcpy(&aad[1], csm_sys_get_key(TEST_SERVER_SAP, CSM_SEC_GAK), 16U);
+    TEST_CHECK(csm_sys_gcm_init(TEST_CLIENT_GCM, TEST_SERVER_SAP, CSM_SEC_GUEK, CSM_SEC_DECRYPT, iv, aad, sizeof(aad)));
+    TEST_CHECK(csm_sys_gcm_update(TEST_CLIENT_GCM, &reply.buff[7], sizeof(cSetOk), plain));
+    TEST_CHECK(csm_sys_gcm_finish(TEST_CLIENT_GCM, mac));
+    TEST_CHECK(memcmp(mac, &reply.buff[7U + sizeof(cSetOk)], 12U) == 0);
+    TEST_CHECK(memcmp(plain, cSetOk, sizeof(cSetOk)) == 0);
+
+    // Same APDU again: replayed
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 0);
+
+    // A ciphered APDU carries the service of its own kind
+    size = test_svc_cipher(AXDR_GLO_GET_REQUEST, 13U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 0);
+
+    // Server counter out of the window reserved by the snapshot: refused in clear, not executed
+    security[0].server_ic_limit = 101U;
+    memset(clock_time, 0, sizeof(clock_time));
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 13U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) == 3);
+    TEST_CHECK((reply.buff[0] == AXDR_EXCEPTION_RESPONSE) && (reply.buff[1] == 1U) && (reply.buff[2] == 1U));
+    TEST_CHECK(clock_time[0] == 0U);
+    TEST_CHECK((security[0].server_ic == 101U) && (security[0].client_ic == 14U));
+    security[0].server_ic_limit = 102U;
+    size = test_svc_cipher(AXDR_GLO_SET_REQUEST, 14U, cClientTitle, cSet, sizeof(cSet), apdu);
+    TEST_CHECK(test_stack_exchange(channel, apdu, size, &reply) > 0);
+    TEST_CHECK(memcmp(clock_time, cDateTime, sizeof(cDateTime)) == 0);
+    TEST_CHECK(security[0].server_ic == 102U);
+    security[0].server_ic_limit = 0U;
+    csm_channel_disconnect(channel);
+}
+
+// GET left pending by the database, completed with csm_channel_complete()
+static void test_svc_get_deferred(void)
+{
+    static const uint8_t cGet[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x01U, 0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x00U };
+    static const uint8_t cValue[] = { 0x12U, 0x00U, 0x2AU };
+    static const uint8_t cGetOk[] = { 0xC4U, 0x01U, 0xC1U, 0x00U, 0x12U, 0x00U, 0x2AU };
+    static const uint8_t cGetUndefined[] = { 0xC4U, 0x01U, 0xC1U, 0x01U, 0x04U };
+    csm_array reply;
+    uint32_t token;
+    uint8_t channel = test_stack_open(TEST_CLIENT_SAP);
+
+    pending_calls = 0U;
+    TEST_CHECK(test_stack_associate(channel));
+    TEST_CHECK(test_stack_exchange(channel, cGet, sizeof(cGet), &reply) == 0);
+    TEST_CHECK(pending_calls == 1U);
+    token = pending_token;
+
+    // A request received meanwhile is not executed and does not replace the pending one
+    TEST_CHECK(test_stack_exchange(channel, cGet, sizeof(cGet), &reply) == 0);
+    TEST_CHECK(pending_calls == 1U);
+    test_stack_packet(&reply, cGet, 0U);
+    TEST_CHECK(csm_channel_complete(token + 0x100U, CSM_OK, cValue, sizeof(cValue), &reply) == 0);
+    TEST_CHECK(csm_channel_complete(token, CSM_OK, cValue, sizeof(cValue), &reply) == (int)sizeof(cGetOk));
+    TEST_CHECK(memcmp(&reply.buff[reply.offset], cGetOk, sizeof(cGetOk)) == 0);
+
+    // A failed access is a data-access-result, not an exception
+    TEST_CHECK(test_stack_exchange(channel, cGet, sizeof(cGet), &reply) == 0);
+    TEST_CHECK(pending_token != token);
+    test_stack_packet(&reply, cGet, 0U);
+    TEST_CHECK(csm_channel_complete(pending_token, CSM_ERR_OBJECT_NOT_FOUND, NULL, 0U, &reply) == (int)sizeof(cGetUndefined));
+    TEST_CHECK(memcmp(&reply.buff[reply.offset], cGetUndefined, sizeof(cGetUndefined)) == 0);
+    csm_channel_disconnect(channel);
+}
+
+// More pending requests than CSM_DEF_MAX_REQUESTS: answered at once with a temporary failure
+static void test_svc_get_exhausted(void)
+{
+    static const uint8_t cGet[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x01U, 0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x00U };
+    static const uint8_t cGetBusy[] = { 0xC4U, 0x01U, 0xC1U, 0x01U, 0x02U };
+    static const uint8_t cValue[] = { 0x12U, 0x00U, 0x2AU };
+    uint8_t channels[CSM_DEF_MAX_REQUESTS + 1U];
+    csm_array reply;
+
+    pending_calls = 0U;
+    for (uint32_t i = 0U; i <= CSM_DEF_MAX_REQUESTS; i++)
+    {
+        // The channels of the same client share the association
+        channels[i] = test_stack_open(TEST_CLIENT_SAP);
+    }
+    TEST_CHECK(test_stack_associate(channels[0]));
+
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_REQUESTS; i++)
+    {
+        TEST_CHECK(test_stack_exchange(channels[i], cGet, sizeof(cGet), &reply) == 0);
+    }
+    TEST_CHECK(test_stack_exchange(channels[CSM_DEF_MAX_REQUESTS], cGet, sizeof(cGet), &reply) == (int)sizeof(cGetBusy));
+    TEST_CHECK(memcmp(reply.buff, cGetBusy, sizeof(cGetBusy)) == 0);
+    TEST_CHECK(pending_calls == (CSM_DEF_MAX_REQUESTS + 1U));
+
+    // The lost access cannot be completed, the other ones can
+    test_stack_packet(&reply, cGet, 0U);
+    TEST_CHECK(csm_channel_complete(pending_tokens[CSM_DEF_MAX_REQUESTS], CSM_OK, cValue, sizeof(cValue), &reply) == 0);
+    for (uint32_t i = 0U; i < CSM_DEF_MAX_REQUESTS; i++)
+    {
+        test_stack_packet(&reply, cGet, 0U);
+        TEST_CHECK(csm_channel_complete(pending_tokens[i], CSM_OK, cValue, sizeof(cValue), &reply) > 0);
+    }
+    for (uint32_t i = 0U; i <= CSM_DEF_MAX_REQUESTS; i++)
+    {
+        csm_channel_disconnect(channels[i]);
+    }
+}
+
+void test_services(void)
+{
+    test_stack_init(test_svc_db);
+    csm_channel_set_security(security);
+    test_svc_set_normal();
+    test_svc_set_ciphered();
+    test_svc_get_deferred();
+    test_svc_get_exhausted();
+}
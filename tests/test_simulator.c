@@ -0,0 +1,180 @@
+/**
+ * Unit tests of the meter model of the simulator, executed through the stack
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "tests.h"
+#include "../simulator/simulator.h"
+#include "clock.h"
+#include "csm_axdr_codec.h"
+#include "csm_snapshot.h"
+
+#define TEST_SIM_METERS     2U
+#define TEST_SIM_ENTRIES    96U
+#define TEST_SIM_TIME       1700002800U     // 2023-11-14 23:00:00 UTC, aligned on the profile period
+#define TEST_SIM_ROW_SIZE   21U             // structure { date-time, double-long-unsigned }
+
+// AARQ, LN referencing, no security, GET with selective access and block transfer
+static const uint8_t cAarq[] = { 0x60U, 0x1DU, 0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U,
+    0xBEU, 0x10U, 0x04U, 0x0EU, 0x01U, 0x00U, 0x00U, 0x00U, 0x06U, 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x7EU, 0x1FU, 0x04U, 0xB0U };
+static const uint8_t cAccepted[] = { 0xA2U, 0x03U, 0x02U, 0x01U, 0x00U };
+static const uint8_t cRlrq[] = { 0x62U, 0x03U, 0x80U, 0x01U, 0x00U };
+
+// Load profile buffer, access selector 1: range_descriptor restricted by the clock or by the energy register
+static const uint8_t cGetProfile[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x07U, 0x01U, 0x00U, 0x63U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x01U,
+    0x01U, 0x02U, 0x04U, 0x02U, 0x04U };
+static const uint8_t cClockColumn[] = { 0x12U, 0x00U, 0x08U, 0x09U, 0x06U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U };
+static const uint8_t cEnergyColumn[] = { 0x12U, 0x00U, 0x03U, 0x09U, 0x06U, 0x01U, 0x00U, 0x01U, 0x08U, 0x00U, 0xFFU, 0x0FU, 0x02U, 0x12U, 0x00U, 0x00U };
+static const uint8_t cAllColumns[] = { 0x01U, 0x00U };
+
+static uint8_t buffer[SIM_BUF_SIZE];
+
+static uint32_t test_sim_be32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static uint32_t test_sim_execute(sim_meter *meter, const uint8_t *apdu, uint32_t size)
+{
+    static uint32_t rand_state = 0x5EEDU;
+    static sim_stats stats;
+
+    memcpy(&buffer[SIM_HEADROOM], apdu, size);
+    return sim_meter_execute(meter, 0x10U, buffer, size, 0U, &rand_state, &stats);
+}
+
+static void test_sim_datetime(csm_array *array, uint32_t utc)
+{
+    uint8_t cosem[CLK_COSEM_DATETIME_SIZE];
+
+    clk_epoch_to_cosem_batch(&utc, 1U, cosem, CLK_COSEM_DATETIME_SIZE, 0, 0U);
+    (void) csm_axdr_wr_octetstring(array, cosem, CLK_COSEM_DATETIME_SIZE);
+}
+
+// GET of the profile buffer restricted by the clock, [from, to]
+static uint32_t test_sim_get_range(sim_meter *meter, uint32_t from, uint32_t to)
+{
+    uint8_t apdu[128];
+    csm_array array;
+
+    csm_array_init(&array, apdu, sizeof(apdu), 0U, 0U);
+    (void) csm_array_write_buff(&array, cGetProfile, sizeof(cGetProfile));
+    (void) csm_array_write_buff(&array, cClockColumn, sizeof(cClockColumn));
+    test_sim_datetime(&array, from);
+    test_sim_datetime(&array, to);
+    (void) csm_array_write_buff(&array, cAllColumns, sizeof(cAllColumns));
+    return test_sim_execute(meter, apdu, array.wr_index);
+}
+
+// Rows of a GET response: one per period from 'first', the energy index growing by the same step
+static int test_sim_rows(uint32_t size, uint32_t first, uint32_t nb_rows)
+{
+    const uint8_t *reply = &buffer[SIM_HEADROOM];
+    uint32_t previous = 0U;
+    uint32_t step = 0U;
+    int valid = (size == (6U + (nb_rows * TEST_SIM_ROW_SIZE))) && (reply[0] == 0xC4U) && (reply[3] == 0x00U);
+
+    valid = valid && (reply[4] == AXDR_TAG_ARRAY) && (reply[5] == nb_rows);
+    for (uint32_t i = 0U; valid && (i < nb_rows); i++)
+    {
+        const uint8_t *row = &reply[6U + (i * TEST_SIM_ROW_SIZE)];
+        uint32_t energy = test_sim_be32(&row[17]);
+        uint32_t utc = 0U;
+
+        valid = (row[0] == AXDR_TAG_STRUCTURE) && (row[1] == 2U) && (row[2] == AXDR_TAG_OCTETSTRING) && (row[16] == AXDR_TAG_UNSIGNED32);
+        valid = valid && (clk_cosem_to_epoch_batch(&row[4], CLK_COSEM_DATETIME_SIZE, 1U, &utc) == 1U);
+        valid = valid && (utc == (first + (i * SIM_PROFILE_PERIOD)));
+        if (i == 1U)
+        {
+            step = energy - previous;
+        }
+        valid = valid && ((i == 0U) || ((step > 0U) && ((energy - previous) == step)));
+        previous = energy;
+    }
+    return valid;
+}
+
+void test_simulator(void)
+{
+    static sim_config config;
+    sim_meter *meter;
+    uint8_t apdu[128];
+    csm_array array;
+    uint32_t size;
+    uint32_t low;
+
+    memset(&config, 0, sizeof(config));
+    config.nb_meters = TEST_SIM_METERS;
+    config.nb_workers = 1U;
+    config.profile_entries = TEST_SIM_ENTRIES;
+    TEST_CHECK(sim_meters_init(&config));
+    meter = sim_meter_get(1U);
+    TEST_CHECK((meter != NULL) && (sim_meter_get(TEST_SIM_METERS) == NULL));
+    if (meter == NULL)
+    {
+        return;
+    }
+    // Meter time in the middle of a period
+    meter->clock_offset = (int32_t)((int64_t)(TEST_SIM_TIME + 300U) - (int64_t)time(NULL));
+
+    // Not associated: the GET is not executed
+    size = test_sim_get_range(meter, TEST_SIM_TIME - 7200U, TEST_SIM_TIME);
+    TEST_CHECK((size == 0U) || (buffer[SIM_HEADROOM] != 0xC4U) || (buffer[SIM_HEADROOM + 3U] != 0x00U));
+
+    size = test_sim_execute(meter, cAarq, sizeof(cAarq));
+    csm_array_init(&array, &buffer[SIM_HEADROOM], size, size, 0U);
+    TEST_CHECK((size > 0U) && (buffer[SIM_HEADROOM] == 0x61U) && (test_find(&array, cAccepted, sizeof(cAccepted)) >= 0));
+    TEST_CHECK(meter->asso[0].state_cf == CF_ASSOCIATED);
+
+    // Two hours: nine entries, the bounds included; a range before the stored entries is clamped to them
+    TEST_CHECK(test_sim_rows(test_sim_get_range(meter, TEST_SIM_TIME - 7200U, TEST_SIM_TIME), TEST_SIM_TIME - 7200U, 9U));
+    TEST_CHECK(test_sim_rows(test_sim_get_range(meter, TEST_SIM_TIME - 7199U, TEST_SIM_TIME - 1U), TEST_SIM_TIME - 6300U, 7U));
+    TEST_CHECK(test_sim_rows(test_sim_get_range(meter, 0U, TEST_SIM_TIME - ((TEST_SIM_ENTRIES - 3U) * SIM_PROFILE_PERIOD)),
+                             TEST_SIM_TIME - ((TEST_SIM_ENTRIES - 1U) * SIM_PROFILE_PERIOD), 3U));
+    TEST_CHECK(test_sim_rows(test_sim_get_range(meter, TEST_SIM_TIME + 900U, TEST_SIM_TIME + 9000U), 0U, 0U));
+
+    // The energy register restricts the rows by value
+    TEST_CHECK(test_sim_get_range(meter, TEST_SIM_TIME - 900U, TEST_SIM_TIME - 900U) > 0U);
+    low = test_sim_be32(&buffer[SIM_HEADROOM + 6U + 17U]);
+    csm_array_init(&array, apdu, sizeof(apdu), 0U, 0U);
+    (void) csm_array_write_buff(&array, cGetProfile, sizeof(cGetProfile));
+    (void) csm_array_write_buff(&array, cEnergyColumn, sizeof(cEnergyColumn));
+    (void) csm_axdr_wr_u32(&array, low);
+    (void) csm_axdr_wr_u32(&array, 0xFFFFFFFFU);
+    (void) csm_array_write_buff(&array, cAllColumns, sizeof(cAllColumns));
+    TEST_CHECK(test_sim_rows(test_sim_execute(meter, apdu, array.wr_index), TEST_SIM_TIME - 900U, 2U));
+
+    // Snapshot: the association, its counters and the lanes are resumed; the counters saved ahead are
+    // reserved once the image is stored, a restart continues after them
+    static uint8_t image[2048];
+    TEST_CHECK(sim_meters_snapshot_size() <= sizeof(image));
+    meter->sec[0].client_ic = 7U;
+    meter->sec[0].server_ic = 40U;
+    TEST_CHECK(sim_meters_save(image, sizeof(image)));
+    TEST_CHECK(sim_meters_reserve(image, sizeof(image)) && (meter->sec[0].server_ic_limit == (40U + CSM_SNAPSHOT_IC_WINDOW)));
+    meter->sec[0].server_ic = 45U;
+    sim_meter_release(meter, 0x10U);
+    TEST_CHECK(meter->asso[0].state_cf != CF_ASSOCIATED);
+    TEST_CHECK(sim_meters_restore(image, sizeof(image)) == 1);
+    TEST_CHECK(meter->asso[0].state_cf == CF_ASSOCIATED);
+    TEST_CHECK(meter->sec[0].client_ic == 7U);
+    TEST_CHECK((meter->sec[0].server_ic == (40U + CSM_SNAPSHOT_IC_WINDOW)) && (meter->sec[0].server_ic_limit == meter->sec[0].server_ic));
+    TEST_CHECK(test_sim_rows(test_sim_get_range(meter, TEST_SIM_TIME - 900U, TEST_SIM_TIME), TEST_SIM_TIME - 900U, 2U));
+    TEST_CHECK(sim_meters_save(image, sizeof(image)) && sim_meters_reserve(image, sizeof(image)));
+    TEST_CHECK(meter->sec[0].server_ic_limit == (40U + (2U * CSM_SNAPSHOT_IC_WINDOW)));
+    TEST_CHECK(sim_meters_restore(image, 16U) == -1);
+
+    // Released: the association is closed
+    size = test_sim_execute(meter, cRlrq, sizeof(cRlrq));
+    TEST_CHECK((size > 0U) && (buffer[SIM_HEADROOM] == 0x63U));
+    TEST_CHECK(meter->asso[0].state_cf != CF_ASSOCIATED);
+}
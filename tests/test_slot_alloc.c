@@ -0,0 +1,129 @@
+/**
+ * Unit tests of the slot allocator
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "slot_alloc.h"
+
+#define TEST_SA_MAX_SLOTS   5000U
+#define TEST_SA_STEPS       20000U
+
+static uint64_t words[SLOT_ALLOC_WORDS(TEST_SA_MAX_SLOTS)];
+static uint64_t summary[SLOT_ALLOC_SUMMARY(TEST_SA_MAX_SLOTS)];
+static uint8_t used[TEST_SA_MAX_SLOTS];     // Reference model
+
+static uint32_t test_sa_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13U;
+    x ^= x >> 17U;
+    x ^= x << 5U;
+    *state = x;
+    return x;
+}
+
+static int32_t test_sa_lowest_free(uint32_t nb_slots)
+{
+    int32_t slot = -1;
+
+    for (uint32_t i = 0U; i < nb_slots; i++)
+    {
+        if (!used[i])
+        {
+            slot = (int32_t)i;
+            break;
+        }
+    }
+    return slot;
+}
+
+// Random gets, takes and releases, compared with the reference model
+static int test_sa_random(uint32_t nb_slots, int two_levels)
+{
+    slot_alloc sa;
+    uint32_t state = 0x12345678U + nb_slots;
+    uint32_t nb_used = 0U;
+    int valid = TRUE;
+
+    memset(used, 0, sizeof(used));
+    slot_alloc_init(&sa, words, two_levels ? summary : NULL, nb_slots);
+
+    for (uint32_t step = 0U; valid && (step < TEST_SA_STEPS); step++)
+    {
+        uint32_t op = test_sa_rand(&state) % 8U;
+        uint32_t slot = test_sa_rand(&state) % (nb_slots + 1U);
+
+        // More gets than releases while the allocator fills, then the other way round
+        if ((op < 4U) && ((step / 2000U) % 2U == 0U))
+        {
+            int32_t expected = test_sa_lowest_free(nb_slots);
+            valid = (slot_alloc_get(&sa) == expected);
+            if (expected >= 0)
+            {
+                used[expected] = 1U;
+                nb_used++;
+            }
+        }
+        else if (op < 6U)
+        {
+            int expected = (slot < nb_slots) && used[slot];
+            valid = (slot_alloc_release(&sa, slot) == expected);
+            if (expected)
+            {
+                used[slot] = 0U;
+                nb_used--;
+            }
+        }
+        else
+        {
+            int expected = (slot < nb_slots) && !used[slot];
+            valid = (slot_alloc_take(&sa, slot) == expected);
+            if (expected)
+            {
+                used[slot] = 1U;
+                nb_used++;
+            }
+        }
+        valid = valid && (slot_alloc_free_count(&sa) == (nb_slots - nb_used));
+        valid = valid && (slot_alloc_is_used(&sa, slot) == ((slot < nb_slots) && used[slot]));
+    }
+    return valid;
+}
+
+void test_slot_alloc(void)
+{
+    static const uint32_t cSizes[] = { 1U, 63U, 64U, 65U, 200U, 4096U, TEST_SA_MAX_SLOTS };
+    slot_alloc sa;
+
+    // Lowest slot first, none beyond the last one
+    int valid = TRUE;
+    slot_alloc_init(&sa, words, NULL, 65U);
+    for (int32_t i = 0; i < 65; i++)
+    {
+        valid = valid && (slot_alloc_get(&sa) == i);
+    }
+    TEST_CHECK(valid && (slot_alloc_get(&sa) == -1) && (slot_alloc_free_count(&sa) == 0U));
+    TEST_CHECK(slot_alloc_release(&sa, 64U) && slot_alloc_release(&sa, 3U) && !slot_alloc_release(&sa, 3U));
+    TEST_CHECK((slot_alloc_get(&sa) == 3) && (slot_alloc_get(&sa) == 64));
+    TEST_CHECK(!slot_alloc_release(&sa, 65U) && !slot_alloc_take(&sa, 65U) && !slot_alloc_is_used(&sa, 65U));
+
+    // Restored state: taken slots are skipped
+    slot_alloc_init(&sa, words, summary, TEST_SA_MAX_SLOTS);
+    TEST_CHECK(slot_alloc_take(&sa, 0U) && slot_alloc_take(&sa, 1U) && !slot_alloc_take(&sa, 1U));
+    TEST_CHECK(slot_alloc_get(&sa) == 2);
+
+    for (uint32_t i = 0U; i < (sizeof(cSizes) / sizeof(cSizes[0])); i++)
+    {
+        TEST_CHECK(test_sa_random(cSizes[i], FALSE));
+        TEST_CHECK(test_sa_random(cSizes[i], TRUE));
+    }
+}
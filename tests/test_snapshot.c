@@ -0,0 +1,112 @@
+/**
+ * Unit tests of the association snapshot
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_snapshot.h"
+
+static uint8_t image[1024];
+
+static void test_snap_assos(csm_asso_state *assos, csm_sec_context *sec)
+{
+    for (uint32_t i = 0U; i < TEST_NB_ASSOS; i++)
+    {
+        csm_asso_init(&assos[i]);
+        assos[i].config = &cTestAssoConf[i];
+    }
+    memset(sec, 0, TEST_NB_ASSOS * sizeof(csm_sec_context));
+}
+
+// Only the established associations are resumed
+static void test_snap_roundtrip(void)
+{
+    csm_asso_state assos[TEST_NB_ASSOS];
+    csm_asso_state restored[TEST_NB_ASSOS];
+    csm_sec_context sec[TEST_NB_ASSOS];
+
+    test_snap_assos(assos, sec);
+    assos[1].state_cf = CF_ASSOCIATED;
+    assos[1].conformance = CSM_CBLOCK_GET;
+    assos[1].client_app_title[0] = 0x55U;
+
+    uint32_t size = csm_snapshot_save(image, sizeof(image), assos, sec, TEST_NB_ASSOS, NULL, 0U);
+    TEST_CHECK(size == csm_snapshot_size(TEST_NB_ASSOS, 0U));
+    TEST_CHECK(csm_snapshot_save(image, size - 1U, assos, sec, TEST_NB_ASSOS, NULL, 0U) == 0U);
+
+    size = csm_snapshot_save(image, sizeof(image), assos, sec, TEST_NB_ASSOS, NULL, 0U);
+    test_snap_assos(restored, sec);
+    TEST_CHECK(csm_snapshot_restore(image, size, restored, sec, TEST_NB_ASSOS, cTestAssoConf, TEST_NB_ASSOS) == 1);
+    TEST_CHECK(restored[0].state_cf == CF_IDLE);
+    TEST_CHECK(restored[1].state_cf == CF_ASSOCIATED);
+    TEST_CHECK(restored[1].config == &cTestAssoConf[1]);
+    TEST_CHECK(restored[1].conformance == CSM_CBLOCK_GET);
+    TEST_CHECK(restored[1].client_app_title[0] == 0x55U);
+}
+
+// The image is checked as a whole before anything is copied
+static void test_snap_invalid(void)
+{
+    csm_asso_state assos[TEST_NB_ASSOS];
+    csm_sec_context sec[TEST_NB_ASSOS];
+
+    test_snap_assos(assos, sec);
+    assos[0].state_cf = CF_ASSOCIATED;
+    uint32_t size = csm_snapshot_save(image, sizeof(image), assos, sec, TEST_NB_ASSOS, NULL, 0U);
+
+    TEST_CHECK(csm_snapshot_restore(image, size - 1U, assos, sec, TEST_NB_ASSOS, cTestAssoConf, TEST_NB_ASSOS) == -1);
+    image[size - 1U] ^= 0x01U;
+    TEST_CHECK(csm_snapshot_restore(image, size, assos, sec, TEST_NB_ASSOS, cTestAssoConf, TEST_NB_ASSOS) == -1);
+    TEST_CHECK(!csm_snapshot_reserve(image, size, sec, TEST_NB_ASSOS));
+    TEST_CHECK(sec[0].server_ic_limit == 0U);
+}
+
+// The server counters used after a save are never used again after a restart
+static void test_snap_ic_window(void)
+{
+    csm_asso_state assos[TEST_NB_ASSOS];
+    csm_sec_context sec[TEST_NB_ASSOS];
+
+    test_snap_assos(assos, sec);
+    assos[0].state_cf = CF_ASSOCIATED;
+    sec[0].client_ic = 7U;
+    sec[0].server_ic = 100U;
+    sec[1].server_ic = 0xFFFFFFF0U;
+
+    uint32_t size = csm_snapshot_save(image, sizeof(image), assos, sec, TEST_NB_ASSOS, NULL, 0U);
+    TEST_CHECK(csm_snapshot_reserve(image, size, sec, TEST_NB_ASSOS));
+    TEST_CHECK(sec[0].server_ic_limit == (100U + CSM_SNAPSHOT_IC_WINDOW));
+    TEST_CHECK(sec[1].server_ic_limit == 0xFFFFFFFFU);
+
+    // Crash after some responses: the restart skips the whole window
+    sec[0].server_ic += 10U;
+    test_snap_assos(assos, sec);
+    TEST_CHECK(csm_snapshot_restore(image, size, assos, sec, TEST_NB_ASSOS, cTestAssoConf, TEST_NB_ASSOS) == 1);
+    TEST_CHECK(sec[0].client_ic == 7U);
+    TEST_CHECK(sec[0].server_ic == (100U + CSM_SNAPSHOT_IC_WINDOW));
+    TEST_CHECK(sec[0].server_ic_limit == sec[0].server_ic);
+
+    // A new image gives a new window, an older one does not take it back
+    uint8_t old_image[sizeof(image)];
+    memcpy(old_image, image, size);
+    size = csm_snapshot_save(image, sizeof(image), assos, sec, TEST_NB_ASSOS, NULL, 0U);
+    TEST_CHECK(csm_snapshot_reserve(image, size, sec, TEST_NB_ASSOS));
+    TEST_CHECK(sec[0].server_ic_limit == (100U + (2U * CSM_SNAPSHOT_IC_WINDOW)));
+    TEST_CHECK(csm_snapshot_reserve(old_image, size, sec, TEST_NB_ASSOS));
+    TEST_CHECK(sec[0].server_ic_limit == (100U + (2U * CSM_SNAPSHOT_IC_WINDOW)));
+}
+
+void test_snapshot(void)
+{
+    test_snap_roundtrip();
+    test_snap_invalid();
+    test_snap_ic_window();
+}
@@ -0,0 +1,105 @@
+/**
+ * Server stack set up for the unit tests: one association, raw APDUs in and out
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "host_hal.h"
+
+#define TEST_HEADROOM   128U    //!< Free space before the APDU, needed by the security layer
+
+// Logical name referencing, LLS with the host HAL password
+const uint8_t cTestAarq[] =
+{
+    0x60U, 0x36U,
+    0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U,
+    0x8AU, 0x02U, 0x07U, 0x80U,
+    0x8BU, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x02U, 0x01U,
+    0xACU, 0x0AU, 0x80U, 0x08U, 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+    0xBEU, 0x10U, 0x04U, 0x0EU, 0x01U, 0x00U, 0x00U, 0x00U, 0x06U, 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x7EU, 0x1FU, 0x04U, 0xB0U
+};
+
+const uint32_t cTestAarqSize = sizeof(cTestAarq);
+
+const csm_asso_config cTestAssoConf[TEST_NB_ASSOS] =
+{
+    { { TEST_CLIENT_SAP, TEST_SERVER_SAP }, TEST_CONFORMANCE, FALSE },
+    { { TEST_CLIENT_SAP + 1U, TEST_SERVER_SAP }, TEST_CONFORMANCE, FALSE },
+};
+
+static csm_channel channels[TEST_NB_CHANNELS];
+static csm_asso_state assos[TEST_NB_ASSOS];
+static uint8_t buffer[TEST_HEADROOM + CSM_DEF_PDU_SIZE];
+
+void test_stack_init(csm_db_access_handler handler)
+{
+    host_hal_init();
+    csm_services_init(handler);
+    csm_channel_init(channels, TEST_NB_CHANNELS, assos, cTestAssoConf, TEST_NB_ASSOS);
+}
+
+csm_channel *test_stack_channel(uint8_t channel)
+{
+    return &channels[channel];
+}
+
+uint8_t test_stack_open(uint8_t client_sap)
+{
+    uint8_t id = csm_channel_new();
+    if (id != INVALID_CHANNEL_ID)
+    {
+        channels[id - 1U].llc.ssap = client_sap;
+        channels[id - 1U].llc.dsap = TEST_SERVER_SAP;
+    }
+    return id - 1U;
+}
+
+void test_stack_packet(csm_array *packet, const uint8_t *apdu, uint32_t size)
+{
+    memcpy(&buffer[TEST_HEADROOM], apdu, size);
+    csm_array_init(packet, buffer, sizeof(buffer), size, TEST_HEADROOM);
+}
+
+int test_stack_exchange(uint8_t channel, const uint8_t *apdu, uint32_t size, csm_array *reply)
+{
+    int ret;
+
+    test_stack_packet(reply, apdu, size);
+    ret = csm_channel_execute(channel, reply);
+    if (ret > 0)
+    {
+        csm_array_init(reply, &buffer[reply->offset], (uint32_t)ret, (uint32_t)ret, 0U);
+    }
+    return ret;
+}
+
+int test_stack_associate(uint8_t channel)
+{
+    csm_array reply;
+    static const uint8_t cAccepted[] = { 0xA2U, 0x03U, 0x02U, 0x01U, 0x00U };
+    int ret = test_stack_exchange(channel, cTestAarq, cTestAarqSize, &reply);
+
+    // AARE with the result field accepted
+    return (ret > 0) && (reply.buff[0] == CSM_ASSO_AARE) && (test_find(&reply, cAccepted, sizeof(cAccepted)) >= 0);
+}
+
+int test_find(const csm_array *array, const uint8_t *pattern, uint32_t size)
+{
+    int pos = -1;
+    for (uint32_t i = 0U; ((i + size) <= array->wr_index) && (pos < 0); i++)
+    {
+        if (memcmp(&array->buff[array->offset + i], pattern, size) == 0)
+        {
+            pos = (int)i;
+        }
+    }
+    return pos;
+}
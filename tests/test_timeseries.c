@@ -0,0 +1,161 @@
+/**
+ * Unit tests of the compressed time series
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "timeseries.h"
+#include "clock.h"
+#include "csm_axdr_codec.h"
+#include "csm_ber.h"
+
+#define TEST_TS_START       1483228800U     // 2017-01-01 00:00:00 UTC
+#define TEST_TS_PERIOD      900U
+#define TEST_TS_ROWS        2000U
+#define TEST_TS_BLOCKS      16U
+
+static ts_block blocks[TEST_TS_BLOCKS];
+
+typedef struct
+{
+    uint32_t nb;
+    uint32_t next;      // Expected row index
+    int valid;
+} test_ts_ctx;
+
+// Row i: energy 10 x i, a power alternating up and down, the period doubles after row 1500
+static uint32_t test_ts_time(uint32_t i)
+{
+    return (i <= 1500U) ? (TEST_TS_START + (i * TEST_TS_PERIOD)) : (TEST_TS_START + (1500U * TEST_TS_PERIOD) + ((i - 1500U) * 2U * TEST_TS_PERIOD));
+}
+
+static int test_ts_cb(void *ctx, uint32_t time, const uint32_t *values)
+{
+    test_ts_ctx *c = (test_ts_ctx *)ctx;
+    uint32_t i = c->next;
+
+    c->valid = c->valid && (time == test_ts_time(i)) && (values[0] == (i * 10U)) && (values[1] == (1000U + ((i & 1U) * 37U)));
+    c->next++;
+    c->nb++;
+    return TRUE;
+}
+
+static int test_ts_fill(ts_store *store)
+{
+    uint32_t values[2];
+    int valid = TRUE;
+
+    for (uint32_t i = 0U; valid && (i < TEST_TS_ROWS); i++)
+    {
+        values[0] = i * 10U;
+        values[1] = 1000U + ((i & 1U) * 37U);
+        valid = ts_append(store, test_ts_time(i), values);
+    }
+    return valid;
+}
+
+// Array header of a profile buffer, and its first date-time
+static int test_ts_axdr_count(const uint8_t *data, uint32_t size, uint32_t *count, uint32_t *first_time)
+{
+    csm_array array;
+    ber_length len;
+    uint8_t byte = 0U;
+    uint32_t length = 0U;
+
+    csm_array_init(&array, (uint8_t *)data, size, size, 0U);
+    int valid = csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_ARRAY);
+    valid = valid && csm_ber_read_len(&array, &len);
+    *count = valid ? len.length : 0U;
+    if (valid && (*count > 0U))
+    {
+        valid = csm_array_read_u8(&array, &byte) && (byte == AXDR_TAG_STRUCTURE);
+        valid = valid && csm_array_read_u8(&array, &byte) && (byte == 3U);
+        valid = valid && csm_axdr_rd_octetstring(&array, &length) && (length == CLK_COSEM_DATETIME_SIZE);
+        valid = valid && (clk_cosem_to_epoch_batch(csm_array_rd_data(&array), CLK_COSEM_DATETIME_SIZE, 1U, first_time) == 1U);
+    }
+    return valid;
+}
+
+void test_timeseries(void)
+{
+    ts_store store;
+    test_ts_ctx ctx;
+    uint8_t buffer[4096];
+    csm_array out;
+    uint32_t count = 0U;
+    uint32_t first_time = 0U;
+    uint32_t values[2] = { 0U, 0U };
+
+    TEST_CHECK(!ts_init(&store, blocks, TEST_TS_BLOCKS, TS_MAX_COLUMNS + 1U));
+    TEST_CHECK(ts_init(&store, blocks, TEST_TS_BLOCKS, 2U));
+    TEST_CHECK(test_ts_fill(&store));
+
+    // Timestamps strictly increasing
+    TEST_CHECK(!ts_append(&store, test_ts_time(TEST_TS_ROWS - 1U), values));
+    TEST_CHECK(ts_rows(&store) == TEST_TS_ROWS);
+    TEST_CHECK((store.used > 1U) && (ts_size(&store) < (TEST_TS_ROWS * 3U * sizeof(uint32_t) / 4U)));
+
+    // Decoded back across the blocks and the period change
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.valid = TRUE;
+    TEST_CHECK(ts_scan(&store, 0U, 0xFFFFFFFFU, test_ts_cb, &ctx) == TEST_TS_ROWS);
+    TEST_CHECK(ctx.valid && (ctx.nb == TEST_TS_ROWS));
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.valid = TRUE;
+    ctx.next = 1490U;
+    TEST_CHECK(ts_scan(&store, test_ts_time(1490U), test_ts_time(1509U) + 1U, test_ts_cb, &ctx) == 20U);
+    TEST_CHECK(ctx.valid);
+
+    // Profile buffer by clock range
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr(&store, &out, clk_epoch_key(test_ts_time(100U)), clk_epoch_key(test_ts_time(139U))));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time));
+    TEST_CHECK((count == 40U) && (first_time == test_ts_time(100U)));
+
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr(&store, &out, clk_epoch_key(test_ts_time(5U)), clk_epoch_key(test_ts_time(4U))));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time) && (count == 0U));
+
+    // Restricted by a value: the rows of energy [12340, 12590], then power 1037 in a clock range
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr_values(&store, &out, CLK_KEY_MIN, CLK_KEY_MAX, 0U, 12340U, 12590U));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time));
+    TEST_CHECK((count == 26U) && (first_time == test_ts_time(1234U)));
+
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr_values(&store, &out, clk_epoch_key(test_ts_time(10U)), clk_epoch_key(test_ts_time(29U)), 1U, 1001U, 2000U));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time));
+    TEST_CHECK((count == 10U) && (first_time == test_ts_time(11U)));
+
+    // No block within the bounds, or no such column
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr_values(&store, &out, CLK_KEY_MIN, CLK_KEY_MAX, 0U, 20000U, 30000U));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time) && (count == 0U));
+    csm_array_init(&out, buffer, sizeof(buffer), 0U, 0U);
+    TEST_CHECK(ts_write_axdr_values(&store, &out, CLK_KEY_MIN, CLK_KEY_MAX, 2U, 0U, 0xFFFFFFFFU));
+    TEST_CHECK(test_ts_axdr_count(buffer, out.wr_index, &count, &first_time) && (count == 0U));
+
+    // Output full
+    csm_array_init(&out, buffer, 64U, 0U, 0U);
+    TEST_CHECK(!ts_write_axdr(&store, &out, CLK_KEY_MIN, CLK_KEY_MAX));
+
+    // Ring: a full store drops its oldest block
+    TEST_CHECK(ts_init(&store, blocks, 2U, 2U));
+    TEST_CHECK(test_ts_fill(&store));
+    TEST_CHECK((store.used == 2U) && (ts_rows(&store) < TEST_TS_ROWS));
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.valid = TRUE;
+    ctx.next = TEST_TS_ROWS - ts_rows(&store);
+    TEST_CHECK(ts_scan(&store, 0U, 0xFFFFFFFFU, test_ts_cb, &ctx) == ts_rows(&store));
+    TEST_CHECK(ctx.valid && (ctx.next == TEST_TS_ROWS));
+}
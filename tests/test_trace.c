@@ -0,0 +1,233 @@
+/**
+ * Unit tests of the binary trace ring and its serialized form
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "tests.h"
+#include "csm_config.h"
+#include "csm_trace.h"
+
+static csm_trace_ring ring;
+static csm_trace_record records[16];
+
+static uint32_t test_trace_clock(void)
+{
+    return 1234U;
+}
+
+static int test_check_last(const char *expected)
+{
+    csm_trace_record record;
+    char line[256];
+    int ok = csm_trace_read(&ring, &record);
+
+    if (ok)
+    {
+        (void) csm_trace_format(&record, line, sizeof(line));
+        ok = (strcmp(line, expected) == 0);
+        if (!ok)
+        {
+            printf("  got \"%s\", expected \"%s\"\r\n", line, expected);
+        }
+    }
+    return ok;
+}
+
+static void *test_unattached_thread(void *arg)
+{
+    (void) arg;
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "lost %d", 1);
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "lost %d", 2);
+    return NULL;
+}
+
+#define TEST_TRACE_ATTACHERS    (CSM_TRACE_MAX_RINGS + 4U)
+
+static csm_trace_ring rings[TEST_TRACE_ATTACHERS];
+static csm_trace_record ring_records[TEST_TRACE_ATTACHERS][4];
+static volatile uint32_t attached;
+static volatile int attaching;
+
+static void *test_attach_thread(void *arg)
+{
+    uint32_t i = (uint32_t)(uintptr_t)arg;
+
+    if (csm_trace_attach(&rings[i], ring_records[i], 4U))
+    {
+        __sync_fetch_and_add(&attached, 1U);
+    }
+    return NULL;
+}
+
+// Every ring counted is readable, while the other threads attach theirs
+static void *test_reader_thread(void *arg)
+{
+    int *valid = (int *)arg;
+
+    *valid = TRUE;
+    while (attaching)
+    {
+        uint32_t nb = csm_trace_number_of_rings();
+        for (uint32_t i = 0U; i < nb; i++)
+        {
+            *valid = *valid && (csm_trace_get_ring(i) != NULL) && (csm_trace_get_ring(i)->size != 0U);
+        }
+    }
+    return NULL;
+}
+
+static void test_trace_attach_race(void)
+{
+    pthread_t threads[TEST_TRACE_ATTACHERS];
+    pthread_t reader;
+    uint32_t before = csm_trace_number_of_rings();
+    int read = FALSE;
+    int valid = TRUE;
+
+    attached = 0U;
+    attaching = TRUE;
+    TEST_CHECK(pthread_create(&reader, NULL, test_reader_thread, &read) == 0);
+    for (uint32_t i = 0U; i < TEST_TRACE_ATTACHERS; i++)
+    {
+        valid = valid && (pthread_create(&threads[i], NULL, test_attach_thread, (void *)(uintptr_t)i) == 0);
+    }
+    for (uint32_t i = 0U; i < TEST_TRACE_ATTACHERS; i++)
+    {
+        (void) pthread_join(threads[i], NULL);
+    }
+    attaching = FALSE;
+    (void) pthread_join(reader, NULL);
+
+    // The refused attachments are not counted
+    TEST_CHECK(valid && read);
+    TEST_CHECK((attached == (CSM_TRACE_MAX_RINGS - before)) && (csm_trace_number_of_rings() == CSM_TRACE_MAX_RINGS));
+    TEST_CHECK(!csm_trace_attach(&rings[0], ring_records[0], 4U) && (csm_trace_number_of_rings() == CSM_TRACE_MAX_RINGS));
+}
+
+static void test_trace_formats(void)
+{
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "int %d %u %x %c", -5, 4000000000U, 0xBEEFU, 'A');
+    TEST_CHECK(test_check_last("int -5 4000000000 beef A"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "wide %ld %llu %lld", -70000L, 0xFFFFFFFFFFFFFFFFULL, -1234567890123LL);
+    TEST_CHECK(test_check_last("wide -70000 18446744073709551615 -1234567890123"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "size %zu %jd %hhu", (size_t)5000000000ULL, (intmax_t)-9, 300);
+    TEST_CHECK(test_check_last("size 5000000000 -9 44"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "float %.2f %e", 3.14159, 1.5e10);
+    TEST_CHECK(test_check_last("float 3.14 1.500000e+10"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "strings %s and %s, 100%%", "first", "second");
+    TEST_CHECK(test_check_last("strings first and second, 100%"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "star [%*d] [%-4s]", 5, 42, "ab");
+    TEST_CHECK(test_check_last("star [   42] [ab  ]"));
+
+    csm_trace_write(CSM_TRACE_LEVEL_LOG, "null %s", (const char *)NULL);
+    TEST_CHECK(test_check_last("[LOG]null ?\r\n"));
+
+    // Only CSM_TRACE_MAX_ARGS arguments are stored
+    csm_trace_write(CSM_TRACE_LEVEL_ERR, "%d %d %d %d %d", 1, 2, 3, 4, 5);
+    TEST_CHECK(test_check_last("[ERR]1 2 3 4 0\r\n"));
+}
+
+static void test_trace_drops(void)
+{
+    pthread_t thread;
+    uint32_t before = csm_trace_unattached_drops();
+    uint32_t dropped = ring.dropped;
+    csm_trace_record record;
+
+    TEST_CHECK(pthread_create(&thread, NULL, test_unattached_thread, NULL) == 0);
+    (void) pthread_join(thread, NULL);
+    TEST_CHECK(csm_trace_unattached_drops() == (before + 2U));
+
+    for (uint32_t i = 0U; i < 20U; i++)
+    {
+        csm_trace_write(CSM_TRACE_LEVEL_TRACE, "fill %u", i);
+    }
+    TEST_CHECK(ring.dropped == (dropped + 4U));
+    while (csm_trace_read(&ring, &record))
+    {
+    }
+}
+
+static void test_trace_serialized(void)
+{
+    static uint8_t data[4096];
+    static csm_trace_string strings[64];
+    static char text[2048];
+    csm_trace_encoder enc;
+    csm_trace_decoder dec;
+    csm_trace_record record;
+    uint32_t size;
+    uint32_t pos = 0U;
+    char line[256];
+
+    csm_trace_write(CSM_TRACE_LEVEL_LOG, "[SVC] %s %s %llu", "GET", "done", 1ULL << 40);
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "[SVC] %s %s %llu", "GET", "done", 7ULL);
+    csm_trace_write(CSM_TRACE_LEVEL_TRACE, "ratio %.1f", 0.5);
+
+    csm_trace_encoder_init(&enc);
+    // Too small for the header and the first record: nothing is written, nothing is lost
+    TEST_CHECK(csm_trace_drain(&enc, data, 8U) == 0U);
+    TEST_CHECK(ring.head != ring.tail);
+
+    size = csm_trace_drain(&enc, data, sizeof(data));
+    TEST_CHECK(size > 0U);
+    TEST_CHECK(ring.head == ring.tail);
+
+    csm_trace_decoder_init(&dec, strings, 64U, text, sizeof(text));
+    TEST_CHECK(csm_trace_decode(&dec, data, size, &pos, &record) == 1);
+    TEST_CHECK(record.timestamp == 1234U);
+    (void) csm_trace_format(&record, line, sizeof(line));
+    TEST_CHECK(strcmp(line, "[LOG][SVC] GET done 1099511627776\r\n") == 0);
+
+    TEST_CHECK(csm_trace_decode(&dec, data, size, &pos, &record) == 1);
+    (void) csm_trace_format(&record, line, sizeof(line));
+    TEST_CHECK(strcmp(line, "[SVC] GET done 7") == 0);
+
+    TEST_CHECK(csm_trace_decode(&dec, data, size, &pos, &record) == 1);
+    (void) csm_trace_format(&record, line, sizeof(line));
+    TEST_CHECK(strcmp(line, "ratio 0.5") == 0);
+
+    TEST_CHECK(csm_trace_decode(&dec, data, size, &pos, &record) == 0);
+    TEST_CHECK(pos == size);
+    // Format and the three distinct strings, each defined once
+    TEST_CHECK(dec.nb_strings == 4U);
+
+    // A truncated record is an error, not the end of the trace
+    pos = 0U;
+    csm_trace_decoder_init(&dec, strings, 64U, text, sizeof(text));
+    TEST_CHECK(csm_trace_decode(&dec, data, size - 1U, &pos, &record) == 1);
+    TEST_CHECK(csm_trace_decode(&dec, data, size - 1U, &pos, &record) == 1);
+    TEST_CHECK(csm_trace_decode(&dec, data, size - 1U, &pos, &record) == -1);
+
+    pos = 0U;
+    data[0] = 'X';
+    csm_trace_decoder_init(&dec, strings, 64U, text, sizeof(text));
+    TEST_CHECK(csm_trace_decode(&dec, data, size, &pos, &record) == -1);
+}
+
+void test_trace(void)
+{
+    csm_trace_set_clock(test_trace_clock);
+    TEST_CHECK(!csm_trace_attach(&ring, records, 12U));
+    TEST_CHECK(csm_trace_attach(&ring, records, 16U));
+
+    test_trace_formats();
+    test_trace_drops();
+    test_trace_serialized();
+    test_trace_attach_race();
+}
@@ -0,0 +1,205 @@
+/**
+ * Unit tests of the APDU translation to XML or JSON text, and back
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+
+#include "tests.h"
+#include "csm_translate.h"
+
+#define TEST_XLT_TEXT_SIZE  8192U
+#define TEST_XLT_NODES      256U
+#define TEST_XLT_APDU_SIZE  512U
+
+typedef struct
+{
+    const uint8_t *apdu;
+    uint32_t size;
+} test_xlt_apdu;
+
+// GET normal, with selective access, next, with list
+static const uint8_t cGetRequest[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x01U, 0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x00U };
+static const uint8_t cGetSelective[] = { 0xC0U, 0x01U, 0xC1U, 0x00U, 0x07U, 0x01U, 0x00U, 0x63U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x01U,
+    0x02U, 0x02U, 0x04U, 0x06U, 0x00U, 0x00U, 0x00U, 0x01U, 0x06U, 0x00U, 0x00U, 0x00U, 0x0AU, 0x12U, 0x00U, 0x01U, 0x12U, 0x00U, 0x00U };
+static const uint8_t cGetNext[] = { 0xC0U, 0x02U, 0xC1U, 0x00U, 0x00U, 0x00U, 0x02U };
+static const uint8_t cGetWithList[] = { 0xC0U, 0x03U, 0xC1U, 0x02U, 0x00U, 0x01U, 0x00U, 0x00U, 0x60U, 0x01U, 0x00U, 0xFFU, 0x02U, 0x00U,
+    0x00U, 0x08U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x02U, 0x00U };
+
+// Structure of all the kinds of values: strings, bit string, date-time, nested array, null
+static const uint8_t cGetResponse[] = { 0xC4U, 0x01U, 0xC1U, 0x00U, 0x02U, 0x08U,
+    0x06U, 0x00U, 0x00U, 0x00U, 0x64U,
+    0x0AU, 0x05U, 'a', '<', '"', '&', 'z',
+    0x04U, 0x0CU, 0xA5U, 0x50U,
+    0x09U, 0x0CU, 0x07U, 0xE0U, 0x0BU, 0x03U, 0x04U, 0x0CU, 0x1EU, 0x00U, 0xFFU, 0xFFU, 0xC4U, 0x00U,
+    0x01U, 0x02U, 0x11U, 0x01U, 0x11U, 0x02U,
+    0x03U, 0x01U,
+    0x10U, 0xFFU, 0x85U,
+    0x00U };
+static const uint8_t cGetResponseError[] = { 0xC4U, 0x01U, 0xC1U, 0x01U, 0x04U };
+static const uint8_t cGetResponseBlock[] = { 0xC4U, 0x02U, 0xC1U, 0x00U, 0x00U, 0x00U, 0x00U, 0x01U, 0x00U, 0x04U, 0x01U, 0x02U, 0x11U, 0x05U };
+static const uint8_t cGetResponseList[] = { 0xC4U, 0x03U, 0xC1U, 0x02U, 0x00U, 0x12U, 0x00U, 0x2AU, 0x01U, 0x04U };
+
+static const uint8_t cSetRequest[] = { 0xC1U, 0x01U, 0xC1U, 0x00U, 0x08U, 0x00U, 0x00U, 0x01U, 0x00U, 0x00U, 0xFFU, 0x02U, 0x00U,
+    0x09U, 0x0CU, 0x07U, 0xE0U, 0x0BU, 0x03U, 0x04U, 0x0CU, 0x1EU, 0x00U, 0xFFU, 0xFFU, 0xC4U, 0x00U };
+static const uint8_t cSetResponse[] = { 0xC5U, 0x01U, 0xC1U, 0x00U };
+static const uint8_t cActionRequest[] = { 0xC3U, 0x01U, 0xC1U, 0x00U, 0x0FU, 0x00U, 0x00U, 0x28U, 0x00U, 0x00U, 0xFFU, 0x01U, 0x01U,
+    0x09U, 0x04U, 0x01U, 0x02U, 0x03U, 0x04U };
+static const uint8_t cActionResponse[] = { 0xC7U, 0x01U, 0xC1U, 0x00U, 0x01U, 0x00U, 0x09U, 0x02U, 0xAAU, 0xBBU };
+static const uint8_t cException[] = { 0xD8U, 0x01U, 0x02U };
+
+// AARQ, LN referencing, no security; AARE accepted; RLRQ, RLRE
+static const uint8_t cAarq[] = { 0x60U, 0x1DU, 0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U,
+    0xBEU, 0x10U, 0x04U, 0x0EU, 0x01U, 0x00U, 0x00U, 0x00U, 0x06U, 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x7EU, 0x1FU, 0x04U, 0xB0U };
+static const uint8_t cAare[] = { 0x61U, 0x29U, 0xA1U, 0x09U, 0x06U, 0x07U, 0x60U, 0x85U, 0x74U, 0x05U, 0x08U, 0x01U, 0x01U,
+    0xA2U, 0x03U, 0x02U, 0x01U, 0x00U, 0xA3U, 0x05U, 0xA1U, 0x03U, 0x02U, 0x01U, 0x00U,
+    0xBEU, 0x10U, 0x04U, 0x0EU, 0x08U, 0x00U, 0x06U, 0x5FU, 0x1FU, 0x04U, 0x00U, 0x00U, 0x10U, 0x1DU, 0x04U, 0x00U, 0x00U, 0x07U };
+static const uint8_t cRlrq[] = { 0x62U, 0x03U, 0x80U, 0x01U, 0x00U };
+static const uint8_t cRlre[] = { 0x63U, 0x03U, 0x80U, 0x01U, 0x00U };
+
+// Ciphered: kept raw
+static const uint8_t cGloGet[] = { 0xC8U, 0x08U, 0x30U, 0x00U, 0x00U, 0x00U, 0x01U, 0x11U, 0x22U, 0x33U };
+
+#define TEST_XLT(array) { array, sizeof(array) }
+
+static const test_xlt_apdu cApdus[] =
+{
+    TEST_XLT(cGetRequest), TEST_XLT(cGetSelective), TEST_XLT(cGetNext), TEST_XLT(cGetWithList),
+    TEST_XLT(cGetResponse), TEST_XLT(cGetResponseError), TEST_XLT(cGetResponseBlock), TEST_XLT(cGetResponseList),
+    TEST_XLT(cSetRequest), TEST_XLT(cSetResponse), TEST_XLT(cActionRequest), TEST_XLT(cActionResponse),
+    TEST_XLT(cException), TEST_XLT(cAarq), TEST_XLT(cAare), TEST_XLT(cRlrq), TEST_XLT(cRlre), TEST_XLT(cGloGet)
+};
+
+#define TEST_XLT_NB_APDUS (sizeof(cApdus) / sizeof(cApdus[0]))
+
+static char buffer[TEST_XLT_TEXT_SIZE];
+static char grown[TEST_XLT_TEXT_SIZE];
+static csm_text_node nodes[TEST_XLT_NODES];
+static uint8_t apdu[TEST_XLT_APDU_SIZE];
+
+// Fixed storage: the first growth moves the text to the larger buffer
+static int test_xlt_grow(csm_text *text, uint32_t needed)
+{
+    int valid = (text->data != grown) && (needed <= sizeof(grown));
+
+    if (valid)
+    {
+        memcpy(grown, text->data, text->size);
+        text->data = grown;
+        text->capacity = sizeof(grown);
+    }
+    return valid;
+}
+
+static int test_xlt_contains(const csm_text *text, const char *str)
+{
+    uint32_t len = (uint32_t)strlen(str);
+    int found = FALSE;
+
+    for (uint32_t i = 0U; !found && ((i + len) <= text->size); i++)
+    {
+        found = (memcmp(&text->data[i], str, len) == 0);
+    }
+    return found;
+}
+
+// All the APDUs in one text, back to the same binary one by one
+static int test_xlt_round_trip(enum csm_text_format format)
+{
+    csm_text text;
+    csm_text_tree tree = { nodes, TEST_XLT_NODES, 0U, CSM_TEXT_XML };
+    csm_array array;
+    uint32_t pos = 0U;
+    int valid = TRUE;
+
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    if (format == CSM_TEXT_XML)
+    {
+        valid = csm_text_append(&text, "<?xml version=\"1.0\"?>\n<!-- capture -->\n", 39U);
+    }
+    for (uint32_t i = 0U; valid && (i < TEST_XLT_NB_APDUS); i++)
+    {
+        valid = csm_translate_to_text(&text, format, cApdus[i].apdu, cApdus[i].size) && !text.error;
+    }
+
+    for (uint32_t i = 0U; valid && (i < TEST_XLT_NB_APDUS); i++)
+    {
+        csm_array_init(&array, apdu, sizeof(apdu), 0U, 0U);
+        valid = (csm_translate_from_text(text.data, text.size, &pos, &tree, &array) == (int)cApdus[i].size);
+        valid = valid && (tree.format == format) && (memcmp(apdu, cApdus[i].apdu, cApdus[i].size) == 0);
+    }
+    csm_array_init(&array, apdu, sizeof(apdu), 0U, 0U);
+    return valid && (csm_translate_from_text(text.data, text.size, &pos, &tree, &array) == 0);
+}
+
+static int test_xlt_from(const char *str, csm_text_tree *tree)
+{
+    csm_array array;
+    uint32_t pos = 0U;
+
+    csm_array_init(&array, apdu, sizeof(apdu), 0U, 0U);
+    return csm_translate_from_text(str, (uint32_t)strlen(str), &pos, tree, &array);
+}
+
+void test_translate(void)
+{
+    static const char cGetXml[] =
+        "<GetRequest>\n"
+        "  <GetRequestNormal>\n"
+        "    <InvokeIdAndPriority Value=\"C1\" />\n"
+        "    <AttributeDescriptor>\n"
+        "      <ClassId Value=\"0001\" />\n"
+        "      <InstanceId Value=\"0000600100FF\" />\n"
+        "      <AttributeId Value=\"02\" />\n"
+        "    </AttributeDescriptor>\n"
+        "  </GetRequestNormal>\n"
+        "</GetRequest>\n";
+    csm_text text;
+    csm_text_tree tree = { nodes, TEST_XLT_NODES, 0U, CSM_TEXT_XML };
+
+    TEST_CHECK(test_xlt_round_trip(CSM_TEXT_XML));
+    TEST_CHECK(test_xlt_round_trip(CSM_TEXT_JSON));
+
+    // Gurux style XML, one JSON line per APDU
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_XML, cGetRequest, sizeof(cGetRequest)));
+    TEST_CHECK((text.size == (sizeof(cGetXml) - 1U)) && (memcmp(text.data, cGetXml, text.size) == 0));
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_XML, cGetResponse, sizeof(cGetResponse)));
+    TEST_CHECK(test_xlt_contains(&text, "a&lt;&quot;&amp;z") && test_xlt_contains(&text, "101001010101"));
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_JSON, cGetRequest, sizeof(cGetRequest)));
+    TEST_CHECK((text.size > 0U) && (text.data[0] == '{') && (memchr(text.data, '\n', text.size) == &text.data[text.size - 1U]));
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_XML, cGloGet, sizeof(cGloGet)));
+    TEST_CHECK(test_xlt_contains(&text, "<Raw Value=\"C8083000000001112233\" />"));
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_XML, cAarq, sizeof(cAarq)));
+    TEST_CHECK(test_xlt_contains(&text, "<InitiateRequest>") && !test_xlt_contains(&text, "<Raw"));
+    csm_text_init(&text, buffer, sizeof(buffer), NULL);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_JSON, cGetResponse, sizeof(cGetResponse)));
+    TEST_CHECK(test_xlt_contains(&text, "{\"String\":\"a<\\\"&z\"}"));
+
+    // Fixed buffer: full; growing buffer: the whole text
+    csm_text_init(&text, buffer, 64U, NULL);
+    TEST_CHECK(!csm_translate_to_text(&text, CSM_TEXT_XML, cGetRequest, sizeof(cGetRequest)) && text.error);
+    csm_text_init(&text, buffer, 64U, test_xlt_grow);
+    TEST_CHECK(csm_translate_to_text(&text, CSM_TEXT_XML, cGetRequest, sizeof(cGetRequest)) && !text.error);
+    TEST_CHECK((text.data == grown) && (text.size == (sizeof(cGetXml) - 1U)) && (memcmp(text.data, cGetXml, text.size) == 0));
+
+    // Malformed texts, too few nodes
+    TEST_CHECK(test_xlt_from(cGetXml, &tree) == (int)sizeof(cGetRequest));
+    TEST_CHECK(test_xlt_from("<GetRequest><GetRequestNormal></GetRequest>", &tree) == -1);
+    TEST_CHECK(test_xlt_from("<GetRequest><Unknown /></GetRequest>", &tree) == -1);
+    TEST_CHECK(test_xlt_from("<Raw Value=\"C0G1\" />", &tree) == -1);
+    TEST_CHECK(test_xlt_from("{\"GetRequest\":[", &tree) == -1);
+    TEST_CHECK(test_xlt_from("  <!-- nothing -->\n", &tree) == 0);
+    tree.capacity = 4U;
+    TEST_CHECK(test_xlt_from(cGetXml, &tree) == -1);
+}
@@ -0,0 +1,160 @@
+/**
+ * Unit tests of the work-stealing pool
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "tests.h"
+#include "work_pool.h"
+
+#define TEST_WP_THIEVES     3U
+#define TEST_WP_TASKS       200000U
+#define TEST_WP_WORKERS     4U
+#define TEST_WP_RUN_TASKS   2000U
+
+static wp_deque deque;
+static wp_pool pool;
+static volatile uint32_t taken[TEST_WP_TASKS];
+static volatile uint32_t owner_done;
+static uint32_t executed[TEST_WP_RUN_TASKS];
+static volatile uint32_t stolen;
+
+static void test_wp_take(uint32_t task)
+{
+    if (task != WP_EMPTY)
+    {
+        __atomic_add_fetch(&taken[task], 1U, __ATOMIC_RELAXED);
+    }
+}
+
+static void *test_wp_thief(void *arg)
+{
+    (void) arg;
+
+    while (!__atomic_load_n(&owner_done, __ATOMIC_ACQUIRE))
+    {
+        test_wp_take(wp_deque_steal(&deque));
+    }
+    return NULL;
+}
+
+// Owner: pushes, pops one task out of three, the thieves race for the others and for the last ones
+static int test_wp_race(void)
+{
+    pthread_t thieves[TEST_WP_THIEVES];
+    int valid = TRUE;
+
+    wp_deque_init(&deque);
+    owner_done = FALSE;
+    for (uint32_t i = 0U; i < TEST_WP_THIEVES; i++)
+    {
+        valid = valid && (pthread_create(&thieves[i], NULL, test_wp_thief, NULL) == 0);
+    }
+
+    for (uint32_t task = 0U; valid && (task < TEST_WP_TASKS); task++)
+    {
+        while (!wp_deque_push(&deque, task))
+        {
+            test_wp_take(wp_deque_pop(&deque));
+        }
+        if ((task % 3U) == 0U)
+        {
+            test_wp_take(wp_deque_pop(&deque));
+        }
+    }
+
+    uint32_t task;
+    while ((task = wp_deque_pop(&deque)) != WP_EMPTY)
+    {
+        test_wp_take(task);
+    }
+    __atomic_store_n(&owner_done, TRUE, __ATOMIC_RELEASE);
+    for (uint32_t i = 0U; i < TEST_WP_THIEVES; i++)
+    {
+        (void) pthread_join(thieves[i], NULL);
+    }
+
+    // Every task taken exactly once
+    for (uint32_t i = 0U; valid && (i < TEST_WP_TASKS); i++)
+    {
+        valid = (taken[i] == 1U);
+    }
+    return valid;
+}
+
+static void test_wp_task(void *ctx, uint32_t task, uint32_t worker)
+{
+    uint32_t spins = 0U;
+
+    (void) ctx;
+    if ((task % TEST_WP_WORKERS) == 0U)
+    {
+        if (worker == 0U)
+        {
+            // The owner of the first deque is held until another worker steals from it
+            while (!__atomic_load_n(&stolen, __ATOMIC_ACQUIRE) && (spins < 1000000U))
+            {
+                (void) sched_yield();
+                spins++;
+            }
+        }
+        else
+        {
+            __atomic_store_n(&stolen, TRUE, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_add_fetch(&executed[task], 1U, __ATOMIC_RELAXED);
+}
+
+void test_work_pool(void)
+{
+    // Owner at the bottom (LIFO), thieves at the top (FIFO)
+    wp_deque_init(&deque);
+    TEST_CHECK(wp_deque_pop(&deque) == WP_EMPTY);
+    TEST_CHECK(wp_deque_steal(&deque) == WP_EMPTY);
+    TEST_CHECK(wp_deque_push(&deque, 1U) && wp_deque_push(&deque, 2U) && wp_deque_push(&deque, 3U));
+    TEST_CHECK(wp_deque_pop(&deque) == 3U);
+    TEST_CHECK(wp_deque_steal(&deque) == 1U);
+    TEST_CHECK(wp_deque_pop(&deque) == 2U);
+    TEST_CHECK((wp_deque_pop(&deque) == WP_EMPTY) && (wp_deque_steal(&deque) == WP_EMPTY));
+
+    // Full, then the slots are reused around the ring
+    int valid = TRUE;
+    for (uint32_t i = 0U; i < WP_DEQUE_SIZE; i++)
+    {
+        valid = valid && wp_deque_push(&deque, i);
+    }
+    TEST_CHECK(valid && !wp_deque_push(&deque, WP_DEQUE_SIZE));
+    TEST_CHECK((wp_deque_steal(&deque) == 0U) && wp_deque_push(&deque, WP_DEQUE_SIZE));
+    TEST_CHECK(wp_deque_pop(&deque) == WP_DEQUE_SIZE);
+
+    TEST_CHECK(test_wp_race());
+
+    // Pool: every task once, the tasks of a busy worker are stolen
+    memset(executed, 0, sizeof(executed));
+    stolen = FALSE;
+    TEST_CHECK(wp_init(&pool, TEST_WP_WORKERS));
+    TEST_CHECK(wp_run(&pool, test_wp_task, NULL, TEST_WP_RUN_TASKS));
+    valid = TRUE;
+    for (uint32_t i = 0U; i < TEST_WP_RUN_TASKS; i++)
+    {
+        valid = valid && (executed[i] == 1U);
+    }
+    TEST_CHECK(valid && stolen);
+
+    // Runs again on the same threads, too many tasks are refused
+    TEST_CHECK(wp_run(&pool, test_wp_task, NULL, TEST_WP_RUN_TASKS));
+    TEST_CHECK(executed[TEST_WP_RUN_TASKS - 1U] == 2U);
+    TEST_CHECK(!wp_run(&pool, test_wp_task, NULL, (TEST_WP_WORKERS * WP_DEQUE_SIZE) + 1U));
+    TEST_CHECK(wp_run(&pool, test_wp_task, NULL, 0U));
+    wp_destroy(&pool);
+}
@@ -0,0 +1,70 @@
+/**
+ * Unit tests: checks and suites
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdint.h>
+#include "csm_channel.h"
+
+// A failed check is reported and counted, the suite goes on
+#define TEST_CHECK(condition) tests_check((condition), #condition, __FILE__, __LINE__)
+
+int tests_check(int condition, const char *text, const char *file, int line);
+
+// Server stack shared by the suites (test_stack.c): two associations, raw APDUs
+#define TEST_CLIENT_SAP     0x10U
+#define TEST_SERVER_SAP     0x01U
+#define TEST_NB_ASSOS       2U
+#define TEST_NB_CHANNELS    (CSM_DEF_MAX_REQUESTS + 2U)
+#define TEST_CONFORMANCE    (CSM_CBLOCK_GET | CSM_CBLOCK_SET | CSM_CBLOCK_ACTION | CSM_CBLOCK_SELECTIVE_ACCESS | CSM_CBLOCK_BLOCK_TRANSFER_WITH_GET_OR_READ)
+
+extern const uint8_t cTestAarq[];
+extern const uint32_t cTestAarqSize;
+extern const csm_asso_config cTestAssoConf[TEST_NB_ASSOS];
+
+void test_stack_init(csm_db_access_handler handler);
+csm_channel *test_stack_channel(uint8_t channel);
+// Allocate a channel for the client SAP, return its index
+uint8_t test_stack_open(uint8_t client_sap);
+void test_stack_packet(csm_array *packet, const uint8_t *apdu, uint32_t size);
+// Run one request APDU, the reply is valid until the next exchange
+int test_stack_exchange(uint8_t channel, const uint8_t *apdu, uint32_t size, csm_array *reply);
+// Send the LLS AARQ, TRUE if the association is accepted
+int test_stack_associate(uint8_t channel);
+// Offset of the pattern in the written part of the array, -1 if absent
+int test_find(const csm_array *array, const uint8_t *pattern, uint32_t size);
+
+// Suites, one per module, listed in tests_main.c
+void test_trace(void);
+void test_metrics(void);
+void test_hdlc(void);
+void test_association(void);
+void test_services(void);
+void test_array(void);
+void test_clock(void);
+void test_push(void);
+void test_capture(void);
+void test_executor(void);
+void test_snapshot(void);
+void test_event_log(void);
+void test_timeseries(void);
+void test_columnar(void);
+void test_slot_alloc(void);
+void test_calendar(void);
+void test_admission(void);
+void test_work_pool(void);
+void test_translate(void);
+void test_simulator(void);
+void test_hex(void);
+void test_objdb(void);
+
+#endif // TESTS_H
@@ -0,0 +1,90 @@
+/**
+ * Unit tests runner: executes all the suites, or the ones given on the command line
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+typedef struct
+{
+    const char *name;
+    void (*run)(void);
+} test_suite;
+
+static const test_suite suites[] =
+{
+    { "trace", test_trace },
+    { "metrics", test_metrics },
+    { "hdlc", test_hdlc },
+    { "association", test_association },
+    { "services", test_services },
+    { "array", test_array },
+    { "clock", test_clock },
+    { "push", test_push },
+    { "capture", test_capture },
+    { "executor", test_executor },
+    { "snapshot", test_snapshot },
+    { "event_log", test_event_log },
+    { "timeseries", test_timeseries },
+    { "columnar", test_columnar },
+    { "slot_alloc", test_slot_alloc },
+    { "calendar", test_calendar },
+    { "admission", test_admission },
+    { "work_pool", test_work_pool },
+    { "translate", test_translate },
+    { "simulator", test_simulator },
+    { "hex", test_hex },
+    { "objdb", test_objdb },
+};
+
+#define NB_SUITES (sizeof(suites) / sizeof(suites[0]))
+
+static uint32_t nb_checks = 0U;
+static uint32_t nb_failures = 0U;
+
+int tests_check(int condition, const char *text, const char *file, int line)
+{
+    nb_checks++;
+    if (!condition)
+    {
+        nb_failures++;
+        printf("%s:%d: check failed: %s\r\n", file, line, text);
+    }
+    return condition;
+}
+
+static int tests_selected(const char *name, int argc, char **argv)
+{
+    int selected = (argc <= 1);
+    for (int i = 1; (i < argc) && !selected; i++)
+    {
+        selected = (strcmp(name, argv[i]) == 0);
+    }
+    return selected;
+}
+
+int main(int argc, char **argv)
+{
+    for (uint32_t i = 0U; i < NB_SUITES; i++)
+    {
+        if (tests_selected(suites[i].name, argc, argv))
+        {
+            uint32_t failures = nb_failures;
+            suites[i].run();
+            printf("[%s] %s\r\n", (failures == nb_failures) ? " OK " : "FAIL", suites[i].name);
+        }
+    }
+
+    printf("%u checks, %u failures\r\n", nb_checks, nb_failures);
+    return (nb_failures == 0U) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,4 @@
+
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), tracedump_main.c)
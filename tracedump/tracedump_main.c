@@ -0,0 +1,98 @@
+/**
+ * Offline decoder of the serialized trace rings (see csm_trace.h)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ * The application drains its rings with csm_trace_drain() into a file; this tool prints one line per
+ * record, prefixed by its timestamp.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "csm_config.h"
+#include "csm_trace.h"
+#include "mapped_file.h"
+
+#define TRD_MAX_STRINGS     65536U
+#define TRD_TEXT_SIZE       (4U * 1024U * 1024U)
+#define TRD_LINE_SIZE       1024U
+
+static csm_trace_string strings[TRD_MAX_STRINGS];
+static char text[TRD_TEXT_SIZE];
+
+static void trd_usage(const char *name)
+{
+    printf("Usage: %s [-l level] input\r\n", name);
+    printf("Prints the records of a serialized trace; -l keeps the levels up to 1 (ERR), 2 (LOG) or 3 (TRACE).\r\n");
+}
+
+int main(int argc, char **argv)
+{
+    csm_trace_decoder dec;
+    csm_trace_record record;
+    mapped_file mf;
+    uint32_t max_level = CSM_TRACE_LEVEL_TRACE;
+    uint32_t pos = 0U;
+    uint32_t nb_records = 0U;
+    int ret = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            max_level = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            trd_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != (argc - 1))
+    {
+        trd_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!mapped_file_open_ro(&mf, argv[optind]))
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    csm_trace_decoder_init(&dec, strings, TRD_MAX_STRINGS, text, TRD_TEXT_SIZE);
+    while ((ret = csm_trace_decode(&dec, mf.data, mf.size, &pos, &record)) > 0)
+    {
+        if (record.level <= max_level)
+        {
+            char line[TRD_LINE_SIZE];
+            uint32_t len = csm_trace_format(&record, line, sizeof(line));
+
+            // The TRACE statements carry their own line endings, the others end with CRLF
+            while ((len > 0U) && ((line[len - 1U] == '\n') || (line[len - 1U] == '\r')))
+            {
+                len--;
+            }
+            printf("%10u %.*s\n", record.timestamp, (int)len, line);
+        }
+        nb_records++;
+    }
+
+    if (ret < 0)
+    {
+        fprintf(stderr, "%s: invalid trace at offset %u\n", argv[optind], pos);
+    }
+    fprintf(stderr, "%u records, %u strings\n", nb_records, dec.nb_strings);
+    mapped_file_close(&mf);
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,3 @@
+LOCAL_DIR = $(call my-dir)/
+
+SOURCES += $(addprefix $(LOCAL_DIR), translator_main.c)
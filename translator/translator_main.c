@@ -0,0 +1,333 @@
+/**
+ * APDU translator: capture files or hex dumps to XML or JSON, and back to hex (see csm_translate.h)
+ *
+ * Copyright (c) 2016, Anthony Rabine
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the BSD license.
+ * See LICENSE.txt for more details.
+ *
+ * Forward input: a capture file (see capture.h) or a text file with one APDU per line in hex.
+ * Reverse input (-r): the XML or JSON output of the forward direction, written as hex lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "csm_translate.h"
+#include "capture.h"
+#include "mapped_file.h"
+#include "os_util.h"
+#include "hdlc.h"
+
+#define XLT_WRAPPER_HDR_SIZE    8U
+#define XLT_HDLC_LLC_SIZE       3U
+#define XLT_MAX_FRAME           65535U
+#define XLT_MAX_NODES           65536U
+#define XLT_OUT_SIZE            (64U * 1024U)
+#define XLT_FLUSH_SIZE          (32U * 1024U)
+
+static enum csm_text_format format = CSM_TEXT_XML;
+static FILE *output = NULL;
+static csm_text text;
+static uint8_t frame[XLT_MAX_FRAME];
+static csm_text_node nodes[XLT_MAX_NODES];
+
+static uint32_t nb_apdus = 0U;
+static uint32_t nb_skipped = 0U;
+
+static void xlt_usage(const char *name)
+{
+    printf("Usage: %s [-j] [-r] [-o output] input\r\n", name);
+    printf("Input: capture file or one APDU per line in hex; -j writes JSON instead of XML.\r\n");
+    printf("-r translates XML or JSON back to one APDU per line in hex.\r\n");
+}
+
+static int xlt_grow(csm_text *t, uint32_t needed)
+{
+    uint32_t capacity = t->capacity * 2U;
+    char *data;
+
+    while (capacity < needed)
+    {
+        capacity *= 2U;
+    }
+    data = realloc(t->data, capacity);
+    if (data != NULL)
+    {
+        t->data = data;
+        t->capacity = capacity;
+    }
+    return (data != NULL);
+}
+
+static int xlt_flush(int force)
+{
+    int valid = TRUE;
+
+    if (force || (text.size >= XLT_FLUSH_SIZE))
+    {
+        valid = (fwrite(text.data, 1U, text.size, output) == text.size);
+        text.size = 0U;
+    }
+    return valid;
+}
+
+static int xlt_apdu(const uint8_t *apdu, uint32_t size)
+{
+    nb_apdus++;
+    return csm_translate_to_text(&text, format, apdu, size) && xlt_flush(FALSE);
+}
+
+// Wrapper: 8 bytes header then the APDU; HDLC: I frames only, without the LLC header
+static int xlt_frame(uint8_t link, uint8_t direction, const uint8_t *data, uint32_t size)
+{
+    int valid = TRUE;
+
+    if (link == CAP_LINK_HDLC)
+    {
+        hdlc_t hdlc;
+        hdlc_init(&hdlc);
+        hdlc.sender = (direction == CAP_RX) ? HDLC_CLIENT : HDLC_SERVER;
+
+        if ((hdlc_decode(&hdlc, data, (uint16_t)size) == HDLC_OK) && (hdlc.type == HDLC_PACKET_TYPE_I) &&
+            (hdlc.data_size > XLT_HDLC_LLC_SIZE))
+        {
+            valid = xlt_apdu(&data[hdlc.data_index + XLT_HDLC_LLC_SIZE], hdlc.data_size - XLT_HDLC_LLC_SIZE);
+        }
+        else
+        {
+            nb_skipped++;
+        }
+    }
+    else if (size > XLT_WRAPPER_HDR_SIZE)
+    {
+        valid = xlt_apdu(&data[XLT_WRAPPER_HDR_SIZE], size - XLT_WRAPPER_HDR_SIZE);
+    }
+    else
+    {
+        nb_skipped++;
+    }
+    return valid;
+}
+
+static int xlt_capture(const char *path)
+{
+    cap_file cap;
+    cap_record record;
+    int valid = cap_open(&cap, path);
+    int read = 0;
+
+    while (valid && ((read = cap_read(&cap, &record, frame, sizeof(frame))) > 0))
+    {
+        // JSON keeps one APDU per line, the record information is only in the XML output
+        if (format == CSM_TEXT_XML)
+        {
+            uint64_t t = record.time_us - cap.start_us;
+            uint32_t seconds = (uint32_t)(t / 1000000U);
+            uint32_t micro = (uint32_t)(t % 1000000U);
+            const char *direction = (record.direction == CAP_RX) ? "rx" : "tx";
+            char comment[96];
+            int len = snprintf(comment, sizeof(comment), "<!-- %u.%06u %s %u -->\n", seconds, micro, direction, record.channel);
+            valid = csm_text_append(&text, comment, (uint32_t)len);
+        }
+        valid = valid && xlt_frame(cap.link, record.direction, frame, record.size);
+    }
+    if (read < 0)
+    {
+        fprintf(stderr, "%s: truncated or oversized record\n", path);
+        valid = FALSE;
+    }
+    cap_close(&cap);
+    return valid;
+}
+
+static int xlt_hex_value(char c)
+{
+    int value = -1;
+    if ((c >= '0') && (c <= '9'))
+    {
+        value = c - '0';
+    }
+    else if ((c >= 'A') && (c <= 'F'))
+    {
+        value = c - 'A' + 10;
+    }
+    else if ((c >= 'a') && (c <= 'f'))
+    {
+        value = c - 'a' + 10;
+    }
+    return value;
+}
+
+// One APDU per line, spaces between the bytes are allowed, '#' starts a comment
+static int xlt_hex_lines(const uint8_t *data, uint32_t size)
+{
+    uint32_t pos = 0U;
+    int valid = TRUE;
+
+    while (valid && (pos < size))
+    {
+        uint32_t nb = 0U;
+        int high = -1;
+
+        while ((pos < size) && (data[pos] != '\n') && (data[pos] != '#'))
+        {
+            int digit = xlt_hex_value((char)data[pos]);
+            if ((digit >= 0) && (nb < sizeof(frame)))
+            {
+                if (high < 0)
+                {
+                    high = digit;
+                }
+                else
+                {
+                    frame[nb++] = (uint8_t)((high << 4) | digit);
+                    high = -1;
+                }
+            }
+            pos++;
+        }
+        while ((pos < size) && (data[pos] != '\n'))
+        {
+            pos++;
+        }
+        pos++;
+
+        if (nb > 0U)
+        {
+            valid = xlt_apdu(frame, nb);
+        }
+    }
+    return valid;
+}
+
+static int xlt_forward(const char *path)
+{
+    mapped_file mf;
+    int valid = mapped_file_open_ro(&mf, path);
+
+    if (valid)
+    {
+        int is_capture = (mf.size >= CAP_HEADER_SIZE) && (GET_BE32(mf.data) == CAP_MAGIC);
+        if (is_capture)
+        {
+            mapped_file_close(&mf);
+            valid = xlt_capture(path);
+        }
+        else
+        {
+            valid = xlt_hex_lines(mf.data, mf.size);
+            mapped_file_close(&mf);
+        }
+    }
+    return valid && xlt_flush(TRUE);
+}
+
+static int xlt_reverse(const char *path)
+{
+    static const char cHex[] = "0123456789ABCDEF";
+    mapped_file mf;
+    csm_text_tree tree;
+    csm_array apdu;
+    uint32_t pos = 0U;
+    int size = 0;
+    int opened = mapped_file_open_ro(&mf, path);
+    int valid = opened;
+
+    tree.nodes = nodes;
+    tree.capacity = XLT_MAX_NODES;
+
+    while (valid)
+    {
+        csm_array_init(&apdu, frame, sizeof(frame), 0U, 0U);
+        size = csm_translate_from_text((const char *)mf.data, mf.size, &pos, &tree, &apdu);
+        if (size <= 0)
+        {
+            valid = (size == 0);
+            break;
+        }
+
+        char line[2U * 256U];
+        uint32_t len = 0U;
+        for (int i = 0; valid && (i < size); i++)
+        {
+            line[len++] = cHex[frame[i] >> 4U];
+            line[len++] = cHex[frame[i] & 0x0FU];
+            if ((len == sizeof(line)) || ((i + 1) == size))
+            {
+                valid = csm_text_append(&text, line, len);
+                len = 0U;
+            }
+        }
+        nb_apdus++;
+        valid = valid && csm_text_append(&text, "\n", 1U) && xlt_flush(FALSE);
+    }
+
+    if (size < 0)
+    {
+        fprintf(stderr, "%s: invalid APDU at offset %u\n", path, pos);
+    }
+    if (opened)
+    {
+        mapped_file_close(&mf);
+    }
+    return xlt_flush(TRUE) && valid;
+}
+
+int main(int argc, char **argv)
+{
+    const char *output_file = NULL;
+    int reverse = FALSE;
+    int valid;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jro:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            format = CSM_TEXT_JSON;
+            break;
+        case 'r':
+            reverse = TRUE;
+            break;
+        case 'o':
+            output_file = optarg;
+            break;
+        case 'h':
+        default:
+            xlt_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != (argc - 1))
+    {
+        xlt_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    output = (output_file != NULL) ? fopen(output_file, "w") : stdout;
+    csm_text_init(&text, malloc(XLT_OUT_SIZE), XLT_OUT_SIZE, xlt_grow);
+    valid = (output != NULL) && (text.data != NULL);
+
+    if (valid)
+    {
+        valid = reverse ? xlt_reverse(argv[optind]) : xlt_forward(argv[optind]);
+        if (!valid)
+        {
+            fprintf(stderr, "Cannot translate %s\n", argv[optind]);
+        }
+        fprintf(stderr, "%u APDUs, %u frames skipped\n", nb_apdus, nb_skipped);
+    }
+
+    if ((output != NULL) && (output != stdout))
+    {
+        fclose(output);
+    }
+    free(text.data);
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}